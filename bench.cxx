@@ -0,0 +1,499 @@
+// runs the benchmarks listed in a manifest under an emulator several times each and reports emulated MIPS
+// and wall time with the median and variance across repetitions as JSON, plus the geometric mean of the medians.
+// with -c it compares the medians against a JSON file from an earlier run and fails when a benchmark regresses
+// by more than a threshold. with -n it also runs each benchmark natively and reports the emulation slowdown.
+// the manifest format is the same as runner's; see bench_tests/micro_manifest.txt and bench_tests/app_manifest.txt.
+// build with mbench.sh.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+struct Benchmark
+{
+    string name;
+    vector<string> commands;        // app and arguments; the emulator and -p are prepended
+    uint64_t instructions;          // emulated instructions per repetition, summed across the commands
+    vector<double> mips;            // one entry per measured repetition
+    vector<double> ms;              // wall milliseconds per measured repetition
+    vector<double> nativeMs;        // with -n, wall milliseconds per native repetition
+    double median;                  // of mips
+    double mean;                    // of mips
+    double variance;                // of mips
+    double medianMs;
+    double medianNativeMs;
+};
+
+static vector<Benchmark> g_benchmarks;
+static string g_emulator = "x64os";
+
+static void usage( char const * perror = 0 )
+{
+    if ( 0 != perror )
+        printf( "error: %s\n", perror );
+
+    printf( "usage: bench [arguments] <manifest>\n" );
+    printf( "   arguments:    -a:F   append a one-line JSON summary of this run to history file F for trend comparison\n" );
+    printf( "                 -c:F   compare the median MIPS of each benchmark with JSON file F from an earlier run\n" );
+    printf( "                 -e:C   emulator command line. default is x64os\n" );
+    printf( "                 -n     also run each benchmark natively (without the emulator) and report the slowdown\n" );
+    printf( "                 -o:F   write the results as JSON to file F. default is stdout\n" );
+    printf( "                 -r:N   measured repetitions per benchmark. default is 5\n" );
+    printf( "                 -t:P   with -c, fail if a benchmark is more than P percent slower. default is 5\n" );
+    printf( "                 -w:N   warm-up runs per benchmark that aren't measured. default is 1\n" );
+    printf( "   example:      bench -r:7 -o:bench_micro.json bench_tests/micro_manifest.txt\n" );
+    printf( "                 bench -c:bench_micro.json -t:3 bench_tests/micro_manifest.txt\n" );
+    printf( "                 bench -n -a:bench_history.jsonl bench_tests/app_manifest.txt\n" );
+    exit( 1 );
+} //usage
+
+static bool read_file( const char * pcFile, string & contents )
+{
+    FILE * fp = fopen( pcFile, "rb" );
+    if ( !fp )
+        return false;
+
+    char buf[ 4096 ];
+    size_t len;
+    while ( 0 != ( len = fread( buf, 1, sizeof( buf ), fp ) ) )
+        contents.append( buf, len );
+    fclose( fp );
+    return true;
+} //read_file
+
+static bool parse_manifest( const char * pcManifest )
+{
+    string contents;
+    if ( !read_file( pcManifest, contents ) )
+    {
+        printf( "can't open manifest file %s\n", pcManifest );
+        return false;
+    }
+
+    size_t lineNumber = 0;
+    size_t start = 0;
+    while ( start < contents.length() )
+    {
+        size_t end = contents.find( '\n', start );
+        if ( string::npos == end )
+            end = contents.length();
+        string line = contents.substr( start, end - start );
+        start = end + 1;
+        lineNumber++;
+
+        while ( line.length() && isspace( (unsigned char) line.back() ) )
+            line.pop_back();
+
+        if ( 0 == line.length() || '#' == line[ 0 ] || '@' == line[ 0 ] ) // benchmarks run serially, so groups don't matter
+            continue;
+
+        if ( ' ' == line[ 0 ] || '\t' == line[ 0 ] )
+        {
+            if ( 0 == g_benchmarks.size() )
+            {
+                printf( "manifest line %zu: a command must follow a benchmark name\n", lineNumber );
+                return false;
+            }
+
+            g_benchmarks.back().commands.push_back( line.substr( line.find_first_not_of( " \t" ) ) );
+        }
+        else
+        {
+            Benchmark b = {};
+            b.name = line;
+            g_benchmarks.push_back( b );
+        }
+    }
+
+    return true;
+} //parse_manifest
+
+// runs the command and returns the wall time in microseconds and, when emulated, the instruction count reported by -p
+
+static bool run_command( const string & command, bool native, int64_t & microseconds, uint64_t & instructions )
+{
+    string full = native ? command : ( g_emulator + " -p " + command );
+    instructions = 0;
+
+    high_resolution_clock::time_point tStart = high_resolution_clock::now();
+    FILE * fp = popen( full.c_str(), "r" );
+    if ( !fp )
+        return false;
+
+    string out;
+    char buf[ 4096 ];
+    size_t len;
+    while ( 0 != ( len = fread( buf, 1, sizeof( buf ), fp ) ) )
+        out.append( buf, len );
+    int status = pclose( fp );
+    microseconds = duration_cast<std::chrono::microseconds>( high_resolution_clock::now() - tStart ).count();
+
+    if ( 0 != status )
+    {
+        printf( "benchmark command failed: %s\n", full.c_str() );
+        return false;
+    }
+
+    if ( native )
+        return true;
+
+    size_t stats = out.rfind( "elapsed milliseconds:" );
+    if ( string::npos == stats )
+    {
+        printf( "benchmark command didn't report performance information: %s\n", full.c_str() );
+        return false;
+    }
+
+    size_t inst = out.find( "instructions:", stats );
+    if ( string::npos != inst )
+        for ( size_t i = inst + strlen( "instructions:" ); i < out.length() && '\n' != out[ i ]; i++ )
+            if ( isdigit( (unsigned char) out[ i ] ) )
+                instructions = instructions * 10 + ( out[ i ] - '0' );
+
+    return true;
+} //run_command
+
+static double median_of( vector<double> values )
+{
+    if ( 0 == values.size() )
+        return 0.0;
+
+    sort( values.begin(), values.end() );
+    size_t n = values.size();
+    return ( n & 1 ) ? values[ n / 2 ] : ( values[ n / 2 - 1 ] + values[ n / 2 ] ) / 2.0;
+} //median_of
+
+static bool run_benchmark( Benchmark & b, bool native, size_t warmups, size_t repetitions )
+{
+    for ( size_t r = 0; r < warmups + repetitions; r++ )
+    {
+        int64_t totalMicroseconds = 0;
+        uint64_t totalInstructions = 0;
+
+        for ( const string & command : b.commands )
+        {
+            int64_t microseconds;
+            uint64_t instructions;
+            if ( !run_command( command, native, microseconds, instructions ) )
+                return false;
+
+            totalMicroseconds += microseconds;
+            totalInstructions += instructions;
+        }
+
+        if ( r < warmups )
+            continue;
+
+        if ( native )
+            b.nativeMs.push_back( (double) totalMicroseconds / 1000.0 );
+        else
+        {
+            b.instructions = totalInstructions;
+            b.ms.push_back( (double) totalMicroseconds / 1000.0 );
+            b.mips.push_back( ( 0 == totalMicroseconds ) ? 0.0 : (double) totalInstructions / (double) totalMicroseconds );
+        }
+    }
+
+    if ( native )
+    {
+        b.medianNativeMs = median_of( b.nativeMs );
+        return true;
+    }
+
+    b.median = median_of( b.mips );
+    b.medianMs = median_of( b.ms );
+
+    size_t n = b.mips.size();
+
+    b.mean = 0.0;
+    for ( double m : b.mips )
+        b.mean += m;
+    b.mean /= (double) n;
+
+    b.variance = 0.0;
+    if ( n > 1 )
+    {
+        for ( double m : b.mips )
+            b.variance += ( m - b.mean ) * ( m - b.mean );
+        b.variance /= (double) ( n - 1 );
+    }
+
+    return true;
+} //run_benchmark
+
+// geometric mean of a per-benchmark value. benchmarks with a value of 0 are skipped
+
+template <typename T> static double geomean( T value )
+{
+    double logSum = 0.0;
+    size_t count = 0;
+    for ( const Benchmark & b : g_benchmarks )
+    {
+        double v = value( b );
+        if ( v > 0.0 )
+        {
+            logSum += log( v );
+            count++;
+        }
+    }
+
+    return ( 0 == count ) ? 0.0 : exp( logSum / (double) count );
+} //geomean
+
+static double geomean_mips() { return geomean( []( const Benchmark & b ) { return b.median; } ); }
+static double geomean_slowdown() { return geomean( []( const Benchmark & b ) { return ( b.medianNativeMs > 0.0 ) ? b.medianMs / b.medianNativeMs : 0.0; } ); }
+
+// emulator command lines and benchmark names are simple paths and words; escape the few characters JSON requires
+
+static string json_quoted( const string & s )
+{
+    string q = "\"";
+    for ( char c : s )
+    {
+        if ( '"' == c || '\\' == c )
+            q += '\\';
+        q += c;
+    }
+    return q + "\"";
+} //json_quoted
+
+static void render_date( char * pcDate, size_t len )
+{
+    time_t t = time( 0 );
+    strftime( pcDate, len, "%Y-%m-%dT%H:%M:%S", localtime( &t ) );
+} //render_date
+
+static void write_json( FILE * fp, const char * pcManifest, bool native, size_t warmups, size_t repetitions )
+{
+    char acDate[ 100 ];
+    render_date( acDate, sizeof( acDate ) );
+
+    fprintf( fp, "{\n" );
+    fprintf( fp, "  \"date\": \"%s\",\n", acDate );
+    fprintf( fp, "  \"emulator\": %s,\n", json_quoted( g_emulator ).c_str() );
+    fprintf( fp, "  \"manifest\": %s,\n", json_quoted( pcManifest ).c_str() );
+    fprintf( fp, "  \"warmups\": %zu,\n", warmups );
+    fprintf( fp, "  \"repetitions\": %zu,\n", repetitions );
+    fprintf( fp, "  \"benchmarks\": [\n" );
+
+    for ( size_t i = 0; i < g_benchmarks.size(); i++ )
+    {
+        const Benchmark & b = g_benchmarks[ i ];
+        fprintf( fp, "    {\n" );
+        fprintf( fp, "      \"name\": %s,\n", json_quoted( b.name ).c_str() );
+        fprintf( fp, "      \"instructions\": %llu,\n", (unsigned long long) b.instructions );
+        fprintf( fp, "      \"mips\": [" );
+        for ( size_t r = 0; r < b.mips.size(); r++ )
+            fprintf( fp, "%s %.3f", ( 0 == r ) ? "" : ",", b.mips[ r ] );
+        fprintf( fp, " ],\n" );
+        fprintf( fp, "      \"median_mips\": %.3f,\n", b.median );
+        fprintf( fp, "      \"mean_mips\": %.3f,\n", b.mean );
+        fprintf( fp, "      \"variance\": %.5f,\n", b.variance );
+        fprintf( fp, "      \"ms\": [" );
+        for ( size_t r = 0; r < b.ms.size(); r++ )
+            fprintf( fp, "%s %.3f", ( 0 == r ) ? "" : ",", b.ms[ r ] );
+        fprintf( fp, " ],\n" );
+        fprintf( fp, "      \"median_ms\": %.3f", b.medianMs );
+        if ( native )
+        {
+            fprintf( fp, ",\n      \"native_median_ms\": %.3f,\n", b.medianNativeMs );
+            fprintf( fp, "      \"slowdown\": %.2f", ( b.medianNativeMs > 0.0 ) ? b.medianMs / b.medianNativeMs : 0.0 );
+        }
+        fprintf( fp, "\n    }%s\n", ( i + 1 < g_benchmarks.size() ) ? "," : "" );
+    }
+
+    fprintf( fp, "  ],\n" );
+    fprintf( fp, "  \"geomean_mips\": %.3f", geomean_mips() );
+    if ( native )
+        fprintf( fp, ",\n  \"geomean_slowdown\": %.2f", geomean_slowdown() );
+    fprintf( fp, "\n}\n" );
+} //write_json
+
+// one line per run so a history file can be graphed or diffed over time
+
+static bool append_history( const char * pcHistory, const char * pcManifest, bool native )
+{
+    FILE * fp = fopen( pcHistory, "a" );
+    if ( !fp )
+        return false;
+
+    char acDate[ 100 ];
+    render_date( acDate, sizeof( acDate ) );
+
+    fprintf( fp, "{ \"date\": \"%s\", \"emulator\": %s, \"manifest\": %s, \"geomean_mips\": %.3f", acDate,
+             json_quoted( g_emulator ).c_str(), json_quoted( pcManifest ).c_str(), geomean_mips() );
+    if ( native )
+        fprintf( fp, ", \"geomean_slowdown\": %.2f", geomean_slowdown() );
+    fprintf( fp, ", \"median_mips\": {" );
+    for ( size_t i = 0; i < g_benchmarks.size(); i++ )
+        fprintf( fp, "%s %s: %.3f", ( 0 == i ) ? "" : ",", json_quoted( g_benchmarks[ i ].name ).c_str(), g_benchmarks[ i ].median );
+    fprintf( fp, " } }\n" );
+    fclose( fp );
+    return true;
+} //append_history
+
+// reads "median_mips" for the named benchmark from JSON written by write_json. this isn't a general JSON parser.
+
+static bool find_baseline_median( const string & json, const string & name, double & median )
+{
+    string key = "\"name\": \"" + name + "\"";
+    size_t pos = json.find( key );
+    if ( string::npos == pos )
+        return false;
+
+    size_t end = json.find( '}', pos );
+    size_t med = json.find( "\"median_mips\":", pos );
+    if ( string::npos == med || med > end )
+        return false;
+
+    median = strtod( json.c_str() + med + strlen( "\"median_mips\":" ), 0 );
+    return true;
+} //find_baseline_median
+
+static bool compare_with_baseline( const char * pcBaseline, double threshold )
+{
+    string json;
+    if ( !read_file( pcBaseline, json ) )
+    {
+        printf( "can't open baseline file %s\n", pcBaseline );
+        return false;
+    }
+
+    bool ok = true;
+    printf( "%-16s %12s %12s %9s  %s\n", "benchmark", "baseline", "current", "change", "result" );
+
+    for ( const Benchmark & b : g_benchmarks )
+    {
+        double baseline;
+        if ( !find_baseline_median( json, b.name, baseline ) || baseline <= 0.0 )
+        {
+            printf( "%-16s %12s %12.2f %9s  %s\n", b.name.c_str(), "-", b.median, "-", "no baseline" );
+            continue;
+        }
+
+        double change = 100.0 * ( b.median - baseline ) / baseline;
+        bool regressed = ( change < -threshold );
+        if ( regressed )
+            ok = false;
+
+        printf( "%-16s %12.2f %12.2f %8.1f%%  %s\n", b.name.c_str(), baseline, b.median, change, regressed ? "REGRESSED" : "ok" );
+    }
+
+    return ok;
+} //compare_with_baseline
+
+int main( int argc, char * argv[] )
+{
+    const char * pcManifest = 0;
+    const char * pcOutput = 0;
+    const char * pcBaseline = 0;
+    const char * pcHistory = 0;
+    bool native = false;
+    size_t repetitions = 5;
+    size_t warmups = 1;
+    double threshold = 5.0;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        char * parg = argv[ i ];
+        if ( '-' == parg[ 0 ] )
+        {
+            char ca = (char) tolower( parg[ 1 ] );
+
+            if ( 'n' == ca )
+                native = true;
+            else if ( ':' != parg[ 2 ] )
+                usage( "invalid argument" );
+            else if ( 'a' == ca )
+                pcHistory = parg + 3;
+            else if ( 'c' == ca )
+                pcBaseline = parg + 3;
+            else if ( 'e' == ca )
+                g_emulator = parg + 3;
+            else if ( 'o' == ca )
+                pcOutput = parg + 3;
+            else if ( 'r' == ca )
+                repetitions = strtoull( parg + 3, 0, 10 );
+            else if ( 't' == ca )
+                threshold = strtod( parg + 3, 0 );
+            else if ( 'w' == ca )
+                warmups = strtoull( parg + 3, 0, 10 );
+            else
+                usage( "invalid argument" );
+        }
+        else if ( 0 == pcManifest )
+            pcManifest = parg;
+        else
+            usage( "only one manifest can be specified" );
+    }
+
+    if ( 0 == pcManifest )
+        usage( "no manifest specified" );
+
+    if ( 0 == repetitions )
+        usage( "at least one repetition is required" );
+
+    if ( 0 == g_emulator.length() )
+        usage( "an emulator is required to count instructions" );
+
+    if ( !parse_manifest( pcManifest ) )
+        return 1;
+
+    for ( Benchmark & b : g_benchmarks )
+    {
+        if ( !run_benchmark( b, false, warmups, repetitions ) )
+            return 1;
+
+        if ( native && !run_benchmark( b, true, warmups, repetitions ) )
+            return 1;
+
+        fprintf( stderr, "  %-36s %10.2f MIPS median, %.4f variance, %10.1f ms", b.name.c_str(), b.median, b.variance, b.medianMs );
+        if ( native && b.medianNativeMs > 0.0 )
+            fprintf( stderr, ", %8.1fx slower than native", b.medianMs / b.medianNativeMs );
+        fprintf( stderr, "\n" );
+    }
+
+    fprintf( stderr, "  geometric mean: %.2f MIPS", geomean_mips() );
+    if ( native )
+        fprintf( stderr, ", %.1fx slower than native", geomean_slowdown() );
+    fprintf( stderr, "\n" );
+
+    if ( pcOutput )
+    {
+        FILE * fp = fopen( pcOutput, "w" );
+        if ( !fp )
+        {
+            printf( "can't write output file %s\n", pcOutput );
+            return 1;
+        }
+        write_json( fp, pcManifest, native, warmups, repetitions );
+        fclose( fp );
+    }
+    else if ( !pcBaseline )
+        write_json( stdout, pcManifest, native, warmups, repetitions );
+
+    if ( pcHistory && !append_history( pcHistory, pcManifest, native ) )
+        printf( "can't append to history file %s\n", pcHistory );
+
+    if ( pcBaseline && !compare_with_baseline( pcBaseline, threshold ) )
+        return 1;
+
+    return 0;
+} //main
@@ -0,0 +1,7 @@
+#!/bin/bash
+# assembles the microbenchmarks. no compiler is needed to run them; see micro_manifest.txt
+
+for arg in mb_alu mb_branch mb_addr mb_stack mb_string mb_sse2int mb_sse2fp mb_x87 mb_syscall;
+do
+    gcc $arg.s -o $arg.elf -static -nostdlib
+done
@@ -0,0 +1,43 @@
+# microbenchmark: memory addressing modes. loads and stores with base, base+displacement, base+index*scale,
+# base+index*scale+displacement, and rip-relative operands over a 4k buffer. the loop runs 3,000,000 times.
+
+.equ iterations, 3000000
+.equ buffer_qwords, 512
+
+.bss
+.p2align 6
+buffer: .skip buffer_qwords * 8
+
+.data
+.p2align 3
+scalar: .quad 3
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    lea     buffer(%rip), %rbx
+    xor     %rcx, %rcx
+    xor     %rax, %rax
+
+  .addr_loop:
+    mov     (%rbx), %rdx
+    add     8(%rbx), %rdx
+    mov     %rdx, 16(%rbx)
+    mov     (%rbx,%rcx,8), %rsi
+    add     %rsi, %rax
+    mov     %rax, 64(%rbx,%rcx,4)
+    movzwl  2(%rbx,%rcx,2), %edi
+    add     scalar(%rip), %rdi
+    mov     %rdi, scalar(%rip)
+    movl    %edi, 128(%rbx,%rcx,1)
+    addq    $1, 24(%rbx)
+
+    inc     %rcx
+    and     $255, %rcx                        # stay inside the buffer
+    dec     %r15
+    jnz     .addr_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
@@ -0,0 +1,36 @@
+# microbenchmark: integer ALU. register-only arithmetic, logic, shifts, rotates, multiply, and lea.
+# each iteration is 16 instructions; the loop runs 4,000,000 times.
+
+.equ iterations, 4000000
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    mov     $0x123456789abcdef, %rax
+    mov     $0x0fedcba987654321, %rbx
+    mov     $7, %rcx
+    xor     %rdx, %rdx
+
+  .alu_loop:
+    add     %rbx, %rax
+    sub     %rcx, %rbx
+    xor     %rax, %rdx
+    and     $0x7fffffff, %ecx
+    or      %rdx, %rcx
+    imul    %rbx, %rdx
+    shl     $3, %rbx
+    shr     $1, %rax
+    ror     $7, %rdx
+    lea     5(%rax,%rbx,2), %rsi
+    neg     %rsi
+    inc     %rcx
+    not     %rdi
+    sar     $2, %rsi
+
+    dec     %r15
+    jnz     .alu_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
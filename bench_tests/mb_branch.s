@@ -0,0 +1,52 @@
+# microbenchmark: flags-heavy code. compares, tests, data-dependent conditional branches, setcc, cmovcc, adc, and sbb.
+# a linear congruential generator makes the branches unpredictable. the loop runs 2,000,000 times.
+
+.equ iterations, 2000000
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    mov     $12345, %rax                      # lcg state
+    mov     $6364136223846793005, %r8         # lcg multiplier
+    mov     $1442695040888963407, %r9         # lcg increment
+    xor     %rbx, %rbx
+    xor     %rcx, %rcx
+
+  .branch_loop:
+    imul    %r8, %rax
+    add     %r9, %rax
+    mov     %rax, %rdx
+    shr     $33, %rdx
+
+    test    $1, %dl
+    jz      .even
+    inc     %rbx
+    jmp     .parity_done
+  .even:
+    dec     %rbx
+  .parity_done:
+
+    cmp     $0x40000000, %edx
+    jb      .low
+    add     $3, %rcx
+  .low:
+    cmp     %rbx, %rcx
+    setg    %sil
+    movzbl  %sil, %esi
+    cmovl   %rdx, %rdi
+    add     %rdx, %rbx
+    adc     $0, %rcx
+    sub     %rdx, %rcx
+    sbb     $0, %rbx
+    bt      $5, %rdx
+    jnc     .no_bit
+    xor     %rsi, %rcx
+  .no_bit:
+
+    dec     %r15
+    jnz     .branch_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
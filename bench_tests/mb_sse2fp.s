@@ -0,0 +1,44 @@
+# microbenchmark: SSE2 scalar floating point. add, subtract, multiply, divide, square root, min, max,
+# conversions, and compares on doubles. the loop runs 2,000,000 times.
+
+.equ iterations, 2000000
+
+.data
+.p2align 3
+one:       .double 1.0
+increment: .double 0.000001
+scale:     .double 1.0000001
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    movsd   one(%rip), %xmm0
+    movsd   increment(%rip), %xmm1
+    movsd   scale(%rip), %xmm2
+    movsd   one(%rip), %xmm5
+
+  .sse2fp_loop:
+    addsd   %xmm1, %xmm0
+    mulsd   %xmm2, %xmm0
+    movsd   %xmm0, %xmm3
+    sqrtsd  %xmm3, %xmm3
+    divsd   %xmm0, %xmm3
+    subsd   %xmm3, %xmm0
+    addsd   %xmm5, %xmm0
+    maxsd   %xmm5, %xmm0
+    minsd   %xmm0, %xmm3
+    cvtsi2sd %r15, %xmm4
+    mulsd   %xmm1, %xmm4
+    cvttsd2si %xmm4, %rax
+    ucomisd %xmm5, %xmm3
+    jbe     .not_above
+    movsd   %xmm5, %xmm3
+  .not_above:
+
+    dec     %r15
+    jnz     .sse2fp_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
@@ -0,0 +1,44 @@
+# microbenchmark: SSE2 packed integer. add, subtract, multiply, logic, compare, shuffle, unpack, and shift
+# on xmm registers, plus aligned loads and stores. the loop runs 2,000,000 times.
+
+.equ iterations, 2000000
+
+.data
+.p2align 4
+vector_a: .long 0x01020304, 0x05060708, 0x090a0b0c, 0x0d0e0f10
+vector_b: .long 0x11111111, 0x22222222, 0x33333333, 0x44444444
+.bss
+.p2align 4
+vector_out: .skip 16
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    movdqa  vector_a(%rip), %xmm0
+    movdqa  vector_b(%rip), %xmm1
+    pxor    %xmm2, %xmm2
+
+  .sse2int_loop:
+    paddd   %xmm1, %xmm0
+    psubw   %xmm0, %xmm1
+    pmullw  %xmm0, %xmm2
+    pand    %xmm1, %xmm2
+    por     %xmm0, %xmm2
+    pxor    %xmm2, %xmm1
+    pcmpeqb %xmm0, %xmm2
+    pshufd  $0x1b, %xmm0, %xmm3
+    punpcklbw %xmm3, %xmm2
+    psllq   $3, %xmm3
+    psrld   $1, %xmm0
+    paddq   %xmm3, %xmm0
+    movdqa  %xmm2, vector_out(%rip)
+    movdqa  vector_out(%rip), %xmm4
+    paddb   %xmm4, %xmm1
+
+    dec     %r15
+    jnz     .sse2int_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
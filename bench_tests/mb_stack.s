@@ -0,0 +1,43 @@
+# microbenchmark: push, pop, call, and ret. a two-deep call chain that saves and restores registers.
+# the loop runs 2,000,000 times.
+
+.equ iterations, 2000000
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    xor     %rax, %rax
+
+  .stack_loop:
+    call    outer
+    dec     %r15
+    jnz     .stack_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
+
+outer:
+    push    %rbp
+    mov     %rsp, %rbp
+    push    %rbx
+    push    %r12
+    mov     %r15, %rbx
+    call    inner
+    call    inner
+    pop     %r12
+    pop     %rbx
+    pop     %rbp
+    ret
+
+inner:
+    push    %rbx
+    push    %rcx
+    add     %rbx, %rax
+    pushq   $7
+    pop     %rcx
+    add     %rcx, %rax
+    pop     %rcx
+    pop     %rbx
+    ret
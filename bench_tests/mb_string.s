@@ -0,0 +1,51 @@
+# microbenchmark: rep string instructions. rep stos, rep movs, and repne scas with byte and qword
+# element sizes over 256-byte buffers. the loop runs 100,000 times.
+
+.equ iterations, 100000
+.equ buffer_size, 256
+
+.bss
+.p2align 6
+source: .skip buffer_size
+.p2align 6
+dest:   .skip buffer_size
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    cld
+
+  .string_loop:
+    lea     source(%rip), %rdi                # fill the source with the loop counter
+    mov     %r15, %rax
+    mov     $buffer_size / 8, %rcx
+    rep     stosq
+
+    lea     source(%rip), %rsi                # copy it as qwords
+    lea     dest(%rip), %rdi
+    mov     $buffer_size / 8, %rcx
+    rep     movsq
+
+    lea     source(%rip), %rsi                # copy it as bytes
+    lea     dest(%rip), %rdi
+    mov     $buffer_size, %rcx
+    rep     movsb
+
+    lea     dest(%rip), %rdi                  # clear the last quarter as bytes
+    add     $buffer_size * 3 / 4, %rdi
+    xor     %al, %al
+    mov     $buffer_size / 4, %rcx
+    rep     stosb
+
+    lea     dest(%rip), %rdi                  # search for a byte that isn't there
+    mov     $0xff, %al
+    mov     $buffer_size, %rcx
+    repne   scasb
+
+    dec     %r15
+    jnz     .string_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
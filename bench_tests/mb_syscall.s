@@ -0,0 +1,35 @@
+# microbenchmark: system calls. getpid, clock_gettime, and a zero-length write to stdout, which exercise
+# syscall dispatch without doing much work in the host. the loop runs 200,000 times.
+
+.equ iterations, 200000
+
+.bss
+.p2align 4
+timespec: .skip 16
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+
+  .syscall_loop:
+    mov     $39, %rax                         # getpid
+    syscall
+
+    mov     $228, %rax                        # clock_gettime
+    mov     $1, %rdi                          # CLOCK_MONOTONIC
+    lea     timespec(%rip), %rsi
+    syscall
+
+    mov     $1, %rax                          # write
+    mov     $1, %rdi
+    lea     timespec(%rip), %rsi
+    xor     %rdx, %rdx
+    syscall
+
+    dec     %r15
+    jnz     .syscall_loop
+
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
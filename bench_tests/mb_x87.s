@@ -0,0 +1,46 @@
+# microbenchmark: x87 floating point. loads, stores, arithmetic, square root, exchange, integer load and
+# store, and compares on the register stack. the loop runs 1,000,000 times.
+
+.equ iterations, 1000000
+
+.data
+.p2align 3
+one:       .double 1.0
+increment: .double 0.000001
+.bss
+.p2align 3
+result:    .skip 8
+integer:   .skip 8
+
+.global _start
+.text
+_start:
+    mov     $iterations, %r15
+    finit
+    fldl    one(%rip)                         # st0 = running value
+
+  .x87_loop:
+    faddl   increment(%rip)
+    fld     %st(0)
+    fsqrt
+    fmul    %st(1), %st(0)
+    fdivl   one(%rip)
+    fxch    %st(1)
+    fsub    %st(1), %st(0)
+    fabs
+    fld1
+    faddp   %st(0), %st(1)
+    fcomi   %st(1), %st(0)
+    fstpl   result(%rip)
+    fldl    result(%rip)
+    fistpll integer(%rip)
+    fildll  integer(%rip)
+    fstp    %st(0)
+
+    dec     %r15
+    jnz     .x87_loop
+
+    fstp    %st(0)
+    mov     $60, %rax                         # exit
+    xor     %rdi, %rdi
+    syscall
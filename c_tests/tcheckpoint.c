@@ -0,0 +1,112 @@
+// test checkpoint and restore. runall.sh runs it with -c:F, where the checkpoint syscall writes F and the app
+// continues, then with -r:F, which resumes from the syscall. it also runs with -c:F -n:X and an argument, which
+// checkpoints in the middle of the loop that fills the heap, then resumes that with -r:F. state set up before the
+// checkpoint must be the same after: memory, file positions, signal handlers, the signal mask, pending signals,
+// timers, and perf_event counters.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const long emulator_sys_checkpoint = 0x2013;
+static volatile int usr1s = 0;
+static volatile int usr2s = 0;
+static volatile int alarms = 0;
+
+static void on_usr1( int sig ) { usr1s++; }
+static void on_usr2( int sig ) { usr2s++; }
+static void on_alarm( int sig ) { alarms++; }
+
+int main( int argc, char * argv[] )
+{
+    bool instruction_checkpoint = ( argc > 1 ); // -n writes the checkpoint, not the syscall
+
+    FILE * fp = fopen( "c_tests/words.txt", "r" );
+    if ( !fp )
+    {
+        printf( "can't open c_tests/words.txt, errno %d\n", errno );
+        exit( 1 );
+    }
+    char line[ 100 ];
+    fgets( line, sizeof( line ), fp );
+    line[ strcspn( line, "\r\n" ) ] = 0; // words.txt has CRLF line endings
+
+    signal( SIGUSR1, on_usr1 );
+    signal( SIGUSR2, on_usr2 );
+    signal( SIGALRM, on_alarm );
+
+    sigset_t mask;
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGUSR2 );
+    sigprocmask( SIG_BLOCK, &mask, 0 );
+    raise( SIGUSR2 ); // stays pending across the checkpoint
+
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = PERF_TYPE_RAW;
+    attr.config = 5; // the emulator's syscall counter
+    int perf = (int) syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+    uint64_t perf_id = 0;
+    ioctl( perf, PERF_EVENT_IOC_ID, &perf_id );
+
+    struct itimerval real = { { 0, 0 }, { 0, 200000 } }; // fires after the checkpoint
+    setitimer( ITIMER_REAL, &real, 0 );
+
+    // with -n, the checkpoint is written in this loop, before any output
+
+    const int count = 1000000;
+    int * values = (int *) malloc( count * sizeof( int ) );
+    for ( int i = 0; i < count; i++ )
+        values[ i ] = i * 3;
+
+    long resumed = 0;
+    if ( !instruction_checkpoint )
+    {
+        printf( "first line: %s\n", line );
+        fflush( stdout ); // so output before the checkpoint isn't shown again on resume
+        resumed = syscall( emulator_sys_checkpoint );
+    }
+    printf( "resumed from the checkpoint: %ld\n", resumed );
+
+    fgets( line, sizeof( line ), fp );
+    line[ strcspn( line, "\r\n" ) ] = 0;
+    printf( "second line: %s\n", line );
+    fclose( fp );
+
+    int64_t sum = 0;
+    for ( int i = 0; i < count; i++ )
+        sum += values[ i ];
+    printf( "sum of heap values %lld\n", (long long) sum );
+    free( values );
+
+    raise( SIGUSR1 );
+    printf( "SIGUSR1 handler still installed: %d\n", 1 == usr1s );
+
+    sigset_t pending;
+    sigpending( &pending );
+    printf( "SIGUSR2 still blocked and pending: %d, delivered %d\n", sigismember( &pending, SIGUSR2 ), usr2s );
+    sigprocmask( SIG_UNBLOCK, &mask, 0 );
+    printf( "SIGUSR2 delivered after unblocking: %d\n", usr2s );
+
+    if ( 0 == alarms )
+        pause();
+    printf( "the timer armed before the checkpoint fired: %d\n", 1 == alarms );
+
+    uint64_t id = 0, syscalls = 0;
+    int result = ioctl( perf, PERF_EVENT_IOC_ID, &id );
+    printf( "perf event still open: %d, same id: %d\n", 0 == result, id == perf_id );
+    printf( "perf event still counting: %d\n", sizeof( syscalls ) == read( perf, &syscalls, sizeof( syscalls ) ) && syscalls >= 10 );
+    close( perf );
+
+    printf( "tcheckpoint completed with great success\n" );
+    return 0;
+} //main
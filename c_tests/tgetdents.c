@@ -0,0 +1,203 @@
+// test directory enumeration: two streams on the same folder read in turns, a walk nested inside another walk,
+// raw getdents64 with buffers too small for every entry, and telldir/seekdir. names are sorted before they're
+// shown because the order of entries depends on the file system.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+static const char * folder = "tgetdents_folder";
+static const char * subfolder = "tgetdents_folder/sub";
+static const int file_count = 40;
+static const int sub_count = 5;
+
+static void cleanup()
+{
+    char path[ 256 ];
+    for ( int i = 0; i < sub_count; i++ )
+    {
+        snprintf( path, sizeof( path ), "%s/s%02d", subfolder, i );
+        unlink( path );
+    }
+    for ( int i = 0; i < file_count; i++ )
+    {
+        snprintf( path, sizeof( path ), "%s/file_with_a_long_name_%02d.txt", folder, i );
+        unlink( path );
+    }
+    rmdir( subfolder );
+    rmdir( folder );
+} //cleanup
+
+static void create_file( const char * path )
+{
+    int fd = open( path, O_CREAT | O_WRONLY | O_TRUNC, 0644 );
+    if ( fd < 0 )
+    {
+        printf( "can't create %s, errno %d\n", path, errno );
+        exit( 1 );
+    }
+    close( fd );
+} //create_file
+
+static void show( const char * label, vector<string> & names )
+{
+    sort( names.begin(), names.end() );
+    printf( "%s: %d entries, first %s, last %s\n", label, (int) names.size(), names.front().c_str(), names.back().c_str() );
+} //show
+
+static bool is_dot( const char * name ) { return !strcmp( name, "." ) || !strcmp( name, ".." ); }
+
+int main( int argc, char * argv[] )
+{
+    cleanup(); // in case a prior run failed
+    if ( 0 != mkdir( folder, 0755 ) || 0 != mkdir( subfolder, 0755 ) )
+    {
+        printf( "can't create test folders, errno %d\n", errno );
+        exit( 1 );
+    }
+
+    char path[ 256 ];
+    for ( int i = 0; i < file_count; i++ )
+    {
+        snprintf( path, sizeof( path ), "%s/file_with_a_long_name_%02d.txt", folder, i );
+        create_file( path );
+    }
+    for ( int i = 0; i < sub_count; i++ )
+    {
+        snprintf( path, sizeof( path ), "%s/s%02d", subfolder, i );
+        create_file( path );
+    }
+
+    // two streams on the same folder, read in turns. each must see every entry once
+
+    DIR * pa = opendir( folder );
+    DIR * pb = opendir( folder );
+    vector<string> a, b;
+    bool a_done = false, b_done = false;
+    while ( !a_done || !b_done )
+    {
+        struct dirent * pe;
+        if ( !a_done )
+        {
+            if ( ( pe = readdir( pa ) ) )
+                a.push_back( pe->d_name );
+            else
+                a_done = true;
+        }
+        if ( !b_done )
+        {
+            if ( ( pe = readdir( pb ) ) )
+                b.push_back( pe->d_name );
+            else
+                b_done = true;
+        }
+    }
+    closedir( pa );
+    closedir( pb );
+    show( "stream a", a );
+    show( "stream b", b );
+    printf( "streams match: %d\n", a == b );
+
+    // walk the subfolder each time the outer walk finds it
+
+    vector<string> outer, inner;
+    pa = opendir( folder );
+    struct dirent * pe;
+    while ( ( pe = readdir( pa ) ) )
+    {
+        outer.push_back( pe->d_name );
+        if ( DT_DIR == pe->d_type && !is_dot( pe->d_name ) )
+        {
+            DIR * psub = opendir( subfolder );
+            struct dirent * ps;
+            while ( ( ps = readdir( psub ) ) )
+                if ( !is_dot( ps->d_name ) )
+                    inner.push_back( ps->d_name );
+            closedir( psub );
+        }
+    }
+    closedir( pa );
+    show( "nested outer", outer );
+    show( "nested inner", inner );
+
+    // getdents64 with buffers that hold only a few entries. every entry must still be returned exactly once
+
+    for ( size_t buffer_size = 64; buffer_size <= 1024; buffer_size *= 4 )
+    {
+        int fd = open( folder, O_RDONLY | O_DIRECTORY );
+        vector<uint8_t> buffer( buffer_size );
+        vector<string> names;
+        int calls = 0;
+        bool types_ok = true;
+        for ( ;; )
+        {
+            long n = syscall( SYS_getdents64, fd, buffer.data(), buffer.size() );
+            if ( n < 0 )
+            {
+                printf( "getdents64 with a %d byte buffer failed, errno %d\n", (int) buffer_size, errno );
+                exit( 1 );
+            }
+            if ( 0 == n )
+                break;
+            calls++;
+
+            for ( long offset = 0; offset < n; )
+            {
+                struct dirent64 * pd = (struct dirent64 *) ( buffer.data() + offset );
+                names.push_back( pd->d_name );
+                if ( !is_dot( pd->d_name ) && ( ( 's' == pd->d_name[ 0 ] ) != ( DT_DIR == pd->d_type ) ) )
+                    types_ok = false;
+                offset += pd->d_reclen;
+            }
+        }
+        close( fd );
+
+        char label[ 64 ];
+        snprintf( label, sizeof( label ), "getdents64 %d byte buffer", (int) buffer_size );
+        show( label, names );
+        printf( "  more than one entry per call: %d, types are right: %d\n", calls < (int) names.size(), types_ok );
+    }
+
+    // a buffer too small for any entry is an error
+
+    int fd = open( folder, O_RDONLY | O_DIRECTORY );
+    uint8_t tiny[ 8 ];
+    long result = syscall( SYS_getdents64, fd, tiny, sizeof( tiny ) );
+    printf( "getdents64 with an 8 byte buffer: %ld errno %d\n", result, ( result < 0 ) ? errno : 0 );
+    close( fd );
+
+    // telldir and seekdir return to the same entry
+
+    pa = opendir( folder );
+    for ( int i = 0; i < 10; i++ )
+        readdir( pa );
+    long position = telldir( pa );
+    string expected = readdir( pa )->d_name;
+    for ( int i = 0; i < 10; i++ )
+        readdir( pa );
+    seekdir( pa, position );
+    printf( "seekdir returns to the same entry: %d\n", expected == readdir( pa )->d_name );
+    rewinddir( pa );
+    int count = 0;
+    while ( readdir( pa ) )
+        count++;
+    printf( "entries after rewinddir: %d\n", count );
+    closedir( pa );
+
+    cleanup();
+    printf( "tgetdents completed with great success\n" );
+    return 0;
+} //main
@@ -0,0 +1,121 @@
+// test perf_event_open with the emulator's counters: groups, enable/disable/reset, PERF_EVENT_IOC_ID, and read
+// formats. counts depend on the compiler and optimization level, so only relationships between them are shown.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int perf_open( uint32_t type, uint64_t config, int group, uint64_t read_format, bool disabled = true )
+{
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = disabled;
+    attr.exclude_kernel = 1;
+    attr.read_format = read_format;
+    return (int) syscall( SYS_perf_event_open, &attr, 0, -1, group, 0 );
+} //perf_open
+
+static uint64_t read_one( int fd )
+{
+    uint64_t value = 0;
+    if ( sizeof( value ) != read( fd, &value, sizeof( value ) ) )
+    {
+        printf( "read of perf event failed, errno %d\n", errno );
+        exit( 1 );
+    }
+    return value;
+} //read_one
+
+volatile uint64_t sink[ 1000 ];
+
+int main( int argc, char * argv[] )
+{
+    // raw configs are the emulator's counters: 0 instructions, 1 branches, 2 taken branches, 3 loads, 4 stores, 5 syscalls
+
+    int instructions = perf_open( PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, 0 );
+    int syscalls = perf_open( PERF_TYPE_RAW, 5, -1, 0 );
+    if ( instructions < 0 || syscalls < 0 )
+    {
+        printf( "perf_event_open failed, errno %d\n", errno );
+        exit( 1 );
+    }
+
+    for ( int i = 0; i < 1000; i++ )
+        sink[ i ] = i;
+    printf( "disabled counters stay at 0: %d\n", 0 == read_one( instructions ) && 0 == read_one( syscalls ) );
+
+    ioctl( syscalls, PERF_EVENT_IOC_ENABLE, 0 );
+    for ( int i = 0; i < 10; i++ )
+        getpid();
+    ioctl( syscalls, PERF_EVENT_IOC_DISABLE, 0 );
+    printf( "syscalls counted for 10 getpid calls: %llu\n", (unsigned long long) read_one( syscalls ) );
+
+    ioctl( syscalls, PERF_EVENT_IOC_RESET, 0 );
+    printf( "syscalls after reset: %llu\n", (unsigned long long) read_one( syscalls ) );
+
+    ioctl( instructions, PERF_EVENT_IOC_ENABLE, 0 );
+    for ( int i = 0; i < 1000; i++ )
+        sink[ i ] += i;
+    ioctl( instructions, PERF_EVENT_IOC_DISABLE, 0 );
+    uint64_t loop = read_one( instructions );
+    printf( "a 1000 iteration loop retires at least 2000 instructions: %d\n", loop >= 2000 );
+    printf( "disabled counters don't advance: %d\n", loop == read_one( instructions ) );
+
+    // a group of instructions, branches, and loads read together with ids and the time enabled
+
+    uint64_t format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED;
+    int leader = perf_open( PERF_TYPE_RAW, 0, -1, format );
+    int branches = perf_open( PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS, leader, format );
+    int loads = perf_open( PERF_TYPE_RAW, 3, leader, format );
+    printf( "group opened: %d\n", leader >= 0 && branches >= 0 && loads >= 0 );
+
+    ioctl( leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+    ioctl( leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+    uint64_t total = 0;
+    for ( int i = 0; i < 1000; i++ )
+        total += sink[ i ];
+    ioctl( leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+
+    uint64_t data[ 16 ];
+    ssize_t len = read( leader, data, sizeof( data ) );
+    printf( "group read returned %d bytes for %llu events\n", (int) len, (unsigned long long) data[ 0 ] );
+    printf( "time enabled is nonzero: %d\n", 0 != data[ 1 ] );
+    printf( "instructions > branches >= 1000: %d\n", data[ 2 ] > data[ 4 ] && data[ 4 ] >= 1000 );
+    printf( "loads >= 1000: %d\n", data[ 6 ] >= 1000 );
+
+    uint64_t ids[ 3 ];
+    int fds[ 3 ] = { leader, branches, loads };
+    for ( int i = 0; i < 3; i++ )
+        ioctl( fds[ i ], PERF_EVENT_IOC_ID, &ids[ i ] );
+    printf( "PERF_EVENT_IOC_ID matches the group read: %d\n", ids[ 0 ] == data[ 3 ] && ids[ 1 ] == data[ 5 ] && ids[ 2 ] == data[ 7 ] );
+    printf( "ids are distinct: %d\n", ids[ 0 ] != ids[ 1 ] && ids[ 1 ] != ids[ 2 ] && ids[ 0 ] != ids[ 2 ] );
+
+    // errors
+
+    int result = ioctl( leader, PERF_EVENT_IOC_ID, (uint64_t *) 8 );
+    printf( "PERF_EVENT_IOC_ID with a bad pointer: %d errno %d\n", result, errno );
+    result = (int) syscall( SYS_perf_event_open, (void *) 8, 0, -1, -1, 0 );
+    printf( "perf_event_open with a bad pointer: %d errno %d\n", result, errno );
+    result = perf_open( PERF_TYPE_RAW, 1000, -1, 0 );
+    printf( "perf_event_open of an unknown counter: %d errno %d\n", result, errno );
+    result = perf_open( PERF_TYPE_RAW, 0, branches, 0 );
+    printf( "perf_event_open with a group member as leader: %d errno %d\n", result, errno );
+
+    close( loads );
+    close( branches );
+    close( leader );
+    close( syscalls );
+    close( instructions );
+
+    printf( "tperf completed with great success %d\n", (int) ( total & 0 ) );
+    return 0;
+} //main
@@ -0,0 +1,71 @@
+// test syscall record (-w) and replay (-x). runall.sh records a run with stdin from tgets.txt, then replays it
+// with no stdin. the output only depends on what syscalls returned, so the replay matches only if replay works.
+// with an argument, the time, random bytes, and pid are also written to stderr, where the emulator's -p output
+// doesn't go. those differ across runs unless replayed.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+int main( int argc, char * argv[] )
+{
+    bool verbose = ( argc > 1 );
+
+    // stdin is a pipe or file when recording and empty when replaying
+
+    static char input[ 4096 ];
+    size_t len = 0;
+    for ( ;; )
+    {
+        ssize_t n = read( 0, input + len, sizeof( input ) - 1 - len );
+        if ( n <= 0 )
+            break;
+        len += n;
+    }
+    input[ len ] = 0;
+
+    int lines = 0;
+    for ( size_t i = 0; i < len; i++ )
+        if ( '\n' == input[ i ] )
+            lines++;
+
+    printf( "stdin has %d bytes in %d lines\n", (int) len, lines );
+    printf( "%s", input );
+
+    struct timespec ts;
+    clock_gettime( CLOCK_REALTIME, &ts );
+    struct timespec mono1, mono2;
+    clock_gettime( CLOCK_MONOTONIC, &mono1 );
+    uint8_t random1[ 16 ], random2[ 16 ];
+    ssize_t r1 = getrandom( random1, sizeof( random1 ), 0 );
+    ssize_t r2 = getrandom( random2, sizeof( random2 ), 0 );
+    clock_gettime( CLOCK_MONOTONIC, &mono2 );
+
+    printf( "realtime is after 2020: %d\n", ts.tv_sec > 1577836800 );
+    printf( "monotonic time doesn't go backwards: %d\n", ( mono2.tv_sec > mono1.tv_sec ) || ( mono2.tv_sec == mono1.tv_sec && mono2.tv_nsec >= mono1.tv_nsec ) );
+    printf( "getrandom returned %d and %d, results differ: %d\n", (int) r1, (int) r2, 0 != memcmp( random1, random2, sizeof( random1 ) ) );
+
+    // a missing file's error is replayed too
+
+    struct stat st;
+    int result = stat( "trecord_missing_file.txt", &st );
+    printf( "stat of a missing file: %d errno %d\n", result, ( 0 == result ) ? 0 : errno );
+
+    if ( verbose )
+    {
+        fprintf( stderr, "time %lld.%09ld pid %d random", (long long) ts.tv_sec, (long) ts.tv_nsec, (int) getpid() );
+        for ( size_t i = 0; i < sizeof( random1 ); i++ )
+            fprintf( stderr, " %02x", random1[ i ] );
+        fprintf( stderr, "\n" );
+    }
+
+    printf( "trecord completed with great success\n" );
+    return 0;
+} //main
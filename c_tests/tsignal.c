@@ -0,0 +1,122 @@
+// test signal delivery: handlers with and without siginfo, masks and pending signals, interval timers, POSIX
+// timers interrupting nanosleep, and the alternate signal stack
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+static volatile int alarms = 0;
+static volatile int profs = 0;
+static volatile int usrs = 0;
+static volatile int timers = 0;
+static volatile int timer_value = 0;
+static volatile int usr_code = 0;
+static volatile int on_alt_stack = 0;
+static char alt_stack[ 65536 ];
+
+static void on_alarm( int sig ) { alarms++; }
+static void on_prof( int sig ) { profs++; }
+
+static void on_usr1( int sig, siginfo_t * info, void * context )
+{
+    usrs++;
+    usr_code = info->si_code;
+
+    // floating point in a handler must not disturb the interrupted code's registers
+
+    volatile double d = 3.5 * usrs;
+    (void) d;
+} //on_usr1
+
+static void on_timer( int sig, siginfo_t * info, void * context )
+{
+    timers++;
+    timer_value = info->si_value.sival_int;
+} //on_timer
+
+static void on_usr2( int sig )
+{
+    char c;
+    on_alt_stack = ( &c >= alt_stack && &c < alt_stack + sizeof( alt_stack ) );
+} //on_usr2
+
+int main( int argc, char * argv[] )
+{
+    signal( SIGALRM, on_alarm );
+    struct itimerval real = { { 0, 0 }, { 0, 10000 } };
+    setitimer( ITIMER_REAL, &real, 0 );
+    pause();
+    printf( "pause returned after SIGALRM, alarms %d\n", alarms );
+
+    struct sigaction sa;
+    memset( &sa, 0, sizeof( sa ) );
+    sa.sa_sigaction = on_usr1;
+    sa.sa_flags = SA_SIGINFO;
+    sigaction( SIGUSR1, &sa, 0 );
+
+    double x = 1.25;
+    raise( SIGUSR1 );
+    raise( SIGUSR1 );
+    printf( "SIGUSR1 delivered %d times, si_code is SI_TKILL: %d, x * 2 = %g\n", usrs, SI_TKILL == usr_code, x * 2 );
+
+    sigset_t mask, pending;
+    sigemptyset( &mask );
+    sigaddset( &mask, SIGUSR1 );
+    sigprocmask( SIG_BLOCK, &mask, 0 );
+    raise( SIGUSR1 );
+    sigpending( &pending );
+    printf( "blocked SIGUSR1 is pending: %d, delivered %d times\n", sigismember( &pending, SIGUSR1 ), usrs );
+    sigprocmask( SIG_UNBLOCK, &mask, 0 );
+    printf( "after unblocking, delivered %d times\n", usrs );
+
+    signal( SIGPROF, on_prof );
+    struct itimerval prof = { { 0, 1000 }, { 0, 1000 } };
+    setitimer( ITIMER_PROF, &prof, 0 );
+    volatile uint64_t sum = 0;
+    for ( uint64_t i = 0; i < 100000000 && profs < 5; i++ )
+        sum += i;
+    struct itimerval off = {};
+    setitimer( ITIMER_PROF, &off, 0 );
+    printf( "ITIMER_PROF fired at least 5 times: %d\n", profs >= 5 );
+
+    sa.sa_sigaction = on_timer;
+    sigaction( SIGRTMIN + 1, &sa, 0 );
+    struct sigevent ev;
+    memset( &ev, 0, sizeof( ev ) );
+    ev.sigev_notify = SIGEV_SIGNAL;
+    ev.sigev_signo = SIGRTMIN + 1;
+    ev.sigev_value.sival_int = 42;
+    timer_t timer;
+    timer_create( CLOCK_MONOTONIC, &ev, &timer );
+    struct itimerspec its = { { 0, 0 }, { 0, 20000000 } };
+    timer_settime( timer, 0, &its, 0 );
+
+    struct timespec request = { 2, 0 }, remain = { 0, 0 };
+    int result = nanosleep( &request, &remain );
+    printf( "nanosleep interrupted by the timer: %d errno %d, more than 1 second remains: %d\n", result, errno, remain.tv_sec >= 1 );
+    printf( "timer signals %d, value %d\n", timers, timer_value );
+    timer_delete( timer );
+
+    stack_t ss = {};
+    ss.ss_sp = alt_stack;
+    ss.ss_size = sizeof( alt_stack );
+    sigaltstack( &ss, 0 );
+    sa.sa_handler = on_usr2;
+    sa.sa_flags = SA_ONSTACK;
+    sigaction( SIGUSR2, &sa, 0 );
+    raise( SIGUSR2 );
+    printf( "SIGUSR2 ran on the alternate stack: %d\n", on_alt_stack );
+
+    signal( SIGTERM, SIG_IGN );
+    raise( SIGTERM );
+    printf( "ignored SIGTERM\n" );
+
+    printf( "tsignal completed with great success\n" );
+    return 0;
+} //main
@@ -0,0 +1,152 @@
+// test the in-memory file system overlay. runall.sh runs it with -o:/tvfs=c_tests/tvfs_data, which mounts the overlay
+// at /tvfs preloaded with c_tests/tvfs_data, and again with -d added so writes are discarded. nothing touches the host.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+static const char * mount = "/tvfs";
+
+static void show_file( const char * name )
+{
+    char path[ 256 ];
+    snprintf( path, sizeof( path ), "%s/%s", mount, name );
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 )
+    {
+        printf( "  open %s failed, errno %d\n", name, errno );
+        return;
+    }
+
+    char buf[ 128 ];
+    ssize_t n = read( fd, buf, sizeof( buf ) - 1 );
+    buf[ ( n < 0 ) ? 0 : n ] = 0;
+    close( fd );
+    printf( "  %s has %d bytes: %s", name, (int) n, buf );
+    if ( 0 == n || '\n' != buf[ n - 1 ] )
+        printf( "\n" );
+} //show_file
+
+static void show_folder( const char * name )
+{
+    char path[ 256 ];
+    snprintf( path, sizeof( path ), "%s%s%s", mount, name[ 0 ] ? "/" : "", name );
+    DIR * pdir = opendir( path );
+    if ( !pdir )
+    {
+        printf( "  opendir %s failed, errno %d\n", path, errno );
+        return;
+    }
+
+    vector<string> entries;
+    struct dirent * pe;
+    while ( ( pe = readdir( pdir ) ) )
+        entries.push_back( string( pe->d_name ) + ( ( DT_DIR == pe->d_type ) ? "/" : "" ) );
+    closedir( pdir );
+
+    sort( entries.begin(), entries.end() );
+    printf( "  %s:", path );
+    for ( size_t i = 0; i < entries.size(); i++ )
+        printf( " %s", entries[ i ].c_str() );
+    printf( "\n" );
+} //show_folder
+
+int main( int argc, char * argv[] )
+{
+    printf( "preloaded files\n" );
+    show_folder( "" );
+    show_file( "hello.txt" );
+    show_file( "deep/nested.txt" );
+
+    printf( "writes\n" );
+    char path[ 256 ], path2[ 256 ];
+    snprintf( path, sizeof( path ), "%s/out.txt", mount );
+    FILE * fp = fopen( path, "w" );
+    if ( !fp )
+    {
+        printf( "can't create %s, errno %d\n", path, errno );
+        exit( 1 );
+    }
+    for ( int i = 0; i < 1000; i++ )
+        fprintf( fp, "line %d\n", i );
+    fclose( fp );
+
+    struct stat st;
+    int result = stat( path, &st );
+    printf( "  stat %d, size %lld, regular %d\n", result, (long long) st.st_size, S_ISREG( st.st_mode ) );
+
+    fp = fopen( path, "r" );
+    char line[ 64 ] = {0};
+    int lines = 0;
+    while ( fgets( line, sizeof( line ), fp ) )
+        lines++;
+    printf( "  read %d lines\n", lines );
+    fseek( fp, -9, SEEK_END );
+    if ( fgets( line, sizeof( line ), fp ) )
+        printf( "  the last 9 bytes are %s", line );
+    fclose( fp );
+
+    fp = fopen( path, "a" );
+    fprintf( fp, "appended\n" );
+    fclose( fp );
+    stat( path, &st );
+    printf( "  size after append %lld\n", (long long) st.st_size );
+
+    printf( "folders\n" );
+    snprintf( path, sizeof( path ), "%s/sub", mount );
+    printf( "  mkdir %d\n", mkdir( path, 0755 ) );
+    result = mkdir( path, 0755 );
+    printf( "  mkdir again %d errno %d\n", result, errno );
+
+    snprintf( path, sizeof( path ), "%s/sub/a.txt", mount );
+    int fd = open( path, O_CREAT | O_WRONLY | O_TRUNC, 0644 );
+    printf( "  write %d\n", (int) write( fd, "abc", 3 ) );
+    close( fd );
+
+    snprintf( path2, sizeof( path2 ), "%s/sub/b.txt", mount );
+    printf( "  rename %d\n", rename( path, path2 ) );
+    printf( "  access a.txt %d\n", access( path, F_OK ) );
+    printf( "  access b.txt %d\n", access( path2, F_OK ) );
+    show_file( "sub/b.txt" );
+
+    snprintf( path, sizeof( path ), "%s/sub", mount );
+    result = rmdir( path );
+    printf( "  rmdir of a folder that isn't empty %d errno %d\n", result, errno );
+    show_folder( "" );
+    show_folder( "sub" );
+
+    printf( "current directory\n" );
+    char cwd_original[ 256 ], cwd[ 256 ];
+    if ( !getcwd( cwd_original, sizeof( cwd_original ) ) )
+        exit( 1 );
+    printf( "  chdir %d\n", chdir( path ) );
+    printf( "  getcwd %s\n", getcwd( cwd, sizeof( cwd ) ) ? cwd : "failed" );
+    printf( "  relative access b.txt %d\n", access( "b.txt", F_OK ) );
+    printf( "  chdir back %d\n", chdir( cwd_original ) );
+
+    printf( "removal\n" );
+    result = unlink( path2 );
+    printf( "  unlink %d\n", result );
+    result = rmdir( path );
+    printf( "  rmdir %d\n", result );
+    snprintf( path, sizeof( path ), "%s/out.txt", mount );
+    printf( "  unlink %d\n", unlink( path ) );
+    result = open( path, O_RDONLY );
+    printf( "  open after unlink %d errno %d\n", result, errno );
+    show_folder( "" );
+
+    printf( "tvfs completed with great success\n" );
+    return 0;
+} //main
@@ -0,0 +1,867 @@
+#pragma once
+
+// CDwarf maps code addresses in an ELF image to source file:line and inlined-function frames using the image's
+// DWARF 2 through 5 debug information: .debug_line, .debug_info, .debug_abbrev, .debug_str, .debug_line_str,
+// .debug_ranges, and .debug_rnglists. The loader notes where each section is with add_section(), and nothing is read
+// or parsed until the first lookup, so apps that aren't traced or symbolized pay nothing.
+//    CDwarf dwarf;
+//    dwarf.set_image( "app" );
+//    dwarf.add_section( ".debug_line", offset, size ); // for each section in the image
+//    const char * pfile; uint32_t line;
+//    if ( dwarf.lookup_line( address, pfile, line ) ) ...
+// Split DWARF (.dwo files and the indexed forms that refer to them) isn't supported; those units are skipped.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+class CDwarf
+{
+    public:
+        struct InlineFrame
+        {
+            const char * name;        // the inlined function
+            const char * call_file;   // where it was inlined
+            uint32_t call_line;
+        };
+
+    private:
+        enum { secLine, secInfo, secAbbrev, secStr, secLineStr, secRanges, secRngLists, secMax };
+
+        struct LineRow
+        {
+            uint64_t address;
+            uint32_t line;
+            uint32_t file;            // index into files. endSequence marks the first address past a sequence
+        };
+
+        static const uint32_t endSequence = 0xffffffff;
+
+        struct InlineRange
+        {
+            uint64_t low;
+            uint64_t high;            // one past the end
+            uint64_t max_high;        // the largest high of this and all earlier ranges once sorted, to bound lookups
+            uint64_t origin;          // .debug_info offset of the inlined function's abstract DIE
+            uint32_t depth;           // nesting among inlined subroutines. deeper is more inner
+            uint32_t call_file;
+            uint32_t call_line;
+        };
+
+        struct LineTable               // the files of one line program, for DW_AT_call_file
+        {
+            uint32_t first;            // index in files of the table's first file
+            uint32_t count;
+            bool zero_based;           // DWARF 5 numbers files from 0, earlier versions from 1
+        };
+
+        struct Subprogram
+        {
+            const char * name;
+            uint64_t ref;              // DW_AT_specification or DW_AT_abstract_origin that has the name, or 0
+        };
+
+        struct Reader
+        {
+            const uint8_t * p;
+            const uint8_t * end;
+            bool ok;
+
+            Reader( const uint8_t * start, size_t size ) : p( start ), end( start + size ), ok( true ) {}
+
+            bool has( size_t n ) { if ( (size_t) ( end - p ) < n ) { ok = false; p = end; return false; } return true; }
+            uint8_t u8() { if ( !has( 1 ) ) return 0; return *p++; }
+            uint16_t u16() { if ( !has( 2 ) ) return 0; uint16_t v; memcpy( &v, p, 2 ); p += 2; return v; }
+            uint32_t u32() { if ( !has( 4 ) ) return 0; uint32_t v; memcpy( &v, p, 4 ); p += 4; return v; }
+            uint64_t u64() { if ( !has( 8 ) ) return 0; uint64_t v; memcpy( &v, p, 8 ); p += 8; return v; }
+            uint64_t sized( size_t n ) { return ( 1 == n ) ? u8() : ( 2 == n ) ? u16() : ( 4 == n ) ? u32() : ( 8 == n ) ? u64() : ( skip( n ), 0 ); }
+            void skip( uint64_t n ) { if ( has( (size_t) n ) ) p += n; }
+
+            uint64_t uleb()
+            {
+                uint64_t v = 0;
+                for ( uint32_t shift = 0; has( 1 ); shift += 7 )
+                {
+                    uint8_t b = *p++;
+                    if ( shift < 64 )
+                        v |= (uint64_t) ( b & 0x7f ) << shift;
+                    if ( 0 == ( b & 0x80 ) )
+                        break;
+                }
+                return v;
+            } //uleb
+
+            int64_t sleb()
+            {
+                uint64_t v = 0;
+                uint32_t shift = 0;
+                uint8_t b = 0;
+                while ( has( 1 ) )
+                {
+                    b = *p++;
+                    if ( shift < 64 )
+                        v |= (uint64_t) ( b & 0x7f ) << shift;
+                    shift += 7;
+                    if ( 0 == ( b & 0x80 ) )
+                        break;
+                }
+                if ( ( shift < 64 ) && ( b & 0x40 ) )
+                    v |= ~0ull << shift;
+                return (int64_t) v;
+            } //sleb
+
+            const char * str()
+            {
+                const uint8_t * s = p;
+                while ( p < end && 0 != *p )
+                    p++;
+                if ( p >= end )
+                {
+                    ok = false;
+                    return "";
+                }
+                p++;
+                return (const char *) s;
+            } //str
+
+            uint64_t unit_length( bool & is64 ) // returns the unit's length and whether it uses 64-bit DWARF offsets
+            {
+                uint64_t length = u32();
+                is64 = ( 0xffffffff == length );
+                if ( is64 )
+                    length = u64();
+                return length;
+            } //unit_length
+        };
+
+        string image;
+        uint64_t section_offset[ secMax ];
+        uint64_t section_size[ secMax ];
+        vector<uint8_t> sections[ secMax ];
+        bool parsed;
+
+        vector<string> files;
+        vector<LineRow> rows;                   // sorted by address
+        map<uint64_t, LineTable> line_tables;   // by .debug_line offset
+        vector<InlineRange> inlines;            // sorted by low
+        map<uint64_t, Subprogram> subprograms;  // by .debug_info offset
+
+        const char * section_string( int s, uint64_t offset )
+        {
+            if ( offset >= sections[ s ].size() || 0 == memchr( sections[ s ].data() + offset, 0, sections[ s ].size() - offset ) )
+                return "";
+            return (const char *) sections[ s ].data() + offset;
+        } //section_string
+
+        const char * form_string( Reader & r, uint64_t form, bool is64 )
+        {
+            if ( 0x08 == form )                                 // DW_FORM_string
+                return r.str();
+            if ( 0x0e == form )                                 // DW_FORM_strp
+                return section_string( secStr, is64 ? r.u64() : r.u32() );
+            if ( 0x1f == form )                                 // DW_FORM_line_strp
+                return section_string( secLineStr, is64 ? r.u64() : r.u32() );
+            return 0;
+        } //form_string
+
+        static bool skip_form( Reader & r, uint64_t form, uint8_t address_size, bool is64, uint16_t version )
+        {
+            // false for forms that aren't understood, since the rest of the unit can't be walked
+
+            size_t offset_size = is64 ? 8 : 4;
+            switch ( form )
+            {
+                case 0x01: r.skip( address_size ); break;                            // addr
+                case 0x03: r.skip( r.u16() ); break;                                 // block2
+                case 0x04: r.skip( r.u32() ); break;                                 // block4
+                case 0x05: case 0x12: r.skip( 2 ); break;                            // data2, ref2
+                case 0x06: case 0x13: case 0x1c: r.skip( 4 ); break;                 // data4, ref4, ref_sup4
+                case 0x07: case 0x14: case 0x20: case 0x24: r.skip( 8 ); break;      // data8, ref8, ref_sig8, ref_sup8
+                case 0x08: r.str(); break;                                           // string
+                case 0x09: case 0x18: r.skip( r.uleb() ); break;                     // block, exprloc
+                case 0x0a: r.skip( r.u8() ); break;                                  // block1
+                case 0x0b: case 0x0c: case 0x11: case 0x25: case 0x29: r.skip( 1 ); break; // data1, flag, ref1, strx1, addrx1
+                case 0x0d: r.sleb(); break;                                          // sdata
+                case 0x0e: case 0x17: case 0x1d: case 0x1f: r.skip( offset_size ); break; // strp, sec_offset, strp_sup, line_strp
+                case 0x0f: case 0x15: case 0x1a: case 0x1b: case 0x22: case 0x23: r.uleb(); break; // udata, ref_udata, strx, addrx, loclistx, rnglistx
+                case 0x10: r.skip( ( version <= 2 ) ? address_size : offset_size ); break; // ref_addr
+                case 0x16: return skip_form( r, r.uleb(), address_size, is64, version ); // indirect
+                case 0x19: case 0x21: break;                                         // flag_present, implicit_const
+                case 0x1e: r.skip( 16 ); break;                                      // data16
+                case 0x26: case 0x2a: r.skip( 2 ); break;                            // strx2, addrx2
+                case 0x27: case 0x2b: r.skip( 3 ); break;                            // strx3, addrx3
+                case 0x28: case 0x2c: r.skip( 4 ); break;                            // strx4, addrx4
+                case 0x1f01: case 0x1f02: r.uleb(); break;                           // GNU_addr_index, GNU_str_index
+                case 0x1f20: case 0x1f21: r.skip( offset_size ); break;              // GNU_ref_alt, GNU_strp_alt
+                default: return false;
+            }
+            return r.ok;
+        } //skip_form
+
+        static bool read_constant( Reader & r, uint64_t form, int64_t implicit_const, uint64_t & value )
+        {
+            switch ( form )
+            {
+                case 0x0b: value = r.u8(); return true;
+                case 0x05: value = r.u16(); return true;
+                case 0x06: value = r.u32(); return true;
+                case 0x07: value = r.u64(); return true;
+                case 0x0f: value = r.uleb(); return true;
+                case 0x0d: value = (uint64_t) r.sleb(); return true;
+                case 0x21: value = (uint64_t) implicit_const; return true;
+                default: return false;
+            }
+        } //read_constant
+
+        bool read_file( FILE * fp, int s )
+        {
+            if ( 0 == section_size[ s ] )
+                return true;
+
+            sections[ s ].resize( (size_t) section_size[ s ] );
+            return ( 0 == fseek( fp, (long) section_offset[ s ], SEEK_SET ) ) && ( 1 == fread( sections[ s ].data(), (size_t) section_size[ s ], 1, fp ) );
+        } //read_file
+
+        void parse_line_program( Reader & r, uint64_t table_offset )
+        {
+            bool is64;
+            uint64_t length = r.unit_length( is64 );
+            if ( !r.has( (size_t) length ) )
+                return;
+
+            Reader unit( r.p, (size_t) length );
+            r.p += length;
+
+            uint16_t version = unit.u16();
+            if ( version < 2 || version > 5 )
+                return;
+
+            uint8_t address_size = 8;
+            if ( version >= 5 )
+            {
+                address_size = unit.u8();
+                unit.u8();                                      // segment selector size
+            }
+
+            uint64_t header_length = is64 ? unit.u64() : unit.u32();
+            if ( !unit.has( (size_t) header_length ) )
+                return;
+            const uint8_t * program = unit.p + header_length;
+
+            uint8_t min_instruction_length = unit.u8();
+            if ( version >= 4 )
+                unit.u8();                                      // maximum operations per instruction. only VLIW uses it
+            unit.u8();                                          // default_is_stmt. every row is kept
+            int8_t line_base = (int8_t) unit.u8();
+            uint8_t line_range = unit.u8();
+            uint8_t opcode_base = unit.u8();
+            if ( 0 == line_range || 0 == opcode_base )
+                return;
+
+            uint8_t standard_lengths[ 256 ] = { 0 };
+            for ( uint32_t i = 1; i < opcode_base; i++ )
+                standard_lengths[ i ] = unit.u8();
+
+            // the file table. directories are prepended unless they're the compilation directory, to keep names short
+
+            vector<const char *> directories;
+            LineTable table;
+            table.first = (uint32_t) files.size();
+            table.zero_based = ( version >= 5 );
+
+            if ( version >= 5 )
+            {
+                for ( int list = 0; list < 2 && unit.ok; list++ ) // directories, then files
+                {
+                    uint8_t format_count = unit.u8();
+                    uint64_t formats[ 256 ][ 2 ];
+                    for ( uint32_t f = 0; f < format_count; f++ )
+                    {
+                        formats[ f ][ 0 ] = unit.uleb();        // content type
+                        formats[ f ][ 1 ] = unit.uleb();        // form
+                    }
+
+                    uint64_t count = unit.uleb();
+                    for ( uint64_t e = 0; e < count && unit.ok; e++ )
+                    {
+                        const char * path = "";
+                        uint64_t directory = 0;
+                        for ( uint32_t f = 0; f < format_count; f++ )
+                        {
+                            if ( 1 == formats[ f ][ 0 ] )      // DW_LNCT_path
+                            {
+                                const char * s = form_string( unit, formats[ f ][ 1 ], is64 );
+                                if ( 0 == s )
+                                    return;
+                                path = s;
+                            }
+                            else if ( 2 == formats[ f ][ 0 ] && read_constant( unit, formats[ f ][ 1 ], 0, directory ) ) // DW_LNCT_directory_index
+                                continue;
+                            else if ( !skip_form( unit, formats[ f ][ 1 ], address_size, is64, version ) )
+                                return;
+                        }
+
+                        if ( 0 == list )
+                            directories.push_back( path );
+                        else
+                            add_file( directories, directory, path ); // directory 0 is the compilation directory
+                    }
+                }
+            }
+            else
+            {
+                directories.push_back( "" );                    // 0 is the compilation directory
+                for ( ;; )
+                {
+                    const char * d = unit.str();
+                    if ( !unit.ok || 0 == d[ 0 ] )
+                        break;
+                    directories.push_back( d );
+                }
+
+                for ( ;; )
+                {
+                    const char * name = unit.str();
+                    if ( !unit.ok || 0 == name[ 0 ] )
+                        break;
+                    uint64_t directory = unit.uleb();
+                    unit.uleb();                                // modification time
+                    unit.uleb();                                // length
+                    add_file( directories, directory, name );
+                }
+            }
+
+            table.count = (uint32_t) files.size() - table.first;
+            line_tables[ table_offset ] = table;
+            if ( !unit.ok || program > unit.end )
+                return;
+
+            // run the line number program
+
+            unit.p = program;
+            uint64_t address = 0;
+            uint64_t file = 1;
+            int64_t line = 1;
+            size_t sequence_start = rows.size();
+
+            while ( unit.ok && unit.p < unit.end )
+            {
+                uint8_t op = unit.u8();
+                bool emit = false;
+
+                if ( op >= opcode_base )                        // special opcode
+                {
+                    uint8_t adjusted = op - opcode_base;
+                    address += ( adjusted / line_range ) * min_instruction_length;
+                    line += line_base + ( adjusted % line_range );
+                    emit = true;
+                }
+                else if ( 0 == op )                             // extended opcode
+                {
+                    uint64_t len = unit.uleb();
+                    if ( 0 == len || !unit.has( (size_t) len ) )
+                        break;
+                    const uint8_t * next = unit.p + len;
+                    uint8_t sub = unit.u8();
+                    if ( 1 == sub )                             // DW_LNE_end_sequence
+                    {
+                        while ( rows.size() > sequence_start && rows.back().address >= address ) // rows at the end describe no code
+                            rows.pop_back();
+                        add_row( address, endSequence, 0 );
+                        if ( 0 == rows[ sequence_start ].address ) // code the linker discarded
+                            rows.resize( sequence_start );
+                        sequence_start = rows.size();
+                        address = 0;
+                        file = 1;
+                        line = 1;
+                    }
+                    else if ( 2 == sub )                        // DW_LNE_set_address
+                        address = unit.sized( (size_t) ( len - 1 ) );
+                    unit.p = next;                              // DW_LNE_define_file and set_discriminator aren't needed
+                }
+                else if ( 1 == op )                             // DW_LNS_copy
+                    emit = true;
+                else if ( 2 == op )                             // DW_LNS_advance_pc
+                    address += unit.uleb() * min_instruction_length;
+                else if ( 3 == op )                             // DW_LNS_advance_line
+                    line += unit.sleb();
+                else if ( 4 == op )                             // DW_LNS_set_file
+                    file = unit.uleb();
+                else if ( 8 == op )                             // DW_LNS_const_add_pc
+                    address += ( ( 255 - opcode_base ) / line_range ) * min_instruction_length;
+                else if ( 9 == op )                             // DW_LNS_fixed_advance_pc
+                    address += unit.u16();
+                else                                            // set_column, negate_stmt, and others only have uleb arguments
+                {
+                    for ( uint32_t a = 0; a < standard_lengths[ op ]; a++ )
+                        unit.uleb();
+                }
+
+                if ( emit )
+                {
+                    uint64_t index = table.zero_based ? file : file - 1;
+                    add_row( address, (uint32_t) line, ( index < table.count ) ? table.first + (uint32_t) index : endSequence - 1 );
+                }
+            }
+        } //parse_line_program
+
+        void add_file( vector<const char *> & directories, uint64_t directory, const char * name )
+        {
+            string path;
+            if ( '/' != name[ 0 ] && directory > 0 && directory < directories.size() && 0 != directories[ (size_t) directory ][ 0 ] )
+            {
+                path = directories[ (size_t) directory ];
+                path += '/';
+            }
+            path += name;
+            files.push_back( path );
+        } //add_file
+
+        void add_row( uint64_t address, uint32_t line, uint32_t file )
+        {
+            LineRow row = { address, line, file };
+            rows.push_back( row );
+        } //add_row
+
+        struct Abbrev
+        {
+            uint64_t tag;
+            bool children;
+            size_t first;             // index in abbrev_specs
+            size_t count;
+        };
+
+        struct AttrSpec
+        {
+            uint64_t name;
+            uint64_t form;
+            int64_t implicit_const;
+        };
+
+        bool parse_abbrevs( uint64_t offset, map<uint64_t, Abbrev> & abbrevs, vector<AttrSpec> & specs )
+        {
+            if ( offset >= sections[ secAbbrev ].size() )
+                return false;
+
+            Reader r( sections[ secAbbrev ].data() + offset, sections[ secAbbrev ].size() - (size_t) offset );
+            for ( ;; )
+            {
+                uint64_t code = r.uleb();
+                if ( 0 == code || !r.ok )
+                    break;
+
+                Abbrev a;
+                a.tag = r.uleb();
+                a.children = ( 0 != r.u8() );
+                a.first = specs.size();
+                for ( ;; )
+                {
+                    AttrSpec s;
+                    s.name = r.uleb();
+                    s.form = r.uleb();
+                    s.implicit_const = ( 0x21 == s.form ) ? r.sleb() : 0;
+                    if ( ( 0 == s.name && 0 == s.form ) || !r.ok )
+                        break;
+                    specs.push_back( s );
+                }
+                a.count = specs.size() - a.first;
+                abbrevs[ code ] = a;
+            }
+
+            return r.ok;
+        } //parse_abbrevs
+
+        void add_ranges( uint64_t ranges, bool rnglists, uint8_t address_size, uint64_t base, InlineRange range )
+        {
+            // DWARF 5 .debug_rnglists entries or DWARF 2..4 .debug_ranges pairs
+
+            int s = rnglists ? secRngLists : secRanges;
+            if ( ranges >= sections[ s ].size() )
+                return;
+
+            Reader r( sections[ s ].data() + ranges, sections[ s ].size() - (size_t) ranges );
+            uint64_t all_ones = ( 4 == address_size ) ? 0xffffffff : ~0ull;
+
+            while ( r.ok )
+            {
+                uint64_t low, high;
+                if ( rnglists )
+                {
+                    uint8_t kind = r.u8();
+                    if ( 0 == kind )                            // DW_RLE_end_of_list
+                        break;
+                    else if ( 4 == kind )                       // DW_RLE_offset_pair
+                    {
+                        low = base + r.uleb();
+                        high = base + r.uleb();
+                    }
+                    else if ( 5 == kind )                       // DW_RLE_base_address
+                    {
+                        base = r.sized( address_size );
+                        continue;
+                    }
+                    else if ( 6 == kind )                       // DW_RLE_start_end
+                    {
+                        low = r.sized( address_size );
+                        high = r.sized( address_size );
+                    }
+                    else if ( 7 == kind )                       // DW_RLE_start_length
+                    {
+                        low = r.sized( address_size );
+                        high = low + r.uleb();
+                    }
+                    else                                        // the indexed kinds need .debug_addr
+                        break;
+                }
+                else
+                {
+                    low = r.sized( address_size );
+                    high = r.sized( address_size );
+                    if ( 0 == low && 0 == high )
+                        break;
+                    if ( all_ones == low )                      // base address selection
+                    {
+                        base = high;
+                        continue;
+                    }
+                    low += base;
+                    high += base;
+                }
+
+                if ( r.ok && low < high && 0 != low )
+                {
+                    range.low = low;
+                    range.high = high;
+                    inlines.push_back( range );
+                }
+            }
+        } //add_ranges
+
+        void parse_unit( Reader & r )
+        {
+            // walk one unit's DIEs, noting subprogram names and the address ranges of inlined subroutines
+
+            uint64_t unit_offset = (uint64_t) ( r.p - sections[ secInfo ].data() );
+            bool is64;
+            uint64_t length = r.unit_length( is64 );
+            if ( !r.has( (size_t) length ) )
+                return;
+
+            Reader unit( r.p, (size_t) length );
+            r.p += length;
+
+            uint16_t version = unit.u16();
+            if ( version < 2 || version > 5 )
+                return;
+
+            uint8_t unit_type = 1;                              // DW_UT_compile
+            uint8_t address_size;
+            uint64_t abbrev_offset;
+            if ( version >= 5 )
+            {
+                unit_type = unit.u8();
+                address_size = unit.u8();
+                abbrev_offset = is64 ? unit.u64() : unit.u32();
+                if ( 1 != unit_type && 3 != unit_type )         // only full and partial units describe code here
+                    return;
+            }
+            else
+            {
+                abbrev_offset = is64 ? unit.u64() : unit.u32();
+                address_size = unit.u8();
+            }
+
+            map<uint64_t, Abbrev> abbrevs;
+            vector<AttrSpec> specs;
+            if ( !parse_abbrevs( abbrev_offset, abbrevs, specs ) )
+                return;
+
+            uint64_t unit_base = 0;                             // the unit's DW_AT_low_pc, the base for its ranges
+            const LineTable * table = 0;
+            uint32_t depth = 0;                                 // of the DIE being read
+            vector<uint32_t> inline_depths;                     // inlined subroutines enclosing each open level
+            inline_depths.push_back( 0 );
+
+            while ( unit.ok && unit.p < unit.end )
+            {
+                uint64_t die_offset = (uint64_t) ( unit.p - sections[ secInfo ].data() );
+                uint64_t code = unit.uleb();
+                if ( 0 == code )                                // end of a sibling list
+                {
+                    if ( 0 == depth )
+                        break;
+                    depth--;
+                    inline_depths.pop_back();
+                    continue;
+                }
+
+                map<uint64_t, Abbrev>::iterator it = abbrevs.find( code );
+                if ( it == abbrevs.end() )
+                    return;
+                Abbrev & a = it->second;
+
+                const char * name = 0;
+                uint64_t ref = 0, low_pc = 0, high_pc = 0, ranges = ~0ull, call_file = 0, call_line = 0, stmt_list = ~0ull;
+                bool high_is_offset = false, has_low = false, has_high = false;
+
+                for ( size_t i = 0; i < a.count; i++ )
+                {
+                    AttrSpec & s = specs[ a.first + i ];
+                    uint64_t value = 0;
+
+                    if ( 0x03 == s.name && ( 0x08 == s.form || 0x0e == s.form || 0x1f == s.form ) ) // DW_AT_name
+                        name = form_string( unit, s.form, is64 );
+                    else if ( ( 0x31 == s.name || 0x47 == s.name ) && s.form >= 0x11 && s.form <= 0x15 ) // abstract_origin, specification. ref1..ref_udata
+                    {
+                        ref = ( 0x15 == s.form ) ? unit.uleb() : unit.sized( (size_t) 1 << ( s.form - 0x11 ) );
+                        ref += unit_offset;
+                    }
+                    else if ( ( 0x31 == s.name || 0x47 == s.name ) && 0x10 == s.form ) // ref_addr
+                        ref = unit.sized( ( version <= 2 ) ? address_size : is64 ? 8 : 4 );
+                    else if ( 0x11 == s.name && 0x01 == s.form ) // DW_AT_low_pc
+                    {
+                        low_pc = unit.sized( address_size );
+                        has_low = true;
+                    }
+                    else if ( 0x12 == s.name && 0x01 == s.form ) // DW_AT_high_pc as an address
+                    {
+                        high_pc = unit.sized( address_size );
+                        has_high = true;
+                    }
+                    else if ( 0x12 == s.name && read_constant( unit, s.form, s.implicit_const, value ) ) // DW_AT_high_pc as a length
+                    {
+                        high_pc = value;
+                        has_high = high_is_offset = true;
+                    }
+                    else if ( 0x55 == s.name && 0x17 == s.form ) // DW_AT_ranges as a section offset
+                        ranges = is64 ? unit.u64() : unit.u32();
+                    else if ( 0x55 == s.name && 0x06 == s.form && version < 4 )
+                        ranges = unit.u32();
+                    else if ( 0x10 == s.name && ( 0x17 == s.form || 0x06 == s.form || 0x07 == s.form ) ) // DW_AT_stmt_list
+                        stmt_list = ( 0x07 == s.form || ( 0x17 == s.form && is64 ) ) ? unit.u64() : unit.u32();
+                    else if ( 0x58 == s.name && read_constant( unit, s.form, s.implicit_const, value ) ) // DW_AT_call_file
+                        call_file = value;
+                    else if ( 0x59 == s.name && read_constant( unit, s.form, s.implicit_const, value ) ) // DW_AT_call_line
+                        call_line = value;
+                    else if ( !skip_form( unit, s.form, address_size, is64, version ) )
+                        return;
+                }
+
+                if ( !unit.ok )
+                    return;
+
+                if ( has_high && high_is_offset )
+                    high_pc += low_pc;
+
+                uint32_t inline_depth = inline_depths.back();
+
+                if ( 0 == depth )                               // the unit's DIE
+                {
+                    if ( has_low )
+                        unit_base = low_pc;
+                    map<uint64_t, LineTable>::iterator lt = line_tables.find( stmt_list );
+                    if ( lt != line_tables.end() )
+                        table = & lt->second;
+                }
+                else if ( 0x2e == a.tag && ( 0 != name || 0 != ref ) ) // DW_TAG_subprogram
+                {
+                    Subprogram sp = { name, name ? 0 : ref };
+                    subprograms[ die_offset ] = sp;
+                }
+                else if ( 0x1d == a.tag && 0 != ref )           // DW_TAG_inlined_subroutine
+                {
+                    inline_depth++;
+
+                    InlineRange range;
+                    range.origin = ref;
+                    range.depth = inline_depth;
+                    range.call_line = (uint32_t) call_line;
+                    range.call_file = endSequence - 1;
+                    if ( table )
+                    {
+                        uint64_t index = table->zero_based ? call_file : call_file - 1;
+                        if ( index < table->count )
+                            range.call_file = table->first + (uint32_t) index;
+                    }
+
+                    if ( has_low && has_high && low_pc < high_pc && 0 != low_pc )
+                    {
+                        range.low = low_pc;
+                        range.high = high_pc;
+                        inlines.push_back( range );
+                    }
+                    else if ( ~0ull != ranges )
+                        add_ranges( ranges, version >= 5, address_size, unit_base, range );
+                }
+
+                if ( a.children )
+                {
+                    depth++;
+                    inline_depths.push_back( inline_depth );
+                }
+            }
+        } //parse_unit
+
+        void parse()
+        {
+            parsed = true;
+            FILE * fp = image.empty() ? 0 : fopen( image.c_str(), "rb" );
+            if ( !fp )
+                return;
+
+            bool ok = true;
+            for ( int s = 0; s < secMax; s++ )
+                ok = ok && read_file( fp, s );
+            fclose( fp );
+            if ( !ok )
+                return;
+
+            Reader lines( sections[ secLine ].data(), sections[ secLine ].size() );
+            while ( lines.ok && lines.p < lines.end )
+                parse_line_program( lines, (uint64_t) ( lines.p - sections[ secLine ].data() ) );
+
+            // where one sequence ends and another starts at the same address, the end must sort first
+
+            stable_sort( rows.begin(), rows.end(), []( const LineRow & a, const LineRow & b )
+                         { return ( a.address < b.address ) || ( a.address == b.address && endSequence == a.line && endSequence != b.line ); } );
+
+            Reader info( sections[ secInfo ].data(), sections[ secInfo ].size() );
+            while ( info.ok && info.p < info.end )
+                parse_unit( info );
+
+            stable_sort( inlines.begin(), inlines.end(), []( const InlineRange & a, const InlineRange & b ) { return a.low < b.low; } );
+            uint64_t max_high = 0;
+            for ( size_t i = 0; i < inlines.size(); i++ )
+            {
+                max_high = ( inlines[ i ].high > max_high ) ? inlines[ i ].high : max_high;
+                inlines[ i ].max_high = max_high;
+            }
+
+            // the raw sections aren't needed once indexed, except for the strings names point into
+
+            sections[ secLine ].clear();
+            sections[ secLine ].shrink_to_fit();
+            sections[ secAbbrev ].clear();
+            sections[ secAbbrev ].shrink_to_fit();
+            sections[ secRanges ].clear();
+            sections[ secRanges ].shrink_to_fit();
+            sections[ secRngLists ].clear();
+            sections[ secRngLists ].shrink_to_fit();
+        } //parse
+
+        const char * subprogram_name( uint64_t offset )
+        {
+            for ( int hops = 0; hops < 8; hops++ ) // follow abstract_origin and specification to the DIE with the name
+            {
+                map<uint64_t, Subprogram>::iterator it = subprograms.find( offset );
+                if ( it == subprograms.end() )
+                    return "?";
+                if ( it->second.name )
+                    return it->second.name;
+                offset = it->second.ref;
+            }
+            return "?";
+        } //subprogram_name
+
+        const char * file_name( uint32_t file )
+        {
+            return ( file < files.size() ) ? files[ file ].c_str() : "?";
+        } //file_name
+
+    public:
+        CDwarf() : parsed( false )
+        {
+            memset( section_offset, 0, sizeof( section_offset ) );
+            memset( section_size, 0, sizeof( section_size ) );
+        } //CDwarf
+
+        void set_image( const char * path ) // the ELF file the sections are read from on first use. forgets any earlier image
+        {
+            image = path ? path : "";
+            parsed = false;
+            memset( section_offset, 0, sizeof( section_offset ) );
+            memset( section_size, 0, sizeof( section_size ) );
+            for ( int s = 0; s < secMax; s++ )
+                sections[ s ].clear();
+            files.clear();
+            rows.clear();
+            line_tables.clear();
+            inlines.clear();
+            subprograms.clear();
+        } //set_image
+
+        void add_section( const char * name, uint64_t offset, uint64_t size ) // ignores sections other than those above
+        {
+            static const char * names[ secMax ] = { ".debug_line", ".debug_info", ".debug_abbrev", ".debug_str", ".debug_line_str", ".debug_ranges", ".debug_rnglists" };
+            for ( int s = 0; s < secMax; s++ )
+            {
+                if ( !strcmp( name, names[ s ] ) )
+                {
+                    section_offset[ s ] = offset;
+                    section_size[ s ] = size;
+                }
+            }
+        } //add_section
+
+        bool available() { return ( 0 != section_size[ secLine ] ) && !image.empty(); } // true if lookups might succeed
+
+        bool lookup_line( uint64_t address, const char * & file, uint32_t & line )
+        {
+            if ( !parsed )
+                parse();
+
+            size_t low = 0, high = rows.size(); // find the last row at or before address
+            while ( low < high )
+            {
+                size_t mid = low + ( high - low ) / 2;
+                if ( rows[ mid ].address <= address )
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+
+            if ( 0 == low || endSequence == rows[ low - 1 ].line )
+                return false;
+
+            file = file_name( rows[ low - 1 ].file );
+            line = rows[ low - 1 ].line;
+            return true;
+        } //lookup_line
+
+        size_t lookup_inlines( uint64_t address, vector<InlineFrame> & frames ) // innermost first. returns the count
+        {
+            if ( !parsed )
+                parse();
+
+            frames.clear();
+            size_t low = 0, high = inlines.size(); // ranges starting after address can't hold it
+            while ( low < high )
+            {
+                size_t mid = low + ( high - low ) / 2;
+                if ( inlines[ mid ].low <= address )
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+
+            vector<const InlineRange *> found;
+            for ( size_t i = low; i > 0 && inlines[ i - 1 ].max_high > address; i-- )
+                if ( address < inlines[ i - 1 ].high )
+                    found.push_back( & inlines[ i - 1 ] );
+
+            stable_sort( found.begin(), found.end(), []( const InlineRange * a, const InlineRange * b ) { return a->depth > b->depth; } );
+            for ( size_t i = 0; i < found.size(); i++ )
+            {
+                InlineFrame f = { subprogram_name( found[ i ]->origin ), file_name( found[ i ]->call_file ), found[ i ]->call_line };
+                frames.push_back( f );
+            }
+
+            return frames.size();
+        } //lookup_inlines
+};
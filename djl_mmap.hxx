@@ -63,6 +63,8 @@ class CMMap
         CMMap() : base( 0 ), length( 0 ), peak( 0 ), pmem( 0 ) {}
         ~CMMap() { validate(); }
         uint64_t peak_usage() { return peak; }
+        vector<MMapEntry> & get_entries() { return entries; } // used to save and restore checkpoints
+        void set_peak_usage( uint64_t p ) { peak = p; }
 
         void initialize( uint64_t b, uint64_t l, uint8_t * p )
         {
@@ -0,0 +1,299 @@
+// checks that x64.hxx computes the same results and rflags with the host-flags backend (X64_HOST_FLAGS) as with
+// the portable C++ code, and that the portable code matches a reference model that works bit by bit like a full adder
+// and a barrel shifter. add, adc, sub, sbb, and, or, xor, shl, shr, and sar run on random operands for each width,
+// with edge values like 0, 1, and the sign bit mixed in, starting from random rflags. shift counts cover everything
+// the interpreter can pass after masking, including counts larger than 8 and 16-bit operands.
+// build with mflagtest.sh. the host comparison is trivially true if the build is portable-only, but the reference
+// comparison runs on every host.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <vector>
+
+using namespace std;
+
+#include "x64.hxx"
+
+struct x64_flag_test
+{
+    x64 & cpu;
+    uint64_t rng;
+    uint64_t cases;
+    uint64_t failures;
+
+    x64_flag_test( x64 & c, uint64_t seed ) : cpu( c ), rng( seed ), cases( 0 ), failures( 0 ) {}
+
+    uint64_t next()
+    {
+        // splitmix64
+
+        uint64_t z = ( rng += 0x9e3779b97f4a7c15ull );
+        z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+        z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebull;
+        return z ^ ( z >> 31 );
+    } //next
+
+    template <typename T> T operand()
+    {
+        // a quarter of operands are values near the edges of the type, where carry and overflow change
+
+        static const uint64_t edges[] = { 0, 1, 2, 0x7f, 0x80, 0xff, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff,
+                                          0x7fffffffffffffffull, 0x8000000000000000ull, ~0ull };
+        uint64_t r = next();
+        if ( 0 == ( r & 3 ) )
+            return (T) edges[ ( r >> 2 ) % ( sizeof( edges ) / sizeof( edges[ 0 ] ) ) ];
+        return (T) next();
+    } //operand
+
+    // ignore is flags the instruction leaves undefined, which the two sides may set differently
+
+    void check( const char * name, uint8_t width, uint64_t a, uint64_t b, uint64_t flags_in, const char * expected_name, uint64_t r_expected, uint64_t f_expected,
+                uint64_t r_portable, uint64_t f_portable, uint64_t ignore = 0 )
+    {
+        cases++;
+        if ( r_expected == r_portable && ( f_expected & ~ignore ) == ( f_portable & ~ignore ) )
+            return;
+
+        failures++;
+        if ( failures <= 20 )
+            printf( "mismatch: %s%u a %#llx b %#llx rflags %#llx: %s %#llx rflags %#llx, portable %#llx rflags %#llx\n", name, width * 8,
+                    (unsigned long long) a, (unsigned long long) b, (unsigned long long) flags_in, expected_name,
+                    (unsigned long long) r_expected, (unsigned long long) f_expected, (unsigned long long) r_portable, (unsigned long long) f_portable );
+    } //check
+
+    static uint64_t parity_flag( uint64_t r )
+    {
+        uint64_t bits = 0;
+        for ( int i = 0; i < 8; i++ )
+            bits += ( r >> i ) & 1;
+        return ( 0 == ( bits & 1 ) ) ? 0x4 : 0;
+    } //parity_flag
+
+    static uint64_t psz_flags( uint64_t r, uint8_t bits )
+    {
+        return parity_flag( r ) | ( ( 0 == r ) ? 0x40 : 0 ) | ( ( ( r >> ( bits - 1 ) ) & 1 ) ? 0x80 : 0 );
+    } //psz_flags
+
+    // the reference model. results and flags are computed in 64 bits for every width, without the portable code's
+    // comparisons: add is a ripple into the top bit, sub is add of the complement with the carry inverted
+
+    static uint64_t reference_add( uint8_t bits, uint64_t a, uint64_t b, uint64_t c, uint64_t flags_in, uint64_t & flags )
+    {
+        uint64_t m = ( 64 == bits ) ? ~0ull : ( ( 1ull << bits ) - 1 );
+        uint64_t low = m >> 1;
+        uint64_t r = ( a + b + c ) & m;
+        uint64_t carry_in = ( ( ( a & low ) + ( b & low ) + c ) >> ( bits - 1 ) ) & 1;
+        uint64_t a_top = ( a >> ( bits - 1 ) ) & 1;
+        uint64_t b_top = ( b >> ( bits - 1 ) ) & 1;
+        uint64_t carry_out = ( a_top & b_top ) | ( carry_in & ( a_top | b_top ) );
+        uint64_t half = ( ( a & 0xf ) + ( b & 0xf ) + c ) >> 4;
+        flags = ( flags_in & ~0x8d5ull ) | psz_flags( r, bits ) | carry_out | ( half << 4 ) | ( ( carry_in ^ carry_out ) << 11 );
+        return r;
+    } //reference_add
+
+    static uint64_t reference_sub( uint8_t bits, uint64_t a, uint64_t b, uint64_t borrow, uint64_t flags_in, uint64_t & flags )
+    {
+        uint64_t m = ( 64 == bits ) ? ~0ull : ( ( 1ull << bits ) - 1 );
+        uint64_t r = reference_add( bits, a, ~b & m, !borrow, flags_in, flags );
+        flags ^= 0x11; // x86 reports borrows, the complement of the adder's carries out of bit 3 and the top bit
+        return r;
+    } //reference_sub
+
+    static uint64_t reference_logic( uint8_t bits, uint64_t r, uint64_t flags_in, uint64_t & flags )
+    {
+        flags = ( flags_in & ~0x8c5ull ) | psz_flags( r, bits ); // C and O are cleared and A is left alone
+        return r;
+    } //reference_logic
+
+    // op is 0 shl, 1 shr, 2 sar. count is 1 through 31 or 63. O is set for counts of 1, and otherwise left alone, as is A
+
+    static uint64_t reference_shift( uint8_t op, uint8_t bits, uint64_t a, uint8_t count, uint64_t flags_in, uint64_t & flags )
+    {
+        uint64_t m = ( 64 == bits ) ? ~0ull : ( ( 1ull << bits ) - 1 );
+        uint64_t r, c, o = 0;
+
+        if ( 0 == op )
+        {
+            r = ( count < bits ) ? ( ( a << count ) & m ) : 0;
+            c = ( count <= bits ) ? ( ( a >> ( bits - count ) ) & 1 ) : 0;
+            o = ( ( r >> ( bits - 1 ) ) & 1 ) ^ c;
+        }
+        else if ( 1 == op )
+        {
+            r = ( count < bits ) ? ( a >> count ) : 0;
+            c = ( count <= bits ) ? ( ( a >> ( count - 1 ) ) & 1 ) : 0;
+            o = ( a >> ( bits - 1 ) ) & 1;
+        }
+        else
+        {
+            int64_t sa = (int64_t) ( a << ( 64 - bits ) ) >> ( 64 - bits );
+            r = (uint64_t) ( sa >> count ) & m;
+            c = (uint64_t) ( sa >> ( count - 1 ) ) & 1;
+        }
+
+        uint64_t mask = ( 1 == count ) ? 0x8c5 : 0xc5;
+        flags = ( flags_in & ~mask ) | psz_flags( r, bits ) | c | ( ( 1 == count ) ? ( o << 11 ) : ( flags_in & 0x800 ) );
+        return r;
+    } //reference_shift
+
+    template <typename T> void math( uint64_t iterations )
+    {
+        static const char * names[] = { "add", "adc", "sub", "sbb", "and", "or", "xor" };
+
+        for ( uint64_t i = 0; i < iterations; i++ )
+        {
+            T a = operand<T>();
+            T b = operand<T>();
+            uint64_t flags_in = next() & 0xfff;
+            bool c = ( 0 != ( flags_in & 1 ) );
+
+            for ( uint8_t op = 0; op < 7; op++ )
+            {
+                T r_host, r_portable;
+                cpu.rflags = flags_in;
+                switch ( op )
+                {
+                    case 0: r_host = cpu.op_add( a, b ); break;
+                    case 1: r_host = cpu.op_add( a, b, c ); break;
+                    case 2: r_host = cpu.op_sub( a, b ); break;
+                    case 3: r_host = cpu.op_sub( a, b, c ); break;
+                    case 4: r_host = cpu.op_and( a, b ); break;
+                    case 5: r_host = cpu.op_or( a, b ); break;
+                    default: r_host = cpu.op_xor( a, b ); break;
+                }
+                uint64_t f_host = cpu.rflags;
+
+                cpu.rflags = flags_in;
+                switch ( op )
+                {
+                    case 0: r_portable = cpu.portable_op_add( a, b ); break;
+                    case 1: r_portable = cpu.portable_op_add( a, b, c ); break;
+                    case 2: r_portable = cpu.portable_op_sub( a, b ); break;
+                    case 3: r_portable = cpu.portable_op_sub( a, b, c ); break;
+                    case 4: r_portable = cpu.portable_op_and( a, b ); break;
+                    case 5: r_portable = cpu.portable_op_or( a, b ); break;
+                    default: r_portable = cpu.portable_op_xor( a, b ); break;
+                }
+
+                uint64_t f_portable = cpu.rflags;
+                check( names[ op ], sizeof( T ), a, b, flags_in, "host", r_host, f_host, r_portable, f_portable );
+
+                uint64_t r_reference, f_reference;
+                uint8_t bits = 8 * sizeof( T );
+                switch ( op )
+                {
+                    case 0: r_reference = reference_add( bits, a, b, 0, flags_in, f_reference ); break;
+                    case 1: r_reference = reference_add( bits, a, b, c, flags_in, f_reference ); break;
+                    case 2: r_reference = reference_sub( bits, a, b, 0, flags_in, f_reference ); break;
+                    case 3: r_reference = reference_sub( bits, a, b, c, flags_in, f_reference ); break;
+                    case 4: r_reference = reference_logic( bits, a & b, flags_in, f_reference ); break;
+                    case 5: r_reference = reference_logic( bits, a | b, flags_in, f_reference ); break;
+                    default: r_reference = reference_logic( bits, a ^ b, flags_in, f_reference ); break;
+                }
+                check( names[ op ], sizeof( T ), a, b, flags_in, "reference", r_reference, f_reference, r_portable, f_portable );
+            }
+        }
+    } //math
+
+    template <typename T> void shifts( uint64_t iterations )
+    {
+        static const char * names[] = { "shl", "shr", "sar" };
+
+        for ( uint64_t i = 0; i < iterations; i++ )
+        {
+            T a = operand<T>();
+            uint8_t bits = 8 * sizeof( T );
+            uint8_t shift = 1 + ( next() % ( ( 64 == bits ) ? 63 : 31 ) ); // the interpreter masks counts to 5 or 6 bits
+            uint64_t flags_in = next() & 0xfff;
+
+            for ( uint8_t op = 0; op < 3; op++ )
+            {
+                T r_host = a;
+                cpu.rflags = flags_in;
+                if ( 0 == op )
+                    cpu.op_sal( &r_host, shift );
+                else if ( 1 == op )
+                    cpu.op_shr( &r_host, shift );
+                else
+                    cpu.op_sar( &r_host, shift );
+                uint64_t f_host = cpu.rflags;
+
+                T r_portable = a;
+                cpu.rflags = flags_in;
+                if ( 0 == op )
+                    cpu.portable_op_sal( &r_portable, shift );
+                else if ( 1 == op )
+                    cpu.portable_op_shr( &r_portable, shift );
+                else
+                    cpu.portable_op_sar( &r_portable, shift );
+
+                uint64_t f_portable = cpu.rflags;
+
+                // C is undefined for shl and shr by the width or more, and the host's result for larger
+                // counts on 8 and 16-bit operands isn't what the portable code picks, so only the reference checks them
+
+                if ( shift < bits )
+                    check( names[ op ], sizeof( T ), a, shift, flags_in, "host", r_host, f_host, r_portable, f_portable );
+
+                uint64_t f_reference;
+                uint64_t r_reference = reference_shift( op, bits, a, shift, flags_in, f_reference );
+                check( names[ op ], sizeof( T ), a, shift, flags_in, "reference", r_reference, f_reference, r_portable, f_portable,
+                       ( op < 2 && shift >= bits ) ? 1 : 0 );
+            }
+        }
+    } //shifts
+};
+
+static void usage( char const * perror = 0 )
+{
+    if ( 0 != perror )
+        printf( "error: %s\n", perror );
+
+    printf( "usage: flagtest [arguments]\n" );
+    printf( "   arguments:    -n:N   random operand sets per operation and width. default is 1000000\n" );
+    printf( "                 -s:N   random number seed. default is 1\n" );
+    printf( "   example:      flagtest -n:10000000 -s:42\n" );
+    exit( 1 );
+} //usage
+
+int main( int argc, char * argv[] )
+{
+    uint64_t iterations = 1000000;
+    uint64_t seed = 1;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char * parg = argv[ i ];
+        if ( ( '-' != parg[ 0 ] && '/' != parg[ 0 ] ) || ':' != parg[ 2 ] )
+            usage( "invalid argument" );
+
+        char c = (char) tolower( parg[ 1 ] );
+        if ( 'n' == c )
+            iterations = strtoull( parg + 3, 0, 10 );
+        else if ( 's' == c )
+            seed = strtoull( parg + 3, 0, 10 );
+        else
+            usage( "invalid argument" );
+    }
+
+    vector<uint8_t> memory( 4096 );
+    x64 cpu( memory, 0, 0, 0, 0 );
+    x64_flag_test test( cpu, seed );
+
+    test.math<uint8_t>( iterations );
+    test.math<uint16_t>( iterations );
+    test.math<uint32_t>( iterations );
+    test.math<uint64_t>( iterations );
+    test.shifts<uint8_t>( iterations );
+    test.shifts<uint16_t>( iterations );
+    test.shifts<uint32_t>( iterations );
+    test.shifts<uint64_t>( iterations );
+
+    printf( "%s backend: %llu cases, %llu mismatches\n", X64_HOST_FLAGS ? "host flags" : "portable", (unsigned long long) test.cases, (unsigned long long) test.failures );
+    return ( 0 == test.failures ) ? 0 : 1;
+} //main
@@ -0,0 +1,50 @@
+#pragma once
+
+// libx64os: run x64 (or x32 with X32OS) Linux elf binaries in-process. build libx64os.a with mlib.sh.
+// emulator state is per-thread in library builds, so each thread can run one X64OSVM at a time
+// and VMs on different threads are independent. create, load, and run a VM on the same thread.
+
+#include <stdint.h>
+#include <stddef.h>
+
+// return true if the syscall was handled and result should be returned to the app.
+// id is the app's syscall number (e.g. 1 for write on x64), not the emulator's internal number.
+
+typedef bool ( * X64OSSyscallOverride )( void * context, uint64_t id, const uint64_t args[ 6 ], int64_t & result );
+
+// receives data the app writes to stdout (1) or stderr (2) with write() or writev()
+
+typedef void ( * X64OSOutputSink )( void * context, int descriptor, const void * data, size_t length );
+
+enum X64OSRunResult
+{
+    x64osExited,                     // the app called exit; see exit_code()
+    x64osBudgetExhausted,            // the instruction budget was reached. call run() again to continue
+    x64osHalted,                     // the app executed hlt or ended emulation some other way
+    x64osError                       // the app or emulator hit a fatal error; see error()
+};
+
+class X64OSVM
+{
+    public:
+        X64OSVM();
+        ~X64OSVM();
+
+        bool set_args( const char * app_args );                               // space-separated, as on the command line
+        bool add_environment( const char * name_equals_value );              // in addition to OS=
+        void set_memory( uint64_t heap_meg, uint64_t mmap_meg, uint64_t stack_kb );
+        void set_syscall_override( X64OSSyscallOverride fn, void * context );
+        void set_output_sink( X64OSOutputSink fn, void * context );
+        bool add_mount( const char * app_path, const char * preload = 0 );     // in-memory file system, optionally preloaded from a host directory or tar file
+
+        bool load( const char * path );                                       // call after the set_* functions above
+        bool load( const void * image, size_t length, const char * name );    // name is the app's argv[0]
+
+        X64OSRunResult run( uint64_t instruction_budget = 0 );               // 0 means no budget
+        int exit_code();
+        uint64_t instructions();                                              // executed so far across all run() calls
+        const char * error();
+
+    private:
+        struct X64OSVMState * state;
+};
@@ -33,6 +33,10 @@
 #define emulator_sys_set_thread_area    0x2010 // exists for x32 and some other platforms
 #define emulator_sys_get_thread_area    0x2011 // exists for x32 and some other platforms
 #define emulator_sys_ugetrlimit         0x2012 // exists for x32 and some other platforms
+#define emulator_sys_checkpoint         0x2013 // save emulator state to the -c checkpoint file. returns 0 now and 1 when resumed with -r
+#define emulator_sys_fork_server        0x2014 // with -f, start the fork server here. returns 0 in each forked child
+#define emulator_sys_alarm              0x2015 // exists on x64 but isn't used on most others
+#define emulator_sys_pause              0x2016 // "
 
 // Linux syscall numbers differ by ISA. InSAne. These are RISC and ARM64, which are the same!
 // Note that there are differences between these two sets. which is correct?
@@ -70,15 +74,26 @@
 #define SYS_set_tid_address 96
 #define SYS_futex 98
 #define SYS_set_robust_list 99
+#define SYS_getitimer 102
+#define SYS_setitimer 103
+#define SYS_timer_create 107
+#define SYS_timer_gettime 108
+#define SYS_timer_getoverrun 109
+#define SYS_timer_settime 110
+#define SYS_timer_delete 111
 #define SYS_clock_gettime 113
 #define SYS_clock_nanosleep 115
 #define SYS_sched_setaffinity 122
 #define SYS_sched_getaffinity 123
 #define SYS_sched_yield 124
+#define SYS_kill 129
 #define SYS_tgkill 131
 #define SYS_signalstack 132
+#define SYS_rt_sigsuspend 133
 #define SYS_sigaction 134
 #define SYS_rt_sigprocmask 135
+#define SYS_rt_sigpending 136
+#define SYS_rt_sigreturn 139
 #define SYS_times 153
 #define SYS_uname 160
 #define SYS_getrusage 165
@@ -98,6 +113,7 @@
 #define SYS_mmap 222
 #define SYS_mprotect 226
 #define SYS_madvise 233
+#define SYS_perf_event_open 241
 #define SYS_riscv_flush_icache 259 // not in docs; may be riscv only
 #define SYS_prlimit64 261
 #define SYS_renameat2 276
@@ -0,0 +1 @@
+g++ -O2 -Wall -I . bench.cxx -o bench
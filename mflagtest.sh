@@ -0,0 +1 @@
+g++ -O2 -Wall -I . flagtest.cxx -o flagtest
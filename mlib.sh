@@ -0,0 +1,4 @@
+g++ -DX64OS -DX64OS_LIBRARY -DNDEBUG -fcf-protection=none -U_FORTIFY_SOURCE -O2 -Wno-psabi -Wno-stringop-overflow -Wno-format-security -fsigned-char -fno-builtin -I . -c x64os.cxx -o libx64os_os.o
+g++ -DX64OS -DX64OS_LIBRARY -DNDEBUG -fcf-protection=none -U_FORTIFY_SOURCE -O2 -Wno-psabi -Wno-stringop-overflow -Wno-format-security -fsigned-char -fno-builtin -I . -c x64.cxx -o libx64os_cpu.o
+ar rcs libx64os.a libx64os_os.o libx64os_cpu.o
+rm libx64os_os.o libx64os_cpu.o
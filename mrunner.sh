@@ -0,0 +1 @@
+g++ -O2 -Wall -I . runner.cxx -o runner -lpthread
@@ -0,0 +1,3 @@
+# build x64os_<app> with app's code translated to C++. usage: mtran.sh <app>. build x64os first with m.sh or mr.sh
+./x64os -j:$(basename $1)_tran.cxx $1 || exit 1
+g++ -DX64OS -DX64OS_TRANSLATED -DNDEBUG -fcf-protection=none -U_FORTIFY_SOURCE -O2 -Wno-psabi -Wno-stringop-overflow -Wno-format-security -fsigned-char -fno-builtin -I . x64os.cxx x64.cxx $(basename $1)_tran.cxx -o x64os_$(basename $1) -static
@@ -25,7 +25,7 @@ echo "$date_time" >$outputfile
 for arg in tcmp t e printint sieve simple tmuldiv tpi ts tarray tbits trw trw2 \
            tmmap tstr tdir fileops ttime tm glob tap tsimplef tphi tf ttt td terrno \
            t_setjmp tex mm tao pis ttypes nantst sleeptm tatomic lenum \
-           tregex trename nqueens fopentst fact triangle mm_old hidave tscas tpopcnt;
+           tregex trename nqueens fopentst fact triangle mm_old hidave tscas tpopcnt tsignal tgetdents;
 do
     echo $arg
     for opt in 0 1 2 3 fast;
@@ -83,6 +83,72 @@ do
     $_x64oscmd c_tests/clangbin$optflag/tgets <c_tests/tgets.txt >>$outputfile
 done    
 
+# the tests below use emulator arguments, so they don't run natively
+
+if [ "$_x64oscmd" != "" ]; then
+
+echo test tcheckpoint
+for opt in 0 1 2 3 fast;
+do
+    echo test c_tests/bin$opt/tcheckpoint -c -r >>$outputfile
+    $_x64oscmd -c:tcheckpoint.ck c_tests/bin$opt/tcheckpoint >>$outputfile
+    $_x64oscmd -r:tcheckpoint.ck c_tests/bin$opt/tcheckpoint >>$outputfile
+    echo test c_tests/bin$opt/tcheckpoint -n -r >>$outputfile
+    $_x64oscmd -c:tcheckpoint.ck -n:1000000 c_tests/bin$opt/tcheckpoint n >>$outputfile
+    $_x64oscmd -r:tcheckpoint.ck c_tests/bin$opt/tcheckpoint n >>$outputfile
+    echo test c_tests/clangbin$opt/tcheckpoint -c -r >>$outputfile
+    $_x64oscmd -c:tcheckpoint.ck c_tests/clangbin$opt/tcheckpoint >>$outputfile
+    $_x64oscmd -r:tcheckpoint.ck c_tests/clangbin$opt/tcheckpoint >>$outputfile
+    echo test c_tests/clangbin$opt/tcheckpoint -n -r >>$outputfile
+    $_x64oscmd -c:tcheckpoint.ck -n:1000000 c_tests/clangbin$opt/tcheckpoint n >>$outputfile
+    $_x64oscmd -r:tcheckpoint.ck c_tests/clangbin$opt/tcheckpoint n >>$outputfile
+done
+rm -f tcheckpoint.ck
+
+echo test trecord
+for opt in 0 1 2 3 fast;
+do
+    echo test c_tests/bin$opt/trecord -w -x >>$outputfile
+    $_x64oscmd -w:trecord.log c_tests/bin$opt/trecord <c_tests/tgets.txt >>$outputfile
+    $_x64oscmd -x:trecord.log c_tests/bin$opt/trecord </dev/null >>$outputfile
+    echo test c_tests/bin$opt/trecord -w -x v >>$outputfile
+    $_x64oscmd -w:trecord.log c_tests/bin$opt/trecord v <c_tests/tgets.txt 2>trecord_w.txt >/dev/null
+    $_x64oscmd -x:trecord.log c_tests/bin$opt/trecord v </dev/null 2>trecord_x.txt >/dev/null
+    cmp -s trecord_w.txt trecord_x.txt && echo time, random bytes, and pid match >>$outputfile
+    echo test c_tests/clangbin$opt/trecord -w -x >>$outputfile
+    $_x64oscmd -w:trecord.log c_tests/clangbin$opt/trecord <c_tests/tgets.txt >>$outputfile
+    $_x64oscmd -x:trecord.log c_tests/clangbin$opt/trecord </dev/null >>$outputfile
+    echo test c_tests/clangbin$opt/trecord -w -x v >>$outputfile
+    $_x64oscmd -w:trecord.log c_tests/clangbin$opt/trecord v <c_tests/tgets.txt 2>trecord_w.txt >/dev/null
+    $_x64oscmd -x:trecord.log c_tests/clangbin$opt/trecord v </dev/null 2>trecord_x.txt >/dev/null
+    cmp -s trecord_w.txt trecord_x.txt && echo time, random bytes, and pid match >>$outputfile
+done
+rm -f trecord.log trecord_w.txt trecord_x.txt
+
+echo test tperf
+for opt in 0 1 2 3 fast;
+do
+    echo c_tests/bin$opt/tperf >>$outputfile
+    $_x64oscmd c_tests/bin$opt/tperf >>$outputfile
+    echo c_tests/clangbin$opt/tperf >>$outputfile
+    $_x64oscmd c_tests/clangbin$opt/tperf >>$outputfile
+done
+
+echo test tvfs
+for opt in 0 1 2 3 fast;
+do
+    echo test c_tests/bin$opt/tvfs -o >>$outputfile
+    $_x64oscmd -o:/tvfs=c_tests/tvfs_data c_tests/bin$opt/tvfs >>$outputfile
+    echo test c_tests/bin$opt/tvfs -o -d >>$outputfile
+    $_x64oscmd -o:/tvfs=c_tests/tvfs_data -d c_tests/bin$opt/tvfs >>$outputfile
+    echo test c_tests/clangbin$opt/tvfs -o >>$outputfile
+    $_x64oscmd -o:/tvfs=c_tests/tvfs_data c_tests/clangbin$opt/tvfs >>$outputfile
+    echo test c_tests/clangbin$opt/tvfs -o -d >>$outputfile
+    $_x64oscmd -o:/tvfs=c_tests/tvfs_data -d c_tests/clangbin$opt/tvfs >>$outputfile
+done
+
+fi
+
 for arg in e td ttt fileops ato tap real tphi mysort tmm;
 do
     echo $arg
@@ -0,0 +1,495 @@
+// runs the guest commands listed in a manifest concurrently, diffs each test's output with its section
+// of a baseline file, and reports pass/fail, wall time, and emulated MIPS per test and in aggregate.
+// it replaces the serial runall.sh / runall32.sh loops; see runall_manifest.txt for the manifest format.
+// build with mrunner.sh.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+struct TestEntry
+{
+    string label;                   // echoed to the combined output before the test's output, as runall.sh does
+    vector<string> commands;        // app and arguments; the emulator and -p are prepended
+    string group;                   // entries in the same group run serially since they share files
+    string output;                  // stdout of all commands with the -p statistics removed
+    uint64_t instructions;          // sum of emulated instructions across the commands
+    int64_t ms;                     // wall time for all commands
+    int result;                     // resultPass, resultFail, resultNoBaseline, resultError
+    string detail;                  // for failures, the first line that differs
+};
+
+enum { resultPass, resultFail, resultNoBaseline, resultError };
+static const char * result_names[] = { "PASS", "FAIL", "NO BASELINE", "ERROR" };
+
+static vector<TestEntry> g_entries;
+static vector<vector<size_t>> g_jobs;       // indexes into g_entries. each job runs serially on one thread
+static atomic<size_t> g_nextJob( 0 );
+static string g_emulator = "x64os";
+static string g_baseline;
+static bool g_haveBaseline = false;
+static bool g_verbose = false;
+
+static void usage( char const * perror = 0 )
+{
+    if ( 0 != perror )
+        printf( "error: %s\n", perror );
+
+    printf( "usage: runner [arguments] <manifest>\n" );
+    printf( "   arguments:    -b:F   baseline file to diff each test's output against. default is none\n" );
+    printf( "                 -e:C   emulator command line. default is x64os. use -e: to run the tests natively\n" );
+    printf( "                 -j:N   number of tests to run concurrently. default is the number of cores\n" );
+    printf( "                 -o:F   write the combined output in manifest order to F, in the same form as runall.sh\n" );
+    printf( "                 -v     show every test's result, not just failures\n" );
+    printf( "   example:      runner -j:16 -b:baseline_runall_test.txt -o:runall_test.txt runall_manifest.txt\n" );
+    printf( "                 runner -e:\"x32os\" -b:baseline_runall32_test.txt runall32_manifest.txt\n" );
+    exit( 1 );
+} //usage
+
+static string render_number_with_commas( uint64_t n )
+{
+    string s = to_string( n );
+    for ( int i = (int) s.length() - 3; i > 0; i -= 3 )
+        s.insert( i, "," );
+    return s;
+} //render_number_with_commas
+
+static void trim_trailing_space( string & s )
+{
+    while ( s.length() && isspace( (unsigned char) s.back() ) )
+        s.pop_back();
+} //trim_trailing_space
+
+static bool read_file( const char * pcFile, string & contents )
+{
+    FILE * fp = fopen( pcFile, "rb" );
+    if ( !fp )
+        return false;
+
+    char buf[ 4096 ];
+    size_t len;
+    while ( 0 != ( len = fread( buf, 1, sizeof( buf ), fp ) ) )
+        contents.append( buf, len );
+    fclose( fp );
+
+    // the baselines were produced on both Windows and Linux
+
+    string clean;
+    clean.reserve( contents.length() );
+    for ( char c : contents )
+        if ( '\r' != c )
+            clean += c;
+    contents.swap( clean );
+    return true;
+} //read_file
+
+static bool parse_manifest( const char * pcManifest )
+{
+    string contents;
+    if ( !read_file( pcManifest, contents ) )
+    {
+        printf( "can't open manifest file %s\n", pcManifest );
+        return false;
+    }
+
+    string group;
+    size_t lineNumber = 0;
+    size_t start = 0;
+    while ( start < contents.length() )
+    {
+        size_t end = contents.find( '\n', start );
+        if ( string::npos == end )
+            end = contents.length();
+        string line = contents.substr( start, end - start );
+        start = end + 1;
+        lineNumber++;
+        trim_trailing_space( line );
+
+        if ( 0 == line.length() || '#' == line[ 0 ] )
+            continue;
+
+        if ( ' ' == line[ 0 ] || '\t' == line[ 0 ] )
+        {
+            if ( 0 == g_entries.size() )
+            {
+                printf( "manifest line %zu: a command must follow a label\n", lineNumber );
+                return false;
+            }
+
+            size_t first = line.find_first_not_of( " \t" );
+            g_entries.back().commands.push_back( line.substr( first ) );
+        }
+        else if ( '@' == line[ 0 ] )
+        {
+            if ( 0 != line.compare( 0, 6, "@group" ) )
+            {
+                printf( "manifest line %zu: unknown directive %s\n", lineNumber, line.c_str() );
+                return false;
+            }
+
+            size_t first = line.find_first_not_of( " \t", 6 );
+            group = ( string::npos == first ) ? "" : line.substr( first );
+        }
+        else
+        {
+            TestEntry entry = {};
+            entry.label = line;
+            entry.group = group;
+            g_entries.push_back( entry );
+        }
+    }
+
+    // grouped tests are queued first since they run serially and take the longest
+
+    vector<string> groups;
+    for ( size_t i = 0; i < g_entries.size(); i++ )
+    {
+        const string & grp = g_entries[ i ].group;
+        if ( 0 == grp.length() )
+            continue;
+
+        size_t j = 0;
+        while ( j < groups.size() && groups[ j ] != grp )
+            j++;
+
+        if ( j == groups.size() )
+        {
+            groups.push_back( grp );
+            g_jobs.push_back( vector<size_t>() );
+        }
+        g_jobs[ j ].push_back( i );
+    }
+
+    for ( size_t i = 0; i < g_entries.size(); i++ )
+        if ( 0 == g_entries[ i ].group.length() )
+            g_jobs.push_back( vector<size_t>( 1, i ) );
+
+    return true;
+} //parse_manifest
+
+// with -p the emulator appends statistics after the app's output. remove them and return the instruction count.
+// the app's last line may not end with a newline, so the statistics can start mid-line.
+
+static uint64_t strip_performance_output( string & output )
+{
+    size_t stats = output.rfind( "elapsed milliseconds:" );
+    if ( string::npos == stats )
+        return 0;
+
+    uint64_t instructions = 0;
+    size_t inst = output.find( "instructions:", stats );
+    if ( string::npos != inst )
+    {
+        for ( size_t i = inst + strlen( "instructions:" ); i < output.length() && '\n' != output[ i ]; i++ )
+            if ( isdigit( (unsigned char) output[ i ] ) )
+                instructions = instructions * 10 + ( output[ i ] - '0' );
+    }
+
+    output.resize( stats );
+    return instructions;
+} //strip_performance_output
+
+static bool run_command( const string & command, string & output, uint64_t & instructions )
+{
+    string full;
+    if ( g_emulator.length() )
+        full = g_emulator + " -p " + command;
+    else
+        full = command;
+
+    FILE * fp = popen( full.c_str(), "r" );
+    if ( !fp )
+        return false;
+
+    string out;
+    char buf[ 4096 ];
+    size_t len;
+    while ( 0 != ( len = fread( buf, 1, sizeof( buf ), fp ) ) )
+        out.append( buf, len );
+    pclose( fp ); // like runall.sh, the app's exit code is ignored; the output is what's validated
+
+    if ( g_emulator.length() )
+        instructions += strip_performance_output( out );
+
+    output += out;
+    return true;
+} //run_command
+
+// find each entry's section of the baseline by locating the labels in order. the baseline's first
+// and last lines are dates, and the label search naturally skips the first. an output that ended
+// without a newline leaves the next label mid-line, so labels are found as substrings ending a line.
+
+static void compare_with_baseline()
+{
+    size_t search = 0;
+    vector<size_t> starts( g_entries.size(), string::npos );
+    vector<size_t> ends( g_entries.size(), string::npos );
+
+    for ( size_t i = 0; i < g_entries.size(); i++ )
+    {
+        string target = g_entries[ i ].label + "\n";
+        size_t found = g_baseline.find( target, search );
+        if ( string::npos == found )
+            continue;
+
+        starts[ i ] = found + target.length();
+        search = starts[ i ];
+
+        for ( size_t p = i; p > 0; p-- )
+        {
+            if ( string::npos != starts[ p - 1 ] )
+            {
+                ends[ p - 1 ] = found;
+                break;
+            }
+        }
+    }
+
+    // the last section ends before the trailing date line
+
+    for ( size_t i = g_entries.size(); i > 0; i-- )
+    {
+        if ( string::npos != starts[ i - 1 ] )
+        {
+            size_t end = g_baseline.length();
+            while ( end > starts[ i - 1 ] && '\n' == g_baseline[ end - 1 ] )
+                end--;
+            size_t lastLine = g_baseline.rfind( '\n', end - 1 );
+            ends[ i - 1 ] = ( string::npos == lastLine || lastLine < starts[ i - 1 ] ) ? starts[ i - 1 ] : lastLine + 1;
+            break;
+        }
+    }
+
+    for ( size_t i = 0; i < g_entries.size(); i++ )
+    {
+        TestEntry & e = g_entries[ i ];
+        if ( resultError == e.result )
+            continue;
+
+        if ( string::npos == starts[ i ] )
+        {
+            e.result = resultNoBaseline;
+            continue;
+        }
+
+        string expected = g_baseline.substr( starts[ i ], ends[ i ] - starts[ i ] );
+        const string & actual = e.output;
+
+        size_t ie = 0, ia = 0, line = 1;
+        e.result = resultPass;
+        while ( ie < expected.length() || ia < actual.length() )
+        {
+            size_t ee = expected.find( '\n', ie );
+            size_t ea = actual.find( '\n', ia );
+            if ( string::npos == ee )
+                ee = expected.length();
+            if ( string::npos == ea )
+                ea = actual.length();
+
+            string le = expected.substr( ie, ee - ie );
+            string la = actual.substr( ia, ea - ia );
+            trim_trailing_space( le );
+            trim_trailing_space( la );
+
+            if ( le != la )
+            {
+                e.result = resultFail;
+                e.detail = "line " + to_string( line ) + ": expected '" + le + "' got '" + la + "'";
+                break;
+            }
+
+            ie = ee + 1;
+            ia = ea + 1;
+            line++;
+        }
+    }
+} //compare_with_baseline
+
+static void worker()
+{
+    do
+    {
+        size_t job = g_nextJob++;
+        if ( job >= g_jobs.size() )
+            break;
+
+        for ( size_t index : g_jobs[ job ] )
+        {
+            TestEntry & e = g_entries[ index ];
+            high_resolution_clock::time_point tStart = high_resolution_clock::now();
+
+            for ( const string & command : e.commands )
+            {
+                if ( !run_command( command, e.output, e.instructions ) )
+                {
+                    e.result = resultError;
+                    e.detail = "unable to start " + command;
+                    break;
+                }
+            }
+
+            e.ms = duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - tStart ).count();
+        }
+    } while ( true );
+} //worker
+
+static void write_date( FILE * fp )
+{
+    time_t t = time( 0 );
+    char ac[ 100 ];
+    strftime( ac, sizeof( ac ), "%a %b %e %H:%M:%S %Z %Y", localtime( &t ) );
+    fprintf( fp, "%s\n", ac );
+} //write_date
+
+int main( int argc, char * argv[] )
+{
+    const char * pcManifest = 0;
+    const char * pcBaseline = 0;
+    const char * pcOutput = 0;
+    size_t threads = thread::hardware_concurrency();
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        char * parg = argv[ i ];
+        if ( '-' == parg[ 0 ] )
+        {
+            char ca = (char) tolower( parg[ 1 ] );
+
+            if ( 'v' == ca )
+                g_verbose = true;
+            else if ( ':' != parg[ 2 ] )
+                usage( "invalid argument" );
+            else if ( 'b' == ca )
+                pcBaseline = parg + 3;
+            else if ( 'e' == ca )
+                g_emulator = parg + 3;
+            else if ( 'j' == ca )
+                threads = strtoull( parg + 3, 0, 10 );
+            else if ( 'o' == ca )
+                pcOutput = parg + 3;
+            else
+                usage( "invalid argument" );
+        }
+        else if ( 0 == pcManifest )
+            pcManifest = parg;
+        else
+            usage( "only one manifest can be specified" );
+    }
+
+    if ( 0 == pcManifest )
+        usage( "no manifest specified" );
+
+    if ( 0 == threads )
+        threads = 1;
+
+    if ( pcBaseline )
+    {
+        if ( !read_file( pcBaseline, g_baseline ) )
+        {
+            printf( "can't open baseline file %s\n", pcBaseline );
+            return 1;
+        }
+        g_haveBaseline = true;
+    }
+
+    if ( !parse_manifest( pcManifest ) )
+        return 1;
+
+    if ( threads > g_jobs.size() )
+        threads = g_jobs.size();
+
+    printf( "running %zu tests as %zu jobs on %zu threads with emulator '%s'\n", g_entries.size(), g_jobs.size(), threads, g_emulator.c_str() );
+    fflush( stdout );
+
+    high_resolution_clock::time_point tStart = high_resolution_clock::now();
+
+    vector<thread> workers;
+    for ( size_t t = 0; t < threads; t++ )
+        workers.emplace_back( worker );
+    for ( thread & t : workers )
+        t.join();
+
+    int64_t wallMs = duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - tStart ).count();
+
+    if ( g_haveBaseline )
+        compare_with_baseline();
+    else
+        for ( TestEntry & e : g_entries )
+            if ( resultError != e.result )
+                e.result = resultNoBaseline;
+
+    if ( pcOutput )
+    {
+        FILE * fp = fopen( pcOutput, "w" );
+        if ( !fp )
+            printf( "can't write output file %s\n", pcOutput );
+        else
+        {
+            write_date( fp );
+            for ( TestEntry & e : g_entries )
+            {
+                fprintf( fp, "%s\n", e.label.c_str() );
+                fwrite( e.output.c_str(), 1, e.output.length(), fp );
+            }
+            write_date( fp );
+            fclose( fp );
+        }
+    }
+
+    size_t counts[ 4 ] = {};
+    uint64_t totalInstructions = 0;
+    int64_t totalMs = 0;
+
+    printf( "%-11s %12s %10s  %s\n", "result", "ms", "MIPS", "test" );
+    for ( TestEntry & e : g_entries )
+    {
+        counts[ e.result ]++;
+        totalInstructions += e.instructions;
+        totalMs += e.ms;
+
+        if ( g_verbose || resultFail == e.result || resultError == e.result )
+        {
+            char mips[ 32 ] = "-";
+            if ( 0 != e.ms && 0 != e.instructions )
+                snprintf( mips, sizeof( mips ), "%.1f", (double) e.instructions / (double) ( e.ms * 1000 ) );
+            printf( "%-11s %12s %10s  %s\n", result_names[ e.result ], render_number_with_commas( e.ms ).c_str(), mips, e.label.c_str() );
+            if ( e.detail.length() )
+                printf( "            %s\n", e.detail.c_str() );
+        }
+    }
+
+    printf( "\n" );
+    printf( "tests:                 %15zu\n", g_entries.size() );
+    printf( "passed:                %15zu\n", counts[ resultPass ] );
+    printf( "failed:                %15zu\n", counts[ resultFail ] );
+    printf( "no baseline:           %15zu\n", counts[ resultNoBaseline ] );
+    printf( "errors:                %15zu\n", counts[ resultError ] );
+    printf( "wall milliseconds:     %15s\n", render_number_with_commas( wallMs ).c_str() );
+    printf( "test milliseconds:     %15s\n", render_number_with_commas( totalMs ).c_str() );
+    if ( 0 != wallMs )
+        printf( "parallel speedup:      %15.2f\n", (double) totalMs / (double) wallMs );
+    printf( "instructions:          %15s\n", render_number_with_commas( totalInstructions ).c_str() );
+    if ( 0 != wallMs )
+        printf( "aggregate MIPS:        %15.1f\n", (double) totalInstructions / (double) ( wallMs * 1000 ) );
+    if ( 0 != totalMs )
+        printf( "per-test MIPS:         %15.1f\n", (double) totalInstructions / (double) ( totalMs * 1000 ) );
+
+    return ( 0 == counts[ resultFail ] && 0 == counts[ resultError ] ) ? 0 : 1;
+} //main
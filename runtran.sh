@@ -0,0 +1,46 @@
+#!/bin/bash
+# checks that apps translated by x64os -j retire exactly the instructions the interpreter does. build x64os first
+# with m.sh or mr.sh, the microbenchmarks with bench_tests/mall.sh, and the c_tests. -k keeps the app's clock
+# readings, and so the work it does, the same in both runs. the emulator is compiled once and linked with each
+# app's translation. usage: runtran.sh [app ...]. with no apps, the microbenchmarks and some c_tests are checked
+
+_flags="-DX64OS -DX64OS_TRANSLATED -DNDEBUG -fcf-protection=none -U_FORTIFY_SOURCE -O2 -Wno-psabi -Wno-stringop-overflow -Wno-format-security -fsigned-char -fno-builtin -I ."
+_dir=$(mktemp -d)
+_failed=0
+
+g++ -c $_flags x64os.cxx -o $_dir/x64os.o || exit 1
+g++ -c $_flags x64.cxx -o $_dir/x64.o || exit 1
+
+_apps="$@"
+if [ -z "$_apps" ]; then
+    _apps="bench_tests/mb_alu.elf bench_tests/mb_branch.elf bench_tests/mb_addr.elf bench_tests/mb_stack.elf \
+           bench_tests/mb_string.elf bench_tests/mb_sse2int.elf bench_tests/mb_sse2fp.elf bench_tests/mb_x87.elf \
+           bench_tests/mb_syscall.elf c_tests/bin2/ttt c_tests/clangbin2/ttt c_tests/bin3/sieve c_tests/bin3/nqueens \
+           c_tests/bin2/mm c_tests/bin2/tpi c_tests/bin0/e"
+fi
+
+for arg in $_apps;
+do
+    echo $arg
+    rm -f $_dir/x64os_tran
+    ./x64os -j:$_dir/tran.cxx $arg >/dev/null && g++ $_flags $_dir/x64os.o $_dir/x64.o $_dir/tran.cxx -o $_dir/x64os_tran -static
+    if [ ! -f $_dir/x64os_tran ]; then
+        echo "  can't build the translation"
+        _failed=1
+        continue
+    fi
+
+    _interpreted=$(./x64os -k -p $arg | grep "^instructions:")
+    _translated=$($_dir/x64os_tran -k -p $arg | grep "^instructions:")
+    if [ -z "$_interpreted" ] || [ "$_interpreted" != "$_translated" ]; then
+        echo "  interpreted $_interpreted"
+        echo "  translated  $_translated"
+        _failed=1
+    fi
+done
+
+rm -rf $_dir
+if [ $_failed -ne 0 ]; then
+    echo "translated and interpreted instruction counts differ"
+fi
+exit $_failed
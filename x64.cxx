@@ -38,9 +38,12 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include <signal.h>
 #include <limits>
 #include <chrono>
+#include <vector>
 #include <type_traits>
+#include <stdexcept>
 
 #include <djl_128.hxx>
 #include <djltrace.hxx>
@@ -74,10 +77,31 @@ template <typename T> bool my_issubnormal( T x ) { return ( FP_SUBNORMAL == fpcl
 #define truncl( x ) trunc( (double) x )
 #endif
 
-static uint32_t g_State = 0;
+static EMULATOR_THREAD_LOCAL uint32_t g_State = 0;
+static EMULATOR_THREAD_LOCAL volatile sig_atomic_t g_SignalRequested = 0; // set by request_signal_check(); see pending_state()
+static EMULATOR_THREAD_LOCAL uint64_t g_InstructionLimit = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_SignalCheckAt = 0;
 
 const uint32_t stateTraceInstructions = 1;
 const uint32_t stateEndEmulation = 2;
+const uint32_t stateInstructionLimit = 4;
+const uint32_t stateCountEvents = 8;
+const uint32_t stateSignalCheck = 16;
+const uint32_t stateSignalCheckAt = 32;
+const uint32_t stateTranslated = 64;           // rip starts a translated block, or translation_resume is ahead in this one
+
+static inline uint32_t pending_state()
+{
+    // host signal handlers can't safely read-modify-write g_State, since this thread's own updates could overwrite
+    // theirs. they set g_SignalRequested instead, and it's folded in here wherever the run loops look at g_State
+
+    if ( g_SignalRequested )
+    {
+        g_SignalRequested = 0;
+        g_State |= stateSignalCheck;
+    }
+    return g_State;
+} //pending_state
 
 bool x64::trace_instructions( bool t )
 {
@@ -91,6 +115,66 @@ bool x64::trace_instructions( bool t )
 
 void x64::end_emulation() { g_State |= stateEndEmulation; }
 
+void x64::set_instruction_limit( uint64_t limit )
+{
+    g_InstructionLimit = limit;
+    if ( 0 != limit )
+        g_State |= stateInstructionLimit;
+    else
+        g_State &= ~stateInstructionLimit;
+} //set_instruction_limit
+
+bool x64::count_events( bool c )
+{
+    bool prev = ( 0 != ( g_State & stateCountEvents ) );
+    if ( c )
+        g_State |= stateCountEvents;
+    else
+        g_State &= ~stateCountEvents;
+    if ( c && !prev )
+        event_fallthrough = 0;
+    return prev;
+} //count_events
+
+void x64::request_signal_check() { g_SignalRequested = 1; }
+
+void x64::set_signal_check_at( uint64_t r )
+{
+    g_SignalCheckAt = r;
+    if ( 0 != r )
+        g_State |= stateSignalCheckAt;
+    else
+        g_State &= ~stateSignalCheckAt;
+} //set_signal_check_at
+
+void x64::set_edge_coverage( uint8_t * map )
+{
+    edge_map = map;
+    edge_prev = 0;
+    note_block_hooks();
+} //set_edge_coverage
+
+void x64::set_code_map( uint8_t * map, uint64_t start, uint64_t length )
+{
+    code_map = map;
+    code_map_start = start;
+    code_map_size = length;
+    note_block_hooks();
+    if ( 0 != map )
+        map_code(); // blocks are otherwise noted when control is transferred to them
+} //set_code_map
+
+void x64::set_translations( const translation * table, uint64_t mask )
+{
+    translations = table;
+    translation_mask = mask;
+    note_block_hooks();
+    if ( 0 != table )
+        enter_translation();
+    else
+        g_State &= ~stateTranslated;
+} //set_translations
+
 static const char * register_names[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
 static const char * register_names32[16] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
 static const char * register_names16[16] = { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" };
@@ -112,7 +196,7 @@ template <typename T> inline void do_swap( T & a, T & b ) { T tmp = a; a = b; b
 #pragma GCC diagnostic ignored "-Wformat="
 #endif
 
-void x64::trace_state()
+void x64::trace_state( bool registers )
 {
     uint64_t rip_save = rip.q;
     uint8_t op = getui8( rip.q );
@@ -148,10 +232,20 @@ void x64::trace_state()
         strcat( symbol_offset, "\n             " );
     }
 
+    // the source line when it changes. the first call parses the app's debug info, so untraced runs don't pay for it
+
+    static char previous_line[ 400 ];
+    const char * line = emulator_line_lookup( ip );
+    if ( 0 != line[ 0 ] && strcmp( line, previous_line ) )
+    {
+        snprintf( previous_line, sizeof( previous_line ), "%s", line );
+        tracer.Trace( "line %s\n", line );
+    }
+
     static char reg_string[ 34 * 32 ];
     reg_string[ 0 ] = 0;
     int len = 0;
-    int reg_count = mode32 ? 8 : 16;
+    int reg_count = !registers ? 0 : mode32 ? 8 : 16;
     for ( uint8_t r = 0; r < reg_count; r++ )
         if ( 0 != regs[ r ].q )
             len += snprintf( & reg_string[ len ], 32, "%s:%llx ", register_name( r ), regs[ r ].q );
@@ -164,9 +258,18 @@ void x64::trace_state()
         len += snprintf( & reg_string[ len ], 32, "gs:%llx ", gs.q );
 #endif
 
+    // show the instruction's bytes, or the first 5 if it doesn't decode. short instructions are padded to line up
+
+    decoded_instruction decoded;
+    uint8_t length = decode_instruction( getmem( ip ), (size_t) get_min( (uint64_t) 15, base + mem_size - ip ), mode32, decoded ) ? decoded.length : 5;
+    char bytes[ 15 * 3 + 1 ];
+    int blen = 0;
+    for ( uint8_t b = 0; b < length; b++ )
+        blen += snprintf( bytes + blen, sizeof( bytes ) - blen, "%02x ", getui8( ip + b ) );
+
     // for __mc68000__ this must be slit into two traces
     tracer.Trace( "rip %8llx %s%s ", ip, symbol_name, symbol_offset );
-    tracer.Trace( "%02x %02x %02x %02x %02x %s%s => ", getui8( ip ), getui8( ip + 1 ), getui8( ip + 2 ), getui8( ip + 3 ), getui8( ip + 4 ), reg_string, render_flags() );
+    tracer.Trace( "%-15s%s%s => ", bytes, reg_string, registers ? render_flags() : "" );
 
     switch( op )
     {
@@ -2502,6 +2605,57 @@ void x64::trace_state()
     clear_decoding();
 } //trace_state
 
+void x64::trace_disassembly( uint64_t address )
+{
+    // consume prefixes the way run() does, then let trace_state() show the instruction. the prefix state of the
+    // current instruction is restored, so this is safe between instructions
+
+    if ( ( address < base ) || ( address + 15 > base + mem_size ) )
+    {
+        tracer.Trace( "rip %8llx is outside of app memory\n", address );
+        return;
+    }
+
+    uint64_t rip_save = rip.q;
+    uint8_t prefix_rex = _prefix_rex, prefix_size = _prefix_size, prefix_sse2_repeat = _prefix_sse2_repeat, prefix_segment = _prefix_segment;
+    _prefix_rex = _prefix_size = _prefix_sse2_repeat = _prefix_segment = 0;
+
+    rip.q = address;
+    for ( uint8_t i = 0; i < 14; i++ )
+    {
+        uint8_t op = getui8( rip.q );
+        if ( 0x66 == op || 0x67 == op )
+            _prefix_size = op;
+        else if ( 0x64 == op || 0x65 == op )
+            _prefix_segment = op;
+        else if ( 0xf2 == op || 0xf3 == op )
+            _prefix_sse2_repeat = op;
+        else if ( !mode32 && 0x40 == ( op & 0xf0 ) )
+            _prefix_rex = op;
+        else
+            break;
+        rip.q++;
+    }
+
+    disassembling = true;
+    try
+    {
+        trace_state( false );
+    }
+    catch ( exception & e )
+    {
+        tracer.Trace( "%s\n", e.what() );
+    }
+    disassembling = false;
+
+    rip.q = rip_save;
+    _prefix_rex = prefix_rex;
+    _prefix_size = prefix_size;
+    _prefix_sse2_repeat = prefix_sse2_repeat;
+    _prefix_segment = prefix_segment;
+    clear_decoding();
+} //trace_disassembly
+
 #ifdef _WIN32
 __declspec(noinline)
 #endif
@@ -2729,11 +2883,6 @@ template <typename T> T gen_bitmask( T n )
     return ( ~ (T) 0 ) >> ( ( 8 * sizeof( T ) ) - n );
 } //gen_bitmask
 
-template <typename T> T top2bits( T x )
-{
-    return ( 3 & ( x >> ( 6 + ( sizeof( T ) - 1 ) * 8 ) ) );
-} //top2bits
-
 void x64::op_stos( uint8_t width )
 {
     if ( 1 == width )
@@ -2797,62 +2946,6 @@ void x64::op_scas( uint8_t width )
         regs[ rdi ].q += width;
 } //op_scas
 
-template <typename T> T x64::op_sub( T a, T b, bool borrow )
-{
-#ifndef __APPLE__
-    static_assert( std::is_unsigned_v<T>, "Template parameter must be an unsigned type." );
-#endif
-    T result = a - b - (T) borrow;
-    set_PSZ( result );
-    setflag_c( ( a < b ) || ( ( a - b ) < (T) borrow ) ); // borrow if a < (b + borrow).
-
-    // Overflow occurs when subtracting a positive from a negative gives a positive or subtracting a negative from a positive gives a negative.
-    using ST = std::make_signed_t<T>;
-    ST a_s = (ST) a;
-    ST b_s = (ST) b;
-    ST result_s = (ST) result;
-    setflag_o( ( ( a_s ^ b_s ) < 0 ) && ( ( a_s ^ result_s ) < 0 ) ); // Overflow is detected if signs were different AND the result's sign is also different.
-    setflag_a( ( 0 != ( ( ( a & 0xf ) - ( b & 0xf ) - (T) borrow ) & ~0xf ) ) );
-    return result;
-} //op_sub
-
-template <typename T> T x64::op_add( T a, T b, bool carry )
-{
-#ifndef __APPLE__
-    static_assert( std::is_unsigned_v<T>, "Template parameter must be an unsigned type." );
-#endif
-    T result = a + b + (T) carry;
-    set_PSZ( result );
-    setflag_c( ( ( result < a || result < b ) ) || ( result < ( a + b ) ) );
-    setflag_o( ( ! val_signed( a ^ b ) ) && ( val_signed( a ^ result ) ) );
-    setflag_a( 0 != ( ( ( a & 0xf ) + ( b & 0xf ) + (T) carry ) & 0x10 ) );
-    return result;
-} //op_add
-
-template <typename T> T x64::op_xor( T a, T b )
-{
-    a ^= b;
-    set_PSZ( a );
-    reset_CO();
-    return a;
-} //op_xor
-
-template <typename T> T x64::op_and( T a, T b )
-{
-    a &= b;
-    set_PSZ( a );
-    reset_CO();
-    return a;
-} //op_xor
-
-template <typename T> T x64::op_or( T a, T b )
-{
-    a |= b;
-    set_PSZ( a );
-    reset_CO();
-    return a;
-} //op_or
-
 template <typename T> void x64::do_math( uint8_t math, T * pdst, T src )
 {
 #ifndef __APPLE__
@@ -2941,47 +3034,6 @@ template <typename T> void x64::op_rcr( T * pval, uint8_t shift )
     *pval = val;
 } //op_rcr
 
-template <typename T> void x64::op_sal( T * pval, uint8_t shift ) // aka shl
-{
-    T x = *pval;
-    if ( 1 == shift )
-        setflag_o( 3 == top2bits( x ) );
-
-    for ( uint8_t s = 0; s < shift; s++ )
-    {
-        setflag_c( val_signed( x ) );
-        x <<= 1;
-    }
-
-    *pval = x;
-    set_PSZ( x );
-} //op_sal
-
-template <typename T> void x64::op_shr( T * pval, uint8_t shift )
-{
-    T x = *pval;
-    if ( 1 == shift )
-        setflag_o( val_signed( x ) );
-    x >>= ( shift - 1 );
-    setflag_c( 0 != ( *pval & 1 ) );
-    x >>= 1;
-    *pval = x;
-    set_PSZ( x );
-} //op_shr
-
-template <typename T> void x64::op_sar( T * pval, uint8_t shift )
-{
-    using ST = std::make_signed_t<T>;
-    ST x = *pval;
-    if ( 1 == shift )
-        setflag_o( false );
-    x >>= ( shift - 1 );
-    setflag_c( 0 != ( *pval & 1 ) );
-    x >>= 1;
-    *pval = x;
-    set_PSZ( x );
-} //op_sar
-
 template <typename T> void x64::op_shift( T * pval, uint8_t operation, uint8_t shift )
 {
     if ( 0 == shift )
@@ -3006,6 +3058,9 @@ __declspec(noinline)
 #endif
 void x64::unhandled()
 {
+    if ( disassembling )
+        throw runtime_error( "instruction can't be disassembled" );
+
     printf( "\n  instruction_start: %llx, rip %llx, op %x, base %llx, mem_size %llx, stack_top %llx, stack_size %llx\n", _instruction_start, rip.q, getui8( rip.q ), base, mem_size, stack_top, stack_size );
     printf( "_prefix_rex %#x, _prefix_size %#x, _prefix_sse2_repeat %#x, _prefix_segment %#x\n", _prefix_rex, _prefix_size, _prefix_sse2_repeat, _prefix_segment );
     printf( "_rex.W %#x, _rex.R %#x, _rex.X %#x, _rex.B %#x\n", _rex.W, _rex.R, _rex.X, _rex.B );
@@ -3194,15 +3249,35 @@ void x64::decode_rm()
     _mod = ( modRM >> 6 );           // this indicates whether the _rm operand is a register or memory location
 
     decode_rex();                    // checking for mode32 here makes x32 a bit faster and x64 a bit more slower, so don't do it
+    _ea_base = 0;
 
     if ( _mod < 3 ) // if r/m refers to memory
     {
+        _displacement = 0;
         if ( 4 == saved_rm )
+        {
             decode_sib();
-        else if ( ( 2 == _mod ) || ( ( 0 == _mod ) && ( 5 == saved_rm ) ) ) // 32-bit displacement
+            if ( 4 == _sibIndex && ( 0 != _mod || 5 != ( _sibBase & 7 ) ) ) // [base] or [base + disp]. often rsp
+                _ea_base = & regs[ _sibBase ].q;
+        }
+        else if ( ( 0 == _mod ) && ( 5 == saved_rm ) ) // [rip + disp32]
+        {
             _displacement = sign_extend( get_rip32(), 31 );
-        else if ( 1 == _mod ) // 8-bit displacement
-            _displacement = sign_extend( get_rip8(), 7 );
+            _ea_base = & rip.q;
+        }
+        else
+        {
+            if ( 2 == _mod ) // 32-bit displacement
+                _displacement = sign_extend( get_rip32(), 31 );
+            else if ( 1 == _mod ) // 8-bit displacement
+                _displacement = sign_extend( get_rip8(), 7 );
+            _ea_base = & regs[ _rm ].q;
+        }
+
+        // segment prefixes and 32-bit addresses are rare enough to leave to full_effective_address()
+
+        if ( 0 != ( _prefix_segment | (uint8_t) mode32 ) )
+            _ea_base = 0;
     }
 } //decode_rm
 
@@ -3226,7 +3301,7 @@ const char * x64::register_name( uint8_t reg, uint8_t byte_width, bool is_xmm )
     return register_names[ reg ];
 } //register_name
 
-uint64_t x64::effective_address()
+uint64_t x64::full_effective_address()
 {
     uint64_t ea;
 
@@ -3288,7 +3363,7 @@ uint64_t x64::effective_address()
     }
 
     return lower32_address( ea );
-} //effective_address
+} //full_effective_address
 
 const char * x64::rm_displacement_string()
 {
@@ -3573,200 +3648,1587 @@ template <typename T> T x64::do_fmul( T a, T b )
     if ( ( ainf && bzero ) || ( azero && binf ) )
         return (T) -MY_NAN;
 
-    if ( ainf || binf )
-        return (T) set_double_sign( INFINITY, signbit( a ) != signbit( b ) );
+    if ( ainf || binf )
+        return (T) set_double_sign( INFINITY, signbit( a ) != signbit( b ) );
+
+    if ( azero || bzero )
+        return (T) set_double_sign( 0.0, signbit( a ) != signbit( b ) );
+
+    return a * b;
+} //do_fmul
+
+template <typename T> T x64::do_fdiv( T a, T b )
+{
+    if ( my_isnan( a ) || my_isnan( b ) )
+        return handle_math_nan( a, b );
+
+    bool ainf = isinf( a );
+    bool binf = isinf( b );
+    bool azero = ( 0.0 == a );
+    bool bzero = ( 0.0 == b );
+
+    if ( ainf && binf )
+        return (T) -MY_NAN;
+
+    if ( azero && bzero )
+        return (T) -MY_NAN;
+
+    if ( ainf )
+        return (T) set_double_sign( INFINITY, signbit( a ) != signbit( b ) );
+
+    if ( binf || azero )
+        return (T) set_double_sign( 0.0, signbit( a ) != signbit( b ) );
+
+    return a / b;
+} //do_fdiv
+
+const uint8_t ccB = 2;
+const uint8_t ccNB = 3;
+const uint8_t ccE = 4;
+const uint8_t ccNE = 5;
+const uint8_t ccBE = 6;
+const uint8_t ccNBE = 7;
+const uint8_t ccU = 10;
+const uint8_t ccNU = 11;
+
+const uint32_t fccG = 0;   // greater than floating condition code
+const uint32_t fccL = 1;   // less than
+const uint32_t fccE = 2;   // equal
+const uint32_t fccU = 3;   // unordered
+
+static const char * fcc_names[4] = { "equal", "less", "greater", "unordered" };
+
+template <typename T> inline uint32_t x64::compare_floating( T a, T b )
+{
+    #if defined( __clang__ ) // clang compares long doubles that are infinite incorrectly
+
+        tracer.Trace( "a %lf (nan %u, inf %u, subnormal %u), b %lf (nan %u, inf %u, subnormal %u)\n",
+                      (double) a, my_isnan( a ), my_isinf( a ), my_issubnormal( a ),
+                      (double) b, my_isnan( b ), my_isinf( b ), my_issubnormal( b ) );
+
+    #endif
+
+    if ( my_isnan( a ) || my_isnan( b ) )
+        return fccU;
+
+    if ( a == b )
+        return fccE;
+    if ( a < b )
+        return fccL;
+    if ( a > b )
+        return fccG;
+
+    return fccU;
+} //compare_floating
+
+void x64::set_x87_status_compare( uint32_t fcc )
+{
+    if ( fccG == fcc )
+        set_x87_status_c320( false, false, false );
+    else if ( fccL == fcc )
+        set_x87_status_c320( false, false, true );
+    else if ( fccE == fcc )
+        set_x87_status_c320( true, false, false );
+    else
+        set_x87_status_c320( true, true, true );
+} //set_x87_status_compare
+
+// match table 3-1 comparison predicates for cmppd and cmpps instructions
+
+static const bool floating_comparison_results[ 32 ][ 4 ] =                  // G      L      E      U
+{
+    /* EQ_OQ (EQ)  0H  Equal (ordered, non-signaling) */                    {  false, false, true,  false },
+    /* LT_OS (LT)  1H  Less-than (ordered, signaling) */                    {  false, true,  false, false },
+    /* LE_OS (LE)  2H  Less-than-or-equal (ordered, signaling) */           {  false, true,  true,  false },
+    /* UNORD_Q (UNORD) 3H  Unordered (non-signaling) */                     {  false, false, false, true },
+    /* NEQ_UQ (NEQ)    4H  Not-equal (unordered, non-signaling) */          {  true,  true,  false, true },
+    /* NLT_US (NLT)    5H  Not-less-than (unordered, signaling) */          {  true,  false, true,  true },
+    /* NLE_US (NLE)    6H  Not-less-than-or-equal (unordered, signaling) */ {  true,  false, false, true },
+    /* ORD_Q (ORD) 7H  Ordered (non-signaling) */                           {  true,  true,  true,  false },
+    /* EQ_UQ   8H  Equal (E) (unordered, non-signaling) */                  {  false, false, true,  true },
+    /* NGE_US (NGE) 9H  Not-greater-than-or-equal (unordered, signaling) */ {  false, true,  false, true },
+    /* NGT_US (NGT)    AH  Not-greater-than (unordered, signaling) */       {  false, true,  true,  true },
+    /* FALSE_OQ(FALSE) BH  False (ordered, non-signaling) */                {  false, false, false, false },
+    /* NEQ_OQ  CH (NE)  Not-equal (ordered, non-signaling) */               {  true,  true,  false, false },
+    /* GE_OS (GE)  DH  Greater-than-or-equal (ordered, signaling) */        {  true,  false, true,  false },
+    /* GT_OS (GT)  EH  Greater-than (ordered, signaling) */                 {  true,  false, false, false },
+    /* TRUE_UQ(TRUE)   FH  True (unordered, non-signaling) */               {  true,  true,  true,  true },
+    /* EQ_OS   10H Equal (ordered, signaling) */                            {  false, false, true,  false },
+    /* LT_OQ   11H Less-than (ordered, nonsignaling) */                     {  false, true,  false, false },
+    /* LE_OQ   12H Less-than-or-equal (ordered, nonsignaling) */            {  false, true,  true,  false },
+    /* UNORD_S 13H Unordered (signaling) */                                 {  false, false, false, true },
+    /* NEQ_US  14H Not-equal (unordered, signaling) */                      {  true,  true,  false, true },
+    /* NLT_UQ  15H Not-less-than (unordered, nonsignaling) */               {  true,  false, true,  true },
+    /* NLE_UQ  16H Not-less-than-or-equal (unordered, nonsignaling) */      {  true,  false, false, true },
+    /* ORD_S   17H Ordered (signaling) */                                   {  true,  true,  true,  false },
+    /* EQ_US   18H Equal (unordered, signaling) */                          {  false, false, true,  true },
+    /* NGE_UQ  19H Not-greater-than-or-equal (unordered, non-signaling) */  {  false, true,  false, true },
+    /* NGT_UQ  1AH Not-greater-than (unordered, nonsignaling) */            {  false, true,  true,  true },
+    /* FALSE_OS    1BH False (ordered, signaling) */                        {  false, false, false, false },
+    /* NEQ_OS  1CH Not-equal (ordered, signaling) */                        {  true,  true,  false, false },
+    /* GE_OQ   1DH Greater-than-or-equal (ordered, nonsignaling) */         {  true,  false, true,  false },
+    /* GT_OQ   1EH Greater-than (ordered, nonsignaling) */                  {  true,  false, false, false },
+    /* TRUE_US 1FH True (unordered, signaling) */                           {  true,  true,  true,  true }
+};
+
+template <typename T> inline bool x64::floating_comparison_true( T a, T b, uint8_t predicate )
+{
+    uint32_t fcc = compare_floating( a, b );
+    assert( fcc < 4 );
+    return floating_comparison_results[ predicate & 0x1f ][ fcc ];
+} //floating_comparison_true
+
+void x64::set_eflags_from_fcc( uint32_t fcc )
+{
+    setflag_o( false );
+    setflag_a( false );
+    setflag_s( false );
+
+    if ( fccU == fcc )
+    {
+        setflag_z( true );
+        setflag_p( true );
+        setflag_c( true );
+        return;
+    }
+    if ( fccG == fcc )
+    {
+        setflag_z( false );
+        setflag_p( false );
+        setflag_c( false );
+        return;
+    }
+    if ( fccL == fcc )
+    {
+        setflag_z( false );
+        setflag_p( false );
+        setflag_c( true );
+        return;
+    }
+
+    assert( fccE == fcc );
+    setflag_z( true );
+    setflag_p( false );
+    setflag_c( false );
+} //set_eflags_from_fcc
+
+// opcode shapes. the low bits say how the immediate is sized and the high bits are flags.
+// the table only describes encodings: lengths, r/m bytes, immediates, and control flow, for the code map, predecode,
+// the translator, and the bytes trace_state() shows. run() and trace_state() still switch on the opcode byte.
+// their cases hold each instruction's semantics and mnemonic, so a table lookup first would add a load and a
+// second dispatch per instruction in run() without removing a case. both also see prefixes one byte at a time
+// through run()'s loop, which decode_instruction() doesn't model.
+
+enum opcode_immediate : uint8_t { imm_none, imm_b, imm_w, imm_z, imm_v, imm_enter, imm_moffs, imm_rel8, imm_relz, imm_far };
+
+static const uint8_t shape_imm = 0x0f;
+static const uint8_t shape_modrm = 0x10;
+static const uint8_t shape_ends = 0x20;
+static const uint8_t shape_test = 0x40;     // f6 and f7: reg 0 and 1 of the r/m byte are test, which has an immediate
+static const uint8_t shape_indirect = 0x80; // ff: reg 2 through 5 of the r/m byte are indirect calls and jumps
+
+static const uint8_t vex_map1 = 4;         // table index of the vex 0x0f map
+
+struct opcode_row
+{
+    uint8_t map;
+    uint8_t first;
+    uint8_t last;
+    uint8_t shape;
+};
+
+static constexpr opcode_row opcode_rows[] =
+{
+    // one-byte opcodes not listed have no r/m byte or immediate. math ops fill 0x00..0x3f in columns of 8;
+    // the gaps between them are prefixes and ops that are only valid for x32
+
+    { 0, 0x00, 0x03, shape_modrm }, { 0, 0x04, 0x04, imm_b }, { 0, 0x05, 0x05, imm_z },
+    { 0, 0x08, 0x0b, shape_modrm }, { 0, 0x0c, 0x0c, imm_b }, { 0, 0x0d, 0x0d, imm_z },
+    { 0, 0x10, 0x13, shape_modrm }, { 0, 0x14, 0x14, imm_b }, { 0, 0x15, 0x15, imm_z },
+    { 0, 0x18, 0x1b, shape_modrm }, { 0, 0x1c, 0x1c, imm_b }, { 0, 0x1d, 0x1d, imm_z },
+    { 0, 0x20, 0x23, shape_modrm }, { 0, 0x24, 0x24, imm_b }, { 0, 0x25, 0x25, imm_z },
+    { 0, 0x28, 0x2b, shape_modrm }, { 0, 0x2c, 0x2c, imm_b }, { 0, 0x2d, 0x2d, imm_z },
+    { 0, 0x30, 0x33, shape_modrm }, { 0, 0x34, 0x34, imm_b }, { 0, 0x35, 0x35, imm_z },
+    { 0, 0x38, 0x3b, shape_modrm }, { 0, 0x3c, 0x3c, imm_b }, { 0, 0x3d, 0x3d, imm_z },
+    { 0, 0x62, 0x63, shape_modrm },                                    // bound (x32; 0x62 is evex for x64), movsxd
+    { 0, 0x68, 0x68, imm_z },                                          // push imm
+    { 0, 0x69, 0x69, shape_modrm | imm_z },                            // imul r, r/m, imm
+    { 0, 0x6a, 0x6a, imm_b },
+    { 0, 0x6b, 0x6b, shape_modrm | imm_b },
+    { 0, 0x70, 0x7f, shape_ends | imm_rel8 },                          // jcc rel8
+    { 0, 0x80, 0x80, shape_modrm | imm_b },                            // math r/m, imm
+    { 0, 0x81, 0x81, shape_modrm | imm_z },
+    { 0, 0x82, 0x83, shape_modrm | imm_b },
+    { 0, 0x84, 0x8f, shape_modrm },                                    // test, xchg, mov, lea, pop r/m
+    { 0, 0x9a, 0x9a, shape_ends | imm_far },                           // far call
+    { 0, 0xa0, 0xa3, imm_moffs },                                      // mov with a moffs address
+    { 0, 0xa8, 0xa8, imm_b },                                          // test al/ax, imm
+    { 0, 0xa9, 0xa9, imm_z },
+    { 0, 0xb0, 0xb7, imm_b },                                          // mov r8, imm8
+    { 0, 0xb8, 0xbf, imm_v },                                          // mov r, imm
+    { 0, 0xc0, 0xc1, shape_modrm | imm_b },                            // shift r/m, imm8
+    { 0, 0xc2, 0xc2, shape_ends | imm_w },                             // ret imm16
+    { 0, 0xc3, 0xc3, shape_ends },
+    { 0, 0xc4, 0xc5, shape_modrm },                                    // les and lds (x32; vex for x64)
+    { 0, 0xc6, 0xc6, shape_modrm | imm_b },                            // mov r/m, imm
+    { 0, 0xc7, 0xc7, shape_modrm | imm_z },
+    { 0, 0xc8, 0xc8, imm_enter },
+    { 0, 0xca, 0xca, shape_ends | imm_w },                             // far ret imm16
+    { 0, 0xcb, 0xcc, shape_ends },                                     // far ret, int 3
+    { 0, 0xcd, 0xcd, shape_ends | imm_b },                             // int
+    { 0, 0xce, 0xcf, shape_ends },                                     // into, iret
+    { 0, 0xd0, 0xd3, shape_modrm },                                    // shift r/m, 1 / cl
+    { 0, 0xd4, 0xd5, imm_b },                                          // aam, aad
+    { 0, 0xd8, 0xdf, shape_modrm },                                    // x87
+    { 0, 0xe0, 0xe3, shape_ends | imm_rel8 },                          // loop, jcxz
+    { 0, 0xe4, 0xe7, imm_b },                                          // in, out
+    { 0, 0xe8, 0xe9, shape_ends | imm_relz },                          // call, jmp rel
+    { 0, 0xea, 0xea, shape_ends | imm_far },                           // far jmp
+    { 0, 0xeb, 0xeb, shape_ends | imm_rel8 },                          // jmp rel8
+    { 0, 0xf4, 0xf4, shape_ends },                                     // hlt
+    { 0, 0xf6, 0xf6, shape_modrm | shape_test | imm_b },
+    { 0, 0xf7, 0xf7, shape_modrm | shape_test | imm_z },
+    { 0, 0xfe, 0xfe, shape_modrm },                                    // inc, dec r/m8
+    { 0, 0xff, 0xff, shape_modrm | shape_indirect },
+
+    // 0x0f opcodes have an r/m byte unless they're listed after the first row
+
+    { 1, 0x00, 0xff, shape_modrm },
+    { 1, 0x05, 0x05, shape_ends },                                     // syscall
+    { 1, 0x06, 0x06, 0 },
+    { 1, 0x07, 0x07, shape_ends },                                     // sysret
+    { 1, 0x08, 0x09, 0 },
+    { 1, 0x0b, 0x0b, shape_ends },                                     // ud2
+    { 1, 0x0e, 0x0e, 0 },
+    { 1, 0x0f, 0x0f, shape_modrm | imm_b },                            // 3dnow
+    { 1, 0x30, 0x33, 0 },                                              // wrmsr, rdtsc, rdmsr, rdpmc
+    { 1, 0x34, 0x35, shape_ends },                                     // sysenter, sysexit
+    { 1, 0x36, 0x37, 0 },
+    { 1, 0x70, 0x73, shape_modrm | imm_b },                            // pshuf and vector shifts by imm8
+    { 1, 0x77, 0x77, 0 },                                              // emms
+    { 1, 0x80, 0x8f, shape_ends | imm_relz },                          // jcc rel
+    { 1, 0xa0, 0xa2, 0 },                                              // push fs, pop fs, cpuid
+    { 1, 0xa4, 0xa4, shape_modrm | imm_b },                            // shld imm8
+    { 1, 0xa8, 0xaa, 0 },                                              // push gs, pop gs, rsm
+    { 1, 0xac, 0xac, shape_modrm | imm_b },                            // shrd imm8
+    { 1, 0xba, 0xba, shape_modrm | imm_b },                            // bt group imm8
+    { 1, 0xc2, 0xc2, shape_modrm | imm_b },                            // cmpps and friends
+    { 1, 0xc4, 0xc6, shape_modrm | imm_b },                            // pinsrw, pextrw, shufps
+    { 1, 0xc8, 0xcf, 0 },                                              // bswap
+
+    // 0x0f 0x38 and 0x0f 0x3a opcodes
+
+    { 2, 0x00, 0xff, shape_modrm },
+    { 3, 0x00, 0xff, shape_modrm | imm_b },
+
+    // vex and evex encode only vector ops. their 0x0f 0x38 and 0x0f 0x3a maps use the rows above
+
+    { vex_map1, 0x00, 0xff, shape_modrm },
+    { vex_map1, 0x70, 0x73, shape_modrm | imm_b },
+    { vex_map1, 0x77, 0x77, 0 },                                       // vzeroupper, vzeroall
+    { vex_map1, 0xc2, 0xc2, shape_modrm | imm_b },
+    { vex_map1, 0xc4, 0xc6, shape_modrm | imm_b },
+};
+
+struct opcode_shape_table
+{
+    uint8_t shape[ 5 ][ 256 ];
+
+    constexpr opcode_shape_table() : shape()
+    {
+        for ( const opcode_row & row : opcode_rows ) // later rows override earlier ones
+            for ( int op = row.first; op <= row.last; op++ )
+                shape[ row.map ][ op ] = row.shape;
+    }
+};
+
+static constexpr opcode_shape_table opcode_shapes;
+
+bool x64::decode_instruction( const uint8_t * p, size_t available, bool is32, decoded_instruction & d )
+{
+    // works for instructions run() doesn't implement as well as those it does.
+    // 0x67 selects 16-bit addressing in 32-bit mode and 32-bit addressing in 64-bit mode; only moffs and 16-bit r/m differ.
+
+    memset( &d, 0, sizeof( d ) );
+    size_t limit = ( available < 15 ) ? available : 15;
+    size_t i = 0;
+    uint8_t op = 0;
+
+    for ( ;; i++ )
+    {
+        if ( i >= limit )
+            return false;
+
+        op = p[ i ];
+        if ( 0x66 == op )
+            d.size16 = true;
+        else if ( 0x67 == op )
+            d.address_prefix = true;
+        else if ( !is32 && ( 0x40 == ( op & 0xf0 ) ) )
+        {
+            d.rex_w = ( 0 != ( op & 8 ) );
+            continue;
+        }
+        else if ( 0xf0 != op && 0xf2 != op && 0xf3 != op && 0x26 != op && 0x2e != op && 0x36 != op && 0x3e != op && 0x64 != op && 0x65 != op )
+            break;
+
+        d.rex_w = false; // rex is ignored unless it immediately precedes the opcode
+    }
+
+    i++;
+    uint8_t shape;
+
+    if ( ( 0xc4 == op || 0xc5 == op || 0x62 == op ) && ( !is32 || ( ( i < limit ) && ( 0xc0 == ( p[ i ] & 0xc0 ) ) ) ) ) // vex and evex
+    {
+        size_t payload = ( 0xc5 == op ) ? 1 : ( 0xc4 == op ) ? 2 : 3;
+        if ( i + payload >= limit )
+            return false;
+
+        d.vex = true;
+        d.map = ( 0xc5 == op ) ? 1 : ( p[ i ] & ( ( 0x62 == op ) ? 3 : 0x1f ) );
+        i += payload;
+        op = p[ i++ ];
+        shape = opcode_shapes.shape[ ( 1 == d.map ) ? vex_map1 : ( 3 == d.map ) ? 3 : 2 ][ op ]; // reserved maps are treated as 0x0f 0x38
+    }
+    else
+    {
+        if ( 0x0f == op )
+        {
+            if ( i >= limit )
+                return false;
+
+            d.map = 1;
+            op = p[ i++ ];
+            if ( 0x38 == op || 0x3a == op )
+            {
+                if ( i >= limit )
+                    return false;
+
+                d.map = ( 0x38 == op ) ? 2 : 3;
+                op = p[ i++ ];
+            }
+        }
+
+        shape = opcode_shapes.shape[ d.map ][ op ];
+    }
+
+    d.opcode = op;
+    d.ends = ( 0 != ( shape & shape_ends ) );
+    size_t z = d.size16 ? 2 : 4;
+    size_t imm = 0;
+
+    switch ( shape & shape_imm )
+    {
+        case imm_b: case imm_rel8: { imm = 1; break; }
+        case imm_w: { imm = 2; break; }
+        case imm_z: { imm = z; break; }
+        case imm_v: { imm = d.rex_w ? 8 : z; break; }
+        case imm_enter: { imm = 3; break; }
+        case imm_moffs: { imm = is32 ? ( d.address_prefix ? 2 : 4 ) : ( d.address_prefix ? 4 : 8 ); break; }
+        case imm_relz: { imm = is32 ? z : 4; break; }
+        case imm_far: // far call and jmp. invalid in 64-bit mode
+        {
+            if ( !is32 )
+                return false;
+            imm = z + 2;
+            break;
+        }
+        default: break;
+    }
+
+    d.relative = ( imm_rel8 == ( shape & shape_imm ) || imm_relz == ( shape & shape_imm ) );
+
+    if ( shape & shape_modrm )
+    {
+        if ( i >= limit )
+            return false;
+
+        d.modrm_offset = (uint8_t) i;
+        uint8_t m = p[ i++ ];
+        uint8_t mod = m >> 6;
+        uint8_t reg = ( m >> 3 ) & 7;
+        uint8_t rm = m & 7;
+
+        if ( 3 != mod )
+        {
+            if ( is32 && d.address_prefix ) // 16-bit addressing has no sib byte
+            {
+                if ( 1 == mod )
+                    i += 1;
+                else if ( 2 == mod || ( 0 == mod && 6 == rm ) )
+                    i += 2;
+            }
+            else
+            {
+                if ( 4 == rm )
+                {
+                    if ( i >= limit )
+                        return false;
+                    if ( 0 == mod && 5 == ( p[ i ] & 7 ) )
+                        i += 4;
+                    i++;
+                }
+
+                if ( 1 == mod )
+                    i += 1;
+                else if ( 2 == mod || ( 0 == mod && 5 == rm ) )
+                    i += 4;
+            }
+        }
+
+        if ( ( shape & shape_test ) && reg >= 2 ) // not, neg, mul, imul, div, and idiv have no immediate
+            imm = 0;
+        else if ( ( shape & shape_indirect ) && reg >= 2 && reg <= 5 )
+            d.ends = true;
+    }
+
+    d.imm_offset = (uint8_t) i;
+    d.imm_size = (uint8_t) imm;
+    i += imm;
+    if ( i > limit )
+        return false;
+
+    d.length = (uint8_t) i;
+    return true;
+} //decode_instruction
+
+uint8_t x64::code_map_entry( const uint8_t * p, size_t available, bool is32 )
+{
+    decoded_instruction d;
+    if ( !decode_instruction( p, available, is32, d ) )
+        return 0;
+
+    return d.length | ( d.ends ? code_map_ends : 0 );
+} //code_map_entry
+
+bool x64::code_map_target( const uint8_t * p, uint8_t entry, uint64_t address, bool is32, uint64_t & target )
+{
+    // jcc, jmp, call, loop, and jcxz with a relative displacement
+
+    if ( 0 == ( entry & code_map_ends ) )
+        return false;
+
+    decoded_instruction d;
+    size_t length = entry & code_map_length;
+    if ( !decode_instruction( p, length, is32, d ) || !d.relative || d.length != length )
+        return false;
+
+    const uint8_t * pimm = p + d.imm_offset;
+    int64_t displacement = 0;
+    if ( 1 == d.imm_size )
+        displacement = (int8_t) pimm[ 0 ];
+    else if ( 4 == d.imm_size )
+        displacement = (int32_t) ( pimm[ 0 ] | ( pimm[ 1 ] << 8 ) | ( pimm[ 2 ] << 16 ) | ( (uint32_t) pimm[ 3 ] << 24 ) );
+    else
+        return false; // 16-bit displacements wrap at 64k, which compiled code doesn't rely on
+
+    target = address + length + displacement;
+    return true;
+} //code_map_target
+
+uint64_t x64::predecode( uint8_t * map, const uint8_t * code, uint64_t code_start, uint64_t code_size, uint64_t start, uint64_t length, bool is32 )
+{
+    // decode from the start of a function to its end or to bytes that don't decode (e.g. data or unimplemented encodings).
+    // entries already present came from the cache, run(), or another function's walk and are trusted.
+
+    uint64_t decoded = 0;
+    uint64_t offset = start - code_start;
+    uint64_t end = get_min( offset + length, code_size );
+    bool block = true;
+
+    while ( offset < end )
+    {
+        uint8_t e = map[ offset ];
+        uint8_t original = e;
+        if ( 0 == ( e & code_map_length ) )
+        {
+            uint8_t found = code_map_entry( code + offset, (size_t) ( code_size - offset ), is32 );
+            if ( 0 == found )
+                break;
+
+            e |= found;
+            decoded++;
+        }
+
+        if ( block )
+            e |= code_map_block;
+
+        if ( e != original )
+            map[ offset ] = e;
+
+        uint64_t target;
+        if ( code_map_target( code + offset, e, code_start + offset, is32, target ) && ( target - code_start ) < code_size )
+        {
+            uint8_t * pt = map + ( target - code_start );
+            uint8_t t = *pt;
+            if ( 0 == ( t & code_map_block ) )
+                *pt = t | code_map_block;
+        }
+
+        block = ( 0 != ( e & code_map_ends ) );
+        offset += ( e & code_map_length );
+    }
+
+    return decoded;
+} //predecode
+
+void x64::run_block_hooks( bool edge )
+{
+    if ( edge && edge_map )
+    {
+        uint64_t cur = ( ( rip.q >> 4 ) ^ ( rip.q << 8 ) ) & ( edge_map_size - 1 );
+        edge_map[ cur ^ edge_prev ]++;
+        edge_prev = cur >> 1;
+    }
+
+    if ( code_map )
+        map_code();
+
+    if ( call_hooks )
+        check_call_hooks();
+
+    if ( translations )
+        enter_translation();
+} //run_block_hooks
+
+void x64::set_call_hooks( const uint64_t * addresses, size_t count )
+{
+    call_hooks = ( 0 != count ) ? addresses : 0;
+    call_hook_count = count;
+    return_hook = 0;
+    note_block_hooks();
+} //set_call_hooks
+
+void x64::check_call_hooks()
+{
+    uint64_t address = rip.q;
+    if ( address == return_hook )
+    {
+        return_hook = 0;
+        emulator_call_hook( *this, address, true );
+        return;
+    }
+
+    if ( address < call_hooks[ 0 ] || address > call_hooks[ call_hook_count - 1 ] )
+        return;
+
+    size_t lo = 0, hi = call_hook_count;
+    while ( lo < hi )
+    {
+        size_t mid = ( lo + hi ) / 2;
+        if ( call_hooks[ mid ] < address )
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if ( lo < call_hook_count && address == call_hooks[ lo ] )
+        emulator_call_hook( *this, address, false );
+} //check_call_hooks
+
+void x64::map_code()
+{
+    // called when a basic block is entered. the first time, walk it to its end, decoding instructions not already
+    // in the map. each instruction is walked once, so the cost is per distinct block rather than per instruction.
+
+    uint64_t offset = rip.q - code_map_start;
+    if ( offset >= code_map_size )
+        return;
+
+    uint8_t e = code_map[ offset ];
+    if ( ( code_map_run | code_map_block ) == ( e & ( code_map_run | code_map_block ) ) )
+        return;
+
+    if ( 0 == ( e & code_map_block ) )
+        code_map[ offset ] = ( e |= code_map_block );
+
+    while ( 0 == ( e & code_map_run ) )
+    {
+        uint8_t original = e;
+        if ( 0 == ( e & code_map_length ) )
+        {
+            e |= code_map_entry( getmem( code_map_start + offset ), (size_t) ( code_map_size - offset ), mode32 );
+            code_map_counts[ code_map_from_run ]++;
+        }
+        else
+            code_map_counts[ code_map_from_cache ]++;
+
+        e |= code_map_run;
+        if ( e != original )
+            code_map[ offset ] = e;
+
+        uint8_t length = e & code_map_length;
+        offset += length;
+        if ( 0 == length || ( e & code_map_ends ) || offset >= code_map_size )
+            break;
+
+        e = code_map[ offset ];
+    }
+} //map_code
+
+x64::translated_block x64::find_translation( uint64_t address )
+{
+    for ( uint64_t i = translation_slot( address ) & translation_mask; ; i = ( i + 1 ) & translation_mask )
+    {
+        if ( address == translations[ i ].address )
+            return translations[ i ].block;
+        if ( 0 == translations[ i ].address )
+            return 0;
+    }
+} //find_translation
+
+void x64::enter_translation()
+{
+    // translated blocks run from the top of run()'s loop while nothing else needs to see each instruction.
+    // edge coverage needs every control transfer, so it keeps the interpreter.
+
+    translation_resume = 0;
+    if ( ( 0 == edge_map ) && ( 0 != find_translation( rip.q ) ) )
+        g_State |= stateTranslated;
+    else
+        g_State &= ~stateTranslated;
+} //enter_translation
+
+uint64_t x64::run_translations()
+{
+    uint64_t executed = 0;
+    translation_resume = 0;
+
+    do
+    {
+        translated_block block = find_translation( rip.q );
+        if ( 0 == block )
+        {
+            g_State &= ~stateTranslated; // interpret until a control transfer lands on a translated block
+            break;
+        }
+
+        executed += block( *this );
+
+        #ifndef X64_NO_FLIGHT_RECORDER
+            flight_rips[ flight_count++ & ( flight_size - 1 ) ] = rip.q; // the interpreter recorded the entry of the first block
+        #endif
+    } while ( ( 0 == translation_resume ) && ( stateTranslated == pending_state() ) ); // a host signal can need the interpreter
+
+    translated_count += executed;
+    return executed;
+} //run_translations
+
+static const char * translated_type( uint8_t width )
+{
+    return ( 1 == width ) ? "uint8_t" : ( 2 == width ) ? "uint16_t" : ( 4 == width ) ? "uint32_t" : "uint64_t";
+} //translated_type
+
+static string translated_reg( uint8_t reg, uint8_t width, bool high_byte )
+{
+    // high_byte is true when an 8-bit reg without a rex prefix means ah, ch, dh, or bh
+
+    char ac[ 32 ];
+    if ( 1 == width && high_byte && reg >= 4 )
+        snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].h", reg & 3 );
+    else
+        snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].%s", reg, ( 1 == width ) ? "b" : ( 2 == width ) ? "w" : ( 4 == width ) ? "d" : "q" );
+    return ac;
+} //translated_reg
+
+// rflags bits tracked by the flag liveness pass in translate(): C P A Z S O
+
+static const uint16_t translated_flag_c = 0x001;
+static const uint16_t translated_flag_o = 0x800;
+static const uint16_t translated_flags_psz = 0x0c4;
+static const uint16_t translated_flags_logic = 0x8c5; // and, or, xor, and test leave A alone
+static const uint16_t translated_flags_all = 0x8d5;
+
+static uint16_t translated_condition_reads( uint8_t condition )
+{
+    // the flags check_condition() reads for each condition
+
+    static const uint16_t reads[ 8 ] = { 0x800, 0x001, 0x040, 0x041, 0x080, 0x004, 0x880, 0x8c0 };
+    return reads[ condition >> 1 ];
+} //translated_condition_reads
+
+static uint16_t translated_math_writes( uint8_t math )
+{
+    return ( 1 == math || 4 == math || 6 == math ) ? translated_flags_logic : translated_flags_all;
+} //translated_math_writes
+
+static string translated_math( uint8_t math, uint8_t width, const string & dst, const string & src, bool flags )
+{
+    // the same operations as do_math(). the caller stores the result unless math is 7 (cmp). when no flag the
+    // operation writes is read before being overwritten, the result is computed without them.
+
+    if ( flags )
+    {
+        static const char * ops[ 8 ] = { "op_add", "op_or", "op_add", "op_sub", "op_and", "op_sub", "op_xor", "op_sub" };
+        return string( "cpu." ) + ops[ math ] + "( " + dst + ", " + src + ( ( 2 == math || 3 == math ) ? ", cpu.flag_c() )" : " )" );
+    }
+
+    static const char * operators[ 8 ] = { " + ", " | ", " + ", " - ", " & ", " - ", " ^ ", " - " };
+    string carry = ( 2 == math ) ? " + cpu.flag_c()" : ( 3 == math ) ? " - cpu.flag_c()" : "";
+    return string( "(" ) + translated_type( width ) + ") ( " + dst + operators[ math ] + src + carry + " )";
+} //translated_math
+
+static string translated_imm( uint8_t width, uint64_t val )
+{
+    char ac[ 48 ];
+    snprintf( ac, sizeof( ac ), "(%s) %#llx", translated_type( width ), (unsigned long long) val );
+    return ac;
+} //translated_imm
+
+string x64::translated_ea( uint64_t next )
+{
+    // the same address effective_address() computes, as an expression. rip-relative addresses are constants
+
+    char ac[ 160 ];
+    char acdisp[ 32 ];
+    snprintf( acdisp, sizeof( acdisp ), "%s %#llx", ( _displacement < 0 ) ? "-" : "+", (unsigned long long) ( ( _displacement < 0 ) ? -_displacement : _displacement ) );
+
+    if ( 4 == ( _rm & 7 ) )
+    {
+        char acindex[ 48 ];
+        snprintf( acindex, sizeof( acindex ), "( cpu.regs[ %u ].q << %u )", _sibIndex, _sibScale );
+
+        if ( 0 == _mod )
+        {
+            if ( 4 == _sibIndex )
+            {
+                if ( 5 == ( _sibBase & 7 ) )
+                    snprintf( ac, sizeof( ac ), "(uint64_t) %lld", (long long) _displacement );
+                else
+                    snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q", _sibBase );
+            }
+            else if ( 5 == ( _sibBase & 7 ) )
+                snprintf( ac, sizeof( ac ), "%s %s", acindex, acdisp );
+            else
+                snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q + %s", _sibBase, acindex );
+        }
+        else if ( 4 == _sibIndex )
+            snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q %s", _sibBase, acdisp );
+        else
+            snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q + %s %s", _sibBase, acindex, acdisp );
+    }
+    else if ( 0 == _mod )
+    {
+        if ( 5 == ( _rm & 7 ) )
+            snprintf( ac, sizeof( ac ), "(uint64_t) %#llx", (unsigned long long) ( next + _displacement ) );
+        else
+            snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q", _rm );
+    }
+    else
+        snprintf( ac, sizeof( ac ), "cpu.regs[ %u ].q %s", _rm, acdisp );
+
+    string ea( ac );
+    if ( 0x64 == _prefix_segment )
+        ea += " + cpu.rfs.q";
+    else if ( 0x65 == _prefix_segment )
+        ea += " + cpu.rgs.q";
+    return ea;
+} //translated_ea
+
+string x64::translated_rm( uint8_t width )
+{
+    // memory operands refer to ea, which translate_instruction() declares
+
+    if ( _mod < 3 )
+        return string( "cpu.getui" ) + ( ( 1 == width ) ? "8" : ( 2 == width ) ? "16" : ( 4 == width ) ? "32" : "64" ) + "( ea )";
+    return translated_reg( _rm, width, 0 == _prefix_rex );
+} //translated_rm
+
+string x64::translated_set_rm( uint8_t width, const string & val, bool zero_extend )
+{
+    // like set_rm8() through set_rm64(). zero_extend picks set_rm32z() over set_rm32()
+
+    if ( _mod < 3 )
+        return string( "cpu.setui" ) + ( ( 1 == width ) ? "8" : ( 2 == width ) ? "16" : ( 4 == width ) ? "32" : "64" ) + "( ea, " + val + " );";
+    return translated_reg( _rm, ( 4 == width && zero_extend ) ? 8 : width, 0 == _prefix_rex ) + " = " + val + ";";
+} //translated_set_rm
+
+bool x64::translate_instruction( string & code, uint64_t address, uint64_t next, uint16_t live, uint16_t & reads, uint16_t & writes )
+{
+    // decode the instruction at address the way run() does, then write C++ with the same effect, flags included,
+    // following run()'s case for the opcode. returns false for instructions left to the interpreter.
+    // reads and writes are set to the flags the instruction reads and always writes. live is the flags read
+    // after the instruction before they're overwritten; when it writes none of them it skips computing flags.
+
+    reads = 0;
+    writes = 0;
+    rip.q = address;
+    _prefix_rex = 0;
+    _prefix_size = 0;
+    _prefix_sse2_repeat = 0;
+    _prefix_segment = 0;
+    clear_decoding();
+
+    uint8_t op;
+    for ( ;; )
+    {
+        op = get_rip8();
+        if ( 0x66 == op )
+            _prefix_size = op;
+        else if ( 0x64 == op || 0x65 == op )
+            _prefix_segment = op;
+        else if ( 0xf2 == op || 0xf3 == op )
+            _prefix_sse2_repeat = op;
+        else if ( 0x40 == ( op & 0xf0 ) )
+            _prefix_rex = op;
+        else if ( 0xf0 != op ) // lock is ignored
+            break;
+    }
+
+    // 16-bit operands, 32-bit addresses, and rep are rare in compiled code, so they're left to the interpreter.
+    // nop and endbr64 are the exceptions, since compilers pad and start functions with them.
+
+    bool is_nop = ( 0x90 == op ) || ( 0x0f == op && ( 0x1f == getui8( rip.q ) || 0x1e == getui8( rip.q ) ) );
+    if ( ( 0 != _prefix_size && !is_nop ) || ( 0 != _prefix_sse2_repeat && !( 0xf3 == _prefix_sse2_repeat && 0x0f == op ) ) )
+        return false;
+
+    string s;                        // the instruction's C++, which may refer to ea
+    bool uses_ea = false;
+    bool locals = false;             // s declares variables, so it needs a scope
+    bool flags = true;               // flags the instruction writes may be read
+    uint8_t w = 4;
+
+    if ( op < 0x40 && ( op & 7 ) < 6 ) // math
+    {
+        uint8_t math = ( op >> 3 ) & 7;
+        uint8_t form = op & 7;
+        bool store = ( 7 != math );
+        reads = ( 2 == math || 3 == math ) ? translated_flag_c : 0;
+        writes = translated_math_writes( math );
+        flags = ( 0 != ( writes & live ) );
+        if ( form <= 3 )
+        {
+            decode_rm();
+            uses_ea = ( _mod < 3 );
+            w = ( 0 == ( form & 1 ) ) ? 1 : _rex.W ? 8 : 4;
+            string reg = translated_reg( _reg, w, 0 == _prefix_rex );
+            if ( 0 == form || 1 == form ) // r/m, r
+            {
+                string m = translated_math( math, w, translated_rm( w ), reg, flags );
+                s = store ? translated_set_rm( w, m ) : m + ";";
+            }
+            else // r, r/m
+            {
+                string m = translated_math( math, w, reg, translated_rm( w ), flags );
+                s = !store ? m + ";" : ( 4 == w ) ? translated_reg( _reg, 8, false ) + " = " + m + ";" : reg + " = " + m + ";";
+            }
+        }
+        else if ( 4 == form ) // al, imm8
+        {
+            string m = translated_math( math, 1, "cpu.regs[ 0 ].b", translated_imm( 1, get_rip8() ), flags );
+            s = store ? "cpu.regs[ 0 ].b = " + m + ";" : m + ";";
+        }
+        else // eax, imm32 or rax, se( imm32 )
+        {
+            decode_rex();
+            w = _rex.W ? 8 : 4;
+            uint64_t imm = ( 8 == w ) ? (uint64_t) sign_extend( get_rip32(), 31 ) : get_rip32();
+            string m = translated_math( math, w, translated_reg( rax, w, false ), translated_imm( w, imm ), flags );
+            s = store ? "cpu.regs[ 0 ].q = " + m + ";" : m + ";";
+        }
+
+        if ( !store && !flags ) // a cmp nothing reads
+        {
+            s.clear();
+            uses_ea = false;
+        }
+    }
+    else
+    {
+        char ac[ 200 ];
+        switch ( op )
+        {
+            case 0x0f:
+            {
+                uint8_t op1 = get_rip8();
+                if ( 0x1e == op1 ) // endbr64 / endbr32
+                {
+                    uint8_t op2 = get_rip8();
+                    if ( 0xfa != op2 && 0xfb != op2 )
+                        return false;
+                }
+                else if ( 0 != _prefix_sse2_repeat )
+                    return false;
+                else if ( 0x1f == op1 ) // nopl
+                {
+                    uint8_t op2 = get_rip8();
+                    if ( 0x40 == op2 )
+                        rip.q += 1;
+                    else if ( 0x44 == op2 )
+                        rip.q += 2;
+                    else if ( 0x80 == op2 )
+                        rip.q += 4;
+                    else if ( 0x84 == op2 )
+                        rip.q += 5;
+                    else if ( 0 != op2 )
+                        return false;
+                }
+                else if ( op1 >= 0x40 && op1 <= 0x4f ) // cmovcc
+                {
+                    decode_rm();
+                    uses_ea = ( _mod < 3 );
+                    w = _rex.W ? 8 : 4;
+                    reads = translated_condition_reads( op1 & 0xf );
+                    snprintf( ac, sizeof( ac ), "if ( cpu.check_condition( %u ) ) cpu.regs[ %u ].q = ", op1 & 0xf, _reg );
+                    s = ac + translated_rm( w ) + ";";
+                }
+                else if ( op1 >= 0x80 && op1 <= 0x8f ) // jcc rel32
+                {
+                    reads = translated_condition_reads( op1 & 0xf );
+                    uint64_t target = next + sign_extend( get_rip32(), 31 );
+                    snprintf( ac, sizeof( ac ), "cpu.rip.q = cpu.check_condition( %u ) ? %#llx : %#llx;", op1 & 0xf, (unsigned long long) target, (unsigned long long) next );
+                    s = ac;
+                }
+                else if ( op1 >= 0x90 && op1 <= 0x9f ) // setcc
+                {
+                    decode_rm();
+                    uses_ea = ( _mod < 3 );
+                    reads = translated_condition_reads( op1 & 0xf );
+                    snprintf( ac, sizeof( ac ), "(uint8_t) cpu.check_condition( %u )", op1 & 0xf );
+                    s = translated_set_rm( 1, ac );
+                }
+                else if ( 0xaf == op1 ) // imul r, r/m
+                {
+                    decode_rm();
+                    uses_ea = ( _mod < 3 );
+                    locals = true;
+                    writes = translated_flag_c | translated_flag_o;
+                    string reg = "cpu.regs[ " + to_string( _reg ) + " ]";
+                    if ( 0 == ( writes & live ) ) // the low half of the product is the same signed or unsigned
+                        s = _rex.W ? reg + ".q = " + reg + ".q * " + translated_rm( 8 ) + ";" : reg + ".q = (uint32_t) ( " + reg + ".d * " + translated_rm( 4 ) + " );";
+                    else if ( _rex.W )
+                        s = "int64_t h = 0; int64_t l = CMultiply128::mul_s64_s64( cpu.regs[ " + to_string( _reg ) + " ].q, " + translated_rm( 8 ) + ", &h ); " +
+                            "cpu.setflag_o( val_signed( h ) != val_signed( l ) ); cpu.setflag_c( cpu.flag_o() ); cpu.regs[ " + to_string( _reg ) + " ].q = l;";
+                    else
+                        s = "int64_t a = x64::sign_extend( cpu.regs[ " + to_string( _reg ) + " ].d, 31 ); int64_t b = x64::sign_extend( " + translated_rm( 4 ) + ", 31 ); " +
+                            "int64_t r64 = a * b; uint32_t r32 = r64 & 0xffffffff; cpu.setflag_o( val_signed( r64 ) != val_signed( r32 ) ); cpu.setflag_c( cpu.flag_o() ); " +
+                            "cpu.regs[ " + to_string( _reg ) + " ].q = r32;";
+                }
+                else if ( 0xb6 == op1 || 0xb7 == op1 || 0xbe == op1 || 0xbf == op1 ) // movzx, movsx
+                {
+                    decode_rm();
+                    uses_ea = ( _mod < 3 );
+                    uint8_t from = ( 0xb6 == op1 || 0xbe == op1 ) ? 1 : 2;
+                    string val = translated_rm( from );
+                    if ( op1 >= 0xbe )
+                        val = string( _rex.W ? "x64::sign_extend( " : "x64::sign_extend32( " ) + val + ( ( 1 == from ) ? ", 7 )" : ", 15 )" );
+                    s = "cpu.regs[ " + to_string( _reg ) + " ].q = " + val + ";";
+                }
+                else
+                    return false;
+                break;
+            }
+            case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x57: // push
+            {
+                _rm = op & 7;
+                decode_rex();
+                s = "cpu.push( cpu.regs[ " + to_string( _rm ) + " ].q );";
+                break;
+            }
+            case 0x58: case 0x59: case 0x5a: case 0x5b: case 0x5c: case 0x5d: case 0x5e: case 0x5f: // pop
+            {
+                _rm = op & 7;
+                decode_rex();
+                s = "cpu.regs[ " + to_string( _rm ) + " ].q = cpu.pop();";
+                break;
+            }
+            case 0x63: // movsxd
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                s = "cpu.regs[ " + to_string( _reg ) + " ].q = " + ( _rex.W ? "x64::sign_extend( " + translated_rm( 4 ) + ", 31 );" : translated_rm( 4 ) + ";" );
+                break;
+            }
+            case 0x68: // push imm32
+            {
+                s = "cpu.push( " + translated_imm( 8, sign_extend( get_rip32(), 31 ) ) + " );";
+                break;
+            }
+            case 0x6a: // push imm8
+            {
+                s = "cpu.push( " + translated_imm( 8, (uint64_t) (int64_t) (int8_t) get_rip8() ) + " );";
+                break;
+            }
+            case 0x69: case 0x6b: // imul reg, r/m, imm
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                locals = true;
+                uint64_t imm = ( 0x69 == op ) ? get_rip32() : get_rip8();
+                string reg = "cpu.regs[ " + to_string( _reg ) + " ].q";
+                writes = translated_flag_c | translated_flag_o;
+                flags = ( 0 != ( writes & live ) );
+                if ( _rex.W )
+                {
+                    imm = ( 0x69 == op ) ? sign_extend( imm, 31 ) : sign_extend( imm, 7 );
+                    if ( !flags )
+                        s = reg + " = " + translated_rm( 8 ) + " * " + translated_imm( 8, imm ) + ";";
+                    else
+                        s = "int64_t h = 0; int64_t l = CMultiply128::mul_s64_s64( " + translated_rm( 8 ) + ", " + translated_imm( 8, imm ) + ", &h ); " +
+                        "cpu.setflag_o( val_signed( h ) != val_signed( l ) ); cpu.setflag_c( cpu.flag_o() ); " + reg + " = l;";
+                }
+                else
+                {
+                    if ( 0x6b == op )
+                        imm = sign_extend( imm, 7 ); // 0x69 uses the immediate zero-extended, as run() does
+                    if ( !flags )
+                        s = reg + " = (uint32_t) ( " + translated_rm( 4 ) + " * " + translated_imm( 4, imm & 0xffffffff ) + " );";
+                    else
+                        s = "uint64_t a = x64::sign_extend( " + translated_rm( 4 ) + ", 31 ); uint64_t b = " + translated_imm( 8, imm ) + "; " +
+                        "uint64_t r64 = a * b; uint32_t r32 = r64 & 0xffffffff; cpu.setflag_o( val_signed( r64 ) != val_signed( r32 ) ); cpu.setflag_c( cpu.flag_o() ); " + reg + " = r32;";
+                }
+                break;
+            }
+            case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x76: case 0x77: // jcc rel8
+            case 0x78: case 0x79: case 0x7a: case 0x7b: case 0x7c: case 0x7d: case 0x7e: case 0x7f:
+            {
+                reads = translated_condition_reads( op & 0xf );
+                uint64_t target = next + (int64_t) (int8_t) get_rip8();
+                snprintf( ac, sizeof( ac ), "cpu.rip.q = cpu.check_condition( %u ) ? %#llx : %#llx;", op & 0xf, (unsigned long long) target, (unsigned long long) next );
+                s = ac;
+                break;
+            }
+            case 0x80: case 0x81: case 0x83: // math r/m, imm
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = ( 0x80 == op ) ? 1 : _rex.W ? 8 : 4;
+                uint64_t imm = ( 0x81 == op ) ? get_rip32() : get_rip8();
+                if ( 0x83 == op )
+                    imm = sign_extend( imm, 7 );
+                else if ( 0x81 == op && 8 == w )
+                    imm = sign_extend( imm, 31 );
+                reads = ( 2 == _reg || 3 == _reg ) ? translated_flag_c : 0;
+                writes = translated_math_writes( _reg );
+                flags = ( 0 != ( writes & live ) );
+                string m = translated_math( _reg, w, translated_rm( w ), translated_imm( w, imm ), flags );
+                if ( 7 != _reg )
+                    s = translated_set_rm( w, m );
+                else if ( flags )
+                    s = m + ";";
+                else // a cmp nothing reads
+                    uses_ea = false;
+                break;
+            }
+            case 0x84: case 0x85: // test r/m, r
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = ( 0x84 == op ) ? 1 : _rex.W ? 8 : 4;
+                writes = translated_flags_logic;
+                if ( 0 != ( writes & live ) )
+                    s = "cpu.op_and( " + translated_rm( w ) + ", " + translated_reg( _reg, w, 0 == _prefix_rex ) + " );";
+                else // a test nothing reads
+                    uses_ea = false;
+                break;
+            }
+            case 0x88: case 0x89: // mov r/m, r
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = ( 0x88 == op ) ? 1 : _rex.W ? 8 : 4;
+                s = translated_set_rm( w, translated_reg( _reg, w, 0 == _prefix_rex ) );
+                break;
+            }
+            case 0x8a: case 0x8b: // mov r, r/m
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = ( 0x8a == op ) ? 1 : _rex.W ? 8 : 4;
+                s = translated_reg( _reg, ( 4 == w ) ? 8 : w, 0 == _prefix_rex ) + " = " + translated_rm( w ) + ";";
+                break;
+            }
+            case 0x8d: // lea
+            {
+                decode_rm();
+                if ( 3 == _mod )
+                    return false;
+                s = "cpu.regs[ " + to_string( _reg ) + " ].q = " + ( _rex.W ? "" : "0xffffffff & ( " ) + translated_ea( next ) + ( _rex.W ? ";" : " );" );
+                break;
+            }
+            case 0x90: // nop
+                break;
+            case 0x98: // cdqe / cwde
+            {
+                decode_rex();
+                s = _rex.W ? "cpu.regs[ 0 ].q = x64::sign_extend( cpu.regs[ 0 ].q, 31 );" : "cpu.regs[ 0 ].q = x64::sign_extend32( cpu.regs[ 0 ].d, 15 );";
+                break;
+            }
+            case 0x99: // cqo / cdq
+            {
+                decode_rex();
+                s = _rex.W ? "cpu.regs[ 2 ].q = val_signed( cpu.regs[ 0 ].q ) ? ~0ull : 0;" : "cpu.regs[ 2 ].q = val_signed( cpu.regs[ 0 ].d ) ? 0xffffffff : 0;";
+                break;
+            }
+            case 0xa8: // test al, imm8
+            {
+                writes = translated_flags_logic;
+                uint8_t imm = get_rip8();
+                if ( 0 != ( writes & live ) )
+                    s = "cpu.op_and( cpu.regs[ 0 ].b, " + translated_imm( 1, imm ) + " );";
+                break;
+            }
+            case 0xa9: // test eax, imm32 or rax, se( imm32 )
+            {
+                decode_rex();
+                w = _rex.W ? 8 : 4;
+                uint64_t imm = ( 8 == w ) ? (uint64_t) sign_extend( get_rip32(), 31 ) : get_rip32();
+                writes = translated_flags_logic;
+                if ( 0 != ( writes & live ) )
+                    s = "cpu.op_and( " + translated_reg( rax, w, false ) + ", " + translated_imm( w, imm ) + " );";
+                break;
+            }
+            case 0xb0: case 0xb1: case 0xb2: case 0xb3: case 0xb4: case 0xb5: case 0xb6: case 0xb7: // mov r8, imm8
+            {
+                _rm = op & 7;
+                _mod = 3;
+                decode_rex();
+                s = translated_set_rm( 1, translated_imm( 1, get_rip8() ) );
+                break;
+            }
+            case 0xb8: case 0xb9: case 0xba: case 0xbb: case 0xbc: case 0xbd: case 0xbe: case 0xbf: // mov r, imm
+            {
+                _rm = op & 7;
+                decode_rex();
+                uint64_t imm = _rex.W ? get_rip64() : get_rip32();
+                s = "cpu.regs[ " + to_string( _rm ) + " ].q = " + translated_imm( 8, imm ) + ";";
+                break;
+            }
+            case 0xc1: case 0xd1: case 0xd3: // shl / shr / sar r/m, imm8 or 1 or cl
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                if ( 4 != _reg && 5 != _reg && 7 != _reg )
+                    return false;
+                w = _rex.W ? 8 : 4;
+                uint8_t mask = ( 8 == w ) ? 0x3f : 0x1f;
+                uint8_t n = ( 0xd3 == op ) ? 0 : ( 0xd1 == op ) ? 1 : ( get_rip8() & mask );
+                if ( 0xd3 != op && 0 == n )
+                    return false;
+
+                // a count in cl may be 0 and leave the flags alone, so only an immediate count always writes them
+
+                uint16_t sets = translated_flag_c | translated_flags_psz | ( ( 1 == n || 0xd3 == op ) ? translated_flag_o : 0 );
+                if ( 0xd3 != op )
+                    writes = sets;
+                string shift;
+                if ( 0 != ( sets & live ) )
+                    shift = string( "cpu." ) + ( ( 4 == _reg ) ? "op_sal" : ( 5 == _reg ) ? "op_shr" : "op_sar" ) + "( &v, n );";
+                else if ( 7 == _reg )
+                    shift = string( "v = (" ) + translated_type( w ) + ") ( (" + ( ( 8 == w ) ? "int64_t" : "int32_t" ) + ") v >> n );";
+                else
+                    shift = ( 4 == _reg ) ? "v <<= n;" : "v >>= n;";
+
+                string get = string( translated_type( w ) ) + " v = " + translated_rm( w ) + "; ";
+                string set = translated_set_rm( w, "v" );
+                if ( 0xd3 == op )
+                    snprintf( ac, sizeof( ac ), "if ( 0 != cpu.regs[ 1 ].b ) { uint8_t n = cpu.regs[ 1 ].b & %#x; %sif ( 0 != n ) %s %s }",
+                              mask, get.c_str(), shift.c_str(), set.c_str() );
+                else
+                {
+                    snprintf( ac, sizeof( ac ), "const uint8_t n = %u; %s%s %s", n, get.c_str(), shift.c_str(), set.c_str() );
+                    locals = true;
+                }
+                s = ac;
+                break;
+            }
+            case 0xc2: // ret imm16
+            {
+                s = "cpu.rip.q = cpu.pop(); cpu.regs[ 4 ].q += " + to_string( get_rip16() ) + ";";
+                break;
+            }
+            case 0xc3: // ret
+            {
+                s = "cpu.rip.q = cpu.pop();";
+                break;
+            }
+            case 0xc6: case 0xc7: // mov r/m, imm
+            {
+                decode_rm();
+                if ( 0 != _reg )
+                    return false;
+                uses_ea = ( _mod < 3 );
+                w = ( 0xc6 == op ) ? 1 : _rex.W ? 8 : 4;
+                uint64_t imm = ( 1 == w ) ? get_rip8() : get_rip32();
+                if ( 8 == w )
+                    imm = sign_extend( imm, 31 );
+                s = translated_set_rm( w, translated_imm( w, imm ) );
+                break;
+            }
+            case 0xc9: // leave
+            {
+                s = "cpu.regs[ 4 ].q = cpu.regs[ 5 ].q; cpu.regs[ 5 ].q = cpu.pop();";
+                break;
+            }
+            case 0xe8: // call rel32
+            {
+                uint64_t target = next + sign_extend( get_rip32(), 31 );
+                snprintf( ac, sizeof( ac ), "cpu.push( %#llx ); cpu.rip.q = %#llx;", (unsigned long long) next, (unsigned long long) target );
+                s = ac;
+                break;
+            }
+            case 0xe9: case 0xeb: // jmp
+            {
+                uint64_t target = next + ( ( 0xe9 == op ) ? sign_extend( get_rip32(), 31 ) : sign_extend( get_rip8(), 7 ) );
+                snprintf( ac, sizeof( ac ), "cpu.rip.q = %#llx;", (unsigned long long) target );
+                s = ac;
+                break;
+            }
+            case 0xf6: case 0xf7:
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = ( 0xf6 == op ) ? 1 : _rex.W ? 8 : 4;
+                if ( 0 == _reg ) // test r/m, imm
+                {
+                    uint64_t imm = ( 1 == w ) ? get_rip8() : get_rip32();
+                    if ( 8 == w )
+                        imm = sign_extend( imm, 31 );
+                    writes = translated_flags_logic;
+                    if ( 0 != ( writes & live ) )
+                        s = "cpu.op_and( " + translated_rm( w ) + ", " + translated_imm( w, imm ) + " );";
+                    else // a test nothing reads
+                        uses_ea = false;
+                }
+                else if ( 1 == w )
+                    return false;
+                else if ( 2 == _reg ) // not. 32-bit registers aren't zero-extended, as in run()
+                    s = translated_set_rm( w, "~ " + translated_rm( w ), false );
+                else if ( 3 == _reg ) // neg. like run(), A and O are left alone
+                {
+                    writes = translated_flag_c | translated_flags_psz;
+                    if ( 0 != ( writes & live ) )
+                        s = string( translated_type( w ) ) + " v = " + translated_rm( w ) + "; cpu.setflag_c( 0 != v ); v = 0 - v; cpu.set_PSZ( v ); " +
+                            translated_set_rm( w, "v", false );
+                    else
+                        s = string( translated_type( w ) ) + " v = 0 - " + translated_rm( w ) + "; " + translated_set_rm( w, "v", false );
+                    locals = true;
+                }
+                else
+                    return false;
+                break;
+            }
+            case 0xff:
+            {
+                decode_rm();
+                uses_ea = ( _mod < 3 );
+                w = _rex.W ? 8 : 4;
+                if ( 0 == _reg || 1 == _reg ) // inc, dec. carry is unaffected and 32-bit registers aren't zero-extended, as in run()
+                {
+                    const char * overflow = ( 0 == _reg ) ? "0" : ( 8 == w ) ? "~0ull" : "0xffffffff";
+                    writes = translated_flags_psz | translated_flag_o;
+                    if ( 0 != ( writes & live ) )
+                        snprintf( ac, sizeof( ac ), "%s v = %s %s 1; cpu.set_PSZ( v ); cpu.setflag_o( %s == v ); ",
+                                  translated_type( w ), translated_rm( w ).c_str(), ( 0 == _reg ) ? "+" : "-", overflow );
+                    else
+                        snprintf( ac, sizeof( ac ), "%s v = %s %s 1; ", translated_type( w ), translated_rm( w ).c_str(), ( 0 == _reg ) ? "+" : "-" );
+                    s = ac + translated_set_rm( w, "v", false );
+                    locals = true;
+                }
+                else if ( 2 == _reg ) // call r/m. the return address is pushed before the operand is read
+                {
+                    uses_ea = false;
+                    snprintf( ac, sizeof( ac ), "cpu.push( %#llx ); cpu.rip.q = ", (unsigned long long) next );
+                    s = ac + ( ( _mod < 3 ) ? "cpu.getui64( " + translated_ea( next ) + " );" : translated_rm( 8 ) + ";" );
+                }
+                else if ( 4 == _reg ) // jmp r/m
+                {
+                    s = "cpu.rip.q = " + translated_rm( 8 ) + ";";
+                }
+                else if ( 6 == _reg ) // push r/m
+                    s = "cpu.push( " + translated_rm( 8 ) + " );";
+                else
+                    return false;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    if ( rip.q != next ) // decoding disagrees with the code map
+        return false;
 
-    if ( azero || bzero )
-        return (T) set_double_sign( 0.0, signbit( a ) != signbit( b ) );
+    if ( uses_ea )
+        code += "        { const uint64_t ea = " + translated_ea( next ) + "; " + s + " }\n";
+    else if ( locals )
+        code += "        { " + s + " }\n";
+    else if ( !s.empty() )
+        code += "        " + s + "\n";
 
-    return a * b;
-} //do_fmul
+    return true;
+} //translate_instruction
 
-template <typename T> T x64::do_fdiv( T a, T b )
+uint64_t x64::translate( string & code, uint64_t address, uint64_t & resume )
 {
-    if ( my_isnan( a ) || my_isnan( b ) )
-        return handle_math_nan( a, b );
-
-    bool ainf = isinf( a );
-    bool binf = isinf( b );
-    bool azero = ( 0.0 == a );
-    bool bzero = ( 0.0 == b );
-
-    if ( ainf && binf )
-        return (T) -MY_NAN;
-
-    if ( azero && bzero )
-        return (T) -MY_NAN;
-
-    if ( ainf )
-        return (T) set_double_sign( INFINITY, signbit( a ) != signbit( b ) );
+    // write the body of a function that runs the basic block at address, or as much of it as translates. a block
+    // ends at a control transfer or where another block starts. at an instruction that won't translate, rip is left
+    // there for the interpreter and resume is set to the next instruction in the block that does translate, if any.
+    // the first pass finds the instructions and the flags each reads and writes. flags are live at the block's
+    // exit since its successors aren't known, and walking backward from there gives the flags live after each
+    // instruction. the second pass writes the code, without flag computations no later instruction reads.
+
+    code.clear();
+    resume = 0;
+    if ( mode32 || 0 == code_map )
+        return 0;
 
-    if ( binf || azero )
-        return (T) set_double_sign( 0.0, signbit( a ) != signbit( b ) );
+    struct block_instruction { uint64_t address; uint8_t length; uint16_t reads; uint16_t writes; };
+    vector<block_instruction> instructions;
+    uint64_t saved_rip = rip.q;
+    uint64_t a = address;
+    bool ended = false;
+    string scratch;
+    uint16_t reads, writes;
 
-    return a / b;
-} //do_fdiv
+    for ( ;; )
+    {
+        uint64_t offset = a - code_map_start;
+        uint8_t e = ( offset < code_map_size ) ? code_map[ offset ] : 0;
+        uint8_t length = e & code_map_length;
+        if ( 0 == length || ( a != address && ( e & code_map_block ) ) )
+            break;
 
-const uint8_t ccB = 2;
-const uint8_t ccNB = 3;
-const uint8_t ccE = 4;
-const uint8_t ccNE = 5;
-const uint8_t ccBE = 6;
-const uint8_t ccNBE = 7;
-const uint8_t ccU = 10;
-const uint8_t ccNU = 11;
+        scratch.clear();
+        if ( !translate_instruction( scratch, a, a + length, translated_flags_all, reads, writes ) )
+        {
+            for ( uint64_t r = a + length; 0 == ( e & code_map_ends ); r += length )
+            {
+                offset = r - code_map_start;
+                e = ( offset < code_map_size ) ? code_map[ offset ] : 0;
+                length = e & code_map_length;
+                if ( 0 == length || ( e & code_map_block ) )
+                    break;
+                if ( translate_instruction( scratch, r, r + length, translated_flags_all, reads, writes ) )
+                {
+                    resume = r;
+                    break;
+                }
+            }
+            break;
+        }
 
-bool x64::check_condition( uint8_t condition )
-{
-    assert( condition < 16 );
-    switch( condition )
-    {                                                           //                   hints:
-        case 0:  return flag_o();                               // jo                o = overflow
-        case 1:  return !flag_o();                              // jno               n = not
-        case 2:  return flag_c();                               // jb / jnae / jc    b = below, ae = above or equal, c = carry. Unsigned here
-        case 3:  return !flag_c();                              // jnb / jae / jnc
-        case 4:  return flag_z();                               // je / jz           e = equal, z = zero
-        case 5:  return !flag_z();                              // jne / jnz
-        case 6:  return flag_c() || flag_z();                   // jbe / jna
-        case 7:  return !flag_c() && !flag_z();                 // jnbe / ja
-        case 8:  return flag_s();                               // js                s = signed
-        case 9:  return !flag_s();                              // jns
-        case 10: return flag_p();                               // jp / jpe          p / pe = parity even
-        case 11: return !flag_p();                              // jnp / jpo         po = parity odd
-        case 12: return ( flag_s() != flag_o() );               // jl / jnge         l = less than, nge = not greater than or equal. Signed here
-        case 13: return ( flag_s() == flag_o() );               // jnl / jge
-        case 14: return flag_z() || ( flag_s() != flag_o() );   // jle / jng         le = less than or equal, ng = not greather than
-        default: return !flag_z() && ( flag_s() == flag_o()  ); // jnle / jg         must be 15, but to work around a bogus compiler warning
+        instructions.push_back( { a, length, reads, writes } );
+        if ( e & code_map_ends )
+        {
+            ended = true;
+            break;
+        }
+        a += length;
     }
-} //check_condition
-
-const uint32_t fccG = 0;   // greater than floating condition code
-const uint32_t fccL = 1;   // less than
-const uint32_t fccE = 2;   // equal
-const uint32_t fccU = 3;   // unordered
 
-static const char * fcc_names[4] = { "equal", "less", "greater", "unordered" };
+    uint64_t count = instructions.size();
+    if ( 0 == count && 0 == resume )
+    {
+        rip.q = saved_rip;
+        return 0;
+    }
 
-template <typename T> inline uint32_t x64::compare_floating( T a, T b )
-{
-    #if defined( __clang__ ) // clang compares long doubles that are infinite incorrectly
+    vector<uint16_t> live( count );
+    uint16_t live_flags = translated_flags_all;
+    for ( size_t i = count; i > 0; i-- )
+    {
+        live[ i - 1 ] = live_flags;
+        live_flags = ( live_flags & ~instructions[ i - 1 ].writes ) | instructions[ i - 1 ].reads;
+    }
 
-        tracer.Trace( "a %lf (nan %u, inf %u, subnormal %u), b %lf (nan %u, inf %u, subnormal %u)\n",
-                      (double) a, my_isnan( a ), my_isinf( a ), my_issubnormal( a ),
-                      (double) b, my_isnan( b ), my_isinf( b ), my_issubnormal( b ) );
+    for ( size_t i = 0; i < count; i++ )
+    {
+        const block_instruction & bi = instructions[ i ];
+        char ac[ 80 ];
+        int len = snprintf( ac, sizeof( ac ), "        // %llx ", (unsigned long long) bi.address );
+        for ( uint8_t b = 0; b < bi.length; b++ )
+            len += snprintf( ac + len, sizeof( ac ) - len, " %02x", getui8( bi.address + b ) );
+        code += string( ac ) + "\n";
+        translate_instruction( code, bi.address, bi.address + bi.length, live[ i ], reads, writes );
+    }
 
-    #endif
+    rip.q = saved_rip;
 
-    if ( my_isnan( a ) || my_isnan( b ) )
-        return fccU;
+    char ac[ 100 ];
+    if ( !ended )
+    {
+        snprintf( ac, sizeof( ac ), "        cpu.rip.q = %#llx;\n", (unsigned long long) a );
+        code += ac;
+    }
 
-    if ( a == b )
-        return fccE;
-    if ( a < b )
-        return fccL;
-    if ( a > b )
-        return fccG;
+    if ( 0 != resume )
+    {
+        snprintf( ac, sizeof( ac ), "        cpu.translation_resume = %#llx;\n", (unsigned long long) resume );
+        code += ac;
+    }
 
-    return fccU;
-} //compare_floating
+    snprintf( ac, sizeof( ac ), "        return %llu;\n", (unsigned long long) count );
+    code += ac;
+    return count;
+} //translate
 
-void x64::set_x87_status_compare( uint32_t fcc )
+void x64::tally_events()
 {
-    if ( fccG == fcc )
-        set_x87_status_c320( false, false, false );
-    else if ( fccL == fcc )
-        set_x87_status_c320( false, false, true );
-    else if ( fccE == fcc )
-        set_x87_status_c320( true, false, false );
-    else
-        set_x87_status_c320( true, true, true );
-} //set_x87_status_compare
+    // peek at the instruction at rip before it executes. only the opcode and the mod bits of r/m are needed
+    // to tell branches, memory references, and the instruction set apart. taken conditional branches are
+    // found at the start of the following instruction by comparing rip with the branch's fall-through address.
 
-// match table 3-1 comparison predicates for cmppd and cmpps instructions
+    if ( 0 != event_fallthrough )
+    {
+        if ( rip.q != event_fallthrough )
+            events[ event_taken_branches ]++;
+        event_fallthrough = 0;
+    }
 
-static const bool floating_comparison_results[ 32 ][ 4 ] =                  // G      L      E      U
-{
-    /* EQ_OQ (EQ)  0H  Equal (ordered, non-signaling) */                    {  false, false, true,  false },
-    /* LT_OS (LT)  1H  Less-than (ordered, signaling) */                    {  false, true,  false, false },
-    /* LE_OS (LE)  2H  Less-than-or-equal (ordered, signaling) */           {  false, true,  true,  false },
-    /* UNORD_Q (UNORD) 3H  Unordered (non-signaling) */                     {  false, false, false, true },
-    /* NEQ_UQ (NEQ)    4H  Not-equal (unordered, non-signaling) */          {  true,  true,  false, true },
-    /* NLT_US (NLT)    5H  Not-less-than (unordered, signaling) */          {  true,  false, true,  true },
-    /* NLE_US (NLE)    6H  Not-less-than-or-equal (unordered, signaling) */ {  true,  false, false, true },
-    /* ORD_Q (ORD) 7H  Ordered (non-signaling) */                           {  true,  true,  true,  false },
-    /* EQ_UQ   8H  Equal (E) (unordered, non-signaling) */                  {  false, false, true,  true },
-    /* NGE_US (NGE) 9H  Not-greater-than-or-equal (unordered, signaling) */ {  false, true,  false, true },
-    /* NGT_US (NGT)    AH  Not-greater-than (unordered, signaling) */       {  false, true,  true,  true },
-    /* FALSE_OQ(FALSE) BH  False (ordered, non-signaling) */                {  false, false, false, false },
-    /* NEQ_OQ  CH (NE)  Not-equal (ordered, non-signaling) */               {  true,  true,  false, false },
-    /* GE_OS (GE)  DH  Greater-than-or-equal (ordered, signaling) */        {  true,  false, true,  false },
-    /* GT_OS (GT)  EH  Greater-than (ordered, signaling) */                 {  true,  false, false, false },
-    /* TRUE_UQ(TRUE)   FH  True (unordered, non-signaling) */               {  true,  true,  true,  true },
-    /* EQ_OS   10H Equal (ordered, signaling) */                            {  false, false, true,  false },
-    /* LT_OQ   11H Less-than (ordered, nonsignaling) */                     {  false, true,  false, false },
-    /* LE_OQ   12H Less-than-or-equal (ordered, nonsignaling) */            {  false, true,  true,  false },
-    /* UNORD_S 13H Unordered (signaling) */                                 {  false, false, false, true },
-    /* NEQ_US  14H Not-equal (unordered, signaling) */                      {  true,  true,  false, true },
-    /* NLT_UQ  15H Not-less-than (unordered, nonsignaling) */               {  true,  false, true,  true },
-    /* NLE_UQ  16H Not-less-than-or-equal (unordered, nonsignaling) */      {  true,  false, false, true },
-    /* ORD_S   17H Ordered (signaling) */                                   {  true,  true,  true,  false },
-    /* EQ_US   18H Equal (unordered, signaling) */                          {  false, false, true,  true },
-    /* NGE_UQ  19H Not-greater-than-or-equal (unordered, non-signaling) */  {  false, true,  false, true },
-    /* NGT_UQ  1AH Not-greater-than (unordered, nonsignaling) */            {  false, true,  true,  true },
-    /* FALSE_OS    1BH False (ordered, signaling) */                        {  false, false, false, false },
-    /* NEQ_OS  1CH Not-equal (ordered, signaling) */                        {  true,  true,  false, false },
-    /* GE_OQ   1DH Greater-than-or-equal (ordered, nonsignaling) */         {  true,  false, true,  false },
-    /* GT_OQ   1EH Greater-than (ordered, nonsignaling) */                  {  true,  false, false, false },
-    /* TRUE_US 1FH True (unordered, signaling) */                           {  true,  true,  true,  true }
-};
+    uint64_t a = rip.q;
+    uint8_t op = getui8( a );
+    uint8_t repeat = 0;
+    while ( 0x66 == op || 0x67 == op || 0xf2 == op || 0xf3 == op || 0xf0 == op || 0x64 == op || 0x65 == op ||
+            0x2e == op || 0x36 == op || 0x3e == op || 0x26 == op || ( !mode32 && ( 0x40 == ( op & 0xf0 ) ) ) )
+    {
+        if ( 0xf2 == op || 0xf3 == op )
+            repeat = op;
+        op = getui8( ++a );
+    }
 
-template <typename T> inline bool x64::floating_comparison_true( T a, T b, uint8_t predicate )
-{
-    uint32_t fcc = compare_floating( a, b );
-    assert( fcc < 4 );
-    return floating_comparison_results[ predicate & 0x1f ][ fcc ];
-} //floating_comparison_true
+    bool load = false, store = false;
+    bool mem = ( 3 != ( getui8( a + 1 ) >> 6 ) );   // only meaningful for opcodes with r/m
+    uint8_t reg = ( getui8( a + 1 ) >> 3 ) & 7;
 
-void x64::set_eflags_from_fcc( uint32_t fcc )
-{
-    setflag_o( false );
-    setflag_a( false );
-    setflag_s( false );
+    if ( 0x0f == op )
+    {
+        uint8_t op1 = getui8( a + 1 );
+        uint8_t modrm = getui8( a + ( ( 0x38 == op1 || 0x3a == op1 ) ? 3 : 2 ) );
+        mem = ( 3 != ( modrm >> 6 ) );
+        reg = ( modrm >> 3 ) & 7;
 
-    if ( fccU == fcc )
+        if ( op1 >= 0x80 && op1 <= 0x8f ) // jcc rel32
+        {
+            events[ event_branches ]++;
+            event_fallthrough = a + 6;
+            return;
+        }
+
+        if ( ( op1 >= 0x10 && op1 <= 0x17 ) || ( op1 >= 0x28 && op1 <= 0x2f ) || ( op1 >= 0x50 && op1 <= 0x7f ) ||
+             ( op1 >= 0xd0 ) || 0x38 == op1 || 0x3a == op1 || 0xc2 == op1 || ( op1 >= 0xc4 && op1 <= 0xc6 ) )
+        {
+            events[ event_sse ]++;
+            if ( mem )
+            {
+                if ( 0x11 == op1 || 0x13 == op1 || 0x17 == op1 || 0x29 == op1 || 0x2b == op1 || 0x7f == op1 || 0xd6 == op1 || 0xe7 == op1 ||
+                     ( 0x7e == op1 && 0xf3 != repeat ) || ( 0x3a == op1 && ( getui8( a + 2 ) >= 0x14 && getui8( a + 2 ) <= 0x17 ) ) )
+                    store = true;
+                else
+                    load = true;
+            }
+        }
+        else if ( mem )
+        {
+            if ( ( op1 >= 0x40 && op1 <= 0x4f ) || 0xaf == op1 || 0xa3 == op1 || 0xb6 == op1 || 0xb7 == op1 || 0xbe == op1 ||
+                 0xbf == op1 || 0xbc == op1 || 0xbd == op1 || ( 0xba == op1 && 4 == reg ) )
+                load = true;
+            else if ( op1 >= 0x90 && op1 <= 0x9f ) // setcc
+                store = true;
+            else if ( 0xab == op1 || 0xb3 == op1 || 0xbb == op1 || 0xba == op1 || 0xb0 == op1 || 0xb1 == op1 || 0xc0 == op1 ||
+                      0xc1 == op1 || 0xa4 == op1 || 0xa5 == op1 || 0xac == op1 || 0xad == op1 || 0xc7 == op1 )
+                load = store = true;
+            else if ( 0xae == op1 ) // ldmxcsr, stmxcsr, fxsave, fxrstor
+            {
+                if ( 0 == reg || 3 == reg )
+                    store = true;
+                else if ( 1 == reg || 2 == reg )
+                    load = true;
+            }
+        }
+    }
+    else if ( op < 0x40 && ( op & 7 ) < 4 ) // math with r/m
     {
-        setflag_z( true );
-        setflag_p( true );
-        setflag_c( true );
-        return;
+        if ( mem )
+        {
+            load = true;
+            store = ( 0 == ( op & 2 ) ) && ( 0x38 != ( op & 0x38 ) );
+        }
     }
-    if ( fccG == fcc )
+    else if ( op >= 0x50 && op <= 0x57 )
+        store = true;
+    else if ( op >= 0x58 && op <= 0x5f )
+        load = true;
+    else if ( op >= 0x70 && op <= 0x7f ) // jcc rel8
     {
-        setflag_z( false );
-        setflag_p( false );
-        setflag_c( false );
-        return;
+        events[ event_branches ]++;
+        event_fallthrough = a + 2;
     }
-    if ( fccL == fcc )
+    else if ( op >= 0xd8 && op <= 0xdf )
     {
-        setflag_z( false );
-        setflag_p( false );
-        setflag_c( true );
-        return;
+        events[ event_x87 ]++;
+        if ( mem )
+        {
+            if ( ( 0xd9 == op && ( 2 == reg || 3 == reg || 6 == reg || 7 == reg ) ) ||
+                 ( 0xdd == op && ( 1 == reg || 2 == reg || 3 == reg || 6 == reg || 7 == reg ) ) ||
+                 ( 0xdb == op && ( 1 == reg || 2 == reg || 3 == reg || 7 == reg ) ) ||
+                 ( 0xdf == op && ( 1 == reg || 2 == reg || 3 == reg || 6 == reg || 7 == reg ) ) )
+                store = true;
+            else
+                load = true;
+        }
+    }
+    else if ( op >= 0xe0 && op <= 0xe3 ) // loop, loope, loopne, jcxz
+    {
+        events[ event_branches ]++;
+        event_fallthrough = a + 2;
+    }
+    else
+    {
+        switch ( op )
+        {
+            case 0x68: case 0x6a: case 0x9c: store = true; break;           // push imm, pushf
+            case 0x9d: case 0xc9: case 0xa0: case 0xa1: case 0xac: case 0xad: case 0xa6: case 0xa7: case 0xae: case 0xaf: load = true; break;
+            case 0xa2: case 0xa3: case 0xaa: case 0xab: store = true; break;  // mov moffs, stos
+            case 0xa4: case 0xa5: load = store = true; break;                 // movs
+            case 0x63: case 0x69: case 0x6b: case 0x84: case 0x85: case 0x8a: case 0x8b: load = mem; break;
+            case 0x88: case 0x89: case 0xc6: case 0xc7: store = mem; break;
+            case 0x86: case 0x87: case 0xc0: case 0xc1: case 0xd0: case 0xd1: case 0xd2: case 0xd3: load = store = mem; break;
+            case 0x8f: load = true; store = mem; break;                       // pop r/m
+            case 0x80: case 0x81: case 0x82: case 0x83: load = mem; store = mem && ( 7 != reg ); break;
+            case 0xf6: case 0xf7: load = mem; store = mem && ( 2 == reg || 3 == reg ); break;
+            case 0xc2: case 0xc3: events[ event_branches ]++; events[ event_taken_branches ]++; load = true; break;
+            case 0xe8: events[ event_branches ]++; events[ event_taken_branches ]++; store = true; break;
+            case 0xe9: case 0xeb: events[ event_branches ]++; events[ event_taken_branches ]++; break;
+            case 0xfe: case 0xff:
+            {
+                if ( reg <= 1 )
+                    load = store = mem;
+                else if ( 2 == reg || 4 == reg ) // call or jmp indirect
+                {
+                    events[ event_branches ]++;
+                    events[ event_taken_branches ]++;
+                    load = mem;
+                    store = ( 2 == reg );
+                }
+                else if ( 6 == reg ) // push r/m
+                {
+                    load = mem;
+                    store = true;
+                }
+                break;
+            }
+            default: break;
+        }
     }
 
-    assert( fccE == fcc );
-    setflag_z( true );
-    setflag_p( false );
-    setflag_c( false );
-} //set_eflags_from_fcc
+    if ( load )
+        events[ event_loads ]++;
+    if ( store )
+        events[ event_stores ]++;
+} //tally_events
 
-uint64_t x64::run()
+template <bool exact> bool x64::run_loop( uint64_t & count, uint64_t & boundary )
 {
-    uint64_t instruction_count = 0;
+    uint64_t instruction_count = count; // locals so they can live in registers
+    uint64_t boundary_count = boundary; // instruction_count when the work below was last done. prefixes revisit the loop top
+    bool resume = true;                 // false once run() should return
 
     for ( ;; )
     {
+        if ( exact && ( 0 == pending_state() ) ) // nothing needs each instruction anymore
+            break;
+
         #ifndef NDEBUG
             _instruction_start = rip.q; // just for debugging; should probably remove for performance
         #endif
@@ -3780,9 +5242,10 @@ uint64_t x64::run()
 _prefix_is_set:
 
         #ifndef NDEBUG
-            if ( regs[ rsp ].q <= ( stack_top - stack_size ) )
+            bool alt_stack = ( regs[ rsp ].q > alt_stack_low ) && ( regs[ rsp ].q <= alt_stack_high );
+            if ( !alt_stack && regs[ rsp ].q <= ( stack_top - stack_size ) )
                 emulator_hard_termination( *this, "stack pointer is below stack memory:", regs[ rsp ].q );
-            if ( regs[ rsp ].q > stack_top + 0x100 ) // give space to get at arguments and AT records
+            if ( !alt_stack && regs[ rsp ].q > stack_top + 0x100 ) // give space to get at arguments and AT records
                 emulator_hard_termination( *this, "stack pointer is above the top of its starting point:", regs[ rsp ].q );
             if ( rip.q < base )
                 emulator_hard_termination( *this, "rip is lower than memory:", rip.q );
@@ -3796,16 +5259,67 @@ _prefix_is_set:
             #endif
         #endif
 
-        if ( 0 != g_State )         // 1.1% of runtime
+        if ( exact && ( 0 != g_State ) )
         {
             if ( g_State & stateEndEmulation )
             {
                 g_State &= ~stateEndEmulation;
+                resume = false;
+                break;
+            }
+
+            if ( ( g_State & stateInstructionLimit ) && ( instruction_count > g_InstructionLimit ) )
+            {
+                g_State &= ~stateInstructionLimit; // first true at the top of the loop, never after a prefix byte is consumed
+                instruction_count--;               // this instruction hasn't executed yet
+                resume = false;
                 break;
             }
 
             if ( ( g_State & stateTraceInstructions ) && tracer.IsEnabled() )
                 trace_state();
+
+            if ( ( stateTranslated == g_State ) && ( boundary_count != instruction_count ) )
+            {
+                boundary_count = instruction_count;
+                if ( ( 0 == translation_resume ) || ( rip.q == translation_resume ) )
+                {
+                    uint64_t executed = run_translations();
+                    if ( 0 != executed )
+                    {
+                        instruction_count += executed - 1; // the loop top counts the instruction now at rip
+                        continue;
+                    }
+                }
+            }
+
+            if ( ( g_State & ( stateCountEvents | stateSignalCheck | stateSignalCheckAt ) ) && ( boundary_count != instruction_count ) )
+            {
+                boundary_count = instruction_count;
+
+                if ( ( g_State & stateSignalCheckAt ) && ( retired_at_run + instruction_count > g_SignalCheckAt ) )
+                {
+                    g_State &= ~stateSignalCheckAt;
+                    g_State |= stateSignalCheck;
+                }
+
+                if ( g_State & stateSignalCheck ) // deliver before tallying so the handler's first instruction is what's counted
+                {
+                    g_State &= ~stateSignalCheck;
+                    retired = retired_at_run + instruction_count - 1;
+                    emulator_check_signals( *this );
+                    enter_block();
+
+                    if ( g_State & stateEndEmulation ) // the signal terminated the app
+                    {
+                        instruction_count--;
+                        continue;
+                    }
+                }
+
+                if ( g_State & stateCountEvents )
+                    tally_events();
+            }
         }
 
         uint8_t op = get_rip8();    // 18% of runtime
@@ -3911,7 +5425,11 @@ _prefix_is_set:
                 {
                     case 5: // syscall  64-bit linux
                     {
+                        retired = retired_at_run + instruction_count;
                         emulator_invoke_svc( *this );
+                        enter_block();
+                        if ( !exact && ( 0 != pending_state() ) )
+                            goto _switch_loops;
                         break;
                     }
                     case 0x10:
@@ -4195,8 +5713,9 @@ _prefix_is_set:
                     }
                     case 0x31: // rdtsc.  return cycle count in edx:eax. use instruction count instead, which is a reasonable proxy
                     {
-                        regs[ rdx ].q = (uint32_t) ( instruction_count >> 32 );
-                        regs[ rax ].q = (uint32_t) ( instruction_count & 0xffffffff );
+                        uint64_t tsc = retired_at_run + instruction_count;
+                        regs[ rdx ].q = (uint32_t) ( tsc >> 32 );
+                        regs[ rax ].q = (uint32_t) ( tsc & 0xffffffff );
                         break;
                     }
                     case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47: // cmovcc reg, r/
@@ -5046,6 +6565,9 @@ _prefix_is_set:
                         uint32_t offset = get_rip32();
                         if ( check_condition( op1 & 0xf ) )
                             rip.q += sign_extend( offset, 31 );
+                        record_edge();
+                        if ( !exact && ( 0 != pending_state() ) )
+                            goto _switch_loops;
                         break;
                     }
                     case 0x90: case 0x91: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: // setcc
@@ -6403,6 +7925,9 @@ _prefix_is_set:
                 int16_t offset = (int16_t) (int8_t) get_rip8();
                 if ( check_condition( op & 0xf ) )
                     rip.q += offset;
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0x80: // math r/m8, i8
@@ -6860,11 +8385,17 @@ _prefix_is_set:
                 uint16_t imm16 = get_rip16();
                 rip.q = pop();
                 regs[ rsp ].q += imm16;
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xc3: // ret
             {
                 rip.q = pop();
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xc6:
@@ -6931,7 +8462,13 @@ _prefix_is_set:
             {
                 uint8_t i = get_rip8();
                 if ( 0x80 == i ) // 32-bit linux syscall
+                {
+                    retired = retired_at_run + instruction_count;
                     emulator_invoke_svc( *this );
+                    enter_block();
+                    if ( !exact && ( 0 != pending_state() ) )
+                        goto _switch_loops;
+                }
                 else
                     unhandled();
                 break;
@@ -7543,6 +9080,9 @@ _prefix_is_set:
 
                 if ( ( !count_zero ) && ( ( 0xe2 == op ) || ( ( 0xe1 == op ) && flag_z() ) || ( ( 0xe0 == op ) && !flag_z() ) ) )
                     rip.q += rel;
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xe3: // jcxz / jecxz / jrcxz rel8
@@ -7559,6 +9099,9 @@ _prefix_is_set:
 
                 if ( jump )
                     rip.q += rel;
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xe8: // call rel32
@@ -7566,16 +9109,25 @@ _prefix_is_set:
                 uint32_t offset = get_rip32();
                 push( rip.q );
                 rip.q += (int32_t) offset;
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xe9: // jmp cd  (relative to rip sign-extended 32-bit immediate)
             {
                 rip.q += (int64_t) (int32_t) get_rip32();
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xeb: // jmp
             {
                 rip.q += (int64_t) (int8_t) get_rip8();
+                record_edge();
+                if ( !exact && ( 0 != pending_state() ) )
+                    goto _switch_loops;
                 break;
             }
             case 0xf0: // lock (do nothing since there is just one thread and core supported
@@ -7590,6 +9142,8 @@ _prefix_is_set:
             case 0xf4: // hlt
             {
                 g_State |= stateEndEmulation; // exit this function and catch fire
+                if ( !exact )
+                    goto _switch_loops;
                 break;
             }
             case 0xf5: // cmc complement carry flag
@@ -7949,6 +9503,9 @@ _prefix_is_set:
                             rip.q = get_rm32();
                         else
                             rip.q = get_rm64();
+                        record_edge();
+                        if ( !exact && ( 0 != pending_state() ) )
+                            goto _switch_loops;
                         break;
                     }
                     case 3: // call  (inter-segment)
@@ -7959,6 +9516,9 @@ _prefix_is_set:
                             rip.q = get_rm32();
                         else
                             rip.q = get_rm64();
+                        record_edge();
+                        if ( !exact && ( 0 != pending_state() ) )
+                            goto _switch_loops;
                         break;
                     }
                     case 5: // jmp  (inter-segment)
@@ -7982,5 +9542,27 @@ _prefix_is_set:
         } //switch
     } //for
 
+_switch_loops:
+    count = instruction_count;
+    boundary = boundary_count;
+    return resume;
+} //run_loop
+
+uint64_t x64::run()
+{
+    // instructions run in one of two loops. the fast loop only looks at pending_state() where a basic block can end: after
+    // control transfers, syscalls, and hlt. that's where the app, the emulator, and host signals have their effect,
+    // and it's soon enough for all of them. the exact loop checks g_State before each instruction for tracing,
+    // instruction limits, event counts, signal deadlines, and translated blocks, and hands back once g_State is 0.
+    // instruction_count is exact in both loops, so rdtsc and syscalls see precise counts mid-block.
+
+    uint64_t instruction_count = 0;
+    uint64_t boundary_count = 0;
+    retired_at_run = retired;
+
+    while ( ( 0 != pending_state() ) ? run_loop<true>( instruction_count, boundary_count ) : run_loop<false>( instruction_count, boundary_count ) )
+        continue;
+
+    retired = retired_at_run + instruction_count;
     return instruction_count;
 } //run
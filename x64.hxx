@@ -1,15 +1,29 @@
 #pragma once
 
 #include <bitset>
+#include <string>
+#include <type_traits>
+#include <cstddef>
 #include <djl_os.hxx>
 #include "f80_double.h"
 
 struct x64;
 
+// library builds (X64OS_LIBRARY, see libx64os.hxx) run independent emulators on separate threads, so global emulator state is per-thread
+
+#ifdef X64OS_LIBRARY
+    #define EMULATOR_THREAD_LOCAL thread_local
+#else
+    #define EMULATOR_THREAD_LOCAL
+#endif
+
 extern void emulator_invoke_svc( x64 & cpu );                                                // called when the syscall instruction is executed
 extern const char * emulator_symbol_lookup( uint64_t address, uint64_t & offset );           // returns the best guess for a symbol name and offset for the address
 extern const char * emulator_symbol_lookup( uint32_t address, uint32_t & offset );           // returns the best guess for a symbol name and offset for the address
+extern const char * emulator_line_lookup( uint64_t address );                                // source file:line and inlined functions from debug info, or ""
 extern void emulator_hard_termination( x64 & cpu, const char *pcerr, uint64_t error_value ); // show an error and exit
+extern void emulator_check_signals( x64 & cpu );                                             // called at an instruction boundary to deliver signals
+extern void emulator_call_hook( x64 & cpu, uint64_t address, bool returned );                // control reached a call or return hook; see set_call_hooks()
 
 template <typename T> inline bool val_signed( T x )
 {
@@ -29,6 +43,11 @@ template <typename T> inline T mk_signed( T x )
     return ( x | hibit );
 } //mk_signed
 
+template <typename T> T top2bits( T x )
+{
+    return ( 3 & ( x >> ( 6 + ( sizeof( T ) - 1 ) * 8 ) ) );
+} //top2bits
+
 typedef struct vec16_t // 16-byte vector
 {
     #ifdef TARGET_BIG_ENDIAN
@@ -118,6 +137,15 @@ typedef struct REXInfo
 #define NATIVE_LONG_DOUBLE 0         // use 8-byte long double with a loss in precision
 #endif
 
+// integer math flags can come from running the same instruction on the host. build with X64_PORTABLE_FLAGS to
+// use the portable C++ everywhere. flagtest.cxx checks that the two agree and that the portable code matches a reference model.
+
+#if defined( __GNUC__ ) && defined( __amd64__ ) && !defined( X64_PORTABLE_FLAGS )
+#define X64_HOST_FLAGS 1             // add, sub, and, or, xor, shl, shr, and sar flags from the host's lahf and seto
+#else
+#define X64_HOST_FLAGS 0             // flags computed in portable C++
+#endif
+
 typedef struct float80_t // 10-byte x87 floating point register
 {
     public:
@@ -173,13 +201,49 @@ struct x64
     static const size_t r14 = 14;
     static const size_t r15 = 15;
 
+    // state is ordered for the cache. the first three cache lines hold what nearly every integer instruction
+    // uses: the registers, rip, rflags, the memory base, and decoding state. colder state follows, then the sse and
+    // x87 registers, aligned for vector loads. the constructor checks the layout, so keep new hot fields in range.
+
+    reg8_t regs[ 16 ];               // rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8..r15
+    reg8_t rip;                      // instruction pointer
+    uint8_t * membase;               // host pointer to base of vm's memory
+
+private:
+                      // 0                                   8                                16
+    uint64_t rflags;  // C, n/a, P, n/a, A, n/a, Z, S,   :   T, I, D, O, IOPL+IOPL, n/a   :   RF, VM, AC, VIF, VIP, ID, 22.31 n/a
+
+    // decoding state
+
+    uint64_t _instruction_start;        // rip where decoding of the current instruction started
+    int64_t _displacement;
+    uint64_t * _ea_base;                // when non-0, decode_rm() found the effective address is *_ea_base + _displacement
+    REXInfo _rex;
+    uint8_t _prefix_rex;                // 0 for none. 0x4x
+    uint8_t _prefix_size;               // 0 for none. can be 0x66 (operand size 16) or 0x67 (address size 32)
+    uint8_t _prefix_sse2_repeat;        // 0 for none. f2 repne/repnz, f3 rep/repe/repz. f3 can also mean multibyte. f2 can also mean bnd (memory protection)
+    uint8_t _prefix_segment;            // 0 for none. 0x64 for fs: or 0x65 for gs:
+    uint8_t _rm, _reg, _mod;
+    uint8_t _sibScale, _sibIndex, _sibBase;
+    bool block_hooks;                   // edge_map, code_map, translations, or call_hooks is set, so block entries need run_block_hooks()
+
+public:
+    bool mode32;                     // true for 32-bit CPU vs 64-bit
+
     bool trace_instructions( bool trace );         // enable/disable tracing each instruction
     void end_emulation( void );                    // make the emulator return at the start of the next instruction
+    void set_instruction_limit( uint64_t limit );  // make run() return once this many instructions have executed. 0 means no limit
+    void set_edge_coverage( uint8_t * map );       // update this AFL-style 64k edge-coverage bitmap on control transfers. 0 to disable
+    bool count_events( bool count );               // enable/disable updating event_count(). off by default because it slows emulation
+    static void request_signal_check( void );      // call emulator_check_signals() by the next basic block boundary. only sets a sig_atomic_t, so it's safe in host signal handlers
+    void set_signal_check_at( uint64_t retired );  // call emulator_check_signals() once this many instructions have retired. 0 to disable
+    void set_code_map( uint8_t * map, uint64_t start, uint64_t length ); // note executed basic blocks in map, one entry per byte of code at start. 0 to disable
     uint64_t run( void );
+    void set_alt_stack( uint64_t sp, uint64_t size ) { alt_stack_low = sp; alt_stack_high = sp + size; } // size 0 when there is none
 
     x64( vector<uint8_t> & memory, uint64_t base_address, uint64_t start, uint64_t stack_commit, uint64_t top_of_stack )
     {
-        memset( this, 0, sizeof( *this ) );
+        memset( (void *) this, 0, sizeof( *this ) ); // void * since -Wclass-memaccess flags types that aren't trivial, and all-zero is valid for every member
         mode32 = false;                            // start in 64-bit long mode
         x87_fpu_control_word = 0x37f;              // hardware boots in this state
         rip.q = start;                             // execution starts here
@@ -191,15 +255,29 @@ struct x64
         mem_size = memory.size();
         beyond = mem + memory.size();              // addresses beyond and later are illegal
         membase = mem - base;                      // real pointer to the start of the app's memory (prior to offset)
+
+        #if defined( __GNUC__ ) || defined( __clang__ )
+            #pragma GCC diagnostic push
+            #pragma GCC diagnostic ignored "-Winvalid-offsetof" // x64 isn't standard layout, but its members are in declaration order
+        #endif
+        static_assert( 0 == offsetof( x64, regs ), "registers must start the first cache line" );
+        static_assert( offsetof( x64, mode32 ) < 192, "state used by most instructions must fit in three cache lines" );
+        static_assert( offsetof( x64, mem ) >= 192, "only hot state belongs in the first three cache lines" );
+        static_assert( 0 == ( offsetof( x64, xregs ) % 64 ), "xmm registers must start a cache line" );
+        static_assert( 0 == ( offsetof( x64, fregs ) % 16 ), "x87 registers must be aligned for vector loads" );
+        #if defined( __GNUC__ ) || defined( __clang__ )
+            #pragma GCC diagnostic pop
+        #endif
     } //x64
 
     uint8_t * mem;
     uint8_t * beyond;
     uint64_t base;
-    uint8_t * membase;                             // host pointer to base of vm's memory
     uint64_t stack_size;
     uint64_t stack_top;
     uint64_t mem_size;
+    uint64_t alt_stack_low;          // a signal handler's alternate stack, which the debug stack checks also accept
+    uint64_t alt_stack_high;
 
     uint64_t getoffset( uint64_t address )
     {
@@ -268,25 +346,135 @@ struct x64
     uint8_t getui8( uint64_t o ) { return * (uint8_t *) getmem( o ); }
     void setui8( uint64_t o, uint8_t val ) { * (uint8_t *) getmem( o ) = val; }
 
-    reg8_t regs[ 16 ];               // rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8..r15
-    vec16_t xregs[ 16 ];             // xmm0 through 15
-    float80_t fregs[ 8 ];            // 80-bit numbers are stored in this fp stack, while math is done as 8-byte or 10-byte doubles depending on the compiler and ISA
-    reg8_t rip;                      // instruction pointer
     reg8_t res, rcs, rss, rds, rfs, rgs; // fs is used by glibc for thread state on x64 and on x32 it's gs. as a simplification, store and use the address the segment refers to.
     uint32_t mxcsr;
     uint16_t x87_fpu_control_word;   // for fldcw, fstcw/fnstcw. applies to sse as well as x87
     uint16_t x87_fpu_status_word;    // for fstsw/fnstsw.
     uint8_t fp_sp;                   // current stack pointer for fregs[]
-    bool mode32;                     // true for 32-bit CPU vs 64-bit
 
     void Mode32( bool m32 ) { mode32 = m32; } // flip from 64-bit long mode to 32-bit compatibility mode for running 32-bit apps. or back.
 
     uint64_t & reg_fs() { return rfs.q; }
     uint64_t & reg_gs() { return rgs.q; }
+    uint64_t & reg_rflags() { return rflags; }
+    uint64_t & retired_instructions() { return retired; } // across run() calls. current as of the latest syscall or run() return
+
+    // events are counted per instruction: a rep movsb is one load and one store, and push [m] is one of each.
+
+    enum cpu_event { event_branches, event_taken_branches, event_loads, event_stores, event_x87, event_sse, event_max };
+    uint64_t & event_count( cpu_event e ) { return events[ e ]; } // while count_events( true )
+
+    static const size_t edge_map_size = 1 << 16;   // same as AFL's MAP_SIZE
+
+    // the layout of an instruction's bytes, found from its encoding alone. decode_instruction() looks up each opcode's
+    // shape in a table built at compile time from rows in x64.cxx, so supporting a new encoding means adding a row.
+    // run() and trace_state() give instructions their meaning; this is how the code map and tracing find their extent.
+
+    struct decoded_instruction
+    {
+        uint8_t length;                            // 1..15
+        uint8_t map;                               // 0 for one-byte opcodes, then 1, 2, and 3 for 0x0f, 0x0f 0x38, and 0x0f 0x3a
+        uint8_t opcode;
+        uint8_t modrm_offset;                      // offset of the r/m byte, or 0 if there isn't one
+        uint8_t imm_offset;                        // offset of the immediate or branch displacement
+        uint8_t imm_size;
+        bool size16;                               // 0x66 prefix
+        bool address_prefix;                       // 0x67 prefix
+        bool rex_w;
+        bool vex;                                  // vex or evex encoding
+        bool ends;                                 // a jump, call, return, syscall, or halt that ends a basic block
+        bool relative;                             // the immediate is a displacement from the next instruction
+    };
+
+    static bool decode_instruction( const uint8_t * p, size_t available, bool is32, decoded_instruction & d ); // false if the bytes available don't hold an instruction
+
+    // code map entries describe the instruction that starts at each byte of code. 0 means nothing is known about the byte.
+    // code_map_entry() packs an instruction's length and whether it transfers control from decode_instruction().
+    // run() still decodes each instruction itself; the map is for analysis and translate(), not for skipping decode.
+
+    static const uint8_t code_map_length = 0x0f;   // instruction length, 1..15
+    static const uint8_t code_map_block = 0x10;    // a basic block starts here: a branch target or just after a control transfer
+    static const uint8_t code_map_ends = 0x20;     // a jump, call, return, syscall, or halt that ends a basic block
+    static const uint8_t code_map_run = 0x80;      // executed since set_code_map(). not meaningful across runs
+    static uint8_t code_map_entry( const uint8_t * p, size_t available, bool is32 ); // 0 if the bytes available don't hold an instruction
+    static bool code_map_target( const uint8_t * p, uint8_t entry, uint64_t address, bool is32, uint64_t & target ); // destination of a direct jump or call
+    static uint64_t predecode( uint8_t * map, const uint8_t * code, uint64_t code_start, uint64_t code_size,
+                               uint64_t start, uint64_t length, bool is32 ); // linearly decode a function. returns instructions decoded
+
+    // where the entry of each instruction came from when it first executed
+
+    enum code_map_source { code_map_from_cache, code_map_from_run, code_map_source_max };
+    uint64_t code_map_count( code_map_source s ) { return code_map_counts[ s ]; }
+
+    // x64os -j writes an app's basic blocks as C++ functions of x64_translated that update this struct directly (see mtran.sh).
+    // each returns the number of instructions it executed and leaves rip where execution continues. a block that stops
+    // at an instruction it couldn't translate sets translation_resume to where translated code can pick up again.
+
+    typedef uint64_t ( * translated_block )( x64 & cpu );
+    struct translation { uint64_t address; translated_block block; };
+    static uint64_t translation_slot( uint64_t address ) { return address ^ ( address >> 12 ); } // & the table's mask, then probe linearly
+    void set_translations( const translation * table, uint64_t mask ); // table has mask + 1 entries; unused ones are 0. 0 to disable
+    uint64_t translated_instructions() { return translated_count; }
+    uint64_t translate( std::string & code, uint64_t address, uint64_t & resume ); // needs set_code_map(). returns instructions translated
+
+    // the flight recorder keeps the most recent basic block entries, interpreted or translated, so a crash can show how
+    // the app got there. an entry is recorded after every control transfer instruction, taken or not, since a conditional
+    // branch that falls through also starts a block. it's always on unless built with X64_NO_FLIGHT_RECORDER.
+
+    static const uint64_t flight_size = 256;       // a power of 2
+    uint64_t flight_entries() { return flight_count; } // recorded since the cpu was created; the latest flight_size are kept
+    uint64_t flight_rip( uint64_t i ) { return flight_rips[ i & ( flight_size - 1 ) ]; } // entry i of flight_entries()
+    void trace_disassembly( uint64_t address );   // trace the instruction at address without register state
+
+    // call hooks let the emulator watch functions in the app, like x64os -u does with the app's allocator. when control
+    // transfers to a hooked address or to the return hook, emulator_call_hook() runs before the instruction there.
+    // translated blocks don't check them.
+
+    void set_call_hooks( const uint64_t * addresses, size_t count ); // sorted function addresses that stay valid until disabled. 0 to disable
+    void set_return_hook( uint64_t address ) { return_hook = address; } // one-shot, for the return of a hooked call. 0 to disable
 
 private:
-                      // 0                                   8                                16
-    uint64_t rflags;  // C, n/a, P, n/a, A, n/a, Z, S,   :   T, I, D, O, IOPL+IOPL, n/a   :   RF, VM, AC, VIF, VIP, ID, 22.31 n/a
+    uint8_t * edge_map;                            // optional coverage bitmap shared with a fuzzer
+    uint64_t edge_prev;                            // hashed location of the prior control transfer, shifted right 1
+    uint64_t retired;                              // instructions executed before the current run() plus, during syscalls, in it
+    uint64_t retired_at_run;                       // retired when the current run() started
+    uint64_t events[ event_max ];
+    uint64_t event_fallthrough;                    // rip after the prior conditional branch if it's not taken, or 0
+    uint8_t * code_map;                            // optional code map; see set_code_map()
+    uint64_t code_map_start;                       // address of the code described by code_map[ 0 ]
+    uint64_t code_map_size;                        // bytes of code described by code_map
+    uint64_t code_map_counts[ code_map_source_max ];
+    const translation * translations;              // optional translated blocks; see set_translations()
+    uint64_t translation_mask;
+    uint64_t translation_resume;                   // where translated code picks up after the interpreter runs what it couldn't translate, or 0
+    uint64_t translated_count;                     // instructions executed by translated blocks
+    uint64_t flight_count;
+    uint64_t flight_rips[ flight_size ];
+    bool disassembling;                            // trace_disassembly() is running, so unhandled() throws rather than terminates
+    const uint64_t * call_hooks;                   // optional sorted function addresses; see set_call_hooks()
+    size_t call_hook_count;
+    uint64_t return_hook;                          // where a hooked call returns to, or 0
+
+    friend struct x64_translated;                  // the code written by translate()
+    friend struct x64_flag_test;                   // flagtest.cxx
+
+    inline void record_edge() // call after each control transfer, with rip pointing at the destination
+    {
+        #ifndef X64_NO_FLIGHT_RECORDER
+            flight_rips[ flight_count++ & ( flight_size - 1 ) ] = rip.q;
+        #endif
+
+        if ( block_hooks )
+            run_block_hooks( true );
+    } //record_edge
+
+    inline void enter_block() // call when rip may start a basic block: after control transfers, syscalls, and signal delivery
+    {
+        if ( block_hooks )
+            run_block_hooks( false );
+    } //enter_block
+
+    void note_block_hooks() { block_hooks = ( 0 != edge_map ) || ( 0 != code_map ) || ( 0 != translations ) || ( 0 != call_hooks ); }
 
     void setflag_c( bool f ) { rflags &= ~( 1 << 0 );  rflags |= ( ( 0 != f ) << 0 );  } // carry
     void setflag_p( bool f ) { rflags &= ~( 1 << 2 );  rflags |= ( ( 0 != f ) << 2 );  } // parity even
@@ -330,18 +518,7 @@ private:
         return buf;
     } //render_flags
 
-    uint8_t _prefix_rex;                // 0 for none. 0x4x
-    uint8_t _prefix_size;               // 0 for none. can be 0x66 (operand size 16) or 0x67 (address size 32)
-    uint8_t _prefix_sse2_repeat;        // 0 for none. f2 repne/repnz, f3 rep/repe/repz. f3 can also mean multibyte. f2 can also mean bnd (memory protection)
-    uint8_t _prefix_segment;            // 0 for none. 0x64 for fs: or 0x65 for gs:
-
-    // decoding state and functions
-
-    uint64_t _instruction_start;        // rip where decoding of the current instruction started
-    int64_t _displacement;
-    REXInfo _rex;
-    uint8_t _rm, _reg, _mod;
-    uint8_t _sibScale, _sibIndex, _sibBase;
+    // decoding functions. the decoding state is declared with the other hot state at the top of x64
 
     void decode_sib();
     void decode_rex();
@@ -352,9 +529,21 @@ private:
         _rm = _reg = _mod = 0;
         _sibScale = _sibIndex = _sibBase = 0;
         _displacement = 0;
+        _ea_base = 0;
     } //clear_decoding
 
-    uint64_t effective_address();
+    // [reg], [reg + disp], and [rip + disp] are most memory operands (rsp, rbp, and rip-relative in particular).
+    // decode_rm() resolves their base register once, so their address is a single add. rip is read here rather
+    // than in decode_rm() since it's relative to the end of the instruction, after any immediate data.
+
+    inline uint64_t effective_address()
+    {
+        if ( 0 != _ea_base )
+            return *_ea_base + _displacement;
+        return full_effective_address();
+    } //effective_address
+
+    uint64_t full_effective_address();
 
     inline uint64_t pop()
     {
@@ -408,11 +597,122 @@ private:
         return ( x ^ m ) - m;
     } //sign_extend16
 
-    template <typename T> T op_add( T lhs, T rhs, bool carry = false );
-    template <typename T> T op_sub( T lhs, T rhs, bool carry = false );
-    template <typename T> T op_or( T lhs, T rhs );
-    template <typename T> T op_and( T lhs, T rhs );
-    template <typename T> T op_xor( T lhs, T rhs );
+    // the flag arithmetic below is defined in this header so code written by translate() can inline it
+
+    template <typename T> T portable_op_sub( T a, T b, bool borrow = false )
+    {
+        #ifndef __APPLE__
+            static_assert( std::is_unsigned_v<T>, "Template parameter must be an unsigned type." );
+        #endif
+        T result = a - b - (T) borrow;
+        set_PSZ( result );
+        setflag_c( ( a < b ) || ( ( a - b ) < (T) borrow ) ); // borrow if a < (b + borrow).
+
+        // Overflow occurs when subtracting a positive from a negative gives a positive or subtracting a negative from a positive gives a negative.
+        using ST = std::make_signed_t<T>;
+        ST a_s = (ST) a;
+        ST b_s = (ST) b;
+        ST result_s = (ST) result;
+        setflag_o( ( ( a_s ^ b_s ) < 0 ) && ( ( a_s ^ result_s ) < 0 ) ); // Overflow is detected if signs were different AND the result's sign is also different.
+        setflag_a( ( 0 != ( ( ( a & 0xf ) - ( b & 0xf ) - (T) borrow ) & ~0xf ) ) );
+        return result;
+    } //portable_op_sub
+
+    template <typename T> T portable_op_add( T a, T b, bool carry = false )
+    {
+        #ifndef __APPLE__
+            static_assert( std::is_unsigned_v<T>, "Template parameter must be an unsigned type." );
+        #endif
+        T result = a + b + (T) carry;
+        set_PSZ( result );
+        setflag_c( carry ? ( result <= a ) : ( result < a ) );
+        setflag_o( ( ! val_signed( (T) ( a ^ b ) ) ) && ( val_signed( (T) ( a ^ result ) ) ) ); // cast since 8 and 16-bit values are promoted to int
+        setflag_a( 0 != ( ( ( a & 0xf ) + ( b & 0xf ) + (T) carry ) & 0x10 ) );
+        return result;
+    } //portable_op_add
+
+    template <typename T> T portable_op_xor( T a, T b )
+    {
+        a ^= b;
+        set_PSZ( a );
+        reset_CO();
+        return a;
+    } //portable_op_xor
+
+    template <typename T> T portable_op_and( T a, T b )
+    {
+        a &= b;
+        set_PSZ( a );
+        reset_CO();
+        return a;
+    } //portable_op_and
+
+    template <typename T> T portable_op_or( T a, T b )
+    {
+        a |= b;
+        set_PSZ( a );
+        reset_CO();
+        return a;
+    } //portable_op_or
+
+    #if X64_HOST_FLAGS
+
+        // lahf loads the host's S, Z, A, P, and C flags into ah at the bit positions they have in rflags, and seto
+        // gets O. mask is the flags the instruction defines. the rest of rflags is left alone, as in the portable code.
+        // a carry or borrow in is loaded with bt so adc and sbb don't need a branch.
+
+        #define HOST_FLAGS_OP( op, mask ) \
+            uint16_t ax; \
+            uint8_t o; \
+            asm( op " %[b], %[a]\n\tlahf\n\tseto %[o]" : [a] "+r" ( a ), "=a" ( ax ), [o] "=q" ( o ) : [b] "r" ( b ) : "cc" ); \
+            set_host_flags( ax, o, mask ); \
+            return a;
+
+        #define HOST_FLAGS_CARRY_OP( op, carry, mask ) \
+            uint16_t ax; \
+            uint8_t o; \
+            asm( "bt $0, %k[c]\n\t" op " %[b], %[a]\n\tlahf\n\tseto %[o]" \
+                 : [a] "+r" ( a ), "=a" ( ax ), [o] "=q" ( o ) : [b] "r" ( b ), [c] "r" ( (uint32_t) carry ) : "cc" ); \
+            set_host_flags( ax, o, mask ); \
+            return a;
+
+        void set_host_flags( uint16_t ax, uint8_t o, uint64_t mask ) { rflags = ( rflags & ~mask ) | ( ( ( ax >> 8 ) | ( (uint64_t) o << 11 ) ) & mask ); }
+
+        template <typename T> T op_sub( T a, T b, bool borrow = false )
+        {
+            if ( __builtin_constant_p( borrow ) && !borrow )
+            {
+                HOST_FLAGS_OP( "sub", 0x8d5 )
+            }
+            HOST_FLAGS_CARRY_OP( "sbb", borrow, 0x8d5 )
+        } //op_sub
+
+        template <typename T> T op_add( T a, T b, bool carry = false )
+        {
+            if ( __builtin_constant_p( carry ) && !carry )
+            {
+                HOST_FLAGS_OP( "add", 0x8d5 )
+            }
+            HOST_FLAGS_CARRY_OP( "adc", carry, 0x8d5 )
+        } //op_add
+
+        template <typename T> T op_xor( T a, T b ) { HOST_FLAGS_OP( "xor", 0x8c5 ) } // A is undefined on the host, so it's left alone
+        template <typename T> T op_and( T a, T b ) { HOST_FLAGS_OP( "and", 0x8c5 ) }
+        template <typename T> T op_or( T a, T b ) { HOST_FLAGS_OP( "or", 0x8c5 ) }
+
+        #undef HOST_FLAGS_OP
+        #undef HOST_FLAGS_CARRY_OP
+
+    #else
+
+        template <typename T> T op_sub( T a, T b, bool borrow = false ) { return portable_op_sub( a, b, borrow ); }
+        template <typename T> T op_add( T a, T b, bool carry = false ) { return portable_op_add( a, b, carry ); }
+        template <typename T> T op_xor( T a, T b ) { return portable_op_xor( a, b ); }
+        template <typename T> T op_and( T a, T b ) { return portable_op_and( a, b ); }
+        template <typename T> T op_or( T a, T b ) { return portable_op_or( a, b ); }
+
+    #endif //X64_HOST_FLAGS
+
     template <typename T> void do_math( uint8_t math, T * pdst, T src );
 
     void op_stos( uint8_t width );
@@ -711,7 +1011,30 @@ private:
     const char * rm_string( uint8_t width, bool is_xmm = false );
     const char * register_name( uint8_t reg, uint8_t width = 8, bool is_xmm = false );
 
-    bool check_condition( uint8_t condition );
+    bool check_condition( uint8_t condition )
+    {
+        assert( condition < 16 );
+        switch( condition )
+        {                                                           //                   hints:
+            case 0:  return flag_o();                               // jo                o = overflow
+            case 1:  return !flag_o();                              // jno               n = not
+            case 2:  return flag_c();                               // jb / jnae / jc    b = below, ae = above or equal, c = carry. Unsigned here
+            case 3:  return !flag_c();                              // jnb / jae / jnc
+            case 4:  return flag_z();                               // je / jz           e = equal, z = zero
+            case 5:  return !flag_z();                              // jne / jnz
+            case 6:  return flag_c() || flag_z();                   // jbe / jna
+            case 7:  return !flag_c() && !flag_z();                 // jnbe / ja
+            case 8:  return flag_s();                               // js                s = signed
+            case 9:  return !flag_s();                              // jns
+            case 10: return flag_p();                               // jp / jpe          p / pe = parity even
+            case 11: return !flag_p();                              // jnp / jpo         po = parity odd
+            case 12: return ( flag_s() != flag_o() );               // jl / jnge         l = less than, nge = not greater than or equal. Signed here
+            case 13: return ( flag_s() == flag_o() );               // jnl / jge
+            case 14: return flag_z() || ( flag_s() != flag_o() );   // jle / jng         le = less than or equal, ng = not greather than
+            default: return !flag_z() && ( flag_s() == flag_o()  ); // jnle / jg         must be 15, but to work around a bogus compiler warning
+        }
+    } //check_condition
+
     template <typename T> inline uint32_t compare_floating( T a, T b );
     template <typename T> inline bool floating_comparison_true( T a, T b, uint8_t predicate );
     void set_eflags_from_fcc( uint32_t fcc );
@@ -721,9 +1044,73 @@ private:
     template <typename T> void op_ror( T * pval, uint8_t amount );
     template <typename T> void op_rcl( T * pval, uint8_t amount );
     template <typename T> void op_rcr( T * pval, uint8_t amount );
-    template <typename T> void op_sal( T * pval, uint8_t amount ); // aka shl
-    template <typename T> void op_shr( T * pval, uint8_t amount );
-    template <typename T> void op_sar( T * pval, uint8_t amount );
+
+    // op_shift passes counts of 1 through 31, or 63 for 64-bit operands, so 8 and 16-bit operands can be shifted by their
+    // width or more. the result is then 0 (or all sign bits for sar), and C for shl and shr is undefined on x86.
+    // O is only defined for counts of 1, and otherwise left alone
+
+    template <typename T> void portable_op_sal( T * pval, uint8_t shift ) // aka shl
+    {
+        T x = *pval;
+        if ( 1 == shift )
+            setflag_o( 1 == top2bits( x ) || 2 == top2bits( x ) ); // the result's sign differs from carry
+
+        for ( uint8_t s = 0; s < shift; s++ )
+        {
+            setflag_c( val_signed( x ) );
+            x <<= 1;
+        }
+
+        *pval = x;
+        set_PSZ( x );
+    } //portable_op_sal
+
+    template <typename T> void portable_op_shr( T * pval, uint8_t shift )
+    {
+        T x = *pval;
+        if ( 1 == shift )
+            setflag_o( val_signed( x ) );
+        x >>= ( shift - 1 );
+        setflag_c( 0 != ( x & 1 ) ); // the last bit shifted out
+        x >>= 1;
+        *pval = x;
+        set_PSZ( x );
+    } //portable_op_shr
+
+    template <typename T> void portable_op_sar( T * pval, uint8_t shift )
+    {
+        using ST = std::make_signed_t<T>;
+        ST x = *pval;
+        if ( 1 == shift )
+            setflag_o( false );
+        x >>= ( shift - 1 );
+        setflag_c( 0 != ( x & 1 ) );
+        x >>= 1;
+        *pval = x;
+        set_PSZ( x );
+    } //portable_op_sar
+
+    #if X64_HOST_FLAGS
+
+        #define HOST_FLAGS_SHIFT( op ) \
+            uint16_t ax; \
+            uint8_t o; \
+            asm( op " %%cl, %[v]\n\tlahf\n\tseto %[o]" : [v] "+r" ( *pval ), "=a" ( ax ), [o] "=q" ( o ) : "c" ( shift ) : "cc" ); \
+            set_host_flags( ax, o, ( 1 == shift ) ? 0x8c5 : 0xc5 );
+
+        template <typename T> void op_sal( T * pval, uint8_t shift ) { HOST_FLAGS_SHIFT( "shl" ) } // aka shl
+        template <typename T> void op_shr( T * pval, uint8_t shift ) { HOST_FLAGS_SHIFT( "shr" ) }
+        template <typename T> void op_sar( T * pval, uint8_t shift ) { HOST_FLAGS_SHIFT( "sar" ) }
+
+        #undef HOST_FLAGS_SHIFT
+
+    #else
+
+        template <typename T> void op_sal( T * pval, uint8_t shift ) { portable_op_sal( pval, shift ); } // aka shl
+        template <typename T> void op_shr( T * pval, uint8_t shift ) { portable_op_shr( pval, shift ); }
+        template <typename T> void op_sar( T * pval, uint8_t shift ) { portable_op_sar( pval, shift ); }
+
+    #endif //X64_HOST_FLAGS
 
     void push_fp( float80_t f80 );
     void push_fp( long double val );
@@ -815,7 +1202,23 @@ private:
     void trace_xreg( uint32_t i );
     void trace_xregs();
     void trace_fregs();
-    void trace_state( void );                  // trace the machine's current status
+    void trace_state( bool registers = true ); // trace the machine's current status
+    void tally_events( void );                 // classify the instruction at rip for event_count()
+    template <bool exact> bool run_loop( uint64_t & count, uint64_t & boundary ); // see run()
+    void run_block_hooks( bool edge );         // update edge coverage after a control transfer, the code map, call hooks, and translation state
+    void map_code( void );                     // note the basic block starting at rip in code_map
+    void check_call_hooks( void );             // call emulator_call_hook() if rip is hooked
+    void enter_translation( void );            // note whether rip starts a translated block
+    uint64_t run_translations( void );         // run translated blocks from rip for as long as they chain. returns instructions executed
+    translated_block find_translation( uint64_t address );
+    bool translate_instruction( std::string & code, uint64_t address, uint64_t next, uint16_t live, uint16_t & reads, uint16_t & writes );
+    std::string translated_ea( uint64_t next );
+    std::string translated_rm( uint8_t width );
+    std::string translated_set_rm( uint8_t width, const std::string & val, bool zero_extend = true );
     void unhandled( void );
+
+public:
+    alignas( 64 ) vec16_t xregs[ 16 ]; // xmm0 through 15
+    float80_t fregs[ 8 ];            // 80-bit numbers are stored in this fp stack, while math is done as 8-byte or 10-byte doubles depending on the compiler and ISA
 };
 
@@ -36,11 +36,23 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <errno.h>
+#include <signal.h>
 #include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <algorithm>
 #include <chrono>
 #include <locale.h>
 #include <cstddef>
 
+#if ( defined( X64OS ) || defined( X32OS ) ) && defined( __linux__ ) && !defined( X64OS_LIBRARY )
+    #define HOST_PERF_COUNTERS // -p:h reports host hardware counters for the emulator
+    #include <linux/perf_event.h>
+    #include <asm/unistd.h>
+    #include <sys/ioctl.h>
+#endif
+
 #include <djl_os.hxx>
 #include <linuxem.h>
 
@@ -72,6 +84,9 @@
 #ifndef __mc68000__
         #include <termios.h>
         #include <sys/random.h>
+        #include <sys/mman.h>
+        #include <sys/shm.h>
+        #include <sys/wait.h>
 #endif
         #ifdef __mc68000__
             #include <time.h>
@@ -100,6 +115,7 @@
 #include <djltrace.hxx>
 #include <djl_con.hxx>
 #include <djl_mmap.hxx>
+#include <djl_dwarf.hxx>
 
 using namespace std;
 using namespace std::chrono;
@@ -254,39 +270,50 @@ using namespace std::chrono;
 
 #endif
 
+#ifndef EMULATOR_THREAD_LOCAL
+    #define EMULATOR_THREAD_LOCAL
+#endif
+
+#ifdef X64OS_LIBRARY
+    #include <stdexcept>
+    #include "libx64os.hxx"
+#endif
+
 #define CONCATENATE(e1, e2) e1 ## e2
 #define PREFIX_L(s) CONCATENATE(L, s)
 
 CDJLTrace tracer;
 ConsoleConfiguration g_consoleConfig;
-bool g_compressed_rvc = false;                 // is the app compressed risc-v?
-const REG_TYPE g_arg_data_commit = 1024;       // storage spot for command-line arguments and environment variables
-REG_TYPE g_stack_commit = 128 * 1024;          // RAM to allocate for the fixed stack. the top of this has argv data
-
-REG_TYPE g_brk_commit = 40 * 1024 * 1024;      // RAM to reserve if the app calls brk to allocate space. 40 meg default
-REG_TYPE g_mmap_commit = 40 * 1024 * 1024;     // RAM to reserve if the app calls mmap to allocate space. 40 meg default
-
-bool g_terminate = false;                      // has the app asked to shut down?
-int g_exit_code = 0;                           // exit code of the app in the vm
-vector<uint8_t> memory;                        // RAM for the vm
-REG_TYPE g_base_address = 0;                   // vm address of start of memory
-REG_TYPE g_execution_address = 0;              // where the program counter starts
-REG_TYPE g_brk_offset = 0;                     // offset of brk, initially g_end_of_data
-REG_TYPE g_mmap_offset = 0;                    // offset of where mmap allocations start
-REG_TYPE g_highwater_brk = 0;                  // highest brk seen during app; peak dynamically-allocated RAM
-REG_TYPE g_end_of_data = 0;                    // official end of the loaded app
-REG_TYPE g_bottom_of_stack = 0;                // just beyond where brk might move
-REG_TYPE g_top_of_stack = 0;                   // argc, argv, penv, aux records sit above this
-CMMap g_mmap;                                  // for mmap and munmap system calls
-bool g_hostIsLittleEndian = true;              // is the host little endian?
-bool g_addCRBeforeLF = false;                  // on Windows, a command-line argument can make this true
+bool g_compressed_rvc = false;                                   // is the app compressed risc-v?
+const REG_TYPE g_arg_data_commit = 1024;                         // storage spot for command-line arguments and environment variables
+EMULATOR_THREAD_LOCAL vector<char> g_environment;                // extra null-terminated name=value strings beyond OS= and TZ=
+EMULATOR_THREAD_LOCAL char g_acImagePath[ EMULATOR_MAX_PATH ] = {0}; // full path of the app, which /proc/self/exe reads as
+EMULATOR_THREAD_LOCAL REG_TYPE g_stack_commit = 128 * 1024;      // RAM to allocate for the fixed stack. the top of this has argv data
+
+EMULATOR_THREAD_LOCAL REG_TYPE g_brk_commit = 40 * 1024 * 1024;  // RAM to reserve if the app calls brk to allocate space. 40 meg default
+EMULATOR_THREAD_LOCAL REG_TYPE g_mmap_commit = 40 * 1024 * 1024; // RAM to reserve if the app calls mmap to allocate space. 40 meg default
+
+EMULATOR_THREAD_LOCAL bool g_terminate = false;                  // has the app asked to shut down?
+EMULATOR_THREAD_LOCAL int g_exit_code = 0;                       // exit code of the app in the vm
+EMULATOR_THREAD_LOCAL vector<uint8_t> memory;                    // RAM for the vm
+EMULATOR_THREAD_LOCAL REG_TYPE g_base_address = 0;               // vm address of start of memory
+EMULATOR_THREAD_LOCAL REG_TYPE g_execution_address = 0;          // where the program counter starts
+EMULATOR_THREAD_LOCAL REG_TYPE g_brk_offset = 0;                 // offset of brk, initially g_end_of_data
+EMULATOR_THREAD_LOCAL REG_TYPE g_mmap_offset = 0;                // offset of where mmap allocations start
+EMULATOR_THREAD_LOCAL REG_TYPE g_highwater_brk = 0;              // highest brk seen during app; peak dynamically-allocated RAM
+EMULATOR_THREAD_LOCAL REG_TYPE g_end_of_data = 0;                // official end of the loaded app
+EMULATOR_THREAD_LOCAL REG_TYPE g_code_start = 0;                 // lowest address of the app's executable segments
+EMULATOR_THREAD_LOCAL REG_TYPE g_code_end = 0;                   // just past the highest address of the app's executable segments
+EMULATOR_THREAD_LOCAL REG_TYPE g_bottom_of_stack = 0;            // just beyond where brk might move
+EMULATOR_THREAD_LOCAL REG_TYPE g_top_of_stack = 0;               // argc, argv, penv, aux records sit above this
+EMULATOR_THREAD_LOCAL CMMap g_mmap;                              // for mmap and munmap system calls
+bool g_hostIsLittleEndian = true;                                // is the host little endian?
+bool g_addCRBeforeLF = false;                                    // on Windows, a command-line argument can make this true
 
 // fake descriptors.
 // /etc/timezone is not implemented, so apps running in the emulator on Windows assume UTC
 
 const uint64_t findFirstDescriptor = 3000;
-const uint64_t timebaseFrequencyDescriptor = 3001;
-const uint64_t osreleaseDescriptor = 3002;
 
 uint64_t swap_endian64( uint64_t x )
 {
@@ -828,6 +855,10 @@ struct ElfSectionHeader32
 
 static void usage( char const * perror = 0 )
 {
+#ifdef X64OS_LIBRARY
+    throw runtime_error( perror ? perror : "invalid usage" ); // library callers get errors, not a process exit
+#endif
+
     g_consoleConfig.RestoreConsole( false );
 
     if ( 0 != perror )
@@ -835,19 +866,52 @@ static void usage( char const * perror = 0 )
 
     printf( "usage: %s <%s arguments> <executable> <app arguments>\n", APP_NAME, APP_NAME );
     printf( "   arguments:    -e     just show information about the elf executable; don't actually run it\n" );
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -b:F   analysis: keep the app's code map (instruction lengths and block starts) in file F across runs.\n" );
+    printf( "                        -j also translates blocks found by runs with -b:F. this adds work; it isn't faster\n" );
+    printf( "                 -c:F   write a checkpoint to file F when the app calls emulator_sys_checkpoint or -n is reached\n" );
+#endif
+    printf( "                 -d     with -o, writes to in-memory files succeed but are discarded\n" );
 #ifdef RVOS
     printf( "                 -g     (internal) generate rcvtable.txt then exit\n" );
+#endif
+#if ( defined( X64OS ) || defined( X32OS ) ) && !defined( _WIN32 )
+    printf( "                 -f:F   fork server. fork a child per input file listed in F, or use F=afl for AFL with edge coverage.\n" );
+    printf( "                        the server starts when the app calls emulator_sys_fork_server or -n is reached\n" );
 #endif
     printf( "                 -h:X   # of meg for the heap (brk space). 0..1024 are valid. default is 40\n" );
     printf( "                 -i     if -t is set, also enables instruction tracing with symbols\n" );
+#ifdef X64OS
+    printf( "                 -j:F   translate the app's code to C++ in file F then exit. mtran.sh builds it into x64os\n" );
+#endif
 #ifdef _WIN32
     printf( "                 -l     when a LF (10) is output, allow Windows to add a CR (13) beforehand\n" );
+#endif
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -k:X   virtual time. app clocks run at X MHz of executed instructions and sleeps don't block. default X is 1000\n" );
 #endif
     printf( "                 -m:X   # of meg for mmap space. 0..1024 are valid. default is 40.\n" );
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -n:X   with -c or -f, write the checkpoint or start the fork server after X instructions\n" );
+#endif
+    printf( "                 -o:P   mount an in-memory file system at app path P. use P=D to preload it from host directory or tar file D\n" );
     printf( "                 -p     shows performance information at app exit\n" );
+    printf( "                 -p:h   also shows host hardware counters for the emulator per guest instruction. Linux only\n" );
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -r:F   resume from checkpoint file F instead of starting the app. app arguments are ignored\n" );
+#endif
     printf( "                 -s:X   # of KB for stack space. 1..1024 are valid. default is 128.\n" );
     printf( "                 -t     enable debug tracing to %s\n", LOGFILE_NAME );
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -u     profile the app's heap: peak live bytes by call site, allocation rate, and leaks at exit.\n" );
+    printf( "                        hooks malloc, free, new, delete, etc. in the app's symbols. no translated blocks with -u\n" );
+#endif
     printf( "                 -v     used with -e shows verbose information (e.g. symbols)\n" );
+#if defined( X64OS ) || defined( X32OS )
+    printf( "                 -w:F   record each syscall's result and app memory changes to file F for later replay with -x\n" );
+    printf( "                 -x:F   replay syscalls from file F instead of the host. stops if the app diverges from the recording\n" );
+    printf( "   the latest block entries and syscalls are shown on a crash, and on a host SIGUSR1 while the app runs\n" );
+#endif
     printf( "  %s\n", build_string() );
     exit( 1 );
 } //usage
@@ -1019,6 +1083,12 @@ bool is_o_creat_set( int f )
     return result;
 } //is_o_creat_set
 
+bool is_open_flag_set( int f, open_flags flag )
+{
+    int flagval = flagmap[ emulated_app_platform() ][ flag ];
+    return ( flagval && ( ( flagval & f ) == flagval ) );
+} //is_open_flag_set
+
 int translate_open_flags( int f )
 {
     // ignored: O_RANDOM, O_SEQUENTIAL, O_TEMPORARY, O_NOINHERIT, O_SHLOCK, O_EXLOCK, O_NONBLOCK, O_TMPFILE, O_NOINHERIT
@@ -1161,16 +1231,6 @@ static int fill_pstat_windows( int descriptor, struct stat_linux_syscall * pstat
         pstat->st_mode = S_IFDIR;
         pstat->st_rdev = 4096;
     }
-    else if ( timebaseFrequencyDescriptor == descriptor )
-    {
-        pstat->st_mode = S_IFREG;
-        pstat->st_rdev = 4096;
-    }
-    else if ( osreleaseDescriptor == descriptor )
-    {
-        pstat->st_mode = S_IFREG;
-        pstat->st_rdev = 4096;
-    }
     else
     {
         WIN32_FILE_ATTRIBUTE_DATA data = {0};
@@ -1546,15 +1606,26 @@ static const SysCall syscalls[] =
     { "SYS_set_tid_address", SYS_set_tid_address },
     { "SYS_futex", SYS_futex },
     { "SYS_set_robust_list", SYS_set_robust_list },
+    { "SYS_getitimer", SYS_getitimer },
+    { "SYS_setitimer", SYS_setitimer },
+    { "SYS_timer_create", SYS_timer_create },
+    { "SYS_timer_gettime", SYS_timer_gettime },
+    { "SYS_timer_getoverrun", SYS_timer_getoverrun },
+    { "SYS_timer_settime", SYS_timer_settime },
+    { "SYS_timer_delete", SYS_timer_delete },
     { "SYS_clock_gettime", SYS_clock_gettime },
     { "SYS_clock_nanosleep", SYS_clock_nanosleep },
     { "SYS_sched_setaffinity", SYS_sched_setaffinity },
     { "SYS_sched_getaffinity", SYS_sched_getaffinity },
     { "SYS_sched_yield", SYS_sched_yield },
+    { "SYS_kill", SYS_kill },
     { "SYS_tgkill", SYS_tgkill },
     { "SYS_signalstack", SYS_signalstack },
+    { "SYS_rt_sigsuspend", SYS_rt_sigsuspend },
     { "SYS_sigaction", SYS_sigaction },
     { "SYS_rt_sigprocmask", SYS_rt_sigprocmask },
+    { "SYS_rt_sigpending", SYS_rt_sigpending },
+    { "SYS_rt_sigreturn", SYS_rt_sigreturn },
     { "SYS_times", SYS_times },
     { "SYS_uname", SYS_uname },
     { "SYS_getrusage", SYS_getrusage },
@@ -1574,6 +1645,7 @@ static const SysCall syscalls[] =
     { "SYS_mmap", SYS_mmap },
     { "SYS_mprotect", SYS_mprotect },
     { "SYS_madvise", SYS_madvise },
+    { "SYS_perf_event_open", SYS_perf_event_open },
     { "SYS_riscv_flush_icache", SYS_riscv_flush_icache },
     { "SYS_prlimit64", SYS_prlimit64 },
     { "SYS_renameat2", SYS_renameat2 },
@@ -1606,6 +1678,10 @@ static const SysCall syscalls[] =
     { "emulator_sys_set_thread_area", emulator_sys_set_thread_area }, // exists on x32 and some other platforms
     { "emulator_sys_get_thread_area", emulator_sys_get_thread_area },
     { "emulator_sys_ugetrlimit", emulator_sys_ugetrlimit },
+    { "emulator_sys_checkpoint", emulator_sys_checkpoint },
+    { "emulator_sys_fork_server", emulator_sys_fork_server },
+    { "emulator_sys_alarm", emulator_sys_alarm },
+    { "emulator_sys_pause", emulator_sys_pause },
 };
 
 // Use custom versions of bsearch and qsort to get consistent behavior across platforms.
@@ -1756,12 +1832,18 @@ static const SyscalltoRV X64ToRiscV[] = // per https://gpages.juszkiewicz.com.pl
     { 12, SYS_brk },
     { 13, SYS_sigaction },
     { 14, SYS_rt_sigprocmask },
+    { 15, SYS_rt_sigreturn },
     { 16, SYS_ioctl },
     { 20, SYS_writev },
     { 21, emulator_sys_access },
     { 25, SYS_mremap },
+    { 34, emulator_sys_pause },
+    { 36, SYS_getitimer },
+    { 37, emulator_sys_alarm },
+    { 38, SYS_setitimer },
     { 39, SYS_getpid },
     { 60, SYS_exit },
+    { 62, SYS_kill },
     { 63, SYS_uname },
     { 72, SYS_fcntl },
     { 74, SYS_fsync },
@@ -1781,6 +1863,9 @@ static const SyscalltoRV X64ToRiscV[] = // per https://gpages.juszkiewicz.com.pl
     { 104, SYS_getgid },
     { 107, SYS_geteuid },
     { 108, SYS_getegid },
+    { 127, SYS_rt_sigpending },
+    { 130, SYS_rt_sigsuspend },
+    { 131, SYS_signalstack },
     { 158, emulator_sys_x32_x64_arch_prctl },
     { 186, SYS_gettid },
     { 201, emulator_sys_time },
@@ -1788,6 +1873,11 @@ static const SyscalltoRV X64ToRiscV[] = // per https://gpages.juszkiewicz.com.pl
     { 204, SYS_sched_getaffinity },
     { 217, SYS_getdents64 },
     { 218, SYS_set_tid_address },
+    { 222, SYS_timer_create },
+    { 223, SYS_timer_settime },
+    { 224, SYS_timer_gettime },
+    { 225, SYS_timer_getoverrun },
+    { 226, SYS_timer_delete },
     { 228, SYS_clock_gettime },
     { 230, SYS_clock_nanosleep }, // really, SYS_clock_nanosleep_time64, but here that's redundant
     { 231, SYS_exit_group },
@@ -1800,10 +1890,13 @@ static const SyscalltoRV X64ToRiscV[] = // per https://gpages.juszkiewicz.com.pl
     { 267, SYS_readlinkat },
     { 270, SYS_pselect6 },
     { 273, SYS_set_robust_list },
+    { 298, SYS_perf_event_open },
     { 302, SYS_prlimit64 },
     { 318, SYS_getrandom },
     { 334, SYS_rseq },
     { 0x2002, emulator_sys_trace_instructions }, // same value
+    { 0x2013, emulator_sys_checkpoint }, // same value
+    { 0x2014, emulator_sys_fork_server }, // same value
 };
 
 uint16_t MapX64ToRiscV( REG_TYPE c )
@@ -1872,12 +1965,15 @@ static const SyscalltoRV X32ToRiscV[] = // per https://gpages.juszkiewicz.com.pl
     { 305, SYS_readlinkat },
     { 308, SYS_pselect6 },
     { 311, SYS_set_robust_list },
+    { 336, SYS_perf_event_open },
     { 355, SYS_getrandom },
     { 383, SYS_statx },
     { 384, emulator_sys_x32_x64_arch_prctl },
     { 386, SYS_rseq },
     { 403, SYS_clock_gettime },
     { 0x2002, emulator_sys_trace_instructions }, // same value
+    { 0x2013, emulator_sys_checkpoint }, // same value
+    { 0x2014, emulator_sys_fork_server }, // same value
 };
 
 uint16_t MapX32ToRiscV( REG_TYPE c )
@@ -1979,7049 +2075,12065 @@ void send_character( uint8_t c )
     printf( "%c", c );
 } //send_character
 
-static struct linux_user_desc g_user_desc;
+static EMULATOR_THREAD_LOCAL struct linux_user_desc g_user_desc;
 
-#ifdef __mc68000__
-extern "C" long syscall( long number, ... );
+#ifdef X64OS_LIBRARY
+static EMULATOR_THREAD_LOCAL X64OSSyscallOverride g_syscallOverride = 0;
+static EMULATOR_THREAD_LOCAL void * g_syscallOverrideContext = 0;
+static EMULATOR_THREAD_LOCAL X64OSOutputSink g_outputSink = 0;
+static EMULATOR_THREAD_LOCAL void * g_outputSinkContext = 0;
 #endif
 
-// this is called when the arm64 app has an svc #0 instruction or a RISC-V 64 app has an ecall instruction
-// https://thevivekpandey.github.io/posts/2017-09-25-linux-system-calls.html
+#if defined( X64OS ) || defined( X32OS )
 
-#pragma warning(disable: 4189) // unreferenced local variable
+// virtual time. with -k:X the app's clocks are derived from retired instructions at a virtual X MHz instead of host
+// time, and sleeps advance the clock instantly instead of blocking. sleep-heavy apps run at full speed and timings
+// are deterministic. realtime clocks start at the host time when the app started; the others start at 0.
 
-void emulator_invoke_svc( CPUClass & cpu )
+static EMULATOR_THREAD_LOCAL uint64_t g_virtualClockMHz = 0;    // -k: 0 means the app sees host time
+static EMULATOR_THREAD_LOCAL uint64_t g_virtualSleepNs = 0;     // total time the app has slept
+static EMULATOR_THREAD_LOCAL uint64_t g_virtualEpochNs = 0;     // host realtime when the app started
+
+static uint64_t virtual_cpu_ns( CPUClass & cpu ) // time spent executing instructions
 {
-#ifdef _WIN32
-    static HANDLE g_hFindFirst = INVALID_HANDLE_VALUE; // for enumerating directories. Only one can be active at once.
-    static char g_acFindFirstPattern[ EMULATOR_MAX_PATH ];
-    char acPath[ EMULATOR_MAX_PATH ];
-#else
-    #if !defined( OLDGCC )
-        static DIR * g_FindFirst = 0;
-        static REG_TYPE g_FindFirstDescriptor = -1;
-    #endif
-#endif
+    return cpu.retired_instructions() * 1000 / g_virtualClockMHz;
+} //virtual_cpu_ns
 
-    REG_TYPE syscall_id = ACCESS_REG( REG_SYSCALL );
+static uint64_t virtual_clock_ns( CPUClass & cpu, uint64_t clockid )
+{
+    uint64_t ns = virtual_cpu_ns( cpu ) + g_virtualSleepNs;
 
-#ifdef SPARCOS
-    cpu.setflag_c( 0 ); // Linux on Sparc uses the carry flag in addition to the result register to indicate success/failure
-    syscall_id = MapSparcToRiscV( syscall_id );
-    tracer.Trace( "mapped sparc syscall %u to %u\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
-    if ( 0 == syscall_id )
+    if ( 0 == clockid || 5 == clockid || 8 == clockid || 11 == clockid ) // REALTIME, REALTIME_COARSE, REALTIME_ALARM, TAI
+        ns += g_virtualEpochNs;
+    else if ( 2 == clockid || 3 == clockid ) // PROCESS_CPUTIME_ID, THREAD_CPUTIME_ID
+        ns = virtual_cpu_ns( cpu );
+
+    return ns;
+} //virtual_clock_ns
+
+#endif //X64OS || X32OS
+
+#if defined( X64OS ) || defined( X32OS )
+
+// perf_event_open counters. each event gets a host placeholder descriptor so its number is unique and close()
+// works, and read() and ioctl() on it are answered from emulator counters, so results are exact and deterministic.
+// raw events (type 4) select a counter by number: 0 instructions, 1 branches, 2 taken branches, 3 loads, 4 stores,
+// 5 syscalls, 6 x87 instructions, 7 sse instructions. the hardware events for cycles, ref-cycles, instructions, and
+// branch instructions map onto the same counters; the emulated cpu retires one instruction per cycle.
+
+enum PerfCounter { perfInstructions, perfBranches, perfTakenBranches, perfLoads, perfStores, perfSyscalls, perfX87, perfSSE, perfCounterMax };
+
+struct PerfEvent
+{
+    int descriptor;
+    int leader;              // descriptor of the group leader. the leader's own descriptor if it leads
+    PerfCounter counter;
+    uint64_t read_format;
+    uint64_t id;
+    bool enabled;
+    uint64_t count;          // accumulated during earlier enabled periods
+    uint64_t start;          // counter value when last enabled
+    uint64_t time;           // accumulated ns during earlier enabled periods
+    uint64_t time_start;
+};
+
+static EMULATOR_THREAD_LOCAL vector<PerfEvent> g_perfEvents;
+static EMULATOR_THREAD_LOCAL uint64_t g_perfNextId = 1;
+static EMULATOR_THREAD_LOCAL uint64_t g_syscallsExecuted = 0;
+
+static uint64_t perf_counter_value( CPUClass & cpu, PerfCounter c )
+{
+    switch ( c )
     {
-        printf( "unable to find a Sparc mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
-        tracer.Trace( "unable to find a Sparc mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
+        case perfInstructions: return cpu.retired_instructions();
+        case perfBranches: return cpu.event_count( CPUClass::event_branches );
+        case perfTakenBranches: return cpu.event_count( CPUClass::event_taken_branches );
+        case perfLoads: return cpu.event_count( CPUClass::event_loads );
+        case perfStores: return cpu.event_count( CPUClass::event_stores );
+        case perfSyscalls: return g_syscallsExecuted;
+        case perfX87: return cpu.event_count( CPUClass::event_x87 );
+        case perfSSE: return cpu.event_count( CPUClass::event_sse );
+        default: return 0;
     }
-#elif defined( X64OS )
-    syscall_id = MapX64ToRiscV( syscall_id );
-    tracer.Trace( "mapped x64 syscall %llu to %llu\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
-    if ( 0 == syscall_id )
+} //perf_counter_value
+
+static uint64_t perf_time_ns( CPUClass & cpu )
+{
+    if ( 0 != g_virtualClockMHz )
+        return virtual_cpu_ns( cpu );
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+} //perf_time_ns
+
+static PerfEvent * find_perf_event( int descriptor )
+{
+    for ( size_t i = 0; i < g_perfEvents.size(); i++ )
+        if ( descriptor == g_perfEvents[ i ].descriptor )
+            return & g_perfEvents[ i ];
+    return 0;
+} //find_perf_event
+
+static void update_perf_event_counting( CPUClass & cpu )
+{
+    // the cpu only classifies instructions while an event needs it since that slows emulation
+
+    bool needed = false;
+    for ( size_t i = 0; i < g_perfEvents.size(); i++ )
     {
-        printf( "unable to find an X64 mapping for syscall %llu\n", ACCESS_REG( REG_SYSCALL ) );
-        tracer.Trace( "unable to find an X64 mapping for syscall %llu\n", ACCESS_REG( REG_SYSCALL ) );
+        PerfEvent & e = g_perfEvents[ i ];
+        if ( e.enabled && perfInstructions != e.counter && perfSyscalls != e.counter )
+            needed = true;
     }
-#elif defined( X32OS )
-    syscall_id = MapX32ToRiscV( syscall_id );
-    tracer.Trace( "mapped x32 syscall %u to %u\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
-    if ( 0 == syscall_id )
+
+    cpu.count_events( needed );
+} //update_perf_event_counting
+
+static void enable_perf_event( CPUClass & cpu, PerfEvent & e, bool enable )
+{
+    if ( enable && !e.enabled )
     {
-        printf( "unable to find an X32 mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
-        tracer.Trace( "unable to find an X32 mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
+        e.start = perf_counter_value( cpu, e.counter );
+        e.time_start = perf_time_ns( cpu );
+    }
+    else if ( !enable && e.enabled )
+    {
+        e.count += perf_counter_value( cpu, e.counter ) - e.start;
+        e.time += perf_time_ns( cpu ) - e.time_start;
     }
-#endif
 
-    // Linux syscalls support up to 6 arguments
+    e.enabled = enable;
+} //enable_perf_event
 
-    if ( tracer.IsEnabled() )
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-        tracer.Trace( "syscall %s %x = %d, arg0 %x, arg1 %x, arg2 %x, arg3 %x, arg4 %x, arg5 %x\n",
-                      lookup_syscall( syscall_id ), syscall_id, syscall_id,
-                      ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ), ACCESS_REG( REG_ARG3 ),
-                      ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) );
+static uint64_t perf_event_value( CPUClass & cpu, PerfEvent & e )
+{
+    return e.count + ( e.enabled ? perf_counter_value( cpu, e.counter ) - e.start : 0 );
+} //perf_event_value
+
+static uint64_t perf_event_time( CPUClass & cpu, PerfEvent & e )
+{
+    return e.time + ( e.enabled ? perf_time_ns( cpu ) - e.time_start : 0 );
+} //perf_event_time
+
+static int open_perf_event( CPUClass & cpu, const uint8_t * pattr, int pid, int group_fd )
+{
+    uint32_t type = swap_endian32( * (uint32_t *) ( pattr + 0 ) );
+    uint64_t config = swap_endian64( * (uint64_t *) ( pattr + 8 ) );
+    uint64_t read_format = swap_endian64( * (uint64_t *) ( pattr + 32 ) );
+    uint64_t flags = swap_endian64( * (uint64_t *) ( pattr + 40 ) ); // bit 0 is disabled
+    tracer.Trace( "  perf_event_open type %u, config %llu, read_format %#llx, flags %#llx, pid %d, group_fd %d\n", type, config, read_format, flags, pid, group_fd );
+
+    PerfCounter counter = perfCounterMax;
+    if ( 0 == type ) // PERF_TYPE_HARDWARE
+    {
+        if ( 0 == config || 1 == config || 9 == config ) // cpu cycles, instructions, ref cpu cycles
+            counter = perfInstructions;
+        else if ( 4 == config ) // branch instructions
+            counter = perfBranches;
+    }
+    else if ( 4 == type && config < perfCounterMax ) // PERF_TYPE_RAW
+        counter = (PerfCounter) config;
+
+    if ( perfCounterMax == counter )
+    {
+        errno = ENOENT;
+        return -1;
+    }
+
+    if ( 0 != pid && pid != (int) getpid() )
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    int leader = -1;
+    if ( -1 != group_fd )
+    {
+        PerfEvent * pleader = find_perf_event( group_fd );
+        if ( !pleader || pleader->leader != group_fd )
+        {
+            errno = EBADF;
+            return -1;
+        }
+        leader = group_fd;
+    }
+
+#ifdef _WIN32
+    int descriptor = _open( "NUL", _O_RDONLY );
 #else
-        tracer.Trace( "syscall %s %llx = %lld, arg0 %llx, arg1 %llx, arg2 %llx, arg3 %llx, arg4 %llx, arg5 %llx\n",
-                      lookup_syscall( (uint32_t) syscall_id ), syscall_id, syscall_id,
-                      ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ), ACCESS_REG( REG_ARG3 ),
-                      ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) );
+    int descriptor = open( "/dev/null", O_RDONLY );
 #endif
+    if ( -1 == descriptor )
+        return -1;
 
-    switch ( syscall_id )
+    PerfEvent e = {};
+    e.descriptor = descriptor;
+    e.leader = ( -1 == leader ) ? descriptor : leader;
+    e.counter = counter;
+    e.read_format = read_format;
+    e.id = g_perfNextId++;
+    g_perfEvents.push_back( e );
+
+    if ( 0 == ( flags & 1 ) )
     {
-        case emulator_sys_exit: // exit
-        case SYS_exit:
-        case SYS_exit_group:
-        case SYS_tgkill:
+        enable_perf_event( cpu, g_perfEvents.back(), true );
+        update_perf_event_counting( cpu );
+    }
+
+    return descriptor;
+} //open_perf_event
+
+static bool read_perf_event( CPUClass & cpu, int descriptor, uint8_t * buffer, size_t buffer_size )
+{
+    // read_format bits: 1 total time enabled, 2 total time running, 4 id, 8 group, 16 lost
+
+    PerfEvent * pe = find_perf_event( descriptor );
+    if ( !pe )
+        return false;
+
+    vector<uint64_t> data;
+    uint64_t fmt = pe->read_format;
+
+    if ( fmt & 8 )
+    {
+        PerfEvent & leader = * find_perf_event( pe->leader );
+        data.push_back( 0 );
+        if ( fmt & 1 )
+            data.push_back( perf_event_time( cpu, leader ) );
+        if ( fmt & 2 )
+            data.push_back( perf_event_time( cpu, leader ) );  // events are never multiplexed, so they're always running
+
+        for ( size_t i = 0; i < g_perfEvents.size(); i++ ) // the leader is always first because it's created first
         {
-            g_terminate = true;
-            cpu.end_emulation();
-            g_exit_code = (int) ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
-            update_result_errno( cpu, 0 );
-            break;
+            PerfEvent & e = g_perfEvents[ i ];
+            if ( e.leader == pe->leader )
+            {
+                data[ 0 ]++;
+                data.push_back( perf_event_value( cpu, e ) );
+                if ( fmt & 4 )
+                    data.push_back( e.id );
+                if ( fmt & 16 )
+                    data.push_back( 0 );
+            }
         }
-#if defined( X32OS )
-        case emulator_sys_ugetrlimit:
+    }
+    else
+    {
+        data.push_back( perf_event_value( cpu, *pe ) );
+        if ( fmt & 1 )
+            data.push_back( perf_event_time( cpu, *pe ) );
+        if ( fmt & 2 )
+            data.push_back( perf_event_time( cpu, *pe ) );
+        if ( fmt & 4 )
+            data.push_back( pe->id );
+        if ( fmt & 16 )
+            data.push_back( 0 );
+    }
+
+    size_t len = data.size() * sizeof( uint64_t );
+    if ( buffer_size < len )
+    {
+        errno = ENOSPC;
+        update_result_errno( cpu, -1 );
+        return true;
+    }
+
+    for ( size_t i = 0; i < data.size(); i++ )
+        data[ i ] = swap_endian64( data[ i ] );
+    memcpy( buffer, data.data(), len );
+    update_result_errno( cpu, (SIGNED_REG_TYPE) len );
+    return true;
+} //read_perf_event
+
+static bool ioctl_perf_event( CPUClass & cpu, int descriptor, uint64_t request, REG_TYPE arg )
+{
+    PerfEvent * pe = find_perf_event( descriptor );
+    if ( !pe )
+        return false;
+
+    if ( 0x2407 == request ) // PERF_EVENT_IOC_ID
+    {
+        if ( !cpu.is_address_valid( arg ) || !cpu.is_address_valid( arg + sizeof( uint64_t ) - 1 ) )
         {
-            errno = EINVAL;
+            errno = EFAULT;
             update_result_errno( cpu, -1 );
-            break;
+            return true;
         }
-        case emulator_sys_set_thread_area:
-        {
-            struct linux_user_desc * pud = (linux_user_desc *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pud->swap_endianness();
-            tracer.Trace( "  entry number: %d\n", pud->entry_number );
-            tracer.Trace( "  sizeof the struct: %u\n", sizeof( struct linux_user_desc ) );
-            tracer.Trace( "  base_addr: %#x\n", pud->base_addr );
-            tracer.Trace( "  limit: %#x\n", pud->limit );
-            if ( -1 == pud->entry_number )
-            {
-                pud->entry_number = 1;
-                cpu.reg_gs() = pud->base_addr;
-            }
-            pud->swap_endianness();
-            memcpy( & g_user_desc, pud, sizeof( *pud ) );
 
-            update_result_errno( cpu, 0 );
-            break;
+        * (uint64_t *) cpu.getmem( arg ) = swap_endian64( pe->id );
+        update_result_errno( cpu, 0 );
+        return true;
+    }
+
+    if ( 0x2400 != request && 0x2401 != request && 0x2403 != request ) // ENABLE, DISABLE, RESET
+    {
+        errno = ENOTTY;
+        update_result_errno( cpu, -1 );
+        return true;
+    }
+
+    int leader = pe->leader;
+    bool group = ( 0 != ( arg & 1 ) ); // PERF_IOC_FLAG_GROUP
+
+    for ( size_t i = 0; i < g_perfEvents.size(); i++ )
+    {
+        PerfEvent & e = g_perfEvents[ i ];
+        if ( ( & e != pe ) && !( group && e.leader == leader ) )
+            continue;
+
+        if ( 0x2403 == request )
+        {
+            e.count = 0;
+            e.start = perf_counter_value( cpu, e.counter );
         }
-#endif //X32OS
-        case emulator_sys_get_thread_area:
+        else
+            enable_perf_event( cpu, e, 0x2400 == request );
+    }
+
+    update_perf_event_counting( cpu );
+    update_result_errno( cpu, 0 );
+    return true;
+} //ioctl_perf_event
+
+static void close_perf_event( CPUClass & cpu, int descriptor )
+{
+    for ( size_t i = 0; i < g_perfEvents.size(); i++ )
+    {
+        if ( descriptor == g_perfEvents[ i ].descriptor )
         {
-            struct linux_user_desc * pud = (linux_user_desc *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            memcpy( pud, & g_user_desc, sizeof( *pud ) );
-            update_result_errno( cpu, 0 );
+            g_perfEvents.erase( g_perfEvents.begin() + i );
             break;
         }
+    }
+
+    for ( size_t i = 0; i < g_perfEvents.size(); i++ ) // like Linux, orphaned group members become singletons
+        if ( descriptor == g_perfEvents[ i ].leader )
+            g_perfEvents[ i ].leader = g_perfEvents[ i ].descriptor;
+
+    update_perf_event_counting( cpu );
+} //close_perf_event
+
+#endif //X64OS || X32OS
+
 #if defined( X64OS ) || defined( X32OS )
-        case emulator_sys_x32_x64_arch_prctl:
+
+// the flight recorder. the cpu keeps the latest block entries and the emulator keeps the latest syscalls, so hard
+// terminations and host faults can show how the app got there without a trace. the app can also ask for a dump
+// with a host SIGUSR1. with -t, the disassembly of each block entry goes to the trace log. host faults only get
+// the addresses, since the fault handler can't call printf, the tracer, or the symbol and line lookups.
+
+struct FlightSyscall
+{
+    uint64_t pc;                      // just after the syscall instruction
+    uint64_t retired;                 // instructions retired before the syscall
+    uint64_t id;                      // the app's syscall number
+    uint64_t mapped;                  // the emulator's syscall number, for the name
+    uint64_t args[ 6 ];
+    int64_t result;
+    bool complete;                    // false for syscalls that didn't return, like exit, or those running at a crash
+};
+
+const size_t flightSyscallCount = 32; // a power of 2
+static EMULATOR_THREAD_LOCAL FlightSyscall g_flightSyscalls[ flightSyscallCount ];
+static EMULATOR_THREAD_LOCAL uint64_t g_flightSyscallsRecorded = 0;
+static volatile sig_atomic_t g_flightDumpRequested = 0;            // set by the host SIGUSR1 handler
+
+static void begin_flight_syscall( CPUClass & cpu, REG_TYPE syscall_id )
+{
+    FlightSyscall & f = g_flightSyscalls[ g_flightSyscallsRecorded++ & ( flightSyscallCount - 1 ) ];
+    f.pc = REG_PC;
+    f.retired = cpu.retired_instructions();
+    f.id = ACCESS_REG( REG_SYSCALL );
+    f.mapped = syscall_id;
+    f.args[ 0 ] = ACCESS_REG( REG_ARG0 );
+    f.args[ 1 ] = ACCESS_REG( REG_ARG1 );
+    f.args[ 2 ] = ACCESS_REG( REG_ARG2 );
+    f.args[ 3 ] = ACCESS_REG( REG_ARG3 );
+    f.args[ 4 ] = ACCESS_REG( REG_ARG4 );
+    f.args[ 5 ] = ACCESS_REG( REG_ARG5 );
+    f.complete = false;
+} //begin_flight_syscall
+
+static void end_flight_syscall( CPUClass & cpu )
+{
+    FlightSyscall & f = g_flightSyscalls[ ( g_flightSyscallsRecorded - 1 ) & ( flightSyscallCount - 1 ) ];
+    f.result = (SIGNED_REG_TYPE) ACCESS_REG( REG_RESULT );
+    f.complete = true;
+} //end_flight_syscall
+
+static void flight_show( bool console, const char * format, ... )
+{
+    char ac[ 400 ];
+    va_list args;
+    va_start( args, format );
+    vsnprintf( ac, sizeof( ac ), format, args );
+    va_end( args );
+
+    if ( console )
+        printf( "%s", ac );
+    tracer.Trace( "%s", ac );
+} //flight_show
+
+static void flight_recorder_dump( CPUClass & cpu, bool console )
+{
+    // oldest first. console is false when only the trace log should get the dump
+
+    uint64_t entries = cpu.flight_entries();
+    uint64_t first = ( entries > CPUClass::flight_size ) ? entries - CPUClass::flight_size : 0;
+    flight_show( console, "flight recorder: the last %llu of %llu block entries, oldest first%s\n", entries - first, entries,
+                 tracer.IsEnabled() ? ". disassembly is in " LOGFILE_NAME : "" );
+    for ( uint64_t i = first; i < entries; i++ )
+    {
+        uint64_t rip = cpu.flight_rip( i );
+        uint64_t offset = 0;
+        const char * psymbol = emulator_symbol_lookup( rip, offset );
+        const char * pline = emulator_line_lookup( rip );
+        if ( psymbol[ 0 ] )
+            flight_show( console, "  %8llx %s + %llx %s\n", rip, psymbol, offset, pline );
+        else
+            flight_show( console, "  %8llx %s\n", rip, pline );
+    }
+
+    uint64_t syscalls = g_flightSyscallsRecorded;
+    first = ( syscalls > flightSyscallCount ) ? syscalls - flightSyscallCount : 0;
+    flight_show( console, "flight recorder: the last %llu of %llu syscalls, oldest first\n", syscalls - first, syscalls );
+    for ( uint64_t i = first; i < syscalls; i++ )
+    {
+        FlightSyscall & f = g_flightSyscalls[ i & ( flightSyscallCount - 1 ) ];
+        char result[ 40 ];
+        if ( f.complete )
+            snprintf( result, sizeof( result ), "%lld", f.result );
+        else
+            strcpy( result, "(didn't return)" );
+
+        flight_show( console, "  pc %8llx instruction %llu: %s (%llu) %llx, %llx, %llx, %llx, %llx, %llx = %s\n", f.pc, f.retired,
+                     lookup_syscall( (uint32_t) f.mapped ), f.id, f.args[ 0 ], f.args[ 1 ], f.args[ 2 ], f.args[ 3 ], f.args[ 4 ], f.args[ 5 ], result );
+    }
+
+    if ( tracer.IsEnabled() )
+    {
+        tracer.Trace( "flight recorder disassembly of block entries, oldest first:\n" );
+        for ( uint64_t i = ( entries > CPUClass::flight_size ) ? entries - CPUClass::flight_size : 0; i < entries; i++ )
+            cpu.trace_disassembly( cpu.flight_rip( i ) );
+    }
+
+    fflush( stdout );
+} //flight_recorder_dump
+
+#ifndef X64OS_LIBRARY
+
+static EMULATOR_THREAD_LOCAL CPUClass * g_flightCpu = 0;          // for the host fault handler
+
+struct FlightText // a line built without printf for the fault handler, then written to stderr with write()
+{
+    char ac[ 200 ];
+    size_t len;
+
+    FlightText() : len( 0 ) {}
+
+    void add( const char * p )
+    {
+        while ( *p && len < sizeof( ac ) )
+            ac[ len++ ] = *p++;
+    }
+
+    void add_number( uint64_t v, uint64_t radix )
+    {
+        char digits[ 24 ];
+        size_t count = 0;
+        do
         {
-            REG_TYPE arch = ACCESS_REG( REG_ARG0 );
-            REG_TYPE pbase = ACCESS_REG( REG_ARG1 );
-            SIGNED_REG_TYPE result = 0;
+            digits[ count++ ] = "0123456789abcdef"[ v % radix ];
+            v /= radix;
+        } while ( 0 != v );
 
-            if ( 0x1001 == arch ) // ARCH_SET_GS
-                cpu.reg_gs() = pbase;
-            else if ( 0x1002 == arch ) // ARCH_SET_FS
-                cpu.reg_fs() = pbase;
-            else if ( 0x1003 == arch ) // ARCH_GET_FS
-                * (REG_TYPE *) cpu.getmem( pbase ) = cpu.reg_fs();
-            else if ( 0x1004 == arch ) // ARCH_GET_GS
-                * (REG_TYPE *) cpu.getmem( pbase ) = cpu.reg_gs();
-            else  // this cpu doesn't support shadow stacks or CET generally
-            {
-                errno = EINVAL;
-                result = -1;
-            }
-            update_result_errno( cpu, result );
-            break;
-        }
-#endif // X64OS || X32OS
-        case SYS_signalstack:
-        {
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_print_int64:
-        {
-            printf( REG_FORMAT, ACCESS_REG( REG_ARG0 ) );
-            fflush( stdout );
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_print_char:
-        {
-            if ( 12 != ACCESS_REG( REG_ARG0 ) )
-            {
-                send_character( (uint8_t) ACCESS_REG( REG_ARG0 ) );
-                fflush( stdout );
-            }
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_print_text: // print asciiz in a0
-        {
-            tracer.Trace( "  syscall command print string '%s'\n", (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
-            printf( "%s", (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
-            fflush( stdout );
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_get_datetime: // writes local date/time into string pointed to by a0
-        {
-            char * pdatetime = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            system_clock::time_point now = system_clock::now();
-            uint64_t ms = duration_cast<milliseconds>( now.time_since_epoch() ).count() % 1000;
-            time_t time_now = system_clock::to_time_t( now );
-            struct tm * plocal = localtime( & time_now );
-            snprintf( pdatetime, 80, "%02u:%02u:%02u.%03u", (uint32_t) plocal->tm_hour, (uint32_t) plocal->tm_min, (uint32_t) plocal->tm_sec, (uint32_t) ms );
-            tracer.Trace( "  got datetime: '%s'\n", pdatetime );
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys__llseek: // old syscall ( unsigned int fd, unsigned long high, unsigned long low, int64_t * result, unsigned int whence )
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            uint32_t offset_hi = (uint32_t) ACCESS_REG( REG_ARG1 );
-            uint32_t offset_lo = (uint32_t) ACCESS_REG( REG_ARG2 );
-            uint64_t offset = ( ( (uint64_t) offset_hi ) << 32 ) | offset_lo;
-            int64_t * presult = (int64_t *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
-            int origin = (int) ACCESS_REG( REG_ARG4 );
-            long result = lseek( descriptor, (long) offset, origin );
-            *presult = swap_endian64( result );
-            update_result_errno( cpu, result );
-            break;
-        }
-        case emulator_sys_poll:
-        {
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_access: // old syscall int access(const char *path, int mode);
-        {
-            char * path = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            REG_TYPE mode = ACCESS_REG( REG_ARG1 );
-            tracer.Trace( "  emulator_sys_access path '%s', mode %#x\n", path, mode );
-            errno = EACCES;
-            update_result_errno( cpu, -1 );
-            break;
+        while ( count > 0 && len < sizeof( ac ) )
+            ac[ len++ ] = digits[ --count ];
+    }
+
+    void write_line()
+    {
+        add( "\n" );
+        size_t written = write( 2, ac, (unsigned int) len );
+        (void) written;
+        len = 0;
+    }
+};
+
+static void flight_fault_handler( int sig )
+{
+    // the emulator crashed. only async-signal-safe work is done here: the rings are formatted into a buffer on the
+    // stack and written to stderr. then the signal takes the process down as before
+
+    signal( sig, SIG_DFL );
+    CPUClass & cpu = *g_flightCpu;
+    FlightText t;
+    t.write_line();
+    t.add( "host signal " );
+    t.add_number( sig, 10 );
+    t.add( " in the emulator at app pc " );
+    t.add_number( cpu.rip.q, 16 );
+    t.write_line();
+
+    uint64_t entries = cpu.flight_entries();
+    uint64_t first = ( entries > CPUClass::flight_size ) ? entries - CPUClass::flight_size : 0;
+    t.add( "flight recorder: the last " );
+    t.add_number( entries - first, 10 );
+    t.add( " block entries, oldest first" );
+    t.write_line();
+    for ( uint64_t i = first; i < entries; i++ )
+    {
+        t.add( "  " );
+        t.add_number( cpu.flight_rip( i ), 16 );
+        t.write_line();
+    }
+
+    uint64_t syscalls = g_flightSyscallsRecorded;
+    first = ( syscalls > flightSyscallCount ) ? syscalls - flightSyscallCount : 0;
+    t.add( "flight recorder: the last " );
+    t.add_number( syscalls - first, 10 );
+    t.add( " syscalls, oldest first" );
+    t.write_line();
+    for ( uint64_t i = first; i < syscalls; i++ )
+    {
+        FlightSyscall & f = g_flightSyscalls[ i & ( flightSyscallCount - 1 ) ];
+        t.add( "  pc " );
+        t.add_number( f.pc, 16 );
+        t.add( " instruction " );
+        t.add_number( f.retired, 10 );
+        t.add( ": " );
+        t.add( lookup_syscall( (uint32_t) f.mapped ) ); // a search of a constant table
+        t.add( " (" );
+        t.add_number( f.id, 10 );
+        t.add( ")" );
+        for ( size_t a = 0; a < _countof( f.args ); a++ )
+        {
+            t.add( ( 0 == a ) ? " " : ", " );
+            t.add_number( f.args[ a ], 16 );
+        }
+
+        if ( f.complete )
+        {
+            t.add( ( f.result < 0 ) ? " = -" : " = " );
+            t.add_number( ( f.result < 0 ) ? 0 - (uint64_t) f.result : (uint64_t) f.result, 10 );
         }
-        case SYS_getcwd:
-        {
-            // the syscall version of getcwd never uses malloc to allocate a return value. Just C runtimes do that for POSIX compliance.
+        else
+            t.add( " = (didn't return)" );
+        t.write_line();
+    }
 
-            REG_TYPE original = ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  address in vm space: %llx == %llu\n", original, original );
-            char * pin = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            size_t size = (size_t) ACCESS_REG( REG_ARG1 );
-            uint64_t pout = 0;
-#ifdef _WIN32
-            char * poutwin32 = _getcwd( acPath, sizeof( acPath ) );
-            if ( poutwin32 )
-            {
-                tracer.Trace( "  acPath: '%s', poutwin32: '%s'\n", acPath, poutwin32 );
-                backslash_to_slash( poutwin32 );
-                pout = original;
-                strcpy( pin, poutwin32 + 2 ); // get past C:
-            }
-            else
-                tracer.Trace( "  _getcwd failed on win32, error %d\n", (int) errno );
+    raise( sig );
+} //flight_fault_handler
 
-            tracer.Trace( "  getcwd returning '%s'\n", pin );
-#else
-    #ifndef OLDGCC      // the several-years-old Gnu C compiler for the RISC-V development boards
-            pout = cpu.host_to_vm_address( getcwd( pin, size ) );
-    #endif
+#ifndef _WIN32
+static void flight_dump_handler( int sig )
+{
+    g_flightDumpRequested = 1;
+    x64::request_signal_check();
+} //flight_dump_handler
 #endif
-            if ( pout )
-                update_result_errno( cpu, original );
-            else
-                update_result_errno( cpu, errno );
-            break;
-        }
-        case SYS_fcntl:
-        {
-            int fd = (int) ACCESS_REG( REG_ARG0 );
-            int op = (int) ACCESS_REG( REG_ARG1 );
 
-            if ( 1 == op ) // F_GETFD
-                ACCESS_REG( REG_RESULT ) = 1; // FD_CLOEXEC
-            else if ( 3 == op )
-                ACCESS_REG( REG_RESULT ) = 2; // O_RDWR
-            else
-                tracer.Trace( "unhandled SYS_fcntl operation %d\n", op );
-            break;
-        }
-        case SYS_clock_nanosleep:
-        {
-            clockid_t clockid = (clockid_t) ACCESS_REG( REG_ARG0 );
-            int flags = (int) ACCESS_REG( REG_ARG1 );
-            tracer.Trace( "  nanosleep id %d flags %x\n", clockid, flags );
+static void start_flight_recorder( CPUClass & cpu )
+{
+    g_flightCpu = & cpu;
+    signal( SIGSEGV, flight_fault_handler );
+    signal( SIGILL, flight_fault_handler );
+    signal( SIGFPE, flight_fault_handler );
+#ifndef _WIN32
+    signal( SIGBUS, flight_fault_handler );
+    signal( SIGUSR1, flight_dump_handler );
+#endif
+} //start_flight_recorder
 
-            const struct timespec_syscall * request = (const struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-            struct timespec_syscall * remain = 0;
-            if ( 0 != ACCESS_REG( REG_ARG3 ) )
-                remain = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
+#endif //X64OS_LIBRARY
 
-#ifdef X32OS
-            struct timespec_syscall_x32 local_request = * (struct timespec_syscall_x32 *) request;
-            local_request.tv_sec = swap_endian32( local_request.tv_sec );
-            local_request.tv_nsec = swap_endian32( local_request.tv_nsec );
-#else
-            struct timespec_syscall local_request = * request;
-            local_request.tv_sec = swap_endian64( local_request.tv_sec );
-            local_request.tv_nsec = swap_endian64( local_request.tv_nsec );
-#endif //X32OS
+static void check_flight_dump_request( CPUClass & cpu )
+{
+    if ( g_flightDumpRequested )
+    {
+        g_flightDumpRequested = 0;
+        flight_recorder_dump( cpu, true );
+    }
+} //check_flight_dump_request
+
+#endif //X64OS || X32OS
+
+#if defined( X64OS )
+
+// signals. handlers registered with rt_sigaction run at instruction boundaries on a Linux-compatible rt_sigframe
+// built on the app's stack, and rt_sigreturn restores the interrupted state. signals come from kill and tgkill,
+// itimers and alarm, posix timers, and host SIGINT and SIGTERM once the app handles those. timers use the virtual
+// clock with -k, so delivery is deterministic, and host time otherwise, polled every signalPollInstructions while
+// a timer is armed. the cpu checks nothing while no timer is armed and no signal is pending.
+
+const int linuxSignals = 64;
+const uint64_t signalPollInstructions = 100000;                  // about a tenth of a millisecond on a fast host
+const size_t itimerCount = 3;                                    // ITIMER_REAL, ITIMER_VIRTUAL, ITIMER_PROF
+const size_t signalTimerCount = itimerCount + 32;                // posix timers follow the itimers
+
+const uint64_t linux_SIG_DFL = 0;
+const uint64_t linux_SIG_IGN = 1;
+const uint64_t linux_SA_SIGINFO = 0x4;
+const uint64_t linux_SA_ONSTACK = 0x08000000;
+const uint64_t linux_SA_NODEFER = 0x40000000;
+const uint64_t linux_SA_RESETHAND = 0x80000000;
+const int linux_SI_USER = 0;
+const int linux_SI_KERNEL = 0x80;
+const int linux_SI_TIMER = -2;
+const int linux_SI_TKILL = -6;
+const int linux_SS_ONSTACK = 1;
+const int linux_SS_DISABLE = 2;
+
+struct linux_sigaction_x64                                      // the kernel's layout, not glibc's
+{
+    uint64_t handler;
+    uint64_t flags;
+    uint64_t restorer;
+    uint64_t mask;
+};
 
-            uint64_t ms = local_request.tv_sec * 1000 + local_request.tv_nsec / 1000000;
-            tracer.Trace( "  nanosleep sec %llu, nsec %llu == %llu ms\n", (uint64_t) local_request.tv_sec, (uint64_t) local_request.tv_nsec, ms );
-            sleep_ms( ms ); // ignore remain argument because there are no signals to wake the thread
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case SYS_sched_setaffinity:
+struct linux_stack_x64
+{
+    uint64_t ss_sp;
+    int32_t ss_flags;
+    int32_t pad;
+    uint64_t ss_size;
+};
+
+struct linux_sigcontext_x64
+{
+    uint64_t r8, r9, r10, r11, r12, r13, r14, r15;
+    uint64_t rdi, rsi, rbp, rbx, rdx, rax, rcx, rsp, rip, eflags;
+    uint16_t cs, gs, fs, ss;
+    uint64_t err, trapno, oldmask, cr2;
+    uint64_t fpstate;                                            // points at an fxsave-format area
+    uint64_t reserved1[ 8 ];
+};
+
+struct linux_rt_sigframe_x64
+{
+    uint64_t pretcode;                                           // the handler returns here, to sa_restorer
+    uint64_t uc_flags;
+    uint64_t uc_link;
+    linux_stack_x64 uc_stack;
+    linux_sigcontext_x64 uc_mcontext;
+    uint64_t uc_sigmask;
+    int32_t info_signo;                                          // siginfo_t is 128 bytes
+    int32_t info_errno;
+    int32_t info_code;
+    int32_t info_pad;
+    int32_t info_pid_or_tid;                                     // kill: sender pid. timers: timer id
+    int32_t info_uid_or_overrun;                                 // kill: sender uid. timers: overrun count
+    uint64_t info_value;                                         // timers: sigev_value
+    uint8_t info_rest[ 96 ];
+};
+
+struct SignalInfo
+{
+    int code;
+    int pid_or_tid;
+    int uid_or_overrun;
+    uint64_t value;
+};
+
+struct SignalTimer
+{
+    bool in_use;
+    bool armed;
+    int signo;                                                   // 0 for SIGEV_NONE
+    int code;
+    uint64_t clock;                                              // Linux clock id the deadline is on
+    uint64_t deadline;                                           // ns on clock
+    uint64_t interval;                                           // ns. 0 for one-shot timers
+    uint64_t value;                                              // sigev_value
+    uint64_t overrun;
+};
+
+static EMULATOR_THREAD_LOCAL linux_sigaction_x64 g_sigActions[ linuxSignals + 1 ];
+static EMULATOR_THREAD_LOCAL SignalInfo g_sigInfo[ linuxSignals + 1 ];   // for pending signals. standard signals don't queue
+static EMULATOR_THREAD_LOCAL uint64_t g_sigPending = 0;                  // bit n - 1 for signal n
+static EMULATOR_THREAD_LOCAL uint64_t g_sigBlocked = 0;
+static EMULATOR_THREAD_LOCAL bool g_sigSuspended = false;                // rt_sigsuspend is waiting. g_sigSuspendMask is restored by the handler's return
+static EMULATOR_THREAD_LOCAL uint64_t g_sigSuspendMask = 0;
+static EMULATOR_THREAD_LOCAL linux_stack_x64 g_sigAltStack = { 0, linux_SS_DISABLE, 0, 0 };
+static EMULATOR_THREAD_LOCAL SignalTimer g_sigTimers[ signalTimerCount ];
+static volatile sig_atomic_t g_hostSigint = 0;                          // set by host signal handlers
+static volatile sig_atomic_t g_hostSigterm = 0;
+
+static uint64_t signal_bit( int sig ) { return 1ull << ( sig - 1 ); }
+
+static bool signal_default_ignored( int sig )
+{
+    return ( 17 == sig || 18 == sig || 23 == sig || 28 == sig ); // SIGCHLD, SIGCONT, SIGURG, SIGWINCH
+} //signal_default_ignored
+
+static bool signal_discarded( int sig ) // Linux drops signals that would be ignored when they are generated
+{
+    uint64_t handler = g_sigActions[ sig ].handler;
+    return ( linux_SIG_IGN == handler ) || ( linux_SIG_DFL == handler && signal_default_ignored( sig ) );
+} //signal_discarded
+
+static bool is_cpu_clock( uint64_t clockid ) { return ( 2 == clockid || 3 == clockid ); } // PROCESS_CPUTIME_ID, THREAD_CPUTIME_ID
+
+static uint64_t signal_clock_ns( CPUClass & cpu, uint64_t clockid )
+{
+    if ( 0 != g_virtualClockMHz )
+        return virtual_clock_ns( cpu, clockid );
+
+    if ( is_cpu_clock( clockid ) )
+        return (uint64_t) clock() * ( 1000000000 / CLOCKS_PER_SEC );
+
+    if ( 0 == clockid || 5 == clockid || 8 == clockid || 11 == clockid ) // the realtime clocks
+        return duration_cast<nanoseconds>( system_clock::now().time_since_epoch() ).count();
+
+    return duration_cast<nanoseconds>( steady_clock::now().time_since_epoch() ).count();
+} //signal_clock_ns
+
+static void raise_guest_signal( int sig, int code, int pid_or_tid, int uid_or_overrun, uint64_t value )
+{
+    if ( signal_discarded( sig ) )
+    {
+        tracer.Trace( "  signal %d is discarded\n", sig );
+        return;
+    }
+
+    tracer.Trace( "  signal %d is pending\n", sig );
+    g_sigPending |= signal_bit( sig );
+    SignalInfo & si = g_sigInfo[ sig ];
+    si.code = code;
+    si.pid_or_tid = pid_or_tid;
+    si.uid_or_overrun = uid_or_overrun;
+    si.value = value;
+} //raise_guest_signal
+
+static void host_signal_handler( int sig )
+{
+    if ( SIGINT == sig )
+        g_hostSigint = 1;
+    else
+        g_hostSigterm = 1;
+    x64::request_signal_check();
+} //host_signal_handler
+
+static void update_host_signal( int sig )
+{
+    // forward host SIGINT and SIGTERM only while the app handles them, so ^c still stops the emulator otherwise
+
+#ifndef X64OS_LIBRARY
+    int host_sig = ( 2 == sig ) ? SIGINT : ( 15 == sig ) ? SIGTERM : 0;
+    if ( 0 != host_sig )
+    {
+        uint64_t handler = g_sigActions[ sig ].handler;
+        signal( host_sig, ( linux_SIG_DFL == handler ) ? SIG_DFL : ( linux_SIG_IGN == handler ) ? SIG_IGN : host_signal_handler );
+    }
+#endif
+} //update_host_signal
+
+static void collect_host_signals()
+{
+    if ( g_hostSigint )
+    {
+        g_hostSigint = 0;
+        raise_guest_signal( 2, linux_SI_KERNEL, 0, 0, 0 );
+    }
+    if ( g_hostSigterm )
+    {
+        g_hostSigterm = 0;
+        raise_guest_signal( 15, linux_SI_KERNEL, 0, 0, 0 );
+    }
+} //collect_host_signals
+
+static void fire_signal_timers( CPUClass & cpu )
+{
+    for ( size_t i = 0; i < signalTimerCount; i++ )
+    {
+        SignalTimer & t = g_sigTimers[ i ];
+        if ( !t.armed )
+            continue;
+
+        uint64_t now = signal_clock_ns( cpu, t.clock );
+        if ( now < t.deadline )
+            continue;
+
+        if ( 0 != t.interval )
         {
-            tracer.Trace( "  setaffinity, EPERM %d\n", EPERM );
-            update_result_errno( cpu, EPERM );
-            break;
+            uint64_t missed = ( now - t.deadline ) / t.interval;
+            t.overrun = missed;
+            t.deadline += ( missed + 1 ) * t.interval;
         }
-        case SYS_sched_getaffinity:
+        else
+            t.armed = false;
+
+        tracer.Trace( "  timer %zu expired, signal %d\n", i, t.signo );
+        if ( 0 != t.signo )
+            raise_guest_signal( t.signo, t.code, ( i < itimerCount ) ? 0 : (int) ( i - itimerCount ), (int) t.overrun, t.value );
+    }
+} //fire_signal_timers
+
+static uint64_t ns_until_next_timer( CPUClass & cpu, bool include_cpu_clocks )
+{
+    uint64_t next = UINT64_MAX;
+    for ( size_t i = 0; i < signalTimerCount; i++ )
+    {
+        SignalTimer & t = g_sigTimers[ i ];
+        if ( t.armed && ( include_cpu_clocks || !is_cpu_clock( t.clock ) ) )
         {
-            tracer.Trace( "  getaffinity, EPERM %d\n", EPERM );
-            update_result_errno( cpu, EPERM );
-            break;
+            uint64_t now = signal_clock_ns( cpu, t.clock );
+            next = get_min( next, ( t.deadline > now ) ? t.deadline - now : 0 );
         }
-        case SYS_sched_yield:
+    }
+    return next;
+} //ns_until_next_timer
+
+static void update_signal_checks( CPUClass & cpu )
+{
+    // have the cpu call emulator_check_signals() when a signal can be delivered or the next timer is due
+
+    fire_signal_timers( cpu );
+
+    if ( 0 != ( g_sigPending & ~g_sigBlocked ) )
+        CPUClass::request_signal_check();
+
+    uint64_t next = ns_until_next_timer( cpu, true );
+    uint64_t at = 0;
+    if ( UINT64_MAX != next )
+    {
+        if ( 0 == g_virtualClockMHz )
+            at = cpu.retired_instructions() + signalPollInstructions;
+        else if ( next >= UINT64_MAX / g_virtualClockMHz )
+            at = UINT64_MAX;
+        else
+            at = cpu.retired_instructions() + ( next * g_virtualClockMHz + 999 ) / 1000; // first instruction at or past the deadline
+    }
+
+    cpu.set_signal_check_at( at );
+} //update_signal_checks
+
+static bool interruptible_sleep( CPUClass & cpu, uint64_t ns, uint64_t & remaining )
+{
+    // sleep on the host or virtual clock until ns pass (UINT64_MAX means forever) or a timer
+    // or the host raises a signal that can be delivered. returns true if a signal cut the sleep short.
+
+    for ( ;; )
+    {
+        collect_host_signals();
+        fire_signal_timers( cpu );
+        if ( 0 != ( g_sigPending & ~g_sigBlocked ) )
         {
-            // always succeeds on Linux, even though nothing happens here.
-            update_result_errno( cpu, 0 );
-            break;
+            remaining = ns;
+            return true;
         }
-        case SYS_newfstat:
-        {
-            // two arguments: descriptor and pointer to the stat buf
-            tracer.Trace( "  syscall command SYS_newfstat\n" );
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            int result = 0;
 
-#ifdef _WIN32
-            struct stat_linux_syscall local_stat = {0};
-            result = fill_pstat_windows( descriptor, & local_stat, 0 );
-            if ( 0 == result )
-            {
-                #ifdef X64OS
-                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-                    pout->st_dev = local_stat.st_dev;
-                    pout->st_ino = local_stat.st_ino;
-                    pout->st_mode = local_stat.st_mode;
-                    pout->st_nlink = local_stat.st_nlink;
-                    pout->st_uid = local_stat.st_uid;
-                    pout->st_gid = local_stat.st_gid;
-                    pout->st_rdev = local_stat.st_rdev;
-                    pout->st_size = local_stat.st_size;
-                    pout->st_blksize = local_stat.st_blksize;
-                    pout->st_blocks = local_stat.st_blocks;
-                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
-                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
-                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) pout->st_size, (int) offsetof( struct stat_linux_syscall_x64, st_size ) );
-                    pout->swap_endianness();
-                    tracer.Trace( "post-swap mode: %#x\n", pout->st_mode );
-                #else // X64OS
-                    size_t cbStat = sizeof( struct stat_linux_syscall );
-                    assert( 128 == cbStat );  // 128 is the size of the stat struct this syscall on RISC-V Linux
-                    local_stat.swap_endianness();
-                    memcpy( cpu.getmem( ACCESS_REG( REG_ARG1 ) ), & local_stat, cbStat );
-                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
-                #endif // X64OS
-            }
-            else
-            {
-                errno = 2;
-                tracer.Trace( "  fill_pstat_windows failed\n" );
-            }
-#else // _WIN32
-            tracer.Trace( "  sizeof struct stat: %d\n", (int) sizeof( struct stat ) );
-            struct stat local_stat = {0};
-            result = fstat( descriptor, & local_stat );
-            if ( 0 == result )
-            {
-                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
+        if ( 0 == ns )
+            return false;
 
-                #ifdef X64OS
-                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-                #else
-                    struct stat_linux_syscall * pout = (struct stat_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-                #endif
+        uint64_t step = get_min( ns, ns_until_next_timer( cpu, false ) ); // cpu clocks don't advance while sleeping
+        if ( UINT64_MAX == step )
+            step = 10000000; // waiting forever; poll for host signals
 
-                pout->st_dev = local_stat.st_dev;
-                pout->st_ino = local_stat.st_ino;
-                pout->st_mode = local_stat.st_mode;
-                pout->st_nlink = local_stat.st_nlink;
-                pout->st_uid = local_stat.st_uid;
-                pout->st_gid = local_stat.st_gid;
-                pout->st_rdev = local_stat.st_rdev;
-                pout->st_size = local_stat.st_size;
-                pout->st_blksize = local_stat.st_blksize;
-                pout->st_blocks = local_stat.st_blocks;
+        if ( 0 != g_virtualClockMHz )
+            g_virtualSleepNs += step;
+        else
+            sleep_ms( ( step + 999999 ) / 1000000 );
 
-                #ifdef __APPLE__
-                    pout->st_atim.tv_sec = local_stat.st_atimespec.tv_sec;
-                    pout->st_atim.tv_nsec = local_stat.st_atimespec.tv_nsec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtimespec.tv_sec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtimespec.tv_nsec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctimespec.tv_sec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctimespec.tv_nsec;
-                #elif defined( __mc68000__ )
-                    pout->st_atim.tv_sec = local_stat.st_atime;
-                    pout->st_mtim.tv_sec = local_stat.st_mtime;
-                    pout->st_ctim.tv_sec = local_stat.st_ctime;
-                #else
-                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
-                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
-                #endif // !__APPLE__
+        if ( UINT64_MAX != ns )
+            ns -= step;
+    }
+} //interruptible_sleep
 
-                tracer.Trace( "  file size %d, mode %#x, isdir %s\n", (int) local_stat.st_size, local_stat.st_mode, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
-                pout->swap_endianness();
-            }
-            else
-                tracer.Trace( "  fstat failed, error %d\n", errno );
-#endif // !_WIN32
+static void terminate_for_signal( CPUClass & cpu, int sig )
+{
+    tracer.Trace( "  signal %d terminates the app\n", sig );
+    g_terminate = true;
+    g_exit_code = 128 + sig; // what a shell reports for a process killed by a signal
+    cpu.end_emulation();
+} //terminate_for_signal
 
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_gettimeofday:
-        {
-            tracer.Trace( "  syscall command SYS_gettimeofday\n" );
-            linux_timeval * ptimeval = (linux_timeval *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            int result = 0;
-            if ( 0 != ptimeval )
-            {
-                linux_timeval tv = {0};
-                result = gettimeofday( &tv );
+static void save_fpstate( CPUClass & cpu, uint8_t * p )
+{
+    // fxsave format. st(i) is stored in order from the top of the stack
+
+    memset( p, 0, 512 );
+    * (uint16_t *) ( p + 0 ) = cpu.x87_fpu_control_word;
+    * (uint16_t *) ( p + 2 ) = (uint16_t) ( ( cpu.x87_fpu_status_word & ~( 7 << 11 ) ) | ( cpu.fp_sp << 11 ) );
+    * (uint32_t *) ( p + 24 ) = cpu.mxcsr;
+    * (uint32_t *) ( p + 28 ) = 0xffff; // mxcsr_mask
+    for ( uint32_t i = 0; i < 8; i++ )
+        memcpy( p + 32 + 16 * i, & cpu.fregs[ ( cpu.fp_sp + i ) % 8 ], get_min( sizeof( float80_t ), (size_t) 16 ) );
+    for ( uint32_t i = 0; i < 16; i++ )
+        memcpy( p + 160 + 16 * i, & cpu.xregs[ i ], 16 );
+} //save_fpstate
+
+static void restore_fpstate( CPUClass & cpu, const uint8_t * p )
+{
+    cpu.x87_fpu_control_word = * (uint16_t *) ( p + 0 );
+    cpu.x87_fpu_status_word = * (uint16_t *) ( p + 2 );
+    cpu.fp_sp = ( cpu.x87_fpu_status_word >> 11 ) & 7;
+    cpu.mxcsr = * (uint32_t *) ( p + 24 );
+    for ( uint32_t i = 0; i < 8; i++ )
+        memcpy( & cpu.fregs[ ( cpu.fp_sp + i ) % 8 ], p + 32 + 16 * i, get_min( sizeof( float80_t ), (size_t) 16 ) );
+    for ( uint32_t i = 0; i < 16; i++ )
+        memcpy( & cpu.xregs[ i ], p + 160 + 16 * i, 16 );
+} //restore_fpstate
+
+static bool on_alt_stack( uint64_t sp )
+{
+    return ( 0 != g_sigAltStack.ss_size ) && ( sp > g_sigAltStack.ss_sp ) && ( sp <= g_sigAltStack.ss_sp + g_sigAltStack.ss_size );
+} //on_alt_stack
 
-                if ( 0 == result )
-                {
-                    ptimeval->tv_sec = tv.tv_sec;
-                    ptimeval->tv_usec = tv.tv_usec;
+static void deliver_guest_signal( CPUClass & cpu, int sig )
+{
+    linux_sigaction_x64 & act = g_sigActions[ sig ];
+    if ( linux_SIG_IGN == act.handler || ( linux_SIG_DFL == act.handler && signal_default_ignored( sig ) ) )
+        return;
 
-                    ptimeval->tv_sec = swap_endian64( ptimeval->tv_sec );
-                    ptimeval->tv_usec = swap_endian64( ptimeval->tv_usec );
+    if ( linux_SIG_DFL == act.handler )
+    {
+        terminate_for_signal( cpu, sig );
+        return;
+    }
 
-                    tracer.Trace( "    tv.tv_sec %#llx, swapped %#llx\n", tv.tv_sec, ptimeval->tv_sec );
-                    tracer.Trace( "    tv_usec %#llx, swapped %#llx\n", swap_endian64( ptimeval->tv_usec ), ptimeval->tv_usec );
-                }
-            }
+    tracer.Trace( "  delivering signal %d to handler %llx at rip %llx\n", sig, act.handler, cpu.rip.q );
+
+    uint64_t old_sp = cpu.regs[ x64::rsp ].q;
+    uint64_t sp = old_sp - 128; // skip the red zone
+    if ( ( act.flags & linux_SA_ONSTACK ) && !( g_sigAltStack.ss_flags & linux_SS_DISABLE ) && !on_alt_stack( old_sp ) )
+        sp = g_sigAltStack.ss_sp + g_sigAltStack.ss_size;
+
+    uint64_t fpstate = ( sp - 512 ) & ~63ull;
+    uint64_t frame = ( ( fpstate - sizeof( linux_rt_sigframe_x64 ) ) & ~15ull ) - 8; // as if the handler was called
+    if ( !cpu.is_address_valid( frame ) || !cpu.is_address_valid( fpstate + 511 ) )
+        emulator_hard_termination( cpu, "no room on the stack for a signal frame. signal:", sig );
+
+    save_fpstate( cpu, cpu.getmem( fpstate ) );
+
+    linux_rt_sigframe_x64 f;
+    memset( &f, 0, sizeof( f ) );
+    f.pretcode = act.restorer;
+    f.uc_flags = 2; // UC_SIGCONTEXT_SS
+    f.uc_stack.ss_sp = g_sigAltStack.ss_sp;
+    f.uc_stack.ss_size = g_sigAltStack.ss_size;
+    f.uc_stack.ss_flags = on_alt_stack( old_sp ) ? linux_SS_ONSTACK : g_sigAltStack.ss_flags;
+
+    linux_sigcontext_x64 & mc = f.uc_mcontext;
+    mc.r8 = cpu.regs[ x64::r8 ].q;
+    mc.r9 = cpu.regs[ x64::r9 ].q;
+    mc.r10 = cpu.regs[ x64::r10 ].q;
+    mc.r11 = cpu.regs[ x64::r11 ].q;
+    mc.r12 = cpu.regs[ x64::r12 ].q;
+    mc.r13 = cpu.regs[ x64::r13 ].q;
+    mc.r14 = cpu.regs[ x64::r14 ].q;
+    mc.r15 = cpu.regs[ x64::r15 ].q;
+    mc.rdi = cpu.regs[ x64::rdi ].q;
+    mc.rsi = cpu.regs[ x64::rsi ].q;
+    mc.rbp = cpu.regs[ x64::rbp ].q;
+    mc.rbx = cpu.regs[ x64::rbx ].q;
+    mc.rdx = cpu.regs[ x64::rdx ].q;
+    mc.rax = cpu.regs[ x64::rax ].q;
+    mc.rcx = cpu.regs[ x64::rcx ].q;
+    mc.rsp = old_sp;
+    mc.rip = cpu.rip.q;
+    mc.eflags = cpu.reg_rflags();
+    mc.cs = 0x33;
+    mc.ss = 0x2b;
+    mc.oldmask = g_sigBlocked;
+    mc.fpstate = fpstate;
+
+    f.uc_sigmask = g_sigSuspended ? g_sigSuspendMask : g_sigBlocked; // after rt_sigsuspend the handler returns to the prior mask
+    g_sigSuspended = false;
+
+    SignalInfo & si = g_sigInfo[ sig ];
+    f.info_signo = sig;
+    f.info_code = si.code;
+    f.info_pid_or_tid = si.pid_or_tid;
+    f.info_uid_or_overrun = si.uid_or_overrun;
+    f.info_value = si.value;
+
+    memcpy( cpu.getmem( frame ), &f, sizeof( f ) );
+
+    g_sigBlocked |= act.mask;
+    if ( ! ( act.flags & linux_SA_NODEFER ) )
+        g_sigBlocked |= signal_bit( sig );
+    g_sigBlocked &= ~( signal_bit( 9 ) | signal_bit( 19 ) ); // SIGKILL and SIGSTOP can't be blocked
+    if ( act.flags & linux_SA_RESETHAND )
+    {
+        act.handler = linux_SIG_DFL;
+        act.flags &= ~linux_SA_SIGINFO;
+    }
+
+    cpu.regs[ x64::rsp ].q = frame;
+    cpu.regs[ x64::rdi ].q = sig;
+    cpu.regs[ x64::rsi ].q = frame + offsetof( linux_rt_sigframe_x64, info_signo );
+    cpu.regs[ x64::rdx ].q = frame + offsetof( linux_rt_sigframe_x64, uc_flags );
+    cpu.regs[ x64::rax ].q = 0;
+    cpu.reg_rflags() &= ~( 1ull << 10 ); // the ABI requires DF clear on function entry
+    cpu.rip.q = act.handler;
+} //deliver_guest_signal
+
+static void guest_sigreturn( CPUClass & cpu )
+{
+    uint64_t frame = cpu.regs[ x64::rsp ].q - 8; // the handler's ret popped pretcode
+    if ( !cpu.is_address_valid( frame ) || !cpu.is_address_valid( frame + sizeof( linux_rt_sigframe_x64 ) - 1 ) )
+        emulator_hard_termination( cpu, "rt_sigreturn has an invalid frame:", frame );
+
+    linux_rt_sigframe_x64 f;
+    memcpy( &f, cpu.getmem( frame ), sizeof( f ) );
+    linux_sigcontext_x64 & mc = f.uc_mcontext;
+
+    cpu.regs[ x64::r8 ].q = mc.r8;
+    cpu.regs[ x64::r9 ].q = mc.r9;
+    cpu.regs[ x64::r10 ].q = mc.r10;
+    cpu.regs[ x64::r11 ].q = mc.r11;
+    cpu.regs[ x64::r12 ].q = mc.r12;
+    cpu.regs[ x64::r13 ].q = mc.r13;
+    cpu.regs[ x64::r14 ].q = mc.r14;
+    cpu.regs[ x64::r15 ].q = mc.r15;
+    cpu.regs[ x64::rdi ].q = mc.rdi;
+    cpu.regs[ x64::rsi ].q = mc.rsi;
+    cpu.regs[ x64::rbp ].q = mc.rbp;
+    cpu.regs[ x64::rbx ].q = mc.rbx;
+    cpu.regs[ x64::rdx ].q = mc.rdx;
+    cpu.regs[ x64::rax ].q = mc.rax;
+    cpu.regs[ x64::rcx ].q = mc.rcx;
+    cpu.regs[ x64::rsp ].q = mc.rsp;
+    cpu.rip.q = mc.rip;
+    cpu.reg_rflags() = ( cpu.reg_rflags() & ~0x0cd5ull ) | ( mc.eflags & 0x0cd5 ); // CF PF AF ZF SF DF OF
+    if ( 0 != mc.fpstate && cpu.is_address_valid( mc.fpstate ) )
+        restore_fpstate( cpu, cpu.getmem( mc.fpstate ) );
+
+    g_sigBlocked = f.uc_sigmask & ~( signal_bit( 9 ) | signal_bit( 19 ) );
+    tracer.Trace( "  rt_sigreturn to rip %llx, mask %llx\n", cpu.rip.q, g_sigBlocked );
+} //guest_sigreturn
+
+void emulator_check_signals( CPUClass & cpu )
+{
+    check_flight_dump_request( cpu );
+    collect_host_signals();
+    fire_signal_timers( cpu );
 
-            tracer.Trace( "  returning result %d\n", result );
-            ACCESS_REG( REG_RESULT ) = result;
-            break;
-        }
-        case SYS_lseek:
-        {
-            tracer.Trace( "  syscall command SYS_lseek\n" );
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            int offset = (int) ACCESS_REG( REG_ARG1 );
-            int origin = (int) ACCESS_REG( REG_ARG2 );
+    uint64_t deliverable = g_sigPending & ~g_sigBlocked;
+    if ( 0 != deliverable )
+    {
+        int sig = 1;
+        while ( ! ( deliverable & signal_bit( sig ) ) )
+            sig++;
 
-            long result = lseek( descriptor, offset, origin );
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_read:
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            void * buffer = cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            uint32_t buffer_size = (uint32_t) ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  syscall command SYS_read. descriptor %d, buffer_size %u, buffer %llx\n", descriptor, buffer_size, ACCESS_REG( REG_ARG1 ) );
+        g_sigPending &= ~signal_bit( sig );
+        deliver_guest_signal( cpu, sig );
+    }
 
-            if ( 0 == descriptor ) //&& 1 == buffer_size )
-            {
-#ifdef _WIN32
-                int r = g_consoleConfig.linux_getch();
-#else
-                int r = g_consoleConfig.portable_getch();
-#endif
-                if ( EOF == r )
-                {
-                    ACCESS_REG( REG_RESULT ) = 0;
-                    tracer.Trace( "  getch reached the end of file on stdin\n" );
-                }
-                else
-                {
-                    * (char *) buffer = (char) r;
-                    ACCESS_REG( REG_RESULT ) = 1;
-                    tracer.Trace( "  getch read character %u == '%c'\n", (uint8_t) r, printable( (uint8_t) r ) );
-                }
-                break;
-            }
-            else if ( timebaseFrequencyDescriptor == descriptor && buffer_size >= 8 )
-            {
-                uint64_t freq = 1000000000000; // nanoseconds, but the LPi4a is off by 3 orders of magnitude, so I replicate that bug here
-                freq = swap_endian64( freq );
-                memcpy( buffer, &freq, 8 );
-                update_result_errno( cpu, 8 );
-                break;
-            }
-            else if ( osreleaseDescriptor == descriptor && buffer_size >= 8 )
-            {
-                memcpy( buffer, "9.69", 5 );
-                update_result_errno( cpu, 5 );
-                break;
-            }
+    if ( !g_terminate )
+        update_signal_checks( cpu ); // more may be pending; they're delivered one per instruction, nesting like on Linux
+} //emulator_check_signals
 
-            int result = read( descriptor, buffer, buffer_size );
-            if ( result > 0 )
-                tracer.TraceBinaryData( (uint8_t *) buffer, (int) get_min( (int) 0x100, result ), 4 );
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_write:
-        {
-            tracer.Trace( "  syscall command SYS_write. fd %lld, buf %llx, count %lld\n", (uint64_t) ACCESS_REG( REG_ARG0 ), (uint64_t) ACCESS_REG( REG_ARG1 ), (uint64_t) ACCESS_REG( REG_ARG2 ) );
+static void read_timer_ns( CPUClass & cpu, SignalTimer & t, uint64_t & value, uint64_t & interval )
+{
+    uint64_t now = signal_clock_ns( cpu, t.clock );
+    value = !t.armed ? 0 : ( t.deadline > now ) ? t.deadline - now : 1; // 0 would mean disarmed
+    interval = t.interval;
+} //read_timer_ns
 
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            uint8_t * p = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            REG_TYPE count = ACCESS_REG( REG_ARG2 );
+static void arm_timer( CPUClass & cpu, SignalTimer & t, uint64_t value, uint64_t interval, bool absolute )
+{
+    t.armed = ( 0 != value );
+    t.interval = interval;
+    t.overrun = 0;
+    t.deadline = absolute ? value : signal_clock_ns( cpu, t.clock ) + value;
+    update_signal_checks( cpu );
+} //arm_timer
 
-            tracer.Trace( "    descriptor %d, pdata %p, count %u\n", descriptor, p, count );
+#elif defined( X32OS )
 
-            if ( 0 == descriptor ) // stdin
-            {
-                errno = EACCES;
-                update_result_errno( cpu, -1 );
-            }
-            else
-            {
-                if ( 1 == descriptor || 2 == descriptor ) // stdout / stderr
-                    tracer.Trace( "  writing '%.*s'\n", (int) count, p );
+void emulator_check_signals( CPUClass & cpu ) { check_flight_dump_request( cpu ); } // signals aren't delivered to 32-bit apps
 
-                tracer.TraceBinaryData( p, (uint32_t) count, 4 );
-                size_t written;
-#ifdef _WIN32
-                if ( 1 == descriptor || 2 == descriptor ) // stdout / stderr
-                    written = WinWrite( descriptor, p, (int) count );
-                else
-#endif
-                written = write( descriptor, p, (int) count );
-                update_result_errno( cpu, (REG_TYPE) written );
-            }
+#endif //X64OS
+
+// descriptors opened by the app are tracked so checkpoints can reopen them on restore
+
+struct OpenFileEntry
+{
+    int descriptor;
+    int directory;                    // -100 (AT_FDCWD) or the descriptor the path is relative to
+    int flags;                        // host flags, already translated
+    int mode;
+    int64_t offset;                   // only valid in checkpoint files
+    char path[ EMULATOR_MAX_PATH ];
+};
+
+static EMULATOR_THREAD_LOCAL vector<OpenFileEntry> g_openFiles;
+
+static void untrack_open_file( int descriptor )
+{
+    for ( size_t i = 0; i < g_openFiles.size(); i++ )
+    {
+        if ( descriptor == g_openFiles[ i ].descriptor )
+        {
+            g_openFiles.erase( g_openFiles.begin() + i );
             break;
         }
-        case SYS_open:
-        {
-            tracer.Trace( "  syscall command SYS_open\n" );
+    }
+} //untrack_open_file
 
-            // a0: asciiz string of file to open. a1: flags. a2: mode
+static void track_open_file( int descriptor, int directory, const char * path, int flags, int mode )
+{
+    if ( descriptor < 0 || strlen( path ) >= EMULATOR_MAX_PATH )
+        return;
 
-            const char * pname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            int flags = (int) ACCESS_REG( REG_ARG1 );
-            int mode = (int) ACCESS_REG( REG_ARG2 );
+    untrack_open_file( descriptor );
+    OpenFileEntry entry = {0};
+    entry.descriptor = descriptor;
+    entry.directory = directory;
+    entry.flags = flags;
+    entry.mode = mode;
+    strcpy( entry.path, path );
+    g_openFiles.push_back( entry );
+} //track_open_file
 
-            int original_flags = flags;
-            tracer.Trace( "  open flags %x, mode %x, file %s\n", flags, mode, pname );
-            flags = translate_open_flags( flags );
+#if defined( X64OS ) || defined( X32OS )
 
-#ifdef _WIN32
-            // bugbug: directory ignored and assumed to be local (-100)
+// checkpoints save the full emulator state so later runs can skip app startup and initialization. file layout:
+//   CheckpointHeader
+//   CheckpointCPU
+//   CheckpointSignals -- x64os only. signals_size is 0 otherwise
+//   MMapEntry * mmap_entries
+//   OpenFileEntry * open_files
+//   PerfEvent * perf_events
+//   uint64_t * page_count -- page numbers of the non-zero 4k pages in memory
+//   padding to a 4k file offset
+//   page_count * 4k of page contents
+// everything is in host byte order, so checkpoints only work with the same build of the emulator.
+
+static const char checkpointSignature[ 8 ] = { 'x', '6', '4', 'o', 's', 'c', 'k', 0 };
+static const uint32_t checkpointVersion = 2;
+static const uint64_t checkpointPageSize = 4096;
+static EMULATOR_THREAD_LOCAL char g_acCheckpointFile[ EMULATOR_MAX_PATH ] = {0}; // -c: where checkpoints are written
+
+struct CheckpointHeader
+{
+    char signature[ 8 ];
+    uint32_t version;
+    uint32_t cpu_size;                // sizeof( CheckpointCPU ) catches mismatched builds
+    uint64_t base_address;
+    uint64_t execution_address;
+    uint64_t memory_size;
+    uint64_t stack_commit;
+    uint64_t brk_commit;
+    uint64_t mmap_commit;
+    uint64_t brk_offset;
+    uint64_t mmap_offset;
+    uint64_t highwater_brk;
+    uint64_t end_of_data;
+    uint64_t bottom_of_stack;
+    uint64_t top_of_stack;
+    uint64_t mmap_peak;
+    uint64_t mmap_entries;
+    uint64_t open_files;
+    uint64_t page_count;
+    uint64_t signals_size;
+    uint64_t perf_events;
+};
 
-            strcpy( acPath, pname );
-            slash_to_backslash( acPath );
+struct CheckpointCPU
+{
+    reg8_t regs[ 16 ];
+    vec16_t xregs[ 16 ];
+    float80_t fregs[ 8 ];
+    reg8_t rip, res, rcs, rss, rds, rfs, rgs;
+    uint64_t rflags;
+    uint32_t mxcsr;
+    uint16_t x87_fpu_control_word;
+    uint16_t x87_fpu_status_word;
+    uint8_t fp_sp;
+    bool mode32;
+    struct linux_user_desc user_desc; // x32 set_thread_area state
+    uint64_t retired_instructions;    // the virtual clock and rdtsc continue from here
+    uint64_t virtual_sleep_ns;
+    uint64_t virtual_epoch_ns;
+};
 
-            bool opendir = is_o_directory_set( original_flags );
-            int descriptor;
-            tracer.Trace( "  opendir: %u\n", opendir );
-            DWORD attr = GetFileAttributesA( acPath );
-            if ( opendir && ( INVALID_FILE_ATTRIBUTES != attr ) && ( attr & FILE_ATTRIBUTE_DIRECTORY ) )
-            {
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    FindClose( g_hFindFirst );
-                    g_hFindFirst = INVALID_HANDLE_VALUE;
-                }
-                strcpy( g_acFindFirstPattern, acPath );
-                size_t len = strlen( g_acFindFirstPattern );
-                if ( '\\' != g_acFindFirstPattern[ len - 1 ] )
-                    strcat( g_acFindFirstPattern, "\\" );
-                strcat( g_acFindFirstPattern, "*.*" );
-                descriptor = findFirstDescriptor;
-            }
-            else
-            {
-#ifdef M68
-                if ( is_o_creat_set( original_flags ) )
-                    mode = _S_IREAD | _S_IWRITE; // __mc68000__ passes user-related flags that conflict with these flags
-#endif //M68
-                descriptor = _open( pname, flags, mode );
-            }
-#else // !_WIN32
+#ifdef X64OS
 
-            const char * pfilename = pname;
+// signal handlers, masks, pending signals, and timers. armed timers are saved as the ns remaining rather than their
+// deadlines, since host clocks like the process cpu time start over in the restoring process
 
-            if ( ! is_o_creat_set( original_flags ) )
-                mode = 0; // mode is only defined if O_CREAT or O_TMPFILE are specified, and O_TMPFILE isn't defined for most platforms
+struct CheckpointSignals
+{
+    linux_sigaction_x64 actions[ linuxSignals + 1 ];
+    SignalInfo info[ linuxSignals + 1 ];
+    uint64_t pending;
+    uint64_t blocked;
+    uint64_t suspend_mask;
+    bool suspended;
+    linux_stack_x64 alt_stack;
+    SignalTimer timers[ signalTimerCount ];
+};
 
-            int descriptor = open( pfilename, flags, mode );
-#endif //_WIN32
+static const uint64_t checkpointSignalsSize = sizeof( CheckpointSignals );
 
-            tracer.Trace( "  result of open: descriptor: %d, mode %#x\n", descriptor, mode );
-            update_result_errno( cpu, descriptor );
-            break;
-        }
-        case SYS_close:
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  syscall command SYS_close %d\n", descriptor );
+static void save_signal_state( CPUClass & cpu, CheckpointSignals & cs )
+{
+    memset( &cs, 0, sizeof( cs ) );
+    memcpy( cs.actions, g_sigActions, sizeof( cs.actions ) );
+    memcpy( cs.info, g_sigInfo, sizeof( cs.info ) );
+    cs.pending = g_sigPending;
+    cs.blocked = g_sigBlocked;
+    cs.suspend_mask = g_sigSuspendMask;
+    cs.suspended = g_sigSuspended;
+    cs.alt_stack = g_sigAltStack;
+    memcpy( cs.timers, g_sigTimers, sizeof( cs.timers ) );
 
-            if ( descriptor >= 0 && descriptor <= 2 )
-            {
-                // built-in handle stdin, stdout, stderr -- ignore
-                ACCESS_REG( REG_RESULT ) = 0;
-            }
-            else
-            {
-                int result = 0;
-#ifdef _WIN32
-                if ( findFirstDescriptor == descriptor )
-                {
-                    if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                    {
-                        FindClose( g_hFindFirst );
-                        g_hFindFirst = INVALID_HANDLE_VALUE;
-                        g_acFindFirstPattern[ 0 ] = 0;
-                    }
-                    update_result_errno( cpu, 0 );
-                    break;
-                }
-                else if ( timebaseFrequencyDescriptor == descriptor || osreleaseDescriptor == descriptor )
-                {
-                    update_result_errno( cpu, 0 );
-                    break;
-                }
-                else
-#else
-    #if !defined( OLDGCC )
-                if ( g_FindFirstDescriptor == descriptor )
-                {
-                    if ( 0 != g_FindFirst )
-                    {
-                        closedir( g_FindFirst );
-                        g_FindFirst = 0;
-                    }
-                    g_FindFirstDescriptor = -1;
-                    update_result_errno( cpu, 0 );
-                    break;
-                }
-    #endif
-#endif
-                result = close( descriptor );
-                update_result_errno( cpu, result );
-            }
-            break;
-        }
-        case emulator_sys_getdents:
+    for ( size_t i = 0; i < signalTimerCount; i++ )
+    {
+        SignalTimer & t = cs.timers[ i ];
+        if ( t.armed )
         {
-            int result = 0;
-            REG_TYPE descriptor = ACCESS_REG( REG_ARG0 );
-            uint8_t * pentries = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            REG_TYPE count = ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  pentries: %p, count %u\n", pentries, (uint32_t) count );
-            struct linux_dirent_syscall * pcur = (struct linux_dirent_syscall *) pentries;
-            memset( pentries, 0, count );
+            uint64_t now = signal_clock_ns( cpu, t.clock );
+            t.deadline = ( t.deadline > now ) ? t.deadline - now : 0;
+        }
+    }
+} //save_signal_state
 
-#ifdef _WIN32
-            if ( ( findFirstDescriptor != descriptor ) || ( 0 == g_acFindFirstPattern[ 0 ] ) )
-            {
-                tracer.Trace( "  getdents on unexpected descriptor or FindFirst (%p) not open\n", g_hFindFirst );
-                errno = EBADF;
-                update_result_errno( cpu, -1 );
-                break;
-            }
+static void restore_signal_state( CPUClass & cpu, const CheckpointSignals & cs )
+{
+    // call once the cpu and virtual clock are restored, since timer deadlines are rebased on the clocks' current time
 
-            WIN32_FIND_DATAA fd = {0};
+    memcpy( g_sigActions, cs.actions, sizeof( g_sigActions ) );
+    memcpy( g_sigInfo, cs.info, sizeof( g_sigInfo ) );
+    g_sigPending = cs.pending;
+    g_sigBlocked = cs.blocked;
+    g_sigSuspendMask = cs.suspend_mask;
+    g_sigSuspended = cs.suspended;
+    g_sigAltStack = cs.alt_stack;
+    cpu.set_alt_stack( g_sigAltStack.ss_sp, g_sigAltStack.ss_size );
+    memcpy( g_sigTimers, cs.timers, sizeof( g_sigTimers ) );
 
-            if ( INVALID_HANDLE_VALUE == g_hFindFirst )
-            {
-                tracer.Trace( "findfirstfilea call, pattern '%s'\n", g_acFindFirstPattern );
-                g_hFindFirst = FindFirstFileA( g_acFindFirstPattern, &fd );
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    tracer.Trace( "  successfully opened FindFirst for pattern '%s'\n", g_acFindFirstPattern );
+    for ( size_t i = 0; i < signalTimerCount; i++ )
+    {
+        SignalTimer & t = g_sigTimers[ i ];
+        if ( t.armed )
+            t.deadline += signal_clock_ns( cpu, t.clock );
+    }
 
-                    size_t len = strlen( fd.cFileName );
-                    if ( ( count < sizeof( struct linux_dirent_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent_syscall ) ) ) )
-                    {
-                        errno = EINVAL;
-                        result = -1;
-                    }
-                    else
-                    {
-                        pcur->d_ino = 100; // fake
-                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent_syscall ) );
-                        size_t dname_off = offsetof( struct linux_dirent_syscall, d_name );
-                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 + 1 ); // null termination on the string + file type
-                        pcur->d_off = pcur->d_reclen;
-                        strcpy( pcur->d_name, fd.cFileName );
+    update_host_signal( 2 );
+    update_host_signal( 15 );
+    update_signal_checks( cpu );
+} //restore_signal_state
 
-                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
-                            pcur->settype( 10 ); // DT_LNK
-                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
-                            pcur->settype( 4 ); // DT_DIR
-                        else
-                            pcur->settype( 8 ); // DT_REG
+#else
+static const uint64_t checkpointSignalsSize = 0;
+#endif //X64OS
 
-                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->gettype() );
-                        result = pcur->d_reclen;
-                        pcur->swap_endianness();
-                    }
-                }
-                else
-                {
-                    tracer.Trace( "find first failed error %d\n", GetLastError() );
-                    errno = EINVAL;
-                    result = -1;
-                }
-            }
-            else
-            {
-                // find next here
+static bool is_page_zero( const uint8_t * p, size_t len )
+{
+    const uint64_t * p64 = (const uint64_t *) p;
+    for ( size_t i = 0; i < len / sizeof( uint64_t ); i++ )
+        if ( 0 != p64[ i ] )
+            return false;
 
-                BOOL found = FindNextFileA( g_hFindFirst, &fd );
-                if ( found )
-                {
-                    size_t len = strlen( fd.cFileName );
-                    if ( ( count < sizeof( struct linux_dirent_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent_syscall ) ) ) )
-                    {
-                        errno = ENOENT;
-                        result = -1;
-                    }
-                    else
-                    {
-                        pcur->d_ino = 100; // fake
-                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent_syscall ) );
-                        size_t dname_off = offsetof( struct linux_dirent_syscall, d_name );
-                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 + 1 );
-                        pcur->d_off = pcur->d_reclen;
-                        strcpy( pcur->d_name, fd.cFileName );
+    for ( size_t i = len & ~( sizeof( uint64_t ) - 1 ); i < len; i++ )
+        if ( 0 != p[ i ] )
+            return false;
 
-                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
-                            pcur->settype( 10 ); // DT_LNK
-                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
-                            pcur->settype( 4 ); // DT_DIR
-                        else
-                            pcur->settype( 8 ); // DT_REG
+    return true;
+} //is_page_zero
 
-                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->gettype() );
-                        tracer.TraceBinaryData( (uint8_t *) pcur, pcur->d_reclen, 4 );
-                        result = pcur->d_reclen;
-                        pcur->swap_endianness();
-                    }
-                }
-                else
-                {
-                    tracer.Trace( "  out of next files\n" );
-                    FindClose( g_hFindFirst );
-                    g_hFindFirst = INVALID_HANDLE_VALUE;
-                    g_acFindFirstPattern[ 0 ] = 0;
-                    result = 0; // nothing left
-                }
-            }
-#else
-        #if !defined( OLDGCC )
-            tracer.Trace( "  g_FindFirstDescriptor: %d, g_FindFirst: %p\n", g_FindFirstDescriptor, g_FindFirst );
+static bool save_checkpoint( CPUClass & cpu, const char * pfile )
+{
+    tracer.Trace( "saving checkpoint to %s\n", pfile );
+    FILE * fp = fopen( pfile, "wb" );
+    if ( !fp )
+    {
+        tracer.Trace( "  can't create checkpoint file %s, errno %d\n", pfile, errno );
+        return false;
+    }
 
-            if ( -1 == g_FindFirstDescriptor )
-            {
-                g_FindFirstDescriptor = descriptor;
-                g_FindFirst = fdopendir( descriptor );
-            }
+    CFile file( fp );
+    size_t mem_size = memory.size();
+    vector<uint64_t> pages;
+
+    for ( uint64_t o = 0; o < mem_size; o += checkpointPageSize )
+        if ( !is_page_zero( memory.data() + o, (size_t) get_min( checkpointPageSize, (uint64_t) ( mem_size - o ) ) ) )
+            pages.push_back( o / checkpointPageSize );
+
+    vector<OpenFileEntry> files( g_openFiles );
+    for ( size_t i = 0; i < files.size(); i++ )
+        files[ i ].offset = lseek( files[ i ].descriptor, 0, SEEK_CUR );
+
+    vector<MMapEntry> & mmap_entries = g_mmap.get_entries();
+
+    // perf event counts and times are saved as totals, since the cpu's event counts and host clocks start over on restore
+
+    vector<PerfEvent> perf_events( g_perfEvents );
+    for ( size_t i = 0; i < perf_events.size(); i++ )
+    {
+        perf_events[ i ].count = perf_event_value( cpu, g_perfEvents[ i ] );
+        perf_events[ i ].time = perf_event_time( cpu, g_perfEvents[ i ] );
+        perf_events[ i ].start = 0;
+        perf_events[ i ].time_start = 0;
+    }
+
+    CheckpointHeader h = {0};
+    memcpy( h.signature, checkpointSignature, sizeof( h.signature ) );
+    h.version = checkpointVersion;
+    h.cpu_size = sizeof( CheckpointCPU );
+    h.base_address = g_base_address;
+    h.execution_address = g_execution_address;
+    h.memory_size = mem_size;
+    h.stack_commit = g_stack_commit;
+    h.brk_commit = g_brk_commit;
+    h.mmap_commit = g_mmap_commit;
+    h.brk_offset = g_brk_offset;
+    h.mmap_offset = g_mmap_offset;
+    h.highwater_brk = g_highwater_brk;
+    h.end_of_data = g_end_of_data;
+    h.bottom_of_stack = g_bottom_of_stack;
+    h.top_of_stack = g_top_of_stack;
+    h.mmap_peak = g_mmap.peak_usage();
+    h.mmap_entries = mmap_entries.size();
+    h.open_files = files.size();
+    h.page_count = pages.size();
+    h.signals_size = checkpointSignalsSize;
+    h.perf_events = perf_events.size();
+
+    CheckpointCPU c;
+    memset( &c, 0, sizeof( c ) );
+    memcpy( c.regs, cpu.regs, sizeof( c.regs ) );
+    memcpy( c.xregs, cpu.xregs, sizeof( c.xregs ) );
+    memcpy( c.fregs, cpu.fregs, sizeof( c.fregs ) );
+    c.rip = cpu.rip;
+    c.res = cpu.res;
+    c.rcs = cpu.rcs;
+    c.rss = cpu.rss;
+    c.rds = cpu.rds;
+    c.rfs = cpu.rfs;
+    c.rgs = cpu.rgs;
+    c.rflags = cpu.reg_rflags();
+    c.mxcsr = cpu.mxcsr;
+    c.x87_fpu_control_word = cpu.x87_fpu_control_word;
+    c.x87_fpu_status_word = cpu.x87_fpu_status_word;
+    c.fp_sp = cpu.fp_sp;
+    c.mode32 = cpu.mode32;
+    c.user_desc = g_user_desc;
+    c.retired_instructions = cpu.retired_instructions();
+    c.virtual_sleep_ns = g_virtualSleepNs;
+    c.virtual_epoch_ns = g_virtualEpochNs;
+
+    bool ok = ( 1 == fwrite( &h, sizeof( h ), 1, fp ) ) && ( 1 == fwrite( &c, sizeof( c ), 1, fp ) );
+#ifdef X64OS
+    CheckpointSignals cs;
+    save_signal_state( cpu, cs );
+    if ( ok )
+        ok = ( 1 == fwrite( &cs, sizeof( cs ), 1, fp ) );
+#endif
+    if ( ok && mmap_entries.size() )
+        ok = ( mmap_entries.size() == fwrite( mmap_entries.data(), sizeof( MMapEntry ), mmap_entries.size(), fp ) );
+    if ( ok && files.size() )
+        ok = ( files.size() == fwrite( files.data(), sizeof( OpenFileEntry ), files.size(), fp ) );
+    if ( ok && perf_events.size() )
+        ok = ( perf_events.size() == fwrite( perf_events.data(), sizeof( PerfEvent ), perf_events.size(), fp ) );
+    if ( ok && pages.size() )
+        ok = ( pages.size() == fwrite( pages.data(), sizeof( uint64_t ), pages.size(), fp ) );
 
-            if ( 0 == g_FindFirst )
-            {
-                errno = EBADF;
-                g_FindFirstDescriptor = -1;
-                update_result_errno( cpu, -1 );
-                break;
-            }
+    // page data starts 4k-aligned so restore can map the file and copy whole pages
 
-            struct dirent * pent = readdir( g_FindFirst );
-            if ( 0 != pent )
-            {
-                tracer.Trace( "  readdir returned '%s'\n", pent->d_name );
-                size_t len = strlen( pent->d_name );
-                if ( ( count < sizeof( struct linux_dirent_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent_syscall ) ) ) )
-                {
-                    errno = EINVAL;
-                    result = -1;
-                }
-                else
-                {
-                    pcur->d_ino = 100; // fake
-                    tracer.Trace( "  len: %d, sizeof struct %d\n", (int) len, (int) sizeof( struct linux_dirent_syscall ) );
-                    size_t dname_off = offsetof( struct linux_dirent_syscall, d_name );
-                    tracer.Trace( "  d_name offset in the struct: %d\n", (int) dname_off );
-                    pcur->d_reclen = dname_off + len + 1 + 1;
-                    tracer.Trace( "  reclen in the struct: %d\n", (int) pcur->d_reclen );
-                    pcur->d_off = pcur->d_reclen;
-                    strcpy( pcur->d_name, pent->d_name );
-                    pcur->settype( pent->d_type );
-
-                    tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %#x\n", pcur->d_name, (int) pcur->d_reclen, (int) pcur->d_off, pcur->gettype() );
-                    tracer.TraceBinaryData( (uint8_t *) pcur, pcur->d_reclen, 4 );
-                    result = pcur->d_reclen;
-                    pcur->swap_endianness();
-                }
-            }
-            else
-            {
-                tracer.Trace( "  readdir returned 0, so there are no more files in the enumeration\n" );
-                result = 0;
-            }
-    #endif
-#endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_getdents64:
-        {
-            int result = 0;
-            REG_TYPE descriptor = ACCESS_REG( REG_ARG0 );
-            uint8_t * pentries = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            REG_TYPE count = ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  pentries: %p, count %u, descriptor %p\n", pentries, (uint32_t) count, descriptor );
-            struct linux_dirent64_syscall * pcur = (struct linux_dirent64_syscall *) pentries;
-            memset( pentries, 0, count );
+    static uint8_t page_buffer[ checkpointPageSize ];
+    long position = ftell( fp );
+    long padding = (long) ( round_up( (uint64_t) position, checkpointPageSize ) - position );
+    if ( ok && padding )
+    {
+        memset( page_buffer, 0, sizeof( page_buffer ) );
+        ok = ( 1 == fwrite( page_buffer, padding, 1, fp ) );
+    }
 
-            if ( 0 == count ) // glibc does this on amd64. it's a success case
-            {
-                update_result_errno( cpu, 0 );
-                break;
-            }
+    for ( size_t i = 0; ok && i < pages.size(); i++ )
+    {
+        uint64_t o = pages[ i ] * checkpointPageSize;
+        uint64_t len = get_min( checkpointPageSize, (uint64_t) ( mem_size - o ) );
+        memset( page_buffer, 0, sizeof( page_buffer ) );
+        memcpy( page_buffer, memory.data() + o, (size_t) len );
+        ok = ( 1 == fwrite( page_buffer, sizeof( page_buffer ), 1, fp ) );
+    }
 
-#ifdef _WIN32
-            if ( ( findFirstDescriptor != descriptor ) || ( 0 == g_acFindFirstPattern[ 0 ] ) )
-            {
-                tracer.Trace( "  getdents on unexpected descriptor or FindFirst (%p) not open\n", g_hFindFirst );
-                errno = EBADF;
-                update_result_errno( cpu, -1 );
-                break;
-            }
+    char ac[ 100 ];
+    tracer.Trace( "  checkpoint %s: %s non-zero pages of %s, %zu mmap entries, %zu open files, %zu perf events\n", ok ? "saved" : "failed",
+                  CDJLTrace::RenderNumberWithCommas( pages.size(), ac ), CDJLTrace::RenderNumberWithCommas( mem_size / checkpointPageSize, ac + 50 ),
+                  mmap_entries.size(), files.size(), perf_events.size() );
+    return ok;
+} //save_checkpoint
 
-            WIN32_FIND_DATAA fd = {0};
+static bool read_checkpoint_header( const char * pfile, CheckpointHeader & h )
+{
+    FILE * fp = fopen( pfile, "rb" );
+    if ( !fp )
+        return false;
 
-            if ( INVALID_HANDLE_VALUE == g_hFindFirst )
-            {
-                tracer.Trace( "findfirstfilea call, pattern '%s'\n", g_acFindFirstPattern );
-                g_hFindFirst = FindFirstFileA( g_acFindFirstPattern, &fd );
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    tracer.Trace( "  successfully opened FindFirst for pattern '%s'\n", g_acFindFirstPattern );
+    CFile file( fp );
+    if ( 1 != fread( &h, sizeof( h ), 1, fp ) )
+        return false;
 
-                    size_t len = strlen( fd.cFileName );
-                    if ( ( count < sizeof( struct linux_dirent64_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent64_syscall ) ) ) )
-                    {
-                        errno = EINVAL;
-                        result = -1;
-                    }
-                    else
-                    {
-                        pcur->d_ino = 100; // fake
-                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent64_syscall ) );
-                        size_t dname_off = offsetof( struct linux_dirent64_syscall, d_name );
-                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 );
-                        pcur->d_off = pcur->d_reclen;
-                        strcpy( pcur->d_name, fd.cFileName );
+    return ( !memcmp( h.signature, checkpointSignature, sizeof( h.signature ) ) && ( checkpointVersion == h.version ) &&
+             ( sizeof( CheckpointCPU ) == h.cpu_size ) && ( checkpointSignalsSize == h.signals_size ) );
+} //read_checkpoint_header
 
-                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
-                            pcur->d_type = 10; // DT_LNK
-                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
-                            pcur->d_type = 4; // DT_DIR
-                        else
-                            pcur->d_type = 8; // DT_REG
+static bool restore_checkpoint( CPUClass & cpu, const char * pfile )
+{
+    tracer.Trace( "restoring checkpoint from %s\n", pfile );
+    CheckpointHeader h;
+    if ( !read_checkpoint_header( pfile, h ) )
+        return false;
 
-                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->d_type );
-                        result = pcur->d_reclen;
-                        pcur->swap_endianness();
-                    }
-                }
-                else
-                {
-                    tracer.Trace( "find first failed error %d\n", GetLastError() );
-                    errno = EINVAL;
-                    result = -1;
-                }
-            }
-            else
-            {
-                // find next here
+    if ( ( h.base_address != g_base_address ) || ( h.execution_address != g_execution_address ) || ( h.memory_size != memory.size() ) )
+    {
+        tracer.Trace( "  checkpoint doesn't match the loaded image\n" );
+        return false;
+    }
 
-                BOOL found = FindNextFileA( g_hFindFirst, &fd );
-                if ( found )
-                {
-                    size_t len = strlen( fd.cFileName );
-                    if ( ( count < sizeof( struct linux_dirent64_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent64_syscall ) ) ) )
-                    {
-                        errno = ENOENT;
-                        result = -1;
-                    }
-                    else
-                    {
-                        pcur->d_ino = 100; // fake
-                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent64_syscall ) );
-                        size_t dname_off = offsetof( struct linux_dirent64_syscall, d_name );
-                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 );
-                        pcur->d_off = pcur->d_reclen;
-                        strcpy( pcur->d_name, fd.cFileName );
+    // the counts come from the file, so check them against its length and the app's memory before they size anything
 
-                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
-                            pcur->d_type = 10; // DT_LNK
-                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
-                            pcur->d_type = 4; // DT_DIR
-                        else
-                            pcur->d_type = 8; // DT_REG
+    long file_len = portable_filelen( pfile );
+    uint64_t memory_pages = round_up( (uint64_t) memory.size(), checkpointPageSize ) / checkpointPageSize;
+    if ( ( file_len <= 0 ) || ( h.mmap_entries > (uint64_t) file_len / sizeof( MMapEntry ) ) ||
+         ( h.open_files > (uint64_t) file_len / sizeof( OpenFileEntry ) ) || ( h.perf_events > (uint64_t) file_len / sizeof( PerfEvent ) ) ||
+         ( h.page_count > memory_pages ) )
+    {
+        tracer.Trace( "  checkpoint counts don't fit in the file or the app's memory\n" );
+        return false;
+    }
 
-                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->d_type );
-                        result = pcur->d_reclen;
-                    }
-                }
-                else
-                {
-                    tracer.Trace( "  out of next files\n" );
-                    FindClose( g_hFindFirst );
-                    g_hFindFirst = INVALID_HANDLE_VALUE;
-                    g_acFindFirstPattern[ 0 ] = 0;
-                    result = 0; // nothing left
-                }
-            }
+    uint64_t data_offset = sizeof( h ) + sizeof( CheckpointCPU ) + h.signals_size + h.mmap_entries * sizeof( MMapEntry ) +
+                           h.open_files * sizeof( OpenFileEntry ) + h.perf_events * sizeof( PerfEvent ) + h.page_count * sizeof( uint64_t );
+    data_offset = round_up( data_offset, checkpointPageSize );
+    uint64_t file_size = data_offset + h.page_count * checkpointPageSize;
+    if ( file_size > (uint64_t) file_len )
+    {
+        tracer.Trace( "  checkpoint file is truncated: it has %ld bytes of %llu\n", file_len, file_size );
+        return false;
+    }
+
+#ifdef _WIN32
+    FILE * fp = fopen( pfile, "rb" );
+    if ( !fp )
+        return false;
+
+    CFile file( fp );
+    vector<uint8_t> contents( (size_t) file_size );
+    if ( 1 != fread( contents.data(), contents.size(), 1, fp ) )
+        return false;
+
+    const uint8_t * pbase = contents.data();
 #else
-        #if !defined( OLDGCC )
-            tracer.Trace( "  g_FindFirstDescriptor: %d, g_FindFirst: %p, descriptor: %p\n", g_FindFirstDescriptor, g_FindFirst, descriptor );
+    int fd = open( pfile, O_RDONLY );
+    if ( fd < 0 )
+        return false;
 
-            if ( -1 == g_FindFirstDescriptor )
-            {
-                g_FindFirstDescriptor = descriptor;
-                g_FindFirst = fdopendir( descriptor );
-            }
+    struct stat st;
+    if ( ( 0 != fstat( fd, &st ) ) || ( (uint64_t) st.st_size < file_size ) )
+    {
+        close( fd );
+        return false;
+    }
 
-            if ( 0 == g_FindFirst )
-            {
-                tracer.Trace( "  no g_FindFirst\n" );
-                errno = EBADF;
-                g_FindFirstDescriptor = -1;
-                update_result_errno( cpu, -1 );
-                break;
-            }
+    void * pmap = mmap( 0, (size_t) file_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( MAP_FAILED == pmap )
+        return false;
 
-            struct dirent * pent = readdir( g_FindFirst );
-            if ( 0 != pent )
-            {
-                tracer.Trace( "  readdir returned '%s'\n", pent->d_name );
-                size_t len = strlen( pent->d_name );
-                if ( ( count < sizeof( struct linux_dirent64_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent64_syscall ) ) ) )
-                {
-                    errno = EINVAL;
-                    result = -1;
-                }
-                else
-                {
-                    pcur->d_ino = 100; // fake
-                    tracer.Trace( "  len: %d, sizeof struct %d\n", (int) len, (int) sizeof( struct linux_dirent64_syscall ) );
-                    size_t dname_off = offsetof( struct linux_dirent64_syscall, d_name );
-                    tracer.Trace( "  d_name offset in the struct: %d\n", (int) dname_off );
-                    pcur->d_reclen = dname_off + len + 1;
-                    tracer.Trace( "  reclen in the struct: %d\n", (int) pcur->d_reclen );
-                    pcur->d_off = pcur->d_reclen;
-                    strcpy( pcur->d_name, pent->d_name );
-                    pcur->d_type = pent->d_type;
-
-                    tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %#x\n", pcur->d_name, (int) pcur->d_reclen, (int) pcur->d_off, pcur->d_type );
-                    result = pcur->d_reclen;
-                    pcur->swap_endianness();
-                }
-            }
-            else
-            {
-                tracer.Trace( "  readdir returned 0, so there are no more files in the enumeration\n" );
-                result = 0;
-            }
-        #endif
+    const uint8_t * pbase = (const uint8_t *) pmap;
 #endif
-            update_result_errno( cpu, result );
-            break;
+
+    // reject pages outside the app's memory before any state changes, so a bad file leaves the loaded app as it was
+
+    const CheckpointCPU * pc = (const CheckpointCPU *) ( pbase + sizeof( h ) );
+    const uint8_t * psignals = (const uint8_t *) ( pc + 1 );
+    const MMapEntry * pentries = (const MMapEntry *) ( psignals + h.signals_size );
+    const OpenFileEntry * pfiles = (const OpenFileEntry *) ( pentries + h.mmap_entries );
+    const PerfEvent * pperf = (const PerfEvent *) ( pfiles + h.open_files );
+    const uint64_t * ppages = (const uint64_t *) ( pperf + h.perf_events );
+    for ( uint64_t i = 0; i < h.page_count; i++ )
+    {
+        if ( ppages[ i ] >= memory_pages )
+        {
+            tracer.Trace( "  checkpoint page %llu is outside the app's %llu pages of memory\n", ppages[ i ], memory_pages );
+#ifndef _WIN32
+            munmap( pmap, (size_t) file_size );
+#endif
+            return false;
         }
-        case SYS_brk:
+    }
+
+    memcpy( cpu.regs, pc->regs, sizeof( cpu.regs ) );
+    memcpy( cpu.xregs, pc->xregs, sizeof( cpu.xregs ) );
+    memcpy( cpu.fregs, pc->fregs, sizeof( cpu.fregs ) );
+    cpu.rip = pc->rip;
+    cpu.res = pc->res;
+    cpu.rcs = pc->rcs;
+    cpu.rss = pc->rss;
+    cpu.rds = pc->rds;
+    cpu.rfs = pc->rfs;
+    cpu.rgs = pc->rgs;
+    cpu.reg_rflags() = pc->rflags;
+    cpu.mxcsr = pc->mxcsr;
+    cpu.x87_fpu_control_word = pc->x87_fpu_control_word;
+    cpu.x87_fpu_status_word = pc->x87_fpu_status_word;
+    cpu.fp_sp = pc->fp_sp;
+    cpu.mode32 = pc->mode32;
+    g_user_desc = pc->user_desc;
+    cpu.retired_instructions() = pc->retired_instructions;
+    g_virtualSleepNs = pc->virtual_sleep_ns;
+    g_virtualEpochNs = pc->virtual_epoch_ns;
+
+    g_brk_offset = h.brk_offset;
+    g_mmap_offset = h.mmap_offset;
+    g_highwater_brk = h.highwater_brk;
+    g_end_of_data = h.end_of_data;
+    g_bottom_of_stack = h.bottom_of_stack;
+
+    vector<MMapEntry> & mmap_entries = g_mmap.get_entries();
+    mmap_entries.assign( pentries, pentries + h.mmap_entries );
+    g_mmap.set_peak_usage( h.mmap_peak );
+
+    // memory is all zeroes after load_image() except for the loaded image, args, and aux data which are all overwritten here
+
+    memset( memory.data(), 0, memory.size() );
+    for ( uint64_t i = 0; i < h.page_count; i++ )
+    {
+        uint64_t o = ppages[ i ] * checkpointPageSize;
+        memcpy( memory.data() + o, pbase + data_offset + i * checkpointPageSize, (size_t) get_min( checkpointPageSize, memory.size() - o ) );
+    }
+
+    g_openFiles.clear();
+    for ( uint64_t i = 0; i < h.open_files; i++ )
+    {
+        const OpenFileEntry & entry = pfiles[ i ];
+        if ( !memchr( entry.path, 0, sizeof( entry.path ) ) )
         {
-            REG_TYPE original = g_brk_offset;
-            REG_TYPE ask = ACCESS_REG( REG_ARG0 );
-            if ( 0 == ask )
-                ACCESS_REG( REG_RESULT ) = cpu.get_vm_address( g_brk_offset );
-            else
-            {
-                REG_TYPE ask_offset = ask - g_base_address;
-                tracer.Trace( "  ask_offset %llx, g_end_of_data %llx, bottom_of_stack %llx\n", (uint64_t) ask_offset, (uint64_t) g_end_of_data, (uint64_t) g_bottom_of_stack );
+            tracer.Trace( "  skipping open file entry %llu; its path isn't terminated\n", i );
+            continue;
+        }
 
-                if ( ask_offset >= g_end_of_data && ask_offset < g_bottom_of_stack )
-                {
-                    g_brk_offset = cpu.getoffset( ask );
-                    if ( g_brk_offset > g_highwater_brk )
-                        g_highwater_brk = g_brk_offset;
-#if defined( X64OS ) || defined( X32OS ) // as far as I can tell x32 and x64 are the only platforms that requires the ask to be in the result on return
-                    ACCESS_REG( REG_RESULT ) = ask;
-#endif
-                }
-                else
-                {
-                    tracer.Trace( "  allocation request was too large, failing it by returning current brk\n" );
-                    ACCESS_REG( REG_RESULT ) = cpu.get_vm_address( g_brk_offset );
-                }
-            }
+        if ( ( -100 != entry.directory ) && ( '/' != entry.path[ 0 ] ) )
+        {
+            tracer.Trace( "  can't reopen descriptor %d for %s; it's relative to directory descriptor %d\n", entry.descriptor, entry.path, entry.directory );
+            continue;
+        }
 
-            tracer.Trace( "  SYS_brk. ask %llx, current brk %llx, new brk %llx, result in return register %llx\n",
-                          (uint64_t) ask, (uint64_t) original, (uint64_t) g_brk_offset, (uint64_t) ACCESS_REG( REG_RESULT ) );
-            break;
+        int fd = open( entry.path, entry.flags & ~( O_TRUNC | O_EXCL ), entry.mode );
+        if ( fd >= 0 && fd != entry.descriptor )
+        {
+            dup2( fd, entry.descriptor );
+            close( fd );
         }
-        case SYS_munmap:
+
+        if ( fd < 0 || entry.offset != lseek( entry.descriptor, (long) entry.offset, SEEK_SET ) )
         {
-            REG_TYPE address = ACCESS_REG( REG_ARG0 );
-            REG_TYPE length = ACCESS_REG( REG_ARG1 );
-            length = round_up( length, (REG_TYPE) 4096 );
+            tracer.Trace( "  unable to reopen descriptor %d for %s, errno %d\n", entry.descriptor, entry.path, errno );
+            continue;
+        }
 
-            bool ok = g_mmap.free( address, length );
-            if ( ok )
-                update_result_errno( cpu, 0 );
-            else
-            {
-                errno = EINVAL;
-                update_result_errno( cpu, -1 );
-            }
+        g_openFiles.push_back( entry );
+    }
 
-            break;
+    // perf events are /dev/null descriptors in the host. their counts continue from the saved totals
+
+    g_perfEvents.clear();
+    for ( uint64_t i = 0; i < h.perf_events; i++ )
+    {
+        PerfEvent e = pperf[ i ];
+        if ( e.descriptor < 0 || e.counter < perfInstructions || e.counter >= perfCounterMax )
+            continue;
+
+#ifdef _WIN32
+        int fd = _open( "NUL", _O_RDONLY );
+#else
+        int fd = open( "/dev/null", O_RDONLY );
+#endif
+        if ( fd >= 0 && fd != e.descriptor )
+        {
+            dup2( fd, e.descriptor );
+            close( fd );
         }
-        case SYS_mremap:
+
+        if ( fd < 0 )
         {
-            REG_TYPE address = ACCESS_REG( REG_ARG0 );
-            REG_TYPE old_length = ACCESS_REG( REG_ARG1 );
-            REG_TYPE new_length = ACCESS_REG( REG_ARG2 );
-            int flags = (int) ACCESS_REG( REG_ARG3 );
+            tracer.Trace( "  unable to reopen perf event descriptor %d, errno %d\n", e.descriptor, errno );
+            continue;
+        }
 
-            if ( 0 != ( new_length & 0xfff ) )
-            {
-                tracer.Trace( "  warning: mremap allocation new length isn't 4k-page aligned\n" );
-                new_length = round_up( new_length, (REG_TYPE) 4096 );
-            }
+        e.start = perf_counter_value( cpu, e.counter );
+        e.time_start = perf_time_ns( cpu );
+        g_perfEvents.push_back( e );
+        g_perfNextId = get_max( g_perfNextId, e.id + 1 );
+    }
+    update_perf_event_counting( cpu );
 
-            old_length = round_up( old_length, (REG_TYPE) 4096 );
+#ifdef X64OS
+    restore_signal_state( cpu, * (const CheckpointSignals *) psignals );
+#endif
 
-            // flags: MREMAP_MAYMOVE = 1, MREMAP_FIXED = 2, MREMAP_DONTUNMAP = 3. Ignore them all
+#ifndef _WIN32
+    munmap( pmap, (size_t) file_size );
+#endif
 
-            SIGNED_REG_TYPE result = (SIGNED_REG_TYPE) g_mmap.resize( address, old_length, new_length, ( 1 == flags ) );
-            if ( 0 != result )
-                update_result_errno( cpu, result );
-            else
-            {
-                errno = ENOMEM;
-                update_result_errno( cpu, -1 );
-            }
+    tracer.Trace( "  checkpoint restored: %llu pages, %llu mmap entries, %zu open files, %zu perf events\n", h.page_count, h.mmap_entries,
+                  g_openFiles.size(), g_perfEvents.size() );
+    return true;
+} //restore_checkpoint
 
-            break;
-        }
-        case SYS_clone:
+#endif //X64OS || X32OS
+
+#if ( defined( X64OS ) || defined( X32OS ) ) && !defined( _WIN32 ) && !defined( X64OS_LIBRARY )
+
+// the fork server loads and initializes the app once, then forks a child process per input.
+// children get copy-on-write copies of guest memory, so each run skips process start, load_image(), and runtime init.
+// -f:afl speaks AFL's fork server protocol on descriptors 198 and 199 and updates the AFL shared-memory coverage map.
+// -f:F reads input filenames from F, one per line, and runs a child with stdin redirected from each one.
+
+static char g_acForkServerInputs[ EMULATOR_MAX_PATH ] = {0};  // -f: "afl" or a file listing inputs
+static bool g_forkServerStarted = false;
+static const int aflControlDescriptor = 198;                    // AFL's FORKSRV_FD
+static const int aflStatusDescriptor = 199;                     // AFL's FORKSRV_FD + 1
+
+static void fork_server_afl( CPUClass & cpu )
+{
+    uint8_t * pmap = 0;
+    const char * pshm = getenv( "__AFL_SHM_ID" );
+    if ( pshm )
+    {
+        pmap = (uint8_t *) shmat( atoi( pshm ), 0, 0 );
+        if ( (uint8_t *) -1 == pmap )
         {
-            // can't create a new process or thread with this emulator
+            tracer.Trace( "  can't attach to AFL shared memory %s, errno %d\n", pshm, errno );
+            pmap = 0;
+        }
+        cpu.set_edge_coverage( pmap );
+    }
 
-            errno = EACCES;
-            update_result_errno( cpu, -1 );
+    uint32_t message = 0;
+    if ( 4 != write( aflStatusDescriptor, &message, 4 ) )
+    {
+        tracer.Trace( "  not running under AFL; running the app once\n" );
+        return;
+    }
+
+    for ( ;; )
+    {
+        if ( 4 != read( aflControlDescriptor, &message, 4 ) )
             break;
-        }
-        case emulator_sys_rand: // rand64. returns an unsigned random number in a0
-        {
-            tracer.Trace( "  syscall command generate random number\n" );
-            ACCESS_REG( REG_RESULT ) = (REG_TYPE) rand64();
+
+        pid_t pid = fork();
+        if ( pid < 0 )
             break;
-        }
-        case emulator_sys_print_double: // print_double in a0
+
+        if ( 0 == pid )
         {
-            tracer.Trace( "  syscall command print double in a0\n" );
-            double d;
-            memcpy( &d, &ACCESS_REG( REG_ARG0 ), sizeof d );
-            printf( "%lf", d );
-            fflush( stdout );
-            update_result_errno( cpu, 0 );
-            break;
+            close( aflControlDescriptor );
+            close( aflStatusDescriptor );
+            cpu.set_edge_coverage( pmap ); // reset the prior location for this run
+            return;
         }
-        case emulator_sys_trace_instructions:
-        {
-            tracer.Trace( "  syscall command trace_instructions %d\n", ACCESS_REG( REG_ARG0 ) );
-#if !defined( _WIN32 ) && !defined( __APPLE__ ) // only on Linux can there be a parent emulator
-            uint64_t v = ACCESS_REG( REG_ARG0 );
-            syscall( 0x2002, 0 != v );
-#endif
-            ACCESS_REG( REG_RESULT ) = cpu.trace_instructions( 0 != ACCESS_REG( REG_ARG0 ) );
+
+        int status = 0;
+        if ( ( 4 != write( aflStatusDescriptor, &pid, 4 ) ) || ( pid != waitpid( pid, &status, 0 ) ) ||
+             ( 4 != write( aflStatusDescriptor, &status, 4 ) ) )
             break;
-        }
-        case SYS_mmap:
-        {
-            // The gnu c runtime is ok with this failing -- it just allocates memory instead probably assuming it's an embedded system.
-            // Same for the gnu runtime with Rust.
-            // But golang actually needs this to succeed and return the requested address and this code doesn't support that.
+    }
 
-            REG_TYPE addr = ACCESS_REG( REG_ARG0 );
-            size_t length = ACCESS_REG( REG_ARG1 );
-            int prot = (int) ACCESS_REG( REG_ARG2 );
-            int flags = (int) ACCESS_REG( REG_ARG3 );
-            int fd = (int) ACCESS_REG( REG_ARG4 );
-            size_t offset = (size_t) ACCESS_REG( REG_ARG5 );
-            tracer.Trace( "  SYS_mmap. addr %llx, length %zd, protection %#x, flags %#x, fd %d, offset %zd\n", addr, length, prot, flags, fd, offset );
-
-            if ( 0 != ( length & 0xfff ) )
-            {
-                // golang does this. golang runtime is kinda funny.
-                tracer.Trace( "  warning: mmap allocation length isn't 4k-page aligned\n" );
-                length = round_up( length, (size_t) 4096 );
-            }
-
-            if ( 0 == addr )
-            {
-                if ( 0 == ( length & 0xfff ) )
-                {
-                    // 2 == MAP_PRIVATE, 0x20 == MAP_ANONYMOUS, 0x100 = MAP_FIXED
-
-                    if ( ( 0 == ( 0x100 & flags ) ) && ( 0x22 == ( 0x22 & flags ) ) )
-                    {
-                        SIGNED_REG_TYPE result = (SIGNED_REG_TYPE) g_mmap.allocate( length );
-                        if ( 0 != result )
-                        {
-                            update_result_errno( cpu, result );
-                            break;
-                        }
-                    }
-                    else
-                        tracer.Trace( "  error: mmap flags %#x aren't supported\n", flags );
-                }
-                else
-                    tracer.Trace( "  error mmap length isn't 4k-page-aligned\n" );
-            }
-            else
-                tracer.Trace( "  mmap allocation at specific address isn't supported\n" );
+    g_consoleConfig.RestoreConsole( false );
+    tracer.Shutdown();
+    exit( 0 );
+} //fork_server_afl
 
-            tracer.Trace( "  mmap failed\n" );
-            errno = ENOMEM;
-            update_result_errno( cpu, -1 );
-            break;
-        }
-#if !defined(OLDGCC) // the syscalls below aren't invoked from the old g++ compiler and runtime
-        case SYS_openat:
-        {
-            tracer.Trace( "  syscall command SYS_openat\n" );
+static void fork_server_list( CPUClass & cpu )
+{
+    FILE * fp = fopen( g_acForkServerInputs, "r" );
+    if ( !fp )
+    {
+        printf( "can't open fork server input list %s\n", g_acForkServerInputs );
+        g_consoleConfig.RestoreConsole( false );
+        exit( 1 );
+    }
 
-            // a0: directory. a1: asciiz string of file to open. a2: flags. a3: mode
-            int directory = (int) ACCESS_REG( REG_ARG0 );
+    CFile file( fp );
 
-#ifdef __APPLE__
-            if ( -100 == directory )
-                directory = -2; // Linux vs. MacOS
-#endif //__APPLE__
-            const char * pname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            int flags = (int) ACCESS_REG( REG_ARG2 );
-            int mode = (int) ACCESS_REG( REG_ARG3 );
-            int64_t descriptor = 0;
-            tracer.Trace( "  open dir %d, flags %x, mode %x, file '%s'\n", directory, flags, mode, pname );
-            int original_flags = flags;
-            flags = translate_open_flags( flags );
+    // coverage from all children accumulates in a shared anonymous map so the parent can report it
 
-            if ( !strcmp( pname, "/proc/device-tree/cpus/timebase-frequency" ) )
-            {
-                descriptor = timebaseFrequencyDescriptor;
-                update_result_errno( cpu, (int) descriptor );
-                break;
-            }
+    uint8_t * pmap = (uint8_t *) mmap( 0, CPUClass::edge_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0 );
+    if ( MAP_FAILED == pmap )
+        pmap = 0;
+    cpu.set_edge_coverage( pmap );
 
-            if ( !strcmp( pname, "/proc/sys/kernel/osrelease" ) )
-            {
-                descriptor = osreleaseDescriptor;
-                update_result_errno( cpu, (int) descriptor );
-                break;
-            }
+    uint64_t execs = 0;
+    uint64_t failures = 0;
+    char acInput[ EMULATOR_MAX_PATH ];
+    high_resolution_clock::time_point tStart = high_resolution_clock::now();
 
-#ifdef _WIN32
-            bool opendir = is_o_directory_set( original_flags );
-            tracer.Trace( "  opendir: %u\n", opendir );
+    while ( fgets( acInput, sizeof( acInput ), fp ) )
+    {
+        size_t len = strlen( acInput );
+        while ( len && ( '\n' == acInput[ len - 1 ] || '\r' == acInput[ len - 1 ] ) )
+            acInput[ --len ] = 0;
 
-            // bugbug: directory ignored and assumed to be local (-100)
+        if ( 0 == len )
+            continue;
 
-            strcpy( acPath, pname );
-            slash_to_backslash( acPath );
+        fflush( stdout );
+        pid_t pid = fork();
+        if ( pid < 0 )
+        {
+            printf( "fork failed, errno %d\n", errno );
+            break;
+        }
 
-            DWORD attr = GetFileAttributesA( acPath );
-            if ( opendir && ( INVALID_FILE_ATTRIBUTES != attr ) && ( attr & FILE_ATTRIBUTE_DIRECTORY ) )
-            {
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    FindClose( g_hFindFirst );
-                    g_hFindFirst = INVALID_HANDLE_VALUE;
-                }
-                strcpy( g_acFindFirstPattern, acPath );
-                size_t len = strlen( g_acFindFirstPattern );
-                if ( '\\' != g_acFindFirstPattern[ len - 1 ] )
-                    strcat( g_acFindFirstPattern, "\\" );
-                strcat( g_acFindFirstPattern, "*.*" );
-                descriptor = findFirstDescriptor;
-            }
-            else
+        if ( 0 == pid )
+        {
+            file.close();
+            int fd = open( acInput, O_RDONLY );
+            if ( fd < 0 )
             {
-#ifdef M68
-                if ( is_o_creat_set( original_flags ) )
-                    mode = _S_IREAD | _S_IWRITE; // __mc68000__ passes user-related flags that conflict with these flags
-#endif //M68
-                tracer.Trace( "  final name %s, flags %#x, mode %#x\n", pname, flags, mode );
-                descriptor = _open( pname, flags, mode );
+                printf( "can't open fork server input %s\n", acInput );
+                exit( 1 );
             }
-#else // _WIN32
 
-            tracer.Trace( "  final directory %d, flags %#x, mode %#x passed to openat\n", directory, flags, mode );
-            descriptor = openat( directory, pname, flags, mode );
-#endif // _WIN32
-            update_result_errno( cpu, (int) descriptor );
-            break;
+            dup2( fd, 0 );
+            close( fd );
+            cpu.set_edge_coverage( pmap ); // reset the prior location for this run
+            return;
         }
-        case SYS_sysinfo:
+
+        int status = 0;
+        waitpid( pid, &status, 0 );
+        execs++;
+        if ( !WIFEXITED( status ) || ( 0 != WEXITSTATUS( status ) ) )
         {
-#if defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
-            errno = EACCES;
-            update_result_errno( cpu, -1 );
-#else
-            int result = sysinfo( (struct sysinfo *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
-            update_result_errno( cpu, result );
-#endif // defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
-            break;
+            failures++;
+            tracer.Trace( "  input %s ended with status %#x\n", acInput, status );
         }
-        case SYS_newfstatat:
-        {
-#if 0
-            tracer.Trace( "  offsetof st_dev: %d\n", (int) offsetof( struct stat_linux_syscall, st_dev ) );
-            tracer.Trace( "  offsetof st_ino: %d\n", (int) offsetof( struct stat_linux_syscall, st_ino ) );
-            tracer.Trace( "  offsetof st_nlink: %d\n", (int) offsetof( struct stat_linux_syscall, st_nlink ) );
-            tracer.Trace( "  offsetof st_mode: %d\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
-            tracer.Trace( "  offsetof st_uid: %d\n", (int) offsetof( struct stat_linux_syscall, st_uid ) );
-            tracer.Trace( "  offsetof st_gid: %d\n", (int) offsetof( struct stat_linux_syscall, st_gid ) );
-            tracer.Trace( "  offsetof st_rdev: %d\n", (int) offsetof( struct stat_linux_syscall, st_rdev ) );
-            tracer.Trace( "  offsetof st_size: %d\n", (int) offsetof( struct stat_linux_syscall, st_size ) );
-#endif
+    }
 
-            const char * path = (char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            tracer.Trace( "  syscall command SYS_newfstatat, id %lld, path '%s', flags %llx\n", (uint64_t) ACCESS_REG( REG_ARG0 ), path, (uint64_t) ACCESS_REG( REG_ARG3 ) );
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            int result = 0;
+    high_resolution_clock::time_point tDone = high_resolution_clock::now();
+    int64_t totalTime = duration_cast<std::chrono::milliseconds>( tDone - tStart ).count();
 
-#ifdef _WIN32
-            // ignore the folder argument on Windows
-            struct stat_linux_syscall local_stat = {0};
-            result = fill_pstat_windows( descriptor, & local_stat, path );
-            if ( 0 == result )
-            {
-                #ifdef X64OS
-                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-                    pout->st_dev = local_stat.st_dev;
-                    pout->st_ino = local_stat.st_ino;
-                    pout->st_mode = local_stat.st_mode;
-                    pout->st_nlink = local_stat.st_nlink;
-                    pout->st_uid = local_stat.st_uid;
-                    pout->st_gid = local_stat.st_gid;
-                    pout->st_rdev = local_stat.st_rdev;
-                    pout->st_size = local_stat.st_size;
-                    pout->st_blksize = local_stat.st_blksize;
-                    pout->st_blocks = local_stat.st_blocks;
-                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
-                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
-                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) pout->st_size, (int) offsetof( struct stat_linux_syscall_x64, st_size ) );
-                    pout->swap_endianness();
-                    tracer.Trace( "post-swap mode: %#x\n", pout->st_mode );
-                #else // X64OS
-                    size_t cbStat = sizeof( struct stat_linux_syscall );
-                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
-                    tracer.Trace( "  offsetof st_mode: %d\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
-                    tracer.Trace( "  offsetof st_blksize: %d\n", (int) offsetof( struct stat_linux_syscall, st_blksize ) );
-                    tracer.Trace( "  st_dev: %#lx\n", local_stat.st_dev );
-                    tracer.Trace( "  st_ino: %#lx\n", local_stat.st_ino );
-                    tracer.Trace( "  st_mode: %#x\n", local_stat.st_mode );
-                    tracer.Trace( "  st_nlink: %#x\n", local_stat.st_nlink );
-                    tracer.Trace( "  st_uid: %#x\n", local_stat.st_uid );
-                    tracer.Trace( "  st_gid: %#x\n", local_stat.st_gid );
-                    tracer.Trace( "  st_rdev: %#lx\n", local_stat.st_rdev );
-                    tracer.Trace( "  st_size: %#lx\n", local_stat.st_size );
-                    tracer.Trace( "  st_blksize: %#llx\n", local_stat.st_blksize );
+    char ac[ 100 ];
+    printf( "fork server execs:     %15s\n", CDJLTrace::RenderNumberWithCommas( execs, ac ) );
+    printf( "non-zero exits:        %15s\n", CDJLTrace::RenderNumberWithCommas( failures, ac ) );
+    printf( "elapsed milliseconds:  %15s\n", CDJLTrace::RenderNumberWithCommas( totalTime, ac ) );
+    if ( 0 != totalTime )
+        printf( "execs per second:      %15s\n", CDJLTrace::RenderNumberWithCommas( execs * 1000 / totalTime, ac ) );
 
-                    local_stat.swap_endianness();
-                    memcpy( cpu.getmem( ACCESS_REG( REG_ARG2 ) ), & local_stat, cbStat );
-                #endif // X64OS
-            }
-            else
-                tracer.Trace( "  fill_pstat_windows failed\n" );
-#else //_WIN32
-            tracer.Trace( "  sizeof struct stat: %zd\n", sizeof( struct stat ) );
-            struct stat local_stat = {0};
-            int flags = (int) ACCESS_REG( REG_ARG3 );
-            #ifdef __APPLE__
-                if ( -100 == descriptor ) // current directory
-                    descriptor = -2;
-                if ( EMULATOR_AT_SYMLINK_NOFOLLOW & flags )
-                    flags = AT_SYMLINK_NOFOLLOW; // 0x20 instead of 0x100 on macOS
-                else if ( EMULATOR_AT_SYMLINK_FOLLOW & flags )
-                    flags = AT_SYMLINK_FOLLOW; // 0x40 instead of 0x400 on macOS
-                else
-                    flags = 0; // no other flags are supported on macOS
-                tracer.Trace( "  translated flags for MacOS: %x\n", flags );
-                if ( 0 == path[ 0 ] )
-                    result = fstat( descriptor, & local_stat );
-                else
-                    result = fstatat( descriptor, path, & local_stat, flags );
-            #else //__APPLE__
-                result = fstatat( descriptor, path, & local_stat, flags );
-            #endif //__APPLE__
+    if ( pmap )
+    {
+        uint64_t edges = 0;
+        for ( size_t i = 0; i < CPUClass::edge_map_size; i++ )
+            edges += ( 0 != pmap[ i ] );
+        printf( "edge map entries hit:  %15s\n", CDJLTrace::RenderNumberWithCommas( edges, ac ) );
+    }
 
-            if ( 0 == result )
-            {
-                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
+    g_consoleConfig.RestoreConsole( false );
+    tracer.Shutdown();
+    exit( 0 );
+} //fork_server_list
 
-                tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
-                tracer.Trace( "  local mode: %#x\n", local_stat.st_mode );
+// returns only in forked children (or if not running under AFL), which then continue emulating the app
 
-                #ifdef X64OS
-                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-                    tracer.Trace( "  using struct stat_linux_syscall_x64\n" );
-                #else
-                    struct stat_linux_syscall * pout = (struct stat_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-                    tracer.Trace( "  using struct stat_linux_syscall\n" );
-                #endif
+static void start_fork_server( CPUClass & cpu )
+{
+    tracer.Trace( "starting fork server with %s\n", g_acForkServerInputs );
+    g_forkServerStarted = true;
+    fflush( stdout );
 
-                pout->st_dev = local_stat.st_dev;
-                pout->st_ino = local_stat.st_ino;
-                pout->st_mode = local_stat.st_mode;
-                pout->st_nlink = local_stat.st_nlink;
-                pout->st_uid = local_stat.st_uid;
-                pout->st_gid = local_stat.st_gid;
+    if ( !strcmp( g_acForkServerInputs, "afl" ) )
+        fork_server_afl( cpu );
+    else
+        fork_server_list( cpu );
+} //start_fork_server
 
-                #ifndef X64OS
-                    if ( 2 == sizeof( local_stat.st_rdev ) )
-                        pout->st_rdev = (uint16_t) local_stat.st_rdev; // on 68000 rdev is an int16_t. avoid sign extension
-                    else if ( 4 == sizeof( local_stat.st_rdev ) )
-                        pout->st_rdev = (uint32_t) local_stat.st_rdev;
-                    else
-                        pout->st_rdev = local_stat.st_rdev;
-                #endif
+#endif //( X64OS || X32OS ) && !_WIN32 && !X64OS_LIBRARY
 
-                pout->st_size = local_stat.st_size;
-                pout->st_blksize = local_stat.st_blksize;
-                pout->st_blocks = local_stat.st_blocks;
+#if defined( X64OS ) || defined( X32OS )
 
-                #if defined( __APPLE__ )
-                    pout->st_atim.tv_sec = local_stat.st_atimespec.tv_sec;
-                    pout->st_atim.tv_nsec = local_stat.st_atimespec.tv_nsec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtimespec.tv_sec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtimespec.tv_nsec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctimespec.tv_sec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctimespec.tv_nsec;
-                #elif defined( __mc68000__ )
-                    pout->st_atim.tv_sec = local_stat.st_atime;
-                    pout->st_mtim.tv_sec = local_stat.st_mtime;
-                    pout->st_ctim.tv_sec = local_stat.st_ctime;
-                #else
-                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
-                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
-                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
+// syscall record/replay. -w:F records each syscall's arguments, result, and the bytes it changed in app memory.
+// -x:F replays that log: syscalls get their results and memory changes from the log instead of the host, so a
+// run is bit-identical to the recorded one and independent of time, randomness, files, and terminal input.
+// syscalls that only change emulator state (brk, mmap, exit, etc.) and console output still execute.
+// a syscall whose number or arguments differ from the log is a divergence and ends the run. file layout:
+//   SyscallLogHeader
+//   for each syscall: SyscallLogRecord, a uint64_t per bit in changed_args, then per region a SyscallLogRegion and its bytes
+// changed bytes are found by diffing snapshots of the memory each pointer argument references, so only
+// the bytes that actually changed are written.
+
+static const char syscallLogSignature[ 8 ] = { 'x', '6', '4', 'o', 's', 'r', 'r', 0 };
+static const uint32_t syscallLogVersion = 1;
+static const uint64_t syscallLogWindow = 4096;  // bytes snapshotted at a pointer argument when the length isn't known
+
+struct SyscallLogHeader
+{
+    char signature[ 8 ];
+    uint32_t version;
+    uint32_t reg_size;                // sizeof( REG_TYPE ) so x64 and x32 logs aren't mixed up
+    uint64_t base_address;
+    uint64_t execution_address;
+    uint64_t memory_size;
+};
 
-                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
-                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
-                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
-                #endif // __APPLE__ || __mc68000__
+struct SyscallLogRecord
+{
+    uint64_t id;                      // the app's syscall number, before mapping
+    uint64_t args[ 6 ];
+    uint64_t result;
+    uint32_t regions;
+    uint32_t changed_args;            // bitmask of argument registers the syscall modified (e.g. readlink becoming readlinkat)
+};
 
-                tracer.Trace( "  sizeof output structure: %u\n", (int) sizeof( *pout ) );
-                tracer.Trace( "  file size %zd, isdir %s\n", local_stat.st_size, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
-                tracer.Trace( "  pre-swap file size %d, mode %#x, isdir %s\n", (int) local_stat.st_size, local_stat.st_mode, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
-                pout->swap_endianness();
-                tracer.Trace( "  post-swap file size %d, mode %#x\n", (int) pout->st_size, pout->st_mode );
-            }
-#endif //_WIN32
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_chdir:
-        {
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            tracer.Trace( "  syscall command SYS_chdir path %s\n", path );
-#ifdef _WIN32
-            int result = _chdir( path );
-#else
-            int result = chdir( path );
+struct SyscallLogRegion
+{
+    uint64_t offset;                  // into memory
+    uint64_t length;
+};
+
+struct SyscallLogWindow
+{
+    size_t offset;
+    size_t length;
+};
+
+static EMULATOR_THREAD_LOCAL FILE * g_syscallRecordFile = 0;                    // -w: the log being written
+static EMULATOR_THREAD_LOCAL vector<uint8_t> g_syscallReplayLog;                // -x: the log being replayed
+static EMULATOR_THREAD_LOCAL size_t g_syscallReplayOffset = 0;
+static EMULATOR_THREAD_LOCAL size_t g_syscallReplayPending = 0;                 // offset of a record executed for real and checked after
+static EMULATOR_THREAD_LOCAL uint64_t g_syscallLogCount = 0;
+static EMULATOR_THREAD_LOCAL SyscallLogRecord g_syscallRecord;                  // the syscall being recorded
+static EMULATOR_THREAD_LOCAL vector<SyscallLogWindow> g_syscallWindows;
+static EMULATOR_THREAD_LOCAL vector<uint8_t> g_syscallSnapshot;
+static EMULATOR_THREAD_LOCAL vector<uint8_t> g_syscallRecordBuffer;
+
+// syscalls that only touch emulator state run during replay too. they're deterministic, so their results are checked.
+
+static bool syscall_runs_in_replay( REG_TYPE id, REG_TYPE arg0 )
+{
+    switch ( id )
+    {
+        case emulator_sys_exit:
+        case SYS_exit:
+        case SYS_exit_group:
+        case SYS_tgkill:
+        case SYS_brk:
+        case SYS_mmap:
+        case SYS_munmap:
+        case SYS_mremap:
+        case SYS_mprotect:
+        case SYS_madvise:
+        case SYS_set_tid_address:
+        case SYS_set_robust_list:
+        case SYS_rseq:
+        case SYS_sigaction:
+        case SYS_rt_sigprocmask:
+        case SYS_signalstack:
+        case SYS_rt_sigreturn:
+        case SYS_rt_sigpending:
+        case SYS_rt_sigsuspend:
+        case SYS_kill:
+        case SYS_getitimer:
+        case SYS_setitimer:
+        case SYS_timer_create:
+        case SYS_timer_settime:
+        case SYS_timer_gettime:
+        case SYS_timer_getoverrun:
+        case SYS_timer_delete:
+        case emulator_sys_alarm:
+        case emulator_sys_pause:
+        case SYS_prctl:
+        case SYS_futex:
+        case SYS_clone:
+        case emulator_sys_x32_x64_arch_prctl:
+        case emulator_sys_print_int64:
+        case emulator_sys_print_char:
+        case emulator_sys_print_text:
+        case emulator_sys_print_double:
+        case emulator_sys_trace_instructions:
+        case emulator_sys_checkpoint:
+        case emulator_sys_fork_server:
+#if defined( X32OS )
+        case emulator_sys_set_thread_area:
+        case emulator_sys_get_thread_area:
+        case emulator_sys_ugetrlimit:
 #endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_mkdir:
+            return true;
+        case SYS_write:
+        case SYS_writev:
+            return ( 1 == arg0 || 2 == arg0 ); // console output is shown during replay. other writes come from the log
+        case SYS_clock_nanosleep:
+            return ( 0 != g_virtualClockMHz ); // sleeps advance the virtual clock, which timers depend on
+    }
+
+    return false;
+} //syscall_runs_in_replay
+
+static void add_syscall_window( CPUClass & cpu, REG_TYPE address, uint64_t length )
+{
+    if ( 0 == address || 0 == length || !cpu.is_address_valid( address ) )
+        return;
+
+    size_t offset = (size_t) ( cpu.getmem( address ) - memory.data() );
+    SyscallLogWindow w = { offset, (size_t) get_min( length, (uint64_t) ( memory.size() - offset ) ) };
+    g_syscallWindows.push_back( w );
+} //add_syscall_window
+
+static void begin_record_syscall( CPUClass & cpu, REG_TYPE syscall_id )
+{
+    SyscallLogRecord & r = g_syscallRecord;
+    r.id = (uint64_t) ACCESS_REG( REG_SYSCALL );
+    r.args[ 0 ] = (uint64_t) ACCESS_REG( REG_ARG0 );
+    r.args[ 1 ] = (uint64_t) ACCESS_REG( REG_ARG1 );
+    r.args[ 2 ] = (uint64_t) ACCESS_REG( REG_ARG2 );
+    r.args[ 3 ] = (uint64_t) ACCESS_REG( REG_ARG3 );
+    r.args[ 4 ] = (uint64_t) ACCESS_REG( REG_ARG4 );
+    r.args[ 5 ] = (uint64_t) ACCESS_REG( REG_ARG5 );
+
+    // buffers with a length argument are snapshotted in full. other pointers get a window big enough for any struct
+
+    int buffer = -1, length = -1;
+    switch ( syscall_id )
+    {
+        case SYS_read: case SYS_getdents64: case emulator_sys_getdents: case emulator_sys_readlink: buffer = 1; length = 2; break;
+        case SYS_getrandom: case SYS_getcwd: buffer = 0; length = 1; break;
+        case SYS_readlinkat: buffer = 2; length = 3; break;
+        case SYS_sched_getaffinity: buffer = 2; length = 1; break;
+    }
+
+    g_syscallWindows.clear();
+    for ( int i = 0; i < 6; i++ )
+        add_syscall_window( cpu, (REG_TYPE) r.args[ i ], ( i == buffer ) ? r.args[ length ] : syscallLogWindow );
+
+    // merge overlapping windows so each changed byte is written once
+
+    sort( g_syscallWindows.begin(), g_syscallWindows.end(), []( const SyscallLogWindow & a, const SyscallLogWindow & b ) { return a.offset < b.offset; } );
+    size_t merged = 0;
+    for ( size_t i = 0; i < g_syscallWindows.size(); i++ )
+    {
+        SyscallLogWindow & w = g_syscallWindows[ i ];
+        if ( merged && ( w.offset <= g_syscallWindows[ merged - 1 ].offset + g_syscallWindows[ merged - 1 ].length ) )
         {
-            int directory = -100;
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-#ifdef _WIN32 // on windows ignore the directory and mode arguments
-            tracer.Trace( "  syscall command SYS_mkdir path %s\n", path );
-            int result = _mkdir( path );
-#else
-#ifdef __APPLE__
-            if ( -100 == directory )
-                directory = -2;
-#endif
-            mode_t mode = (mode_t) ACCESS_REG( REG_ARG1 );
-            tracer.Trace( "  syscall command SYS_mkdir dir %d, path %s, mode %x\n", directory, path, mode );
-            int result = mkdirat( directory, path, mode );
-#endif
-            update_result_errno( cpu, result );
-            break;
+            SyscallLogWindow & prev = g_syscallWindows[ merged - 1 ];
+            prev.length = get_max( prev.offset + prev.length, w.offset + w.length ) - prev.offset;
         }
-        case SYS_mkdirat:
+        else
+            g_syscallWindows[ merged++ ] = w;
+    }
+    g_syscallWindows.resize( merged );
+
+    g_syscallSnapshot.clear();
+    for ( const SyscallLogWindow & w : g_syscallWindows )
+        g_syscallSnapshot.insert( g_syscallSnapshot.end(), memory.data() + w.offset, memory.data() + w.offset + w.length );
+} //begin_record_syscall
+
+static void end_record_syscall( CPUClass & cpu )
+{
+    SyscallLogRecord & r = g_syscallRecord;
+    r.result = (uint64_t) ACCESS_REG( REG_RESULT );
+    r.regions = 0;
+    r.changed_args = 0;
+
+    vector<uint8_t> & out = g_syscallRecordBuffer;
+    out.resize( sizeof( SyscallLogRecord ) );
+
+    uint64_t args[ 6 ] = { (uint64_t) ACCESS_REG( REG_ARG0 ), (uint64_t) ACCESS_REG( REG_ARG1 ), (uint64_t) ACCESS_REG( REG_ARG2 ),
+                           (uint64_t) ACCESS_REG( REG_ARG3 ), (uint64_t) ACCESS_REG( REG_ARG4 ), (uint64_t) ACCESS_REG( REG_ARG5 ) };
+    for ( int i = 0; i < 6; i++ )
+    {
+        if ( args[ i ] != r.args[ i ] && ( 0 != i || REG_ARG0 != REG_RESULT ) )
         {
-            int directory = (int) ACCESS_REG( REG_ARG0 );
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-#ifdef _WIN32 // on windows ignore the directory and mode arguments
-            tracer.Trace( "  syscall command SYS_mkdirat path %s\n", path );
-            int result = _mkdir( path );
-#else
-#ifdef __APPLE__
-            if ( -100 == directory )
-                directory = -2;
-#endif
-            mode_t mode = (mode_t) ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  syscall command SYS_mkdirat dir %d, path %s, mode %x\n", directory, path, mode );
-            int result = mkdirat( directory, path, mode );
-#endif
-            update_result_errno( cpu, result );
-            break;
+            r.changed_args |= ( 1 << i );
+            out.insert( out.end(), (uint8_t *) &args[ i ], (uint8_t *) ( &args[ i ] + 1 ) );
         }
-        case SYS_rmdir:
-        {
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            tracer.Trace( "  syscall command SYS_rmdir path %s\n", path );
+    }
 
-#ifdef _WIN32 // on windows ignore the directory and flags arguments
-            int result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
-#else
-            int directory = -100;
-            int flags = EMULATOR_AT_REMOVEDIR;
-#ifdef __APPLE__
-            if ( -100 == directory )
-                directory = -2;
-            if ( EMULATOR_AT_REMOVEDIR == flags )
-                flags = AT_REMOVEDIR;
-#endif
-            int result = unlinkat( directory, path, flags );
-#endif // _WIN32
+    // runs of changed bytes separated by fewer than 16 unchanged bytes are written as one region
 
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_unlinkat:
+    const uint8_t * psnap = g_syscallSnapshot.data();
+    for ( const SyscallLogWindow & w : g_syscallWindows )
+    {
+        const uint8_t * pmem = memory.data() + w.offset;
+        size_t i = 0;
+        while ( i < w.length )
         {
-            int directory = (int) ACCESS_REG( REG_ARG0 );
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            int flags = (int) ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  syscall command SYS_unlinkat dir %d, path %s, flags %x\n", directory, path, flags );
-#ifdef _WIN32 // on windows ignore the directory and flags arguments
-            DWORD attr = GetFileAttributesA( path );
-            int result = 0;
-            if ( INVALID_FILE_ATTRIBUTES != result )
+            if ( pmem[ i ] == psnap[ i ] )
             {
-                if ( attr & FILE_ATTRIBUTE_DIRECTORY )
-                    result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
-                else
-                    result = remove( path );
+                i++;
+                continue;
             }
-#else
-#ifdef __APPLE__
-            if ( -100 == directory )
-                directory = -2;
-            if ( EMULATOR_AT_REMOVEDIR == flags )
-                flags = AT_REMOVEDIR;
-#endif // __APPLE__
-            int result = unlinkat( directory, path, flags );
-#endif //_WIN32
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_unlink:
-        {
-            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            tracer.Trace( "  syscall command SYS_unlink path %#llx '%s'\n", (uint64_t) path, path );
-#ifdef _WIN32
-            DWORD attr = GetFileAttributesA( path );
-            int result = 0;
-            if ( INVALID_FILE_ATTRIBUTES != result )
+
+            size_t start = i, end = i + 1, same = 0;
+            for ( i++; i < w.length && same < 16; i++ )
             {
-                if ( attr & FILE_ATTRIBUTE_DIRECTORY )
-                    result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
+                if ( pmem[ i ] == psnap[ i ] )
+                    same++;
                 else
-                    result = remove( path );
+                {
+                    same = 0;
+                    end = i + 1;
+                }
             }
-#else
-            int result = unlink( path );
-#endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_uname:
-        {
-            struct utsname_syscall * pname = (struct utsname_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            strcpy( pname->sysname, "syscall" );
-            strcpy( pname->nodename, "localhost" );
-            strcpy( pname->release, "19.69.420" );
-            strcpy( pname->version, "#1" );
-            strcpy( pname->machine, "aarch64" );
-            strcpy( pname->domainname, "localdomain" );
-            update_result_errno( cpu, 0 );
-            break;
+
+            SyscallLogRegion region = { w.offset + start, end - start };
+            out.insert( out.end(), (uint8_t *) &region, (uint8_t *) ( &region + 1 ) );
+            out.insert( out.end(), pmem + start, pmem + end );
+            r.regions++;
         }
-        case SYS_getrusage:
-        {
-            int who = (int) ACCESS_REG( REG_ARG0 );
-#if defined( M68 )
-            struct linux_rusage_syscall32 *prusage = (struct linux_rusage_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-#elif defined( X32OS )
-            struct linux_rusage_syscall_x32 *prusage = (struct linux_rusage_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-#else //M68 || X32OS
-            struct linux_rusage_syscall *prusage = (struct linux_rusage_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            tracer.Trace( "  sizeof linux_rusage_syscall: %zd\n", sizeof( struct linux_rusage_syscall ) );
-#if defined( SPARCOS ) || defined( X32OS )
-            memset( prusage, 0, 88 ); // 32-bit sparc binaries use fulls-sized times but are only 88 bytes long; through ru_majflt, not starting with ru_nswap
-#else
-            memset( prusage, 0, sizeof( struct linux_rusage_syscall ) );
-#endif //SPARCOS
-#endif //M68 || X32OS
+        psnap += w.length;
+    }
 
-            if ( 0 == who ) // RUSAGE_SELF
-            {
-#ifdef _WIN32
-                FILETIME ftCreation, ftExit, ftKernel, ftUser;
-                if ( GetProcessTimes( GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser ) )
-                {
-                    uint64_t utotal = ( ( (uint64_t) ftUser.dwHighDateTime << 32 ) + ftUser.dwLowDateTime ) / 10; // 100ns to microseconds
-#if defined( M68 )
-                    prusage->ru_utime.tv_sec = utotal / 1000000;
-                    prusage->ru_utime.tv_usec = (uint32_t) ( utotal % 1000000 );
-                    prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
-                    prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
-#elif defined( X32OS )
-                    prusage->ru_utime.tv_sec = (uint32_t) ( utotal / 1000000 );
-                    prusage->ru_utime.tv_usec = (uint32_t) ( utotal % 1000000 );
-                    prusage->ru_utime.tv_sec = swap_endian32( prusage->ru_utime.tv_sec );
-                    prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
-#else //M68 // SPARCOS seems to use the 64 bit structures
-                    prusage->ru_utime.tv_sec = utotal / 1000000;
-                    prusage->ru_utime.tv_usec = utotal % 1000000;
-                    prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
-                    prusage->ru_utime.tv_usec = swap_endian64( prusage->ru_utime.tv_usec );
-#endif //M68
-                    uint64_t stotal = ( ( (uint64_t) ftKernel.dwHighDateTime << 32 ) + ftKernel.dwLowDateTime ) / 10;
-#ifdef M68
-                    prusage->ru_stime.tv_sec = stotal / 1000000;
-                    prusage->ru_stime.tv_usec = (uint32_t) ( stotal % 1000000 );
-                    prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
-                    prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
-#elif defined( X32OS )
-                    prusage->ru_stime.tv_sec = (uint32_t) ( stotal / 1000000 );
-                    prusage->ru_stime.tv_usec = (uint32_t) ( stotal % 1000000 );
-                    prusage->ru_stime.tv_sec = swap_endian32( prusage->ru_stime.tv_sec );
-                    prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
-#else //M68 or X32OS
-                    prusage->ru_stime.tv_sec = stotal / 1000000;
-                    prusage->ru_stime.tv_usec = stotal % 1000000;
-                    prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
-                    prusage->ru_stime.tv_usec = swap_endian64( prusage->ru_stime.tv_usec );
-#endif //M68
-                }
-                else
-                    tracer.Trace( "  unable to GetProcessTimes, error %d\n", GetLastError() );
-#else //_WIN32
-                struct rusage local_rusage;
-                getrusage( who, &local_rusage ); // on 32-bit systems fields are 32 bit
-#if defined( M68 )
-                prusage->ru_utime.tv_sec = local_rusage.ru_utime.tv_sec;
-                prusage->ru_utime.tv_usec = (uint32_t) local_rusage.ru_utime.tv_usec;
-                prusage->ru_stime.tv_sec = local_rusage.ru_stime.tv_sec;
-                prusage->ru_stime.tv_usec = (uint32_t) local_rusage.ru_stime.tv_usec;
-                prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
-                prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
-                prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
-                prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
-#elif defined( X32OS )
-                prusage->ru_utime.tv_sec = (uint32_t) local_rusage.ru_utime.tv_sec;
-                prusage->ru_utime.tv_usec = (uint32_t) local_rusage.ru_utime.tv_usec;
-                prusage->ru_stime.tv_sec = (uint32_t) local_rusage.ru_stime.tv_sec;
-                prusage->ru_stime.tv_usec = (uint32_t) local_rusage.ru_stime.tv_usec;
-                prusage->ru_utime.tv_sec = swap_endian32( prusage->ru_utime.tv_sec );
-                prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
-                prusage->ru_stime.tv_sec = swap_endian32( prusage->ru_stime.tv_sec );
-                prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
-#else //M68 or X32OS
-                prusage->ru_utime.tv_sec = local_rusage.ru_utime.tv_sec;
-                prusage->ru_utime.tv_usec = local_rusage.ru_utime.tv_usec;
-                prusage->ru_stime.tv_sec = local_rusage.ru_stime.tv_sec;
-                prusage->ru_stime.tv_usec = local_rusage.ru_stime.tv_usec;
-                prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
-                prusage->ru_utime.tv_usec = swap_endian64( prusage->ru_utime.tv_usec );
-                prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
-                prusage->ru_stime.tv_usec = swap_endian64( prusage->ru_stime.tv_usec );
-#if ! ( defined( __mc68000__ ) || defined( X32OS ) )
-                prusage->ru_maxrss = local_rusage.ru_maxrss;
-                prusage->ru_ixrss = local_rusage.ru_ixrss;
-                prusage->ru_idrss = local_rusage.ru_idrss;
-                prusage->ru_isrss = local_rusage.ru_isrss;
-                prusage->ru_minflt = local_rusage.ru_minflt;
-                prusage->ru_majflt = local_rusage.ru_majflt;
-#ifndef SPARCOS // SPARC on Linux seems to use a structure that ends at ru_majflt
-                prusage->ru_nswap = local_rusage.ru_nswap;
-                prusage->ru_inblock = local_rusage.ru_inblock;
-                prusage->ru_oublock = local_rusage.ru_oublock;
-                prusage->ru_msgsnd = local_rusage.ru_msgsnd;
-                prusage->ru_msgrcv = local_rusage.ru_msgrcv;
-                prusage->ru_nsignals = local_rusage.ru_nsignals;
-                prusage->ru_nvcsw = local_rusage.ru_nvcsw;
-                prusage->ru_nivcsw = local_rusage.ru_nivcsw;
-#endif //SPARCOS
-#endif //__mc68000__
-#endif //M68
-#endif //_WIN32
-            }
-            else
-                tracer.Trace( "  unsupported request for who %u\n", who );
+    memcpy( out.data(), &r, sizeof( r ) );
+    if ( 1 != fwrite( out.data(), out.size(), 1, g_syscallRecordFile ) )
+    {
+        printf( "can't write to the syscall record file, errno %d\n", errno );
+        fclose( g_syscallRecordFile );
+        g_syscallRecordFile = 0;
+    }
+    g_syscallLogCount++;
+} //end_record_syscall
 
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case SYS_futex:
-        {
-            if ( !cpu.is_address_valid( ACCESS_REG( REG_ARG0 ) ) ) // sometimes it's malformed on arm64. not sure why yet.
-            {
-                tracer.Trace( "futex pointer in reg 0 is malformed\n" );
-                ACCESS_REG( REG_RESULT ) = 0;
-                break;
-            }
+static void syscall_replay_diverged( CPUClass & cpu, const char * pcwhy, uint64_t value )
+{
+    tracer.Trace( "syscall replay diverged at syscall %llu: %s %#llx\n", g_syscallLogCount, pcwhy, value );
+    printf( "syscall replay diverged at syscall %llu: %s %#llx\n", g_syscallLogCount, pcwhy, value );
+    emulator_hard_termination( cpu, "syscall replay diverged:", value );
+} //syscall_replay_diverged
 
-            uint32_t * paddr = (uint32_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            int futex_op = (int) ACCESS_REG( REG_ARG1 ) & (~128); // strip "private" flags
-            uint32_t value = (uint32_t) ACCESS_REG( REG_ARG2 );
+// returns the size of the record at offset, or 0 if it runs past the end of the log or writes outside the app's memory
 
-            tracer.Trace( "  futex all paddr %p (%d), futex_op %d, val %d\n", paddr, ( 0 == paddr ) ? -666 : *paddr, futex_op, value );
+static size_t syscall_log_record_size( size_t offset )
+{
+    size_t size = g_syscallReplayLog.size();
+    if ( ( offset > size ) || ( size - offset < sizeof( SyscallLogRecord ) ) )
+        return 0;
 
-            if ( 0 == futex_op ) // FUTEX_WAIT
-            {
-                if ( *paddr != value )
-                    ACCESS_REG( REG_RESULT ) = 11; // EAGAIN
-                else
-                    ACCESS_REG( REG_RESULT ) = 0;
-            }
-            else if ( 1 == futex_op ) // FUTEX_WAKE
-                ACCESS_REG( REG_RESULT ) = 0;
-            else
-                ACCESS_REG( REG_RESULT ) = (REG_TYPE) -1; // fail this until/unless there is a real-world use
-            break;
-        }
-#if !defined( M68 ) && !defined( __mc68000__ )// lots of 64/32 interop issues with this
-        case SYS_writev:
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
-            const struct iovec * pvec = (const struct iovec *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            if ( 1 == descriptor || 2 == descriptor )
-#ifdef M68
-                tracer.Trace( "  desc %d: writing '%.*s'\n", descriptor, pvec->iov_len, cpu.getmem( 0xffffffff & (REG_TYPE) pvec->iov_base ) );
-#else
-                tracer.Trace( "  desc %d: writing '%.*s'\n", descriptor, pvec->iov_len, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ) );
-#endif
+    const SyscallLogRecord * pr = (const SyscallLogRecord *) ( g_syscallReplayLog.data() + offset );
+    size_t o = offset + sizeof( SyscallLogRecord );
+    for ( int i = 0; i < 6; i++ )
+        if ( pr->changed_args & ( 1 << i ) )
+            o += sizeof( uint64_t );
 
-            REG_TYPE result = 0;
+    if ( o > size )
+        return 0;
 
-#ifdef _WIN32
-            if ( descriptor <= 2 )
-                result = (REG_TYPE) WinWrite( descriptor, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ), (unsigned) (uint64_t) pvec->iov_len );
-            else
-                result = (REG_TYPE) write( descriptor, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ), (unsigned) (uint64_t) pvec->iov_len );
-#else //_WIN32
-            struct iovec vec_local;
-            vec_local.iov_base = cpu.getmem( (uint64_t) pvec->iov_base );
-            vec_local.iov_len = pvec->iov_len;
-            tracer.Trace( "  write length: %u to descriptor %d at addr %p\n", pvec->iov_len, descriptor, vec_local.iov_base );
-            result = writev( descriptor, &vec_local, ACCESS_REG( REG_ARG2 ) );
-#endif //_WIN32
-            update_result_errno( cpu, result );
-            break;
-        }
-#endif //M68
-        case SYS_clock_gettime:
-        {
-            clockid_t cid = (clockid_t) ACCESS_REG( REG_ARG0 );
-            #ifdef __APPLE__ // Linux vs MacOS
-                if ( 1 == cid )
-                    cid = CLOCK_REALTIME;
-                else if ( 5 == cid )
-                    cid = CLOCK_REALTIME;
-            #endif
+    for ( uint64_t i = 0; i < pr->regions; i++ )
+    {
+        if ( size - o < sizeof( SyscallLogRegion ) )
+            return 0;
 
-#ifdef _WIN32
-            struct timespec_syscall local_ts = { 0 };
-            int result = msc_clock_gettime( cid, & local_ts );
-#else
-            struct timespec local_ts; // this varies in size from platform to platform
-            int result = clock_gettime( cid, & local_ts );
-#endif
+        const SyscallLogRegion * pregion = (const SyscallLogRegion *) ( g_syscallReplayLog.data() + o );
+        o += sizeof( SyscallLogRegion );
+        if ( ( pregion->length > size - o ) || ( pregion->offset > memory.size() ) || ( pregion->length > memory.size() - pregion->offset ) )
+            return 0;
 
-            struct timespec_syscall * ptimespec = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            ptimespec->tv_sec = local_ts.tv_sec;
-            ptimespec->tv_nsec = local_ts.tv_nsec;
-            ptimespec->swap_endianness();
+        o += (size_t) pregion->length;
+    }
 
-            tracer.Trace( "  tv_sec %llx, tv_nsec %llx\n", ptimespec->tv_sec, (uint64_t) ptimespec->tv_nsec );
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_fsync:
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+    return o - offset;
+} //syscall_log_record_size
 
-#ifdef _WIN32
-            int result = _commit( descriptor );
-#else
-            int result = fsync( descriptor );
-#endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_fdatasync:
-        {
-            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+static const SyscallLogRecord * apply_replay_record( CPUClass & cpu, size_t offset )
+{
+    // start_syscall_replay() checked that each record fits in the log and that its regions fit in memory
 
-#ifdef _WIN32
-            int result = _commit( descriptor );
-#elif defined( __APPLE__ )
-            int result = fsync( descriptor ); // fdatasync isn't available on MacOS
-#else
-            int result = fdatasync( descriptor );
-#endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_sigaction:
-        {
-            //errno = EACCES;
-            //update_result_errno( cpu, -1 );
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case emulator_sys_time: // returns the time as number of seconds since the epoch 1970-01-01 0 UTC. time_t time(time_t *_Nullable tloc);
+    const SyscallLogRecord * pr = (const SyscallLogRecord *) ( g_syscallReplayLog.data() + offset );
+    const uint64_t * pargs = (const uint64_t *) ( pr + 1 );
+    REG_TYPE * args[ 6 ] = { &ACCESS_REG( REG_ARG0 ), &ACCESS_REG( REG_ARG1 ), &ACCESS_REG( REG_ARG2 ),
+                             &ACCESS_REG( REG_ARG3 ), &ACCESS_REG( REG_ARG4 ), &ACCESS_REG( REG_ARG5 ) };
+    for ( int i = 0; i < 6; i++ )
+        if ( pr->changed_args & ( 1 << i ) )
+            *args[ i ] = (REG_TYPE) *pargs++;
+
+    const uint8_t * p = (const uint8_t *) pargs;
+    for ( uint64_t i = 0; i < pr->regions; i++ )
+    {
+        const SyscallLogRegion * pregion = (const SyscallLogRegion *) p;
+        memcpy( memory.data() + pregion->offset, pregion + 1, (size_t) pregion->length );
+        p += sizeof( SyscallLogRegion ) + pregion->length;
+    }
+
+    g_syscallReplayOffset = (size_t) ( p - g_syscallReplayLog.data() );
+    g_syscallLogCount++;
+    return pr;
+} //apply_replay_record
+
+// returns true if the syscall was satisfied from the log and shouldn't execute
+
+static bool replay_syscall( CPUClass & cpu, REG_TYPE syscall_id )
+{
+    if ( g_syscallReplayOffset + sizeof( SyscallLogRecord ) > g_syscallReplayLog.size() )
+        syscall_replay_diverged( cpu, "the app made more syscalls than were recorded. syscall", (uint64_t) ACCESS_REG( REG_SYSCALL ) );
+
+    const SyscallLogRecord * pr = (const SyscallLogRecord *) ( g_syscallReplayLog.data() + g_syscallReplayOffset );
+    if ( pr->id != (uint64_t) ACCESS_REG( REG_SYSCALL ) )
+        syscall_replay_diverged( cpu, "the app made a different syscall than was recorded. syscall", (uint64_t) ACCESS_REG( REG_SYSCALL ) );
+
+    REG_TYPE args[ 6 ] = { ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ),
+                           ACCESS_REG( REG_ARG3 ), ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) };
+    for ( int i = 0; i < 6; i++ )
+        if ( pr->args[ i ] != (uint64_t) args[ i ] )
+            syscall_replay_diverged( cpu, "a syscall argument differs from the recording. argument", (uint64_t) i );
+
+    if ( syscall_runs_in_replay( syscall_id, args[ 0 ] ) )
+    {
+        g_syscallReplayPending = g_syscallReplayOffset;
+        return false;
+    }
+
+    apply_replay_record( cpu, g_syscallReplayOffset );
+    ACCESS_REG( REG_RESULT ) = (REG_TYPE) pr->result;
+    tracer.Trace( "  replayed syscall result %llx\n", pr->result );
+    return true;
+} //replay_syscall
+
+// called after a syscall that executed during replay
+
+static void end_replay_syscall( CPUClass & cpu, REG_TYPE syscall_id )
+{
+    const SyscallLogRecord * pr = apply_replay_record( cpu, g_syscallReplayPending );
+    g_syscallReplayPending = 0;
+
+    if ( SYS_write == syscall_id || SYS_writev == syscall_id )
+        ACCESS_REG( REG_RESULT ) = (REG_TYPE) pr->result; // the console may accept a different byte count than when recording
+    else if ( pr->result != (uint64_t) ACCESS_REG( REG_RESULT ) )
+        syscall_replay_diverged( cpu, "a syscall result differs from the recording. result", (uint64_t) ACCESS_REG( REG_RESULT ) );
+} //end_replay_syscall
+
+static void fill_syscall_log_header( SyscallLogHeader & h )
+{
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.signature, syscallLogSignature, sizeof( h.signature ) );
+    h.version = syscallLogVersion;
+    h.reg_size = sizeof( REG_TYPE );
+    h.base_address = g_base_address;
+    h.execution_address = g_execution_address;
+    h.memory_size = memory.size();
+} //fill_syscall_log_header
+
+static bool start_syscall_record( const char * pfile )
+{
+    g_syscallRecordFile = fopen( pfile, "wb" );
+    if ( !g_syscallRecordFile )
+        return false;
+
+    SyscallLogHeader h;
+    fill_syscall_log_header( h );
+    return ( 1 == fwrite( &h, sizeof( h ), 1, g_syscallRecordFile ) );
+} //start_syscall_record
+
+static bool start_syscall_replay( const char * pfile )
+{
+    FILE * fp = fopen( pfile, "rb" );
+    if ( !fp )
+        return false;
+
+    CFile file( fp );
+    fseek( fp, 0, SEEK_END );
+    long len = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    if ( len < (long) sizeof( SyscallLogHeader ) )
+        return false;
+
+    g_syscallReplayLog.resize( (size_t) len );
+    if ( 1 != fread( g_syscallReplayLog.data(), (size_t) len, 1, fp ) )
+        return false;
+
+    SyscallLogHeader h, expected;
+    memcpy( &h, g_syscallReplayLog.data(), sizeof( h ) );
+    fill_syscall_log_header( expected );
+    if ( memcmp( &h, &expected, sizeof( h ) ) )
+    {
+        printf( "syscall log %s wasn't recorded with this app and emulator configuration\n", pfile );
+        g_syscallReplayLog.clear();
+        return false;
+    }
+
+    // check every record up front, so a corrupt or truncated log fails here rather than writing outside the app's memory
+
+    size_t offset = sizeof( SyscallLogHeader );
+    uint64_t records = 0;
+    while ( offset < g_syscallReplayLog.size() )
+    {
+        size_t record_size = syscall_log_record_size( offset );
+        if ( 0 == record_size )
         {
-            time_t t = time( 0 );
-            if ( 0 != ACCESS_REG( REG_ARG0 ) )
-            {
-                uint64_t * ptime = (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-                *ptime = swap_endian64( t );
-            }
-            update_result_errno( cpu, (REG_TYPE) t );
-            break;
+            printf( "syscall log %s is corrupt or truncated after %llu syscalls\n", pfile, records );
+            g_syscallReplayLog.clear();
+            return false;
         }
-        case SYS_times:
-        {
-            // this function is long obsolete, but older apps call it and it's still supported on recent Linux builds
 
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-            struct linux_tms_syscall32 * ptms = ( 0 != ACCESS_REG( REG_ARG0 ) ) ? (struct linux_tms_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) : 0;
-#else
-            struct linux_tms_syscall * ptms = ( 0 != ACCESS_REG( REG_ARG0 ) ) ? (struct linux_tms_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) : 0;
-#endif //M68 or SPARCOS
+        offset += record_size;
+        records++;
+    }
 
-            if ( 0 != ptms ) // 0 is legal if callers just want the return value
-            {
-                memset( ptms, 0, sizeof ( *ptms ) );
-#ifdef _WIN32
-                FILETIME ftCreation, ftExit, ftKernel, ftUser;
-                if ( GetProcessTimes( GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser ) )
-                {
-                    ptms->tms_utime = ( ( (uint64_t) ftUser.dwHighDateTime << 32) + ftUser.dwLowDateTime ) / 100000; // 100ns to hundredths of a second
-                    ptms->tms_stime = ( ( (uint64_t) ftKernel.dwHighDateTime << 32 ) + ftKernel.dwLowDateTime ) / 100000;
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-                    ptms->tms_utime = swap_endian32( ptms->tms_utime );
-                    ptms->tms_stime = swap_endian32( ptms->tms_stime );
-#else
-                    ptms->tms_utime = swap_endian64( ptms->tms_utime );
-                    ptms->tms_stime = swap_endian64( ptms->tms_stime );
-#endif //M68 or SPARCOS
-                }
-                else
-                    tracer.Trace( "  unable to GetProcessTimes, error %d\n", GetLastError() );
-#else //_WIN32
-                struct tms local_tms; // on 32-bit systems the members are 32 bit.
-                times( &local_tms );
-                ptms->tms_utime = local_tms.tms_utime;
-                ptms->tms_stime = local_tms.tms_stime;
-                ptms->tms_cutime = local_tms.tms_cutime;
-                ptms->tms_cstime = local_tms.tms_cstime;
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-                ptms->tms_utime = swap_endian32( ptms->tms_utime );
-                ptms->tms_stime = swap_endian32( ptms->tms_stime );
-                ptms->tms_cutime = swap_endian32( ptms->tms_cutime );
-                ptms->tms_cstime = swap_endian32( ptms->tms_cstime );
-#else
-                ptms->tms_utime = swap_endian64( ptms->tms_utime );
-                ptms->tms_stime = swap_endian64( ptms->tms_stime );
-                ptms->tms_cutime = swap_endian64( ptms->tms_cutime );
-                ptms->tms_cstime = swap_endian64( ptms->tms_cstime );
-#endif //M68 or SPARCOS
-#endif //_WIN32
-            }
+    g_syscallReplayOffset = sizeof( SyscallLogHeader );
+    return true;
+} //start_syscall_replay
 
-            // ticks is generally in hundredths of a second per sysconf( _SC_CLK_TCK )
-            REG_TYPE sc_clk_tck = (REG_TYPE) 100;
-#if defined( _WIN32 )
-            REG_TYPE ticks = (REG_TYPE) GetTickCount64();
-            ticks /= 10; // milliseconds to hundredths of a second
-#else
-            sc_clk_tck = sysconf( _SC_CLK_TCK );
-            struct tms unused;
-            REG_TYPE ticks = times( &unused );
-#endif
-            update_result_errno( cpu, ticks );
-            break;
-        }
-        case SYS_rt_sigprocmask:
-        {
-            errno = 0;
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case SYS_prctl:
-        {
-            update_result_errno( cpu, 0 );
-            break;
-        }
-        case SYS_getpid:
-        {
-            ACCESS_REG( REG_RESULT ) = getpid();
-            break;
-        }
-        case SYS_gettid:
+static void end_syscall_record_replay()
+{
+    if ( g_syscallRecordFile )
+    {
+        fclose( g_syscallRecordFile );
+        g_syscallRecordFile = 0;
+        tracer.Trace( "recorded %llu syscalls\n", g_syscallLogCount );
+    }
+
+    if ( g_syscallReplayLog.size() )
+    {
+        tracer.Trace( "replayed %llu syscalls\n", g_syscallLogCount );
+        if ( g_syscallReplayOffset != g_syscallReplayLog.size() )
+            printf( "warning: syscall replay ended after %llu syscalls, before the end of the log\n", g_syscallLogCount );
+    }
+} //end_syscall_record_replay
+
+#endif //X64OS || X32OS
+
+// in-memory file system overlay. -o mounts a RAM file system at an app path, optionally preloaded from a host directory
+// or tar archive, so batch runs and benchmarks don't depend on host disk latency and don't change host files. the few
+// synthetic files apps look for under /proc live here too. each open overlay file holds a host descriptor for the null
+// device so its number can't collide with host descriptors.
+
+struct VfsNode
+{
+    bool directory;
+    bool synthetic;             // read-only, and can't be removed or renamed
+    uint64_t ino;
+    uint64_t mtime;             // seconds since the epoch
+    vector<uint8_t> data;
+};
+
+struct VfsFile
+{
+    int descriptor;             // host descriptor for the null device
+    string path;                // used to enumerate directories
+    shared_ptr<VfsNode> node;   // shared so open files survive unlink and rename
+    uint64_t offset;            // byte offset for files, next entry index for directories
+    bool readable;
+    bool writable;
+    bool append;
+};
+
+static EMULATOR_THREAD_LOCAL map<string, shared_ptr<VfsNode>> g_vfsNodes; // sorted, so a directory's descendants follow it
+static EMULATOR_THREAD_LOCAL vector<string> g_vfsMounts;                 // absolute app paths with no trailing slash
+static EMULATOR_THREAD_LOCAL vector<VfsFile> g_vfsFiles;
+static EMULATOR_THREAD_LOCAL uint64_t g_vfsNextIno = 0;
+static EMULATOR_THREAD_LOCAL bool g_vfsDiscardWrites = false;            // -d: writes succeed but file contents don't change
+static EMULATOR_THREAD_LOCAL string g_vfsCwd;                            // the app's current directory when it's in the overlay
+
+static shared_ptr<VfsNode> vfs_new_node( bool directory )
+{
+    shared_ptr<VfsNode> node( new VfsNode() );
+    node->directory = directory;
+    node->synthetic = false;
+    node->ino = 0x7f000000 + ( ++g_vfsNextIno );
+    node->mtime = (uint64_t) time( 0 );
+    return node;
+} //vfs_new_node
+
+static void vfs_initialize()
+{
+    if ( !g_vfsNodes.empty() ) // the synthetic files can't be removed, so this means it's already initialized
+        return;
+
+    uint64_t freq = 1000000000000; // nanoseconds, but the LPi4a is off by 3 orders of magnitude, so I replicate that bug here
+    freq = swap_endian64( freq );
+    shared_ptr<VfsNode> node = vfs_new_node( false );
+    node->synthetic = true;
+    node->data.resize( sizeof( freq ) );
+    memcpy( node->data.data(), &freq, sizeof( freq ) );
+    g_vfsNodes[ "/proc/device-tree/cpus/timebase-frequency" ] = node;
+
+    node = vfs_new_node( false );
+    node->synthetic = true;
+    node->data.assign( (const uint8_t *) "9.69", (const uint8_t *) "9.69" + 5 ); // including the null termination
+    g_vfsNodes[ "/proc/sys/kernel/osrelease" ] = node;
+} //vfs_initialize
+
+static VfsFile * vfs_find_file( int descriptor )
+{
+    for ( size_t i = 0; i < g_vfsFiles.size(); i++ )
+        if ( descriptor == g_vfsFiles[ i ].descriptor )
+            return & g_vfsFiles[ i ];
+
+    return 0;
+} //vfs_find_file
+
+static shared_ptr<VfsNode> vfs_find_node( const string & full )
+{
+    map<string, shared_ptr<VfsNode>>::iterator it = g_vfsNodes.find( full );
+    if ( g_vfsNodes.end() == it )
+        return shared_ptr<VfsNode>();
+
+    return it->second;
+} //vfs_find_node
+
+static string vfs_parent( const string & full )
+{
+    size_t slash = full.rfind( '/' );
+    return ( 0 == slash || string::npos == slash ) ? string( "/" ) : full.substr( 0, slash );
+} //vfs_parent
+
+static bool vfs_has_children( const string & full )
+{
+    string prefix = full + "/";
+    map<string, shared_ptr<VfsNode>>::iterator it = g_vfsNodes.lower_bound( prefix );
+    return ( g_vfsNodes.end() != it ) && ( 0 == it->first.compare( 0, prefix.length(), prefix ) );
+} //vfs_has_children
+
+static bool vfs_is_mount( const string & full )
+{
+    for ( size_t i = 0; i < g_vfsMounts.size(); i++ )
+        if ( full == g_vfsMounts[ i ] )
+            return true;
+
+    return false;
+} //vfs_is_mount
+
+static bool vfs_in_mount( const string & full )
+{
+    for ( size_t i = 0; i < g_vfsMounts.size(); i++ )
+    {
+        const string & m = g_vfsMounts[ i ];
+        if ( ( 0 == full.compare( 0, m.length(), m ) ) && ( ( full.length() == m.length() ) || ( '/' == full[ m.length() ] ) ) )
+            return true;
+    }
+
+    return false;
+} //vfs_in_mount
+
+// makes an absolute path without . or .. components. returns false if a relative path is relative to a host directory
+
+static bool vfs_full_path( int dirfd, const char * path, string & full )
+{
+    string combined;
+    if ( '/' == path[ 0 ] )
+        combined = path;
+    else
+    {
+        VfsFile * dir = vfs_find_file( dirfd );
+        if ( dir )
+            combined = dir->path + "/" + path;
+        else if ( -100 == dirfd && g_vfsCwd.length() )
+            combined = g_vfsCwd + "/" + path;
+#ifndef _WIN32
+        else if ( -100 == dirfd && g_vfsMounts.size() ) // AT_FDCWD. the synthetic files are only found with absolute paths
         {
-            ACCESS_REG( REG_RESULT ) = 1;
-            break;
+            char acCwd[ EMULATOR_MAX_PATH ];
+            if ( 0 == getcwd( acCwd, sizeof( acCwd ) ) )
+                return false;
+            combined = string( acCwd ) + "/" + path;
         }
-        case emulator_sys_rename:
+#endif
+        else
+            return false;
+    }
+
+    full.clear();
+    size_t start = 0;
+    while ( start <= combined.length() )
+    {
+        size_t end = combined.find( '/', start );
+        if ( string::npos == end )
+            end = combined.length();
+
+        string part = combined.substr( start, end - start );
+        if ( ".." == part )
         {
-            int result = rename( (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ), (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) ) );
-            update_result_errno( cpu, result );
-            break;
+            size_t slash = full.rfind( '/' );
+            full.erase( ( string::npos == slash ) ? 0 : slash );
         }
-        case SYS_renameat:
-        case SYS_renameat2:
+        else if ( part.length() && ( "." != part ) )
+            full += "/" + part;
+
+        start = end + 1;
+    }
+
+    if ( full.empty() )
+        full = "/";
+
+    return true;
+} //vfs_full_path
+
+// returns true and the full path if the path belongs to the overlay instead of the host
+
+static bool vfs_resolve( int dirfd, const char * path, string & full )
+{
+    vfs_initialize();
+
+    if ( !vfs_full_path( dirfd, path, full ) )
+        return false;
+
+    return vfs_in_mount( full ) || ( g_vfsNodes.end() != g_vfsNodes.find( full ) );
+} //vfs_resolve
+
+static bool vfs_fail( CPUClass & cpu, int error )
+{
+    errno = error;
+    update_result_errno( cpu, -1 );
+    return true;
+} //vfs_fail
+
+// flags are the app's open flags, not the host's
+
+static bool vfs_open( CPUClass & cpu, int dirfd, const char * path, int flags )
+{
+    string full;
+    if ( !vfs_resolve( dirfd, path, full ) )
+        return false;
+
+    int access = ( flags & 3 ); // O_RDONLY, O_WRONLY, O_RDWR
+    bool writable = ( 0 != access );
+    shared_ptr<VfsNode> node = vfs_find_node( full );
+
+    if ( !node )
+    {
+        if ( !is_o_creat_set( flags ) )
+            return vfs_fail( cpu, ENOENT );
+
+        shared_ptr<VfsNode> parent = vfs_find_node( vfs_parent( full ) );
+        if ( !parent )
+            return vfs_fail( cpu, ENOENT );
+        if ( !parent->directory )
+            return vfs_fail( cpu, ENOTDIR );
+
+        node = vfs_new_node( false );
+        g_vfsNodes[ full ] = node;
+    }
+    else
+    {
+        if ( is_o_creat_set( flags ) && is_open_flag_set( flags, o_excl ) )
+            return vfs_fail( cpu, EEXIST );
+        if ( is_o_directory_set( flags ) && !node->directory )
+            return vfs_fail( cpu, ENOTDIR );
+        if ( node->directory && writable )
+            return vfs_fail( cpu, EISDIR );
+        if ( node->synthetic && writable )
+            return vfs_fail( cpu, EACCES );
+
+        if ( writable && is_open_flag_set( flags, o_trunc ) && !g_vfsDiscardWrites )
         {
-            int olddirfd = (int) ACCESS_REG( REG_ARG0 );
-            const char * oldpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            int newdirfd = (int) ACCESS_REG( REG_ARG2 );
-            const char * newpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
-            unsigned int flags = ( SYS_renameat2 == syscall_id ) ? (unsigned int) ACCESS_REG( REG_ARG4 ) : 0;
-            tracer.Trace( "  renaming '%s' to '%s'\n", oldpath, newpath );
-#if defined( _WIN32 ) || defined( __mc68000__ )
-            int result = rename( oldpath, newpath );
-#elif defined( __APPLE__ )
-            if ( -100 == olddirfd )
-                olddirfd = -2;
-            if ( -100 == newdirfd )
-                newdirfd = -2;
-            int result = renameat( olddirfd, oldpath, newdirfd, newpath ); // macos has no renameat2
-#elif defined( sparc )
-            int result = renameat( olddirfd, oldpath, newdirfd, newpath ); // sparc has no renameat2
-#else
-            int result = renameat2( olddirfd, oldpath, newdirfd, newpath, flags );
-#endif
-            update_result_errno( cpu, result );
-            break;
+            node->data.clear();
+            node->mtime = (uint64_t) time( 0 );
         }
-        case SYS_getrandom:
-        {
-            void * buf = cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            REG_TYPE buflen = ACCESS_REG( REG_ARG1 );
-            unsigned int flags = (unsigned int) ACCESS_REG( REG_ARG2 );
-            SIGNED_REG_TYPE result = 0;
+    }
 
-#if defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
-            int * pbuf = (int *) buf;
-            size_t count = buflen / sizeof( int );
-            for ( size_t i = 0; i < count; i++ )
-                pbuf[ i ] = (int) rand64();
-            result = buflen;
+#ifdef _WIN32
+    int descriptor = _open( "NUL", _O_RDWR );
 #else
-            result = getrandom( buf, buflen, flags );
+    int descriptor = open( "/dev/null", O_RDWR );
 #endif
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_statx:
-        {
-            //                    0                                        1          2                  3                                4
-            // int statx( int dirfd, const char *_Nullable restrict pathname, int flags, unsigned int mask, struct statx *restrict statxbuf );
-            tracer.Trace( "  syscall cmd SYS_statx\n" );
-            int dirfd = (int) ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  dirfd: %d\n", dirfd );
-            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            int flags = (int) ACCESS_REG( REG_ARG2 );
-            tracer.Trace( "  statx on path '%s'\n", pathname );
-            int mask = (int) ACCESS_REG( REG_ARG3 );
+    if ( descriptor < 0 )
+    {
+        update_result_errno( cpu, -1 );
+        return true;
+    }
 
-            if ( STATX_BASIC_STATS != mask ) // very simplistic implementation
-            {
-                errno = EINVAL;
-                update_result_errno( cpu, -1 );
-                break;
-            }
+    VfsFile file;
+    file.descriptor = descriptor;
+    file.path = full;
+    file.node = node;
+    file.offset = 0;
+    file.readable = ( 1 != access );
+    file.writable = writable;
+    file.append = is_open_flag_set( flags, o_append );
+    g_vfsFiles.push_back( file );
 
-            struct statx_linux_syscall * pout = (struct statx_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
-            memset( pout, 0, sizeof( struct statx_linux_syscall ) );
-            pout->stx_mask = mask;
-            int result = 0;
+    tracer.Trace( "  opened '%s' in the in-memory file system as descriptor %d\n", full.c_str(), descriptor );
+    update_result_errno( cpu, descriptor );
+    return true;
+} //vfs_open
 
-#ifdef _WIN32
-            struct stat_linux_syscall local_stat = {0};
-            char ac[ EMULATOR_MAX_PATH ];
-            strcpy( ac, pathname );
-            slash_to_backslash( ac );
-            result = fill_pstat_windows( ( dirfd > 0 ) ? dirfd : -1, & local_stat, ac );
-            if ( 0 == result )
-            {
-                tracer.Trace( "  result in local stat_linux_syscall, offset of mode %u, mode: %#x\n", offsetof( struct stat_linux_syscall, st_mode ), local_stat.st_mode );
-                tracer.TraceBinaryData( (uint8_t *) &local_stat, sizeof( stat_linux_syscall ), 5 );
-#if defined( SPARCOS )
-                struct statx_sparc_linux_syscall32 * pout32 = (struct statx_sparc_linux_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
-                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout32->stx_ino = local_stat.st_ino;
-                pout32->stx_nlink = local_stat.st_nlink;
-                pout32->stx_uid = local_stat.st_uid;
-                pout32->stx_gid = local_stat.st_gid;
-                pout32->stx_mode = (uint16_t) local_stat.st_mode;
-                pout32->stx_size = (uint32_t) local_stat.st_size;
-                pout32->stx_blocks = (uint32_t) local_stat.st_blocks;
-                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
-                pout32->swap_endianness();
+static bool vfs_close( CPUClass & cpu, int descriptor )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
 
-                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct statx_sparc_linux_syscall32, stx_mode ) );
-                tracer.Trace( "statx data:\n" );
-                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
-                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
-                tracer.Trace( "  ino: %#x\n", pout32->stx_ino );
-                tracer.Trace( "  size: %#x\n", pout32->stx_size );
-                tracer.Trace( "  blocks: %#x\n", pout32->stx_blocks );
-                tracer.TraceBinaryData( (uint8_t *) pout32, sizeof( *pout32 ), 5 );
-#elif defined( X32OS )
-                struct statx_linux_syscall_x32 * pout32 = (struct statx_linux_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
-                size_t cbStat = sizeof( struct statx_linux_syscall_x32 );
-                local_stat.swap_endianness();
+    close( descriptor );
+    g_vfsFiles.erase( g_vfsFiles.begin() + ( file - g_vfsFiles.data() ) );
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_close
 
-                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout32->stx_ino = local_stat.st_ino;
-                pout32->stx_nlink = (uint32_t) local_stat.st_nlink;
-                pout32->stx_uid = local_stat.st_uid;
-                pout32->stx_gid = local_stat.st_gid;
-                pout32->stx_mode = swap_endian16( (uint16_t) swap_endian32( local_stat.st_mode ) );
-                pout32->stx_size = local_stat.st_size;
-                pout32->stx_blocks = local_stat.st_blocks;
-                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+static bool vfs_read( CPUClass & cpu, int descriptor, void * buffer, size_t buffer_size )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
 
-                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct statx_linux_syscall_x32, stx_mode ) );
-                tracer.Trace( "statx data:\n" );
-                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
-                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
-                tracer.Trace( "  ino: %#llx\n", pout32->stx_ino );
-                tracer.Trace( "  size: %#llx\n", pout32->stx_size );
-                tracer.Trace( "  blocks: %#llx\n", pout32->stx_blocks );
-                tracer.Trace( "  attrib_mask: %#llx\n", pout32->stx_attributes_mask );
-                tracer.Trace( "  atime sec %#llx\n", pout32->stx_atime.tv_sec );
-                tracer.Trace( "  atime nsec %#lx\n", pout32->stx_atime.tv_nsec );
-                tracer.Trace( "  btime sec %#llx\n", pout32->stx_btime.tv_sec );
-                tracer.Trace( "  btime nsec %#lx\n", pout32->stx_btime.tv_nsec );
-                tracer.Trace( "  ctime sec %#llx\n", pout32->stx_ctime.tv_sec );
-                tracer.Trace( "  ctime nsec %#lx\n", pout32->stx_ctime.tv_nsec );
-                tracer.Trace( "  mtime sec %#llx\n", pout32->stx_mtime.tv_sec );
-                tracer.Trace( "  mtime nsec %#lx\n", pout32->stx_mtime.tv_nsec );
-                //tracer.TraceBinaryData( (uint8_t *) pout32, cbStat, 5 );
-#else
-                size_t cbStat = sizeof( struct stat_linux_syscall );
-                assert( 128 == cbStat );  // 128 is the size of the stat struct this syscall on RISC-V Linux
-                local_stat.swap_endianness();
+    if ( file->node->directory )
+        return vfs_fail( cpu, EISDIR );
+    if ( !file->readable )
+        return vfs_fail( cpu, EBADF );
 
-                pout->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout->stx_ino = local_stat.st_ino;
-                pout->stx_nlink = (uint32_t) local_stat.st_nlink;
-                pout->stx_uid = local_stat.st_uid;
-                pout->stx_gid = local_stat.st_gid;
-                pout->stx_mode = swap_endian16( (uint16_t) swap_endian32( local_stat.st_mode ) );
-                pout->stx_size = local_stat.st_size;
-                pout->stx_blocks = local_stat.st_blocks;
-                pout->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
-                pout->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+    vector<uint8_t> & data = file->node->data;
+    size_t len = 0;
+    if ( file->offset < data.size() )
+        len = (size_t) get_min( (uint64_t) buffer_size, (uint64_t) data.size() - file->offset );
 
-                pout->stx_blksize = 0xbbbbbbbb;
-                pout->stx_attributes = 0xaaaaaaaaaaaaaaaa;
-                pout->stx_nlink = 0x11111111;
-                pout->stx_uid = 0x22222222;
-                pout->stx_gid = 0x33333333;
-                pout->stx_mode = 0x4444;
-                pout->stx_ino = 0x5555555555555555;
-                pout->stx_size = 0x6666666666666666;
-                pout->stx_blocks = 0x7777777777777777;
+    if ( len )
+        memcpy( buffer, data.data() + file->offset, len );
 
-                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
-                tracer.Trace( "statx data:\n" );
-                tracer.Trace( "  gid: %#x\n", pout->stx_gid );
-                tracer.Trace( "  mode: %#x\n", pout->stx_mode );
-                tracer.Trace( "  ino: %#llx\n", pout->stx_ino );
-                tracer.Trace( "  size: %#llx\n", pout->stx_size );
-                tracer.Trace( "  blocks: %#llx\n", pout->stx_blocks );
-                tracer.Trace( "  attrib_mask: %#llx\n", pout->stx_attributes_mask );
-                tracer.TraceBinaryData( (uint8_t *) pout, (uint32_t) cbStat, 5 );
-#endif
-            }
-            else
-            {
-                errno = 2;
-                tracer.Trace( "  fill_pstat_windows failed\n" );
-            }
-#else // _WIN32
-            tracer.Trace( "  sizeof struct stat: %d\n", (int) sizeof( struct stat ) );
-            struct stat local_stat = {0};
+    file->offset += len;
+    update_result_errno( cpu, (SIGNED_REG_TYPE) len );
+    return true;
+} //vfs_read
 
-#if defined( __APPLE__ )
-            if ( -100 == dirfd )
-                dirfd = -2;
+static void vfs_write_bytes( VfsFile & file, const uint8_t * p, size_t count )
+{
+    vector<uint8_t> & data = file.node->data;
+    if ( file.append )
+        file.offset = data.size();
 
-            if ( EMULATOR_AT_SYMLINK_NOFOLLOW & flags )
-                flags = AT_SYMLINK_NOFOLLOW; // 0x20 instead of 0x100 on macOS
-            else if ( EMULATOR_AT_SYMLINK_FOLLOW & flags )
-                flags = AT_SYMLINK_FOLLOW; // 0x40 instead of 0x400 on macOS
-            else
-                flags = 0; // no other flags are supported on macOS
-            tracer.Trace( "  translated flags for MacOS: %x\n", flags );
+    if ( !g_vfsDiscardWrites && count )
+    {
+        if ( file.offset + count > data.size() )
+            data.resize( (size_t) file.offset + count ); // seeking past the end leaves a zero-filled hole
+        memcpy( data.data() + file.offset, p, count );
+        file.node->mtime = (uint64_t) time( 0 );
+    }
 
-            tracer.Trace( "  statx calling fstatat with dirfd %d, flags %#x\n", dirfd, flags );
-            if ( 0 == pathname[ 0 ] )
-                result = fstat( dirfd, & local_stat );
-            else
-                result = fstatat( dirfd, pathname, & local_stat, flags );
-#else
-            tracer.Trace( "  statx calling fstatat with dirfd %d, flags %#x\n", dirfd, flags );
-            result = fstatat( dirfd, pathname, & local_stat, flags );
-#endif // __APPLE__
-            if ( 0 == result )
-            {
-                tracer.Trace( "  result in local_stat, offset of mode %u, mode: %#x\n", offsetof( struct stat, st_mode ), local_stat.st_mode );
-                tracer.TraceBinaryData( (uint8_t *) &local_stat, sizeof( local_stat ), 5 );
+    file.offset += count;
+} //vfs_write_bytes
 
-#if defined( SPARCOS )
-                tracer.Trace( "  offsetof mode: %u\n", (int) offsetof( struct statx_sparc_linux_syscall32, stx_mode ) );
-                struct statx_sparc_linux_syscall32 * pout32 = (struct statx_sparc_linux_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
-                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout32->stx_ino = local_stat.st_ino;
-                pout32->stx_nlink = local_stat.st_nlink;
-                pout32->stx_uid = local_stat.st_uid;
-                pout32->stx_gid = local_stat.st_gid;
-                pout32->stx_mode = local_stat.st_mode;
-                pout32->stx_size = local_stat.st_size;
-                pout32->stx_blocks = local_stat.st_blocks;
-#if defined( __APPLE__ )
-                pout32->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
-#elif defined( __mc68000__ )
-                pout32->stx_atime.tv_sec = local_stat.st_atime;
-                pout32->stx_atime.tv_nsec = 0;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtime;
-                pout32->stx_mtime.tv_nsec = 0;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctime;
-                pout32->stx_ctime.tv_nsec = 0;
-#else
-                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
-#endif
-                pout32->swap_endianness();
+static bool vfs_write( CPUClass & cpu, int descriptor, const uint8_t * p, size_t count )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
 
-#elif defined( X32OS )
-                tracer.Trace( "  offsetof mode: %u\n", (int) offsetof( struct statx_linux_syscall_x32, stx_mode ) );
-                struct statx_linux_syscall_x32 * pout32 = (struct statx_linux_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
-                size_t cbStat = sizeof( struct statx_linux_syscall_x32 );
+    if ( !file->writable )
+        return vfs_fail( cpu, EBADF );
 
-                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout32->stx_ino = local_stat.st_ino;
-                pout32->stx_nlink = (uint32_t) local_stat.st_nlink;
-                pout32->stx_uid = local_stat.st_uid;
-                pout32->stx_gid = local_stat.st_gid;
-                tracer.Trace( "sizeof local_stat.st_mode: %u\n", (int) sizeof( local_stat.st_mode ) );
-                tracer.Trace( "sizeof pout32->st_mode: %u\n", (int) sizeof( pout32->stx_mode ) );
-                pout32->stx_mode = (uint16_t) local_stat.st_mode;
-                tracer.Trace( "mode from %#x, mode to %#x\n", local_stat.st_mode, pout32->stx_mode );
-                pout32->stx_size = local_stat.st_size;
-                pout32->stx_blocks = local_stat.st_blocks;
+    vfs_write_bytes( *file, p, count );
+    update_result_errno( cpu, (SIGNED_REG_TYPE) count );
+    return true;
+} //vfs_write
 
-#if defined( __APPLE__ )
-                pout32->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
-#elif defined( __mc68000__ )
-                pout32->stx_atime.tv_sec = local_stat.st_atime;
-                pout32->stx_atime.tv_nsec = 0;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtime;
-                pout32->stx_mtime.tv_nsec = 0;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctime;
-                pout32->stx_ctime.tv_nsec = 0;
-#else
-                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
-                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
-#endif // __APPLE__ || __mc68000__ || (other)
+static bool vfs_writev( CPUClass & cpu, int descriptor, const struct iovec * pvec, size_t count )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
 
-                pout32->swap_endianness();
-                tracer.Trace( "statx data:\n" );
-                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
-                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
-                tracer.Trace( "  ino: %#llx\n", pout32->stx_ino );
-                tracer.Trace( "  size: %#llx\n", pout32->stx_size );
-                tracer.Trace( "  blocks: %#llx\n", pout32->stx_blocks );
-                tracer.Trace( "  attrib_mask: %#llx\n", pout32->stx_attributes_mask );
-                tracer.Trace( "  atime sec %#llx\n", pout32->stx_atime.tv_sec );
-                tracer.Trace( "  atime nsec %#lx\n", pout32->stx_atime.tv_nsec );
-                tracer.Trace( "  btime sec %#llx\n", pout32->stx_btime.tv_sec );
-                tracer.Trace( "  btime nsec %#lx\n", pout32->stx_btime.tv_nsec );
-                tracer.Trace( "  ctime sec %#llx\n", pout32->stx_ctime.tv_sec );
-                tracer.Trace( "  ctime nsec %#lx\n", pout32->stx_ctime.tv_nsec );
-                tracer.Trace( "  mtime sec %#llx\n", pout32->stx_mtime.tv_sec );
-                tracer.Trace( "  mtime nsec %#lx\n", pout32->stx_mtime.tv_nsec );
-                //tracer.TraceBinaryData( (uint8_t *) pout32, cbStat, 5 );
+    if ( !file->writable )
+        return vfs_fail( cpu, EBADF );
 
-#else // SPARCOS
-                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
+    size_t total = 0;
+    for ( size_t v = 0; v < count; v++ )
+    {
+        vfs_write_bytes( *file, cpu.getmem( (REG_TYPE) (uint64_t) pvec[ v ].iov_base ), pvec[ v ].iov_len );
+        total += pvec[ v ].iov_len;
+    }
 
-                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
-                pout->stx_blksize = (uint32_t) local_stat.st_blksize;
-                pout->stx_ino = local_stat.st_ino;
-                pout->stx_nlink = local_stat.st_nlink;
-                pout->stx_uid = local_stat.st_uid;
-                pout->stx_gid = local_stat.st_gid;
-                pout->stx_mode = (uint16_t) local_stat.st_mode;
-                pout->stx_size = local_stat.st_size;
-                pout->stx_blocks = local_stat.st_blocks;
-#if defined( __APPLE__ )
-                pout->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
-                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
-                pout->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
-                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
-                pout->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
-                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
-#elif defined( __mc68000__ )
-                pout->stx_atime.tv_sec = local_stat.st_atime;
-                pout->stx_mtime.tv_sec = local_stat.st_mtime;
-                pout->stx_ctime.tv_sec = local_stat.st_ctime;
-#else
-                pout->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
-                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
-                pout->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
-                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
-                pout->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
-                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
-#endif // __APPLE__ || __mc68000__
+    update_result_errno( cpu, (SIGNED_REG_TYPE) total );
+    return true;
+} //vfs_writev
 
-                pout->swap_endianness();
-#endif // SPARCOS
-                tracer.Trace( "  file size %d, isdir %s\n", (int) local_stat.st_size, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
-            }
-            else
-                tracer.Trace( "  fstatat failed, error %d\n", errno );
-#endif // !_WIN32
+// presult is non-0 for _llseek, which also writes the new offset to app memory
 
-            update_result_errno( cpu, result );
-            break;
-        }
-        case SYS_rseq :
-        {
-            errno = EPERM;
-            update_result_errno( cpu, -1 );
-            break;
-        }
-        case SYS_riscv_flush_icache :
+static bool vfs_lseek( CPUClass & cpu, int descriptor, int64_t offset, int origin, int64_t * presult )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
+
+    int64_t position = offset;
+    if ( SEEK_CUR == origin )
+        position += (int64_t) file->offset;
+    else if ( SEEK_END == origin && !file->node->directory )
+        position += (int64_t) file->node->data.size();
+    else if ( SEEK_SET != origin )
+        return vfs_fail( cpu, EINVAL );
+
+    if ( position < 0 )
+        return vfs_fail( cpu, EINVAL );
+
+    file->offset = (uint64_t) position;
+    if ( presult )
+        *presult = swap_endian64( position );
+
+    update_result_errno( cpu, (SIGNED_REG_TYPE) position );
+    return true;
+} //vfs_lseek
+
+// entries are ., .., then the directory's children in sorted order. the file offset is the index of the next entry
+
+static bool vfs_getdents64( CPUClass & cpu, int descriptor, uint8_t * pentries, size_t count )
+{
+    VfsFile * file = vfs_find_file( descriptor );
+    if ( !file )
+        return false;
+
+    if ( !file->node->directory )
+        return vfs_fail( cpu, ENOTDIR );
+
+    vector<pair<string, shared_ptr<VfsNode>>> entries;
+    entries.push_back( make_pair( string( "." ), file->node ) );
+    shared_ptr<VfsNode> parent = vfs_find_node( vfs_parent( file->path ) );
+    entries.push_back( make_pair( string( ".." ), parent ? parent : file->node ) );
+
+    string prefix = file->path + "/";
+    for ( map<string, shared_ptr<VfsNode>>::iterator it = g_vfsNodes.lower_bound( prefix );
+          g_vfsNodes.end() != it && 0 == it->first.compare( 0, prefix.length(), prefix ); it++ )
+    {
+        if ( string::npos == it->first.find( '/', prefix.length() ) )
+            entries.push_back( make_pair( it->first.substr( prefix.length() ), it->second ) );
+    }
+
+    size_t used = 0;
+    while ( file->offset < entries.size() )
+    {
+        const string & name = entries[ (size_t) file->offset ].first;
+        size_t reclen = round_up( offsetof( struct linux_dirent64_syscall, d_name ) + name.length() + 1, (size_t) 8 );
+        if ( reclen > ( count - used ) )
         {
-            assert( false ); // no arm64 equivalent
-            ACCESS_REG( REG_RESULT ) = 0;
+            if ( 0 == used )
+                return vfs_fail( cpu, EINVAL );
             break;
         }
-        case SYS_pselect6:
-        {
-            int nfds = (int) ACCESS_REG( REG_ARG0 );
-            uint64_t readfds = ACCESS_REG( REG_ARG1 );
 
-            if ( 1 == nfds && 0 != readfds )
-            {
-                // check to see if stdin has a keystroke available
+        struct linux_dirent64_syscall * pcur = (struct linux_dirent64_syscall *) ( pentries + used );
+        memset( pcur, 0, reclen );
+        pcur->d_ino = entries[ (size_t) file->offset ].second->ino;
+        pcur->d_off = file->offset + 1;
+        pcur->d_reclen = (uint16_t) reclen;
+        pcur->d_type = entries[ (size_t) file->offset ].second->directory ? 4 : 8; // DT_DIR : DT_REG
+        memcpy( pcur->d_name, name.c_str(), name.length() );
+        pcur->swap_endianness();
 
-                ACCESS_REG( REG_RESULT ) = g_consoleConfig.portable_kbhit();
-                tracer.Trace( "  pselect6 keystroke available on stdin: %llx\n", ACCESS_REG( REG_RESULT ) );
-            }
-            else
-            {
-                // lie and say no I/O is ready
+        used += reclen;
+        file->offset++;
+    }
 
-                ACCESS_REG( REG_RESULT ) = 0;
-            }
+    update_result_errno( cpu, (SIGNED_REG_TYPE) used );
+    return true;
+} //vfs_getdents64
 
-            break;
-        }
-        case SYS_ppoll_time32:
-        {
-            struct pollfd_syscall * pfds = (struct pollfd_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            int nfds = (int) ACCESS_REG( REG_ARG1 );
-            struct timespec_syscall * pts = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-            int * psigmask = (int *) ( ( 0 == ACCESS_REG( REG_ARG3 ) ) ? 0 : cpu.getmem( ACCESS_REG( REG_ARG3 ) ) );
+// T is the host's struct stat or, on Windows, stat_linux_syscall. an empty path means dirfd itself, as with AT_EMPTY_PATH
 
-            tracer.Trace( "  count of file descriptors: %d\n", nfds );
-            for ( int i = 0; i < nfds; i++ )
-                tracer.Trace( "    fd %d: %d\n", i, pfds[ i ].fd );
+template <class T> static bool vfs_stat( int dirfd, const char * path, T & st, int & result )
+{
+    shared_ptr<VfsNode> node;
 
-            // lie and say no I/O is ready
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case emulator_sys_readlink:
-        {
-            // shift the arguments over to make room for dirfd then fall through to readlinkat
+    if ( 0 == path[ 0 ] )
+    {
+        VfsFile * file = vfs_find_file( dirfd );
+        if ( !file )
+            return false;
+        node = file->node;
+    }
+    else
+    {
+        string full;
+        if ( !vfs_resolve( dirfd, path, full ) )
+            return false;
 
-            ACCESS_REG( REG_ARG3 ) = ACCESS_REG( REG_ARG2 );
-            ACCESS_REG( REG_ARG2 ) = ACCESS_REG( REG_ARG1 );
-            ACCESS_REG( REG_ARG1 ) = ACCESS_REG( REG_ARG0 );
-            ACCESS_REG( REG_ARG0 ) = (REG_TYPE) -100;
-            // fall through!
-        }
-        case SYS_readlinkat:
+        node = vfs_find_node( full );
+        if ( !node )
         {
-            int dirfd = (int) ACCESS_REG( REG_ARG0 );
-            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            char * buf = (char *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
-            size_t bufsiz = (size_t) ACCESS_REG( REG_ARG3 );
-            tracer.Trace( "  readlinkat pathname %p == '%s', buf %p, bufsiz %zd, dirfd %d\n", pathname, pathname, buf, bufsiz, dirfd );
-            int result = -1;
-
-#if defined( _WIN32 )
-            errno = EINVAL; // no symbolic links on Windows as far as this emulator is concerned
+            errno = ENOENT;
             result = -1;
-#else
-    #if defined( __APPLE__ )
-            if ( -100 == dirfd )
-                dirfd = -2;
-    #endif //__APPLE__
-            result = readlinkat( dirfd, pathname, buf, bufsiz );
-            tracer.Trace( "  result of readlinkat(): %d, %s\n", result, buf );
-#endif // _WIN32 || __mc68000__
-
-            update_result_errno( cpu, result );
-            break;
+            return true;
         }
-        case SYS_ioctl:
-        {
-            int fd = (int) ACCESS_REG( REG_ARG0 );
-            unsigned long request = (unsigned long) ACCESS_REG( REG_ARG1 ) & 0xffff;
-            tracer.Trace( "  ioctl fd %d, request %lx\n", fd, request );
-            struct local_kernel_termios * pt = (struct local_kernel_termios *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+    }
 
-            if ( 0 == fd || 1 == fd || 2 == fd ) // stdin, stdout, stderr
-            {
-#if defined( _WIN32 ) || defined( __mc68000__ )
-                if ( 0x5401 == request || 0x5408 == request ) // TCGETS. 5401 is newer, 5408 is older like Linux on sparc
-                {
-                    memset( pt, 0, sizeof( *pt ) );
-                    if ( isatty( fd ) )
-                    {
-                        // populate with arbitrary but reasonable values
+    memset( & st, 0, sizeof( st ) );
+    st.st_ino = node->ino;
+    st.st_mode = node->directory ? ( S_IFDIR | 0755 ) : ( S_IFREG | ( node->synthetic ? 0444 : 0644 ) );
+    st.st_nlink = node->directory ? 2 : 1;
+    st.st_size = node->directory ? 4096 : node->data.size();
+    st.st_blksize = 4096;
+    st.st_blocks = ( st.st_size + 511 ) / 512;
+#ifndef _WIN32
+    st.st_uid = getuid();
+    st.st_gid = getgid();
+    st.st_atime = (time_t) node->mtime;
+    st.st_mtime = (time_t) node->mtime;
+    st.st_ctime = (time_t) node->mtime;
+#endif
+    tracer.Trace( "  stat served by the in-memory file system. size %llu, directory %d\n", (uint64_t) st.st_size, node->directory );
+    result = 0;
+    return true;
+} //vfs_stat
 
-                        pt->c_iflag = 0;
-                        pt->c_oflag = 5;
-                        pt->c_cflag = 0xbf;
-                        pt->c_lflag = 0xa30;
-                        pt->swap_endianness();
-                        update_result_errno( cpu, 0 );
-                        break;
-                    }
+static bool vfs_access( CPUClass & cpu, int dirfd, const char * path, int mode )
+{
+    string full;
+    if ( !vfs_resolve( dirfd, path, full ) )
+        return false;
 
-                    errno = ENOTTY;
-                    update_result_errno( cpu, -1 );
-                    break;
-                }
-                else if ( 0x5402 == request )
-                {
-                    // kbhit() works without all this fuss on Windows
-                }
-#else //defined( _WIN32 ) || defined( __mc68000__ )
-                // likely a TCGETS or TCSETS on stdin to check or enable non-blocking reads for a keystroke
+    shared_ptr<VfsNode> node = vfs_find_node( full );
+    if ( !node )
+        return vfs_fail( cpu, ENOENT );
+    if ( node->synthetic && ( mode & 2 ) ) // W_OK
+        return vfs_fail( cpu, EACCES );
 
-                if ( 0x5401 == request || 0x5408 == request ) // TCGETS
-                {
-                    struct termios val;
-                    int result = tcgetattr( fd, &val );
-                    if ( -1 == result )
-                    {
-                        tracer.Trace( "  tcgetattr on fd %d failed, errno %d\n", fd, errno );
-                        update_result_errno( cpu, -1 );
-                        break;
-                    }
-                    tracer.Trace( "  result %d, iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", result, val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
-                    pt->c_iflag = val.c_iflag;
-                    pt->c_oflag = val.c_oflag;
-                    pt->c_cflag = val.c_cflag;
-                    pt->c_lflag = val.c_lflag;
-#ifdef __APPLE__
-                    pt->c_iflag = map_termios_iflag_macos_to_linux( pt->c_iflag );
-                    pt->c_oflag = map_termios_oflag_macos_to_linux( pt->c_oflag );
-                    pt->c_cflag = map_termios_cflag_macos_to_linux( pt->c_cflag );
-                    pt->c_lflag = map_termios_lflag_macos_to_linux( pt->c_lflag );
-                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", pt->c_iflag, pt->c_oflag, pt->c_cflag, pt->c_lflag );
-#else //__APPLE__
-                    pt->c_line = val.c_line;
-                    memcpy( & pt->c_cc, & val.c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
-#endif //__APPLE__
-                    tracer.Trace( "  ioctl queried termios on stdin, sizeof local_kernel_termios %zd, sizeof val %zd\n",
-                                sizeof( struct local_kernel_termios ), sizeof( val ) );
-                }
-                else if ( 0x5402 == request ) // TCSETS
-                {
-                    struct termios val;
-                    memset( &val, 0, sizeof val );
-                    tracer.TraceBinaryData( (uint8_t *) pt, sizeof( struct local_kernel_termios ), 4 );
-                    tracer.Trace( "  oflag %#x OPOST %#x ONLCR %#x OCRNL %#x ONOCR %#x ONLRET %#x\n",
-                                  pt->c_oflag, OPOST, ONLCR, OCRNL, ONOCR, ONLRET );
-                    tracer.Trace( "  iflag %#x IGNBRK %#x BRKINT %#x IGNPAR %#x PARMRK %#x INPCK %#x ISTRIP %#x INLCR %#x IGNCR %#x ICRNL %#x IXON %#x IXOFF %#x IXANY %#x IMAXBEL %#x IUTF8 %#x\n",
-                                  pt->c_iflag, IGNBRK, BRKINT, IGNPAR, PARMRK, INPCK, ISTRIP, INLCR, IGNCR, ICRNL, IXON, IXOFF, IXANY, IMAXBEL, IUTF8 );
-                    tracer.Trace( "  cflag %#x CSIZE %#x, CSTOPB %#x CREAD %#x PARENB %#x PARODD %#x CS5 %#x CS6 %#x CS7 %#x CS8 %#x HUPCL %#x CLOCAL %#x\n",
-                                  CSIZE, CSTOPB, CREAD, PARENB, PARODD, CS5, CS6, CS7, CS8, HUPCL, CLOCAL );
-#ifdef sparc
-                    tracer.Trace( "  lflag %#x ECHOKE %#x ECHOE %#x ECHOK %#x ECHO %#x ECHONL %#x ECHOPRT %#x ECHOCTL %#x ICANON %#x ISIG %#x IEXTEN %#x TOSTOP %#x\n",
-                                  ECHOKE, ECHOE, ECHOK, ECHO, ECHONL, ECHOPRT, ECHOCTL, ICANON, ISIG, IEXTEN, TOSTOP );
-#else
-                    tracer.Trace( "  lflag %#x ECHOKE %#x ECHOE %#x ECHOK %#x ECHO %#x ECHONL %#x ECHOPRT %#x ECHOCTL %#x ICANON %#x ISIG %#x IEXTEN %#x EXTPROC %#x TOSTOP %#x\n",
-                                  ECHOKE, ECHOE, ECHOK, ECHO, ECHONL, ECHOPRT, ECHOCTL, ICANON, ISIG, IEXTEN, EXTPROC, TOSTOP );
-#endif
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_access
 
-                    val.c_iflag = pt->c_iflag;
-                    val.c_oflag = pt->c_oflag;
-                    val.c_cflag = pt->c_cflag;
-                    val.c_lflag = pt->c_lflag;
-                    tracer.Trace( "  iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
-#ifdef __APPLE__
-                    val.c_iflag = map_termios_iflag_linux_to_macos( val.c_iflag );
-                    val.c_oflag = map_termios_oflag_linux_to_macos( val.c_oflag );
-                    val.c_cflag = map_termios_cflag_linux_to_macos( val.c_cflag );
-                    val.c_lflag = map_termios_lflag_linux_to_macos( val.c_lflag );
-                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
-#else //__APPLE__
-                    val.c_line = pt->c_line;
-                    memcpy( & val.c_cc, & pt->c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
-#endif //__APPLE__
-                    tracer.TraceBinaryData( (uint8_t *) &val, sizeof( struct termios ), 4 );
-                    tcsetattr( 0, TCSANOW, &val );
-                    tracer.Trace( "  ioctl set termios on stdin\n" );
-                }
-#endif //defined( _WIN32 ) || defined( __mc68000__ )
-            }
-            else if ( 1 == fd ) // stdout
-            {
-                if ( 0x5401 == request || 0x5408 == request ) // TCGETS
-                {
-#if defined( _WIN32 ) || defined( __mc68000__ ) || defined( sparc )
-                    if ( isatty( fd ) )
-                        update_result_errno( cpu, 0 );
-                    else
-                        update_result_errno( cpu, -1 );
+// relative paths that leave the overlay while the current directory is in it are still passed to the host as-is
 
-                    break;
-#else //defined( _WIN32 ) || defined( __mc68000__ )
-                    struct termios val;
-                    int result = tcgetattr( fd, &val );
-                    tracer.Trace( "  result: %d, iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", result, val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
-                    if ( -1 == result )
-                    {
-                        update_result_errno( cpu, -1 );
-                        break;
-                    }
-                    pt->c_iflag = val.c_iflag;
-                    pt->c_oflag = val.c_oflag;
-                    pt->c_cflag = val.c_cflag;
-                    pt->c_lflag = val.c_lflag;
-#ifdef __APPLE__
-                    pt->c_iflag = map_termios_iflag_macos_to_linux( pt->c_iflag );
-                    pt->c_oflag = map_termios_oflag_macos_to_linux( pt->c_oflag );
-                    pt->c_cflag = map_termios_cflag_macos_to_linux( pt->c_cflag );
-                    pt->c_lflag = map_termios_lflag_macos_to_linux( pt->c_lflag );
-                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", pt->c_iflag, pt->c_oflag, pt->c_cflag, pt->c_lflag );
-#else //__APPLE__
-                    pt->c_line = val.c_line;
-                    memcpy( & pt->c_cc, & val.c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
-#endif //__APPLE__
-                    tracer.Trace( "  ioctl queried termios on stdout, sizeof local_kernel_termios %zd, sizeof val %zd\n",
-                                sizeof( struct local_kernel_termios ), sizeof( val ) );
-#endif //defined( _WIN32 ) || defined( __mc68000__ )
-                }
+static bool vfs_chdir( CPUClass & cpu, const char * path )
+{
+    string full;
+    if ( !vfs_resolve( -100, path, full ) )
+    {
+        g_vfsCwd.clear();
+        return false;
+    }
 
-            }
+    shared_ptr<VfsNode> node = vfs_find_node( full );
+    if ( !node )
+        return vfs_fail( cpu, ENOENT );
+    if ( !node->directory )
+        return vfs_fail( cpu, ENOTDIR );
 
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case SYS_set_tid_address:
-        {
-            ACCESS_REG( REG_RESULT ) = 1;
-            break;
-        }
-        case SYS_madvise:
-        {
-            ACCESS_REG( REG_RESULT ) = 0; // report success
-            break;
-        }
-        case SYS_set_robust_list:
-        case SYS_prlimit64:
-        case SYS_mprotect:
-            // ignore for now
-            break;
+    g_vfsCwd = full;
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_chdir
 
-#endif // !defined(OLDGCC)
-        case SYS_faccessat:
-        {
-            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
-            tracer.Trace( "  faccessat failing for path %s\n", pathname );
+static bool vfs_getcwd( CPUClass & cpu, char * pbuf, size_t size )
+{
+    if ( g_vfsCwd.empty() )
+        return false;
 
-            errno = 2; // not found
-            update_result_errno( cpu, -1 );
-            break;
-        }
-        case SYS_getuid:
-        case SYS_geteuid:
-        case SYS_getgid:
-        case SYS_getegid:
-        {
-            update_result_errno( cpu, 0x5549 ); // IU. Love wins all.
-            break;
-        }
-        default:
-        {
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-            printf( "error; ecall invoked with unknown command %u = %#x, a0 %#x, a1 %#x, a2 %#x\n",
-                    syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
-            tracer.Trace( "error; ecall invoked with unknown command %u = %#x, a0 %#x, a1 %#x, a2 %#x\n",
-                          syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
-#else
-            printf( "error; ecall invoked with unknown command %llu = %llx, a0 %#llx, a1 %#llx, a2 %#llx\n",
-                    syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
-            tracer.Trace( "error; ecall invoked with unknown command %llu = %llx, a0 %#llx, a1 %#llx, a2 %#llx\n",
-                          syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
-#endif
-            fflush( stdout );
-            //ACCESS_REG( REG_RESULT ] = -1;
-        }
-    }
-} //emulator_invoke_svc
+    if ( size <= g_vfsCwd.length() )
+        return vfs_fail( cpu, ERANGE );
 
-#ifdef SPARCOS
+    strcpy( pbuf, g_vfsCwd.c_str() );
+    update_result_errno( cpu, ACCESS_REG( REG_ARG0 ) );
+    return true;
+} //vfs_getcwd
 
-#pragma warning(disable: 4127) // conditional expression is constant
+// the overlay has no symbolic links
 
-void emulator_invoke_sparc_trap5( Sparc & cpu ) // called for trap #5 overflow of register window from save instrution
+static bool vfs_readlink( CPUClass & cpu, int dirfd, const char * path )
 {
-    // copy the register window that's marked as invalid / in-use to the memory location pointed to by the stack pointer o6 / 14 in the target register window
+    string full;
+    if ( !vfs_resolve( dirfd, path, full ) )
+        return false;
 
-    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // once because we're handling a trap
-    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // again for the nested save
+    return vfs_fail( cpu, vfs_find_node( full ) ? EINVAL : ENOENT );
+} //vfs_readlink
 
-    if ( 0 == cpu.Sparc_reg( 14 ) )
-        emulator_hard_termination( cpu, "sp is 0 in overflow trap from a save instruction", cpu.pc );
+static bool vfs_mkdir( CPUClass & cpu, int dirfd, const char * path )
+{
+    string full;
+    if ( !vfs_resolve( dirfd, path, full ) )
+        return false;
 
-    memcpy( cpu.getmem( cpu.Sparc_reg( 14 ) ), & cpu.Sparc_reg( 16 ), 64 ); // spill
+    if ( vfs_find_node( full ) )
+        return vfs_fail( cpu, EEXIST );
 
-    #ifndef NDEBUG
-    memset( & cpu.Sparc_reg( 16 ), 0, 64 ); // the register window can be trashed at this point. validate this is true in debug builds.
-    #endif
+    shared_ptr<VfsNode> parent = vfs_find_node( vfs_parent( full ) );
+    if ( !parent )
+        return vfs_fail( cpu, ENOENT );
+    if ( !parent->directory )
+        return vfs_fail( cpu, ENOTDIR );
 
-    //tracer.Trace( "  sp being spilled to: %#x from register address %p, cwp:%u\n", cpu.Sparc_reg( 14 ), & cpu.Sparc_reg( 16 ), cpu.get_cwp() );
-    //tracer.TraceBinaryData( cpu.getmem( cpu.Sparc_reg( 14 ) ), 64, 4 );
+    g_vfsNodes[ full ] = vfs_new_node( true );
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_mkdir
 
-    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) );
+static bool vfs_unlink( CPUClass & cpu, int dirfd, const char * path, bool removedir )
+{
+    string full;
+    if ( !vfs_resolve( dirfd, path, full ) )
+        return false;
 
-    // update the wim for the current register window to be valid so when save is retried it doesn't trap and
-    // the window following cwp_new to in-use, so subsequent SAVE instructions will spill it
+    shared_ptr<VfsNode> node = vfs_find_node( full );
+    if ( !node )
+        return vfs_fail( cpu, ENOENT );
+    if ( node->synthetic )
+        return vfs_fail( cpu, EACCES );
 
-    cpu.wim = ( cpu.wim << ( cpu.NWINDOWS - 1 ) ) | ( cpu.wim >> 1 );
-    if ( 32 != cpu.NWINDOWS )
-        cpu.wim &= ( ( 1 << cpu.NWINDOWS ) - 1 ); // mask off unused high bits
+    if ( removedir )
+    {
+        if ( !node->directory )
+            return vfs_fail( cpu, ENOTDIR );
+        if ( vfs_is_mount( full ) )
+            return vfs_fail( cpu, EBUSY );
+        if ( vfs_has_children( full ) )
+            return vfs_fail( cpu, ENOTEMPTY );
+    }
+    else if ( node->directory )
+        return vfs_fail( cpu, EISDIR );
 
-    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // the equivalent of a RETT instruction
-} //emulator_invoke_sparc_trap5
+    g_vfsNodes.erase( full );
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_unlink
 
-void emulator_invoke_sparc_trap6( Sparc & cpu ) // called for trap #6 underflow of register window from restore instruction
+static bool vfs_rename( CPUClass & cpu, int olddirfd, const char * oldpath, int newdirfd, const char * newpath )
 {
-    // copy the register window that's marked as invalid / in-use from the current memory location pointed to by the stack pointer o6 / 14 in the target register window
-    // note: offsetting next_save and next_restore calls are #ifdef'ed out for performance
+    string from, to;
+    bool fromOverlay = vfs_resolve( olddirfd, oldpath, from );
+    bool toOverlay = vfs_resolve( newdirfd, newpath, to );
+    if ( !fromOverlay && !toOverlay )
+        return false;
 
-#if CWP_REALITY // this isn't defined but could be to match what would happen in an actual handler
-    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // because we're handling a trap
-    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // restore twice to point at the frame to restore
-#endif
-    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) );
+    if ( fromOverlay != toOverlay )
+        return vfs_fail( cpu, EXDEV );
 
-    if ( 0 == cpu.Sparc_reg( 14 ) )
-        emulator_hard_termination( cpu, "sp is 0 in underflow trap from a restore instruction", cpu.get_cwp() );
+    shared_ptr<VfsNode> node = vfs_find_node( from );
+    if ( !node )
+        return vfs_fail( cpu, ENOENT );
+    if ( node->synthetic || vfs_is_mount( from ) )
+        return vfs_fail( cpu, EBUSY );
 
-    memcpy( & cpu.Sparc_reg( 16 ), cpu.getmem( cpu.Sparc_reg( 14 ) ), 64 ); // unspill
+    if ( from == to )
+    {
+        update_result_errno( cpu, 0 );
+        return true;
+    }
 
-    //tracer.Trace( "  sp being unspilled from: %#x to register address %p, cwp:%u\n", cpu.Sparc_reg( 14 ), & cpu.Sparc_reg( 16 ), cpu.get_cwp() );
-    //tracer.TraceBinaryData( cpu.getmem( cpu.Sparc_reg( 14 ) ), 64, 4 );
+    if ( 0 == to.compare( 0, from.length() + 1, from + "/" ) )
+        return vfs_fail( cpu, EINVAL ); // can't move a directory into itself
 
-    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // restore the original cwp
-#if CWP_REALITY
-    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) );
-#endif
+    shared_ptr<VfsNode> parent = vfs_find_node( vfs_parent( to ) );
+    if ( !parent || !parent->directory )
+        return vfs_fail( cpu, ENOENT );
 
-    cpu.wim = ( cpu.wim >> ( cpu.NWINDOWS - 1 ) ) | ( cpu.wim << 1 );
-    if ( 32 != cpu.NWINDOWS )
-        cpu.wim &= ( ( 1 << cpu.NWINDOWS ) - 1 ); // mask off unused high bits
+    shared_ptr<VfsNode> target = vfs_find_node( to );
+    if ( target )
+    {
+        if ( target->synthetic || vfs_is_mount( to ) )
+            return vfs_fail( cpu, EBUSY );
+        if ( target->directory && !node->directory )
+            return vfs_fail( cpu, EISDIR );
+        if ( !target->directory && node->directory )
+            return vfs_fail( cpu, ENOTDIR );
+        if ( vfs_has_children( to ) )
+            return vfs_fail( cpu, ENOTEMPTY );
+    }
 
-#if CWP_REALITY
-    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // the equivalent of a RETT instruction
-#endif
-} //emulator_invoke_sparc_trap6
+    // move the node and, for directories, everything below it
 
-#endif //SPARCOS
+    vector<string> moving;
+    string prefix = from + "/";
+    moving.push_back( from );
+    for ( map<string, shared_ptr<VfsNode>>::iterator it = g_vfsNodes.lower_bound( prefix );
+          g_vfsNodes.end() != it && 0 == it->first.compare( 0, prefix.length(), prefix ); it++ )
+        moving.push_back( it->first );
 
-#ifdef M68
+    for ( size_t i = 0; i < moving.size(); i++ )
+    {
+        shared_ptr<VfsNode> n = g_vfsNodes[ moving[ i ] ];
+        g_vfsNodes.erase( moving[ i ] );
+        g_vfsNodes[ to + moving[ i ].substr( from.length() ) ] = n;
+    }
 
-// called when trap #15 is invoked for an IDE68K emulator system call
-// hard-code register values because they differ from linux syscall calling convention
+    for ( size_t i = 0; i < g_vfsFiles.size(); i++ )
+    {
+        string & p = g_vfsFiles[ i ].path;
+        if ( ( p == from ) || ( 0 == p.compare( 0, prefix.length(), prefix ) ) )
+            p = to + p.substr( from.length() );
+    }
 
-void emulator_invoke_68k_trap15( m68000 & cpu )
+    update_result_errno( cpu, 0 );
+    return true;
+} //vfs_rename
+
+// creates any missing directories from the mount point down to full
+
+static void vfs_make_directories( const string & full )
 {
-    uint16_t svc = cpu.getui16( cpu.pc + 2 ); // two bytes that are two bytes past the trap instruction
-    tracer.Trace( "68k trap 15: svc %u, reg0 %x\n", svc, ACCESS_REG( 0 ) );
+    for ( size_t slash = full.find( '/', 1 ); ; slash = full.find( '/', slash + 1 ) )
+    {
+        string dir = full.substr( 0, slash );
+        if ( vfs_in_mount( dir ) && !vfs_find_node( dir ) )
+            g_vfsNodes[ dir ] = vfs_new_node( true );
 
-    switch( svc )
+        if ( string::npos == slash )
+            break;
+    }
+} //vfs_make_directories
+
+static bool vfs_read_host_file( const char * host, vector<uint8_t> & data )
+{
+    FILE * fp = fopen( host, "rb" );
+    if ( !fp )
+        return false;
+
+    fseek( fp, 0, SEEK_END );
+    long length = ftell( fp );
+    fseek( fp, 0, SEEK_SET );
+    data.resize( ( length > 0 ) ? (size_t) length : 0 );
+    bool ok = ( length >= 0 ) && ( data.size() == fread( data.data(), 1, data.size(), fp ) );
+    fclose( fp );
+    return ok;
+} //vfs_read_host_file
+
+static bool vfs_preload_directory( const string & host, const string & app )
+{
+    vfs_make_directories( app );
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd = {0};
+    HANDLE hFind = FindFirstFileA( ( host + "\\*.*" ).c_str(), &fd );
+    if ( INVALID_HANDLE_VALUE == hFind )
+        return false;
+
+    bool ok = true;
+    do
     {
-        case 0: // exit
+        string name = fd.cFileName;
+        if ( "." == name || ".." == name )
+            continue;
+
+        if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
+            ok = vfs_preload_directory( host + "\\" + name, app + "/" + name );
+        else
         {
-            g_terminate = true;
-            cpu.end_emulation();
-            g_exit_code = (int) ACCESS_REG( 0 );
-            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
-            break;
+            shared_ptr<VfsNode> node = vfs_new_node( false );
+            ok = vfs_read_host_file( ( host + "\\" + name ).c_str(), node->data );
+            g_vfsNodes[ app + "/" + name ] = node;
         }
-        case 1: // putch
+    } while ( ok && FindNextFileA( hFind, &fd ) );
+
+    FindClose( hFind );
+    return ok;
+#else
+    DIR * dir = opendir( host.c_str() );
+    if ( !dir )
+        return false;
+
+    bool ok = true;
+    struct dirent * pent;
+    while ( ok && ( 0 != ( pent = readdir( dir ) ) ) )
+    {
+        string name = pent->d_name;
+        if ( "." == name || ".." == name )
+            continue;
+
+        struct stat st;
+        string hostPath = host + "/" + name;
+        if ( 0 != stat( hostPath.c_str(), &st ) )
+            continue; // e.g. a dangling symbolic link
+
+        if ( S_ISDIR( st.st_mode ) )
+            ok = vfs_preload_directory( hostPath, app + "/" + name );
+        else if ( S_ISREG( st.st_mode ) )
         {
-            uint8_t val = (uint8_t) ACCESS_REG( 0 );
-            SetBinaryMode bm( 10 == val );
-            size_t written = write( 1, &val, 1 );
-            update_result_errno( cpu, (REG_TYPE) written );
-            break;
+            shared_ptr<VfsNode> node = vfs_new_node( false );
+            ok = vfs_read_host_file( hostPath.c_str(), node->data );
+            node->mtime = (uint64_t) st.st_mtime;
+            g_vfsNodes[ app + "/" + name ] = node;
         }
-        default:
+    }
+
+    closedir( dir );
+    return ok;
+#endif
+} //vfs_preload_directory
+
+// ustar archives with regular files and directories. other entry types, including GNU long names, are skipped
+
+static bool vfs_preload_archive( const string & host, const string & app )
+{
+    vector<uint8_t> tar;
+    if ( !vfs_read_host_file( host.c_str(), tar ) )
+        return false;
+
+    size_t position = 0;
+    while ( position + 512 <= tar.size() )
+    {
+        const char * header = (const char *) tar.data() + position;
+        if ( 0 == header[ 0 ] )
+            break; // end-of-archive blocks are zero-filled
+
+        string name( header, strnlen( header, 100 ) );
+        if ( !memcmp( header + 257, "ustar", 5 ) && header[ 345 ] )
+            name = string( header + 345, strnlen( header + 345, 155 ) ) + "/" + name;
+
+        char acSize[ 13 ] = {0};
+        memcpy( acSize, header + 124, 12 );
+        size_t size = (size_t) strtoull( acSize, 0, 8 );
+        char type = header[ 156 ];
+        position += 512;
+
+        if ( size > tar.size() - position )
+            return false;
+
+        string full;
+        vfs_full_path( -1, ( app + "/" + name ).c_str(), full );
+        if ( vfs_in_mount( full ) )
         {
-            tracer.Trace( "unimplemented 68k trap #15 service %u\n", svc );
-            break;
+            if ( '5' == type )
+                vfs_make_directories( full );
+            else if ( '0' == type || 0 == type )
+            {
+                vfs_make_directories( vfs_parent( full ) );
+                shared_ptr<VfsNode> node = vfs_new_node( false );
+                node->data.assign( tar.begin() + position, tar.begin() + position + size );
+                node->mtime = strtoull( string( header + 136, 12 ).c_str(), 0, 8 );
+                g_vfsNodes[ full ] = node;
+            }
         }
+
+        position += round_up( size, (size_t) 512 );
     }
-} //emulator_invoke_68k_trap15
 
-#pragma pack( push, 1 )
+    return true;
+} //vfs_preload_archive
 
-struct IOParam
+// spec is P or P=D where P is the app's absolute mount path and D is a host directory or tar archive to preload
+
+static bool vfs_mount( const char * spec )
 {
-    uint32_t qLink; // pointer
-    int16_t qType; 
-    int16_t ioTrap; 
-    uint32_t ioCmdAddr; // pointer
-    uint32_t ioCompletion; // pointer
-    int16_t ioResult; 
-    uint32_t ioNamePtr; // pointer
-    int16_t ioVRefNum;
-    int16_t ioRefNum;
-    char ioVersNum;
-    char ioPermssn;
-    uint32_t ioMisc; // pointer
-    uint32_t ioBuffer; // pointer
-    int32_t ioReqCount;
-    int32_t ioActCount;
-    int16_t ioPosMode;
-    int32_t ioPosOffset;
+    vfs_initialize();
 
-    void swap_endianness()
+    string app( spec ), host;
+    size_t equals = app.find( '=' );
+    if ( string::npos != equals )
     {
-        qLink = swap_endian32( qLink );
-        qType = swap_endian16( qType );
-        ioTrap = swap_endian16( ioTrap );
-        ioCmdAddr = swap_endian32( ioCmdAddr );
-        ioCompletion = swap_endian32( ioCompletion );
-        ioResult = swap_endian16( ioResult );
-        ioNamePtr = swap_endian32( ioNamePtr );
-        ioVRefNum = swap_endian16( ioVRefNum );
-        ioRefNum = swap_endian16( ioRefNum );
-        ioMisc = swap_endian32( ioMisc );
-        ioBuffer = swap_endian32( ioBuffer );
-        ioReqCount = swap_endian32( ioReqCount );
-        ioActCount = swap_endian32( ioActCount );
-        ioPosMode = swap_endian16( ioPosMode );
-        ioPosOffset = swap_endian32( ioPosOffset );
+        host = app.substr( equals + 1 );
+        app.erase( equals );
     }
 
-    void trace()
+    string full;
+    if ( ( '/' != app[ 0 ] ) || !vfs_full_path( -1, app.c_str(), full ) || ( "/" == full ) )
+        return false;
+
+    g_vfsMounts.push_back( full );
+    tracer.Trace( "in-memory file system mounted at '%s', preloaded from '%s'\n", full.c_str(), host.c_str() );
+
+    if ( host.empty() )
     {
-        tracer.Trace( "  IOParam:\n" );
-        tracer.Trace( "    qLink %#x\n", qLink );
-        tracer.Trace( "    qType %#x\n", qType );
-        tracer.Trace( "    ipTrap %#x\n", ioTrap );
-        tracer.Trace( "    ioCmdAdddr %#x\n", ioCmdAddr );
-        tracer.Trace( "    ioCompletion %#x\n", ioCompletion );
-        tracer.Trace( "    ioResult %#x\n", ioResult );
-        tracer.Trace( "    ioNamePtr %#x\n", ioNamePtr  );
-        tracer.Trace( "    ioVRefNum %#x\n", ioVRefNum );
-        tracer.Trace( "    ioRefNum %#x\n", ioRefNum );
-        tracer.Trace( "    ioVersNum %#x\n", ioVersNum );
-        tracer.Trace( "    ioPermssn %#x\n", ioPermssn );
-        tracer.Trace( "    ioMisc %#x\n", ioMisc );
-        tracer.Trace( "    ioBuffer %#x\n", ioBuffer );
-        tracer.Trace( "    ioReqCount %#x\n", ioReqCount  );
-        tracer.Trace( "    ioActCount %#x\n", ioActCount );
-        tracer.Trace( "    ioPosMode %#x\n", ioPosMode );
-        tracer.Trace( "    ioPosOffset %#x\n", ioPosOffset );
+        vfs_make_directories( full );
+        return true;
     }
-};
 
-#pragma pack(pop)
+    struct stat st;
+    if ( 0 != stat( host.c_str(), &st ) )
+        return false;
 
-#define macos_trapa_async 0x0400
+    if ( S_IFDIR == ( st.st_mode & S_IFMT ) )
+        return vfs_preload_directory( host, full );
 
-#define macos_trapa_open 0
-#define macos_trapa_close 1
-#define macos_trapa_read 2
-#define macos_trapa_write 3
-#define macos_trapa_exittoshell 0x9f4
+    vfs_make_directories( full );
+    return vfs_preload_archive( host, full );
+} //vfs_mount
 
-#define macos_trapa_control 4
+#ifdef X64OS_LIBRARY
 
-void emulator_invoke_68k_trap10( m68000 & cpu, uint16_t op )
+static void vfs_reset()
 {
-    tracer.Trace( "68k a-line trap: op: %x\n", op );
+    for ( size_t i = 0; i < g_vfsFiles.size(); i++ )
+        close( g_vfsFiles[ i ].descriptor );
 
-    if ( macos_trapa_async & op )
+    g_vfsFiles.clear();
+    g_vfsNodes.clear();
+    g_vfsMounts.clear();
+    g_vfsNextIno = 0;
+    g_vfsDiscardWrites = false;
+    g_vfsCwd.clear();
+} //vfs_reset
+
+#endif
+
+#if !defined( _WIN32 ) && !defined( OLDGCC )
+
+// getdents and getdents64 keep a DIR stream per descriptor so nested and interleaved directory walks
+// each keep their own position. closedir() closes the descriptor too, so close() goes through here.
+
+struct DirStream
+{
+    int descriptor;
+    DIR * dir;
+};
+
+static EMULATOR_THREAD_LOCAL vector<DirStream> g_dirStreams;
+
+static DIR * find_dir_stream( int descriptor, bool create )
+{
+    for ( size_t i = 0; i < g_dirStreams.size(); i++ )
+        if ( descriptor == g_dirStreams[ i ].descriptor )
+            return g_dirStreams[ i ].dir;
+
+    if ( !create )
+        return 0;
+
+    DIR * dir = fdopendir( descriptor );
+    if ( 0 != dir )
     {
-        tracer.Trace( "asynchronous calls aren't supported\n" );
-        ACCESS_REG( 0 ) = EINVAL;
+        DirStream ds = { descriptor, dir };
+        g_dirStreams.push_back( ds );
     }
 
-    switch( op & 0xbff )
+    return dir;
+} //find_dir_stream
+
+static bool close_dir_stream( int descriptor )
+{
+    for ( size_t i = 0; i < g_dirStreams.size(); i++ )
     {
-        case macos_trapa_write:
+        if ( descriptor == g_dirStreams[ i ].descriptor )
         {
-            IOParam * p = (IOParam *) cpu.getmem( cpu.aregs[ 0 ] );
-            IOParam local = *p;
-            local.swap_endianness();
-            //local.trace();
-            tracer.Trace( "  ioRefNum: %x, ioReqCount %x, ioBuffer %x, ioPosMode %x\n", local.ioRefNum, local.ioReqCount, local.ioBuffer, local.ioPosMode );
-            if ( 1 == local.ioRefNum || 2 == local.ioRefNum ) // stdout / stderr
-                tracer.Trace( "  writing '%.*s'\n", (int) local.ioReqCount, cpu.getmem( local.ioBuffer ) );
-            tracer.TraceBinaryData( cpu.getmem( local.ioBuffer ), (uint32_t) local.ioReqCount, 4 );
+            closedir( g_dirStreams[ i ].dir );
+            g_dirStreams.erase( g_dirStreams.begin() + i );
+            return true;
+        }
+    }
 
-            int written;
+    return false;
+} //close_dir_stream
 
-#ifdef _WIN32
-            written = WinWrite( local.ioRefNum, cpu.getmem( local.ioBuffer ), (int) local.ioReqCount );
-#else
-            written = write( local.ioRefNum, cpu.getmem( local.ioBuffer ), (int) local.ioReqCount );
-#endif
+// write as many entries as fit into the app's buffer. an entry that doesn't fit is left for the next call.
+// returns the number of bytes written, 0 at the end of the directory, or -1 with errno set.
 
-            p->ioActCount = swap_endian32( written );
-            ACCESS_REG( 0 ) = 0;
+static int fill_dir_entries( DIR * dir, uint8_t * pentries, size_t count, bool dirent64 )
+{
+    size_t used = 0;
+
+    while ( used < count )
+    {
+        long pos = telldir( dir );
+        errno = 0;
+        struct dirent * pent = readdir( dir );
+        if ( 0 == pent )
+        {
+            if ( ( 0 != errno ) && ( 0 == used ) )
+                return -1;
             break;
         }
-        case macos_trapa_exittoshell:
+
+        size_t len = strlen( pent->d_name );
+        size_t reclen;
+        if ( dirent64 )
+            reclen = round_up( offsetof( struct linux_dirent64_syscall, d_name ) + len + 1, (size_t) 8 );
+        else
+            reclen = round_up( offsetof( struct linux_dirent_syscall, d_name ) + len + 2, sizeof( REG_TYPE ) ); // null + type
+
+        if ( reclen > ( count - used ) )
         {
-            g_terminate = true;
-            cpu.end_emulation();
-            g_exit_code = (int) ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
+            seekdir( dir, pos );
+            if ( 0 == used )
+            {
+                errno = EINVAL;
+                return -1;
+            }
             break;
         }
-        default:
+
+        uint8_t * prec = pentries + used;
+        memset( prec, 0, reclen );
+
+        if ( dirent64 )
         {
-            tracer.Trace( "unimplemented 68k trap #10 op %x\n", op );
-            ACCESS_REG( 0 ) = EINVAL;
-            break;
+            struct linux_dirent64_syscall * pcur = (struct linux_dirent64_syscall *) prec;
+            pcur->d_ino = pent->d_ino;
+            pcur->d_off = telldir( dir );
+            pcur->d_reclen = (uint16_t) reclen;
+            pcur->d_type = pent->d_type;
+            memcpy( pcur->d_name, pent->d_name, len );
+            pcur->swap_endianness();
         }
+        else
+        {
+            struct linux_dirent_syscall * pcur = (struct linux_dirent_syscall *) prec;
+            pcur->d_ino = (uint32_t) pent->d_ino;
+            pcur->d_off = (uint32_t) telldir( dir );
+            pcur->d_reclen = (uint16_t) reclen;
+            pcur->settype( pent->d_type );
+            memcpy( pcur->d_name, pent->d_name, len );
+            pcur->swap_endianness();
+        }
+
+        tracer.Trace( "  entry '%s' at offset %zd, d_reclen %zd, d_type %#x\n", pent->d_name, used, reclen, pent->d_type );
+        used += reclen;
     }
-} //emulator_invoke_68k_trap10
 
-#endif
+    return (int) used;
+} //fill_dir_entries
 
-#ifdef RVOS
-static const char * riscv_register_names[ 32 ] =
-{
-    "zero", "ra", "sp",  "gp",  "tp", "t0", "t1", "t2",
-    "s0",   "s1", "a0",  "a1",  "a2", "a3", "a4", "a5",
-    "a6",   "a7", "s2",  "s3",  "s4", "s5", "s6", "s7",
-    "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6",
-};
 #endif
 
-#ifdef X64OS
-static const char * x64_register_names[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+#ifdef __mc68000__
+extern "C" long syscall( long number, ... );
 #endif
 
-#ifdef X32OS
-static const char * x32_register_names[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi" };
-#endif
+// this is called when the arm64 app has an svc #0 instruction or a RISC-V 64 app has an ecall instruction
+// https://thevivekpandey.github.io/posts/2017-09-25-linux-system-calls.html
 
-#ifdef SPARCOS
-static const char * sparc_register_names[ 32 ] =
-{
-    "g0", "g1", "g2", "g3", "g4", "g5", "g6", "g7",
-    "o0", "o1", "o2", "o3", "o4", "o5", "sp", "o7",
-    "l0", "l1", "l2", "l3", "l4", "l5", "l6", "l7",
-    "i0", "i1", "i2", "i3", "i4", "i5", "fp", "i7",
-};
-#endif
+#pragma warning(disable: 4189) // unreferenced local variable
 
-void emulator_hard_termination( CPUClass & cpu, const char *pcerr, uint64_t error_value )
+void emulator_invoke_svc( CPUClass & cpu )
 {
-    g_consoleConfig.RestoreConsole( false );
-
-    printf( "hard termination!!!\n" );
-
-    tracer.Trace( "%s (%s) fatal error: %s %0llx\n", APP_NAME, target_platform(), pcerr, error_value );
-    printf( "%s (%s) fatal error: %s %0llx\n", APP_NAME, target_platform(), pcerr, error_value );
-
-    uint64_t offset = 0;
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-    uint32_t offset32 = 0;
-    const char * psymbol = emulator_symbol_lookup( REG_PC, offset32 );
-    offset = offset32;
+#ifdef _WIN32
+    static HANDLE g_hFindFirst = INVALID_HANDLE_VALUE; // for enumerating directories. Only one can be active at once.
+    static char g_acFindFirstPattern[ EMULATOR_MAX_PATH ];
+    char acPath[ EMULATOR_MAX_PATH ];
 #else
-    const char * psymbol = emulator_symbol_lookup( REG_PC, offset );
 #endif
 
-    if ( psymbol[ 0 ] )
+#ifdef X64OS_LIBRARY
+    if ( g_syscallOverride )
     {
-        tracer.Trace( "pc: %llx %s + %llx\n", REG_PC, psymbol, offset );
-        printf( "pc: %llx %s + %llx\n", (uint64_t) REG_PC, psymbol, offset );
+        uint64_t args[ 6 ] = { ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ),
+                               ACCESS_REG( REG_ARG3 ), ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) };
+        int64_t result = 0;
+        if ( g_syscallOverride( g_syscallOverrideContext, ACCESS_REG( REG_SYSCALL ), args, result ) )
+        {
+            tracer.Trace( "  syscall %llu handled by the library caller, result %lld\n", (uint64_t) ACCESS_REG( REG_SYSCALL ), result );
+            ACCESS_REG( REG_RESULT ) = (REG_TYPE) result;
+            return;
+        }
     }
-    else
+#endif
+
+    REG_TYPE syscall_id = ACCESS_REG( REG_SYSCALL );
+
+#ifdef SPARCOS
+    cpu.setflag_c( 0 ); // Linux on Sparc uses the carry flag in addition to the result register to indicate success/failure
+    syscall_id = MapSparcToRiscV( syscall_id );
+    tracer.Trace( "mapped sparc syscall %u to %u\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
+    if ( 0 == syscall_id )
     {
-        tracer.Trace( "pc: %llx\n", REG_PC );
-        printf( "pc: %llx\n", (uint64_t) REG_PC );
+        printf( "unable to find a Sparc mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
+        tracer.Trace( "unable to find a Sparc mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
+    }
+#elif defined( X64OS )
+    syscall_id = MapX64ToRiscV( syscall_id );
+    tracer.Trace( "mapped x64 syscall %llu to %llu\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
+    if ( 0 == syscall_id )
+    {
+        printf( "unable to find an X64 mapping for syscall %llu\n", ACCESS_REG( REG_SYSCALL ) );
+        tracer.Trace( "unable to find an X64 mapping for syscall %llu\n", ACCESS_REG( REG_SYSCALL ) );
+    }
+#elif defined( X32OS )
+    syscall_id = MapX32ToRiscV( syscall_id );
+    tracer.Trace( "mapped x32 syscall %u to %u\n", ACCESS_REG( REG_SYSCALL ), syscall_id );
+    if ( 0 == syscall_id )
+    {
+        printf( "unable to find an X32 mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
+        tracer.Trace( "unable to find an X32 mapping for syscall %u\n", ACCESS_REG( REG_SYSCALL ) );
     }
+#endif
 
-    tracer.Trace( "address space %llx to %llx\n", (uint64_t) g_base_address, (uint64_t) g_base_address + memory.size() );
-    printf( "address space %llx to %llx\n", (uint64_t) g_base_address, (uint64_t) g_base_address + memory.size() );
+    // Linux syscalls support up to 6 arguments
 
-    tracer.Trace( "  " );
-    printf( "  " );
+    if ( tracer.IsEnabled() )
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+        tracer.Trace( "syscall %s %x = %d, arg0 %x, arg1 %x, arg2 %x, arg3 %x, arg4 %x, arg5 %x\n",
+                      lookup_syscall( syscall_id ), syscall_id, syscall_id,
+                      ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ), ACCESS_REG( REG_ARG3 ),
+                      ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) );
+#else
+        tracer.Trace( "syscall %s %llx = %lld, arg0 %llx, arg1 %llx, arg2 %llx, arg3 %llx, arg4 %llx, arg5 %llx\n",
+                      lookup_syscall( (uint32_t) syscall_id ), syscall_id, syscall_id,
+                      ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ), ACCESS_REG( REG_ARG3 ),
+                      ACCESS_REG( REG_ARG4 ), ACCESS_REG( REG_ARG5 ) );
+#endif
 
-#ifdef M68
+#if defined( X64OS ) || defined( X32OS )
+    g_syscallsExecuted++;
+    begin_flight_syscall( cpu, syscall_id );
 
-    for ( size_t i = 0; i < 8; i++ )
+    if ( g_syscallReplayLog.size() && replay_syscall( cpu, syscall_id ) )
     {
-        tracer.Trace( "d%zu: %8x, ", i, cpu.dregs[ i ].l );
-        printf( "d%zu: %8x, ", i, cpu.dregs[ i ].l );
-
-        if ( 3 == ( i & 3 ) )
-        {
-            tracer.Trace( "\n" );
-            printf( "\n" );
-            if ( 7 != i )
-            {
-                tracer.Trace( "  " );
-                printf( "  " );
-            }
-        }
+        end_flight_syscall( cpu );
+        return;
     }
 
-    tracer.Trace( "  " );
-    printf( "  " );
+    if ( g_syscallRecordFile )
+        begin_record_syscall( cpu, syscall_id );
+#endif
 
-    for ( size_t i = 0; i < 8; i++ )
+    switch ( syscall_id )
     {
-        tracer.Trace( "a%zu: %8x, ", i, cpu.aregs[ i ] );
-        printf( "a%zu: %8x, ", i, cpu.aregs[ i ] );
-
-        if ( 3 == ( i & 3 ) )
+        case emulator_sys_exit: // exit
+        case SYS_exit:
+        case SYS_exit_group:
+#if !defined( X64OS )
+        case SYS_tgkill:
+#endif
         {
-            tracer.Trace( "\n" );
-            printf( "\n" );
-            if ( 7 != i )
+            g_terminate = true;
+            cpu.end_emulation();
+            g_exit_code = (int) ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+#if defined( X32OS )
+        case emulator_sys_ugetrlimit:
+        {
+            errno = EINVAL;
+            update_result_errno( cpu, -1 );
+            break;
+        }
+        case emulator_sys_set_thread_area:
+        {
+            struct linux_user_desc * pud = (linux_user_desc *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pud->swap_endianness();
+            tracer.Trace( "  entry number: %d\n", pud->entry_number );
+            tracer.Trace( "  sizeof the struct: %u\n", sizeof( struct linux_user_desc ) );
+            tracer.Trace( "  base_addr: %#x\n", pud->base_addr );
+            tracer.Trace( "  limit: %#x\n", pud->limit );
+            if ( -1 == pud->entry_number )
             {
-                tracer.Trace( "  " );
-                printf( "  " );
+                pud->entry_number = 1;
+                cpu.reg_gs() = pud->base_addr;
             }
-        }
-    }
-
-#elif defined( X64OS )
-
-    for ( size_t i = 0; i < 16; i++ )
-    {
-        tracer.Trace( "%4s: %16llx, ", x64_register_names[ i ], ACCESS_REG( i ) );
-        printf( "%4s: %16llx, ", x64_register_names[ i ], ACCESS_REG( i ) );
+            pud->swap_endianness();
+            memcpy( & g_user_desc, pud, sizeof( *pud ) );
 
-        if ( 3 == ( i & 3 ) )
+            update_result_errno( cpu, 0 );
+            break;
+        }
+#endif //X32OS
+        case emulator_sys_get_thread_area:
         {
-            tracer.Trace( "\n" );
-            printf( "\n" );
-            if ( 31 != i )
+            struct linux_user_desc * pud = (linux_user_desc *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            memcpy( pud, & g_user_desc, sizeof( *pud ) );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+#if defined( X64OS ) || defined( X32OS )
+        case emulator_sys_x32_x64_arch_prctl:
+        {
+            REG_TYPE arch = ACCESS_REG( REG_ARG0 );
+            REG_TYPE pbase = ACCESS_REG( REG_ARG1 );
+            SIGNED_REG_TYPE result = 0;
+
+            if ( 0x1001 == arch ) // ARCH_SET_GS
+                cpu.reg_gs() = pbase;
+            else if ( 0x1002 == arch ) // ARCH_SET_FS
+                cpu.reg_fs() = pbase;
+            else if ( 0x1003 == arch ) // ARCH_GET_FS
+                * (REG_TYPE *) cpu.getmem( pbase ) = cpu.reg_fs();
+            else if ( 0x1004 == arch ) // ARCH_GET_GS
+                * (REG_TYPE *) cpu.getmem( pbase ) = cpu.reg_gs();
+            else  // this cpu doesn't support shadow stacks or CET generally
             {
-                tracer.Trace( "  " );
-                printf( "  " );
+                errno = EINVAL;
+                result = -1;
             }
+            update_result_errno( cpu, result );
+            break;
         }
-    }
-
-#elif defined( X32OS )
-
-    for ( size_t i = 0; i < 8; i++ )
-    {
-        tracer.Trace( "%4s: %8x, ", x32_register_names[ i ], ACCESS_REG( i ) );
-        printf( "%4s: %8x, ", x32_register_names[ i ], ACCESS_REG( i ) );
-
-        if ( 3 == ( i & 3 ) )
+#endif // X64OS || X32OS
+        case SYS_signalstack:
         {
-            tracer.Trace( "\n" );
-            printf( "\n" );
-            if ( 15 != i )
+#if defined( X64OS )
+            uint64_t sp = cpu.regs[ x64::rsp ].q;
+            if ( 0 != ACCESS_REG( REG_ARG1 ) )
             {
-                tracer.Trace( "  " );
-                printf( "  " );
+                linux_stack_x64 * pold = (linux_stack_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                *pold = g_sigAltStack;
+                if ( on_alt_stack( sp ) )
+                    pold->ss_flags = linux_SS_ONSTACK;
             }
-        }
-    }
 
-#else
+            if ( 0 != ACCESS_REG( REG_ARG0 ) )
+            {
+                if ( on_alt_stack( sp ) )
+                {
+                    errno = EPERM;
+                    update_result_errno( cpu, -1 );
+                    break;
+                }
 
-    for ( size_t i = 0; i < 32; i++ )
-    {
-#ifdef ARMOS
-        tracer.Trace( "%02zu: %16llx, ", i, ACCESS_REG( i ) );
-        printf( "%02zu: %16llx, ", i, ACCESS_REG( i ) );
-#elif defined( SPARCOS )
-        tracer.Trace( "%4s: %8x, ", sparc_register_names[ i ], ACCESS_REG( (uint32_t) i ) );
-        printf( "%4s: %8x, ", sparc_register_names[ i ], ACCESS_REG( (uint32_t) i ) );
-#elif defined( RVOS )
-        tracer.Trace( "%4s: %16llx, ", riscv_register_names[ i ], ACCESS_REG( i ) );
-        printf( "%4s: %16llx, ", riscv_register_names[ i ], ACCESS_REG( i ) );
+                g_sigAltStack = * (linux_stack_x64 *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+                if ( g_sigAltStack.ss_flags & linux_SS_DISABLE )
+                    g_sigAltStack.ss_size = 0;
+                cpu.set_alt_stack( g_sigAltStack.ss_sp, g_sigAltStack.ss_size );
+                tracer.Trace( "  alternate signal stack %llx, size %llu, flags %d\n", g_sigAltStack.ss_sp, g_sigAltStack.ss_size, g_sigAltStack.ss_flags );
+            }
 #endif
-
-        if ( 3 == ( i & 3 ) )
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_print_int64:
         {
-            tracer.Trace( "\n" );
-            printf( "\n" );
-            if ( 31 != i )
+            printf( REG_FORMAT, ACCESS_REG( REG_ARG0 ) );
+            fflush( stdout );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_print_char:
+        {
+            if ( 12 != ACCESS_REG( REG_ARG0 ) )
             {
-                tracer.Trace( "  " );
-                printf( "  " );
+                send_character( (uint8_t) ACCESS_REG( REG_ARG0 ) );
+                fflush( stdout );
             }
+            update_result_errno( cpu, 0 );
+            break;
         }
-    }
-
-    cpu.trace_instructions( true );
-#ifdef ARMOS
-    cpu.trace_vregs();
-#elif defined( SPARCOS )
-    cpu.trace_fregs();
+        case emulator_sys_print_text: // print asciiz in a0
+        {
+            tracer.Trace( "  syscall command print string '%s'\n", (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
+            printf( "%s", (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
+            fflush( stdout );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_get_datetime: // writes local date/time into string pointed to by a0
+        {
+            char * pdatetime = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            system_clock::time_point now = system_clock::now();
+            uint64_t ms = duration_cast<milliseconds>( now.time_since_epoch() ).count() % 1000;
+            time_t time_now = system_clock::to_time_t( now );
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+            {
+                uint64_t vms = virtual_clock_ns( cpu, 0 ) / 1000000;
+                ms = vms % 1000;
+                time_now = (time_t) ( vms / 1000 );
+            }
 #endif
+            struct tm * plocal = localtime( & time_now );
+            snprintf( pdatetime, 80, "%02u:%02u:%02u.%03u", (uint32_t) plocal->tm_hour, (uint32_t) plocal->tm_min, (uint32_t) plocal->tm_sec, (uint32_t) ms );
+            tracer.Trace( "  got datetime: '%s'\n", pdatetime );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys__llseek: // old syscall ( unsigned int fd, unsigned long high, unsigned long low, int64_t * result, unsigned int whence )
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            uint32_t offset_hi = (uint32_t) ACCESS_REG( REG_ARG1 );
+            uint32_t offset_lo = (uint32_t) ACCESS_REG( REG_ARG2 );
+            uint64_t offset = ( ( (uint64_t) offset_hi ) << 32 ) | offset_lo;
+            int64_t * presult = (int64_t *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
+            int origin = (int) ACCESS_REG( REG_ARG4 );
+            if ( vfs_lseek( cpu, descriptor, (int64_t) offset, origin, presult ) )
+                break;
 
-#endif // M68
+            long result = lseek( descriptor, (long) offset, origin );
+            *presult = swap_endian64( result );
+            update_result_errno( cpu, result );
+            break;
+        }
+        case emulator_sys_poll:
+        {
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_access: // old syscall int access(const char *path, int mode);
+        {
+            char * path = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            REG_TYPE mode = ACCESS_REG( REG_ARG1 );
+            tracer.Trace( "  emulator_sys_access path '%s', mode %#x\n", path, mode );
+            if ( vfs_access( cpu, -100, path, (int) mode ) )
+                break;
 
-    tracer.Trace( "%s\n", build_string() );
-    printf( "%s\n", build_string() );
+            errno = EACCES;
+            update_result_errno( cpu, -1 );
+            break;
+        }
+        case SYS_getcwd:
+        {
+            // the syscall version of getcwd never uses malloc to allocate a return value. Just C runtimes do that for POSIX compliance.
 
-    tracer.Flush();
-    fflush( stdout );
-    exit( 1 );
-} //emulator_hard_termination
+            REG_TYPE original = ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  address in vm space: %llx == %llu\n", original, original );
+            char * pin = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            size_t size = (size_t) ACCESS_REG( REG_ARG1 );
+            uint64_t pout = 0;
+            if ( vfs_getcwd( cpu, pin, size ) )
+                break;
 
-#if defined( M68 )
+#ifdef _WIN32
+            char * poutwin32 = _getcwd( acPath, sizeof( acPath ) );
+            if ( poutwin32 )
+            {
+                tracer.Trace( "  acPath: '%s', poutwin32: '%s'\n", acPath, poutwin32 );
+                backslash_to_slash( poutwin32 );
+                pout = original;
+                strcpy( pin, poutwin32 + 2 ); // get past C:
+            }
+            else
+                tracer.Trace( "  _getcwd failed on win32, error %d\n", (int) errno );
 
-const char * bdos_functions[] =
-{
-    "system reset",                        // 0
-    "console input",
-    "console output",
-    "auxiliary input",
-    "auxiliary output",
-    "list output",
-    "direct console i/o",
-    "get i/o byte",
-    "set i/o byte",
-    "print string",
-    "read console buffer",                 // 10
-    "get console status",
-    "return version number",
-    "reset disk system",
-    "select disk",
-    "open file",
-    "close file",
-    "search for first",
-    "search for next",
-    "delete file",
-    "read sequential",                     // 20
-    "write sequential",
-    "make file",
-    "rename file",
-    "return login vector",
-    "return current disk",
-    "set dma address",
-    "27 is unused",
-    "write protect disk",
-    "get read-only vector",
-    "set file attributes",                 // 30
-    "get disk parmameters",
-    "get/set user code",
-    "read random",
-    "write random",
-    "compute file size",
-    "set random record",
-    "reset drive",
-    "38 is unused",
-    "39 is unused",
-    "write random with zero fill",         // 40
-    "41 is unused",
-    "42 is unused",
-    "43 is unused",
-    "44 is unused",
-    "45 is unused",
-    "get disk free space",
-    "chain to program",
-    "flush buffers",
-    "49 is unused",
-    "direct BIOS call",                    // 50
-    "51 is unused",
-    "52 is unused",
-    "53 is unused",
-    "54 is unused",
-    "55 is unused",
-    "56 is unused",
-    "57 is unused",
-    "58 is unused",
-    "program load",
-    "60 is unused",                        // 60
-    "set exception vector",
-    "set supervisor state",
-    "get/set tpa limits"
-};
+            tracer.Trace( "  getcwd returning '%s'\n", pin );
+#else
+    #ifndef OLDGCC      // the several-years-old Gnu C compiler for the RISC-V development boards
+            pout = cpu.host_to_vm_address( getcwd( pin, size ) );
+    #endif
+#endif
+            if ( pout )
+                update_result_errno( cpu, original );
+            else
+                update_result_errno( cpu, errno );
+            break;
+        }
+        case SYS_fcntl:
+        {
+            int fd = (int) ACCESS_REG( REG_ARG0 );
+            int op = (int) ACCESS_REG( REG_ARG1 );
 
-const char * bdos_function( uint32_t id )
-{
-    if ( id < _countof( bdos_functions ) )
-        return bdos_functions[ id ];
+            if ( 1 == op ) // F_GETFD
+                ACCESS_REG( REG_RESULT ) = 1; // FD_CLOEXEC
+            else if ( 3 == op )
+                ACCESS_REG( REG_RESULT ) = 2; // O_RDWR
+            else
+                tracer.Trace( "unhandled SYS_fcntl operation %d\n", op );
+            break;
+        }
+        case SYS_clock_nanosleep:
+        {
+            clockid_t clockid = (clockid_t) ACCESS_REG( REG_ARG0 );
+            int flags = (int) ACCESS_REG( REG_ARG1 );
+            tracer.Trace( "  nanosleep id %d flags %x\n", clockid, flags );
 
-    if ( 45 == id )
-        return "non - cp/m 2.2: set action on hardware error";
-    if ( 48 == id )
-        return "non - cp/m 2.2: empty disk buffers";
-    if ( 105 == id )
-        return "non - cp/m 2.2: get date and time";
-    if ( 108 == id )
-        return "cp/m v3 get/put exit code";
-    if ( 155 == id )
-        return "non - cp/m 2.2: get date and time with seconds";
+            const struct timespec_syscall * request = (const struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+            struct timespec_syscall * remain = 0;
+            if ( 0 != ACCESS_REG( REG_ARG3 ) )
+                remain = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
 
-    return "unknown";
-} //bdos_function
+#ifdef X32OS
+            struct timespec_syscall_x32 local_request = * (struct timespec_syscall_x32 *) request;
+            local_request.tv_sec = swap_endian32( local_request.tv_sec );
+            local_request.tv_nsec = swap_endian32( local_request.tv_nsec );
+#else
+            struct timespec_syscall local_request = * request;
+            local_request.tv_sec = swap_endian64( local_request.tv_sec );
+            local_request.tv_nsec = swap_endian64( local_request.tv_nsec );
+#endif //X32OS
 
-const char * bios_functions[] =
-{
-    "initialization",                      // 0
-    "warm boot",
-    "console status",
-    "read console character in",
-    "write console character out",
-    "list",
-    "auxiliary output",
-    "auxiliary input",
-    "home",
-    "selet disk drive",
-    "set track number",                    // 10
-    "set sector number",
-    "set dma address",
-    "read selected sector",
-    "write selected sector",
-    "return list status",
-    "sector translate",
-    "17 is unused",
-    "get memory region table address",
-    "get i/o mapping byte",
-    "set i/o mapping byte",                // 20
-    "flush buffers",
-    "set exception handler address"
-};
+            uint64_t ms = local_request.tv_sec * 1000 + local_request.tv_nsec / 1000000;
+            tracer.Trace( "  nanosleep sec %llu, nsec %llu == %llu ms\n", (uint64_t) local_request.tv_sec, (uint64_t) local_request.tv_nsec, ms );
+#if defined( X64OS )
+            if ( UINT64_MAX != ns_until_next_timer( cpu, false ) ) // a timer may cut the sleep short
+            {
+                uint64_t ns = (uint64_t) local_request.tv_sec * 1000000000 + (uint64_t) local_request.tv_nsec;
+                if ( flags & 1 ) // TIMER_ABSTIME
+                {
+                    uint64_t now = signal_clock_ns( cpu, (uint64_t) clockid );
+                    ns = ( ns > now ) ? ( ns - now ) : 0;
+                }
 
-const char * bios_function( uint32_t id )
-{
-    if ( id < _countof( bios_functions ) )
-        return bios_functions[ id ];
+                uint64_t remaining = 0;
+                bool interrupted = interruptible_sleep( cpu, ns, remaining );
+                update_signal_checks( cpu );
+                if ( interrupted )
+                {
+                    if ( remain && !( flags & 1 ) )
+                    {
+                        remain->tv_sec = swap_endian64( remaining / 1000000000 );
+                        remain->tv_nsec = swap_endian64( remaining % 1000000000 );
+                    }
+                    errno = EINTR;
+                    update_result_errno( cpu, -1 );
+                }
+                else
+                    update_result_errno( cpu, 0 );
+                break;
+            }
+#endif
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+            {
+                uint64_t ns = (uint64_t) local_request.tv_sec * 1000000000 + (uint64_t) local_request.tv_nsec;
+                if ( flags & 1 ) // TIMER_ABSTIME
+                {
+                    uint64_t now = virtual_clock_ns( cpu, (uint64_t) clockid );
+                    ns = ( ns > now ) ? ( ns - now ) : 0;
+                }
+                g_virtualSleepNs += ns;
+                tracer.Trace( "  advanced virtual time by %llu ns\n", ns );
+            }
+            else
+#endif
+            sleep_ms( ms ); // no timer is armed to end the sleep early, and host signals are delivered after it, so remain isn't written
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_sched_setaffinity:
+        {
+            tracer.Trace( "  setaffinity, EPERM %d\n", EPERM );
+            update_result_errno( cpu, EPERM );
+            break;
+        }
+        case SYS_sched_getaffinity:
+        {
+            tracer.Trace( "  getaffinity, EPERM %d\n", EPERM );
+            update_result_errno( cpu, EPERM );
+            break;
+        }
+        case SYS_sched_yield:
+        {
+            // always succeeds on Linux, even though nothing happens here.
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_newfstat:
+        {
+            // two arguments: descriptor and pointer to the stat buf
+            tracer.Trace( "  syscall command SYS_newfstat\n" );
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            int result = 0;
 
-    return "unknown";
-} //bios_function
+#ifdef _WIN32
+            struct stat_linux_syscall local_stat = {0};
+            if ( !vfs_stat( descriptor, "", local_stat, result ) )
+                result = fill_pstat_windows( descriptor, & local_stat, 0 );
+            if ( 0 == result )
+            {
+                #ifdef X64OS
+                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                    pout->st_dev = local_stat.st_dev;
+                    pout->st_ino = local_stat.st_ino;
+                    pout->st_mode = local_stat.st_mode;
+                    pout->st_nlink = local_stat.st_nlink;
+                    pout->st_uid = local_stat.st_uid;
+                    pout->st_gid = local_stat.st_gid;
+                    pout->st_rdev = local_stat.st_rdev;
+                    pout->st_size = local_stat.st_size;
+                    pout->st_blksize = local_stat.st_blksize;
+                    pout->st_blocks = local_stat.st_blocks;
+                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
+                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
+                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) pout->st_size, (int) offsetof( struct stat_linux_syscall_x64, st_size ) );
+                    pout->swap_endianness();
+                    tracer.Trace( "post-swap mode: %#x\n", pout->st_mode );
+                #else // X64OS
+                    size_t cbStat = sizeof( struct stat_linux_syscall );
+                    assert( 128 == cbStat );  // 128 is the size of the stat struct this syscall on RISC-V Linux
+                    local_stat.swap_endianness();
+                    memcpy( cpu.getmem( ACCESS_REG( REG_ARG1 ) ), & local_stat, cbStat );
+                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
+                #endif // X64OS
+            }
+            else
+            {
+                errno = 2;
+                tracer.Trace( "  fill_pstat_windows failed\n" );
+            }
+#else // _WIN32
+            tracer.Trace( "  sizeof struct stat: %d\n", (int) sizeof( struct stat ) );
+            struct stat local_stat = {0};
+            if ( !vfs_stat( descriptor, "", local_stat, result ) )
+                result = fstat( descriptor, & local_stat );
+            if ( 0 == result )
+            {
+                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
 
-void append_string( char * pc, const char * a )
-{
-    size_t len = strlen( pc );
-    if ( 0 != len )
-    {
-        pc[ len++ ] = ',';
-        pc[ len++ ] = ' ';
-    }
+                #ifdef X64OS
+                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                #else
+                    struct stat_linux_syscall * pout = (struct stat_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                #endif
 
-    strcpy( pc + len, a );
-} //append_string
+                pout->st_dev = local_stat.st_dev;
+                pout->st_ino = local_stat.st_ino;
+                pout->st_mode = local_stat.st_mode;
+                pout->st_nlink = local_stat.st_nlink;
+                pout->st_uid = local_stat.st_uid;
+                pout->st_gid = local_stat.st_gid;
+                pout->st_rdev = local_stat.st_rdev;
+                pout->st_size = local_stat.st_size;
+                pout->st_blksize = local_stat.st_blksize;
+                pout->st_blocks = local_stat.st_blocks;
 
-#pragma pack( push, 1 )
-struct SymbolEntryCPM
-{
-    char name[ 8 ];
-    uint16_t type;
-    uint32_t value;
+                #ifdef __APPLE__
+                    pout->st_atim.tv_sec = local_stat.st_atimespec.tv_sec;
+                    pout->st_atim.tv_nsec = local_stat.st_atimespec.tv_nsec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtimespec.tv_sec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtimespec.tv_nsec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctimespec.tv_sec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctimespec.tv_nsec;
+                #elif defined( __mc68000__ )
+                    pout->st_atim.tv_sec = local_stat.st_atime;
+                    pout->st_mtim.tv_sec = local_stat.st_mtime;
+                    pout->st_ctim.tv_sec = local_stat.st_ctime;
+                #else
+                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
+                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
+                #endif // !__APPLE__
 
-    void swap_endianness()
-    {
-        type = swap_endian16( type );
-        value = swap_endian32( value );
-    }
+                tracer.Trace( "  file size %d, mode %#x, isdir %s\n", (int) local_stat.st_size, local_stat.st_mode, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
+                pout->swap_endianness();
+            }
+            else
+                tracer.Trace( "  fstat failed, error %d\n", errno );
+#endif // !_WIN32
 
-    const char * get_type()
-    {
-        static char ac[ 80 ];
-        ac[ 0 ] = 0;
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_gettimeofday:
+        {
+            tracer.Trace( "  syscall command SYS_gettimeofday\n" );
+            linux_timeval * ptimeval = (linux_timeval *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            int result = 0;
+            if ( 0 != ptimeval )
+            {
+                linux_timeval tv = {0};
+#if defined( X64OS ) || defined( X32OS )
+                if ( 0 != g_virtualClockMHz )
+                {
+                    uint64_t us = virtual_clock_ns( cpu, 0 ) / 1000;
+                    tv.tv_sec = us / 1000000;
+                    tv.tv_usec = us % 1000000;
+                }
+                else
+#endif
+                result = gettimeofday( &tv );
 
-        if ( 0x8000 & type )
-            append_string( ac, "defined" );
-        if ( 0x4000 & type )
-            append_string( ac, "equated" );
-        if ( 0x2000 & type )
-            append_string( ac, "global" );
-        if ( 0x1000 & type )
-            append_string( ac, "equated-register" );
-        if ( 0x800 & type )
-            append_string( ac, "external reference" );
-        if ( 0x400 & type )
-            append_string( ac, "data-based-relocatable" );
-        if ( 0x200 & type )
-            append_string( ac, "text-based-relocatable" );
-        if ( 0x100 & type )
-            append_string( ac, "bss-based-relocatable" );
+                if ( 0 == result )
+                {
+                    ptimeval->tv_sec = tv.tv_sec;
+                    ptimeval->tv_usec = tv.tv_usec;
 
-        return ac;
-    }
+                    ptimeval->tv_sec = swap_endian64( ptimeval->tv_sec );
+                    ptimeval->tv_usec = swap_endian64( ptimeval->tv_usec );
 
-    void trace()
-    {
-        tracer.Trace( "  %#16x", value );
-        tracer.Trace( "  %10s", name );
-        tracer.Trace( "  %s\n", get_type() );
-    }
-};
-#pragma pack(pop)
+                    tracer.Trace( "    tv.tv_sec %#llx, swapped %#llx\n", tv.tv_sec, ptimeval->tv_sec );
+                    tracer.Trace( "    tv_usec %#llx, swapped %#llx\n", swap_endian64( ptimeval->tv_usec ), ptimeval->tv_usec );
+                }
+            }
 
-static vector<SymbolEntryCPM> g_cpmSymbols;
+            tracer.Trace( "  returning result %d\n", result );
+            ACCESS_REG( REG_RESULT ) = result;
+            break;
+        }
+        case SYS_lseek:
+        {
+            tracer.Trace( "  syscall command SYS_lseek\n" );
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            SIGNED_REG_TYPE offset = (SIGNED_REG_TYPE) ACCESS_REG( REG_ARG1 ); // directory offsets are 64-bit cookies from d_off
+            int origin = (int) ACCESS_REG( REG_ARG2 );
 
-static int symbol_find_compare_cpm( const void * a, const void * b )
-{
-    SymbolEntryCPM & sa = * (SymbolEntryCPM *) a;
-    SymbolEntryCPM & sb = * (SymbolEntryCPM *) b;
+            if ( vfs_lseek( cpu, descriptor, offset, origin, 0 ) )
+                break;
 
-    if ( 0 == sa.name[0] ) // a is the key
-    {
-        SymbolEntryCPM * pnext = ( ( & sb ) + 1 );
-        if ( ( sa.value == sb.value ) || ( sa.value > sb.value && sa.value < pnext->value ) )
-            return 0;
-    }
-    else // b is the key
-    {
-        SymbolEntryCPM * pnext = ( ( & sa ) + 1 );
-        if ( ( sb.value == sa.value ) || ( sb.value > sa.value && sb.value < pnext->value ) )
-            return 0;
-    }
-
-    if ( sa.value > sb.value )
-        return 1;
-    return -1;
-} //symbol_find_compare_cpm
-
-#endif //M68
-
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-
-static int symbol_find_compare32( const void * a, const void * b )
-{
-    ElfSymbol32 & sa = * (ElfSymbol32 *) a;
-    ElfSymbol32 & sb = * (ElfSymbol32 *) b;
-
-    if ( 0 == sa.size ) // a is the key
-    {
-        if ( ( sa.value == sb.value ) || ( sa.value > sb.value && sa.value < ( sb.value + sb.size ) ) )
-            return 0;
-    }
-    else // b is the key
-    {
-        if ( ( sb.value == sa.value ) || ( sb.value > sa.value && sb.value < ( sa.value + sa.size ) ) )
-            return 0;
-    }
-
-    if ( sa.value > sb.value )
-        return 1;
-    return -1;
-} //symbol_find_compare32
+#if !defined( _WIN32 ) && !defined( OLDGCC )
+            DIR * dir = find_dir_stream( descriptor, false );
+            if ( 0 != dir && SEEK_SET == origin ) // seekdir and rewinddir in the app move the stream that fills its records
+            {
+                seekdir( dir, (long) offset );
+                update_result_errno( cpu, offset );
+                break;
+            }
 
-#else // M68 || SPARCOS || X32OS
+            off_t result = lseek( descriptor, (off_t) offset, origin );
+#else
+            long result = lseek( descriptor, (long) offset, origin );
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_read:
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            void * buffer = cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            uint32_t buffer_size = (uint32_t) ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  syscall command SYS_read. descriptor %d, buffer_size %u, buffer %llx\n", descriptor, buffer_size, ACCESS_REG( REG_ARG1 ) );
 
-static int symbol_find_compare( const void * a, const void * b )
-{
-    ElfSymbol64 & sa = * (ElfSymbol64 *) a;
-    ElfSymbol64 & sb = * (ElfSymbol64 *) b;
+#if defined( X64OS ) || defined( X32OS )
+            if ( read_perf_event( cpu, descriptor, (uint8_t *) buffer, buffer_size ) )
+                break;
+#endif
 
-    if ( 0 == sa.size ) // a is the key
-    {
-        if ( sa.value >= sb.value && sa.value < ( sb.value + sb.size ) )
-            return 0;
-    }
-    else // b is the key
-    {
-        if ( sb.value >= sa.value && sb.value < ( sa.value + sa.size ) )
-            return 0;
-    }
+            if ( 0 == descriptor ) //&& 1 == buffer_size )
+            {
+#ifdef _WIN32
+                int r = g_consoleConfig.linux_getch();
+#else
+                int r = g_consoleConfig.portable_getch();
+#endif
+                if ( EOF == r )
+                {
+                    ACCESS_REG( REG_RESULT ) = 0;
+                    tracer.Trace( "  getch reached the end of file on stdin\n" );
+                }
+                else
+                {
+                    * (char *) buffer = (char) r;
+                    ACCESS_REG( REG_RESULT ) = 1;
+                    tracer.Trace( "  getch read character %u == '%c'\n", (uint8_t) r, printable( (uint8_t) r ) );
+                }
+                break;
+            }
+            else if ( vfs_read( cpu, descriptor, buffer, buffer_size ) )
+                break;
 
-    if ( sa.value > sb.value )
-        return 1;
-    return -1;
-} //symbol_find_compare
+            int result = read( descriptor, buffer, buffer_size );
+            if ( result > 0 )
+                tracer.TraceBinaryData( (uint8_t *) buffer, (int) get_min( (int) 0x100, result ), 4 );
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_write:
+        {
+            tracer.Trace( "  syscall command SYS_write. fd %lld, buf %llx, count %lld\n", (uint64_t) ACCESS_REG( REG_ARG0 ), (uint64_t) ACCESS_REG( REG_ARG1 ), (uint64_t) ACCESS_REG( REG_ARG2 ) );
 
-#endif // M68 || SPARCOS || X32OS
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            uint8_t * p = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            REG_TYPE count = ACCESS_REG( REG_ARG2 );
 
-vector<char> g_string_table;      // strings in the elf image
-vector<ElfSymbol64> g_symbols;    // symbols in the elf image
-vector<ElfSymbol32> g_symbols32;  // symbols in the elf image
+            tracer.Trace( "    descriptor %d, pdata %p, count %u\n", descriptor, p, count );
 
-// returns the best guess for a symbol name for the address
+            if ( vfs_write( cpu, descriptor, p, (size_t) count ) )
+                break;
 
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+            if ( 0 == descriptor ) // stdin
+            {
+                errno = EACCES;
+                update_result_errno( cpu, -1 );
+            }
+            else
+            {
+                if ( 1 == descriptor || 2 == descriptor ) // stdout / stderr
+                    tracer.Trace( "  writing '%.*s'\n", (int) count, p );
 
-#ifdef X32OS
-const char * emulator_symbol_lookup( uint64_t address, uint64_t & offset )
-{
-    uint32_t offset32;
-    const char * result = emulator_symbol_lookup( (uint32_t) address, offset32 );
-    offset = offset32;
-    return result;
-} //emulator_symbol_lookup
+                tracer.TraceBinaryData( p, (uint32_t) count, 4 );
+#ifdef X64OS_LIBRARY
+                if ( g_outputSink && ( 1 == descriptor || 2 == descriptor ) )
+                {
+                    g_outputSink( g_outputSinkContext, descriptor, p, (size_t) count );
+                    update_result_errno( cpu, (SIGNED_REG_TYPE) count );
+                    break;
+                }
 #endif
-
-const char * emulator_symbol_lookup( uint32_t address, uint32_t & offset )
-{
-    if ( address < g_base_address || address > ( g_base_address + memory.size() ) )
-        return "";
-
-    // if no elf symbols, try CP/M symbols
-
-    if ( 0 == g_symbols32.size() )
-    {
-#ifdef M68
-        if ( 0 != g_cpmSymbols.size() )
-        {
-            SymbolEntryCPM key = {0};
-            key.value = address;
-            SymbolEntryCPM * psym = (SymbolEntryCPM *) my_bsearch( &key, g_cpmSymbols.data(), g_cpmSymbols.size(), sizeof( key ), symbol_find_compare_cpm );
-            if ( 0 != psym )
-            {
-                offset = address - psym->value;
-                return psym->name;
+                size_t written;
+#ifdef _WIN32
+                if ( 1 == descriptor || 2 == descriptor ) // stdout / stderr
+                    written = WinWrite( descriptor, p, (int) count );
+                else
+#endif
+                written = write( descriptor, p, (int) count );
+                update_result_errno( cpu, (REG_TYPE) written );
             }
+            break;
         }
-#endif //M68
+        case SYS_open:
+        {
+            tracer.Trace( "  syscall command SYS_open\n" );
 
-        return "";
-    }
+            // a0: asciiz string of file to open. a1: flags. a2: mode
 
-    ElfSymbol32 key = {0};
-    key.value = address;
+            const char * pname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            int flags = (int) ACCESS_REG( REG_ARG1 );
+            int mode = (int) ACCESS_REG( REG_ARG2 );
 
-    ElfSymbol32 * psym = (ElfSymbol32 *) my_bsearch( &key, g_symbols32.data(), g_symbols32.size(), sizeof( key ), symbol_find_compare32 );
+            int original_flags = flags;
+            tracer.Trace( "  open flags %x, mode %x, file %s\n", flags, mode, pname );
+            if ( vfs_open( cpu, -100, pname, original_flags ) )
+                break;
 
-    if ( 0 != psym )
-    {
-        offset = address - psym->value;
-        return & g_string_table[ psym->name ];
-    }
+            flags = translate_open_flags( flags );
 
-    offset = 0;
-    return "";
-} //emulator_symbol_lookup
+#ifdef _WIN32
+            // bugbug: directory ignored and assumed to be local (-100)
 
-static int symbol_compare32( const void * a, const void * b )
-{
-    ElfSymbol32 * pa = (ElfSymbol32 *) a;
-    ElfSymbol32 * pb = (ElfSymbol32 *) b;
+            strcpy( acPath, pname );
+            slash_to_backslash( acPath );
 
-    if ( pa->value > pb->value )
-        return 1;
-    if ( pa->value == pb->value )
-        return 0;
-    return -1;
-} //symbol_compare32
+            bool opendir = is_o_directory_set( original_flags );
+            int descriptor;
+            tracer.Trace( "  opendir: %u\n", opendir );
+            DWORD attr = GetFileAttributesA( acPath );
+            if ( opendir && ( INVALID_FILE_ATTRIBUTES != attr ) && ( attr & FILE_ATTRIBUTE_DIRECTORY ) )
+            {
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    FindClose( g_hFindFirst );
+                    g_hFindFirst = INVALID_HANDLE_VALUE;
+                }
+                strcpy( g_acFindFirstPattern, acPath );
+                size_t len = strlen( g_acFindFirstPattern );
+                if ( '\\' != g_acFindFirstPattern[ len - 1 ] )
+                    strcat( g_acFindFirstPattern, "\\" );
+                strcat( g_acFindFirstPattern, "*.*" );
+                descriptor = findFirstDescriptor;
+            }
+            else
+            {
+#ifdef M68
+                if ( is_o_creat_set( original_flags ) )
+                    mode = _S_IREAD | _S_IWRITE; // __mc68000__ passes user-related flags that conflict with these flags
+#endif //M68
+                descriptor = _open( pname, flags, mode );
+            }
+#else // !_WIN32
 
-#else // M68 || SPARCOS || X32OS
+            const char * pfilename = pname;
 
-const char * emulator_symbol_lookup( uint64_t address, uint64_t & offset )
-{
-    if ( address < g_base_address || address > ( g_base_address + memory.size() ) )
-        return "";
+            if ( ! is_o_creat_set( original_flags ) )
+                mode = 0; // mode is only defined if O_CREAT or O_TMPFILE are specified, and O_TMPFILE isn't defined for most platforms
 
-    ElfSymbol64 key = {0};
-    key.value = address;
+            int descriptor = open( pfilename, flags, mode );
+            track_open_file( descriptor, -100, pfilename, flags, mode );
+#endif //_WIN32
 
-    ElfSymbol64 * psym = (ElfSymbol64 *) my_bsearch( &key, g_symbols.data(), g_symbols.size(), sizeof( key ), symbol_find_compare );
+            tracer.Trace( "  result of open: descriptor: %d, mode %#x\n", descriptor, mode );
+            update_result_errno( cpu, descriptor );
+            break;
+        }
+        case SYS_close:
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  syscall command SYS_close %d\n", descriptor );
 
-    if ( 0 != psym )
-    {
-        offset = address - psym->value;
-        return & g_string_table[ psym->name ];
-    }
+            if ( descriptor >= 0 && descriptor <= 2 )
+            {
+                // built-in handle stdin, stdout, stderr -- ignore
+                ACCESS_REG( REG_RESULT ) = 0;
+            }
+            else if ( !vfs_close( cpu, descriptor ) )
+            {
+                int result = 0;
+#ifdef _WIN32
+                if ( findFirstDescriptor == descriptor )
+                {
+                    if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                    {
+                        FindClose( g_hFindFirst );
+                        g_hFindFirst = INVALID_HANDLE_VALUE;
+                        g_acFindFirstPattern[ 0 ] = 0;
+                    }
+                    update_result_errno( cpu, 0 );
+                    break;
+                }
+                else
+#else
+    #if !defined( OLDGCC )
+                if ( close_dir_stream( (int) descriptor ) )
+                {
+                    untrack_open_file( (int) descriptor );
+                    update_result_errno( cpu, 0 );
+                    break;
+                }
+    #endif
+#endif
+                result = close( descriptor );
+                if ( 0 == result )
+                {
+                    untrack_open_file( descriptor );
+#if defined( X64OS ) || defined( X32OS )
+                    close_perf_event( cpu, descriptor );
+#endif
+                }
+                update_result_errno( cpu, result );
+            }
+            break;
+        }
+        case emulator_sys_getdents:
+        {
+            int result = 0;
+            REG_TYPE descriptor = ACCESS_REG( REG_ARG0 );
+            uint8_t * pentries = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            REG_TYPE count = ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  pentries: %p, count %u\n", pentries, (uint32_t) count );
 
-    offset = 0;
-    return "";
-} //emulator_symbol_lookup
+#ifdef _WIN32
+            struct linux_dirent_syscall * pcur = (struct linux_dirent_syscall *) pentries;
+            memset( pentries, 0, count );
 
-static int symbol_compare( const void * a, const void * b )
-{
-    ElfSymbol64 * pa = (ElfSymbol64 *) a;
-    ElfSymbol64 * pb = (ElfSymbol64 *) b;
+            if ( ( findFirstDescriptor != descriptor ) || ( 0 == g_acFindFirstPattern[ 0 ] ) )
+            {
+                tracer.Trace( "  getdents on unexpected descriptor or FindFirst (%p) not open\n", g_hFindFirst );
+                errno = EBADF;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    if ( pa->value > pb->value )
-        return 1;
-    if ( pa->value == pb->value )
-        return 0;
-    return -1;
-} //symbol_compare
+            WIN32_FIND_DATAA fd = {0};
 
-#endif //M68
+            if ( INVALID_HANDLE_VALUE == g_hFindFirst )
+            {
+                tracer.Trace( "findfirstfilea call, pattern '%s'\n", g_acFindFirstPattern );
+                g_hFindFirst = FindFirstFileA( g_acFindFirstPattern, &fd );
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    tracer.Trace( "  successfully opened FindFirst for pattern '%s'\n", g_acFindFirstPattern );
 
-static void remove_spaces( char * p )
-{
-    char * o;
-    for ( o = p; *p; p++ )
-    {
-        if ( ' ' != *p )
-            *o++ = *p;
-    }
-    *o = 0;
-} //remove_spaces
+                    size_t len = strlen( fd.cFileName );
+                    if ( ( count < sizeof( struct linux_dirent_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent_syscall ) ) ) )
+                    {
+                        errno = EINVAL;
+                        result = -1;
+                    }
+                    else
+                    {
+                        pcur->d_ino = 100; // fake
+                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent_syscall ) );
+                        size_t dname_off = offsetof( struct linux_dirent_syscall, d_name );
+                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 + 1 ); // null termination on the string + file type
+                        pcur->d_off = pcur->d_reclen;
+                        strcpy( pcur->d_name, fd.cFileName );
 
-static const char * image_type( uint16_t e_type )
-{
-    if ( 0 == e_type )
-        return "et none";
-    if ( 1 == e_type )
-        return "et relocatable file";
-    if ( 2 == e_type )
-        return "et executable";
-    if ( 3 == e_type )
-        return "et dynamic linked shared object";
-    if ( 4 == e_type )
-        return "et core file";
-    return "et unknown";
-} //image_type
+                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
+                            pcur->settype( 10 ); // DT_LNK
+                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
+                            pcur->settype( 4 ); // DT_DIR
+                        else
+                            pcur->settype( 8 ); // DT_REG
 
-static int ends_with( const char * str, const char * end )
-{
-    size_t len = strlen( str );
-    size_t lenend = strlen( end );
+                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->gettype() );
+                        result = pcur->d_reclen;
+                        pcur->swap_endianness();
+                    }
+                }
+                else
+                {
+                    tracer.Trace( "find first failed error %d\n", GetLastError() );
+                    errno = EINVAL;
+                    result = -1;
+                }
+            }
+            else
+            {
+                // find next here
 
-    if ( len < lenend )
-        return false;
+                BOOL found = FindNextFileA( g_hFindFirst, &fd );
+                if ( found )
+                {
+                    size_t len = strlen( fd.cFileName );
+                    if ( ( count < sizeof( struct linux_dirent_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent_syscall ) ) ) )
+                    {
+                        errno = ENOENT;
+                        result = -1;
+                    }
+                    else
+                    {
+                        pcur->d_ino = 100; // fake
+                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent_syscall ) );
+                        size_t dname_off = offsetof( struct linux_dirent_syscall, d_name );
+                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 + 1 );
+                        pcur->d_off = pcur->d_reclen;
+                        strcpy( pcur->d_name, fd.cFileName );
 
-    return ( 0 == _stricmp( str + len - lenend, end ) );
-} //ends_with
+                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
+                            pcur->settype( 10 ); // DT_LNK
+                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
+                            pcur->settype( 4 ); // DT_DIR
+                        else
+                            pcur->settype( 8 ); // DT_REG
 
-#ifdef M68
+                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->gettype() );
+                        tracer.TraceBinaryData( (uint8_t *) pcur, pcur->d_reclen, 4 );
+                        result = pcur->d_reclen;
+                        pcur->swap_endianness();
+                    }
+                }
+                else
+                {
+                    tracer.Trace( "  out of next files\n" );
+                    FindClose( g_hFindFirst );
+                    g_hFindFirst = INVALID_HANDLE_VALUE;
+                    g_acFindFirstPattern[ 0 ] = 0;
+                    result = 0; // nothing left
+                }
+            }
+#else
+        #if !defined( OLDGCC )
+            DIR * dir = find_dir_stream( (int) descriptor, true );
+            if ( 0 == dir )
+            {
+                errno = EBADF;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-#define CPM_FILENAME_LEN ( 8 + 3 + 1 + 1 ) // name + type + dot + null
+            result = fill_dir_entries( dir, pentries, count, false );
+    #endif
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_getdents64:
+        {
+            int result = 0;
+            REG_TYPE descriptor = ACCESS_REG( REG_ARG0 );
+            uint8_t * pentries = (uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            REG_TYPE count = ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  pentries: %p, count %u, descriptor %p\n", pentries, (uint32_t) count, descriptor );
 
-// this struct is used to cache FILE * objects to avoid open/close for each file access
+            if ( 0 == count ) // glibc does this on amd64. it's a success case
+            {
+                update_result_errno( cpu, 0 );
+                break;
+            }
 
-struct FileEntry
-{
-    char acName[ CPM_FILENAME_LEN ];
-    FILE * fp;
-};
+            if ( vfs_getdents64( cpu, (int) descriptor, pentries, (size_t) count ) )
+                break;
 
-#pragma pack( push, 1 )
-struct CPM3DateTime
-{
-    uint16_t day; // day 1 is 1 January 1978
-    uint8_t hour; // packed bcd (nibbles for each digit)
-    uint8_t minute; // packed bcd
-    uint8_t second; // packed bcd. for BDOS 155, not BDOS 105
+#ifdef _WIN32
+            struct linux_dirent64_syscall * pcur = (struct linux_dirent64_syscall *) pentries;
+            memset( pentries, 0, count );
 
-    void swap_endian()
-    {
-        day = flip_endian16( day );
-    }
-};
-#pragma pack(pop)
+            if ( ( findFirstDescriptor != descriptor ) || ( 0 == g_acFindFirstPattern[ 0 ] ) )
+            {
+                tracer.Trace( "  getdents on unexpected descriptor or FindFirst (%p) not open\n", g_hFindFirst );
+                errno = EBADF;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-uint8_t packBCD( uint8_t x )
-{
-    return (uint8_t) ( ( ( x / 10 ) << 4 ) | ( x % 10 ) );
-} //packBCD
+            WIN32_FIND_DATAA fd = {0};
 
-static bool g_forceLowercase = false;
-static uint8_t * g_DMA = 0;
-static vector<FileEntry> g_fileEntries;
+            if ( INVALID_HANDLE_VALUE == g_hFindFirst )
+            {
+                tracer.Trace( "findfirstfilea call, pattern '%s'\n", g_acFindFirstPattern );
+                g_hFindFirst = FindFirstFileA( g_acFindFirstPattern, &fd );
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    tracer.Trace( "  successfully opened FindFirst for pattern '%s'\n", g_acFindFirstPattern );
 
-FILE * RemoveFileEntry( char * name )
-{
-    for ( size_t i = 0; i < g_fileEntries.size(); i++ )
-    {
-        if ( !strcmp( name, g_fileEntries[ i ].acName ) )
-        {
-            FILE * fp = g_fileEntries[ i ].fp;
-            tracer.Trace( "  removing file entry '%s'\n", name );
-            g_fileEntries.erase( g_fileEntries.begin() + i );
-            return fp;
-        }
-    }
+                    size_t len = strlen( fd.cFileName );
+                    if ( ( count < sizeof( struct linux_dirent64_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent64_syscall ) ) ) )
+                    {
+                        errno = EINVAL;
+                        result = -1;
+                    }
+                    else
+                    {
+                        pcur->d_ino = 100; // fake
+                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent64_syscall ) );
+                        size_t dname_off = offsetof( struct linux_dirent64_syscall, d_name );
+                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 );
+                        pcur->d_off = pcur->d_reclen;
+                        strcpy( pcur->d_name, fd.cFileName );
 
-    tracer.Trace( "ERROR: could not remove file entry for '%s'\n", name );
-    return 0;
-} //RemoveFileEntry
+                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
+                            pcur->d_type = 10; // DT_LNK
+                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
+                            pcur->d_type = 4; // DT_DIR
+                        else
+                            pcur->d_type = 8; // DT_REG
 
-FILE * FindFileEntry( char * name )
-{
-    for ( size_t i = 0; i < g_fileEntries.size(); i++ )
-    {
-        if ( !strcmp( name, g_fileEntries[ i ].acName ) )
-        {
-            tracer.Trace( "  found file entry '%s'\n", name );
-            return g_fileEntries[ i ].fp;
-        }
-    }
+                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->d_type );
+                        result = pcur->d_reclen;
+                        pcur->swap_endianness();
+                    }
+                }
+                else
+                {
+                    tracer.Trace( "find first failed error %d\n", GetLastError() );
+                    errno = EINVAL;
+                    result = -1;
+                }
+            }
+            else
+            {
+                // find next here
 
-    tracer.Trace( "  could not find an open file entry for '%s'; that might be OK\n", name );
-    return 0;
-} //FindFileEntry
+                BOOL found = FindNextFileA( g_hFindFirst, &fd );
+                if ( found )
+                {
+                    size_t len = strlen( fd.cFileName );
+                    if ( ( count < sizeof( struct linux_dirent64_syscall ) ) || ( len > ( count - sizeof( struct linux_dirent64_syscall ) ) ) )
+                    {
+                        errno = ENOENT;
+                        result = -1;
+                    }
+                    else
+                    {
+                        pcur->d_ino = 100; // fake
+                        tracer.Trace( "  len: %zd, sizeof struct %zd\n", len, sizeof( struct linux_dirent64_syscall ) );
+                        size_t dname_off = offsetof( struct linux_dirent64_syscall, d_name );
+                        pcur->d_reclen = (uint16_t) ( dname_off + len + 1 );
+                        pcur->d_off = pcur->d_reclen;
+                        strcpy( pcur->d_name, fd.cFileName );
 
-#pragma pack( push, 1 )
+                        if ( ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes ) && ( FILE_ATTRIBUTE_REPARSE_POINT & fd.dwFileAttributes ) && is_dir_symbolic_link( fd.cFileName ) )
+                            pcur->d_type = 10; // DT_LNK
+                        else if ( FILE_ATTRIBUTE_DIRECTORY & fd.dwFileAttributes )
+                            pcur->d_type = 4; // DT_DIR
+                        else
+                            pcur->d_type = 8; // DT_REG
 
-struct ExceptionParameterBlockCPM
-{
-    uint16_t vector;
-    uint32_t newValue;
-    uint32_t oldValue;
+                        tracer.Trace( "  wrote '%s' into the entry. d_reclen %d, d_off %d, d_type %d\n", pcur->d_name, pcur->d_reclen, pcur->d_off, pcur->d_type );
+                        result = pcur->d_reclen;
+                    }
+                }
+                else
+                {
+                    tracer.Trace( "  out of next files\n" );
+                    FindClose( g_hFindFirst );
+                    g_hFindFirst = INVALID_HANDLE_VALUE;
+                    g_acFindFirstPattern[ 0 ] = 0;
+                    result = 0; // nothing left
+                }
+            }
+#else
+        #if !defined( OLDGCC )
+            DIR * dir = find_dir_stream( (int) descriptor, false );
+            #if defined( __linux__ ) && defined( __GLIBC__ ) && ( ( __GLIBC__ > 2 ) || ( __GLIBC_MINOR__ >= 30 ) )
+            if ( 0 == dir )
+            {
+                // the host's records have the same layout as the app's, so the kernel fills the buffer directly
 
-    void swap_endianness()
-    {
-        vector = swap_endian16( vector );
-        newValue = swap_endian32( newValue );
-        oldValue = swap_endian32( oldValue );
-    }
+                ssize_t bytes = getdents64( (int) descriptor, pentries, count );
+                for ( ssize_t offset = 0; offset < bytes; )
+                {
+                    struct linux_dirent64_syscall * pcur = (struct linux_dirent64_syscall *) ( pentries + offset );
+                    offset += pcur->d_reclen;
+                    pcur->swap_endianness();
+                }
+                tracer.Trace( "  host getdents64 returned %zd\n", bytes );
+                update_result_errno( cpu, (int) bytes );
+                break;
+            }
+            #endif
 
-    void trace()
-    {
-        tracer.Trace( "  ExceptionParameterBlockCPM:\n" );
-        tracer.Trace( "    vector %#x\n", vector );
-        tracer.Trace( "    newValue %#x\n", newValue );
-        tracer.Trace( "    oldValue %#x\n", oldValue );
-    }
-};
+            if ( 0 == dir )
+                dir = find_dir_stream( (int) descriptor, true );
 
-struct LoadParameterBlockCPM
-{
-    uint32_t fcbOfChildApp;      // the calling app must have opened the file that's here
-    uint32_t lowestAddress;      // the calling app specifies this
-    uint32_t highestAddress;     // the calling app specifies this
-    uint32_t childBasePage;      // returned by bdos
-    uint32_t childStackPointer;  // returned by bdos
-    uint16_t loaderControlFlags; // 0 == load in lowest possible address. 1 == load in highest possible address
+            if ( 0 == dir )
+            {
+                errno = EBADF;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    void swap_endianness()
-    {
-         fcbOfChildApp = swap_endian32( fcbOfChildApp );
-         lowestAddress = swap_endian32( lowestAddress );
-         highestAddress = swap_endian32( highestAddress );
-         childBasePage = swap_endian32( childBasePage );
-         childStackPointer = swap_endian32( childStackPointer );
-         loaderControlFlags= swap_endian16( loaderControlFlags );
-    }
+            result = fill_dir_entries( dir, pentries, count, true );
+        #endif
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_brk:
+        {
+            REG_TYPE original = g_brk_offset;
+            REG_TYPE ask = ACCESS_REG( REG_ARG0 );
+            if ( 0 == ask )
+                ACCESS_REG( REG_RESULT ) = cpu.get_vm_address( g_brk_offset );
+            else
+            {
+                REG_TYPE ask_offset = ask - g_base_address;
+                tracer.Trace( "  ask_offset %llx, g_end_of_data %llx, bottom_of_stack %llx\n", (uint64_t) ask_offset, (uint64_t) g_end_of_data, (uint64_t) g_bottom_of_stack );
 
-    void trace()
-    {
-        tracer.Trace( "  load parameter block:\n" );
-        tracer.Trace( "    fcb of child app:               %lx\n", fcbOfChildApp );
-        tracer.Trace( "    lowest address of child app:    %lx\n", lowestAddress );
-        tracer.Trace( "    highest address of child app:   %lx\n", highestAddress );
-        tracer.Trace( "    child base page from bdos:      %lx\n", childBasePage );
-        tracer.Trace( "    child stack pointer from bdos:  %lx\n", childStackPointer );
-        tracer.Trace( "    loader control flags:           %x\n", loaderControlFlags );
-    }
-};
+                if ( ask_offset >= g_end_of_data && ask_offset < g_bottom_of_stack )
+                {
+                    g_brk_offset = cpu.getoffset( ask );
+                    if ( g_brk_offset > g_highwater_brk )
+                        g_highwater_brk = g_brk_offset;
+#if defined( X64OS ) || defined( X32OS ) // as far as I can tell x32 and x64 are the only platforms that requires the ask to be in the result on return
+                    ACCESS_REG( REG_RESULT ) = ask;
+#endif
+                }
+                else
+                {
+                    tracer.Trace( "  allocation request was too large, failing it by returning current brk\n" );
+                    ACCESS_REG( REG_RESULT ) = cpu.get_vm_address( g_brk_offset );
+                }
+            }
 
-struct HeaderCPM68K    // .68k executable files for cp/m 68k v1.3
-{
-    uint16_t signature;
-    uint32_t cb_text;
-    uint32_t cb_data;
-    uint32_t cb_bss;
-    uint32_t cb_symbols;
-    uint32_t reserved;
-    uint32_t text_start;
-    uint16_t relocation_flag; // two bytes, but only the low byte has the flag
+            tracer.Trace( "  SYS_brk. ask %llx, current brk %llx, new brk %llx, result in return register %llx\n",
+                          (uint64_t) ask, (uint64_t) original, (uint64_t) g_brk_offset, (uint64_t) ACCESS_REG( REG_RESULT ) );
+            break;
+        }
+        case SYS_munmap:
+        {
+            REG_TYPE address = ACCESS_REG( REG_ARG0 );
+            REG_TYPE length = ACCESS_REG( REG_ARG1 );
+            length = round_up( length, (REG_TYPE) 4096 );
 
-    void swap_endianness()
-    {
-        signature = swap_endian16( signature );
-        cb_text = swap_endian32( cb_text );
-        cb_data = swap_endian32( cb_data );
-        cb_bss = swap_endian32( cb_bss );
-        cb_symbols = swap_endian32( cb_symbols );
-        reserved = swap_endian32( reserved );
-        text_start = swap_endian32( text_start );
-        relocation_flag = swap_endian16( relocation_flag );
-    }
+            bool ok = g_mmap.free( address, length );
+            if ( ok )
+                update_result_errno( cpu, 0 );
+            else
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+            }
 
-    void trace()
-    {
-        tracer.Trace( "cpm68k executable header:\n" );
-        tracer.Trace( "  signature: %#x\n", signature );
-        tracer.Trace( "  cb_text: %#x\n", cb_text );
-        tracer.Trace( "  cb_data: %#x\n", cb_data );
-        tracer.Trace( "  cb_bss: %#x\n", cb_bss );
-        tracer.Trace( "  cb_symbols: %#x\n", cb_symbols );
-        tracer.Trace( "  reserved: %#x\n", reserved );
-        tracer.Trace( "  text_start: %#x\n", text_start );
-        tracer.Trace( "  relocation_flag: %#x\n", relocation_flag );
-    }
-};
+            break;
+        }
+        case SYS_mremap:
+        {
+            REG_TYPE address = ACCESS_REG( REG_ARG0 );
+            REG_TYPE old_length = ACCESS_REG( REG_ARG1 );
+            REG_TYPE new_length = ACCESS_REG( REG_ARG2 );
+            int flags = (int) ACCESS_REG( REG_ARG3 );
 
-struct FCBCPM68K // file control block for cp/m
-{
-    uint8_t dr;         // drive
-    char f[ 8 ];        // filename
-    char t[ 3 ];        // file type
-    uint8_t ex;         // current extent number. normally set to 0 by user but is in range 0-31
-    uint8_t s1;
-    uint8_t s2;         // reserved for system use. set to 0 for open/make/search
-    uint8_t rc;         // record count, reserved for system use
-    uint8_t d[ 16 ];
-    uint8_t cr;         // current reacord to be read or written for sequential read/write operations. apps must set approprately.
-    uint8_t r0;         // (optional if app is doing random I/O) random record number. most significant byte in r0 then r1 then r2 as a 24-bit record
-    uint8_t r1;         // the byte order is the opposite of CP/M 2.2 for 8080 plus r2 is actually used!
-    uint8_t r2;
+            if ( 0 != ( new_length & 0xfff ) )
+            {
+                tracer.Trace( "  warning: mremap allocation new length isn't 4k-page aligned\n" );
+                new_length = round_up( new_length, (REG_TYPE) 4096 );
+            }
 
-    void make_filename( char * p )
-    {
-        for ( int i = 0; i < 8; i++ )
+            old_length = round_up( old_length, (REG_TYPE) 4096 );
+
+            // flags: MREMAP_MAYMOVE = 1, MREMAP_FIXED = 2, MREMAP_DONTUNMAP = 3. Ignore them all
+
+            SIGNED_REG_TYPE result = (SIGNED_REG_TYPE) g_mmap.resize( address, old_length, new_length, ( 1 == flags ) );
+            if ( 0 != result )
+                update_result_errno( cpu, result );
+            else
+            {
+                errno = ENOMEM;
+                update_result_errno( cpu, -1 );
+            }
+
+            break;
+        }
+        case SYS_clone:
         {
-            if ( ' ' == ( 0x7f & f[ i ] ) )
-                break;
-            *p++ = ( 0x7f & f[ i ] );
+            // can't create a new process or thread with this emulator
+
+            errno = EACCES;
+            update_result_errno( cpu, -1 );
+            break;
         }
-        if ( ' ' != t[ 0 ] )
+        case emulator_sys_rand: // rand64. returns an unsigned random number in a0
         {
-            *p++ = '.';
-            for ( int i = 0; i < 3; i++ )
+            tracer.Trace( "  syscall command generate random number\n" );
+            ACCESS_REG( REG_RESULT ) = (REG_TYPE) rand64();
+            break;
+        }
+        case emulator_sys_print_double: // print_double in a0
+        {
+            tracer.Trace( "  syscall command print double in a0\n" );
+            double d;
+            memcpy( &d, &ACCESS_REG( REG_ARG0 ), sizeof d );
+            printf( "%lf", d );
+            fflush( stdout );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_trace_instructions:
+        {
+            tracer.Trace( "  syscall command trace_instructions %d\n", ACCESS_REG( REG_ARG0 ) );
+#if !defined( _WIN32 ) && !defined( __APPLE__ ) // only on Linux can there be a parent emulator
+            uint64_t v = ACCESS_REG( REG_ARG0 );
+            syscall( 0x2002, 0 != v );
+#endif
+            ACCESS_REG( REG_RESULT ) = cpu.trace_instructions( 0 != ACCESS_REG( REG_ARG0 ) );
+            break;
+        }
+#if defined( X64OS ) || defined( X32OS )
+        case emulator_sys_checkpoint:
+        {
+            tracer.Trace( "  syscall command checkpoint\n" );
+            if ( 0 == g_acCheckpointFile[ 0 ] )
             {
-                if ( ' ' == ( 0x7f & t[ i ] ) )
-                    break;
-                *p++ = ( 0x7f & t[ i ] );
+                tracer.Trace( "  no checkpoint file was specified with -c; ignoring\n" );
+                update_result_errno( cpu, 0 );
+                break;
+            }
+
+            ACCESS_REG( REG_RESULT ) = 1; // the app sees 1 when it's resumed from the checkpoint
+            if ( save_checkpoint( cpu, g_acCheckpointFile ) )
+                update_result_errno( cpu, 0 );
+            else
+            {
+                errno = EIO;
+                update_result_errno( cpu, -1 );
             }
+            break;
         }
-        *p++ = 0;
-    } //make_filename
+#endif
+#if ( defined( X64OS ) || defined( X32OS ) ) && !defined( _WIN32 ) && !defined( X64OS_LIBRARY )
+        case emulator_sys_fork_server:
+        {
+            tracer.Trace( "  syscall command fork_server\n" );
+            if ( ( 0 != g_acForkServerInputs[ 0 ] ) && !g_forkServerStarted )
+                start_fork_server( cpu );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+#endif
+        case SYS_mmap:
+        {
+            // The gnu c runtime is ok with this failing -- it just allocates memory instead probably assuming it's an embedded system.
+            // Same for the gnu runtime with Rust.
+            // But golang actually needs this to succeed and return the requested address and this code doesn't support that.
 
-    // r0 and r1 are a 16-bit count of 128 byte records in CP/M 2.2. For CP/M 68K, reverse the byte ordering and add r2
+            REG_TYPE addr = ACCESS_REG( REG_ARG0 );
+            size_t length = ACCESS_REG( REG_ARG1 );
+            int prot = (int) ACCESS_REG( REG_ARG2 );
+            int flags = (int) ACCESS_REG( REG_ARG3 );
+            int fd = (int) ACCESS_REG( REG_ARG4 );
+            size_t offset = (size_t) ACCESS_REG( REG_ARG5 );
+            tracer.Trace( "  SYS_mmap. addr %llx, length %zd, protection %#x, flags %#x, fd %d, offset %zd\n", addr, length, prot, flags, fd, offset );
 
-    uint32_t GetRandomIOOffset() { return ( (uint32_t) this->r0 << 16 ) | ( (uint32_t) this->r1 << 8 ) | this->r2; }
+            if ( 0 != ( length & 0xfff ) )
+            {
+                // golang does this. golang runtime is kinda funny.
+                tracer.Trace( "  warning: mmap allocation length isn't 4k-page aligned\n" );
+                length = round_up( length, (size_t) 4096 );
+            }
 
-    void SetRandomIOOffset( uint32_t o )
-    {
-        this->r2 = ( 0xff & o );
-        this->r1 = ( 0xff & ( o >> 8 ) );
-        this->r0 = ( 0xff & ( o >> 16 ) );
-    } //SetRandomIOOffset
+            if ( 0 == addr )
+            {
+                if ( 0 == ( length & 0xfff ) )
+                {
+                    // 2 == MAP_PRIVATE, 0x20 == MAP_ANONYMOUS, 0x100 = MAP_FIXED
 
-    void SetRecordCount( FILE * fp )
-    {
-        // set rc to file size in 128 byte records if < 16k, else 128
-        uint32_t file_size = portable_filelen( fp );
-        if ( file_size >= ( 16 * 1024 ) ) // CP/M 2.2 does this and Whitesmith C's A80.COM and LNK.COM depend on it
-            this->rc = 128;
-        else
-        {
-            uint32_t tail_size = ( file_size % ( 16 * 1024 ) ); // won't matter because of 16k check above
-            this->rc = (uint8_t) ( tail_size / 128 );
-            if ( 0 != ( tail_size % 128 ) )
-                this->rc++;
+                    if ( ( 0 == ( 0x100 & flags ) ) && ( 0x22 == ( 0x22 & flags ) ) )
+                    {
+                        SIGNED_REG_TYPE result = (SIGNED_REG_TYPE) g_mmap.allocate( length );
+                        if ( 0 != result )
+                        {
+                            update_result_errno( cpu, result );
+                            break;
+                        }
+                    }
+                    else
+                        tracer.Trace( "  error: mmap flags %#x aren't supported\n", flags );
+                }
+                else
+                    tracer.Trace( "  error mmap length isn't 4k-page-aligned\n" );
+            }
+            else
+                tracer.Trace( "  mmap allocation at specific address isn't supported\n" );
+
+            tracer.Trace( "  mmap failed\n" );
+            errno = ENOMEM;
+            update_result_errno( cpu, -1 );
+            break;
         }
-    } //SetRecordCount
+#if !defined(OLDGCC) // the syscalls below aren't invoked from the old g++ compiler and runtime
+        case SYS_openat:
+        {
+            tracer.Trace( "  syscall command SYS_openat\n" );
 
-    void UpdateSequentialOffset( uint32_t offset )
-    {
-        cr = (uint8_t) ( ( offset % ( (uint32_t) 16 * 1024 ) ) / (uint32_t) 128 );
-        ex = (uint8_t) ( ( offset % ( (uint32_t) 512 * 1024 ) ) / ( (uint32_t) 16 * 1024 ) );
-        s2 = (uint8_t) ( offset / ( (uint32_t) 512 * 1024 ) );
-        #ifdef WATCOM
-        tracer.Trace( "  new offset: %u, s2 %u, ex %u, cr %u\n", (uint16_t) offset, (uint16_t) s2, (uint16_t) ex, (uint16_t) cr );
-        #else
-        tracer.Trace( "  new offset: %u, s2 %u, ex %u, cr %u\n", offset, s2, ex, cr );
-        #endif
-    } //UpdateSequentialOffset
+            // a0: directory. a1: asciiz string of file to open. a2: flags. a3: mode
+            int directory = (int) ACCESS_REG( REG_ARG0 );
 
-    uint32_t GetSequentialOffset()
-    {
-        uint32_t curr = (uint32_t) cr * 128;
-        curr += ( (uint32_t) ex * ( (uint32_t) 16 * 1024 ) );
-        curr += ( (uint32_t) s2 * ( (uint32_t) 512 * 1024 ) );
-        return curr;
-    } //GetSequentialOffset
+#ifdef __APPLE__
+            if ( -100 == directory )
+                directory = -2; // Linux vs. MacOS
+#endif //__APPLE__
+            const char * pname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            int flags = (int) ACCESS_REG( REG_ARG2 );
+            int mode = (int) ACCESS_REG( REG_ARG3 );
+            int64_t descriptor = 0;
+            tracer.Trace( "  open dir %d, flags %x, mode %x, file '%s'\n", directory, flags, mode, pname );
+            int original_flags = flags;
+            flags = translate_open_flags( flags );
 
-    void Trace( bool justArg = false ) // justArg is the first 16 bytes at app startup
-    {
-        tracer.Trace( "  FCB at address %04x:\n", (uint32_t) ( (uint8_t * ) this - memory.data() ) );
-        tracer.Trace( "    drive:    %#x == %c\n", dr, ( 0 == dr ) ? 'A' : 'A' + dr - 1 );
-        tracer.Trace( "    filename: '%c%c%c%c%c%c%c%c'\n", 0x7f & f[0], 0x7f & f[1], 0x7f & f[2], 0x7f & f[3],
-                                                            0x7f & f[4], 0x7f & f[5], 0x7f & f[6], 0x7f & f[7] );
-        tracer.Trace( "    filetype: '%c%c%c'\n", 0x7f & t[0], 0x7f & t[1], 0x7f & t[2] );
-        tracer.Trace( "    R S A:    %d %d %d\n", 0 != ( 0x80 & t[0] ), 0 != ( 0x80 & t[1] ), 0 != ( 0x80 & t[2] ) );
-        tracer.Trace( "    ex:       %d\n", ex );
-        tracer.Trace( "    s1:       %u\n", s1 );
-        tracer.Trace( "    s2:       %u\n", s2 );
-        tracer.Trace( "    rc:       %u\n", rc );
-        if ( !justArg )
-        {
-            tracer.Trace( "    cr:       %u\n", cr );
-            tracer.Trace( "    r0:       %u\n", r0 );
-            tracer.Trace( "    r1:       %u\n", r1 );
-            tracer.Trace( "    r2:       %u\n", r2 );
-        }
-    } //Trace
-};
+            if ( vfs_open( cpu, (int) ACCESS_REG( REG_ARG0 ), pname, original_flags ) )
+                break;
 
-struct BasePageCPM // base page for cp/m -- the first 256 bytes in memory
-{
-    uint32_t lowest_tpa;                // 0
-    uint32_t highest_tpa;               // 4
-    uint32_t start_text;                // 8
-    uint32_t cb_text;                   // c
-    uint32_t start_data;                // 10
-    uint32_t cb_data;                   // 14
-    uint32_t start_bss;                 // 18
-    uint32_t cb_bss;                    // 1c
-    uint32_t cb_after_bss;              // 20
-    uint8_t drive;                      // 24 where the app was loaded
-    uint8_t reserved[ 19 ];             // 25 reserved. used for exit trap when an app returns from _start
-    FCBCPM68K secondFCB;                // 38
-    FCBCPM68K firstFCB;                 // 5c
-    uint8_t cb_command_tail;            // 80 also start of default DMA buffer
-    uint8_t command_tail[ 127 ];        // 81
+#ifdef _WIN32
+            bool opendir = is_o_directory_set( original_flags );
+            tracer.Trace( "  opendir: %u\n", opendir );
 
-    void Trace()
-    {
-        tracer.Trace( "base page:\n" );
-        tracer.Trace( "  lowest tpa:       %lx\n", swap_endian32( lowest_tpa ) );
-        tracer.Trace( "  highest tpa:      %lx\n", swap_endian32( highest_tpa ) );
-        tracer.Trace( "  start_text:       %lx\n", swap_endian32( start_text ) );
-        tracer.Trace( "  cb_text:          %lx\n", swap_endian32( cb_text ) );
-        tracer.Trace( "  start_data:       %lx\n", swap_endian32( start_data ) );
-        tracer.Trace( "  cb_data:          %lx\n", swap_endian32( cb_data ) );
-        tracer.Trace( "  start_bss:        %lx\n", swap_endian32( start_bss ) );
-        tracer.Trace( "  cb_bss:           %lx\n", swap_endian32( cb_bss ) );
-        tracer.Trace( "  cb_after_bss:     %lx\n", swap_endian32( cb_after_bss ) );
-        tracer.Trace( "  cb_command_tail:  %x\n",  cb_command_tail );
-        tracer.TraceBinaryData( command_tail, 127, 4 );
-    }
-};
+            // bugbug: directory ignored and assumed to be local (-100)
 
-#pragma pack(pop)
+            strcpy( acPath, pname );
+            slash_to_backslash( acPath );
 
-static int symbol_compare_cpm( const void * a, const void * b )
-{
-    SymbolEntryCPM * pa = (SymbolEntryCPM *) a;
-    SymbolEntryCPM * pb = (SymbolEntryCPM *) b;
+            DWORD attr = GetFileAttributesA( acPath );
+            if ( opendir && ( INVALID_FILE_ATTRIBUTES != attr ) && ( attr & FILE_ATTRIBUTE_DIRECTORY ) )
+            {
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    FindClose( g_hFindFirst );
+                    g_hFindFirst = INVALID_HANDLE_VALUE;
+                }
+                strcpy( g_acFindFirstPattern, acPath );
+                size_t len = strlen( g_acFindFirstPattern );
+                if ( '\\' != g_acFindFirstPattern[ len - 1 ] )
+                    strcat( g_acFindFirstPattern, "\\" );
+                strcat( g_acFindFirstPattern, "*.*" );
+                descriptor = findFirstDescriptor;
+            }
+            else
+            {
+#ifdef M68
+                if ( is_o_creat_set( original_flags ) )
+                    mode = _S_IREAD | _S_IWRITE; // __mc68000__ passes user-related flags that conflict with these flags
+#endif //M68
+                tracer.Trace( "  final name %s, flags %#x, mode %#x\n", pname, flags, mode );
+                descriptor = _open( pname, flags, mode );
+            }
+#else // _WIN32
 
-    if ( pa->value > pb->value )
-        return 1;
-    if ( pa->value == pb->value )
-        return 0;
-    return -1;
-} //symbol_compare_cpm
+            tracer.Trace( "  final directory %d, flags %#x, mode %#x passed to openat\n", directory, flags, mode );
+            descriptor = openat( directory, pname, flags, mode );
+            track_open_file( (int) descriptor, directory, pname, flags, mode );
+#endif // _WIN32
+            update_result_errno( cpu, (int) descriptor );
+            break;
+        }
+        case SYS_sysinfo:
+        {
+#if defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
+            errno = EACCES;
+            update_result_errno( cpu, -1 );
+#else
+            int result = sysinfo( (struct sysinfo *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) );
+            update_result_errno( cpu, result );
+#endif // defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
+            break;
+        }
+        case SYS_newfstatat:
+        {
+#if 0
+            tracer.Trace( "  offsetof st_dev: %d\n", (int) offsetof( struct stat_linux_syscall, st_dev ) );
+            tracer.Trace( "  offsetof st_ino: %d\n", (int) offsetof( struct stat_linux_syscall, st_ino ) );
+            tracer.Trace( "  offsetof st_nlink: %d\n", (int) offsetof( struct stat_linux_syscall, st_nlink ) );
+            tracer.Trace( "  offsetof st_mode: %d\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
+            tracer.Trace( "  offsetof st_uid: %d\n", (int) offsetof( struct stat_linux_syscall, st_uid ) );
+            tracer.Trace( "  offsetof st_gid: %d\n", (int) offsetof( struct stat_linux_syscall, st_gid ) );
+            tracer.Trace( "  offsetof st_rdev: %d\n", (int) offsetof( struct stat_linux_syscall, st_rdev ) );
+            tracer.Trace( "  offsetof st_size: %d\n", (int) offsetof( struct stat_linux_syscall, st_size ) );
+#endif
 
-bool write_fcb_arg( FCBCPM68K * arg, char * pc )
-{
-    if ( ':' == pc[ 1 ] )
-    {
-        if ( pc[0] > 'P' || pc[0] < 'A' )
-            return false; // don't write arguments that don't look like filenames
+            const char * path = (char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            tracer.Trace( "  syscall command SYS_newfstatat, id %lld, path '%s', flags %llx\n", (uint64_t) ACCESS_REG( REG_ARG0 ), path, (uint64_t) ACCESS_REG( REG_ARG3 ) );
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            int result = 0;
 
-        arg->dr = 1 + pc[0] - 'A';
-        pc += 2;
-    }
+#ifdef _WIN32
+            // ignore the folder argument on Windows
+            struct stat_linux_syscall local_stat = {0};
+            if ( !vfs_stat( descriptor, path, local_stat, result ) )
+                result = fill_pstat_windows( descriptor, & local_stat, path );
+            if ( 0 == result )
+            {
+                #ifdef X64OS
+                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+                    pout->st_dev = local_stat.st_dev;
+                    pout->st_ino = local_stat.st_ino;
+                    pout->st_mode = local_stat.st_mode;
+                    pout->st_nlink = local_stat.st_nlink;
+                    pout->st_uid = local_stat.st_uid;
+                    pout->st_gid = local_stat.st_gid;
+                    pout->st_rdev = local_stat.st_rdev;
+                    pout->st_size = local_stat.st_size;
+                    pout->st_blksize = local_stat.st_blksize;
+                    pout->st_blocks = local_stat.st_blocks;
+                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
+                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
+                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) pout->st_size, (int) offsetof( struct stat_linux_syscall_x64, st_size ) );
+                    pout->swap_endianness();
+                    tracer.Trace( "post-swap mode: %#x\n", pout->st_mode );
+                #else // X64OS
+                    size_t cbStat = sizeof( struct stat_linux_syscall );
+                    tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
+                    tracer.Trace( "  offsetof st_mode: %d\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
+                    tracer.Trace( "  offsetof st_blksize: %d\n", (int) offsetof( struct stat_linux_syscall, st_blksize ) );
+                    tracer.Trace( "  st_dev: %#lx\n", local_stat.st_dev );
+                    tracer.Trace( "  st_ino: %#lx\n", local_stat.st_ino );
+                    tracer.Trace( "  st_mode: %#x\n", local_stat.st_mode );
+                    tracer.Trace( "  st_nlink: %#x\n", local_stat.st_nlink );
+                    tracer.Trace( "  st_uid: %#x\n", local_stat.st_uid );
+                    tracer.Trace( "  st_gid: %#x\n", local_stat.st_gid );
+                    tracer.Trace( "  st_rdev: %#lx\n", local_stat.st_rdev );
+                    tracer.Trace( "  st_size: %#lx\n", local_stat.st_size );
+                    tracer.Trace( "  st_blksize: %#llx\n", local_stat.st_blksize );
 
-    char * dot = strchr( pc, '.' );
-    if ( dot )
-    {
-        memcpy( & ( arg->f ), pc, get_min( (size_t) 8, (size_t) ( dot - pc ) ) );
-        memcpy( & ( arg->t ), dot + 1, get_min( (size_t) 3, strlen( dot + 1 ) ) );
-    }
-    else
-        memcpy( & ( arg->f ), pc, get_min( (size_t) 8, strlen( pc ) ) );
+                    local_stat.swap_endianness();
+                    memcpy( cpu.getmem( ACCESS_REG( REG_ARG2 ) ), & local_stat, cbStat );
+                #endif // X64OS
+            }
+            else
+                tracer.Trace( "  fill_pstat_windows failed\n" );
+#else //_WIN32
+            tracer.Trace( "  sizeof struct stat: %zd\n", sizeof( struct stat ) );
+            struct stat local_stat = {0};
+            int flags = (int) ACCESS_REG( REG_ARG3 );
+            if ( !vfs_stat( descriptor, path, local_stat, result ) )
+            {
+                #ifdef __APPLE__
+                    if ( -100 == descriptor ) // current directory
+                        descriptor = -2;
+                    if ( EMULATOR_AT_SYMLINK_NOFOLLOW & flags )
+                        flags = AT_SYMLINK_NOFOLLOW; // 0x20 instead of 0x100 on macOS
+                    else if ( EMULATOR_AT_SYMLINK_FOLLOW & flags )
+                        flags = AT_SYMLINK_FOLLOW; // 0x40 instead of 0x400 on macOS
+                    else
+                        flags = 0; // no other flags are supported on macOS
+                    tracer.Trace( "  translated flags for MacOS: %x\n", flags );
+                    if ( 0 == path[ 0 ] )
+                        result = fstat( descriptor, & local_stat );
+                    else
+                        result = fstatat( descriptor, path, & local_stat, flags );
+                #else //__APPLE__
+                    result = fstatat( descriptor, path, & local_stat, flags );
+                #endif //__APPLE__
+            }
 
-    return true;
-} //write_fcb_arg
+            if ( 0 == result )
+            {
+                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
 
-char get_next_kbd_char()
-{
-    return (char) ConsoleConfiguration::portable_getch();
-} //get_next_kbd_char
+                tracer.Trace( "  file size in bytes: %d, offsetof st_size: %d\n", (int) local_stat.st_size, (int) offsetof( struct stat_linux_syscall, st_size ) );
+                tracer.Trace( "  local mode: %#x\n", local_stat.st_mode );
 
-bool is_kbd_char_available()
-{
-    return g_consoleConfig.portable_kbhit();
-} //is_kbd_char_available
+                #ifdef X64OS
+                    struct stat_linux_syscall_x64 * pout = (struct stat_linux_syscall_x64 *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+                    tracer.Trace( "  using struct stat_linux_syscall_x64\n" );
+                #else
+                    struct stat_linux_syscall * pout = (struct stat_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+                    tracer.Trace( "  using struct stat_linux_syscall\n" );
+                #endif
 
-bool cpm_read_console( char * buf, size_t bufsize, uint8_t & out_len )
-{
-    char ch = 0;
-    out_len = 0;
-    while ( out_len < (uint8_t) bufsize )
-    {
-        ch = (char) get_next_kbd_char();
-        tracer.Trace( "  get_next_kbd_char read character %02x -- '%c'\n", ch, printable( ch ) );
+                pout->st_dev = local_stat.st_dev;
+                pout->st_ino = local_stat.st_ino;
+                pout->st_mode = local_stat.st_mode;
+                pout->st_nlink = local_stat.st_nlink;
+                pout->st_uid = local_stat.st_uid;
+                pout->st_gid = local_stat.st_gid;
 
-        // CP/M read console buffer treats these control characters as special: c, e, h, j, m, r, u, x
-        // per http://www.gaby.de/cpm/manuals/archive/cpm22htm/ch5.htm
-        // Only c, h, j, and m are currently handled correctly.
-        // ^c means exit the currently running app in CP/M if it's the first character in the buffer
+                #ifndef X64OS
+                    if ( 2 == sizeof( local_stat.st_rdev ) )
+                        pout->st_rdev = (uint16_t) local_stat.st_rdev; // on 68000 rdev is an int16_t. avoid sign extension
+                    else if ( 4 == sizeof( local_stat.st_rdev ) )
+                        pout->st_rdev = (uint32_t) local_stat.st_rdev;
+                    else
+                        pout->st_rdev = local_stat.st_rdev;
+                #endif
 
-        if ( ( 3 == ch ) && ( 0 == out_len ) )
-            return true;
+                pout->st_size = local_stat.st_size;
+                pout->st_blksize = local_stat.st_blksize;
+                pout->st_blocks = local_stat.st_blocks;
 
-        if ( '\n' == ch || '\r' == ch )
-            break;
+                #if defined( __APPLE__ )
+                    pout->st_atim.tv_sec = local_stat.st_atimespec.tv_sec;
+                    pout->st_atim.tv_nsec = local_stat.st_atimespec.tv_nsec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtimespec.tv_sec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtimespec.tv_nsec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctimespec.tv_sec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctimespec.tv_nsec;
+                #elif defined( __mc68000__ )
+                    pout->st_atim.tv_sec = local_stat.st_atime;
+                    pout->st_mtim.tv_sec = local_stat.st_mtime;
+                    pout->st_ctim.tv_sec = local_stat.st_ctime;
+                #else
+                    pout->st_atim.tv_sec = local_stat.st_atim.tv_sec;
+                    pout->st_mtim.tv_sec = local_stat.st_mtim.tv_sec;
+                    pout->st_ctim.tv_sec = local_stat.st_ctim.tv_sec;
 
-        if ( 0x7f == ch || 8 == ch ) // backspace (it's not 8 for some reason)
-        {
-            if ( out_len > 0 )
-            {
-                printf( "\x8 \x8" );
-                fflush( stdout );
-                out_len--;
+                    pout->st_atim.tv_nsec = local_stat.st_atim.tv_nsec;
+                    pout->st_mtim.tv_nsec = local_stat.st_mtim.tv_nsec;
+                    pout->st_ctim.tv_nsec = local_stat.st_ctim.tv_nsec;
+                #endif // __APPLE__ || __mc68000__
+
+                tracer.Trace( "  sizeof output structure: %u\n", (int) sizeof( *pout ) );
+                tracer.Trace( "  file size %zd, isdir %s\n", local_stat.st_size, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
+                tracer.Trace( "  pre-swap file size %d, mode %#x, isdir %s\n", (int) local_stat.st_size, local_stat.st_mode, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
+                pout->swap_endianness();
+                tracer.Trace( "  post-swap file size %d, mode %#x\n", (int) pout->st_size, pout->st_mode );
             }
+#endif //_WIN32
+            update_result_errno( cpu, result );
+            break;
         }
-        else
+        case SYS_chdir:
         {
-            send_character( ch );
-            fflush( stdout );
-            buf[ out_len++ ] = ch;
-        }
-    }
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            tracer.Trace( "  syscall command SYS_chdir path %s\n", path );
+            if ( vfs_chdir( cpu, path ) )
+                break;
 
-    return false;
-} //cpm_read_console
+#ifdef _WIN32
+            int result = _chdir( path );
+#else
+            int result = chdir( path );
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_mkdir:
+        {
+            int directory = -100;
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            if ( vfs_mkdir( cpu, directory, path ) )
+                break;
 
-bool read_symbols_cpm( FILE * fp, HeaderCPM68K & head, uint32_t text_base, uint32_t data_base, uint32_t bss_base )
-{
-    if ( 0 != head.cb_symbols ) // if they exist, load symbols so disassembly and hard termination can show them
-    {
-        uint32_t symbol_count = head.cb_symbols / sizeof( SymbolEntryCPM );
-        g_cpmSymbols.resize( symbol_count );
-        fseek( fp, (long) sizeof( head ) + head.cb_text + head.cb_data, SEEK_SET );
-        size_t read = fread( g_cpmSymbols.data(), head.cb_symbols, 1, fp );
-        if ( 1 != read )
-        {
-            printf( "can't read symbol data of cp/m 68k image file\n" );
-            return false;
+#ifdef _WIN32 // on windows ignore the directory and mode arguments
+            tracer.Trace( "  syscall command SYS_mkdir path %s\n", path );
+            int result = _mkdir( path );
+#else
+#ifdef __APPLE__
+            if ( -100 == directory )
+                directory = -2;
+#endif
+            mode_t mode = (mode_t) ACCESS_REG( REG_ARG1 );
+            tracer.Trace( "  syscall command SYS_mkdir dir %d, path %s, mode %x\n", directory, path, mode );
+            int result = mkdirat( directory, path, mode );
+#endif
+            update_result_errno( cpu, result );
+            break;
         }
-
-        for ( uint32_t i = 0; i < symbol_count; i++ )
+        case SYS_mkdirat:
         {
-            SymbolEntryCPM & sym = g_cpmSymbols[ i ];
-            sym.swap_endianness();
-            if ( sym.type & 0x400 )
-                sym.value += data_base;
-            else if ( sym.type & 0x200 )
-                sym.value += text_base;
-            else if ( sym.type & 0x100 )
-                sym.value += bss_base;
+            int directory = (int) ACCESS_REG( REG_ARG0 );
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            if ( vfs_mkdir( cpu, directory, path ) )
+                break;
 
-            // the DR tools create some symbols that aren't null-terminated. this is valid for internal symbols but difficult to work with.
-            sym.name[ 7 ] = 0;
+#ifdef _WIN32 // on windows ignore the directory and mode arguments
+            tracer.Trace( "  syscall command SYS_mkdirat path %s\n", path );
+            int result = _mkdir( path );
+#else
+#ifdef __APPLE__
+            if ( -100 == directory )
+                directory = -2;
+#endif
+            mode_t mode = (mode_t) ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  syscall command SYS_mkdirat dir %d, path %s, mode %x\n", directory, path, mode );
+            int result = mkdirat( directory, path, mode );
+#endif
+            update_result_errno( cpu, result );
+            break;
         }
-
-        // add a final entry with a very large value so the lookup doesn't have to worry about that edge case
-
-        SymbolEntryCPM last;
-        strcpy( last.name, "!last" );
-        last.type = 0;
-        last.value = 0xffffffff;
-        g_cpmSymbols.push_back( last );
-
-        my_qsort( g_cpmSymbols.data(), g_cpmSymbols.size(), sizeof( SymbolEntryCPM ), symbol_compare_cpm );
-
-        tracer.Trace( "symbols:\n" );
-        for ( uint32_t i = 0; i < symbol_count; i++ )
-            g_cpmSymbols[ i ].trace();
-    }
-
-    return true;
-} //read_symbols_cpm
-
-bool handle_relocations_cpm( FILE * fp, HeaderCPM68K & head, uint32_t text_base, uint32_t data_base, uint32_t bss_base )
-{
-    if ( 0 == head.relocation_flag ) // 0 means they exist
-    {
-        uint16_t * pimage = (uint16_t *) ( memory.data() + text_base );
-        uint32_t relocation_words = ( head.cb_text + head.cb_data ) / 2;
-        vector<uint16_t> relocations;
-        relocations.resize( relocation_words );
-        fseek( fp, (long) sizeof( head ) + head.cb_text + head.cb_data + head.cb_symbols, SEEK_SET );
-        size_t read = fread( relocations.data(), relocation_words * 2, 1, fp );
-        if ( 1 != read )
+        case SYS_rmdir:
         {
-            printf( "can't read relocations data of cp/m 68k image file\n" );
-            return false;
-        }
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            tracer.Trace( "  syscall command SYS_rmdir path %s\n", path );
+            if ( vfs_unlink( cpu, -100, path, true ) )
+                break;
 
-        bool longword_mode = false;
+#ifdef _WIN32 // on windows ignore the directory and flags arguments
+            int result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
+#else
+            int directory = -100;
+            int flags = EMULATOR_AT_REMOVEDIR;
+#ifdef __APPLE__
+            if ( -100 == directory )
+                directory = -2;
+            if ( EMULATOR_AT_REMOVEDIR == flags )
+                flags = AT_REMOVEDIR;
+#endif
+            int result = unlinkat( directory, path, flags );
+#endif // _WIN32
 
-        for ( uint32_t i = 0; i < relocation_words; i++ )
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_unlinkat:
         {
-            uint16_t r = 7 & swap_endian16( relocations[ i ] );
+            int directory = (int) ACCESS_REG( REG_ARG0 );
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            int flags = (int) ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  syscall command SYS_unlinkat dir %d, path %s, flags %x\n", directory, path, flags );
+            if ( vfs_unlink( cpu, directory, path, 0 != ( EMULATOR_AT_REMOVEDIR & flags ) ) )
+                break;
 
-            if ( 1 == r )
-            {
-                //tracer.Trace( "updating relocation offset %u with data_base %#x, longword_mode %u\n", i, data_base, longword_mode );
-                if ( longword_mode )
-                {
-                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
-                    *pfull = swap_endian32( data_base + swap_endian32( *pfull ) );
-                    longword_mode = false;
-                }
-                else
-                    pimage[ i ] = swap_endian16( ( 0xffff & data_base ) + swap_endian16( pimage[ i ] ) );
-            }
-            else if ( 2 == r )
+#ifdef _WIN32 // on windows ignore the directory and flags arguments
+            DWORD attr = GetFileAttributesA( path );
+            int result = 0;
+            if ( INVALID_FILE_ATTRIBUTES != result )
             {
-                //tracer.Trace( "updating relocation offset %u with text_base %#x, longword_mode %u\n", i, text_base, longword_mode );
-                if ( longword_mode )
-                {
-                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
-                    *pfull = swap_endian32( text_base + swap_endian32( *pfull ) );
-                    longword_mode = false;
-                }
+                if ( attr & FILE_ATTRIBUTE_DIRECTORY )
+                    result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
                 else
-                    pimage[ i ] = swap_endian16( (uint16_t) text_base + swap_endian16( pimage[ i ] ) );
+                    result = remove( path );
             }
-            else if ( 3 == r )
+#else
+#ifdef __APPLE__
+            if ( -100 == directory )
+                directory = -2;
+            if ( EMULATOR_AT_REMOVEDIR == flags )
+                flags = AT_REMOVEDIR;
+#endif // __APPLE__
+            int result = unlinkat( directory, path, flags );
+#endif //_WIN32
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_unlink:
+        {
+            const char * path = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            tracer.Trace( "  syscall command SYS_unlink path %#llx '%s'\n", (uint64_t) path, path );
+            if ( vfs_unlink( cpu, -100, path, false ) )
+                break;
+
+#ifdef _WIN32
+            DWORD attr = GetFileAttributesA( path );
+            int result = 0;
+            if ( INVALID_FILE_ATTRIBUTES != result )
             {
-                //tracer.Trace( "updating relocation offset %u with bss_base %#x, longword_mode %u\n", i, bss_base, longword_mode );
-                if ( longword_mode )
-                {
-                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
-                    *pfull = swap_endian32( bss_base + swap_endian32( *pfull ) );
-                    longword_mode = false;
-                }
+                if ( attr & FILE_ATTRIBUTE_DIRECTORY )
+                    result = _rmdir( path ); // unlink will fail with error 13 "permission denied", so use rmdir instead
                 else
-                    pimage[ i ] = swap_endian16( (uint16_t) bss_base + swap_endian16( pimage[ i ] ) );
+                    result = remove( path );
             }
-            else if ( 5 == r )
-                longword_mode = true;
-            else
-                longword_mode = false;
+#else
+            int result = unlink( path );
+#endif
+            update_result_errno( cpu, result );
+            break;
         }
-    }
-
-    return true;
-} //handle_relocations_cpm
-
-// bdos 59 is invoked by apps including DDT
-
-bool load59_cpm68k( FILE *fp, uint32_t lowestAddress, uint32_t highestAddress, uint16_t loaderControlFlags, uint32_t & basePage, uint32_t & stackPointer )
-{
-    if ( 0 != loaderControlFlags )
-    {
-        tracer.Trace( "ERROR: only loading to lowest address is implemented\n" );
-        printf( "ERROR: only loading to lowest address is implemented\n" );
-        return false;
-    }
-
-    g_cpmSymbols.resize( 0 ); // throw away parent symbols
-    uint32_t child_memory_size = highestAddress + 1 - lowestAddress;
+        case SYS_uname:
+        {
+            struct utsname_syscall * pname = (struct utsname_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            strcpy( pname->sysname, "syscall" );
+            strcpy( pname->nodename, "localhost" );
+            strcpy( pname->release, "19.69.420" );
+            strcpy( pname->version, "#1" );
+            strcpy( pname->machine, "aarch64" );
+            strcpy( pname->domainname, "localdomain" );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_getrusage:
+        {
+            int who = (int) ACCESS_REG( REG_ARG0 );
+#if defined( M68 )
+            struct linux_rusage_syscall32 *prusage = (struct linux_rusage_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+#elif defined( X32OS )
+            struct linux_rusage_syscall_x32 *prusage = (struct linux_rusage_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+#else //M68 || X32OS
+            struct linux_rusage_syscall *prusage = (struct linux_rusage_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            tracer.Trace( "  sizeof linux_rusage_syscall: %zd\n", sizeof( struct linux_rusage_syscall ) );
+#if defined( SPARCOS ) || defined( X32OS )
+            memset( prusage, 0, 88 ); // 32-bit sparc binaries use fulls-sized times but are only 88 bytes long; through ru_majflt, not starting with ru_nswap
+#else
+            memset( prusage, 0, sizeof( struct linux_rusage_syscall ) );
+#endif //SPARCOS
+#endif //M68 || X32OS
 
-    fseek( fp, (long) 0, SEEK_SET );
-    HeaderCPM68K head;
-    size_t read = fread( &head, sizeof( head ), 1, fp );
-    if ( 1 != read )
-    {
-        printf( "can't read header of cp/m 68k image file\n" );
-        return false;
-    }
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+            {
+                // only user time is reported; the app never spends time in a kernel
 
-    head.swap_endianness();
-    head.trace();
+                memset( prusage, 0, sizeof( *prusage ) );
+                uint64_t us = ( 0 == who ) ? virtual_cpu_ns( cpu ) / 1000 : 0;
+#if defined( X32OS )
+                prusage->ru_utime.tv_sec = swap_endian32( (uint32_t) ( us / 1000000 ) );
+                prusage->ru_utime.tv_usec = swap_endian32( (uint32_t) ( us % 1000000 ) );
+#else
+                prusage->ru_utime.tv_sec = swap_endian64( us / 1000000 );
+                prusage->ru_utime.tv_usec = swap_endian64( us % 1000000 );
+#endif
+                update_result_errno( cpu, 0 );
+                break;
+            }
+#endif
 
-    if ( 0x601a != head.signature )
-    {
-        printf( "header of cp/m 68k image file isn't standard 0x601a:\n" );
-        return false;
-    }
-
-    if ( 0 == lowestAddress )    // ddt loads debugged apps at 0. Don't overwrite trap vectors; use a standard address
-        lowestAddress = 0x7a00;
+            if ( 0 == who ) // RUSAGE_SELF
+            {
+#ifdef _WIN32
+                FILETIME ftCreation, ftExit, ftKernel, ftUser;
+                if ( GetProcessTimes( GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser ) )
+                {
+                    uint64_t utotal = ( ( (uint64_t) ftUser.dwHighDateTime << 32 ) + ftUser.dwLowDateTime ) / 10; // 100ns to microseconds
+#if defined( M68 )
+                    prusage->ru_utime.tv_sec = utotal / 1000000;
+                    prusage->ru_utime.tv_usec = (uint32_t) ( utotal % 1000000 );
+                    prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
+                    prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
+#elif defined( X32OS )
+                    prusage->ru_utime.tv_sec = (uint32_t) ( utotal / 1000000 );
+                    prusage->ru_utime.tv_usec = (uint32_t) ( utotal % 1000000 );
+                    prusage->ru_utime.tv_sec = swap_endian32( prusage->ru_utime.tv_sec );
+                    prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
+#else //M68 // SPARCOS seems to use the 64 bit structures
+                    prusage->ru_utime.tv_sec = utotal / 1000000;
+                    prusage->ru_utime.tv_usec = utotal % 1000000;
+                    prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
+                    prusage->ru_utime.tv_usec = swap_endian64( prusage->ru_utime.tv_usec );
+#endif //M68
+                    uint64_t stotal = ( ( (uint64_t) ftKernel.dwHighDateTime << 32 ) + ftKernel.dwLowDateTime ) / 10;
+#ifdef M68
+                    prusage->ru_stime.tv_sec = stotal / 1000000;
+                    prusage->ru_stime.tv_usec = (uint32_t) ( stotal % 1000000 );
+                    prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
+                    prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
+#elif defined( X32OS )
+                    prusage->ru_stime.tv_sec = (uint32_t) ( stotal / 1000000 );
+                    prusage->ru_stime.tv_usec = (uint32_t) ( stotal % 1000000 );
+                    prusage->ru_stime.tv_sec = swap_endian32( prusage->ru_stime.tv_sec );
+                    prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
+#else //M68 or X32OS
+                    prusage->ru_stime.tv_sec = stotal / 1000000;
+                    prusage->ru_stime.tv_usec = stotal % 1000000;
+                    prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
+                    prusage->ru_stime.tv_usec = swap_endian64( prusage->ru_stime.tv_usec );
+#endif //M68
+                }
+                else
+                    tracer.Trace( "  unable to GetProcessTimes, error %d\n", GetLastError() );
+#else //_WIN32
+                struct rusage local_rusage;
+                getrusage( who, &local_rusage ); // on 32-bit systems fields are 32 bit
+#if defined( M68 )
+                prusage->ru_utime.tv_sec = local_rusage.ru_utime.tv_sec;
+                prusage->ru_utime.tv_usec = (uint32_t) local_rusage.ru_utime.tv_usec;
+                prusage->ru_stime.tv_sec = local_rusage.ru_stime.tv_sec;
+                prusage->ru_stime.tv_usec = (uint32_t) local_rusage.ru_stime.tv_usec;
+                prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
+                prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
+                prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
+                prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
+#elif defined( X32OS )
+                prusage->ru_utime.tv_sec = (uint32_t) local_rusage.ru_utime.tv_sec;
+                prusage->ru_utime.tv_usec = (uint32_t) local_rusage.ru_utime.tv_usec;
+                prusage->ru_stime.tv_sec = (uint32_t) local_rusage.ru_stime.tv_sec;
+                prusage->ru_stime.tv_usec = (uint32_t) local_rusage.ru_stime.tv_usec;
+                prusage->ru_utime.tv_sec = swap_endian32( prusage->ru_utime.tv_sec );
+                prusage->ru_utime.tv_usec = swap_endian32( prusage->ru_utime.tv_usec );
+                prusage->ru_stime.tv_sec = swap_endian32( prusage->ru_stime.tv_sec );
+                prusage->ru_stime.tv_usec = swap_endian32( prusage->ru_stime.tv_usec );
+#else //M68 or X32OS
+                prusage->ru_utime.tv_sec = local_rusage.ru_utime.tv_sec;
+                prusage->ru_utime.tv_usec = local_rusage.ru_utime.tv_usec;
+                prusage->ru_stime.tv_sec = local_rusage.ru_stime.tv_sec;
+                prusage->ru_stime.tv_usec = local_rusage.ru_stime.tv_usec;
+                prusage->ru_utime.tv_sec = swap_endian64( prusage->ru_utime.tv_sec );
+                prusage->ru_utime.tv_usec = swap_endian64( prusage->ru_utime.tv_usec );
+                prusage->ru_stime.tv_sec = swap_endian64( prusage->ru_stime.tv_sec );
+                prusage->ru_stime.tv_usec = swap_endian64( prusage->ru_stime.tv_usec );
+#if ! ( defined( __mc68000__ ) || defined( X32OS ) )
+                prusage->ru_maxrss = local_rusage.ru_maxrss;
+                prusage->ru_ixrss = local_rusage.ru_ixrss;
+                prusage->ru_idrss = local_rusage.ru_idrss;
+                prusage->ru_isrss = local_rusage.ru_isrss;
+                prusage->ru_minflt = local_rusage.ru_minflt;
+                prusage->ru_majflt = local_rusage.ru_majflt;
+#ifndef SPARCOS // SPARC on Linux seems to use a structure that ends at ru_majflt
+                prusage->ru_nswap = local_rusage.ru_nswap;
+                prusage->ru_inblock = local_rusage.ru_inblock;
+                prusage->ru_oublock = local_rusage.ru_oublock;
+                prusage->ru_msgsnd = local_rusage.ru_msgsnd;
+                prusage->ru_msgrcv = local_rusage.ru_msgrcv;
+                prusage->ru_nsignals = local_rusage.ru_nsignals;
+                prusage->ru_nvcsw = local_rusage.ru_nvcsw;
+                prusage->ru_nivcsw = local_rusage.ru_nivcsw;
+#endif //SPARCOS
+#endif //__mc68000__
+#endif //M68
+#endif //_WIN32
+            }
+            else
+                tracer.Trace( "  unsupported request for who %u\n", who );
 
-    uint32_t text_base;
-    if ( 0 != head.relocation_flag ) // 0 means they exist, != 0 means they don't exist
-        text_base = head.text_start;
-    else
-        text_base = lowestAddress + 0x100; // leave room for the base page
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_futex:
+        {
+            if ( !cpu.is_address_valid( ACCESS_REG( REG_ARG0 ) ) ) // sometimes it's malformed on arm64. not sure why yet.
+            {
+                tracer.Trace( "futex pointer in reg 0 is malformed\n" );
+                ACCESS_REG( REG_RESULT ) = 0;
+                break;
+            }
 
-    uint32_t image_size = head.cb_text + head.cb_data + head.cb_bss;
-    basePage = lowestAddress;
-    stackPointer = highestAddress & 0xfffffffe; // make sure it's 2-byte aligned
-    BasePageCPM * pbasepage = (BasePageCPM *) ( memory.data() + basePage );
+            uint32_t * paddr = (uint32_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            int futex_op = (int) ACCESS_REG( REG_ARG1 ) & (~128); // strip "private" flags
+            uint32_t value = (uint32_t) ACCESS_REG( REG_ARG2 );
 
-    fseek( fp, (long) sizeof( head ), SEEK_SET );
-    read = fread( memory.data() + text_base, head.cb_text + head.cb_data, 1, fp );
-    if ( 1 != read )
-    {
-        printf( "can't read text and data segments of cp/m 68k image file\n" );
-        return false;
-    }
+            tracer.Trace( "  futex all paddr %p (%d), futex_op %d, val %d\n", paddr, ( 0 == paddr ) ? -666 : *paddr, futex_op, value );
 
-    tracer.Trace( "  read %x bytes of text and data at offset %x\n", head.cb_text + head.cb_data, text_base );
+            if ( 0 == futex_op ) // FUTEX_WAIT
+            {
+                if ( *paddr != value )
+                    ACCESS_REG( REG_RESULT ) = 11; // EAGAIN
+                else
+                    ACCESS_REG( REG_RESULT ) = 0;
+            }
+            else if ( 1 == futex_op ) // FUTEX_WAKE
+                ACCESS_REG( REG_RESULT ) = 0;
+            else
+                ACCESS_REG( REG_RESULT ) = (REG_TYPE) -1; // fail this until/unless there is a real-world use
+            break;
+        }
+#if !defined( M68 ) && !defined( __mc68000__ )// lots of 64/32 interop issues with this
+        case SYS_writev:
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
+            const struct iovec * pvec = (const struct iovec *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            if ( 1 == descriptor || 2 == descriptor )
+#ifdef M68
+                tracer.Trace( "  desc %d: writing '%.*s'\n", descriptor, pvec->iov_len, cpu.getmem( 0xffffffff & (REG_TYPE) pvec->iov_base ) );
+#else
+                tracer.Trace( "  desc %d: writing '%.*s'\n", descriptor, pvec->iov_len, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ) );
+#endif
 
-    // malloc / brk in the C runtime for DR C use some of these values
+            REG_TYPE result = 0;
 
-    pbasepage->lowest_tpa = swap_endian32( lowestAddress );
-    pbasepage->highest_tpa = swap_endian32( highestAddress );
-    pbasepage->start_text = swap_endian32( text_base );
-    pbasepage->cb_text = swap_endian32( head.cb_text );
-    pbasepage->start_data = swap_endian32( text_base + head.cb_text );
-    pbasepage->cb_data = swap_endian32( head.cb_data );
-    pbasepage->start_bss = swap_endian32( text_base + head.cb_text + head.cb_data );
-    pbasepage->cb_bss = swap_endian32( head.cb_bss );
-    pbasepage->cb_after_bss = swap_endian32( highestAddress + 1 - lowestAddress + 0x100 + head.cb_text + head.cb_data + head.cb_bss );
+            if ( vfs_writev( cpu, descriptor, pvec, (size_t) ACCESS_REG( REG_ARG2 ) ) )
+                break;
 
-    uint32_t data_base = text_base; // + head.cb_text; with 0x601a all bases belong to text_base
-    uint32_t bss_base = text_base; // data_base + head.cb_data;
+#ifdef X64OS_LIBRARY
+            if ( g_outputSink && ( 1 == descriptor || 2 == descriptor ) )
+            {
+                for ( REG_TYPE v = 0; v < ACCESS_REG( REG_ARG2 ); v++ )
+                {
+                    g_outputSink( g_outputSinkContext, descriptor, cpu.getmem( (REG_TYPE) (uint64_t) pvec[ v ].iov_base ), pvec[ v ].iov_len );
+                    result += (REG_TYPE) pvec[ v ].iov_len;
+                }
+                update_result_errno( cpu, result );
+                break;
+            }
+#endif
 
-    if ( !handle_relocations_cpm( fp, head, text_base, data_base, bss_base ) )
-        return false;
+#ifdef _WIN32
+            if ( descriptor <= 2 )
+                result = (REG_TYPE) WinWrite( descriptor, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ), (unsigned) (uint64_t) pvec->iov_len );
+            else
+                result = (REG_TYPE) write( descriptor, cpu.getmem( (REG_TYPE) (uint64_t) pvec->iov_base ), (unsigned) (uint64_t) pvec->iov_len );
+#else //_WIN32
+            struct iovec vec_local;
+            vec_local.iov_base = cpu.getmem( (uint64_t) pvec->iov_base );
+            vec_local.iov_len = pvec->iov_len;
+            tracer.Trace( "  write length: %u to descriptor %d at addr %p\n", pvec->iov_len, descriptor, vec_local.iov_base );
+            result = writev( descriptor, &vec_local, ACCESS_REG( REG_ARG2 ) );
+#endif //_WIN32
+            update_result_errno( cpu, result );
+            break;
+        }
+#endif //M68
+        case SYS_clock_gettime:
+        {
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+            {
+                uint64_t ns = virtual_clock_ns( cpu, ACCESS_REG( REG_ARG0 ) );
+                struct timespec_syscall * pvts = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                pvts->tv_sec = ns / 1000000000;
+                pvts->tv_nsec = ns % 1000000000;
+                pvts->swap_endianness();
+                tracer.Trace( "  virtual time %llu ns\n", ns );
+                update_result_errno( cpu, 0 );
+                break;
+            }
+#endif
+            clockid_t cid = (clockid_t) ACCESS_REG( REG_ARG0 );
+            #ifdef __APPLE__ // Linux vs MacOS
+                if ( 1 == cid )
+                    cid = CLOCK_REALTIME;
+                else if ( 5 == cid )
+                    cid = CLOCK_REALTIME;
+            #endif
 
-    if ( !read_symbols_cpm( fp, head, text_base, data_base, bss_base ) )
-        return false;
+#ifdef _WIN32
+            struct timespec_syscall local_ts = { 0 };
+            int result = msc_clock_gettime( cid, & local_ts );
+#else
+            struct timespec local_ts; // this varies in size from platform to platform
+            int result = clock_gettime( cid, & local_ts );
+#endif
 
-    pbasepage->Trace();
+            struct timespec_syscall * ptimespec = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            ptimespec->tv_sec = local_ts.tv_sec;
+            ptimespec->tv_nsec = local_ts.tv_nsec;
+            ptimespec->swap_endianness();
 
-    tracer.Trace( "memory map from highest to lowest addresses:\n" );
-    tracer.Trace( "  actual top of stack:                                %x\n", stackPointer );
-    tracer.Trace( "  <stack>\n" );
-    tracer.Trace( "  <unallocated space between brk and the stack>\n" );
-    tracer.Trace( "  end_of_bss / current brk:                           %x\n", text_base + head.cb_text + head.cb_data  + head.cb_bss );
-    tracer.Trace( "  <uninitialized bss data>\n" );
-    tracer.Trace( "  start of bss segment:                               %x\n", text_base + head.cb_text + head.cb_data );
-    tracer.Trace( "  <initialized data from the .68k file>\n" );
-    tracer.Trace( "  start of data segment:                              %x\n", text_base + head.cb_text );
-    tracer.Trace( "  <code from the .68k file>\n" );
-    tracer.Trace( "  initial pc execution_addess + start of code         %x\n", text_base );
-    tracer.Trace( "  start of base page:                                 %x\n", basePage );
-    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+            tracer.Trace( "  tv_sec %llx, tv_nsec %llx\n", ptimespec->tv_sec, (uint64_t) ptimespec->tv_nsec );
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_fsync:
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
 
-    tracer.Trace( "first 512 bytes starting at base page:\n" );
-    tracer.TraceBinaryData( memory.data() + basePage, 512, 8 );
+#ifdef _WIN32
+            int result = _commit( descriptor );
+#else
+            int result = fsync( descriptor );
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_fdatasync:
+        {
+            int descriptor = (int) ACCESS_REG( REG_ARG0 );
 
-    return true;
-} //load59_cpm68k
-
-bool load_cpm68k( const char * acApp, const char * acAppArgs )
-{
-    assert( 256 == sizeof( BasePageCPM ) ); // make sure the structure was defined correctly
+#ifdef _WIN32
+            int result = _commit( descriptor );
+#elif defined( __APPLE__ )
+            int result = fsync( descriptor ); // fdatasync isn't available on MacOS
+#else
+            int result = fdatasync( descriptor );
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_sigaction:
+        {
+#if defined( X64OS )
+            int sig = (int) ACCESS_REG( REG_ARG0 );
+            if ( sig < 1 || sig > linuxSignals || ( 0 != ACCESS_REG( REG_ARG1 ) && ( 9 == sig || 19 == sig ) ) )
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    // CP/M apps including Forth83 expect LF characters in files redirected to stdin are converted to CR
-    ConsoleConfiguration::ConvertRedirectedLFToCR( true );
+            if ( 0 != ACCESS_REG( REG_ARG2 ) )
+                * (linux_sigaction_x64 *) cpu.getmem( ACCESS_REG( REG_ARG2 ) ) = g_sigActions[ sig ];
 
-    // if this is being called from the bdos chain call, reset global data structures.
-    memory.resize( 0 );
-    g_cpmSymbols.resize( 0 );
+            if ( 0 != ACCESS_REG( REG_ARG1 ) )
+            {
+                g_sigActions[ sig ] = * (linux_sigaction_x64 *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                tracer.Trace( "  signal %d handler %llx flags %llx\n", sig, g_sigActions[ sig ].handler, g_sigActions[ sig ].flags );
+                update_host_signal( sig );
+                if ( signal_discarded( sig ) )
+                    g_sigPending &= ~signal_bit( sig );
+            }
+#else
+            //errno = EACCES;
+            //update_result_errno( cpu, -1 );
+#endif
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_time: // returns the time as number of seconds since the epoch 1970-01-01 0 UTC. time_t time(time_t *_Nullable tloc);
+        {
+            time_t t = time( 0 );
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+                t = (time_t) ( virtual_clock_ns( cpu, 0 ) / 1000000000 );
+#endif
+            if ( 0 != ACCESS_REG( REG_ARG0 ) )
+            {
+                uint64_t * ptime = (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+                *ptime = swap_endian64( t );
+            }
+            update_result_errno( cpu, (REG_TYPE) t );
+            break;
+        }
+        case SYS_times:
+        {
+            // this function is long obsolete, but older apps call it and it's still supported on recent Linux builds
 
-    FILE * fp = fopen( acApp, "rb" );
-    if ( !fp )
-    {
-        printf( "can't open cp/m 68k image file: %s\n", acApp );
-        return false;
-    }
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+            struct linux_tms_syscall32 * ptms = ( 0 != ACCESS_REG( REG_ARG0 ) ) ? (struct linux_tms_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) : 0;
+#else
+            struct linux_tms_syscall * ptms = ( 0 != ACCESS_REG( REG_ARG0 ) ) ? (struct linux_tms_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) : 0;
+#endif //M68 or SPARCOS
 
-    CFile file( fp );
-    HeaderCPM68K head;
-    size_t read = fread( &head, sizeof( head ), 1, fp );
-    if ( 1 != read )
-    {
-        printf( "can't read header of cp/m 68k image file: %s\n", acApp );
-        return false;
-    }
+            if ( 0 != ptms ) // 0 is legal if callers just want the return value
+            {
+                memset( ptms, 0, sizeof ( *ptms ) );
+#ifdef _WIN32
+                FILETIME ftCreation, ftExit, ftKernel, ftUser;
+                if ( GetProcessTimes( GetCurrentProcess(), &ftCreation, &ftExit, &ftKernel, &ftUser ) )
+                {
+                    ptms->tms_utime = ( ( (uint64_t) ftUser.dwHighDateTime << 32) + ftUser.dwLowDateTime ) / 100000; // 100ns to hundredths of a second
+                    ptms->tms_stime = ( ( (uint64_t) ftKernel.dwHighDateTime << 32 ) + ftKernel.dwLowDateTime ) / 100000;
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+                    ptms->tms_utime = swap_endian32( ptms->tms_utime );
+                    ptms->tms_stime = swap_endian32( ptms->tms_stime );
+#else
+                    ptms->tms_utime = swap_endian64( ptms->tms_utime );
+                    ptms->tms_stime = swap_endian64( ptms->tms_stime );
+#endif //M68 or SPARCOS
+                }
+                else
+                    tracer.Trace( "  unable to GetProcessTimes, error %d\n", GetLastError() );
+#else //_WIN32
+                struct tms local_tms; // on 32-bit systems the members are 32 bit.
+                times( &local_tms );
+                ptms->tms_utime = local_tms.tms_utime;
+                ptms->tms_stime = local_tms.tms_stime;
+                ptms->tms_cutime = local_tms.tms_cutime;
+                ptms->tms_cstime = local_tms.tms_cstime;
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+                ptms->tms_utime = swap_endian32( ptms->tms_utime );
+                ptms->tms_stime = swap_endian32( ptms->tms_stime );
+                ptms->tms_cutime = swap_endian32( ptms->tms_cutime );
+                ptms->tms_cstime = swap_endian32( ptms->tms_cstime );
+#else
+                ptms->tms_utime = swap_endian64( ptms->tms_utime );
+                ptms->tms_stime = swap_endian64( ptms->tms_stime );
+                ptms->tms_cutime = swap_endian64( ptms->tms_cutime );
+                ptms->tms_cstime = swap_endian64( ptms->tms_cstime );
+#endif //M68 or SPARCOS
+#endif //_WIN32
+            }
 
-    head.swap_endianness();
-    head.trace();
+            // ticks is generally in hundredths of a second per sysconf( _SC_CLK_TCK )
+            REG_TYPE sc_clk_tck = (REG_TYPE) 100;
+#if defined( _WIN32 )
+            REG_TYPE ticks = (REG_TYPE) GetTickCount64();
+            ticks /= 10; // milliseconds to hundredths of a second
+#else
+            sc_clk_tck = sysconf( _SC_CLK_TCK );
+            struct tms unused;
+            REG_TYPE ticks = times( &unused );
+#endif
 
-    if ( 0x601a != head.signature )
-    {
-        printf( "header of cp/m 68k image file isn't standard no-relocation 0x601a: %s\n", acApp );
-        return false;
-    }
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+            {
+                // apps assume 100 ticks per second because that's what sysconf( _SC_CLK_TCK ) returns on Linux
 
-    uint32_t text_base;
-    if ( 0 != head.relocation_flag ) // 0 means they exist, != 0 means they don't exist
-        text_base = head.text_start;
-    else
-        text_base = 0x7b00; // arbitrary, but this is what an actual cp/m 68k machine uses
+                if ( 0 != ptms )
+                {
+                    memset( ptms, 0, sizeof ( *ptms ) );
+                    ptms->tms_utime = virtual_cpu_ns( cpu ) / 10000000;
+#if defined( X32OS )
+                    ptms->tms_utime = swap_endian32( ptms->tms_utime );
+#else
+                    ptms->tms_utime = swap_endian64( ptms->tms_utime );
+#endif
+                }
+                ticks = (REG_TYPE) ( virtual_clock_ns( cpu, 1 ) / 10000000 );
+            }
+#endif
+            update_result_errno( cpu, ticks );
+            break;
+        }
+        case SYS_rt_sigprocmask:
+        {
+#if defined( X64OS )
+            int how = (int) ACCESS_REG( REG_ARG0 );
+            uint64_t old = g_sigBlocked;
+            if ( 0 != ACCESS_REG( REG_ARG1 ) )
+            {
+                uint64_t set = * (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                if ( 0 == how ) // SIG_BLOCK
+                    g_sigBlocked |= set;
+                else if ( 1 == how ) // SIG_UNBLOCK
+                    g_sigBlocked &= ~set;
+                else if ( 2 == how ) // SIG_SETMASK
+                    g_sigBlocked = set;
+                else
+                {
+                    errno = EINVAL;
+                    update_result_errno( cpu, -1 );
+                    break;
+                }
+                g_sigBlocked &= ~( signal_bit( 9 ) | signal_bit( 19 ) );
+                update_signal_checks( cpu );
+            }
 
-    uint32_t image_size = head.cb_text + head.cb_data + head.cb_bss;
-    uint32_t memory_size = 0x100 + text_base + image_size; // base page + offset from 0 to start of code + total size of image loaded from the executable
+            if ( 0 != ACCESS_REG( REG_ARG2 ) )
+                * (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG2 ) ) = old;
+#endif
+            errno = 0;
+            update_result_errno( cpu, 0 );
+            break;
+        }
+#if defined( X64OS )
+        case SYS_rt_sigreturn:
+        {
+            guest_sigreturn( cpu ); // rax and all other registers come from the signal frame
+            update_signal_checks( cpu );
+            break;
+        }
+        case SYS_rt_sigpending:
+        {
+            * (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) = g_sigPending;
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_rt_sigsuspend:
+        case emulator_sys_pause:
+        {
+            uint64_t old = g_sigBlocked;
+            if ( SYS_rt_sigsuspend == syscall_id )
+                g_sigBlocked = ( * (uint64_t *) cpu.getmem( ACCESS_REG( REG_ARG0 ) ) ) & ~( signal_bit( 9 ) | signal_bit( 19 ) );
 
-    // make it 4-byte aligned
+            uint64_t remaining = 0;
+            interruptible_sleep( cpu, UINT64_MAX, remaining );
 
-    if ( memory_size & 3 )
-    {
-        memory_size += 4;
-        memory_size &= ~3;
-    }
+            if ( SYS_rt_sigsuspend == syscall_id )
+            {
+                g_sigSuspended = true;
+                g_sigSuspendMask = old;
+            }
 
-    g_end_of_data = memory_size - 0x100;
-    g_brk_offset = g_end_of_data;
-    g_highwater_brk = g_end_of_data;
-    memory_size += g_brk_commit;
+            update_signal_checks( cpu );
+            errno = EINTR;
+            update_result_errno( cpu, -1 );
+            break;
+        }
+        case SYS_kill:
+        case SYS_tgkill:
+        {
+            // only the app itself can be signaled. its pid is getpid() and its one thread's tid is 1
 
-    g_bottom_of_stack = memory_size;
-    memory_size += g_stack_commit;
+            bool tgkill = ( SYS_tgkill == syscall_id );
+            int target = (int) ACCESS_REG( REG_ARG0 );
+            int sig = (int) ACCESS_REG( tgkill ? REG_ARG2 : REG_ARG1 );
+            bool self = tgkill ? ( 1 == (int) ACCESS_REG( REG_ARG1 ) || (int) getpid() == (int) ACCESS_REG( REG_ARG1 ) )
+                               : ( 0 == target || -1 == target || (int) getpid() == target );
 
-    memory.resize( memory_size );
-    memset( memory.data(), 0, memory.size() );
+            if ( sig < 0 || sig > linuxSignals )
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    // put the supervisor stack pointer in the first 4 bytes of RAM.
-    * (uint32_t *) memory.data() = swap_endian32( 1024 ); // arbitrary, but above the vector table and below the typical cp/m 68k base page (where f83 loads)
+            if ( !self )
+            {
+                errno = ESRCH;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    g_base_address = 0;
-    uint32_t base_page = text_base - 0x100; // where the base page (256 bytes) resides
-    BasePageCPM * pbasepage = (BasePageCPM *) ( memory.data() + base_page );
-    g_execution_address = text_base;
-    g_top_of_stack = (REG_TYPE) g_bottom_of_stack + g_stack_commit;
-    pbasepage->reserved[ 1 ] = 0x22; // move.l d0, d1.  return code. at at offset 0x26 in the base page (not a cp/m standard)
-    pbasepage->reserved[ 2 ] = 0x00;
-    pbasepage->reserved[ 3 ] = 0x70; // moveq #93, d0   linux exit function
-    pbasepage->reserved[ 4 ] = 0x5d;
-    pbasepage->reserved[ 5 ] = 0x4e; // trap 0          invoke linux syscall to exit the app
-    pbasepage->reserved[ 6 ] = 0x40;
+            if ( 0 != sig )
+            {
+                raise_guest_signal( sig, tgkill ? linux_SI_TKILL : linux_SI_USER, (int) getpid(), 0, 0 );
+                update_signal_checks( cpu );
+            }
 
-    // per the cp/m 68k spec there must be two 32-bit values at the top of the stack for base address and return location at app completion
-    g_top_of_stack -= 8;
-    uint32_t * preturn_address = (uint32_t *) & memory[ g_top_of_stack ];
-    uint32_t * pbase_page_address = (uint32_t *) & memory[ g_top_of_stack + 4 ];
-    *preturn_address = swap_endian32( base_page + 0x26 );
-    *pbase_page_address = swap_endian32( base_page );
-    tracer.Trace( "memory at top of stack address %#x:\n", g_top_of_stack );
-    tracer.TraceBinaryData( & memory[ g_top_of_stack ], 8, 4 );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_getitimer:
+        case SYS_setitimer:
+        {
+            size_t which = (size_t) ACCESS_REG( REG_ARG0 );
+            if ( which >= itimerCount )
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    fseek( fp, (long) sizeof( head ), SEEK_SET );
-    read = fread( memory.data() + text_base, head.cb_text + head.cb_data, 1, fp );
-    if ( 1 != read )
-    {
-        printf( "can't read text and data segments of cp/m 68k image file: %s\n", acApp );
-        return false;
-    }
-    tracer.Trace( "  read %x bytes of text and data from file offset %x to memory offset %x\n", head.cb_text + head.cb_data, (int) sizeof( head ), text_base );
+            static const int itimer_signals[ itimerCount ] = { 14, 26, 27 }; // SIGALRM, SIGVTALRM, SIGPROF
+            SignalTimer & t = g_sigTimers[ which ];
+            t.in_use = true;
+            t.signo = itimer_signals[ which ];
+            t.code = linux_SI_KERNEL;
+            t.clock = ( 0 == which ) ? 1 : 2; // MONOTONIC and PROCESS_CPUTIME_ID
 
-    while ( ' ' == *acAppArgs )
-        acAppArgs++;
+            REG_TYPE pold = ( SYS_getitimer == syscall_id ) ? ACCESS_REG( REG_ARG1 ) : ACCESS_REG( REG_ARG2 );
+            if ( 0 != pold )
+            {
+                uint64_t value, interval;
+                read_timer_ns( cpu, t, value, interval );
+                linux_timeval * ptv = (linux_timeval *) cpu.getmem( pold ); // interval then value
+                ptv[ 0 ].tv_sec = interval / 1000000000;
+                ptv[ 0 ].tv_usec = ( interval % 1000000000 ) / 1000;
+                ptv[ 1 ].tv_sec = value / 1000000000;
+                ptv[ 1 ].tv_usec = ( value % 1000000000 + 999 ) / 1000;
+            }
 
-    uint8_t arg_len = (uint8_t) strlen( acAppArgs );
-    if ( arg_len > 126 )
-    {
-        printf( "app arguments for cp/m can't be > 126 characters long\n" );
-        return false;
-    }
+            if ( SYS_setitimer == syscall_id && 0 != ACCESS_REG( REG_ARG1 ) )
+            {
+                const linux_timeval * ptv = (const linux_timeval *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+                uint64_t interval = ptv[ 0 ].tv_sec * 1000000000 + ptv[ 0 ].tv_usec * 1000;
+                uint64_t value = ptv[ 1 ].tv_sec * 1000000000 + ptv[ 1 ].tv_usec * 1000;
+                tracer.Trace( "  itimer %zu value %llu ns, interval %llu ns\n", which, value, interval );
+                arm_timer( cpu, t, value, interval, false );
+            }
 
-    memset( & ( pbasepage->firstFCB.f ), ' ', 11 ); // 8 filename + 3 type
-    memset( & ( pbasepage->secondFCB.f ), ' ', 11 );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case emulator_sys_alarm:
+        {
+            SignalTimer & t = g_sigTimers[ 0 ];
+            uint64_t value = 0, interval = 0;
+            if ( t.in_use )
+                read_timer_ns( cpu, t, value, interval );
 
-    pbasepage->cb_command_tail = arg_len;
-    strcpy( (char *) ( pbasepage->command_tail ), acAppArgs );
-    tracer.Trace( "arg_len %u, command tail %s\n", arg_len, acAppArgs );
+            t.in_use = true;
+            t.signo = 14; // SIGALRM
+            t.code = linux_SI_KERNEL;
+            t.clock = 1;
+            arm_timer( cpu, t, (uint64_t) ACCESS_REG( REG_ARG0 ) * 1000000000, 0, false );
+            update_result_errno( cpu, (SIGNED_REG_TYPE) ( ( value + 999999999 ) / 1000000000 ) ); // seconds left on the prior alarm
+            break;
+        }
+        case SYS_timer_create:
+        {
+            size_t i = itimerCount;
+            while ( i < signalTimerCount && g_sigTimers[ i ].in_use )
+                i++;
 
-    // put what looks like filenames in the command tail in the two FCBs in the base page. Apps don't much use this.
+            if ( signalTimerCount == i )
+            {
+                errno = EAGAIN;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    char acCopy[ 128 ];
-    strcpy( acCopy, acAppArgs );
+            SignalTimer & t = g_sigTimers[ i ];
+            memset( &t, 0, sizeof( t ) );
+            t.clock = ACCESS_REG( REG_ARG0 );
+            t.code = linux_SI_TIMER;
+            t.signo = 14; // SIGALRM and the timer id are the defaults without a sigevent
+            t.value = i - itimerCount;
 
-    char * pcArg1 = 0;
-    char * pcArg2 = 0;
-    char * pa = acCopy;
+            if ( 0 != ACCESS_REG( REG_ARG1 ) )
+            {
+                const uint8_t * pevent = (const uint8_t *) cpu.getmem( ACCESS_REG( REG_ARG1 ) ); // sigev_value, sigev_signo, sigev_notify
+                int notify = * (int32_t *) ( pevent + 12 );
+                if ( 1 != notify && 0 != notify && 4 != notify ) // SIGEV_NONE, SIGEV_SIGNAL, and SIGEV_THREAD_ID
+                {
+                    errno = EINVAL;
+                    update_result_errno( cpu, -1 );
+                    break;
+                }
+                t.value = * (uint64_t *) pevent;
+                t.signo = ( 1 == notify ) ? 0 : * (int32_t *) ( pevent + 8 );
+            }
 
-    while ( *pa && !pcArg2 )
-    {
-        if ( ' ' == *pa )
-            pa++;
-        else if ( '-' == *pa )
+            t.in_use = true;
+            * (int32_t *) cpu.getmem( ACCESS_REG( REG_ARG2 ) ) = (int32_t) ( i - itimerCount );
+            tracer.Trace( "  created timer %zu on clock %llu, signal %d\n", i - itimerCount, t.clock, t.signo );
+            update_result_errno( cpu, 0 );
+            break;
+        }
+        case SYS_timer_settime:
+        case SYS_timer_gettime:
+        case SYS_timer_getoverrun:
+        case SYS_timer_delete:
         {
-            while ( *pa && ' ' != *pa )
-                pa++;
+            size_t i = itimerCount + (size_t) ACCESS_REG( REG_ARG0 );
+            if ( i >= signalTimerCount || !g_sigTimers[ i ].in_use )
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+                break;
+            }
+
+            SignalTimer & t = g_sigTimers[ i ];
+            SIGNED_REG_TYPE result = 0;
+
+            if ( SYS_timer_delete == syscall_id )
+            {
+                t.in_use = false;
+                t.armed = false;
+                update_signal_checks( cpu );
+            }
+            else if ( SYS_timer_getoverrun == syscall_id )
+                result = (SIGNED_REG_TYPE) t.overrun;
+            else
+            {
+                REG_TYPE pold = ( SYS_timer_gettime == syscall_id ) ? ACCESS_REG( REG_ARG1 ) : ACCESS_REG( REG_ARG3 );
+                if ( 0 != pold )
+                {
+                    uint64_t value, interval;
+                    read_timer_ns( cpu, t, value, interval );
+                    timespec_syscall * pts = (timespec_syscall *) cpu.getmem( pold ); // interval then value
+                    pts[ 0 ].tv_sec = interval / 1000000000;
+                    pts[ 0 ].tv_nsec = interval % 1000000000;
+                    pts[ 1 ].tv_sec = value / 1000000000;
+                    pts[ 1 ].tv_nsec = value % 1000000000;
+                }
+
+                if ( SYS_timer_settime == syscall_id )
+                {
+                    const timespec_syscall * pts = (const timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+                    uint64_t interval = pts[ 0 ].tv_sec * 1000000000 + pts[ 0 ].tv_nsec;
+                    uint64_t value = pts[ 1 ].tv_sec * 1000000000 + pts[ 1 ].tv_nsec;
+                    bool absolute = ( 0 != ( ACCESS_REG( REG_ARG1 ) & 1 ) ); // TIMER_ABSTIME
+                    tracer.Trace( "  timer %zu value %llu ns, interval %llu ns, absolute %d\n", i - itimerCount, value, interval, absolute );
+                    arm_timer( cpu, t, value, interval, absolute );
+                }
+            }
+
+            update_result_errno( cpu, result );
+            break;
         }
-        else if ( ':' == * ( pa + 1 ) )
-            pa += 2;
-        else if ( !pcArg1 )
+#endif //X64OS
+        case SYS_prctl:
         {
-            pcArg1 = pa;
-            while ( *pa && ' ' != *pa )
-                pa++;
+            update_result_errno( cpu, 0 );
+            break;
         }
-        else if ( !pcArg2 )
+        case SYS_getpid:
         {
-            pcArg2 = pa;
-            while ( *pa && ' ' != *pa )
-                pa++;
+            ACCESS_REG( REG_RESULT ) = getpid();
+            break;
         }
-    }
-
-    if ( pcArg1 )
-    {
-        char * p = pcArg1;
-        while ( *p )
+        case SYS_gettid:
         {
-            if ( ' ' == *p )
-                *p = 0;
-            else
-                p++;
+            ACCESS_REG( REG_RESULT ) = 1;
+            break;
         }
-        tracer.Trace( "    arg1: '%s'\n", pcArg1 );
-        strupr( pcArg1 );
-        write_fcb_arg( & ( pbasepage->firstFCB ), pcArg1 );
-    }
+        case emulator_sys_rename:
+        {
+            const char * oldpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            const char * newpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            if ( vfs_rename( cpu, -100, oldpath, -100, newpath ) )
+                break;
 
-    if ( pcArg2 )
-    {
-        char * p = pcArg2;
-        while ( *p )
+            int result = rename( oldpath, newpath );
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_renameat:
+        case SYS_renameat2:
         {
-            if ( ' ' == *p )
-                *p = 0;
-            else
-                p++;
+            int olddirfd = (int) ACCESS_REG( REG_ARG0 );
+            const char * oldpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            int newdirfd = (int) ACCESS_REG( REG_ARG2 );
+            const char * newpath = (const char *) cpu.getmem( ACCESS_REG( REG_ARG3 ) );
+            unsigned int flags = ( SYS_renameat2 == syscall_id ) ? (unsigned int) ACCESS_REG( REG_ARG4 ) : 0;
+            tracer.Trace( "  renaming '%s' to '%s'\n", oldpath, newpath );
+            if ( vfs_rename( cpu, olddirfd, oldpath, newdirfd, newpath ) )
+                break;
+
+#if defined( _WIN32 ) || defined( __mc68000__ )
+            int result = rename( oldpath, newpath );
+#elif defined( __APPLE__ )
+            if ( -100 == olddirfd )
+                olddirfd = -2;
+            if ( -100 == newdirfd )
+                newdirfd = -2;
+            int result = renameat( olddirfd, oldpath, newdirfd, newpath ); // macos has no renameat2
+#elif defined( sparc )
+            int result = renameat( olddirfd, oldpath, newdirfd, newpath ); // sparc has no renameat2
+#else
+            int result = renameat2( olddirfd, oldpath, newdirfd, newpath, flags );
+#endif
+            update_result_errno( cpu, result );
+            break;
         }
-        tracer.Trace( "    arg2: '%s'\n", pcArg2 );
-        strupr( pcArg2 );
-        write_fcb_arg( & ( pbasepage->secondFCB ), pcArg2 );
-    }
+        case SYS_getrandom:
+        {
+            void * buf = cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            REG_TYPE buflen = ACCESS_REG( REG_ARG1 );
+            unsigned int flags = (unsigned int) ACCESS_REG( REG_ARG2 );
+            SIGNED_REG_TYPE result = 0;
 
-    // malloc / brk in the C runtime for DR C use some of these values
+#if defined(_WIN32) || defined(__APPLE__) || defined( __mc68000__ )
+            int * pbuf = (int *) buf;
+            size_t count = buflen / sizeof( int );
+            for ( size_t i = 0; i < count; i++ )
+                pbuf[ i ] = (int) rand64();
+            result = buflen;
+#else
+            result = getrandom( buf, buflen, flags );
+#endif
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_statx:
+        {
+            //                    0                                        1          2                  3                                4
+            // int statx( int dirfd, const char *_Nullable restrict pathname, int flags, unsigned int mask, struct statx *restrict statxbuf );
+            tracer.Trace( "  syscall cmd SYS_statx\n" );
+            int dirfd = (int) ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  dirfd: %d\n", dirfd );
+            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            int flags = (int) ACCESS_REG( REG_ARG2 );
+            tracer.Trace( "  statx on path '%s'\n", pathname );
+            int mask = (int) ACCESS_REG( REG_ARG3 );
 
-    pbasepage->lowest_tpa = 0;
-    pbasepage->highest_tpa = swap_endian32( g_base_address + memory_size - 1 );
-    pbasepage->start_text = swap_endian32( text_base );
-    pbasepage->cb_text = swap_endian32( head.cb_text );
-    pbasepage->start_data = swap_endian32( text_base + head.cb_text );
-    pbasepage->cb_data = swap_endian32( head.cb_data );
-    pbasepage->start_bss = swap_endian32( text_base + head.cb_text + head.cb_data );
-    pbasepage->cb_bss = swap_endian32( head.cb_bss );
-    pbasepage->cb_after_bss = swap_endian32( g_brk_commit );
+            if ( STATX_BASIC_STATS != mask ) // very simplistic implementation
+            {
+                errno = EINVAL;
+                update_result_errno( cpu, -1 );
+                break;
+            }
 
-    g_DMA = memory.data() + text_base - 0x80; // midway through the base page
-    uint32_t data_base = text_base; // + head.cb_text; with 0x601a all bases belong to text_base
-    uint32_t bss_base = text_base; // data_base + head.cb_data;
+            struct statx_linux_syscall * pout = (struct statx_linux_syscall *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
+            memset( pout, 0, sizeof( struct statx_linux_syscall ) );
+            pout->stx_mask = mask;
+            int result = 0;
 
-    if ( !handle_relocations_cpm( fp, head, text_base, data_base, bss_base ) )
-        return false;
+#ifdef _WIN32
+            struct stat_linux_syscall local_stat = {0};
+            char ac[ EMULATOR_MAX_PATH ];
+            strcpy( ac, pathname );
+            slash_to_backslash( ac );
+            if ( !vfs_stat( dirfd, pathname, local_stat, result ) )
+                result = fill_pstat_windows( ( dirfd > 0 ) ? dirfd : -1, & local_stat, ac );
+            if ( 0 == result )
+            {
+                tracer.Trace( "  result in local stat_linux_syscall, offset of mode %u, mode: %#x\n", offsetof( struct stat_linux_syscall, st_mode ), local_stat.st_mode );
+                tracer.TraceBinaryData( (uint8_t *) &local_stat, sizeof( stat_linux_syscall ), 5 );
+#if defined( SPARCOS )
+                struct statx_sparc_linux_syscall32 * pout32 = (struct statx_sparc_linux_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
+                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout32->stx_ino = local_stat.st_ino;
+                pout32->stx_nlink = local_stat.st_nlink;
+                pout32->stx_uid = local_stat.st_uid;
+                pout32->stx_gid = local_stat.st_gid;
+                pout32->stx_mode = (uint16_t) local_stat.st_mode;
+                pout32->stx_size = (uint32_t) local_stat.st_size;
+                pout32->stx_blocks = (uint32_t) local_stat.st_blocks;
+                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+                pout32->swap_endianness();
 
-    if ( !read_symbols_cpm( fp, head, text_base, data_base, bss_base ) )
-        return false;
+                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct statx_sparc_linux_syscall32, stx_mode ) );
+                tracer.Trace( "statx data:\n" );
+                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
+                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
+                tracer.Trace( "  ino: %#x\n", pout32->stx_ino );
+                tracer.Trace( "  size: %#x\n", pout32->stx_size );
+                tracer.Trace( "  blocks: %#x\n", pout32->stx_blocks );
+                tracer.TraceBinaryData( (uint8_t *) pout32, sizeof( *pout32 ), 5 );
+#elif defined( X32OS )
+                struct statx_linux_syscall_x32 * pout32 = (struct statx_linux_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
+                size_t cbStat = sizeof( struct statx_linux_syscall_x32 );
+                local_stat.swap_endianness();
 
-    pbasepage->Trace();
+                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout32->stx_ino = local_stat.st_ino;
+                pout32->stx_nlink = (uint32_t) local_stat.st_nlink;
+                pout32->stx_uid = local_stat.st_uid;
+                pout32->stx_gid = local_stat.st_gid;
+                pout32->stx_mode = swap_endian16( (uint16_t) swap_endian32( local_stat.st_mode ) );
+                pout32->stx_size = local_stat.st_size;
+                pout32->stx_blocks = local_stat.st_blocks;
+                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
 
-    tracer.Trace( "memory map from highest to lowest addresses:\n" );
-    tracer.Trace( "  first byte beyond allocated memory:                 %x\n", g_base_address + memory_size );
-    tracer.Trace( "  actual top of stack:                                %x\n", g_top_of_stack + 8 );
-    tracer.Trace( "  initial stack pointer g_top_of_stack:               %x\n", g_top_of_stack );
-    REG_TYPE stack_bytes = g_stack_commit;
-    tracer.Trace( "  <stack>                                             (%d == %x bytes)\n", stack_bytes, stack_bytes );
-    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %x\n", g_base_address + g_bottom_of_stack );
-    tracer.Trace( "  <unallocated space between brk and the stack>       (%d == %llx bytes)\n", g_brk_commit, g_brk_commit );
-    tracer.Trace( "  end_of_bss / current brk:                           %x\n", g_base_address + g_end_of_data );
-    tracer.Trace( "  <uninitialized bss data>\n" );
-    tracer.Trace( "  start of bss segment:                               %x\n", g_execution_address + head.cb_text + head.cb_data );
-    tracer.Trace( "  <initialized data from the .68k file>\n" );
-    tracer.Trace( "  start of data segment:                              %x\n", g_execution_address + head.cb_text );
-    tracer.Trace( "  <code from the .68k file>\n" );
-    tracer.Trace( "  initial pc execution_addess + start of code         %x\n", g_execution_address );
-    tracer.Trace( "  default DMA address:                                %x\n", (uint32_t) ( g_DMA - memory.data() ) );
-    tracer.Trace( "  start of base page:                                 %x\n", base_page );
-    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct statx_linux_syscall_x32, stx_mode ) );
+                tracer.Trace( "statx data:\n" );
+                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
+                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
+                tracer.Trace( "  ino: %#llx\n", pout32->stx_ino );
+                tracer.Trace( "  size: %#llx\n", pout32->stx_size );
+                tracer.Trace( "  blocks: %#llx\n", pout32->stx_blocks );
+                tracer.Trace( "  attrib_mask: %#llx\n", pout32->stx_attributes_mask );
+                tracer.Trace( "  atime sec %#llx\n", pout32->stx_atime.tv_sec );
+                tracer.Trace( "  atime nsec %#lx\n", pout32->stx_atime.tv_nsec );
+                tracer.Trace( "  btime sec %#llx\n", pout32->stx_btime.tv_sec );
+                tracer.Trace( "  btime nsec %#lx\n", pout32->stx_btime.tv_nsec );
+                tracer.Trace( "  ctime sec %#llx\n", pout32->stx_ctime.tv_sec );
+                tracer.Trace( "  ctime nsec %#lx\n", pout32->stx_ctime.tv_nsec );
+                tracer.Trace( "  mtime sec %#llx\n", pout32->stx_mtime.tv_sec );
+                tracer.Trace( "  mtime nsec %#lx\n", pout32->stx_mtime.tv_nsec );
+                //tracer.TraceBinaryData( (uint8_t *) pout32, cbStat, 5 );
+#else
+                size_t cbStat = sizeof( struct stat_linux_syscall );
+                assert( 128 == cbStat );  // 128 is the size of the stat struct this syscall on RISC-V Linux
+                local_stat.swap_endianness();
 
-    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
-    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
-    tracer.Trace( "memory_size:                     %#x == %d\n", memory_size, memory_size );
+                pout->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout->stx_ino = local_stat.st_ino;
+                pout->stx_nlink = (uint32_t) local_stat.st_nlink;
+                pout->stx_uid = local_stat.st_uid;
+                pout->stx_gid = local_stat.st_gid;
+                pout->stx_mode = swap_endian16( (uint16_t) swap_endian32( local_stat.st_mode ) );
+                pout->stx_size = local_stat.st_size;
+                pout->stx_blocks = local_stat.st_blocks;
+                pout->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+                pout->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
 
-    tracer.Trace( "first 512 bytes starting at base page:\n" );
-    tracer.TraceBinaryData( memory.data() + base_page, 512, 8 );
+                pout->stx_blksize = 0xbbbbbbbb;
+                pout->stx_attributes = 0xaaaaaaaaaaaaaaaa;
+                pout->stx_nlink = 0x11111111;
+                pout->stx_uid = 0x22222222;
+                pout->stx_gid = 0x33333333;
+                pout->stx_mode = 0x4444;
+                pout->stx_ino = 0x5555555555555555;
+                pout->stx_size = 0x6666666666666666;
+                pout->stx_blocks = 0x7777777777777777;
 
-    return true;
-} //load_cpm68k
+                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
+                tracer.Trace( "statx data:\n" );
+                tracer.Trace( "  gid: %#x\n", pout->stx_gid );
+                tracer.Trace( "  mode: %#x\n", pout->stx_mode );
+                tracer.Trace( "  ino: %#llx\n", pout->stx_ino );
+                tracer.Trace( "  size: %#llx\n", pout->stx_size );
+                tracer.Trace( "  blocks: %#llx\n", pout->stx_blocks );
+                tracer.Trace( "  attrib_mask: %#llx\n", pout->stx_attributes_mask );
+                tracer.TraceBinaryData( (uint8_t *) pout, (uint32_t) cbStat, 5 );
+#endif
+            }
+            else
+            {
+                errno = 2;
+                tracer.Trace( "  fill_pstat_windows failed\n" );
+            }
+#else // _WIN32
+            tracer.Trace( "  sizeof struct stat: %d\n", (int) sizeof( struct stat ) );
+            struct stat local_stat = {0};
 
-bool IsAFolder( const char * pc )
-{
-    struct stat file_stat;
-    int result = stat( pc, &file_stat );
-    return ( ( 0 == result ) && ( 0 != ( S_IFDIR & file_stat.st_mode ) ) );
-} //IsAFolder
+            if ( !vfs_stat( dirfd, pathname, local_stat, result ) )
+            {
+#if defined( __APPLE__ )
+                if ( -100 == dirfd )
+                    dirfd = -2;
 
-bool ValidCPMFilename( char * pc )
-{
-    if ( !strcmp( pc, "." ) )
-        return false;
+                if ( EMULATOR_AT_SYMLINK_NOFOLLOW & flags )
+                    flags = AT_SYMLINK_NOFOLLOW; // 0x20 instead of 0x100 on macOS
+                else if ( EMULATOR_AT_SYMLINK_FOLLOW & flags )
+                    flags = AT_SYMLINK_FOLLOW; // 0x40 instead of 0x400 on macOS
+                else
+                    flags = 0; // no other flags are supported on macOS
+                tracer.Trace( "  translated flags for MacOS: %x\n", flags );
 
-    if ( !strcmp( pc, ".." ) )
-        return false;
+                tracer.Trace( "  statx calling fstatat with dirfd %d, flags %#x\n", dirfd, flags );
+                if ( 0 == pathname[ 0 ] )
+                    result = fstat( dirfd, & local_stat );
+                else
+                    result = fstatat( dirfd, pathname, & local_stat, flags );
+#else
+                tracer.Trace( "  statx calling fstatat with dirfd %d, flags %#x\n", dirfd, flags );
+                result = fstatat( dirfd, pathname, & local_stat, flags );
+#endif // __APPLE__
+            }
 
-    const char * pcinvalid = "<>,;:=?[]%|()/\\ \t\n\r"; // control characters are valid with exceptions
-    for ( size_t i = 0; i < strlen( pcinvalid ); i++ )
-        if ( strchr( pc, pcinvalid[i] ) )
-            return false;
+            if ( 0 == result )
+            {
+                tracer.Trace( "  result in local_stat, offset of mode %u, mode: %#x\n", offsetof( struct stat, st_mode ), local_stat.st_mode );
+                tracer.TraceBinaryData( (uint8_t *) &local_stat, sizeof( local_stat ), 5 );
 
-    size_t len = strlen( pc );
+#if defined( SPARCOS )
+                tracer.Trace( "  offsetof mode: %u\n", (int) offsetof( struct statx_sparc_linux_syscall32, stx_mode ) );
+                struct statx_sparc_linux_syscall32 * pout32 = (struct statx_sparc_linux_syscall32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
+                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout32->stx_ino = local_stat.st_ino;
+                pout32->stx_nlink = local_stat.st_nlink;
+                pout32->stx_uid = local_stat.st_uid;
+                pout32->stx_gid = local_stat.st_gid;
+                pout32->stx_mode = local_stat.st_mode;
+                pout32->stx_size = local_stat.st_size;
+                pout32->stx_blocks = local_stat.st_blocks;
+#if defined( __APPLE__ )
+                pout32->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
+#elif defined( __mc68000__ )
+                pout32->stx_atime.tv_sec = local_stat.st_atime;
+                pout32->stx_atime.tv_nsec = 0;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtime;
+                pout32->stx_mtime.tv_nsec = 0;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctime;
+                pout32->stx_ctime.tv_nsec = 0;
+#else
+                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+#endif
+                pout32->swap_endianness();
 
-    if ( len > 12 )
-        return false;
+#elif defined( X32OS )
+                tracer.Trace( "  offsetof mode: %u\n", (int) offsetof( struct statx_linux_syscall_x32, stx_mode ) );
+                struct statx_linux_syscall_x32 * pout32 = (struct statx_linux_syscall_x32 *) cpu.getmem( ACCESS_REG( REG_ARG4 ) );
+                size_t cbStat = sizeof( struct statx_linux_syscall_x32 );
 
-    char * pcdot = strchr( pc, '.' );
+                pout32->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout32->stx_ino = local_stat.st_ino;
+                pout32->stx_nlink = (uint32_t) local_stat.st_nlink;
+                pout32->stx_uid = local_stat.st_uid;
+                pout32->stx_gid = local_stat.st_gid;
+                tracer.Trace( "sizeof local_stat.st_mode: %u\n", (int) sizeof( local_stat.st_mode ) );
+                tracer.Trace( "sizeof pout32->st_mode: %u\n", (int) sizeof( pout32->stx_mode ) );
+                pout32->stx_mode = (uint16_t) local_stat.st_mode;
+                tracer.Trace( "mode from %#x, mode to %#x\n", local_stat.st_mode, pout32->stx_mode );
+                pout32->stx_size = local_stat.st_size;
+                pout32->stx_blocks = local_stat.st_blocks;
 
-    if ( !pcdot && ( len > 8 ) )
-        return false;
+#if defined( __APPLE__ )
+                pout32->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
+#elif defined( __mc68000__ )
+                pout32->stx_atime.tv_sec = local_stat.st_atime;
+                pout32->stx_atime.tv_nsec = 0;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtime;
+                pout32->stx_mtime.tv_nsec = 0;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctime;
+                pout32->stx_ctime.tv_nsec = 0;
+#else
+                pout32->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout32->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout32->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout32->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+                pout32->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout32->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+#endif // __APPLE__ || __mc68000__ || (other)
 
-    if ( pcdot && ( ( pcdot - pc ) > 8 ) )
-        return false;
+                pout32->swap_endianness();
+                tracer.Trace( "statx data:\n" );
+                tracer.Trace( "  gid: %#x\n", pout32->stx_gid );
+                tracer.Trace( "  mode: %#x\n", pout32->stx_mode );
+                tracer.Trace( "  ino: %#llx\n", pout32->stx_ino );
+                tracer.Trace( "  size: %#llx\n", pout32->stx_size );
+                tracer.Trace( "  blocks: %#llx\n", pout32->stx_blocks );
+                tracer.Trace( "  attrib_mask: %#llx\n", pout32->stx_attributes_mask );
+                tracer.Trace( "  atime sec %#llx\n", pout32->stx_atime.tv_sec );
+                tracer.Trace( "  atime nsec %#lx\n", pout32->stx_atime.tv_nsec );
+                tracer.Trace( "  btime sec %#llx\n", pout32->stx_btime.tv_sec );
+                tracer.Trace( "  btime nsec %#lx\n", pout32->stx_btime.tv_nsec );
+                tracer.Trace( "  ctime sec %#llx\n", pout32->stx_ctime.tv_sec );
+                tracer.Trace( "  ctime nsec %#lx\n", pout32->stx_ctime.tv_nsec );
+                tracer.Trace( "  mtime sec %#llx\n", pout32->stx_mtime.tv_sec );
+                tracer.Trace( "  mtime nsec %#lx\n", pout32->stx_mtime.tv_nsec );
+                //tracer.TraceBinaryData( (uint8_t *) pout32, cbStat, 5 );
 
-    return true;
-} //ValidCPMFilename
+#else // SPARCOS
+                // the syscall version of stat has similar fields but a different layout, so copy fields one by one
 
-#ifdef _WIN32
-    static HANDLE g_hFindFirst = INVALID_HANDLE_VALUE;
+                tracer.Trace( "offsetof mode: %u\n", (int) offsetof( struct stat_linux_syscall, st_mode ) );
+                pout->stx_blksize = (uint32_t) local_stat.st_blksize;
+                pout->stx_ino = local_stat.st_ino;
+                pout->stx_nlink = local_stat.st_nlink;
+                pout->stx_uid = local_stat.st_uid;
+                pout->stx_gid = local_stat.st_gid;
+                pout->stx_mode = (uint16_t) local_stat.st_mode;
+                pout->stx_size = local_stat.st_size;
+                pout->stx_blocks = local_stat.st_blocks;
+#if defined( __APPLE__ )
+                pout->stx_atime.tv_sec = local_stat.st_atimespec.tv_sec;
+                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atimespec.tv_nsec;
+                pout->stx_mtime.tv_sec = local_stat.st_mtimespec.tv_sec;
+                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtimespec.tv_nsec;
+                pout->stx_ctime.tv_sec = local_stat.st_ctimespec.tv_sec;
+                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctimespec.tv_nsec;
+#elif defined( __mc68000__ )
+                pout->stx_atime.tv_sec = local_stat.st_atime;
+                pout->stx_mtime.tv_sec = local_stat.st_mtime;
+                pout->stx_ctime.tv_sec = local_stat.st_ctime;
+#else
+                pout->stx_atime.tv_sec = local_stat.st_atim.tv_sec;
+                pout->stx_atime.tv_nsec = (uint32_t) local_stat.st_atim.tv_nsec;
+                pout->stx_mtime.tv_sec = local_stat.st_mtim.tv_sec;
+                pout->stx_mtime.tv_nsec = (uint32_t) local_stat.st_mtim.tv_nsec;
+                pout->stx_ctime.tv_sec = local_stat.st_ctim.tv_sec;
+                pout->stx_ctime.tv_nsec = (uint32_t) local_stat.st_ctim.tv_nsec;
+#endif // __APPLE__ || __mc68000__
 
-    void CloseFindFirst()
-    {
-        if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                pout->swap_endianness();
+#endif // SPARCOS
+                tracer.Trace( "  file size %d, isdir %s\n", (int) local_stat.st_size, S_ISDIR( local_stat.st_mode ) ? "yes" : "no" );
+            }
+            else
+                tracer.Trace( "  fstatat failed, error %d\n", errno );
+#endif // !_WIN32
+
+            update_result_errno( cpu, result );
+            break;
+        }
+        case SYS_rseq :
         {
-            FindClose( g_hFindFirst );
-            g_hFindFirst = INVALID_HANDLE_VALUE;
+            errno = EPERM;
+            update_result_errno( cpu, -1 );
+            break;
         }
-    } //CloseFindFirst
-#else //_WIN2
-    #include <dirent.h>
-    static DIR * g_FindFirst = 0;
-
-    void CloseFindFirst()
-    {
-        if ( 0 != g_FindFirst )
+        case SYS_riscv_flush_icache :
         {
-            closedir( g_FindFirst );
-            g_FindFirst = 0;
+            assert( false ); // no arm64 equivalent
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
         }
-    } //CloseFindFirst
-
-    void ExtractFilename( const char * filename, char * name, char * ext )
-    {
-        bool pastdot = false;
-        const char * p = filename;
-        int extlen = 0;
-        int namelen = 0;
-        while ( *p )
+        case SYS_pselect6:
         {
-            if ( '.' == *p )
-                pastdot = true;
+            int nfds = (int) ACCESS_REG( REG_ARG0 );
+            uint64_t readfds = ACCESS_REG( REG_ARG1 );
+
+            if ( 1 == nfds && 0 != readfds )
+            {
+                // check to see if stdin has a keystroke available
+
+                ACCESS_REG( REG_RESULT ) = g_consoleConfig.portable_kbhit();
+                tracer.Trace( "  pselect6 keystroke available on stdin: %llx\n", ACCESS_REG( REG_RESULT ) );
+            }
             else
             {
-                if ( pastdot )
-                    ext[ extlen++ ] = *p;
-                else
-                    name[ namelen++ ] = *p;
+                // lie and say no I/O is ready
+
+                ACCESS_REG( REG_RESULT ) = 0;
             }
 
-            p++;
+            break;
         }
-
-        assert( namelen <= 8 );
-        assert( extlen <= 3 );
-        name[ namelen ] = 0;
-        ext[ extlen ] = 0;
-    } //ExtractFilename
-
-    bool IsCPMPatternMatch( const char * pattern, const char * name )
-    {
-        bool match = true;
-        int o_pattern = 0, o_name = 0;
-        while ( pattern[ o_pattern ] || name[ o_name ] )
+        case SYS_ppoll_time32:
         {
-            char cp = pattern[ o_pattern ];
-            char cn = name[ o_name ];
+            struct pollfd_syscall * pfds = (struct pollfd_syscall *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            int nfds = (int) ACCESS_REG( REG_ARG1 );
+            struct timespec_syscall * pts = (struct timespec_syscall *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+            int * psigmask = (int *) ( ( 0 == ACCESS_REG( REG_ARG3 ) ) ? 0 : cpu.getmem( ACCESS_REG( REG_ARG3 ) ) );
 
-            if ( ( '?' != cp ) && ( cp != cn ) )
-            {
-                tracer.Trace( "  not a pattern match at offsets %d / %d\n", o_pattern, o_name );
-                match = false;
-                break;
-            }
+            tracer.Trace( "  count of file descriptors: %d\n", nfds );
+            for ( int i = 0; i < nfds; i++ )
+                tracer.Trace( "    fd %d: %d\n", i, pfds[ i ].fd );
 
-            if ( cp )
-                o_pattern++;
-            if ( cn )
-                o_name++;
+            // lie and say no I/O is ready
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
         }
-
-        return match;
-    } //IsCPMPatternMatch
-
-    bool FindNextFileLinux( const char * pattern, DIR * pdir, LINUX_FIND_DATA & fd )
-    {
-        do
+        case emulator_sys_readlink:
         {
-            struct dirent * pent = readdir( pdir );
-            if ( 0 == pent )
-                return false;
-
-            // ignore files CP/M just wouldn't understand
-
-            if ( !ValidCPMFilename( pent->d_name ) || IsAFolder( pent->d_name ) )
-                continue;
-
-            tracer.Trace( "  FindNextFileLinux is matching '%s' with '%s'\n", pattern, pent->d_name );
-
-            bool match = true;
-            if ( strcmp( pattern, "????????.???" ) )
-            {
-                // cp/m patterns contain '?' (match anything including nothing), ' ' (match nothing), or literal characters
-
-                char acName[ 9 ], acExt[ 4 ];
-                char acPatternName[ 9 ], acPatternExt[ 4 ];
-                ExtractFilename( pattern, acPatternName, acPatternExt );
-                ExtractFilename( pent->d_name, acName, acExt );
-
-                tracer.Trace( "  extracted pattern name '%s' ext '%s', file name '%s', ext '%s'\n", acPatternName, acPatternExt, acName, acExt );
-
-                match = IsCPMPatternMatch( acPatternName, acName );
-                if ( match )
-                    match = IsCPMPatternMatch( acPatternExt, acExt );
-            }
-
-            if ( !match )
-                continue;
-
-            strcpy( fd.cFileName, pent->d_name );
-            return true;
-        } while ( true );
-
-        return false;
-    } //FindNextFileLinux
-
-    DIR * FindFirstFileLinux( const char * pattern, LINUX_FIND_DATA & fd )
-    {
-        DIR * pdir = opendir( "." );
-        tracer.Trace( "  opendir returned %p, errno %d = %s\n", pdir, errno, strerror( errno ) );
-
-        if ( 0 == pdir )
-            return 0;
-
-        bool found = FindNextFileLinux( pattern, pdir, fd );
+            // shift the arguments over to make room for dirfd then fall through to readlinkat
 
-        if ( !found )
-        {
-            closedir( pdir );
-            return 0;
+            ACCESS_REG( REG_ARG3 ) = ACCESS_REG( REG_ARG2 );
+            ACCESS_REG( REG_ARG2 ) = ACCESS_REG( REG_ARG1 );
+            ACCESS_REG( REG_ARG1 ) = ACCESS_REG( REG_ARG0 );
+            ACCESS_REG( REG_ARG0 ) = (REG_TYPE) -100;
+            // fall through!
         }
-
-        return pdir;
-    } //FindFirstFileLinux
-
-#endif //_WIN32
-
-void ParseFoundFile( char * pfile )
-{
-    tracer.Trace( "  ParseFoundFile '%s'\n", pfile );
-    memset( g_DMA, 0, 128 );
-    memset( g_DMA + 1, ' ', 11 );
-
-    size_t len = strlen( pfile );
-    assert( len <= 12 ); // 8.3 only
-    _strupr( pfile );
-
-    for ( size_t i = 0; i < len; i++ )
-    {
-        if ( '.' == pfile[ i ] )
+        case SYS_readlinkat:
         {
-            for ( size_t e = 0; e < 3; e++ )
-            {
-                if ( 0 == pfile[ i + 1 + e ] )
-                    break;
+            int dirfd = (int) ACCESS_REG( REG_ARG0 );
+            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            char * buf = (char *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
+            size_t bufsiz = (size_t) ACCESS_REG( REG_ARG3 );
+            tracer.Trace( "  readlinkat pathname %p == '%s', buf %p, bufsiz %zd, dirfd %d\n", pathname, pathname, buf, bufsiz, dirfd );
+            int result = -1;
+            if ( vfs_readlink( cpu, dirfd, pathname ) )
+                break;
 
-                g_DMA[ 8 + e + 1 ] = pfile[ i + 1 + e ];
+            if ( !strcmp( pathname, "/proc/self/exe" ) ) // the app, not the emulator. otherwise its path length changes what the app executes
+            {
+                result = (int) get_min( strlen( g_acImagePath ), bufsiz );
+                memcpy( buf, g_acImagePath, result );
+                tracer.Trace( "  readlinkat of /proc/self/exe is the app: %.*s\n", result, buf );
+                update_result_errno( cpu, result );
+                break;
             }
 
+#if defined( _WIN32 )
+            errno = EINVAL; // no symbolic links on Windows as far as this emulator is concerned
+            result = -1;
+#else
+    #if defined( __APPLE__ )
+            if ( -100 == dirfd )
+                dirfd = -2;
+    #endif //__APPLE__
+            result = readlinkat( dirfd, pathname, buf, bufsiz );
+            tracer.Trace( "  result of readlinkat(): %d, %s\n", result, buf );
+#endif // _WIN32 || __mc68000__
+
+            update_result_errno( cpu, result );
             break;
         }
+        case SYS_ioctl:
+        {
+            int fd = (int) ACCESS_REG( REG_ARG0 );
+            unsigned long request = (unsigned long) ACCESS_REG( REG_ARG1 ) & 0xffff;
+            tracer.Trace( "  ioctl fd %d, request %lx\n", fd, request );
 
-        g_DMA[ i + 1 ] = pfile[ i ];
-    }
+#if defined( X64OS ) || defined( X32OS )
+            if ( ioctl_perf_event( cpu, fd, request, ACCESS_REG( REG_ARG2 ) ) )
+                break;
+#endif
 
-    tracer.Trace( "  search for first/next found '%c%c%c%c%c%c%c%c%c%c%c'\n",
-                    g_DMA[1], g_DMA[2], g_DMA[3], g_DMA[4], g_DMA[5], g_DMA[6], g_DMA[7], g_DMA[8],
-                    g_DMA[9], g_DMA[10],  g_DMA[11] );
-} //ParseFoundFile
+            struct local_kernel_termios * pt = (struct local_kernel_termios *) cpu.getmem( ACCESS_REG( REG_ARG2 ) );
 
-bool parse_FCB_Filename( FCBCPM68K * pfcb, char * pcFilename )
-{
-    char * orig = pcFilename;
+            if ( 0 == fd || 1 == fd || 2 == fd ) // stdin, stdout, stderr
+            {
+#if defined( _WIN32 ) || defined( __mc68000__ )
+                if ( 0x5401 == request || 0x5408 == request ) // TCGETS. 5401 is newer, 5408 is older like Linux on sparc
+                {
+                    memset( pt, 0, sizeof( *pt ) );
+                    if ( isatty( fd ) )
+                    {
+                        // populate with arbitrary but reasonable values
 
-    // note: the high bits are used for file attributes. Mask them away
+                        pt->c_iflag = 0;
+                        pt->c_oflag = 5;
+                        pt->c_cflag = 0xbf;
+                        pt->c_lflag = 0xa30;
+                        pt->swap_endianness();
+                        update_result_errno( cpu, 0 );
+                        break;
+                    }
 
-    for ( int i = 0; i < 8; i++ )
-    {
-        char c = ( 0x7f & pfcb->f[ i ] );
-        if ( ' ' == c )
-            break;
-        if ( '/' == c ) // slash is legal in CP/M and MT Pascal v3.0b uses it for P2/FLT.OVL. hack it to use #
-            c = '#';
-        *pcFilename++ = c;
-    }
+                    errno = ENOTTY;
+                    update_result_errno( cpu, -1 );
+                    break;
+                }
+                else if ( 0x5402 == request )
+                {
+                    // kbhit() works without all this fuss on Windows
+                }
+#else //defined( _WIN32 ) || defined( __mc68000__ )
+                // likely a TCGETS or TCSETS on stdin to check or enable non-blocking reads for a keystroke
 
-    if ( ' ' != pfcb->t[0] )
-    {
-        *pcFilename++ = '.';
+                if ( 0x5401 == request || 0x5408 == request ) // TCGETS
+                {
+                    struct termios val;
+                    int result = tcgetattr( fd, &val );
+                    if ( -1 == result )
+                    {
+                        tracer.Trace( "  tcgetattr on fd %d failed, errno %d\n", fd, errno );
+                        update_result_errno( cpu, -1 );
+                        break;
+                    }
+                    tracer.Trace( "  result %d, iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", result, val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
+                    pt->c_iflag = val.c_iflag;
+                    pt->c_oflag = val.c_oflag;
+                    pt->c_cflag = val.c_cflag;
+                    pt->c_lflag = val.c_lflag;
+#ifdef __APPLE__
+                    pt->c_iflag = map_termios_iflag_macos_to_linux( pt->c_iflag );
+                    pt->c_oflag = map_termios_oflag_macos_to_linux( pt->c_oflag );
+                    pt->c_cflag = map_termios_cflag_macos_to_linux( pt->c_cflag );
+                    pt->c_lflag = map_termios_lflag_macos_to_linux( pt->c_lflag );
+                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", pt->c_iflag, pt->c_oflag, pt->c_cflag, pt->c_lflag );
+#else //__APPLE__
+                    pt->c_line = val.c_line;
+                    memcpy( & pt->c_cc, & val.c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
+#endif //__APPLE__
+                    tracer.Trace( "  ioctl queried termios on stdin, sizeof local_kernel_termios %zd, sizeof val %zd\n",
+                                sizeof( struct local_kernel_termios ), sizeof( val ) );
+                }
+                else if ( 0x5402 == request ) // TCSETS
+                {
+                    struct termios val;
+                    memset( &val, 0, sizeof val );
+                    tracer.TraceBinaryData( (uint8_t *) pt, sizeof( struct local_kernel_termios ), 4 );
+                    tracer.Trace( "  oflag %#x OPOST %#x ONLCR %#x OCRNL %#x ONOCR %#x ONLRET %#x\n",
+                                  pt->c_oflag, OPOST, ONLCR, OCRNL, ONOCR, ONLRET );
+                    tracer.Trace( "  iflag %#x IGNBRK %#x BRKINT %#x IGNPAR %#x PARMRK %#x INPCK %#x ISTRIP %#x INLCR %#x IGNCR %#x ICRNL %#x IXON %#x IXOFF %#x IXANY %#x IMAXBEL %#x IUTF8 %#x\n",
+                                  pt->c_iflag, IGNBRK, BRKINT, IGNPAR, PARMRK, INPCK, ISTRIP, INLCR, IGNCR, ICRNL, IXON, IXOFF, IXANY, IMAXBEL, IUTF8 );
+                    tracer.Trace( "  cflag %#x CSIZE %#x, CSTOPB %#x CREAD %#x PARENB %#x PARODD %#x CS5 %#x CS6 %#x CS7 %#x CS8 %#x HUPCL %#x CLOCAL %#x\n",
+                                  CSIZE, CSTOPB, CREAD, PARENB, PARODD, CS5, CS6, CS7, CS8, HUPCL, CLOCAL );
+#ifdef sparc
+                    tracer.Trace( "  lflag %#x ECHOKE %#x ECHOE %#x ECHOK %#x ECHO %#x ECHONL %#x ECHOPRT %#x ECHOCTL %#x ICANON %#x ISIG %#x IEXTEN %#x TOSTOP %#x\n",
+                                  ECHOKE, ECHOE, ECHOK, ECHO, ECHONL, ECHOPRT, ECHOCTL, ICANON, ISIG, IEXTEN, TOSTOP );
+#else
+                    tracer.Trace( "  lflag %#x ECHOKE %#x ECHOE %#x ECHOK %#x ECHO %#x ECHONL %#x ECHOPRT %#x ECHOCTL %#x ICANON %#x ISIG %#x IEXTEN %#x EXTPROC %#x TOSTOP %#x\n",
+                                  ECHOKE, ECHOE, ECHOK, ECHO, ECHONL, ECHOPRT, ECHOCTL, ICANON, ISIG, IEXTEN, EXTPROC, TOSTOP );
+#endif
 
-        for ( int i = 0; i < 3; i++ )
+                    val.c_iflag = pt->c_iflag;
+                    val.c_oflag = pt->c_oflag;
+                    val.c_cflag = pt->c_cflag;
+                    val.c_lflag = pt->c_lflag;
+                    tracer.Trace( "  iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
+#ifdef __APPLE__
+                    val.c_iflag = map_termios_iflag_linux_to_macos( val.c_iflag );
+                    val.c_oflag = map_termios_oflag_linux_to_macos( val.c_oflag );
+                    val.c_cflag = map_termios_cflag_linux_to_macos( val.c_cflag );
+                    val.c_lflag = map_termios_lflag_linux_to_macos( val.c_lflag );
+                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
+#else //__APPLE__
+                    val.c_line = pt->c_line;
+                    memcpy( & val.c_cc, & pt->c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
+#endif //__APPLE__
+                    tracer.TraceBinaryData( (uint8_t *) &val, sizeof( struct termios ), 4 );
+                    tcsetattr( 0, TCSANOW, &val );
+                    tracer.Trace( "  ioctl set termios on stdin\n" );
+                }
+#endif //defined( _WIN32 ) || defined( __mc68000__ )
+            }
+            else if ( 1 == fd ) // stdout
+            {
+                if ( 0x5401 == request || 0x5408 == request ) // TCGETS
+                {
+#if defined( _WIN32 ) || defined( __mc68000__ ) || defined( sparc )
+                    if ( isatty( fd ) )
+                        update_result_errno( cpu, 0 );
+                    else
+                        update_result_errno( cpu, -1 );
+
+                    break;
+#else //defined( _WIN32 ) || defined( __mc68000__ )
+                    struct termios val;
+                    int result = tcgetattr( fd, &val );
+                    tracer.Trace( "  result: %d, iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", result, val.c_iflag, val.c_oflag, val.c_cflag, val.c_lflag );
+                    if ( -1 == result )
+                    {
+                        update_result_errno( cpu, -1 );
+                        break;
+                    }
+                    pt->c_iflag = val.c_iflag;
+                    pt->c_oflag = val.c_oflag;
+                    pt->c_cflag = val.c_cflag;
+                    pt->c_lflag = val.c_lflag;
+#ifdef __APPLE__
+                    pt->c_iflag = map_termios_iflag_macos_to_linux( pt->c_iflag );
+                    pt->c_oflag = map_termios_oflag_macos_to_linux( pt->c_oflag );
+                    pt->c_cflag = map_termios_cflag_macos_to_linux( pt->c_cflag );
+                    pt->c_lflag = map_termios_lflag_macos_to_linux( pt->c_lflag );
+                    tracer.Trace( "  translated iflag %#x, oflag %#x, cflag %#x, lflag %#x\n", pt->c_iflag, pt->c_oflag, pt->c_cflag, pt->c_lflag );
+#else //__APPLE__
+                    pt->c_line = val.c_line;
+                    memcpy( & pt->c_cc, & val.c_cc, get_min( sizeof( pt->c_cc ), sizeof( val.c_cc ) ) );
+#endif //__APPLE__
+                    tracer.Trace( "  ioctl queried termios on stdout, sizeof local_kernel_termios %zd, sizeof val %zd\n",
+                                sizeof( struct local_kernel_termios ), sizeof( val ) );
+#endif //defined( _WIN32 ) || defined( __mc68000__ )
+                }
+
+            }
+
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case SYS_set_tid_address:
         {
-            char c = ( 0x7f & pfcb->t[ i ] );
-            if ( ' ' == c )
+            ACCESS_REG( REG_RESULT ) = 1;
+            break;
+        }
+        case SYS_madvise:
+        {
+            ACCESS_REG( REG_RESULT ) = 0; // report success
+            break;
+        }
+#if defined( X64OS ) || defined( X32OS )
+        case SYS_perf_event_open:
+        {
+            REG_TYPE attr = ACCESS_REG( REG_ARG0 );
+            if ( !cpu.is_address_valid( attr ) || !cpu.is_address_valid( attr + 47 ) ) // open_perf_event reads the first 48 bytes
+            {
+                errno = EFAULT;
+                update_result_errno( cpu, -1 );
                 break;
-            *pcFilename++ = c;
+            }
+
+            const uint8_t * pattr = (const uint8_t *) cpu.getmem( attr );
+            int result = open_perf_event( cpu, pattr, (int) ACCESS_REG( REG_ARG1 ), (int) ACCESS_REG( REG_ARG3 ) );
+            update_result_errno( cpu, result );
+            break;
+        }
+#endif
+        case SYS_set_robust_list:
+        case SYS_prlimit64:
+        case SYS_mprotect:
+            // ignore for now
+            break;
+
+#endif // !defined(OLDGCC)
+        case SYS_faccessat:
+        {
+            const char * pathname = (const char *) cpu.getmem( ACCESS_REG( REG_ARG1 ) );
+            if ( vfs_access( cpu, (int) ACCESS_REG( REG_ARG0 ), pathname, (int) ACCESS_REG( REG_ARG2 ) ) )
+                break;
+
+            tracer.Trace( "  faccessat failing for path %s\n", pathname );
+
+            errno = 2; // not found
+            update_result_errno( cpu, -1 );
+            break;
+        }
+        case SYS_getuid:
+        case SYS_geteuid:
+        case SYS_getgid:
+        case SYS_getegid:
+        {
+            update_result_errno( cpu, 0x5549 ); // IU. Love wins all.
+            break;
+        }
+        default:
+        {
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+            printf( "error; ecall invoked with unknown command %u = %#x, a0 %#x, a1 %#x, a2 %#x\n",
+                    syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
+            tracer.Trace( "error; ecall invoked with unknown command %u = %#x, a0 %#x, a1 %#x, a2 %#x\n",
+                          syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
+#else
+            printf( "error; ecall invoked with unknown command %llu = %llx, a0 %#llx, a1 %#llx, a2 %#llx\n",
+                    syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
+            tracer.Trace( "error; ecall invoked with unknown command %llu = %llx, a0 %#llx, a1 %#llx, a2 %#llx\n",
+                          syscall_id, syscall_id, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), ACCESS_REG( REG_ARG2 ) );
+#endif
+            fflush( stdout );
+            //ACCESS_REG( REG_RESULT ] = -1;
         }
     }
 
-    *pcFilename = 0;
+#if defined( X64OS ) || defined( X32OS )
+    if ( g_syscallRecordFile )
+        end_record_syscall( cpu );
+    else if ( g_syscallReplayPending )
+        end_replay_syscall( cpu, syscall_id );
 
-    // CP/M assumes all filenames are uppercase. Linux users generally use all lowercase filenames
+    end_flight_syscall( cpu );
+#endif
+} //emulator_invoke_svc
 
-    if ( g_forceLowercase )
-        _strlwr( orig );
+#ifdef SPARCOS
 
-    return ( pcFilename != orig );
-} //parse_FCB_Filename
+#pragma warning(disable: 4127) // conditional expression is constant
 
-void WriteRandom( m68000 & cpu )
+void emulator_invoke_sparc_trap5( Sparc & cpu ) // called for trap #5 overflow of register window from save instrution
 {
-    FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-    pfcb->Trace();
-    ACCESS_REG( REG_RESULT ) = 6; // seek past end of disk
+    // copy the register window that's marked as invalid / in-use to the memory location pointed to by the stack pointer o6 / 14 in the target register window
 
-    char acFilename[ CPM_FILENAME_LEN ];
-    bool ok = parse_FCB_Filename( pfcb, acFilename );
-    if ( ok )
-    {
-        FILE * fp = FindFileEntry( acFilename );
-        if ( fp )
-        {
-            uint32_t record = pfcb->GetRandomIOOffset();
-            uint32_t file_offset = record * (uint32_t) 128;
+    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // once because we're handling a trap
+    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // again for the nested save
 
-            fseek( fp, 0, SEEK_END );
-            uint32_t file_size = ftell( fp );
-            tracer.Trace( "  write random file %p, record %#x, file_offset %d, file_size %d\n", fp, record, file_offset, file_size );
+    if ( 0 == cpu.Sparc_reg( 14 ) )
+        emulator_hard_termination( cpu, "sp is 0 in overflow trap from a save instruction", cpu.pc );
 
-            if ( file_offset > file_size )
-            {
-                ok = !fseek( fp, file_offset, SEEK_SET );
-                if ( ok )
-                    file_size = ftell( fp );
-                else
-                    tracer.Trace( "  can't seek to extend file with zeros, error %d = %s\n", errno, strerror( errno ) );
-            }
+    memcpy( cpu.getmem( cpu.Sparc_reg( 14 ) ), & cpu.Sparc_reg( 16 ), 64 ); // spill
 
-            if ( file_size >= file_offset )
-            {
-                ok = !fseek( fp, file_offset, SEEK_SET );
-                if ( ok )
-                {
-                    tracer.Trace( "  writing random at offset %#x\n", file_offset );
-                    tracer.TraceBinaryData( g_DMA, 128, 2 );
-                    size_t numwritten = fwrite( g_DMA, 128, 1, fp );
-                    if ( numwritten )
-                    {
-                        ACCESS_REG( REG_RESULT ) = 0;
+    #ifndef NDEBUG
+    memset( & cpu.Sparc_reg( 16 ), 0, 64 ); // the register window can be trashed at this point. validate this is true in debug builds.
+    #endif
 
-                        // The CP/M spec says random write should set the file offset such
-                        // that the following sequential I/O will be from the SAME location
-                        // as this random write -- not 128 bytes beyond.
+    //tracer.Trace( "  sp being spilled to: %#x from register address %p, cwp:%u\n", cpu.Sparc_reg( 14 ), & cpu.Sparc_reg( 16 ), cpu.get_cwp() );
+    //tracer.TraceBinaryData( cpu.getmem( cpu.Sparc_reg( 14 ) ), 64, 4 );
 
-                        fseek( fp, file_offset, SEEK_SET );
-                    }
-                    else
-                        tracer.Trace( "ERROR: can't write in write random, error %d = %s\n", errno, strerror( errno ) );
-                }
-                else
-                    tracer.Trace( "ERROR: can't seek in write random, offset %#x, size %#x\n", file_offset, file_size );
-            }
-            else
-                tracer.Trace( "ERROR: write random at offset %d beyond end of file size %d\n", file_offset, file_size );
-        }
-        else
-            tracer.Trace( "ERROR: write random on unopened file\n" );
-    }
-    else
-        tracer.Trace( "ERROR: write random can't parse filename\n" );
-} //WriteRandom
+    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) );
 
-uint8_t map_input( uint8_t input )
-{
-    uint8_t output = input;
+    // update the wim for the current register window to be valid so when save is retried it doesn't trap and
+    // the window following cwp_new to in-use, so subsequent SAVE instructions will spill it
 
-#if defined(_MSC_VER) || defined(WATCOM)
-    // On Windows, input is  0xe0 for standard arrow keys and 0 for keypad equivalents
-    // On DOS/WATCOM, input is 0 for both cases
+    cpu.wim = ( cpu.wim << ( cpu.NWINDOWS - 1 ) ) | ( cpu.wim >> 1 );
+    if ( 32 != cpu.NWINDOWS )
+        cpu.wim &= ( ( 1 << cpu.NWINDOWS ) - 1 ); // mask off unused high bits
 
-    if ( 0 == input || 0xe0 == input )
-    {
-        uint8_t next = (uint8_t) ConsoleConfiguration::portable_getch();
+    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // the equivalent of a RETT instruction
+} //emulator_invoke_sparc_trap5
 
-        // map various keys to ^ XSEDCRG used in many apps.
+void emulator_invoke_sparc_trap6( Sparc & cpu ) // called for trap #6 underflow of register window from restore instruction
+{
+    // copy the register window that's marked as invalid / in-use from the current memory location pointed to by the stack pointer o6 / 14 in the target register window
+    // note: offsetting next_save and next_restore calls are #ifdef'ed out for performance
 
-        if ( 'K' == next )                   // left arrow
-            output = 1 + 'S' - 'A';
-        else if ( 'P' == next )              // down arrow
-            output = 1 + 'X' - 'A';
-        else if ( 'M' == next )              // right arrow
-            output = 1 + 'D' - 'A';
-        else if ( 'H' == next )              // up arrow
-            output = 1 + 'E' - 'A';
-        else if ( 'Q' == next )              // page down
-            output = 1 + 'C' - 'A';
-        else if ( 'I' == next )              // page up
-            output = 1 + 'R' - 'A';
-        else if ( 'S' == next )              // del
-            output = 1 + 'G' - 'A';
-        else
-            tracer.Trace( "  no map_input mapping for %02x, second character %02x\n", input, next );
+#if CWP_REALITY // this isn't defined but could be to match what would happen in an actual handler
+    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // because we're handling a trap
+    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // restore twice to point at the frame to restore
+#endif
+    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) );
 
-        tracer.Trace( "    next character after %02x: %02x == '%c' mapped to %02x\n", input, printable( next ), output );
-    }
-#else // Linux / MacOS
-    if ( 0x1b == input )
-    {
-        if ( g_consoleConfig.portable_kbhit() )
-        {
-            tracer.Trace( "read an escape on linux... getting next char\n" );
-            uint8_t nexta = ConsoleConfiguration::portable_getch();
-            tracer.Trace( "read an escape on linux... getting next char again\n" );
-            uint8_t nextb = ConsoleConfiguration::portable_getch();
-            tracer.Trace( "  nexta: %02x. nextb: %02x\n", nexta, nextb );
+    if ( 0 == cpu.Sparc_reg( 14 ) )
+        emulator_hard_termination( cpu, "sp is 0 in underflow trap from a restore instruction", cpu.get_cwp() );
 
-            if ( '[' == nexta )
-            {
-                if ( 'A' == nextb )              // up arrow
-                    output = 1 + 'E' - 'A';
-                else if ( 'B' == nextb )         // down arrow
-                    output = 1 + 'X' - 'A';
-                else if ( 'C' == nextb )         // right arrow
-                    output = 1 + 'D' - 'A';
-                else if ( 'D' == nextb )         // left arrow
-                    output = 1 + 'S' - 'A';
-                else if ( '5' == nextb )         // page up
-                {
-                    uint8_t nextc = g_consoleConfig.portable_getch();
-                    tracer.Trace( "  5 nextc: %02x\n", nextc );
-                    if ( '~' == nextc )
-                        output = 1 + 'R' - 'A';
-                }
-                else if ( '6' == nextb )         // page down
-                {
-                    uint8_t nextc = g_consoleConfig.portable_getch();
-                    tracer.Trace( "  6 nextc: %02x\n", nextc );
-                    if ( '~' == nextc )
-                        output = 1 + 'C' - 'A';
-                }
-                else if ( '3' == nextb )         // DEL on linux
-                {
-                    uint8_t nextc = g_consoleConfig.portable_getch();
-                    tracer.Trace( "  3 nextc: %02x\n", nextc );
-                    if ( '~' == nextc )
-                        output = 0x7f;
-                }
-                else
-                    tracer.Trace( "unhandled nextb %u == %02x\n", nextb, nextb ); // lots of other keys not on a cp/m machine here
-            }
-            else
-                tracer.Trace( "unhandled linux keyboard escape sequence\n" );
-        }
-    }
+    memcpy( & cpu.Sparc_reg( 16 ), cpu.getmem( cpu.Sparc_reg( 14 ) ), 64 ); // unspill
+
+    //tracer.Trace( "  sp being unspilled from: %#x to register address %p, cwp:%u\n", cpu.Sparc_reg( 14 ), & cpu.Sparc_reg( 16 ), cpu.get_cwp() );
+    //tracer.TraceBinaryData( cpu.getmem( cpu.Sparc_reg( 14 ) ), 64, 4 );
+
+    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) ); // restore the original cwp
+#if CWP_REALITY
+    cpu.set_cwp( cpu.next_save_cwp( cpu.get_cwp() ) );
 #endif
 
-    return output;
-} //map_input
+    cpu.wim = ( cpu.wim >> ( cpu.NWINDOWS - 1 ) ) | ( cpu.wim << 1 );
+    if ( 32 != cpu.NWINDOWS )
+        cpu.wim &= ( ( 1 << cpu.NWINDOWS ) - 1 ); // mask off unused high bits
 
-void emulator_invoke_68k_trap3( m68000 & cpu ) // bios
+#if CWP_REALITY
+    cpu.set_cwp( cpu.next_restore_cwp( cpu.get_cwp() ) ); // the equivalent of a RETT instruction
+#endif
+} //emulator_invoke_sparc_trap6
+
+#endif //SPARCOS
+
+#ifdef M68
+
+// called when trap #15 is invoked for an IDE68K emulator system call
+// hard-code register values because they differ from linux syscall calling convention
+
+void emulator_invoke_68k_trap15( m68000 & cpu )
 {
-    uint16_t function = ( 0xffff & ACCESS_REG( REG_SYSCALL ) );
-    tracer.Trace( "trap 3 cp/m 68k bios call %u arguments %#x, %#x -- %s\n", function, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), bios_function( function ) );
+    uint16_t svc = cpu.getui16( cpu.pc + 2 ); // two bytes that are two bytes past the trap instruction
+    tracer.Trace( "68k trap 15: svc %u, reg0 %x\n", svc, ACCESS_REG( 0 ) );
 
-    switch( function )
+    switch( svc )
     {
-        case 0: // cold boot
-        case 1: // warm boot
+        case 0: // exit
         {
             g_terminate = true;
             cpu.end_emulation();
-            g_exit_code = (int) ACCESS_REG( REG_ARG0 ); // not part of the cp/m 68k spec but it seems handy
+            g_exit_code = (int) ACCESS_REG( 0 );
             tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
             break;
         }
-        case 2: // console status (check for console character ready)
-        {
-            if ( is_kbd_char_available() )
-                ACCESS_REG( REG_RESULT ) = 0xff;
-            else
-                ACCESS_REG( REG_RESULT ) = 0;
-            tracer.Trace( "  status is returing %x\n", (uint8_t) ACCESS_REG( REG_RESULT ) );
-            break;
-        }
-        case 3: // read console character in
-        {
-            uint8_t input = (uint8_t) get_next_kbd_char();
-            tracer.Trace( "  read character %u == %02x == '%c'\n", input, input, printable( input ) );
-            ACCESS_REG( REG_RESULT ) = map_input( input );
-            break;
-        }
-        case 4: // write console character
-        {
-            uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
-            if ( 0 != ch )  // cp/m 68k assembler as.68k v1 outputs a null character; ignore it.
-            {
-                tracer.Trace( "  bios write console: %02x == '%c'\n", ch, printable( ch ) );
-                send_character( ch );
-                fflush( stdout );
-            }
-            break;
-        }
-        case 22: // set exception handler address
+        case 1: // putch
         {
-            uint32_t vector_number = 0xffff & ACCESS_REG( REG_ARG0 );
-            uint32_t vector_address = ACCESS_REG( REG_ARG1 );
-            ACCESS_REG( REG_RESULT ) = cpu.getui32( vector_number * 4 );
-            cpu.setui32( vector_number * 4, vector_address );
+            uint8_t val = (uint8_t) ACCESS_REG( 0 );
+            SetBinaryMode bm( 10 == val );
+            size_t written = write( 1, &val, 1 );
+            update_result_errno( cpu, (REG_TYPE) written );
             break;
         }
         default:
         {
-            printf( "  unhandled cp/m bios call %u\n", function );
-            tracer.Trace( "  unhandled cp/m bios call %u\n", function );
-            ACCESS_REG( REG_RESULT ) = 0xff;
+            tracer.Trace( "unimplemented 68k trap #15 service %u\n", svc );
             break;
         }
     }
-} //emulator_invoke_68k_trap3
-
-uint16_t days_since_jan1_1978()
-{
-    time_t current_time;
-    struct tm *time_info;
-
-    current_time = time( 0 );
-    time_info = localtime( &current_time );
-
-    struct tm target_date = {0};
-    target_date.tm_year = 1978 - 1900; // Years since 1900
-    target_date.tm_mon = 0;         // January (0-indexed)
-    target_date.tm_mday = 1;
-    target_date.tm_hour = 0;
-    target_date.tm_min = 0;
-    target_date.tm_sec = 0;
+} //emulator_invoke_68k_trap15
 
-    time_t target_time = mktime( &target_date );
-    time_t difference_seconds = current_time - target_time;
-    uint16_t days_since_1978 = (uint16_t) ( difference_seconds / ( 24 * 60 * 60 ) );
-    return days_since_1978;
-} //days_since_jan1_1978
+#pragma pack( push, 1 )
 
-void emulator_invoke_68k_trap2( m68000 & cpu ) // bdos
+struct IOParam
 {
-    char acFilename[ CPM_FILENAME_LEN ];
-    uint16_t function = ( 0xffff & ACCESS_REG( REG_SYSCALL ) );
-    tracer.Trace( "trap 2 cp/m 68k bdos call %u, argument %#x -- %s\n", function, ACCESS_REG( REG_ARG0 ), bdos_function( function ) );
+    uint32_t qLink; // pointer
+    int16_t qType; 
+    int16_t ioTrap; 
+    uint32_t ioCmdAddr; // pointer
+    uint32_t ioCompletion; // pointer
+    int16_t ioResult; 
+    uint32_t ioNamePtr; // pointer
+    int16_t ioVRefNum;
+    int16_t ioRefNum;
+    char ioVersNum;
+    char ioPermssn;
+    uint32_t ioMisc; // pointer
+    uint32_t ioBuffer; // pointer
+    int32_t ioReqCount;
+    int32_t ioActCount;
+    int16_t ioPosMode;
+    int32_t ioPosOffset;
 
-    // note: only the subset invoked by cp/m 68k versions of the C, BASIC, and Pascal compilers, assembler, and linker are implemented.
+    void swap_endianness()
+    {
+        qLink = swap_endian32( qLink );
+        qType = swap_endian16( qType );
+        ioTrap = swap_endian16( ioTrap );
+        ioCmdAddr = swap_endian32( ioCmdAddr );
+        ioCompletion = swap_endian32( ioCompletion );
+        ioResult = swap_endian16( ioResult );
+        ioNamePtr = swap_endian32( ioNamePtr );
+        ioVRefNum = swap_endian16( ioVRefNum );
+        ioRefNum = swap_endian16( ioRefNum );
+        ioMisc = swap_endian32( ioMisc );
+        ioBuffer = swap_endian32( ioBuffer );
+        ioReqCount = swap_endian32( ioReqCount );
+        ioActCount = swap_endian32( ioActCount );
+        ioPosMode = swap_endian16( ioPosMode );
+        ioPosOffset = swap_endian32( ioPosOffset );
+    }
 
-    switch ( function )
+    void trace()
     {
-        case 0: // system reset; exit the app
-        {
-            g_terminate = true;
-            cpu.end_emulation();
-            g_exit_code = (int) ACCESS_REG( REG_ARG0 ); // not part of the cp/m 68k spec but it seems handy
-            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
-            break;
-        }
-        case 1: // console input. echo input to console
-        {
-            uint8_t ch = (uint8_t) get_next_kbd_char();
-            ACCESS_REG( REG_RESULT ) = map_input( ch );
-            tracer.Trace( "  bdos console in: %02x == '%c'\n", ch, printable( ch ) );
-            send_character( ch );
-            fflush( stdout );
-            break;
-        }
-        case 2: // console output. d1.w ascii chracter
-        {
-            // console output
-            // CP/M 2.2 checks for ^s and ^q to pause and resume output. If output is paused due to ^s,
-            // a subsequent ^c terminates the application. ^q resumes output then ^c has no effect.
+        tracer.Trace( "  IOParam:\n" );
+        tracer.Trace( "    qLink %#x\n", qLink );
+        tracer.Trace( "    qType %#x\n", qType );
+        tracer.Trace( "    ipTrap %#x\n", ioTrap );
+        tracer.Trace( "    ioCmdAdddr %#x\n", ioCmdAddr );
+        tracer.Trace( "    ioCompletion %#x\n", ioCompletion );
+        tracer.Trace( "    ioResult %#x\n", ioResult );
+        tracer.Trace( "    ioNamePtr %#x\n", ioNamePtr  );
+        tracer.Trace( "    ioVRefNum %#x\n", ioVRefNum );
+        tracer.Trace( "    ioRefNum %#x\n", ioRefNum );
+        tracer.Trace( "    ioVersNum %#x\n", ioVersNum );
+        tracer.Trace( "    ioPermssn %#x\n", ioPermssn );
+        tracer.Trace( "    ioMisc %#x\n", ioMisc );
+        tracer.Trace( "    ioBuffer %#x\n", ioBuffer );
+        tracer.Trace( "    ioReqCount %#x\n", ioReqCount  );
+        tracer.Trace( "    ioActCount %#x\n", ioActCount );
+        tracer.Trace( "    ioPosMode %#x\n", ioPosMode );
+        tracer.Trace( "    ioPosOffset %#x\n", ioPosOffset );
+    }
+};
 
-            uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
-            if ( 0 != ch )  // cp/m 68k assembler as.68k v1 outputs a null character; ignore it.
-            {
-                tracer.Trace( "  bdos console out: %02x == '%c'\n", ch, printable( ch ) );
-                send_character( ch );
-                fflush( stdout );
-            }
+#pragma pack(pop)
 
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 6: // direct console i/o. Note slightly different behavior than cp/m 80 v2.2 with the 0xff and 0xfe distinction
-        {
-            uint16_t cmd = (uint16_t) ( 0xffff & ACCESS_REG( REG_ARG0 ) );
-            if ( 0xff == cmd ) // input. block until a character is ready
-            {
-                uint8_t input = (uint8_t) get_next_kbd_char();
-                tracer.Trace( "  read character %u == %02x == '%c'\n", input, input, printable( input ) );
-                ACCESS_REG( REG_RESULT ) = map_input( input );
-            }
-            else if ( 0xfe == cmd ) // status. return non-zero if available and 0 if unavailable
-            {
-                if ( is_kbd_char_available() )
-                    ACCESS_REG( REG_RESULT ) = 1;
-                else
-                    ACCESS_REG( REG_RESULT ) = 0;
-            }
-            else // output
-            {
-                uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
-                tracer.Trace( "  bdos console i/o output: %02x == '%c'\n", ch, printable( ch ) );
-                send_character( ch );
-                fflush( stdout );
-            }
-            break;
-        }
-        case 9: // print string. send $-terminated string to stdout
-        {
-            char * str = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            char * pdollar = strchr( str, '$' );
-            if ( pdollar )
-            {
-                tracer.Trace( "   string: %.*s\n", pdollar - str, str );
-                tracer.TraceBinaryData( (uint8_t *) str, (uint32_t) ( pdollar - str ), 4 );
-            }
-            uint32_t count = 0;
-            while ( '$' != *str )
-            {
-                if ( count++ > 2000 ) // arbitrary limit, but probably a bug if this long
-                {
-                    tracer.Trace( "  ERROR: String to print is too long!\n", stderr );
-                    break;
-                }
+#define macos_trapa_async 0x0400
 
-                uint8_t ch = *str++;
-                send_character( ch );
-            }
-            fflush( stdout );
-            break;
-        }
-        case 10: // read console buffer. aka buffered console input. DE: buffer address. buffer:
-        {
-            //   0      1         2       3
-            //   in_len out_len   char1   char2 ...
+#define macos_trapa_open 0
+#define macos_trapa_close 1
+#define macos_trapa_read 2
+#define macos_trapa_write 3
+#define macos_trapa_exittoshell 0x9f4
 
-            char * pbuf = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pbuf[ 1 ] = 0;
-            uint16_t in_len = *pbuf;
+#define macos_trapa_control 4
 
-            if ( in_len > 0 )
-            {
-                pbuf[ 2 ] = 0;
-                uint8_t out_len;
-                bool reboot = cpm_read_console( pbuf + 2, in_len, out_len );
-                if ( reboot )
-                {
-                    tracer.Trace( "  bdos read console buffer read a ^c at the first position, so it's terminating the app\n" );
-                    cpu.end_emulation();
-                    g_terminate = true;
-                    g_exit_code = 1;
-                    break;
-                }
+void emulator_invoke_68k_trap10( m68000 & cpu, uint16_t op )
+{
+    tracer.Trace( "68k a-line trap: op: %x\n", op );
 
-                pbuf[ 1 ] = out_len;
-                tracer.Trace( "  read console len %u, string '%.*s'\n", out_len, (size_t) out_len, pbuf + 2 );
-            }
-            else
-                tracer.Trace( "WARNING: read console buffer asked for input but provided a 0-length buffer\n" );
-            break;
-        }
-        case 11: // get console status
+    if ( macos_trapa_async & op )
+    {
+        tracer.Trace( "asynchronous calls aren't supported\n" );
+        ACCESS_REG( 0 ) = EINVAL;
+    }
+
+    switch( op & 0xbff )
+    {
+        case macos_trapa_write:
         {
-            // for now lie and say no characters are available
+            IOParam * p = (IOParam *) cpu.getmem( cpu.aregs[ 0 ] );
+            IOParam local = *p;
+            local.swap_endianness();
+            //local.trace();
+            tracer.Trace( "  ioRefNum: %x, ioReqCount %x, ioBuffer %x, ioPosMode %x\n", local.ioRefNum, local.ioReqCount, local.ioBuffer, local.ioPosMode );
+            if ( 1 == local.ioRefNum || 2 == local.ioRefNum ) // stdout / stderr
+                tracer.Trace( "  writing '%.*s'\n", (int) local.ioReqCount, cpu.getmem( local.ioBuffer ) );
+            tracer.TraceBinaryData( cpu.getmem( local.ioBuffer ), (uint32_t) local.ioReqCount, 4 );
 
-            ACCESS_REG( REG_RESULT ) = 0;
+            int written;
+
+#ifdef _WIN32
+            written = WinWrite( local.ioRefNum, cpu.getmem( local.ioBuffer ), (int) local.ioReqCount );
+#else
+            written = write( local.ioRefNum, cpu.getmem( local.ioBuffer ), (int) local.ioReqCount );
+#endif
+
+            p->ioActCount = swap_endian32( written );
+            ACCESS_REG( 0 ) = 0;
             break;
         }
-        case 12: // return version number
+        case macos_trapa_exittoshell:
         {
-            ACCESS_REG( REG_RESULT ) = 0x2022; // cp/m-68k v1.1
+            g_terminate = true;
+            cpu.end_emulation();
+            g_exit_code = (int) ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
             break;
         }
-        case 13: // reset disks.
+        default:
         {
-            ACCESS_REG( REG_RESULT ) = 0;
+            tracer.Trace( "unimplemented 68k trap #10 op %x\n", op );
+            ACCESS_REG( 0 ) = EINVAL;
             break;
         }
-        case 14: // select disk. Return 0 in result if OK, or 0xff otherwise.
-        {
-            uint8_t disk = (uint8_t) ACCESS_REG( REG_ARG0 );
-            tracer.Trace( "  selected disk %d == %c\n", disk, ( disk < 16 ) ? disk + 'A' : '?' );
+    }
+} //emulator_invoke_68k_trap10
 
-            if ( 0 == disk )
-                ACCESS_REG( REG_RESULT ) = 0;
-            else
-                ACCESS_REG( REG_RESULT ) = 255;
-            break;
-        }
-        case 15: // open file. success 0-3, error 0xff
-        {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            tracer.TraceBinaryData( (uint8_t *) pfcb, sizeof( FCBCPM68K ), 4 );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                tracer.Trace( "  opening file '%s' for pfcb %p\n", acFilename, pfcb );
-                FILE * fp = FindFileEntry( acFilename );
-                if ( fp )
-                {
-                    // sometimes apps like the CP/M assembler ASM open files that are already open.
-                    // rewind it to position 0.
+#endif
 
-                    fseek( fp, 0, SEEK_SET );
-                    ACCESS_REG( REG_RESULT ) = 0;
-                    pfcb->cr = 0;
-                    pfcb->SetRecordCount( fp ); // Whitesmith C 2.1 requires this to be set
-                    // don't reset extent on a re-open or LK80.COM will fail. pfcb->ex = 0;
-                    pfcb->s2 = 0;
-                    tracer.Trace( "  open used existing file and rewound to offset 0\n" );
-                }
-                else
-                {
-                    // the cp/m 2.2 spec says that filenames may contain question marks. I haven't found an app that uses that.
+#ifdef RVOS
+static const char * riscv_register_names[ 32 ] =
+{
+    "zero", "ra", "sp",  "gp",  "tp", "t0", "t1", "t2",
+    "s0",   "s1", "a0",  "a1",  "a2", "a3", "a4", "a5",
+    "a6",   "a7", "s2",  "s3",  "s4", "s5", "s6", "s7",
+    "s8",   "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+};
+#endif
 
-                    fp = fopen( acFilename, "r+b" );
-                    if ( fp )
-                    {
-                        FileEntry fe;
-                        strcpy( fe.acName, acFilename );
-                        fe.fp = fp;
-                        g_fileEntries.push_back( fe );
-                        ACCESS_REG( REG_RESULT ) = 0;
+#ifdef X64OS
+static const char * x64_register_names[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+#endif
 
-                        // Digital Research's lk80.com linker has many undocumented expectations no other apps I've tested have.
-                        // including rc > 0 after an open. Whitesmith C requires the record count set correctly.
+#ifdef X32OS
+static const char * x32_register_names[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi" };
+#endif
 
-                        pfcb->SetRecordCount( fp );
+#ifdef SPARCOS
+static const char * sparc_register_names[ 32 ] =
+{
+    "g0", "g1", "g2", "g3", "g4", "g5", "g6", "g7",
+    "o0", "o1", "o2", "o3", "o4", "o5", "sp", "o7",
+    "l0", "l1", "l2", "l3", "l4", "l5", "l6", "l7",
+    "i0", "i1", "i2", "i3", "i4", "i5", "fp", "i7",
+};
+#endif
 
-                        // cr and ex can't be zeroed or whitesmith pascal's lnk produces corrupt .com files
-                        // pfcb->cr = 0;
-                        // pfcb->ex = 0;
-                        pfcb->s2 = 0;
-                        tracer.Trace( "  file opened successfully, record count: %u\n", pfcb->rc );
-                    }
-                    else
-                        tracer.Trace( "ERROR: can't open file '%s' error %d = %s\n", acFilename, errno, strerror( errno ) );
-                }
-            }
-            else
-                tracer.Trace( "ERROR: can't parse filename in FCB\n" );
-            break;
-        }
-        case 16: // close file. return 255 on error and 0..3 directory code otherwise
-        {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                FILE * fp = RemoveFileEntry( acFilename );
-                if ( fp )
-                {
-                    int ret = fclose( fp );
+void emulator_hard_termination( CPUClass & cpu, const char *pcerr, uint64_t error_value )
+{
+#ifdef X64OS_LIBRARY
+    char acError[ 200 ];
+    snprintf( acError, sizeof( acError ), "%s %#llx at pc %#llx", pcerr, (uint64_t) error_value, (uint64_t) REG_PC );
+    tracer.Trace( "hard termination: %s\n", acError );
+    flight_recorder_dump( cpu, false );
+    throw runtime_error( acError );
+#endif
 
-                    if ( 0 == ret )
-                        ACCESS_REG( REG_RESULT ) = 0;
-                    else
-                        tracer.Trace( "ERROR: file close failed, error %d = %s\n", errno, strerror( errno ) );
-                }
-                else
-                {
-                    // return error 255 if the file doesn't exist.
-                    // Pro Pascal Compiler v2.1 requires a 0 return code for a file that's not open but exists.
+    g_consoleConfig.RestoreConsole( false );
 
-                    if ( file_exists( acFilename ) )
-                    {
-                        tracer.Trace( "    WARNING: file close on file that's not open but exists\n" );
-                        ACCESS_REG( REG_RESULT ) = 0;
-                    }
-                    else
-                        tracer.Trace( "ERROR: file close on file that's not open and doesn't exist\n" );
-                }
+    printf( "hard termination!!!\n" );
+
+    tracer.Trace( "%s (%s) fatal error: %s %0llx\n", APP_NAME, target_platform(), pcerr, error_value );
+    printf( "%s (%s) fatal error: %s %0llx\n", APP_NAME, target_platform(), pcerr, error_value );
+
+    uint64_t offset = 0;
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+    uint32_t offset32 = 0;
+    const char * psymbol = emulator_symbol_lookup( REG_PC, offset32 );
+    offset = offset32;
+#else
+    const char * psymbol = emulator_symbol_lookup( REG_PC, offset );
+#endif
+
+    if ( psymbol[ 0 ] )
+    {
+        tracer.Trace( "pc: %llx %s + %llx\n", REG_PC, psymbol, offset );
+        printf( "pc: %llx %s + %llx\n", (uint64_t) REG_PC, psymbol, offset );
+    }
+    else
+    {
+        tracer.Trace( "pc: %llx\n", REG_PC );
+        printf( "pc: %llx\n", (uint64_t) REG_PC );
+    }
+
+#if defined( X64OS ) || defined( X32OS )
+    const char * pline = emulator_line_lookup( REG_PC );
+    if ( pline[ 0 ] )
+    {
+        tracer.Trace( "source: %s\n", pline );
+        printf( "source: %s\n", pline );
+    }
+#endif
+
+    tracer.Trace( "address space %llx to %llx\n", (uint64_t) g_base_address, (uint64_t) g_base_address + memory.size() );
+    printf( "address space %llx to %llx\n", (uint64_t) g_base_address, (uint64_t) g_base_address + memory.size() );
+
+    tracer.Trace( "  " );
+    printf( "  " );
+
+#ifdef M68
+
+    for ( size_t i = 0; i < 8; i++ )
+    {
+        tracer.Trace( "d%zu: %8x, ", i, cpu.dregs[ i ].l );
+        printf( "d%zu: %8x, ", i, cpu.dregs[ i ].l );
+
+        if ( 3 == ( i & 3 ) )
+        {
+            tracer.Trace( "\n" );
+            printf( "\n" );
+            if ( 7 != i )
+            {
+                tracer.Trace( "  " );
+                printf( "  " );
             }
-            else
-                tracer.Trace( "ERROR: can't parse filename in close call\n" );
-            break;
         }
-        case 17: // search for first.
-        {
-            // Use the FCB and write directory entries to the DMA address, then point to
-            // which of those entries is the actual one (0-3) or 0xff for not found in result.
-            // Find First on CP/M has a side-effect of flushing data to disk.
+    }
 
-            fflush( 0 );
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                tracer.Trace( "  search for first match of '%s'\n", acFilename );
-                CloseFindFirst();
+    tracer.Trace( "  " );
+    printf( "  " );
 
-#ifdef _MSC_VER
-                BOOL found = FALSE;
-                WIN32_FIND_DATAA fd = {0};
-                g_hFindFirst = FindFirstFileA( acFilename, &fd );
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    do
-                    {
-                        if ( ValidCPMFilename( fd.cFileName ) && ! IsAFolder( fd.cFileName ) )
-                        {
-                            ParseFoundFile( fd.cFileName );
-                            ACCESS_REG( REG_RESULT ) = 0;
-                            found = TRUE;
-                            break;
-                        }
-                        else
-                        {
-                            found = FindNextFileA( g_hFindFirst, &fd );
-                            if ( !found )
-                                break;
-                        }
-                    } while ( true );
-                }
-                else
-                    tracer.Trace( "WARNING: find first file failed, error %d\n", GetLastError() );
+    for ( size_t i = 0; i < 8; i++ )
+    {
+        tracer.Trace( "a%zu: %8x, ", i, cpu.aregs[ i ] );
+        printf( "a%zu: %8x, ", i, cpu.aregs[ i ] );
 
-                if ( !found )
-                {
-                    CloseFindFirst();
-                    tracer.Trace( "WARNING: find first file couldn't find a single match\n" );
-                }
-#else //_MSC_VER
-                LINUX_FIND_DATA fd = {0};
-                g_FindFirst = FindFirstFileLinux( acFilename, fd );
-                if ( 0 != g_FindFirst )
-                {
-                    ParseFoundFile( fd.cFileName );
-                    ACCESS_REG( REG_RESULT ) = 0;
-                }
-                else
-                    tracer.Trace( "WARNING: find first file failed, error %d = %s\n", errno, strerror( errno ) );
-#endif //_MSC_VER
+        if ( 3 == ( i & 3 ) )
+        {
+            tracer.Trace( "\n" );
+            printf( "\n" );
+            if ( 7 != i )
+            {
+                tracer.Trace( "  " );
+                printf( "  " );
             }
-            else
-                tracer.Trace( "ERROR: can't parse filename for search for first\n" );
-            break;
         }
-        case 18: // search for next.
-        {
-            // Use the FCB and write directory entries to the DMA address, then point to
-            // which of those entries is the actual one (0-3) or 0xff for not found in result.
+    }
 
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                tracer.Trace( "  searchinf for next match of '%s'\n", acFilename );
-#ifdef _MSC_VER
-                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
-                {
-                    BOOL found = FALSE;
+#elif defined( X64OS )
 
-                    do
-                    {
-                        WIN32_FIND_DATAA fd = {0};
-                        found = FindNextFileA( g_hFindFirst, &fd );
-                        if ( found )
-                        {
-                            if ( ValidCPMFilename( fd.cFileName ) && !IsAFolder( fd.cFileName ) )
-                            {
-                                ParseFoundFile( fd.cFileName );
-                                ACCESS_REG( REG_RESULT ) = 0;
-                                break;
-                            }
-                            else
-                                found = FALSE;
-                        }
-                        else
-                            break;
-                    } while ( true );
+    for ( size_t i = 0; i < 16; i++ )
+    {
+        tracer.Trace( "%4s: %16llx, ", x64_register_names[ i ], ACCESS_REG( i ) );
+        printf( "%4s: %16llx, ", x64_register_names[ i ], ACCESS_REG( i ) );
 
-                    if ( !found )
-                    {
-                        tracer.Trace( "WARNING: find next file found no more, error %d\n", GetLastError() );
-                        CloseFindFirst();
-                    }
-                }
-                else
-                    tracer.Trace( "ERROR: search for next without a prior successful search for first\n" );
-#else //_MSC_VER
-                if ( 0 != g_FindFirst )
-                {
-                    LINUX_FIND_DATA fd = {0};
-                    bool found = FindNextFileLinux( acFilename, g_FindFirst, fd );
-                    if ( found )
-                    {
-                        ParseFoundFile( fd.cFileName );
-                        ACCESS_REG( REG_RESULT ) = 0;
-                    }
-                    else
-                    {
-                        tracer.Trace( "WARNING: find next file found no more, error %d = %s\n", errno, strerror( errno ) );
-                        CloseFindFirst();
-                    }
-                }
-                else
-                    tracer.Trace( "ERROR: search for next without a prior successful search for first\n" );
-#endif //_MSC_VER
+        if ( 3 == ( i & 3 ) )
+        {
+            tracer.Trace( "\n" );
+            printf( "\n" );
+            if ( 15 != i )
+            {
+                tracer.Trace( "  " );
+                printf( "  " );
             }
-            else
-                tracer.Trace( "ERROR: can't parse filename for search for first\n" );
-            break;
         }
-        case 19: // delete file. return 255 if file not found and 0..3 directory code otherwise
+    }
+
+#elif defined( X32OS )
+
+    for ( size_t i = 0; i < 8; i++ )
+    {
+        tracer.Trace( "%4s: %8x, ", x32_register_names[ i ], ACCESS_REG( i ) );
+        printf( "%4s: %8x, ", x32_register_names[ i ], ACCESS_REG( i ) );
+
+        if ( 3 == ( i & 3 ) )
         {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
+            tracer.Trace( "\n" );
+            printf( "\n" );
+            if ( 7 != i )
             {
-                // if deleting an open file, close it first. CalcStar does this on file save.
+                tracer.Trace( "  " );
+                printf( "  " );
+            }
+        }
+    }
 
-                if ( FindFileEntry( acFilename ) )
-                {
-                    FILE * fp = RemoveFileEntry( acFilename );
-                    if ( fp )
-                        fclose( fp );
-                }
-
-                int removeok = ( 0 == unlink( acFilename ) );
-                tracer.Trace( "  attempt to remove file '%s' result ok: %d\n", acFilename, removeok );
-                if ( removeok )
-                    ACCESS_REG( REG_RESULT ) = 0;
-                else
-                    tracer.Trace( "  error %d = %s\n", errno, strerror( errno ) );
-            }
-            else
-                tracer.Trace( "ERROR: can't parse filename for delete file\n" );
-            break;
-        }
-        case 20: // read sequential. return 0 on success or non-0 on failure:
-        {
-            // reads 128 bytes from cr of the extent and increments cr.
-            // if cr overflows, the extent is incremented and cr is set to 0 for the next read
-
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                FILE * fp = FindFileEntry( acFilename );
-                if ( fp )
-                {
-                    // apps like Digital Research's linker LK80 update pcb->cr and pfcb->ex between
-                    // calls to sequential read and effectively does random reads using sequential I/O.
-                    // This is illegal (the doc says apps can't touch this data, but that ship has sailed and sunk).
-
-                    uint32_t file_size = portable_filelen( fp );
-                    uint32_t curr = pfcb->GetSequentialOffset();
-                    uint16_t dmaOffset = (uint16_t) ( g_DMA - memory.data() );
-                    tracer.Trace( "  file size: %#x = %u, current %#x = %u, dma %#x = %u\n",
-                                  file_size, file_size, curr, curr, dmaOffset, dmaOffset );
-
-                    if ( curr < file_size )
-                    {
-                        fseek( fp, curr, SEEK_SET );
+#else
 
-                        uint32_t to_read = get_min( file_size - curr, (uint32_t) 128 );
-                        memset( g_DMA, 0x1a, 128 ); // fill with ^z, the EOF marker in CP/M
+    for ( size_t i = 0; i < 32; i++ )
+    {
+#ifdef ARMOS
+        tracer.Trace( "%02zu: %16llx, ", i, ACCESS_REG( i ) );
+        printf( "%02zu: %16llx, ", i, ACCESS_REG( i ) );
+#elif defined( SPARCOS )
+        tracer.Trace( "%4s: %8x, ", sparc_register_names[ i ], ACCESS_REG( (uint32_t) i ) );
+        printf( "%4s: %8x, ", sparc_register_names[ i ], ACCESS_REG( (uint32_t) i ) );
+#elif defined( RVOS )
+        tracer.Trace( "%4s: %16llx, ", riscv_register_names[ i ], ACCESS_REG( i ) );
+        printf( "%4s: %16llx, ", riscv_register_names[ i ], ACCESS_REG( i ) );
+#endif
 
-                        size_t numread = fread( g_DMA, 1, to_read, fp );
-                        if ( numread > 0 )
-                        {
-                            tracer.TraceBinaryData( g_DMA, 128, 2 );
-                            ACCESS_REG( REG_RESULT ) = 0;
-                            pfcb->UpdateSequentialOffset( curr + 128 );
-                        }
-                        else
-                        {
-                            ACCESS_REG( REG_RESULT ) = 1;
-                            tracer.Trace( "  read error %d = %s, so returning a = 1\n", errno, strerror( errno ) );
-                        }
-                    }
-                    else
-                    {
-                        ACCESS_REG( REG_RESULT ) = 1;
-                        tracer.Trace( "  at the end of file, so returning a = 1\n" );
-                    }
-                }
-                else
-                    tracer.Trace( "ERROR: can't read from a file that's not open\n" );
-            }
-            else
-                tracer.Trace( "ERROR: can't parse filename in read sequential file\n" );
-            break;
-        }
-        case 21: // write sequential. return 0 on success or non-0 on failure (out of disk space)
+        if ( 3 == ( i & 3 ) )
         {
-            // reads 128 bytes from cr of the extent and increments cr.
-            // if cr overflows, the extent is incremented and cr is set to 0 for the next read
-
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
+            tracer.Trace( "\n" );
+            printf( "\n" );
+            if ( 31 != i )
             {
-                FILE * fp = FindFileEntry( acFilename );
-                if ( fp )
-                {
-                    uint32_t file_size = portable_filelen( fp );
-                    uint32_t curr = pfcb->GetSequentialOffset();
-                    uint16_t dmaOffset = (uint16_t) ( g_DMA - memory.data() );
-                    tracer.Trace( "  writing at offset %#x = %u, file size is %#x = %u, dma %#x = %u\n",
-                                  curr, curr, file_size, file_size, dmaOffset, dmaOffset );
-                    fseek( fp, curr, SEEK_SET );
-
-                    tracer.TraceBinaryData( g_DMA, 128, 2 );
-                    size_t numwritten = fwrite( g_DMA, 128, 1, fp );
-                    if ( numwritten > 0 )
-                    {
-                        ACCESS_REG( REG_RESULT ) = 0;
-                        pfcb->UpdateSequentialOffset( curr + 128 );
-                        pfcb->SetRecordCount( fp ); // Whitesmith C v2.1's A80.COM assembler requires this
-                    }
-                    else
-                        tracer.Trace( "ERROR: fwrite returned %zd, errno %d = %s\n", numwritten, errno, strerror( errno ) );
-                }
-                else
-                    tracer.Trace( "ERROR: can't write to a file that's not open\n" );
+                tracer.Trace( "  " );
+                printf( "  " );
             }
-            else
-                tracer.Trace( "ERROR: can't parse filename in write sequential file\n" );
-            break;
         }
-        case 22: // make file. return 255 if out of space or the file exists. 0..3 directory code otherwise.
-        {
-            // "the Make function has the side effect of activating the FCB and thus a subsequent open is not necessary."
-
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                tracer.Trace( "  making file '%s'\n", acFilename );
-                FILE * fp = fopen( acFilename, "w+b" );
-                if ( fp )
-                {
-                    FileEntry fe;
-                    strcpy( fe.acName, acFilename );
-                    fe.fp = fp;
-                    g_fileEntries.push_back( fe );
+    }
 
-                    pfcb->cr = 0;
-                    pfcb->rc = 0;
-                    pfcb->ex = 0;
-                    pfcb->s2 = 0;
+    cpu.trace_instructions( true );
+#ifdef ARMOS
+    cpu.trace_vregs();
+#elif defined( SPARCOS )
+    cpu.trace_fregs();
+#endif
 
-                    tracer.Trace( "  successfully created fp %p for write\n", fp );
-                    ACCESS_REG( REG_RESULT ) = 0;
-                }
-                else
-                    tracer.Trace( "ERROR: unable to make file\n" );
-            }
-            else
-                tracer.Trace( "ERROR: can't parse filename in make file\n" );
-            break;
-        }
-        case 23: // rename file. 0 for success, non-zero otherwise.
-        {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            char acOldName[ CPM_FILENAME_LEN ];
-            if ( parse_FCB_Filename( pfcb, acOldName ) )
-            {
-                 // if the file is open, close it or the rename will fail.
+#endif // M68
 
-                 if ( FindFileEntry( acOldName ) )
-                     fclose( RemoveFileEntry( acOldName ) );
+#if defined( X64OS ) || defined( X32OS )
+    flight_recorder_dump( cpu, true );
+#endif
 
-                char acNewName[ CPM_FILENAME_LEN ];
-                if ( parse_FCB_Filename( (FCBCPM68K *) ( ( (uint8_t *) pfcb ) + 16 ), acNewName ) )
-                {
-                    tracer.Trace( "  rename from '%s' to '%s'\n", acOldName, acNewName );
+    tracer.Trace( "%s\n", build_string() );
+    printf( "%s\n", build_string() );
 
-                    if ( !rename( acOldName, acNewName ) )
-                        ACCESS_REG( REG_RESULT ) = 0;
-                    else
-                        tracer.Trace( "ERROR: can't rename file, errno %d = %s\n", errno, strerror( errno ) );
-                }
-                else
-                    tracer.Trace( "ERROR: can't parse new filename in rename\n" );
-            }
-            else
-                tracer.Trace( "ERROR: can't parse old filename in rename\n" );
-            break;
-        }
-        case 25: // return current disk
-        {
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 26: // set the dma address (128 byte buffer for doing I/O)
-        {
-            tracer.Trace( "  updating DMA address; D %u = %#x\n", ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG0 ) );
-            g_DMA = memory.data() + ACCESS_REG( REG_ARG0 );
-            break;
-        }
-        case 29: // get read-only vector: return bitmap of read-only drives
-        {
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 32: // get/set current user
-        {
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 33: // read random
-        {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 6; // seek past end of disk
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                FILE * fp = FindFileEntry( acFilename );
-                if ( !fp )
-                {
-                    // dxforth 4.56 relies on this cp/m 2.2 behavior: open / close / read should work.
-                    tracer.Trace( "  in random read but the file isn't opened. trying to open it now\n" );
-                    fp = fopen( acFilename, "r+b" );
-                    if ( fp )
-                    {
-                        FileEntry fe;
-                        strcpy( fe.acName, acFilename );
-                        fe.fp = fp;
-                        g_fileEntries.push_back( fe );
-                        tracer.Trace( "  file opened successfully for random read\n" );
-                    }
-                    else
-                        tracer.Trace( "  file open failed for random read\n" );
-                }
-                if ( fp )
-                {
-                    uint32_t record = pfcb->GetRandomIOOffset();
-                    tracer.Trace( "  read random record %u == %#x\n", record, record );
-                    uint32_t file_offset = (uint32_t) record * (uint32_t) 128;
-                    memset( g_DMA, 0x1a, 128 ); // fill with ^z, the EOF marker in CP/M
+    tracer.Flush();
+    fflush( stdout );
+    exit( 1 );
+} //emulator_hard_termination
 
-                    uint32_t file_size = portable_filelen( fp );
+#if defined( M68 )
+
+const char * bdos_functions[] =
+{
+    "system reset",                        // 0
+    "console input",
+    "console output",
+    "auxiliary input",
+    "auxiliary output",
+    "list output",
+    "direct console i/o",
+    "get i/o byte",
+    "set i/o byte",
+    "print string",
+    "read console buffer",                 // 10
+    "get console status",
+    "return version number",
+    "reset disk system",
+    "select disk",
+    "open file",
+    "close file",
+    "search for first",
+    "search for next",
+    "delete file",
+    "read sequential",                     // 20
+    "write sequential",
+    "make file",
+    "rename file",
+    "return login vector",
+    "return current disk",
+    "set dma address",
+    "27 is unused",
+    "write protect disk",
+    "get read-only vector",
+    "set file attributes",                 // 30
+    "get disk parmameters",
+    "get/set user code",
+    "read random",
+    "write random",
+    "compute file size",
+    "set random record",
+    "reset drive",
+    "38 is unused",
+    "39 is unused",
+    "write random with zero fill",         // 40
+    "41 is unused",
+    "42 is unused",
+    "43 is unused",
+    "44 is unused",
+    "45 is unused",
+    "get disk free space",
+    "chain to program",
+    "flush buffers",
+    "49 is unused",
+    "direct BIOS call",                    // 50
+    "51 is unused",
+    "52 is unused",
+    "53 is unused",
+    "54 is unused",
+    "55 is unused",
+    "56 is unused",
+    "57 is unused",
+    "58 is unused",
+    "program load",
+    "60 is unused",                        // 60
+    "set exception vector",
+    "set supervisor state",
+    "get/set tpa limits"
+};
+
+const char * bdos_function( uint32_t id )
+{
+    if ( id < _countof( bdos_functions ) )
+        return bdos_functions[ id ];
+
+    if ( 45 == id )
+        return "non - cp/m 2.2: set action on hardware error";
+    if ( 48 == id )
+        return "non - cp/m 2.2: empty disk buffers";
+    if ( 105 == id )
+        return "non - cp/m 2.2: get date and time";
+    if ( 108 == id )
+        return "cp/m v3 get/put exit code";
+    if ( 155 == id )
+        return "non - cp/m 2.2: get date and time with seconds";
+
+    return "unknown";
+} //bdos_function
+
+const char * bios_functions[] =
+{
+    "initialization",                      // 0
+    "warm boot",
+    "console status",
+    "read console character in",
+    "write console character out",
+    "list",
+    "auxiliary output",
+    "auxiliary input",
+    "home",
+    "selet disk drive",
+    "set track number",                    // 10
+    "set sector number",
+    "set dma address",
+    "read selected sector",
+    "write selected sector",
+    "return list status",
+    "sector translate",
+    "17 is unused",
+    "get memory region table address",
+    "get i/o mapping byte",
+    "set i/o mapping byte",                // 20
+    "flush buffers",
+    "set exception handler address"
+};
+
+const char * bios_function( uint32_t id )
+{
+    if ( id < _countof( bios_functions ) )
+        return bios_functions[ id ];
+
+    return "unknown";
+} //bios_function
+
+void append_string( char * pc, const char * a )
+{
+    size_t len = strlen( pc );
+    if ( 0 != len )
+    {
+        pc[ len++ ] = ',';
+        pc[ len++ ] = ' ';
+    }
+
+    strcpy( pc + len, a );
+} //append_string
+
+#pragma pack( push, 1 )
+struct SymbolEntryCPM
+{
+    char name[ 8 ];
+    uint16_t type;
+    uint32_t value;
+
+    void swap_endianness()
+    {
+        type = swap_endian16( type );
+        value = swap_endian32( value );
+    }
+
+    const char * get_type()
+    {
+        static char ac[ 80 ];
+        ac[ 0 ] = 0;
+
+        if ( 0x8000 & type )
+            append_string( ac, "defined" );
+        if ( 0x4000 & type )
+            append_string( ac, "equated" );
+        if ( 0x2000 & type )
+            append_string( ac, "global" );
+        if ( 0x1000 & type )
+            append_string( ac, "equated-register" );
+        if ( 0x800 & type )
+            append_string( ac, "external reference" );
+        if ( 0x400 & type )
+            append_string( ac, "data-based-relocatable" );
+        if ( 0x200 & type )
+            append_string( ac, "text-based-relocatable" );
+        if ( 0x100 & type )
+            append_string( ac, "bss-based-relocatable" );
+
+        return ac;
+    }
+
+    void trace()
+    {
+        tracer.Trace( "  %#16x", value );
+        tracer.Trace( "  %10s", name );
+        tracer.Trace( "  %s\n", get_type() );
+    }
+};
+#pragma pack(pop)
+
+static vector<SymbolEntryCPM> g_cpmSymbols;
+
+static int symbol_find_compare_cpm( const void * a, const void * b )
+{
+    SymbolEntryCPM & sa = * (SymbolEntryCPM *) a;
+    SymbolEntryCPM & sb = * (SymbolEntryCPM *) b;
+
+    if ( 0 == sa.name[0] ) // a is the key
+    {
+        SymbolEntryCPM * pnext = ( ( & sb ) + 1 );
+        if ( ( sa.value == sb.value ) || ( sa.value > sb.value && sa.value < pnext->value ) )
+            return 0;
+    }
+    else // b is the key
+    {
+        SymbolEntryCPM * pnext = ( ( & sa ) + 1 );
+        if ( ( sb.value == sa.value ) || ( sb.value > sa.value && sb.value < pnext->value ) )
+            return 0;
+    }
+
+    if ( sa.value > sb.value )
+        return 1;
+    return -1;
+} //symbol_find_compare_cpm
+
+#endif //M68
+
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+
+static int symbol_find_compare32( const void * a, const void * b )
+{
+    ElfSymbol32 & sa = * (ElfSymbol32 *) a;
+    ElfSymbol32 & sb = * (ElfSymbol32 *) b;
+
+    if ( 0 == sa.size ) // a is the key
+    {
+        if ( ( sa.value == sb.value ) || ( sa.value > sb.value && sa.value < ( sb.value + sb.size ) ) )
+            return 0;
+    }
+    else // b is the key
+    {
+        if ( ( sb.value == sa.value ) || ( sb.value > sa.value && sb.value < ( sa.value + sa.size ) ) )
+            return 0;
+    }
+
+    if ( sa.value > sb.value )
+        return 1;
+    return -1;
+} //symbol_find_compare32
+
+#else // M68 || SPARCOS || X32OS
+
+static int symbol_find_compare( const void * a, const void * b )
+{
+    ElfSymbol64 & sa = * (ElfSymbol64 *) a;
+    ElfSymbol64 & sb = * (ElfSymbol64 *) b;
+
+    if ( 0 == sa.size ) // a is the key
+    {
+        if ( sa.value >= sb.value && sa.value < ( sb.value + sb.size ) )
+            return 0;
+    }
+    else // b is the key
+    {
+        if ( sb.value >= sa.value && sb.value < ( sa.value + sa.size ) )
+            return 0;
+    }
+
+    if ( sa.value > sb.value )
+        return 1;
+    return -1;
+} //symbol_find_compare
+
+#endif // M68 || SPARCOS || X32OS
+
+EMULATOR_THREAD_LOCAL vector<char> g_string_table;      // strings in the elf image
+EMULATOR_THREAD_LOCAL vector<ElfSymbol64> g_symbols;    // symbols in the elf image
+EMULATOR_THREAD_LOCAL vector<ElfSymbol32> g_symbols32;  // symbols in the elf image
+static EMULATOR_THREAD_LOCAL CDwarf g_dwarf;             // source lines from the elf image's debug info, parsed on first use
+
+const char * emulator_line_lookup( uint64_t address )
+{
+    // file:line, then each function inlined at address from innermost out with where it was inlined
+
+    static EMULATOR_THREAD_LOCAL char acLine[ 400 ];
+    acLine[ 0 ] = 0;
+    if ( !g_dwarf.available() )
+        return acLine;
+
+    const char * pfile;
+    uint32_t line;
+    if ( !g_dwarf.lookup_line( address, pfile, line ) )
+        return acLine;
+
+    int len = snprintf( acLine, sizeof( acLine ), "%s:%u", pfile, line );
+
+    static EMULATOR_THREAD_LOCAL vector<CDwarf::InlineFrame> frames;
+    g_dwarf.lookup_inlines( address, frames );
+    for ( size_t i = 0; i < frames.size() && len > 0 && len < (int) sizeof( acLine ); i++ )
+        len += snprintf( acLine + len, sizeof( acLine ) - len, " [%s inlined at %s:%u]", frames[ i ].name, frames[ i ].call_file, frames[ i ].call_line );
+
+    return acLine;
+} //emulator_line_lookup
+
+// returns the best guess for a symbol name for the address
+
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+
+#ifdef X32OS
+const char * emulator_symbol_lookup( uint64_t address, uint64_t & offset )
+{
+    uint32_t offset32;
+    const char * result = emulator_symbol_lookup( (uint32_t) address, offset32 );
+    offset = offset32;
+    return result;
+} //emulator_symbol_lookup
+#endif
+
+const char * emulator_symbol_lookup( uint32_t address, uint32_t & offset )
+{
+    if ( address < g_base_address || address > ( g_base_address + memory.size() ) )
+        return "";
+
+    // if no elf symbols, try CP/M symbols
+
+    if ( 0 == g_symbols32.size() )
+    {
+#ifdef M68
+        if ( 0 != g_cpmSymbols.size() )
+        {
+            SymbolEntryCPM key = {0};
+            key.value = address;
+            SymbolEntryCPM * psym = (SymbolEntryCPM *) my_bsearch( &key, g_cpmSymbols.data(), g_cpmSymbols.size(), sizeof( key ), symbol_find_compare_cpm );
+            if ( 0 != psym )
+            {
+                offset = address - psym->value;
+                return psym->name;
+            }
+        }
+#endif //M68
+
+        return "";
+    }
+
+    ElfSymbol32 key = {0};
+    key.value = address;
+
+    ElfSymbol32 * psym = (ElfSymbol32 *) my_bsearch( &key, g_symbols32.data(), g_symbols32.size(), sizeof( key ), symbol_find_compare32 );
+
+    if ( 0 != psym )
+    {
+        offset = address - psym->value;
+        return & g_string_table[ psym->name ];
+    }
+
+    offset = 0;
+    return "";
+} //emulator_symbol_lookup
+
+static int symbol_compare32( const void * a, const void * b )
+{
+    ElfSymbol32 * pa = (ElfSymbol32 *) a;
+    ElfSymbol32 * pb = (ElfSymbol32 *) b;
+
+    if ( pa->value > pb->value )
+        return 1;
+    if ( pa->value == pb->value )
+        return 0;
+    return -1;
+} //symbol_compare32
+
+#else // M68 || SPARCOS || X32OS
+
+const char * emulator_symbol_lookup( uint64_t address, uint64_t & offset )
+{
+    if ( address < g_base_address || address > ( g_base_address + memory.size() ) )
+        return "";
+
+    ElfSymbol64 key = {0};
+    key.value = address;
+
+    ElfSymbol64 * psym = (ElfSymbol64 *) my_bsearch( &key, g_symbols.data(), g_symbols.size(), sizeof( key ), symbol_find_compare );
+
+    if ( 0 != psym )
+    {
+        offset = address - psym->value;
+        return & g_string_table[ psym->name ];
+    }
+
+    offset = 0;
+    return "";
+} //emulator_symbol_lookup
+
+static int symbol_compare( const void * a, const void * b )
+{
+    ElfSymbol64 * pa = (ElfSymbol64 *) a;
+    ElfSymbol64 * pb = (ElfSymbol64 *) b;
+
+    if ( pa->value > pb->value )
+        return 1;
+    if ( pa->value == pb->value )
+        return 0;
+    return -1;
+} //symbol_compare
+
+#endif //M68
+
+static void remove_spaces( char * p )
+{
+    char * o;
+    for ( o = p; *p; p++ )
+    {
+        if ( ' ' != *p )
+            *o++ = *p;
+    }
+    *o = 0;
+} //remove_spaces
+
+static const char * image_type( uint16_t e_type )
+{
+    if ( 0 == e_type )
+        return "et none";
+    if ( 1 == e_type )
+        return "et relocatable file";
+    if ( 2 == e_type )
+        return "et executable";
+    if ( 3 == e_type )
+        return "et dynamic linked shared object";
+    if ( 4 == e_type )
+        return "et core file";
+    return "et unknown";
+} //image_type
+
+static int ends_with( const char * str, const char * end )
+{
+    size_t len = strlen( str );
+    size_t lenend = strlen( end );
+
+    if ( len < lenend )
+        return false;
+
+    return ( 0 == _stricmp( str + len - lenend, end ) );
+} //ends_with
+
+#ifdef M68
+
+#define CPM_FILENAME_LEN ( 8 + 3 + 1 + 1 ) // name + type + dot + null
+
+// this struct is used to cache FILE * objects to avoid open/close for each file access
+
+struct FileEntry
+{
+    char acName[ CPM_FILENAME_LEN ];
+    FILE * fp;
+};
+
+#pragma pack( push, 1 )
+struct CPM3DateTime
+{
+    uint16_t day; // day 1 is 1 January 1978
+    uint8_t hour; // packed bcd (nibbles for each digit)
+    uint8_t minute; // packed bcd
+    uint8_t second; // packed bcd. for BDOS 155, not BDOS 105
+
+    void swap_endian()
+    {
+        day = flip_endian16( day );
+    }
+};
+#pragma pack(pop)
+
+uint8_t packBCD( uint8_t x )
+{
+    return (uint8_t) ( ( ( x / 10 ) << 4 ) | ( x % 10 ) );
+} //packBCD
+
+static bool g_forceLowercase = false;
+static uint8_t * g_DMA = 0;
+static vector<FileEntry> g_fileEntries;
+
+FILE * RemoveFileEntry( char * name )
+{
+    for ( size_t i = 0; i < g_fileEntries.size(); i++ )
+    {
+        if ( !strcmp( name, g_fileEntries[ i ].acName ) )
+        {
+            FILE * fp = g_fileEntries[ i ].fp;
+            tracer.Trace( "  removing file entry '%s'\n", name );
+            g_fileEntries.erase( g_fileEntries.begin() + i );
+            return fp;
+        }
+    }
+
+    tracer.Trace( "ERROR: could not remove file entry for '%s'\n", name );
+    return 0;
+} //RemoveFileEntry
+
+FILE * FindFileEntry( char * name )
+{
+    for ( size_t i = 0; i < g_fileEntries.size(); i++ )
+    {
+        if ( !strcmp( name, g_fileEntries[ i ].acName ) )
+        {
+            tracer.Trace( "  found file entry '%s'\n", name );
+            return g_fileEntries[ i ].fp;
+        }
+    }
+
+    tracer.Trace( "  could not find an open file entry for '%s'; that might be OK\n", name );
+    return 0;
+} //FindFileEntry
+
+#pragma pack( push, 1 )
+
+struct ExceptionParameterBlockCPM
+{
+    uint16_t vector;
+    uint32_t newValue;
+    uint32_t oldValue;
+
+    void swap_endianness()
+    {
+        vector = swap_endian16( vector );
+        newValue = swap_endian32( newValue );
+        oldValue = swap_endian32( oldValue );
+    }
+
+    void trace()
+    {
+        tracer.Trace( "  ExceptionParameterBlockCPM:\n" );
+        tracer.Trace( "    vector %#x\n", vector );
+        tracer.Trace( "    newValue %#x\n", newValue );
+        tracer.Trace( "    oldValue %#x\n", oldValue );
+    }
+};
+
+struct LoadParameterBlockCPM
+{
+    uint32_t fcbOfChildApp;      // the calling app must have opened the file that's here
+    uint32_t lowestAddress;      // the calling app specifies this
+    uint32_t highestAddress;     // the calling app specifies this
+    uint32_t childBasePage;      // returned by bdos
+    uint32_t childStackPointer;  // returned by bdos
+    uint16_t loaderControlFlags; // 0 == load in lowest possible address. 1 == load in highest possible address
+
+    void swap_endianness()
+    {
+         fcbOfChildApp = swap_endian32( fcbOfChildApp );
+         lowestAddress = swap_endian32( lowestAddress );
+         highestAddress = swap_endian32( highestAddress );
+         childBasePage = swap_endian32( childBasePage );
+         childStackPointer = swap_endian32( childStackPointer );
+         loaderControlFlags= swap_endian16( loaderControlFlags );
+    }
+
+    void trace()
+    {
+        tracer.Trace( "  load parameter block:\n" );
+        tracer.Trace( "    fcb of child app:               %lx\n", fcbOfChildApp );
+        tracer.Trace( "    lowest address of child app:    %lx\n", lowestAddress );
+        tracer.Trace( "    highest address of child app:   %lx\n", highestAddress );
+        tracer.Trace( "    child base page from bdos:      %lx\n", childBasePage );
+        tracer.Trace( "    child stack pointer from bdos:  %lx\n", childStackPointer );
+        tracer.Trace( "    loader control flags:           %x\n", loaderControlFlags );
+    }
+};
+
+struct HeaderCPM68K    // .68k executable files for cp/m 68k v1.3
+{
+    uint16_t signature;
+    uint32_t cb_text;
+    uint32_t cb_data;
+    uint32_t cb_bss;
+    uint32_t cb_symbols;
+    uint32_t reserved;
+    uint32_t text_start;
+    uint16_t relocation_flag; // two bytes, but only the low byte has the flag
+
+    void swap_endianness()
+    {
+        signature = swap_endian16( signature );
+        cb_text = swap_endian32( cb_text );
+        cb_data = swap_endian32( cb_data );
+        cb_bss = swap_endian32( cb_bss );
+        cb_symbols = swap_endian32( cb_symbols );
+        reserved = swap_endian32( reserved );
+        text_start = swap_endian32( text_start );
+        relocation_flag = swap_endian16( relocation_flag );
+    }
+
+    void trace()
+    {
+        tracer.Trace( "cpm68k executable header:\n" );
+        tracer.Trace( "  signature: %#x\n", signature );
+        tracer.Trace( "  cb_text: %#x\n", cb_text );
+        tracer.Trace( "  cb_data: %#x\n", cb_data );
+        tracer.Trace( "  cb_bss: %#x\n", cb_bss );
+        tracer.Trace( "  cb_symbols: %#x\n", cb_symbols );
+        tracer.Trace( "  reserved: %#x\n", reserved );
+        tracer.Trace( "  text_start: %#x\n", text_start );
+        tracer.Trace( "  relocation_flag: %#x\n", relocation_flag );
+    }
+};
+
+struct FCBCPM68K // file control block for cp/m
+{
+    uint8_t dr;         // drive
+    char f[ 8 ];        // filename
+    char t[ 3 ];        // file type
+    uint8_t ex;         // current extent number. normally set to 0 by user but is in range 0-31
+    uint8_t s1;
+    uint8_t s2;         // reserved for system use. set to 0 for open/make/search
+    uint8_t rc;         // record count, reserved for system use
+    uint8_t d[ 16 ];
+    uint8_t cr;         // current reacord to be read or written for sequential read/write operations. apps must set approprately.
+    uint8_t r0;         // (optional if app is doing random I/O) random record number. most significant byte in r0 then r1 then r2 as a 24-bit record
+    uint8_t r1;         // the byte order is the opposite of CP/M 2.2 for 8080 plus r2 is actually used!
+    uint8_t r2;
+
+    void make_filename( char * p )
+    {
+        for ( int i = 0; i < 8; i++ )
+        {
+            if ( ' ' == ( 0x7f & f[ i ] ) )
+                break;
+            *p++ = ( 0x7f & f[ i ] );
+        }
+        if ( ' ' != t[ 0 ] )
+        {
+            *p++ = '.';
+            for ( int i = 0; i < 3; i++ )
+            {
+                if ( ' ' == ( 0x7f & t[ i ] ) )
+                    break;
+                *p++ = ( 0x7f & t[ i ] );
+            }
+        }
+        *p++ = 0;
+    } //make_filename
+
+    // r0 and r1 are a 16-bit count of 128 byte records in CP/M 2.2. For CP/M 68K, reverse the byte ordering and add r2
+
+    uint32_t GetRandomIOOffset() { return ( (uint32_t) this->r0 << 16 ) | ( (uint32_t) this->r1 << 8 ) | this->r2; }
+
+    void SetRandomIOOffset( uint32_t o )
+    {
+        this->r2 = ( 0xff & o );
+        this->r1 = ( 0xff & ( o >> 8 ) );
+        this->r0 = ( 0xff & ( o >> 16 ) );
+    } //SetRandomIOOffset
+
+    void SetRecordCount( FILE * fp )
+    {
+        // set rc to file size in 128 byte records if < 16k, else 128
+        uint32_t file_size = portable_filelen( fp );
+        if ( file_size >= ( 16 * 1024 ) ) // CP/M 2.2 does this and Whitesmith C's A80.COM and LNK.COM depend on it
+            this->rc = 128;
+        else
+        {
+            uint32_t tail_size = ( file_size % ( 16 * 1024 ) ); // won't matter because of 16k check above
+            this->rc = (uint8_t) ( tail_size / 128 );
+            if ( 0 != ( tail_size % 128 ) )
+                this->rc++;
+        }
+    } //SetRecordCount
+
+    void UpdateSequentialOffset( uint32_t offset )
+    {
+        cr = (uint8_t) ( ( offset % ( (uint32_t) 16 * 1024 ) ) / (uint32_t) 128 );
+        ex = (uint8_t) ( ( offset % ( (uint32_t) 512 * 1024 ) ) / ( (uint32_t) 16 * 1024 ) );
+        s2 = (uint8_t) ( offset / ( (uint32_t) 512 * 1024 ) );
+        #ifdef WATCOM
+        tracer.Trace( "  new offset: %u, s2 %u, ex %u, cr %u\n", (uint16_t) offset, (uint16_t) s2, (uint16_t) ex, (uint16_t) cr );
+        #else
+        tracer.Trace( "  new offset: %u, s2 %u, ex %u, cr %u\n", offset, s2, ex, cr );
+        #endif
+    } //UpdateSequentialOffset
+
+    uint32_t GetSequentialOffset()
+    {
+        uint32_t curr = (uint32_t) cr * 128;
+        curr += ( (uint32_t) ex * ( (uint32_t) 16 * 1024 ) );
+        curr += ( (uint32_t) s2 * ( (uint32_t) 512 * 1024 ) );
+        return curr;
+    } //GetSequentialOffset
+
+    void Trace( bool justArg = false ) // justArg is the first 16 bytes at app startup
+    {
+        tracer.Trace( "  FCB at address %04x:\n", (uint32_t) ( (uint8_t * ) this - memory.data() ) );
+        tracer.Trace( "    drive:    %#x == %c\n", dr, ( 0 == dr ) ? 'A' : 'A' + dr - 1 );
+        tracer.Trace( "    filename: '%c%c%c%c%c%c%c%c'\n", 0x7f & f[0], 0x7f & f[1], 0x7f & f[2], 0x7f & f[3],
+                                                            0x7f & f[4], 0x7f & f[5], 0x7f & f[6], 0x7f & f[7] );
+        tracer.Trace( "    filetype: '%c%c%c'\n", 0x7f & t[0], 0x7f & t[1], 0x7f & t[2] );
+        tracer.Trace( "    R S A:    %d %d %d\n", 0 != ( 0x80 & t[0] ), 0 != ( 0x80 & t[1] ), 0 != ( 0x80 & t[2] ) );
+        tracer.Trace( "    ex:       %d\n", ex );
+        tracer.Trace( "    s1:       %u\n", s1 );
+        tracer.Trace( "    s2:       %u\n", s2 );
+        tracer.Trace( "    rc:       %u\n", rc );
+        if ( !justArg )
+        {
+            tracer.Trace( "    cr:       %u\n", cr );
+            tracer.Trace( "    r0:       %u\n", r0 );
+            tracer.Trace( "    r1:       %u\n", r1 );
+            tracer.Trace( "    r2:       %u\n", r2 );
+        }
+    } //Trace
+};
+
+struct BasePageCPM // base page for cp/m -- the first 256 bytes in memory
+{
+    uint32_t lowest_tpa;                // 0
+    uint32_t highest_tpa;               // 4
+    uint32_t start_text;                // 8
+    uint32_t cb_text;                   // c
+    uint32_t start_data;                // 10
+    uint32_t cb_data;                   // 14
+    uint32_t start_bss;                 // 18
+    uint32_t cb_bss;                    // 1c
+    uint32_t cb_after_bss;              // 20
+    uint8_t drive;                      // 24 where the app was loaded
+    uint8_t reserved[ 19 ];             // 25 reserved. used for exit trap when an app returns from _start
+    FCBCPM68K secondFCB;                // 38
+    FCBCPM68K firstFCB;                 // 5c
+    uint8_t cb_command_tail;            // 80 also start of default DMA buffer
+    uint8_t command_tail[ 127 ];        // 81
+
+    void Trace()
+    {
+        tracer.Trace( "base page:\n" );
+        tracer.Trace( "  lowest tpa:       %lx\n", swap_endian32( lowest_tpa ) );
+        tracer.Trace( "  highest tpa:      %lx\n", swap_endian32( highest_tpa ) );
+        tracer.Trace( "  start_text:       %lx\n", swap_endian32( start_text ) );
+        tracer.Trace( "  cb_text:          %lx\n", swap_endian32( cb_text ) );
+        tracer.Trace( "  start_data:       %lx\n", swap_endian32( start_data ) );
+        tracer.Trace( "  cb_data:          %lx\n", swap_endian32( cb_data ) );
+        tracer.Trace( "  start_bss:        %lx\n", swap_endian32( start_bss ) );
+        tracer.Trace( "  cb_bss:           %lx\n", swap_endian32( cb_bss ) );
+        tracer.Trace( "  cb_after_bss:     %lx\n", swap_endian32( cb_after_bss ) );
+        tracer.Trace( "  cb_command_tail:  %x\n",  cb_command_tail );
+        tracer.TraceBinaryData( command_tail, 127, 4 );
+    }
+};
+
+#pragma pack(pop)
+
+static int symbol_compare_cpm( const void * a, const void * b )
+{
+    SymbolEntryCPM * pa = (SymbolEntryCPM *) a;
+    SymbolEntryCPM * pb = (SymbolEntryCPM *) b;
+
+    if ( pa->value > pb->value )
+        return 1;
+    if ( pa->value == pb->value )
+        return 0;
+    return -1;
+} //symbol_compare_cpm
+
+bool write_fcb_arg( FCBCPM68K * arg, char * pc )
+{
+    if ( ':' == pc[ 1 ] )
+    {
+        if ( pc[0] > 'P' || pc[0] < 'A' )
+            return false; // don't write arguments that don't look like filenames
+
+        arg->dr = 1 + pc[0] - 'A';
+        pc += 2;
+    }
+
+    char * dot = strchr( pc, '.' );
+    if ( dot )
+    {
+        memcpy( & ( arg->f ), pc, get_min( (size_t) 8, (size_t) ( dot - pc ) ) );
+        memcpy( & ( arg->t ), dot + 1, get_min( (size_t) 3, strlen( dot + 1 ) ) );
+    }
+    else
+        memcpy( & ( arg->f ), pc, get_min( (size_t) 8, strlen( pc ) ) );
+
+    return true;
+} //write_fcb_arg
+
+char get_next_kbd_char()
+{
+    return (char) ConsoleConfiguration::portable_getch();
+} //get_next_kbd_char
+
+bool is_kbd_char_available()
+{
+    return g_consoleConfig.portable_kbhit();
+} //is_kbd_char_available
+
+bool cpm_read_console( char * buf, size_t bufsize, uint8_t & out_len )
+{
+    char ch = 0;
+    out_len = 0;
+    while ( out_len < (uint8_t) bufsize )
+    {
+        ch = (char) get_next_kbd_char();
+        tracer.Trace( "  get_next_kbd_char read character %02x -- '%c'\n", ch, printable( ch ) );
+
+        // CP/M read console buffer treats these control characters as special: c, e, h, j, m, r, u, x
+        // per http://www.gaby.de/cpm/manuals/archive/cpm22htm/ch5.htm
+        // Only c, h, j, and m are currently handled correctly.
+        // ^c means exit the currently running app in CP/M if it's the first character in the buffer
+
+        if ( ( 3 == ch ) && ( 0 == out_len ) )
+            return true;
+
+        if ( '\n' == ch || '\r' == ch )
+            break;
+
+        if ( 0x7f == ch || 8 == ch ) // backspace (it's not 8 for some reason)
+        {
+            if ( out_len > 0 )
+            {
+                printf( "\x8 \x8" );
+                fflush( stdout );
+                out_len--;
+            }
+        }
+        else
+        {
+            send_character( ch );
+            fflush( stdout );
+            buf[ out_len++ ] = ch;
+        }
+    }
+
+    return false;
+} //cpm_read_console
+
+bool read_symbols_cpm( FILE * fp, HeaderCPM68K & head, uint32_t text_base, uint32_t data_base, uint32_t bss_base )
+{
+    if ( 0 != head.cb_symbols ) // if they exist, load symbols so disassembly and hard termination can show them
+    {
+        uint32_t symbol_count = head.cb_symbols / sizeof( SymbolEntryCPM );
+        g_cpmSymbols.resize( symbol_count );
+        fseek( fp, (long) sizeof( head ) + head.cb_text + head.cb_data, SEEK_SET );
+        size_t read = fread( g_cpmSymbols.data(), head.cb_symbols, 1, fp );
+        if ( 1 != read )
+        {
+            printf( "can't read symbol data of cp/m 68k image file\n" );
+            return false;
+        }
+
+        for ( uint32_t i = 0; i < symbol_count; i++ )
+        {
+            SymbolEntryCPM & sym = g_cpmSymbols[ i ];
+            sym.swap_endianness();
+            if ( sym.type & 0x400 )
+                sym.value += data_base;
+            else if ( sym.type & 0x200 )
+                sym.value += text_base;
+            else if ( sym.type & 0x100 )
+                sym.value += bss_base;
+
+            // the DR tools create some symbols that aren't null-terminated. this is valid for internal symbols but difficult to work with.
+            sym.name[ 7 ] = 0;
+        }
+
+        // add a final entry with a very large value so the lookup doesn't have to worry about that edge case
+
+        SymbolEntryCPM last;
+        strcpy( last.name, "!last" );
+        last.type = 0;
+        last.value = 0xffffffff;
+        g_cpmSymbols.push_back( last );
+
+        my_qsort( g_cpmSymbols.data(), g_cpmSymbols.size(), sizeof( SymbolEntryCPM ), symbol_compare_cpm );
+
+        tracer.Trace( "symbols:\n" );
+        for ( uint32_t i = 0; i < symbol_count; i++ )
+            g_cpmSymbols[ i ].trace();
+    }
+
+    return true;
+} //read_symbols_cpm
+
+bool handle_relocations_cpm( FILE * fp, HeaderCPM68K & head, uint32_t text_base, uint32_t data_base, uint32_t bss_base )
+{
+    if ( 0 == head.relocation_flag ) // 0 means they exist
+    {
+        uint16_t * pimage = (uint16_t *) ( memory.data() + text_base );
+        uint32_t relocation_words = ( head.cb_text + head.cb_data ) / 2;
+        vector<uint16_t> relocations;
+        relocations.resize( relocation_words );
+        fseek( fp, (long) sizeof( head ) + head.cb_text + head.cb_data + head.cb_symbols, SEEK_SET );
+        size_t read = fread( relocations.data(), relocation_words * 2, 1, fp );
+        if ( 1 != read )
+        {
+            printf( "can't read relocations data of cp/m 68k image file\n" );
+            return false;
+        }
+
+        bool longword_mode = false;
+
+        for ( uint32_t i = 0; i < relocation_words; i++ )
+        {
+            uint16_t r = 7 & swap_endian16( relocations[ i ] );
+
+            if ( 1 == r )
+            {
+                //tracer.Trace( "updating relocation offset %u with data_base %#x, longword_mode %u\n", i, data_base, longword_mode );
+                if ( longword_mode )
+                {
+                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
+                    *pfull = swap_endian32( data_base + swap_endian32( *pfull ) );
+                    longword_mode = false;
+                }
+                else
+                    pimage[ i ] = swap_endian16( ( 0xffff & data_base ) + swap_endian16( pimage[ i ] ) );
+            }
+            else if ( 2 == r )
+            {
+                //tracer.Trace( "updating relocation offset %u with text_base %#x, longword_mode %u\n", i, text_base, longword_mode );
+                if ( longword_mode )
+                {
+                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
+                    *pfull = swap_endian32( text_base + swap_endian32( *pfull ) );
+                    longword_mode = false;
+                }
+                else
+                    pimage[ i ] = swap_endian16( (uint16_t) text_base + swap_endian16( pimage[ i ] ) );
+            }
+            else if ( 3 == r )
+            {
+                //tracer.Trace( "updating relocation offset %u with bss_base %#x, longword_mode %u\n", i, bss_base, longword_mode );
+                if ( longword_mode )
+                {
+                    uint32_t * pfull = (uint32_t *) ( pimage + i - 1 );
+                    *pfull = swap_endian32( bss_base + swap_endian32( *pfull ) );
+                    longword_mode = false;
+                }
+                else
+                    pimage[ i ] = swap_endian16( (uint16_t) bss_base + swap_endian16( pimage[ i ] ) );
+            }
+            else if ( 5 == r )
+                longword_mode = true;
+            else
+                longword_mode = false;
+        }
+    }
+
+    return true;
+} //handle_relocations_cpm
+
+// bdos 59 is invoked by apps including DDT
+
+bool load59_cpm68k( FILE *fp, uint32_t lowestAddress, uint32_t highestAddress, uint16_t loaderControlFlags, uint32_t & basePage, uint32_t & stackPointer )
+{
+    if ( 0 != loaderControlFlags )
+    {
+        tracer.Trace( "ERROR: only loading to lowest address is implemented\n" );
+        printf( "ERROR: only loading to lowest address is implemented\n" );
+        return false;
+    }
+
+    g_cpmSymbols.resize( 0 ); // throw away parent symbols
+    uint32_t child_memory_size = highestAddress + 1 - lowestAddress;
+
+    fseek( fp, (long) 0, SEEK_SET );
+    HeaderCPM68K head;
+    size_t read = fread( &head, sizeof( head ), 1, fp );
+    if ( 1 != read )
+    {
+        printf( "can't read header of cp/m 68k image file\n" );
+        return false;
+    }
+
+    head.swap_endianness();
+    head.trace();
+
+    if ( 0x601a != head.signature )
+    {
+        printf( "header of cp/m 68k image file isn't standard 0x601a:\n" );
+        return false;
+    }
+
+    if ( 0 == lowestAddress )    // ddt loads debugged apps at 0. Don't overwrite trap vectors; use a standard address
+        lowestAddress = 0x7a00;
+
+    uint32_t text_base;
+    if ( 0 != head.relocation_flag ) // 0 means they exist, != 0 means they don't exist
+        text_base = head.text_start;
+    else
+        text_base = lowestAddress + 0x100; // leave room for the base page
+
+    uint32_t image_size = head.cb_text + head.cb_data + head.cb_bss;
+    basePage = lowestAddress;
+    stackPointer = highestAddress & 0xfffffffe; // make sure it's 2-byte aligned
+    BasePageCPM * pbasepage = (BasePageCPM *) ( memory.data() + basePage );
+
+    fseek( fp, (long) sizeof( head ), SEEK_SET );
+    read = fread( memory.data() + text_base, head.cb_text + head.cb_data, 1, fp );
+    if ( 1 != read )
+    {
+        printf( "can't read text and data segments of cp/m 68k image file\n" );
+        return false;
+    }
+
+    tracer.Trace( "  read %x bytes of text and data at offset %x\n", head.cb_text + head.cb_data, text_base );
+
+    // malloc / brk in the C runtime for DR C use some of these values
+
+    pbasepage->lowest_tpa = swap_endian32( lowestAddress );
+    pbasepage->highest_tpa = swap_endian32( highestAddress );
+    pbasepage->start_text = swap_endian32( text_base );
+    pbasepage->cb_text = swap_endian32( head.cb_text );
+    pbasepage->start_data = swap_endian32( text_base + head.cb_text );
+    pbasepage->cb_data = swap_endian32( head.cb_data );
+    pbasepage->start_bss = swap_endian32( text_base + head.cb_text + head.cb_data );
+    pbasepage->cb_bss = swap_endian32( head.cb_bss );
+    pbasepage->cb_after_bss = swap_endian32( highestAddress + 1 - lowestAddress + 0x100 + head.cb_text + head.cb_data + head.cb_bss );
+
+    uint32_t data_base = text_base; // + head.cb_text; with 0x601a all bases belong to text_base
+    uint32_t bss_base = text_base; // data_base + head.cb_data;
+
+    if ( !handle_relocations_cpm( fp, head, text_base, data_base, bss_base ) )
+        return false;
+
+    if ( !read_symbols_cpm( fp, head, text_base, data_base, bss_base ) )
+        return false;
+
+    pbasepage->Trace();
+
+    tracer.Trace( "memory map from highest to lowest addresses:\n" );
+    tracer.Trace( "  actual top of stack:                                %x\n", stackPointer );
+    tracer.Trace( "  <stack>\n" );
+    tracer.Trace( "  <unallocated space between brk and the stack>\n" );
+    tracer.Trace( "  end_of_bss / current brk:                           %x\n", text_base + head.cb_text + head.cb_data  + head.cb_bss );
+    tracer.Trace( "  <uninitialized bss data>\n" );
+    tracer.Trace( "  start of bss segment:                               %x\n", text_base + head.cb_text + head.cb_data );
+    tracer.Trace( "  <initialized data from the .68k file>\n" );
+    tracer.Trace( "  start of data segment:                              %x\n", text_base + head.cb_text );
+    tracer.Trace( "  <code from the .68k file>\n" );
+    tracer.Trace( "  initial pc execution_addess + start of code         %x\n", text_base );
+    tracer.Trace( "  start of base page:                                 %x\n", basePage );
+    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+
+    tracer.Trace( "first 512 bytes starting at base page:\n" );
+    tracer.TraceBinaryData( memory.data() + basePage, 512, 8 );
+
+    return true;
+} //load59_cpm68k
+
+bool load_cpm68k( const char * acApp, const char * acAppArgs )
+{
+    assert( 256 == sizeof( BasePageCPM ) ); // make sure the structure was defined correctly
+
+    // CP/M apps including Forth83 expect LF characters in files redirected to stdin are converted to CR
+    ConsoleConfiguration::ConvertRedirectedLFToCR( true );
+
+    // if this is being called from the bdos chain call, reset global data structures.
+    memory.resize( 0 );
+    g_cpmSymbols.resize( 0 );
+
+    FILE * fp = fopen( acApp, "rb" );
+    if ( !fp )
+    {
+        printf( "can't open cp/m 68k image file: %s\n", acApp );
+        return false;
+    }
+
+    CFile file( fp );
+    HeaderCPM68K head;
+    size_t read = fread( &head, sizeof( head ), 1, fp );
+    if ( 1 != read )
+    {
+        printf( "can't read header of cp/m 68k image file: %s\n", acApp );
+        return false;
+    }
+
+    head.swap_endianness();
+    head.trace();
+
+    if ( 0x601a != head.signature )
+    {
+        printf( "header of cp/m 68k image file isn't standard no-relocation 0x601a: %s\n", acApp );
+        return false;
+    }
+
+    uint32_t text_base;
+    if ( 0 != head.relocation_flag ) // 0 means they exist, != 0 means they don't exist
+        text_base = head.text_start;
+    else
+        text_base = 0x7b00; // arbitrary, but this is what an actual cp/m 68k machine uses
+
+    uint32_t image_size = head.cb_text + head.cb_data + head.cb_bss;
+    uint32_t memory_size = 0x100 + text_base + image_size; // base page + offset from 0 to start of code + total size of image loaded from the executable
+
+    // make it 4-byte aligned
+
+    if ( memory_size & 3 )
+    {
+        memory_size += 4;
+        memory_size &= ~3;
+    }
+
+    g_end_of_data = memory_size - 0x100;
+    g_brk_offset = g_end_of_data;
+    g_highwater_brk = g_end_of_data;
+    memory_size += g_brk_commit;
+
+    g_bottom_of_stack = memory_size;
+    memory_size += g_stack_commit;
+
+    memory.resize( memory_size );
+    memset( memory.data(), 0, memory.size() );
+
+    // put the supervisor stack pointer in the first 4 bytes of RAM.
+    * (uint32_t *) memory.data() = swap_endian32( 1024 ); // arbitrary, but above the vector table and below the typical cp/m 68k base page (where f83 loads)
+
+    g_base_address = 0;
+    uint32_t base_page = text_base - 0x100; // where the base page (256 bytes) resides
+    BasePageCPM * pbasepage = (BasePageCPM *) ( memory.data() + base_page );
+    g_execution_address = text_base;
+    g_top_of_stack = (REG_TYPE) g_bottom_of_stack + g_stack_commit;
+    pbasepage->reserved[ 1 ] = 0x22; // move.l d0, d1.  return code. at at offset 0x26 in the base page (not a cp/m standard)
+    pbasepage->reserved[ 2 ] = 0x00;
+    pbasepage->reserved[ 3 ] = 0x70; // moveq #93, d0   linux exit function
+    pbasepage->reserved[ 4 ] = 0x5d;
+    pbasepage->reserved[ 5 ] = 0x4e; // trap 0          invoke linux syscall to exit the app
+    pbasepage->reserved[ 6 ] = 0x40;
+
+    // per the cp/m 68k spec there must be two 32-bit values at the top of the stack for base address and return location at app completion
+    g_top_of_stack -= 8;
+    uint32_t * preturn_address = (uint32_t *) & memory[ g_top_of_stack ];
+    uint32_t * pbase_page_address = (uint32_t *) & memory[ g_top_of_stack + 4 ];
+    *preturn_address = swap_endian32( base_page + 0x26 );
+    *pbase_page_address = swap_endian32( base_page );
+    tracer.Trace( "memory at top of stack address %#x:\n", g_top_of_stack );
+    tracer.TraceBinaryData( & memory[ g_top_of_stack ], 8, 4 );
+
+    fseek( fp, (long) sizeof( head ), SEEK_SET );
+    read = fread( memory.data() + text_base, head.cb_text + head.cb_data, 1, fp );
+    if ( 1 != read )
+    {
+        printf( "can't read text and data segments of cp/m 68k image file: %s\n", acApp );
+        return false;
+    }
+    tracer.Trace( "  read %x bytes of text and data from file offset %x to memory offset %x\n", head.cb_text + head.cb_data, (int) sizeof( head ), text_base );
+
+    while ( ' ' == *acAppArgs )
+        acAppArgs++;
+
+    uint8_t arg_len = (uint8_t) strlen( acAppArgs );
+    if ( arg_len > 126 )
+    {
+        printf( "app arguments for cp/m can't be > 126 characters long\n" );
+        return false;
+    }
+
+    memset( & ( pbasepage->firstFCB.f ), ' ', 11 ); // 8 filename + 3 type
+    memset( & ( pbasepage->secondFCB.f ), ' ', 11 );
+
+    pbasepage->cb_command_tail = arg_len;
+    strcpy( (char *) ( pbasepage->command_tail ), acAppArgs );
+    tracer.Trace( "arg_len %u, command tail %s\n", arg_len, acAppArgs );
+
+    // put what looks like filenames in the command tail in the two FCBs in the base page. Apps don't much use this.
+
+    char acCopy[ 128 ];
+    strcpy( acCopy, acAppArgs );
+
+    char * pcArg1 = 0;
+    char * pcArg2 = 0;
+    char * pa = acCopy;
+
+    while ( *pa && !pcArg2 )
+    {
+        if ( ' ' == *pa )
+            pa++;
+        else if ( '-' == *pa )
+        {
+            while ( *pa && ' ' != *pa )
+                pa++;
+        }
+        else if ( ':' == * ( pa + 1 ) )
+            pa += 2;
+        else if ( !pcArg1 )
+        {
+            pcArg1 = pa;
+            while ( *pa && ' ' != *pa )
+                pa++;
+        }
+        else if ( !pcArg2 )
+        {
+            pcArg2 = pa;
+            while ( *pa && ' ' != *pa )
+                pa++;
+        }
+    }
+
+    if ( pcArg1 )
+    {
+        char * p = pcArg1;
+        while ( *p )
+        {
+            if ( ' ' == *p )
+                *p = 0;
+            else
+                p++;
+        }
+        tracer.Trace( "    arg1: '%s'\n", pcArg1 );
+        strupr( pcArg1 );
+        write_fcb_arg( & ( pbasepage->firstFCB ), pcArg1 );
+    }
+
+    if ( pcArg2 )
+    {
+        char * p = pcArg2;
+        while ( *p )
+        {
+            if ( ' ' == *p )
+                *p = 0;
+            else
+                p++;
+        }
+        tracer.Trace( "    arg2: '%s'\n", pcArg2 );
+        strupr( pcArg2 );
+        write_fcb_arg( & ( pbasepage->secondFCB ), pcArg2 );
+    }
+
+    // malloc / brk in the C runtime for DR C use some of these values
+
+    pbasepage->lowest_tpa = 0;
+    pbasepage->highest_tpa = swap_endian32( g_base_address + memory_size - 1 );
+    pbasepage->start_text = swap_endian32( text_base );
+    pbasepage->cb_text = swap_endian32( head.cb_text );
+    pbasepage->start_data = swap_endian32( text_base + head.cb_text );
+    pbasepage->cb_data = swap_endian32( head.cb_data );
+    pbasepage->start_bss = swap_endian32( text_base + head.cb_text + head.cb_data );
+    pbasepage->cb_bss = swap_endian32( head.cb_bss );
+    pbasepage->cb_after_bss = swap_endian32( g_brk_commit );
+
+    g_DMA = memory.data() + text_base - 0x80; // midway through the base page
+    uint32_t data_base = text_base; // + head.cb_text; with 0x601a all bases belong to text_base
+    uint32_t bss_base = text_base; // data_base + head.cb_data;
+
+    if ( !handle_relocations_cpm( fp, head, text_base, data_base, bss_base ) )
+        return false;
+
+    if ( !read_symbols_cpm( fp, head, text_base, data_base, bss_base ) )
+        return false;
+
+    pbasepage->Trace();
+
+    tracer.Trace( "memory map from highest to lowest addresses:\n" );
+    tracer.Trace( "  first byte beyond allocated memory:                 %x\n", g_base_address + memory_size );
+    tracer.Trace( "  actual top of stack:                                %x\n", g_top_of_stack + 8 );
+    tracer.Trace( "  initial stack pointer g_top_of_stack:               %x\n", g_top_of_stack );
+    REG_TYPE stack_bytes = g_stack_commit;
+    tracer.Trace( "  <stack>                                             (%d == %x bytes)\n", stack_bytes, stack_bytes );
+    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %x\n", g_base_address + g_bottom_of_stack );
+    tracer.Trace( "  <unallocated space between brk and the stack>       (%d == %llx bytes)\n", g_brk_commit, g_brk_commit );
+    tracer.Trace( "  end_of_bss / current brk:                           %x\n", g_base_address + g_end_of_data );
+    tracer.Trace( "  <uninitialized bss data>\n" );
+    tracer.Trace( "  start of bss segment:                               %x\n", g_execution_address + head.cb_text + head.cb_data );
+    tracer.Trace( "  <initialized data from the .68k file>\n" );
+    tracer.Trace( "  start of data segment:                              %x\n", g_execution_address + head.cb_text );
+    tracer.Trace( "  <code from the .68k file>\n" );
+    tracer.Trace( "  initial pc execution_addess + start of code         %x\n", g_execution_address );
+    tracer.Trace( "  default DMA address:                                %x\n", (uint32_t) ( g_DMA - memory.data() ) );
+    tracer.Trace( "  start of base page:                                 %x\n", base_page );
+    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+
+    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
+    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
+    tracer.Trace( "memory_size:                     %#x == %d\n", memory_size, memory_size );
+
+    tracer.Trace( "first 512 bytes starting at base page:\n" );
+    tracer.TraceBinaryData( memory.data() + base_page, 512, 8 );
+
+    return true;
+} //load_cpm68k
+
+bool IsAFolder( const char * pc )
+{
+    struct stat file_stat;
+    int result = stat( pc, &file_stat );
+    return ( ( 0 == result ) && ( 0 != ( S_IFDIR & file_stat.st_mode ) ) );
+} //IsAFolder
+
+bool ValidCPMFilename( char * pc )
+{
+    if ( !strcmp( pc, "." ) )
+        return false;
+
+    if ( !strcmp( pc, ".." ) )
+        return false;
+
+    const char * pcinvalid = "<>,;:=?[]%|()/\\ \t\n\r"; // control characters are valid with exceptions
+    for ( size_t i = 0; i < strlen( pcinvalid ); i++ )
+        if ( strchr( pc, pcinvalid[i] ) )
+            return false;
+
+    size_t len = strlen( pc );
+
+    if ( len > 12 )
+        return false;
+
+    char * pcdot = strchr( pc, '.' );
+
+    if ( !pcdot && ( len > 8 ) )
+        return false;
+
+    if ( pcdot && ( ( pcdot - pc ) > 8 ) )
+        return false;
+
+    return true;
+} //ValidCPMFilename
+
+#ifdef _WIN32
+    static HANDLE g_hFindFirst = INVALID_HANDLE_VALUE;
+
+    void CloseFindFirst()
+    {
+        if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+        {
+            FindClose( g_hFindFirst );
+            g_hFindFirst = INVALID_HANDLE_VALUE;
+        }
+    } //CloseFindFirst
+#else //_WIN2
+    #include <dirent.h>
+    static DIR * g_FindFirst = 0;
+
+    void CloseFindFirst()
+    {
+        if ( 0 != g_FindFirst )
+        {
+            closedir( g_FindFirst );
+            g_FindFirst = 0;
+        }
+    } //CloseFindFirst
+
+    void ExtractFilename( const char * filename, char * name, char * ext )
+    {
+        bool pastdot = false;
+        const char * p = filename;
+        int extlen = 0;
+        int namelen = 0;
+        while ( *p )
+        {
+            if ( '.' == *p )
+                pastdot = true;
+            else
+            {
+                if ( pastdot )
+                    ext[ extlen++ ] = *p;
+                else
+                    name[ namelen++ ] = *p;
+            }
+
+            p++;
+        }
+
+        assert( namelen <= 8 );
+        assert( extlen <= 3 );
+        name[ namelen ] = 0;
+        ext[ extlen ] = 0;
+    } //ExtractFilename
+
+    bool IsCPMPatternMatch( const char * pattern, const char * name )
+    {
+        bool match = true;
+        int o_pattern = 0, o_name = 0;
+        while ( pattern[ o_pattern ] || name[ o_name ] )
+        {
+            char cp = pattern[ o_pattern ];
+            char cn = name[ o_name ];
+
+            if ( ( '?' != cp ) && ( cp != cn ) )
+            {
+                tracer.Trace( "  not a pattern match at offsets %d / %d\n", o_pattern, o_name );
+                match = false;
+                break;
+            }
+
+            if ( cp )
+                o_pattern++;
+            if ( cn )
+                o_name++;
+        }
+
+        return match;
+    } //IsCPMPatternMatch
+
+    bool FindNextFileLinux( const char * pattern, DIR * pdir, LINUX_FIND_DATA & fd )
+    {
+        do
+        {
+            struct dirent * pent = readdir( pdir );
+            if ( 0 == pent )
+                return false;
+
+            // ignore files CP/M just wouldn't understand
+
+            if ( !ValidCPMFilename( pent->d_name ) || IsAFolder( pent->d_name ) )
+                continue;
+
+            tracer.Trace( "  FindNextFileLinux is matching '%s' with '%s'\n", pattern, pent->d_name );
+
+            bool match = true;
+            if ( strcmp( pattern, "????????.???" ) )
+            {
+                // cp/m patterns contain '?' (match anything including nothing), ' ' (match nothing), or literal characters
+
+                char acName[ 9 ], acExt[ 4 ];
+                char acPatternName[ 9 ], acPatternExt[ 4 ];
+                ExtractFilename( pattern, acPatternName, acPatternExt );
+                ExtractFilename( pent->d_name, acName, acExt );
+
+                tracer.Trace( "  extracted pattern name '%s' ext '%s', file name '%s', ext '%s'\n", acPatternName, acPatternExt, acName, acExt );
+
+                match = IsCPMPatternMatch( acPatternName, acName );
+                if ( match )
+                    match = IsCPMPatternMatch( acPatternExt, acExt );
+            }
+
+            if ( !match )
+                continue;
+
+            strcpy( fd.cFileName, pent->d_name );
+            return true;
+        } while ( true );
+
+        return false;
+    } //FindNextFileLinux
+
+    DIR * FindFirstFileLinux( const char * pattern, LINUX_FIND_DATA & fd )
+    {
+        DIR * pdir = opendir( "." );
+        tracer.Trace( "  opendir returned %p, errno %d = %s\n", pdir, errno, strerror( errno ) );
+
+        if ( 0 == pdir )
+            return 0;
+
+        bool found = FindNextFileLinux( pattern, pdir, fd );
+
+        if ( !found )
+        {
+            closedir( pdir );
+            return 0;
+        }
+
+        return pdir;
+    } //FindFirstFileLinux
+
+#endif //_WIN32
+
+void ParseFoundFile( char * pfile )
+{
+    tracer.Trace( "  ParseFoundFile '%s'\n", pfile );
+    memset( g_DMA, 0, 128 );
+    memset( g_DMA + 1, ' ', 11 );
+
+    size_t len = strlen( pfile );
+    assert( len <= 12 ); // 8.3 only
+    _strupr( pfile );
+
+    for ( size_t i = 0; i < len; i++ )
+    {
+        if ( '.' == pfile[ i ] )
+        {
+            for ( size_t e = 0; e < 3; e++ )
+            {
+                if ( 0 == pfile[ i + 1 + e ] )
+                    break;
+
+                g_DMA[ 8 + e + 1 ] = pfile[ i + 1 + e ];
+            }
+
+            break;
+        }
+
+        g_DMA[ i + 1 ] = pfile[ i ];
+    }
+
+    tracer.Trace( "  search for first/next found '%c%c%c%c%c%c%c%c%c%c%c'\n",
+                    g_DMA[1], g_DMA[2], g_DMA[3], g_DMA[4], g_DMA[5], g_DMA[6], g_DMA[7], g_DMA[8],
+                    g_DMA[9], g_DMA[10],  g_DMA[11] );
+} //ParseFoundFile
+
+bool parse_FCB_Filename( FCBCPM68K * pfcb, char * pcFilename )
+{
+    char * orig = pcFilename;
+
+    // note: the high bits are used for file attributes. Mask them away
+
+    for ( int i = 0; i < 8; i++ )
+    {
+        char c = ( 0x7f & pfcb->f[ i ] );
+        if ( ' ' == c )
+            break;
+        if ( '/' == c ) // slash is legal in CP/M and MT Pascal v3.0b uses it for P2/FLT.OVL. hack it to use #
+            c = '#';
+        *pcFilename++ = c;
+    }
+
+    if ( ' ' != pfcb->t[0] )
+    {
+        *pcFilename++ = '.';
+
+        for ( int i = 0; i < 3; i++ )
+        {
+            char c = ( 0x7f & pfcb->t[ i ] );
+            if ( ' ' == c )
+                break;
+            *pcFilename++ = c;
+        }
+    }
+
+    *pcFilename = 0;
+
+    // CP/M assumes all filenames are uppercase. Linux users generally use all lowercase filenames
+
+    if ( g_forceLowercase )
+        _strlwr( orig );
+
+    return ( pcFilename != orig );
+} //parse_FCB_Filename
+
+void WriteRandom( m68000 & cpu )
+{
+    FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+    pfcb->Trace();
+    ACCESS_REG( REG_RESULT ) = 6; // seek past end of disk
+
+    char acFilename[ CPM_FILENAME_LEN ];
+    bool ok = parse_FCB_Filename( pfcb, acFilename );
+    if ( ok )
+    {
+        FILE * fp = FindFileEntry( acFilename );
+        if ( fp )
+        {
+            uint32_t record = pfcb->GetRandomIOOffset();
+            uint32_t file_offset = record * (uint32_t) 128;
+
+            fseek( fp, 0, SEEK_END );
+            uint32_t file_size = ftell( fp );
+            tracer.Trace( "  write random file %p, record %#x, file_offset %d, file_size %d\n", fp, record, file_offset, file_size );
+
+            if ( file_offset > file_size )
+            {
+                ok = !fseek( fp, file_offset, SEEK_SET );
+                if ( ok )
+                    file_size = ftell( fp );
+                else
+                    tracer.Trace( "  can't seek to extend file with zeros, error %d = %s\n", errno, strerror( errno ) );
+            }
+
+            if ( file_size >= file_offset )
+            {
+                ok = !fseek( fp, file_offset, SEEK_SET );
+                if ( ok )
+                {
+                    tracer.Trace( "  writing random at offset %#x\n", file_offset );
+                    tracer.TraceBinaryData( g_DMA, 128, 2 );
+                    size_t numwritten = fwrite( g_DMA, 128, 1, fp );
+                    if ( numwritten )
+                    {
+                        ACCESS_REG( REG_RESULT ) = 0;
+
+                        // The CP/M spec says random write should set the file offset such
+                        // that the following sequential I/O will be from the SAME location
+                        // as this random write -- not 128 bytes beyond.
+
+                        fseek( fp, file_offset, SEEK_SET );
+                    }
+                    else
+                        tracer.Trace( "ERROR: can't write in write random, error %d = %s\n", errno, strerror( errno ) );
+                }
+                else
+                    tracer.Trace( "ERROR: can't seek in write random, offset %#x, size %#x\n", file_offset, file_size );
+            }
+            else
+                tracer.Trace( "ERROR: write random at offset %d beyond end of file size %d\n", file_offset, file_size );
+        }
+        else
+            tracer.Trace( "ERROR: write random on unopened file\n" );
+    }
+    else
+        tracer.Trace( "ERROR: write random can't parse filename\n" );
+} //WriteRandom
+
+uint8_t map_input( uint8_t input )
+{
+    uint8_t output = input;
+
+#if defined(_MSC_VER) || defined(WATCOM)
+    // On Windows, input is  0xe0 for standard arrow keys and 0 for keypad equivalents
+    // On DOS/WATCOM, input is 0 for both cases
+
+    if ( 0 == input || 0xe0 == input )
+    {
+        uint8_t next = (uint8_t) ConsoleConfiguration::portable_getch();
+
+        // map various keys to ^ XSEDCRG used in many apps.
+
+        if ( 'K' == next )                   // left arrow
+            output = 1 + 'S' - 'A';
+        else if ( 'P' == next )              // down arrow
+            output = 1 + 'X' - 'A';
+        else if ( 'M' == next )              // right arrow
+            output = 1 + 'D' - 'A';
+        else if ( 'H' == next )              // up arrow
+            output = 1 + 'E' - 'A';
+        else if ( 'Q' == next )              // page down
+            output = 1 + 'C' - 'A';
+        else if ( 'I' == next )              // page up
+            output = 1 + 'R' - 'A';
+        else if ( 'S' == next )              // del
+            output = 1 + 'G' - 'A';
+        else
+            tracer.Trace( "  no map_input mapping for %02x, second character %02x\n", input, next );
+
+        tracer.Trace( "    next character after %02x: %02x == '%c' mapped to %02x\n", input, printable( next ), output );
+    }
+#else // Linux / MacOS
+    if ( 0x1b == input )
+    {
+        if ( g_consoleConfig.portable_kbhit() )
+        {
+            tracer.Trace( "read an escape on linux... getting next char\n" );
+            uint8_t nexta = ConsoleConfiguration::portable_getch();
+            tracer.Trace( "read an escape on linux... getting next char again\n" );
+            uint8_t nextb = ConsoleConfiguration::portable_getch();
+            tracer.Trace( "  nexta: %02x. nextb: %02x\n", nexta, nextb );
+
+            if ( '[' == nexta )
+            {
+                if ( 'A' == nextb )              // up arrow
+                    output = 1 + 'E' - 'A';
+                else if ( 'B' == nextb )         // down arrow
+                    output = 1 + 'X' - 'A';
+                else if ( 'C' == nextb )         // right arrow
+                    output = 1 + 'D' - 'A';
+                else if ( 'D' == nextb )         // left arrow
+                    output = 1 + 'S' - 'A';
+                else if ( '5' == nextb )         // page up
+                {
+                    uint8_t nextc = g_consoleConfig.portable_getch();
+                    tracer.Trace( "  5 nextc: %02x\n", nextc );
+                    if ( '~' == nextc )
+                        output = 1 + 'R' - 'A';
+                }
+                else if ( '6' == nextb )         // page down
+                {
+                    uint8_t nextc = g_consoleConfig.portable_getch();
+                    tracer.Trace( "  6 nextc: %02x\n", nextc );
+                    if ( '~' == nextc )
+                        output = 1 + 'C' - 'A';
+                }
+                else if ( '3' == nextb )         // DEL on linux
+                {
+                    uint8_t nextc = g_consoleConfig.portable_getch();
+                    tracer.Trace( "  3 nextc: %02x\n", nextc );
+                    if ( '~' == nextc )
+                        output = 0x7f;
+                }
+                else
+                    tracer.Trace( "unhandled nextb %u == %02x\n", nextb, nextb ); // lots of other keys not on a cp/m machine here
+            }
+            else
+                tracer.Trace( "unhandled linux keyboard escape sequence\n" );
+        }
+    }
+#endif
+
+    return output;
+} //map_input
+
+void emulator_invoke_68k_trap3( m68000 & cpu ) // bios
+{
+    uint16_t function = ( 0xffff & ACCESS_REG( REG_SYSCALL ) );
+    tracer.Trace( "trap 3 cp/m 68k bios call %u arguments %#x, %#x -- %s\n", function, ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG1 ), bios_function( function ) );
+
+    switch( function )
+    {
+        case 0: // cold boot
+        case 1: // warm boot
+        {
+            g_terminate = true;
+            cpu.end_emulation();
+            g_exit_code = (int) ACCESS_REG( REG_ARG0 ); // not part of the cp/m 68k spec but it seems handy
+            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
+            break;
+        }
+        case 2: // console status (check for console character ready)
+        {
+            if ( is_kbd_char_available() )
+                ACCESS_REG( REG_RESULT ) = 0xff;
+            else
+                ACCESS_REG( REG_RESULT ) = 0;
+            tracer.Trace( "  status is returing %x\n", (uint8_t) ACCESS_REG( REG_RESULT ) );
+            break;
+        }
+        case 3: // read console character in
+        {
+            uint8_t input = (uint8_t) get_next_kbd_char();
+            tracer.Trace( "  read character %u == %02x == '%c'\n", input, input, printable( input ) );
+            ACCESS_REG( REG_RESULT ) = map_input( input );
+            break;
+        }
+        case 4: // write console character
+        {
+            uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
+            if ( 0 != ch )  // cp/m 68k assembler as.68k v1 outputs a null character; ignore it.
+            {
+                tracer.Trace( "  bios write console: %02x == '%c'\n", ch, printable( ch ) );
+                send_character( ch );
+                fflush( stdout );
+            }
+            break;
+        }
+        case 22: // set exception handler address
+        {
+            uint32_t vector_number = 0xffff & ACCESS_REG( REG_ARG0 );
+            uint32_t vector_address = ACCESS_REG( REG_ARG1 );
+            ACCESS_REG( REG_RESULT ) = cpu.getui32( vector_number * 4 );
+            cpu.setui32( vector_number * 4, vector_address );
+            break;
+        }
+        default:
+        {
+            printf( "  unhandled cp/m bios call %u\n", function );
+            tracer.Trace( "  unhandled cp/m bios call %u\n", function );
+            ACCESS_REG( REG_RESULT ) = 0xff;
+            break;
+        }
+    }
+} //emulator_invoke_68k_trap3
+
+uint16_t days_since_jan1_1978()
+{
+    time_t current_time;
+    struct tm *time_info;
+
+    current_time = time( 0 );
+    time_info = localtime( &current_time );
+
+    struct tm target_date = {0};
+    target_date.tm_year = 1978 - 1900; // Years since 1900
+    target_date.tm_mon = 0;         // January (0-indexed)
+    target_date.tm_mday = 1;
+    target_date.tm_hour = 0;
+    target_date.tm_min = 0;
+    target_date.tm_sec = 0;
+
+    time_t target_time = mktime( &target_date );
+    time_t difference_seconds = current_time - target_time;
+    uint16_t days_since_1978 = (uint16_t) ( difference_seconds / ( 24 * 60 * 60 ) );
+    return days_since_1978;
+} //days_since_jan1_1978
+
+void emulator_invoke_68k_trap2( m68000 & cpu ) // bdos
+{
+    char acFilename[ CPM_FILENAME_LEN ];
+    uint16_t function = ( 0xffff & ACCESS_REG( REG_SYSCALL ) );
+    tracer.Trace( "trap 2 cp/m 68k bdos call %u, argument %#x -- %s\n", function, ACCESS_REG( REG_ARG0 ), bdos_function( function ) );
+
+    // note: only the subset invoked by cp/m 68k versions of the C, BASIC, and Pascal compilers, assembler, and linker are implemented.
+
+    switch ( function )
+    {
+        case 0: // system reset; exit the app
+        {
+            g_terminate = true;
+            cpu.end_emulation();
+            g_exit_code = (int) ACCESS_REG( REG_ARG0 ); // not part of the cp/m 68k spec but it seems handy
+            tracer.Trace( "  emulated app exit code %d\n", g_exit_code );
+            break;
+        }
+        case 1: // console input. echo input to console
+        {
+            uint8_t ch = (uint8_t) get_next_kbd_char();
+            ACCESS_REG( REG_RESULT ) = map_input( ch );
+            tracer.Trace( "  bdos console in: %02x == '%c'\n", ch, printable( ch ) );
+            send_character( ch );
+            fflush( stdout );
+            break;
+        }
+        case 2: // console output. d1.w ascii chracter
+        {
+            // console output
+            // CP/M 2.2 checks for ^s and ^q to pause and resume output. If output is paused due to ^s,
+            // a subsequent ^c terminates the application. ^q resumes output then ^c has no effect.
+
+            uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
+            if ( 0 != ch )  // cp/m 68k assembler as.68k v1 outputs a null character; ignore it.
+            {
+                tracer.Trace( "  bdos console out: %02x == '%c'\n", ch, printable( ch ) );
+                send_character( ch );
+                fflush( stdout );
+            }
+
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 6: // direct console i/o. Note slightly different behavior than cp/m 80 v2.2 with the 0xff and 0xfe distinction
+        {
+            uint16_t cmd = (uint16_t) ( 0xffff & ACCESS_REG( REG_ARG0 ) );
+            if ( 0xff == cmd ) // input. block until a character is ready
+            {
+                uint8_t input = (uint8_t) get_next_kbd_char();
+                tracer.Trace( "  read character %u == %02x == '%c'\n", input, input, printable( input ) );
+                ACCESS_REG( REG_RESULT ) = map_input( input );
+            }
+            else if ( 0xfe == cmd ) // status. return non-zero if available and 0 if unavailable
+            {
+                if ( is_kbd_char_available() )
+                    ACCESS_REG( REG_RESULT ) = 1;
+                else
+                    ACCESS_REG( REG_RESULT ) = 0;
+            }
+            else // output
+            {
+                uint8_t ch = ( 0xff & ACCESS_REG( REG_ARG0 ) );
+                tracer.Trace( "  bdos console i/o output: %02x == '%c'\n", ch, printable( ch ) );
+                send_character( ch );
+                fflush( stdout );
+            }
+            break;
+        }
+        case 9: // print string. send $-terminated string to stdout
+        {
+            char * str = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            char * pdollar = strchr( str, '$' );
+            if ( pdollar )
+            {
+                tracer.Trace( "   string: %.*s\n", pdollar - str, str );
+                tracer.TraceBinaryData( (uint8_t *) str, (uint32_t) ( pdollar - str ), 4 );
+            }
+            uint32_t count = 0;
+            while ( '$' != *str )
+            {
+                if ( count++ > 2000 ) // arbitrary limit, but probably a bug if this long
+                {
+                    tracer.Trace( "  ERROR: String to print is too long!\n", stderr );
+                    break;
+                }
+
+                uint8_t ch = *str++;
+                send_character( ch );
+            }
+            fflush( stdout );
+            break;
+        }
+        case 10: // read console buffer. aka buffered console input. DE: buffer address. buffer:
+        {
+            //   0      1         2       3
+            //   in_len out_len   char1   char2 ...
+
+            char * pbuf = (char *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pbuf[ 1 ] = 0;
+            uint16_t in_len = *pbuf;
+
+            if ( in_len > 0 )
+            {
+                pbuf[ 2 ] = 0;
+                uint8_t out_len;
+                bool reboot = cpm_read_console( pbuf + 2, in_len, out_len );
+                if ( reboot )
+                {
+                    tracer.Trace( "  bdos read console buffer read a ^c at the first position, so it's terminating the app\n" );
+                    cpu.end_emulation();
+                    g_terminate = true;
+                    g_exit_code = 1;
+                    break;
+                }
+
+                pbuf[ 1 ] = out_len;
+                tracer.Trace( "  read console len %u, string '%.*s'\n", out_len, (size_t) out_len, pbuf + 2 );
+            }
+            else
+                tracer.Trace( "WARNING: read console buffer asked for input but provided a 0-length buffer\n" );
+            break;
+        }
+        case 11: // get console status
+        {
+            // for now lie and say no characters are available
+
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 12: // return version number
+        {
+            ACCESS_REG( REG_RESULT ) = 0x2022; // cp/m-68k v1.1
+            break;
+        }
+        case 13: // reset disks.
+        {
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 14: // select disk. Return 0 in result if OK, or 0xff otherwise.
+        {
+            uint8_t disk = (uint8_t) ACCESS_REG( REG_ARG0 );
+            tracer.Trace( "  selected disk %d == %c\n", disk, ( disk < 16 ) ? disk + 'A' : '?' );
+
+            if ( 0 == disk )
+                ACCESS_REG( REG_RESULT ) = 0;
+            else
+                ACCESS_REG( REG_RESULT ) = 255;
+            break;
+        }
+        case 15: // open file. success 0-3, error 0xff
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            tracer.TraceBinaryData( (uint8_t *) pfcb, sizeof( FCBCPM68K ), 4 );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                tracer.Trace( "  opening file '%s' for pfcb %p\n", acFilename, pfcb );
+                FILE * fp = FindFileEntry( acFilename );
+                if ( fp )
+                {
+                    // sometimes apps like the CP/M assembler ASM open files that are already open.
+                    // rewind it to position 0.
+
+                    fseek( fp, 0, SEEK_SET );
+                    ACCESS_REG( REG_RESULT ) = 0;
+                    pfcb->cr = 0;
+                    pfcb->SetRecordCount( fp ); // Whitesmith C 2.1 requires this to be set
+                    // don't reset extent on a re-open or LK80.COM will fail. pfcb->ex = 0;
+                    pfcb->s2 = 0;
+                    tracer.Trace( "  open used existing file and rewound to offset 0\n" );
+                }
+                else
+                {
+                    // the cp/m 2.2 spec says that filenames may contain question marks. I haven't found an app that uses that.
+
+                    fp = fopen( acFilename, "r+b" );
+                    if ( fp )
+                    {
+                        FileEntry fe;
+                        strcpy( fe.acName, acFilename );
+                        fe.fp = fp;
+                        g_fileEntries.push_back( fe );
+                        ACCESS_REG( REG_RESULT ) = 0;
+
+                        // Digital Research's lk80.com linker has many undocumented expectations no other apps I've tested have.
+                        // including rc > 0 after an open. Whitesmith C requires the record count set correctly.
+
+                        pfcb->SetRecordCount( fp );
+
+                        // cr and ex can't be zeroed or whitesmith pascal's lnk produces corrupt .com files
+                        // pfcb->cr = 0;
+                        // pfcb->ex = 0;
+                        pfcb->s2 = 0;
+                        tracer.Trace( "  file opened successfully, record count: %u\n", pfcb->rc );
+                    }
+                    else
+                        tracer.Trace( "ERROR: can't open file '%s' error %d = %s\n", acFilename, errno, strerror( errno ) );
+                }
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename in FCB\n" );
+            break;
+        }
+        case 16: // close file. return 255 on error and 0..3 directory code otherwise
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                FILE * fp = RemoveFileEntry( acFilename );
+                if ( fp )
+                {
+                    int ret = fclose( fp );
+
+                    if ( 0 == ret )
+                        ACCESS_REG( REG_RESULT ) = 0;
+                    else
+                        tracer.Trace( "ERROR: file close failed, error %d = %s\n", errno, strerror( errno ) );
+                }
+                else
+                {
+                    // return error 255 if the file doesn't exist.
+                    // Pro Pascal Compiler v2.1 requires a 0 return code for a file that's not open but exists.
+
+                    if ( file_exists( acFilename ) )
+                    {
+                        tracer.Trace( "    WARNING: file close on file that's not open but exists\n" );
+                        ACCESS_REG( REG_RESULT ) = 0;
+                    }
+                    else
+                        tracer.Trace( "ERROR: file close on file that's not open and doesn't exist\n" );
+                }
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename in close call\n" );
+            break;
+        }
+        case 17: // search for first.
+        {
+            // Use the FCB and write directory entries to the DMA address, then point to
+            // which of those entries is the actual one (0-3) or 0xff for not found in result.
+            // Find First on CP/M has a side-effect of flushing data to disk.
+
+            fflush( 0 );
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                tracer.Trace( "  search for first match of '%s'\n", acFilename );
+                CloseFindFirst();
+
+#ifdef _MSC_VER
+                BOOL found = FALSE;
+                WIN32_FIND_DATAA fd = {0};
+                g_hFindFirst = FindFirstFileA( acFilename, &fd );
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    do
+                    {
+                        if ( ValidCPMFilename( fd.cFileName ) && ! IsAFolder( fd.cFileName ) )
+                        {
+                            ParseFoundFile( fd.cFileName );
+                            ACCESS_REG( REG_RESULT ) = 0;
+                            found = TRUE;
+                            break;
+                        }
+                        else
+                        {
+                            found = FindNextFileA( g_hFindFirst, &fd );
+                            if ( !found )
+                                break;
+                        }
+                    } while ( true );
+                }
+                else
+                    tracer.Trace( "WARNING: find first file failed, error %d\n", GetLastError() );
+
+                if ( !found )
+                {
+                    CloseFindFirst();
+                    tracer.Trace( "WARNING: find first file couldn't find a single match\n" );
+                }
+#else //_MSC_VER
+                LINUX_FIND_DATA fd = {0};
+                g_FindFirst = FindFirstFileLinux( acFilename, fd );
+                if ( 0 != g_FindFirst )
+                {
+                    ParseFoundFile( fd.cFileName );
+                    ACCESS_REG( REG_RESULT ) = 0;
+                }
+                else
+                    tracer.Trace( "WARNING: find first file failed, error %d = %s\n", errno, strerror( errno ) );
+#endif //_MSC_VER
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename for search for first\n" );
+            break;
+        }
+        case 18: // search for next.
+        {
+            // Use the FCB and write directory entries to the DMA address, then point to
+            // which of those entries is the actual one (0-3) or 0xff for not found in result.
+
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                tracer.Trace( "  searchinf for next match of '%s'\n", acFilename );
+#ifdef _MSC_VER
+                if ( INVALID_HANDLE_VALUE != g_hFindFirst )
+                {
+                    BOOL found = FALSE;
+
+                    do
+                    {
+                        WIN32_FIND_DATAA fd = {0};
+                        found = FindNextFileA( g_hFindFirst, &fd );
+                        if ( found )
+                        {
+                            if ( ValidCPMFilename( fd.cFileName ) && !IsAFolder( fd.cFileName ) )
+                            {
+                                ParseFoundFile( fd.cFileName );
+                                ACCESS_REG( REG_RESULT ) = 0;
+                                break;
+                            }
+                            else
+                                found = FALSE;
+                        }
+                        else
+                            break;
+                    } while ( true );
+
+                    if ( !found )
+                    {
+                        tracer.Trace( "WARNING: find next file found no more, error %d\n", GetLastError() );
+                        CloseFindFirst();
+                    }
+                }
+                else
+                    tracer.Trace( "ERROR: search for next without a prior successful search for first\n" );
+#else //_MSC_VER
+                if ( 0 != g_FindFirst )
+                {
+                    LINUX_FIND_DATA fd = {0};
+                    bool found = FindNextFileLinux( acFilename, g_FindFirst, fd );
+                    if ( found )
+                    {
+                        ParseFoundFile( fd.cFileName );
+                        ACCESS_REG( REG_RESULT ) = 0;
+                    }
+                    else
+                    {
+                        tracer.Trace( "WARNING: find next file found no more, error %d = %s\n", errno, strerror( errno ) );
+                        CloseFindFirst();
+                    }
+                }
+                else
+                    tracer.Trace( "ERROR: search for next without a prior successful search for first\n" );
+#endif //_MSC_VER
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename for search for first\n" );
+            break;
+        }
+        case 19: // delete file. return 255 if file not found and 0..3 directory code otherwise
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                // if deleting an open file, close it first. CalcStar does this on file save.
+
+                if ( FindFileEntry( acFilename ) )
+                {
+                    FILE * fp = RemoveFileEntry( acFilename );
+                    if ( fp )
+                        fclose( fp );
+                }
+
+                int removeok = ( 0 == unlink( acFilename ) );
+                tracer.Trace( "  attempt to remove file '%s' result ok: %d\n", acFilename, removeok );
+                if ( removeok )
+                    ACCESS_REG( REG_RESULT ) = 0;
+                else
+                    tracer.Trace( "  error %d = %s\n", errno, strerror( errno ) );
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename for delete file\n" );
+            break;
+        }
+        case 20: // read sequential. return 0 on success or non-0 on failure:
+        {
+            // reads 128 bytes from cr of the extent and increments cr.
+            // if cr overflows, the extent is incremented and cr is set to 0 for the next read
+
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                FILE * fp = FindFileEntry( acFilename );
+                if ( fp )
+                {
+                    // apps like Digital Research's linker LK80 update pcb->cr and pfcb->ex between
+                    // calls to sequential read and effectively does random reads using sequential I/O.
+                    // This is illegal (the doc says apps can't touch this data, but that ship has sailed and sunk).
+
+                    uint32_t file_size = portable_filelen( fp );
+                    uint32_t curr = pfcb->GetSequentialOffset();
+                    uint16_t dmaOffset = (uint16_t) ( g_DMA - memory.data() );
+                    tracer.Trace( "  file size: %#x = %u, current %#x = %u, dma %#x = %u\n",
+                                  file_size, file_size, curr, curr, dmaOffset, dmaOffset );
+
+                    if ( curr < file_size )
+                    {
+                        fseek( fp, curr, SEEK_SET );
+
+                        uint32_t to_read = get_min( file_size - curr, (uint32_t) 128 );
+                        memset( g_DMA, 0x1a, 128 ); // fill with ^z, the EOF marker in CP/M
+
+                        size_t numread = fread( g_DMA, 1, to_read, fp );
+                        if ( numread > 0 )
+                        {
+                            tracer.TraceBinaryData( g_DMA, 128, 2 );
+                            ACCESS_REG( REG_RESULT ) = 0;
+                            pfcb->UpdateSequentialOffset( curr + 128 );
+                        }
+                        else
+                        {
+                            ACCESS_REG( REG_RESULT ) = 1;
+                            tracer.Trace( "  read error %d = %s, so returning a = 1\n", errno, strerror( errno ) );
+                        }
+                    }
+                    else
+                    {
+                        ACCESS_REG( REG_RESULT ) = 1;
+                        tracer.Trace( "  at the end of file, so returning a = 1\n" );
+                    }
+                }
+                else
+                    tracer.Trace( "ERROR: can't read from a file that's not open\n" );
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename in read sequential file\n" );
+            break;
+        }
+        case 21: // write sequential. return 0 on success or non-0 on failure (out of disk space)
+        {
+            // reads 128 bytes from cr of the extent and increments cr.
+            // if cr overflows, the extent is incremented and cr is set to 0 for the next read
+
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                FILE * fp = FindFileEntry( acFilename );
+                if ( fp )
+                {
+                    uint32_t file_size = portable_filelen( fp );
+                    uint32_t curr = pfcb->GetSequentialOffset();
+                    uint16_t dmaOffset = (uint16_t) ( g_DMA - memory.data() );
+                    tracer.Trace( "  writing at offset %#x = %u, file size is %#x = %u, dma %#x = %u\n",
+                                  curr, curr, file_size, file_size, dmaOffset, dmaOffset );
+                    fseek( fp, curr, SEEK_SET );
+
+                    tracer.TraceBinaryData( g_DMA, 128, 2 );
+                    size_t numwritten = fwrite( g_DMA, 128, 1, fp );
+                    if ( numwritten > 0 )
+                    {
+                        ACCESS_REG( REG_RESULT ) = 0;
+                        pfcb->UpdateSequentialOffset( curr + 128 );
+                        pfcb->SetRecordCount( fp ); // Whitesmith C v2.1's A80.COM assembler requires this
+                    }
+                    else
+                        tracer.Trace( "ERROR: fwrite returned %zd, errno %d = %s\n", numwritten, errno, strerror( errno ) );
+                }
+                else
+                    tracer.Trace( "ERROR: can't write to a file that's not open\n" );
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename in write sequential file\n" );
+            break;
+        }
+        case 22: // make file. return 255 if out of space or the file exists. 0..3 directory code otherwise.
+        {
+            // "the Make function has the side effect of activating the FCB and thus a subsequent open is not necessary."
+
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                tracer.Trace( "  making file '%s'\n", acFilename );
+                FILE * fp = fopen( acFilename, "w+b" );
+                if ( fp )
+                {
+                    FileEntry fe;
+                    strcpy( fe.acName, acFilename );
+                    fe.fp = fp;
+                    g_fileEntries.push_back( fe );
+
+                    pfcb->cr = 0;
+                    pfcb->rc = 0;
+                    pfcb->ex = 0;
+                    pfcb->s2 = 0;
+
+                    tracer.Trace( "  successfully created fp %p for write\n", fp );
+                    ACCESS_REG( REG_RESULT ) = 0;
+                }
+                else
+                    tracer.Trace( "ERROR: unable to make file\n" );
+            }
+            else
+                tracer.Trace( "ERROR: can't parse filename in make file\n" );
+            break;
+        }
+        case 23: // rename file. 0 for success, non-zero otherwise.
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            char acOldName[ CPM_FILENAME_LEN ];
+            if ( parse_FCB_Filename( pfcb, acOldName ) )
+            {
+                 // if the file is open, close it or the rename will fail.
+
+                 if ( FindFileEntry( acOldName ) )
+                     fclose( RemoveFileEntry( acOldName ) );
+
+                char acNewName[ CPM_FILENAME_LEN ];
+                if ( parse_FCB_Filename( (FCBCPM68K *) ( ( (uint8_t *) pfcb ) + 16 ), acNewName ) )
+                {
+                    tracer.Trace( "  rename from '%s' to '%s'\n", acOldName, acNewName );
+
+                    if ( !rename( acOldName, acNewName ) )
+                        ACCESS_REG( REG_RESULT ) = 0;
+                    else
+                        tracer.Trace( "ERROR: can't rename file, errno %d = %s\n", errno, strerror( errno ) );
+                }
+                else
+                    tracer.Trace( "ERROR: can't parse new filename in rename\n" );
+            }
+            else
+                tracer.Trace( "ERROR: can't parse old filename in rename\n" );
+            break;
+        }
+        case 25: // return current disk
+        {
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 26: // set the dma address (128 byte buffer for doing I/O)
+        {
+            tracer.Trace( "  updating DMA address; D %u = %#x\n", ACCESS_REG( REG_ARG0 ), ACCESS_REG( REG_ARG0 ) );
+            g_DMA = memory.data() + ACCESS_REG( REG_ARG0 );
+            break;
+        }
+        case 29: // get read-only vector: return bitmap of read-only drives
+        {
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 32: // get/set current user
+        {
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 33: // read random
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 6; // seek past end of disk
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                FILE * fp = FindFileEntry( acFilename );
+                if ( !fp )
+                {
+                    // dxforth 4.56 relies on this cp/m 2.2 behavior: open / close / read should work.
+                    tracer.Trace( "  in random read but the file isn't opened. trying to open it now\n" );
+                    fp = fopen( acFilename, "r+b" );
+                    if ( fp )
+                    {
+                        FileEntry fe;
+                        strcpy( fe.acName, acFilename );
+                        fe.fp = fp;
+                        g_fileEntries.push_back( fe );
+                        tracer.Trace( "  file opened successfully for random read\n" );
+                    }
+                    else
+                        tracer.Trace( "  file open failed for random read\n" );
+                }
+                if ( fp )
+                {
+                    uint32_t record = pfcb->GetRandomIOOffset();
+                    tracer.Trace( "  read random record %u == %#x\n", record, record );
+                    uint32_t file_offset = (uint32_t) record * (uint32_t) 128;
+                    memset( g_DMA, 0x1a, 128 ); // fill with ^z, the EOF marker in CP/M
+
+                    uint32_t file_size = portable_filelen( fp );
 
                     // OS workaround for app bug: Turbo Pascal expects a read just past the end of file to succeed.
 
-                    if ( file_size == file_offset )
-                    {
-                        tracer.Trace( "  random read at eof, offset %u\n", file_size );
-                        ACCESS_REG( REG_RESULT ) = 1;
-                        break;
-                    }
+                    if ( file_size == file_offset )
+                    {
+                        tracer.Trace( "  random read at eof, offset %u\n", file_size );
+                        ACCESS_REG( REG_RESULT ) = 1;
+                        break;
+                    }
+
+                    if ( file_size > file_offset )
+                    {
+                        uint32_t to_read = get_min( file_size - file_offset, (uint32_t) 128 );
+                        ok = !fseek( fp, file_offset, SEEK_SET );
+                        if ( ok )
+                        {
+                            tracer.Trace( "  reading random at offset %u == %#x. file size %u, to read %u\n", file_offset, file_offset, file_size, to_read );
+                            size_t numread = fread( g_DMA, 1, to_read, fp );
+                            if ( numread )
+                            {
+                                tracer.TraceBinaryData( g_DMA, to_read, 2 );
+                                ACCESS_REG( REG_RESULT ) = 0;
+
+                                // The CP/M spec says random read should set the file offset such
+                                // that the following sequential I/O will be from the SAME location
+                                // as this random read -- not 128 bytes beyond.
+
+                                pfcb->UpdateSequentialOffset( file_offset );
+                            }
+                            else
+                                tracer.Trace( "ERROR: can't read in read random\n" );
+                        }
+                        else
+                            tracer.Trace( "ERROR: can't seek in read random\n" );
+                    }
+                    else
+                    {
+                        ACCESS_REG( REG_RESULT ) = 1;
+                        tracer.Trace( "ERROR: read random read at %u beyond end of file size %u\n", file_offset, file_size );
+                    }
+                }
+                else
+                    tracer.Trace( "ERROR: read random on unopened file\n" );
+            }
+            else
+                tracer.Trace( "ERROR: read random can't parse filename\n" );
+            break;
+        }
+        case 34: // write random
+        {
+            WriteRandom( cpu );
+            break;
+        }
+        case 35: // Compute file size. A = 0 if ok, 0xff on failure. Sets r0/r1/2 to the number of 128 byte records
+        {
+            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            pfcb->Trace();
+            ACCESS_REG( REG_RESULT ) = 255;
+            bool ok = parse_FCB_Filename( pfcb, acFilename );
+            if ( ok )
+            {
+                FILE * fp = FindFileEntry( acFilename );
+                bool found = false;
+                if ( fp )
+                    found = true;
+                else
+                    fp = fopen( acFilename, "r+b" );
+
+                if ( fp )
+                {
+                    uint32_t file_size = portable_filelen( fp );
+                    file_size = round_up( file_size, (uint32_t) 128 ); // cp/m files round up in 128 byte records
+                    pfcb->SetRandomIOOffset( file_size / 128 );
+                    ACCESS_REG( REG_RESULT ) = 0;
+                    tracer.Trace( "  file size is %u == %u records; r2 %#x r1 %#x r0 %#x\n", file_size, file_size / 128, pfcb->r2, pfcb->r1, pfcb->r0 );
+
+                    if ( !found )
+                        fclose( fp );
+                }
+                else
+                    tracer.Trace( "ERROR: compute file size can't find file '%s'\n", acFilename );
+            }
+            else
+                tracer.Trace( "ERROR: compute file size can't parse filename\n" );
+            break;
+        }
+        case 40:
+        {
+            // write random with zero fill.
+            // Just like 34 / write random except also fills any file-extending blocks with 0.
+            // The 34 implementation of WriteRandom already fills with zeros, so just use that.
+            // I haven't found any apps that call this, so I can't say it's really tested.
+
+            WriteRandom( cpu );
+            break;
+        }
+        case 45: // called by BASIC/Z
+        {
+            // non - CP/M 2.2: set action on hardware error
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 47: // chain to program
+        {
+            tracer.Trace( "chain to len %u command '%s'\n", * g_DMA, g_DMA + 1 );
+            char * pcmdline = (char *) ( g_DMA + 1 );
+            char * ptail = strchr( pcmdline, ' ' );
+            if ( ptail )
+            {
+                *ptail = 0;
+                ptail++;
+            }
+            else
+                ptail = pcmdline + strlen( pcmdline );
+
+            char acApp[ CPM_FILENAME_LEN ];
+            strcpy( acApp, pcmdline );
+            char acAppArgs[ 128 ];
+            strcpy( acAppArgs, ptail );
+
+            if ( load_cpm68k( acApp, acAppArgs ) )
+            {
+                tracer.Trace( "loaded chained app successfully\n" );
+                cpu.reset( memory, g_base_address, g_execution_address, g_stack_commit, g_top_of_stack );
+            }
+            else
+            {
+                ACCESS_REG( REG_RESULT ) = 0xff;
+                tracer.Trace( "unable to load chained app\n" );
+            }
+            break;
+        }
+        case 48: // flush buffers
+        {
+            fflush( 0 );
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 59: // program load (used by ddt). returns 0 = success, 1 = insufficient RAM, 2 = read error, 3 = bad relocation bits
+        {
+            LoadParameterBlockCPM * plpb = (LoadParameterBlockCPM *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            plpb->swap_endianness();
+            plpb->trace();
+            ACCESS_REG( REG_RESULT ) = 1;
+
+            bool ok = parse_FCB_Filename( (FCBCPM68K *) cpu.getmem( plpb->fcbOfChildApp ), acFilename );
+            if ( ok )
+            {
+                tracer.Trace( "  program to load: '%s'\n", acFilename );
+                FILE * fp = FindFileEntry( acFilename );
+                if ( fp )
+                {
+                    uint32_t basePage = 0;
+                    uint32_t stackPointer = 0;
+                    if ( load59_cpm68k( fp, plpb->lowestAddress, plpb->highestAddress, plpb->loaderControlFlags, basePage, stackPointer ) )
+                    {
+                        plpb->childBasePage = basePage;
+                        plpb->childStackPointer = stackPointer;
+                        plpb->trace();
+                        plpb->swap_endianness();
+                        cpu.relax_pc_sp_constraints();
+                        ACCESS_REG( REG_RESULT ) = 0;
+                    }
+                    else
+                        tracer.Trace( "ERROR: program load failed to actually load the app\n" );
+                }
+                else
+                    tracer.Trace( "ERROR: program load can't find file in list of open files\n" );
+            }
+            else
+                tracer.Trace( "ERROR: program load can't parse filename\n" );
+            break;
+        }
+        case 61: // set exception vector. returns 0 on success, 0xff on failure
+        {
+            ExceptionParameterBlockCPM * pepb = (ExceptionParameterBlockCPM *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            tracer.TraceBinaryData( (uint8_t *) pepb, 10, 8 );
+            pepb->swap_endianness();
+            pepb->trace();
+
+            if ( pepb->vector >= 64 )
+            {
+                tracer.Trace( "ERROR: invalid vector number %u\n", pepb->vector );
+                ACCESS_REG( REG_RESULT ) = 0xff;
+                break;
+            }
+
+            pepb->oldValue = cpu.getui32( pepb->vector * 4 );
+            cpu.setui32( pepb->vector * 4, pepb->newValue );
+            pepb->trace();
+            pepb->swap_endianness();
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 62: // set supervisor state.
+        {
+            cpu.set_supervisor_state();
+            ACCESS_REG( REG_RESULT ) = 0;
+            break;
+        }
+        case 102:
+        {
+            // Get file date and time (not in cp/m 2.2)
+            break;
+        }
+        case 105: // get date time. cp/m 3.0 and later. Returns seconds in A as packed bcd
+        case 155: // Get date and time. MP/M, Concurrent CP/M. called by rmcobol v1.5
+        {
+            CPM3DateTime * ptime = (CPM3DateTime *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
+            system_clock::time_point now = system_clock::now();
+            time_t time_now = system_clock::to_time_t( now );
+            struct tm * plocal = localtime( & time_now );
+
+            ptime->day = 1 + days_since_jan1_1978();
+            ptime->hour = packBCD( (uint8_t) plocal->tm_hour );
+            ptime->minute = packBCD( (uint8_t) plocal->tm_min );
+            ACCESS_REG( REG_RESULT ) = packBCD( (uint8_t) plocal->tm_sec );
+
+            if ( 155 == function )
+                ptime->second = (uint8_t) ACCESS_REG( REG_RESULT );
+
+#ifdef TARGET_BIG_ENDIAN
+            ptime->swap_endian();
+#endif
+            break;
+        }
+        case 108: // bdos get put program return code
+        {
+            // This is not a CP/M v2.2 function. It is in CP/M v3 and it's so handy that it's here too. called by DR PLI v1.4.
+            // if DE = 0xffff then return current code in HL (mapped to 68k registers)
+            // otherwise, set the current code to the value in DE (mapped to 68k registers)
+
+            if ( 0xffff == ACCESS_REG( REG_ARG0 ) )
+                ACCESS_REG( REG_RESULT ) = g_exit_code;
+            else
+            {
+                g_exit_code = ACCESS_REG( REG_ARG0 ) >> 16;
+                tracer.Trace( "  app exit code set to %u\n", g_exit_code );
+            }
+            break;
+        }
+        default:
+        {
+            printf( "  unhandled cp/m bdos call %u\n", function );
+            tracer.Trace( "  unhandled cp/m bdos call %u\n", function );
+            break;
+        }
+    }
+} //emulator_invoke_68k_trap2
+
+#endif // M68
+
+static REG_TYPE arg_data_commit()
+{
+    return g_arg_data_commit + round_up( (REG_TYPE) g_environment.size(), (REG_TYPE) 16 );
+} //arg_data_commit
+
+// copy g_environment strings after the OS= and optional TZ= strings at penv_data and return their vm addresses
+
+static void copy_environment( char * penv_data, vector<REG_TYPE> & addresses )
+{
+    char * pnext = penv_data + 1 + strlen( penv_data );
+    if ( '\0' != *pnext ) // TZ= follows OS= on Windows
+        pnext += 1 + strlen( pnext );
+
+    for ( const char * penv = g_environment.data(); penv < g_environment.data() + g_environment.size(); penv += 1 + strlen( penv ) )
+    {
+        strcpy( pnext, penv );
+        addresses.push_back( (REG_TYPE) ( pnext - (char *) memory.data() ) + g_base_address );
+        pnext += 1 + strlen( pnext );
+    }
+} //copy_environment
+
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+
+static bool load_image32( FILE * fp, const char * pimage, const char * app_args )
+{
+    ElfHeader32 ehead = {0};
+    fseek( fp, (long) 0, SEEK_SET );
+    size_t read = fread( &ehead, 1, sizeof ehead, fp );
+
+    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+        usage( "elf image file's magic header is invalid" );
+
+    bool big_endian = ( 2 == ehead.endianness );
+    tracer.Trace( "image is %s endian\n", big_endian ? "big" : "little" );
+    if ( big_endian == CPU_IS_LITTLE_ENDIAN )
+        usage( "elf image endianness isn't consistent with emulator expectations" );
+
+    ehead.swap_endianness();
+
+    if ( 2 != ehead.type )
+    {
+        printf( "e_type is %d == %s\n", ehead.type, image_type( ehead.type ) );
+        usage( "elf image isn't an executable file (2 expected)" );
+    }
+
+    if ( ELF_MACHINE_ISA != ehead.machine )
+    {
+        printf( "machine found: %#x\n", ehead.machine );
+        usage( "elf image machine ISA doesn't match this emulator" );
+    }
+
+    if ( 0 == ehead.entry_point )
+        usage( "elf entry point is 0, which is invalid" );
+
+    tracer.Trace( "header fields:\n" );
+    tracer.Trace( "  entry address: %x\n", ehead.entry_point );
+    tracer.Trace( "  program entries: %u\n", ehead.program_header_table_entries );
+    tracer.Trace( "  program header entry size: %u\n", ehead.program_header_table_size );
+    tracer.Trace( "  program offset: %u == %x\n", ehead.program_header_table, ehead.program_header_table );
+    tracer.Trace( "  section entries: %u\n", ehead.section_header_table_entries );
+    tracer.Trace( "  section header entry size: %u\n", ehead.section_header_table_size );
+    tracer.Trace( "  section offset: %u == %x\n", ehead.section_header_table, ehead.section_header_table );
+    tracer.Trace( "  section with section names: %u == %x\n", ehead.section_with_section_names, ehead.section_with_section_names );
+    tracer.Trace( "  flags: %x\n", ehead.flags );
+    g_execution_address = ehead.entry_point;
+
+    // determine how much RAM to allocate
+
+    REG_TYPE memory_size = 0;
+
+    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+    {
+        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
+        tracer.Trace( "program header %u at offset %u\n", ph, (unsigned int) o );
+
+        ElfProgramHeader32 head = {0};
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), 1, fp );
+        if ( 1 != read )
+            usage( "can't read program header" );
+
+        head.swap_endianness();
+
+        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
+        tracer.Trace( "  offset in image: %x\n", head.offset_in_image );
+        tracer.Trace( "  virtual address: %x\n", head.virtual_address );
+        tracer.Trace( "  physical address: %x\n", head.physical_address );
+        tracer.Trace( "  file size: %x\n", head.file_size );
+        tracer.Trace( "  memory size: %x\n", head.memory_size );
+        tracer.Trace( "  alignment: %x\n", head.alignment );
+
+        if ( 2 == head.type )
+        {
+#ifdef X64OS_LIBRARY
+            usage( "dynamic linking is not supported by this emulator. link your app with -static" );
+#endif
+            printf( "dynamic linking is not supported by this emulator. link your app with -static\n" );
+            exit( 1 );
+        }
+
+        REG_TYPE just_past = head.physical_address + head.memory_size;
+        if ( just_past > memory_size )
+            memory_size = just_past;
+
+        if ( ( 0 != head.physical_address ) && ( ( 0 == g_base_address ) || g_base_address > head.physical_address ) )
+            g_base_address = head.physical_address;
+    }
+
+    // if it won't waste much RAM, start the address space at 0 so low addresses can be used for things like trap vectors
+
+    REG_TYPE elf_base_address = g_base_address;
+
+    if ( g_base_address < 0x20000 ) // sparc v8 binaries load by default at 0x10000 using stock tools
+        g_base_address = 0;
+
+    memory_size -= g_base_address;
+    tracer.Trace( "memory_size of content to load from elf file: %x\n", memory_size );
+
+    // first load the string table(s)
+    vector<char> section_names_string_table;
+
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    {
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        ElfSectionHeader32 head = {0};
+
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
+
+        head.swap_endianness();
+        if ( 3 == head.type )
+        {
+            if ( sh == ehead.section_with_section_names )
+            {
+                section_names_string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( section_names_string_table.data(), head.size, 1, fp );
+                if ( 1 != read )
+                    usage( "can't read string table\n" );
+
+                tracer.Trace( "section names string table:\n" );
+                tracer.TraceBinaryData( (uint8_t *) section_names_string_table.data(), (uint32_t) head.size, 4 );
+            }
+            else
+            {
+                g_string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( g_string_table.data(), head.size, 1, fp );
+                if ( 1 != read )
+                    usage( "can't read string table\n" );
+
+                tracer.Trace( "main string table:\n" );
+                tracer.TraceBinaryData( (uint8_t *) g_string_table.data(), (uint32_t) head.size, 4 );
+            }
+        }
+    }
+
+    uint32_t the_EH_FRAME_BEGIN = 0; // for C++ programs, the pointer to the argument for __register_frame() at app startup
+
+    // load the symbol data into RAM and look for .eh_frame
+
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    {
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        tracer.Trace( "section header %u at offset %u == %x\n", sh, o, o );
+
+        ElfSectionHeader32 head = {0};
+
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
+
+        head.swap_endianness();
+
+        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
+        tracer.Trace( "  name %s, offset: %x\n", & section_names_string_table[ head.name_offset ], head.name_offset );
+        tracer.Trace( "  flags: %x / %s\n", head.flags, head.show_flags() );
+        tracer.Trace( "  address: %x\n", head.address );
+        tracer.Trace( "  offset: %x\n", head.offset );
+        tracer.Trace( "  size: %x\n", head.size );
+        tracer.Trace( "  link: %x\n", head.link );
+        tracer.Trace( "  info: %x\n", head.info );
+        tracer.Trace( "  address_alignment: %x\n", head.address_alignment );
+        tracer.Trace( "  entry_size: %x\n", head.entry_size );
+
+        if ( !strcmp( ".tbss", & section_names_string_table[ head.name_offset ] ) )
+            tracer.Trace( "tbss: %#x, size %#x\n", head.address, head.size );
+
+        g_dwarf.add_section( & section_names_string_table[ head.name_offset ], head.offset, head.size );
+
+        if ( !strcmp( ".eh_frame", & section_names_string_table[ head.name_offset ] ) )
+            the_EH_FRAME_BEGIN = head.address;
+
+        if ( 2 == head.type )
+        {
+            g_symbols32.resize( head.size / sizeof( ElfSymbol32 ) );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( g_symbols32.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read symbol table" );
+        }
+    }
+
+    // void out the entries that don't have symbol names or have mangled names that start with $
+
+    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+    {
+        g_symbols32[se].swap_endianness();
+
+        if ( ( 0 == g_symbols32[se].name ) || ( '$' == g_string_table[ g_symbols32[se].name ] ) )
+            g_symbols32[se].value = 0;
+    }
+
+    // use known my_qsort so traces are consistent across platforms because qsort implementations for duplicate values differ
+
+    tracer.Trace( "sorting symbol entries\n" );
+    my_qsort( g_symbols32.data(), g_symbols32.size(), sizeof( ElfSymbol32 ), symbol_compare32 );
+
+    // remove symbols that don't look like they have a valid addresses (rust binaries have tens of thousands of these)
+
+    size_t to_erase = 0;
+    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+    {
+        if ( g_symbols32[ se ].value < elf_base_address )
+            to_erase++;
+        else
+            break;
+    }
+
+    if ( to_erase > 0 )
+        g_symbols32.erase( g_symbols32.begin(), g_symbols32.begin() + to_erase );
+
+    // set the size of each symbol if it's not already set
+
+    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+    {
+        if ( 0 == g_symbols32[se].size )
+        {
+            if ( se < ( g_symbols32.size() - 1 ) )
+                g_symbols32[se].size = g_symbols32[ se + 1 ].value - g_symbols32[ se ].value;
+            else
+                g_symbols32[se].size = g_base_address + memory_size - g_symbols32[ se ].value;
+        }
+    }
+
+    tracer.Trace( "elf image has %u usable symbols:\n", (unsigned) g_symbols32.size() );
+    tracer.Trace( "     address      size  name\n" );
+
+    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+        tracer.Trace( "    %8x  %8x  %s\n", g_symbols32[ se ].value, g_symbols32[ se ].size, & g_string_table[ g_symbols32[ se ].name ] );
+
+    // memory map from high to low addresses:
+    //     <end of allocated memory>
+    //     (memory for mmap fulfillment)
+    //     g_mmap_offset
+    //     (wasted space so g_mmap_offset is 4k-aligned)
+    //     arg_data_offset -- actual arg and env, etc. values pointed to by Linux start data
+    //     Linux start data on the stack (see details below)
+    //     g_top_of_stack
+    //     g_bottom_of_stack
+    //     (unallocated space between brk and the bottom of the stack)
+    //     g_brk_offset with uninitialized RAM (just after arg_data_offset initially)
+    //     g_end_of_data
+    //     uninitalized data bss (size read from the .elf file)
+    //     initialized data (size & data read from the .elf file)
+    //     code (read from the .elf file)
+    //     g_base_address (offset read from the .elf file).
+
+    if ( memory_size & 0xf )
+    {
+        memory_size += 16;
+        memory_size &= ~0xf;
+    }
+
+    g_end_of_data = memory_size;
+    g_brk_offset = memory_size;
+    g_highwater_brk = memory_size;
+    memory_size += g_brk_commit;
+
+    g_bottom_of_stack = memory_size;
+    memory_size += g_stack_commit;
+    REG_TYPE top_of_aux = memory_size;
+
+    REG_TYPE arg_data_offset = memory_size;
+    memory_size += arg_data_commit();
+
+    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
+    g_mmap_offset = memory_size;
+    memory_size += g_mmap_commit;
+
+    memory.resize( memory_size );
+    memset( memory.data(), 0, memory_size );
+
+    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
+
+    // load the program into RAM
+
+    REG_TYPE first_uninitialized_data = 0;
+
+    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+    {
+        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
+        ElfProgramHeader32 head = {0};
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
+        head.swap_endianness();
+
+        // head.type 1 == load. Other entries will overlap and even have physical addresses, but they are redundant
+
+        if ( 0 != head.file_size && 1 == head.type )
+        {
+            fseek( fp, (long) head.offset_in_image, SEEK_SET );
+            read = fread( memory.data() + head.physical_address - g_base_address, 1, head.file_size, fp );
+            if ( 0 == read )
+                usage( "can't read image" );
+
+            first_uninitialized_data = get_max( head.physical_address + head.file_size, first_uninitialized_data );
+
+            if ( head.flags & 1 ) // PF_X
+            {
+                if ( ( 0 == g_code_end ) || ( head.physical_address < g_code_start ) )
+                    g_code_start = head.physical_address;
+                g_code_end = get_max( g_code_end, (REG_TYPE) ( head.physical_address + head.file_size ) );
+            }
+
+            tracer.Trace( "  read type %s: %x bytes into physical address %x - %x then uninitialized to %x \n", head.show_type(), head.file_size,
+                          head.physical_address, head.physical_address + head.file_size - 1, head.physical_address + head.memory_size - 1 );
+            tracer.TraceBinaryData( memory.data() + head.physical_address - g_base_address, get_min( (uint32_t) head.file_size, (uint32_t) 128 ), 4 );
+        }
+    }
+
+    // if the base address is 0 we need a supervisor stack configured at address 0.
+
+    if ( 0 == g_base_address )
+        * (uint32_t *) memory.data() = swap_endian32( elf_base_address ); // arbitrary, but probably safe here between the vector table and app
+
+    // write the command-line arguments into the vm memory in a place where _start can find them.
+    // there's an array of pointers to the args followed by the arg strings at offset arg_data_offset.
+
+    const uint32_t max_args = 40;
+    REG_TYPE aargs[ max_args ]; // vm pointers to each arguments
+    char * buffer_args = (char *) ( memory.data() + arg_data_offset );
+    size_t image_len = strlen( pimage );
+    vector<char> full_command( 2 + image_len + strlen( app_args ) );
+    strcpy( full_command.data(), pimage );
+    backslash_to_slash( full_command.data() );
+    full_command[ image_len ] = ' ';
+    strcpy( full_command.data() + image_len + 1, app_args );
+    strcpy( buffer_args, full_command.data() );
+    char * pargs = buffer_args;
+    REG_TYPE args_len = (REG_TYPE) strlen( buffer_args );
+
+    REG_TYPE app_argc = 0;
+    while ( *pargs && app_argc < max_args )
+    {
+        while ( ' ' == *pargs )
+            pargs++;
+
+        char * space = strchr( pargs, ' ' );
+        if ( space )
+            *space = 0;
+
+        REG_TYPE offset = (REG_TYPE) ( pargs - buffer_args );
+        tracer.Trace( "offset %x\n", offset );
+        aargs[ app_argc ] = swap_endian32( offset + g_base_address + arg_data_offset );
+        tracer.Trace( "  argument %d is '%s', at vm address %llx\n", app_argc, pargs, (uint64_t) offset + g_base_address + arg_data_offset );
+
+        app_argc++;
+        pargs += strlen( pargs );
+
+        if ( space )
+            pargs++;
+    }
+
+    REG_TYPE env_offset = args_len + 1;
+    tracer.Trace( "env_offset: %x\n", env_offset );
+    char * penv_data = (char *) ( buffer_args + env_offset );
+    strcpy( penv_data, "OS=" );
+    strcat( penv_data, APP_NAME );
+    REG_TYPE env_os_address = (REG_TYPE) ( penv_data - (char *) memory.data() ) + g_base_address;
+    tracer.Trace( "env_os_address %x\n", env_os_address );
+    REG_TYPE env_count = 1;
+    REG_TYPE env_tz_address = 0;
+
+    // The local time zone is found by libc on Linux/MacOS, but not on Windows.
+    // Workaround: set the TZ environment variable.
+
+#ifdef _WIN32
+    DYNAMIC_TIME_ZONE_INFORMATION tzi = {0};
+    DWORD dw = GetDynamicTimeZoneInformation( &tzi );
+    if ( TIME_ZONE_ID_INVALID != dw )
+    {
+        char acName[ 32 ] = {0};
+        if ( TIME_ZONE_ID_STANDARD == dw )
+            wcstombs( acName, tzi.StandardName, sizeof( acName ) );
+        else if ( TIME_ZONE_ID_DAYLIGHT == dw )
+            wcstombs( acName, tzi.DaylightName, sizeof( acName ) );
+        else if ( TIME_ZONE_ID_UNKNOWN == dw )
+            strcpy( acName, "local" );
+
+        if ( 0 != acName[ 0 ] )
+        {
+            char * ptz_data = penv_data + 1 + strlen( penv_data );
+            env_tz_address = (REG_TYPE) ( ptz_data - (char *) memory.data() ) + g_base_address;
+            tracer.Trace( "env_tz_address %x\n", env_tz_address );
+            strcpy( ptz_data, "TZ=" );
 
-                    if ( file_size > file_offset )
-                    {
-                        uint32_t to_read = get_min( file_size - file_offset, (uint32_t) 128 );
-                        ok = !fseek( fp, file_offset, SEEK_SET );
-                        if ( ok )
-                        {
-                            tracer.Trace( "  reading random at offset %u == %#x. file size %u, to read %u\n", file_offset, file_offset, file_size, to_read );
-                            size_t numread = fread( g_DMA, 1, to_read, fp );
-                            if ( numread )
-                            {
-                                tracer.TraceBinaryData( g_DMA, to_read, 2 );
-                                ACCESS_REG( REG_RESULT ) = 0;
+            // libc doesn't like spaces in spite of the doc saying it's OK:
+            // https://ftp.gnu.org/old-gnu/Manuals/glibc-2.2.3/html_node/libc_431.html
 
-                                // The CP/M spec says random read should set the file offset such
-                                // that the following sequential I/O will be from the SAME location
-                                // as this random read -- not 128 bytes beyond.
+            remove_spaces( acName );
+            strcat( (char *) ptz_data, acName );
 
-                                pfcb->UpdateSequentialOffset( file_offset );
-                            }
-                            else
-                                tracer.Trace( "ERROR: can't read in read random\n" );
-                        }
-                        else
-                            tracer.Trace( "ERROR: can't seek in read random\n" );
-                    }
-                    else
-                    {
-                        ACCESS_REG( REG_RESULT ) = 1;
-                        tracer.Trace( "ERROR: read random read at %u beyond end of file size %u\n", file_offset, file_size );
-                    }
-                }
-                else
-                    tracer.Trace( "ERROR: read random on unopened file\n" );
+            if ( tzi.Bias >= 0 )
+                strcat( (char *) ptz_data, "+" );
+            itoa( tzi.Bias / 60, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
+            int minutes = abs( tzi.Bias % 60 );
+            if ( 0 != minutes )
+            {
+                strcat( ptz_data, ":" );
+                itoa( minutes, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
             }
-            else
-                tracer.Trace( "ERROR: read random can't parse filename\n" );
-            break;
-        }
-        case 34: // write random
-        {
-            WriteRandom( cpu );
-            break;
+            tracer.Trace( "ptz_data: '%s'\n", ptz_data );
+            env_count++;
         }
-        case 35: // Compute file size. A = 0 if ok, 0xff on failure. Sets r0/r1/2 to the number of 128 byte records
-        {
-            FCBCPM68K * pfcb = (FCBCPM68K *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            pfcb->Trace();
-            ACCESS_REG( REG_RESULT ) = 255;
-            bool ok = parse_FCB_Filename( pfcb, acFilename );
-            if ( ok )
-            {
-                FILE * fp = FindFileEntry( acFilename );
-                bool found = false;
-                if ( fp )
-                    found = true;
-                else
-                    fp = fopen( acFilename, "r+b" );
+    }
+#endif
 
-                if ( fp )
-                {
-                    uint32_t file_size = portable_filelen( fp );
-                    file_size = round_up( file_size, (uint32_t) 128 ); // cp/m files round up in 128 byte records
-                    pfcb->SetRandomIOOffset( file_size / 128 );
-                    ACCESS_REG( REG_RESULT ) = 0;
-                    tracer.Trace( "  file size is %u == %u records; r2 %#x r1 %#x r0 %#x\n", file_size, file_size / 128, pfcb->r2, pfcb->r1, pfcb->r0 );
+    vector<REG_TYPE> env_extra_addresses;
+    copy_environment( penv_data, env_extra_addresses );
+    env_count += (REG_TYPE) env_extra_addresses.size();
 
-                    if ( !found )
-                        fclose( fp );
-                }
-                else
-                    tracer.Trace( "ERROR: compute file size can't find file '%s'\n", acFilename );
-            }
-            else
-                tracer.Trace( "ERROR: compute file size can't parse filename\n" );
-            break;
-        }
-        case 40:
-        {
-            // write random with zero fill.
-            // Just like 34 / write random except also fills any file-extending blocks with 0.
-            // The 34 implementation of WriteRandom already fills with zeros, so just use that.
-            // I haven't found any apps that call this, so I can't say it's really tested.
+    tracer.Trace( "args_len %d, penv_data %p\n", args_len, penv_data );
+    tracer.TraceBinaryData( (uint8_t *) ( memory.data() + arg_data_offset ), g_arg_data_commit + 0x20, 4 ); // +20 to inspect for bugs
+
+    // put the Linux startup info at the top of the stack. this consists of (from high to low):
+    //   two 8-byte random numbers used for stack and pointer guards
+    //   optional filler to make sure alignment of all startup info is 16 bytes
+    //   AT_NULL aux record
+    //   AT_RANDOM aux record -- point to the 2 random 8-byte numbers above
+    //   AT_PAGESZ aux record -- golang runtime fails if it can't find the page size here
+    //   0 environment termination
+    //   0..n environment string pointers
+    //   0 argv termination
+    //   1..n argv string pointers
+    //   argc  <<<==== sp should point here when the entrypoint (likely _start) is invoked
+
+    tracer.Trace( "top of aux: %x\n", top_of_aux );
+    REG_TYPE * pstack = (REG_TYPE *) ( memory.data() + top_of_aux );
+
+    pstack--;
+    *pstack = (REG_TYPE) rand64();
+    pstack--;
+    *pstack = (REG_TYPE) rand64();
+    REG_TYPE prandom = g_base_address + memory_size - ( 2 * sizeof( REG_TYPE ) );
+
+    // ensure that after all of this the stack is 16-byte aligned
+
+    if ( 0 == ( 1 & ( app_argc + env_count ) ) )
+        pstack--;
+
+    pstack -= ( 10 * sizeof( AuxProcessStart32 ) ); // for 10 aux records
+    REG_TYPE aux_data_offset = (REG_TYPE) ( (uint8_t *) pstack - memory.data() );
+    AuxProcessStart32 * paux = (AuxProcessStart32 *) pstack;
+    paux[0].a_type = 25; // AT_RANDOM
+    paux[0].a_un.a_val = prandom;
+    paux[0].swap_endianness();
+    paux[1].a_type = 6; // AT_PAGESZ
+    paux[1].a_un.a_val = 4096;
+    paux[1].swap_endianness();
+    paux[2].a_type = 16; // AT_HWCAP
+    paux[2].a_un.a_val = 0xa01; // ARM64 bits for fp(0), atomics(8), cpuid(11)
+    paux[2].swap_endianness();
+    paux[3].a_type = 26; // AT_HWCAP2
+    paux[3].a_un.a_val = 0;
+    paux[3].swap_endianness();
+    paux[4].a_type = 11; // AT_UID
+    paux[4].a_un.a_val = 0x595a5449; // "ITZY" they are each my bias.
+    paux[4].swap_endianness();
+    paux[5].a_type = 22; // AT_EUID;
+    paux[5].a_un.a_val = 0x595a5449;
+    paux[5].swap_endianness();
+    paux[6].a_type = 13; // AT_GID
+    paux[6].a_un.a_val = 0x595a5449;
+    paux[6].swap_endianness();
+    paux[7].a_type = 14; // AT_EGID
+    paux[7].a_un.a_val = 0x595a5449;
+    paux[7].swap_endianness();
+#ifdef M68 // only needed for M68 because it uses newlib. In fact, on Sparc the C runtime infinte loops when it sees a value as large as AT_EH_FRAME_BEGIN
+    paux[8].a_type = AT_EH_FRAME_BEGIN;
+    paux[8].a_un.a_val = the_EH_FRAME_BEGIN;
+    paux[8].swap_endianness();
+#endif
+    paux[9].a_type = 0;  // 0 to signify the end of the list of AT aux records
+    paux[9].a_un.a_val = 0;
+
+    pstack--; // end of environment data is 0
+    pstack--; // move to where the OS environment variable is set OS=RVOS or OS=ARMOS
+
+    for ( size_t e = env_extra_addresses.size(); e > 0; e-- )
+    {
+        *pstack = swap_endian32( env_extra_addresses[ e - 1 ] );
+        pstack--;
+    }
+
+    if ( 0 != env_tz_address )
+    {
+        *pstack = swap_endian32( env_tz_address );
+        tracer.Trace( "the TZ environment argument is at VM address %lx (orig %lx)\n", swap_endian32( *pstack ), env_tz_address );
+        pstack--;
+    }
+
+    // point to the OS= environment variable location
+    *pstack = swap_endian32( env_os_address ); // (REG_TYPE) ( env_offset + arg_data_offset + g_base_address + max_args * sizeof( REG_TYPE ) );
+    tracer.Trace( "the OS environment argument is at VM address %lx\n", swap_endian32( *pstack ) );
+
+    pstack--; // the last argv is 0 to indicate the end
+
+    for ( int iarg = (int) app_argc - 1; iarg >= 0; iarg-- )
+    {
+        pstack--;
+        *pstack = aargs[ iarg ];
+    }
+
+    REG_TYPE first_argv_at = (REG_TYPE) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
+    tracer.Trace( "first argv value (app name) is at %lx\n", first_argv_at );
+    pstack--;
+    *pstack = swap_endian32( app_argc );
+
+    g_top_of_stack = (REG_TYPE) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
+#ifdef SPARCOS
+    // linux on sparc v8 reserves one register frame of space between argc and the actual top of the stack for the trap handler
+    g_top_of_stack -= 64;
+#endif
+
+    REG_TYPE aux_data_size = top_of_aux - (REG_TYPE) ( (uint8_t *) pstack - memory.data() );
+    tracer.Trace( "stack at start (beginning with argc) -- %u bytes at address %p:\n", aux_data_size, pstack );
+    tracer.TraceBinaryData( (uint8_t *) pstack, (uint32_t) aux_data_size, 2 );
+
+    tracer.Trace( "memory map from highest to lowest addresses:\n" );
+    tracer.Trace( "  first byte beyond allocated memory:                 %lx\n", g_base_address + memory_size );
+    tracer.Trace( "  <mmap arena>                                        (%ld = %lx bytes)\n", g_mmap_commit, g_mmap_commit );
+    tracer.Trace( "  mmap start adddress:                                %lx\n", g_base_address + g_mmap_offset );
+    tracer.Trace( "  <filler to align to 4k-page for mmap allocations>\n" );
+
+    tracer.Trace( "  <argv data, pointed to by argv array below>         (%ld == %lx bytes)\n", g_arg_data_commit, g_arg_data_commit );
+    tracer.Trace( "  start of argv data:                                 %lx\n", g_base_address + arg_data_offset );
+
+    tracer.Trace( "  start of aux data:                                  %lx\n", g_base_address + aux_data_offset );
+    tracer.Trace( "  <random, alignment, aux recs, env, argv>            (%ld == %lx bytes)\n", aux_data_size, aux_data_size );
+    tracer.Trace( "  initial stack pointer g_top_of_stack:               %lx\n", g_top_of_stack );
+    REG_TYPE stack_bytes = g_stack_commit - aux_data_size;
+    tracer.Trace( "  <stack>                                             (%ld == %lx bytes)\n", stack_bytes, stack_bytes );
+    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %lx\n", g_base_address + g_bottom_of_stack );
+    tracer.Trace( "  <unallocated space between brk and the stack>       (%ld == %lx bytes)\n", g_brk_commit, g_brk_commit );
+    tracer.Trace( "  end_of_data / current brk:                          %lx\n", g_base_address + g_end_of_data );
+    REG_TYPE uninitialized_bytes = g_end_of_data - first_uninitialized_data;
+    tracer.Trace( "  <uninitialized data per the .elf file>              (%ld == %lx bytes)\n", uninitialized_bytes, uninitialized_bytes );
+    tracer.Trace( "  first byte of uninitialized data:                   %lx\n", first_uninitialized_data );
+    tracer.Trace( "  <initialized data from the .elf file>\n" );
+    tracer.Trace( "  <code from the .elf file>\n" );
+    tracer.Trace( "  initial pc execution_addess:                        %lx\n", g_execution_address );
+    tracer.Trace( "  <code per the .elf file>\n" );
+    tracer.Trace( "  start of the address space per the .elf file:       %lx\n", elf_base_address );
+    tracer.Trace( "  start of the address space actual:                  %lx\n", g_base_address );
+
+    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
+    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
+    tracer.Trace( "memory_size:                     %lx == %ld\n", memory_size, memory_size );
+
+    return true;
+} //load_image32
+
+#ifdef M68
+
+static bool load_68000_hex( const char * pimage )
+{
+    assert ( 4 == ELF_MACHINE_ISA );
+    FILE * fp = fopen( pimage, "rb" );
+    if ( !fp )
+    {
+        printf( "can't open 68000 hex image file: %s\n", pimage );
+        usage();
+    }
 
-            WriteRandom( cpu );
-            break;
-        }
-        case 45: // called by BASIC/Z
-        {
-            // non - CP/M 2.2: set action on hardware error
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 47: // chain to program
-        {
-            tracer.Trace( "chain to len %u command '%s'\n", * g_DMA, g_DMA + 1 );
-            char * pcmdline = (char *) ( g_DMA + 1 );
-            char * ptail = strchr( pcmdline, ' ' );
-            if ( ptail )
-            {
-                *ptail = 0;
-                ptail++;
-            }
-            else
-                ptail = pcmdline + strlen( pcmdline );
+    CFile file( fp );
+    char acLine[ 200 ];
+    char ac[ 5 ];
 
-            char acApp[ CPM_FILENAME_LEN ];
-            strcpy( acApp, pcmdline );
-            char acAppArgs[ 128 ];
-            strcpy( acAppArgs, ptail );
+    do
+    {
+        char * buf = fgets( acLine, _countof( acLine ), fp );
 
-            if ( load_cpm68k( acApp, acAppArgs ) )
-            {
-                tracer.Trace( "loaded chained app successfully\n" );
-                cpu.reset( memory, g_base_address, g_execution_address, g_stack_commit, g_top_of_stack );
-            }
-            else
-            {
-                ACCESS_REG( REG_RESULT ) = 0xff;
-                tracer.Trace( "unable to load chained app\n" );
-            }
-            break;
-        }
-        case 48: // flush buffers
-        {
-            fflush( 0 );
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 59: // program load (used by ddt). returns 0 = success, 1 = insufficient RAM, 2 = read error, 3 = bad relocation bits
+        if ( buf && strlen( buf ) >= 8 )
         {
-            LoadParameterBlockCPM * plpb = (LoadParameterBlockCPM *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            plpb->swap_endianness();
-            plpb->trace();
-            ACCESS_REG( REG_RESULT ) = 1;
+            if ( 'S' != buf[ 0 ] )
+                usage( "motorola hex file lines must start with S" );
 
-            bool ok = parse_FCB_Filename( (FCBCPM68K *) cpu.getmem( plpb->fcbOfChildApp ), acFilename );
-            if ( ok )
+            if ( '0' == acLine[1] )
             {
-                tracer.Trace( "  program to load: '%s'\n", acFilename );
-                FILE * fp = FindFileEntry( acFilename );
-                if ( fp )
+                // ignore
+            }
+            else if ( '1' == acLine[1] )
+            {
+                ac[ 0 ] = acLine[ 2 ];
+                ac[ 1 ] = acLine[ 3 ];
+                ac[ 2 ] = 0;
+                uint32_t length = strtoul( ac, 0, 16 );
+                length -= 3; // 2-byte address at start and 1-byte checksum at end
+                ac[ 0 ] = acLine[ 4 ];
+                ac[ 1 ] = acLine[ 5 ];
+                ac[ 2 ] = acLine[ 6 ];
+                ac[ 3 ] = acLine[ 7 ];
+                ac[ 4 ] = 0;
+                uint32_t address = strtoul( ac, 0, 16 );
+                memory.resize( address + length );
+                for ( uint32_t i = 0; i < length; i++ )
                 {
-                    uint32_t basePage = 0;
-                    uint32_t stackPointer = 0;
-                    if ( load59_cpm68k( fp, plpb->lowestAddress, plpb->highestAddress, plpb->loaderControlFlags, basePage, stackPointer ) )
-                    {
-                        plpb->childBasePage = basePage;
-                        plpb->childStackPointer = stackPointer;
-                        plpb->trace();
-                        plpb->swap_endianness();
-                        cpu.relax_pc_sp_constraints();
-                        ACCESS_REG( REG_RESULT ) = 0;
-                    }
-                    else
-                        tracer.Trace( "ERROR: program load failed to actually load the app\n" );
+                    ac[ 0 ] = acLine[ 8 + i * 2 ];
+                    ac[ 1 ] = acLine[ 8 + i * 2 + 1 ];
+                    ac[ 2 ] = 0;
+                    uint8_t v = (uint8_t) strtoul( ac, 0, 16 );
+                    memory[ address + i ] = v;
                 }
-                else
-                    tracer.Trace( "ERROR: program load can't find file in list of open files\n" );
+            }
+            else if ( '9' == acLine[1] )
+            {
+                ac[ 0 ] = acLine[ 4 ];
+                ac[ 1 ] = acLine[ 5 ];
+                ac[ 2 ] = acLine[ 6 ];
+                ac[ 3 ] = acLine[ 7 ];
+                ac[ 4 ] = 0;
+                g_execution_address = strtoul( ac, 0, 16 );
             }
             else
-                tracer.Trace( "ERROR: program load can't parse filename\n" );
-            break;
+                usage( "motorola hex input file format variation not supported" );
         }
-        case 61: // set exception vector. returns 0 on success, 0xff on failure
-        {
-            ExceptionParameterBlockCPM * pepb = (ExceptionParameterBlockCPM *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            tracer.TraceBinaryData( (uint8_t *) pepb, 10, 8 );
-            pepb->swap_endianness();
-            pepb->trace();
+    } while ( !feof( fp ) );
+
+    REG_TYPE memory_size = (REG_TYPE) memory.size();
+
+    if ( memory_size & 0xf )
+    {
+        memory_size += 16;
+        memory_size &= ~0xf;
+    }
+
+    g_end_of_data = memory_size;
+    g_brk_offset = memory_size;
+    g_highwater_brk = memory_size;
+    memory_size += g_brk_commit;
+
+    g_bottom_of_stack = memory_size;
+    memory_size += g_stack_commit;
+
+    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
+    g_mmap_offset = memory_size;
+    memory_size += g_mmap_commit;
+
+    memory.resize( memory_size );
+    memset( memory.data() + g_brk_offset, 0, memory_size - g_brk_offset );
+
+    g_base_address = 0;
+    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
+
+    g_top_of_stack = (REG_TYPE) memory.size();
+
+    tracer.Trace( "memory map from highest to lowest addresses:\n" );
+    tracer.Trace( "  first byte beyond allocated memory:                 %x\n", g_base_address + memory_size );
+    tracer.Trace( "  <mmap arena>                                        (%d = %x bytes)\n", g_mmap_commit, g_mmap_commit );
+    tracer.Trace( "  mmap start adddress:                                %x\n", g_base_address + g_mmap_offset );
+    tracer.Trace( "  <align to 4k-page for mmap allocations>\n" );
+    tracer.Trace( "  initial stack pointer g_top_of_stack:               %x\n", g_top_of_stack );
+    REG_TYPE stack_bytes = g_stack_commit;
+    tracer.Trace( "  <stack>                                             (%d == %x bytes)\n", stack_bytes, stack_bytes );
+    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %x\n", g_base_address + g_bottom_of_stack );
+    tracer.Trace( "  <unallocated space between brk and the stack>       (%d == %llx bytes)\n", g_brk_commit, g_brk_commit );
+    tracer.Trace( "  end_of_data / current brk:                          %x\n", g_base_address + g_end_of_data );
+    tracer.Trace( "  <code + data from the .hex file>\n" );
+    tracer.Trace( "  initial pc execution_addess:                        %x\n", g_execution_address );
+    tracer.Trace( "  <code per the .hex file>\n" );
+    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+
+    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
+    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
+    tracer.Trace( "memory_size:                     %#x == %d\n", memory_size, memory_size );
+
+    return true;
+} //load_68000_hex
+
+#endif //M68
+
+#endif // defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+
+static bool load_image( const char * pimage, const char * app_args, FILE * fpImage = 0 ) // takes ownership of fpImage if provided
+{
+    tracer.Trace( "loading image %s\n", pimage );
+
+#ifdef M68
+    if ( ends_with( pimage, ".hex" ) ) // Motorola 68000 hex file special-case
+        return load_68000_hex( pimage ); // app args are lost with hex files
+
+    if ( ends_with( pimage, ".68k" ) || ends_with( pimage, ".rel" ) ) // Digital Research CP/M 68K executable file
+        return load_cpm68k( pimage, app_args );
+#endif
+
+    FILE * fp = fpImage ? fpImage : fopen( pimage, "rb" );
+    if ( !fp )
+    {
+        printf( "can't open elf image file: %s\n", pimage );
+        usage();
+    }
+
+    // debug info is read from the file on first use, so remember its full path in case the app changes directories.
+    // images loaded from memory have no line information
+
+#ifdef _WIN32
+    char acFullPath[ EMULATOR_MAX_PATH ];
+    char * pfull = fpImage ? 0 : _fullpath( acFullPath, pimage, sizeof( acFullPath ) );
+    g_dwarf.set_image( fpImage ? 0 : pfull ? pfull : pimage );
+    snprintf( g_acImagePath, sizeof( g_acImagePath ), "%s", pfull ? pfull : pimage );
+#else
+    char * pfull = fpImage ? 0 : realpath( pimage, 0 );
+    g_dwarf.set_image( fpImage ? 0 : pfull ? pfull : pimage );
+    snprintf( g_acImagePath, sizeof( g_acImagePath ), "%s", pfull ? pfull : pimage );
+    free( pfull );
+#endif
+
+    CFile file( fp );
+
+    ElfHeader64 ehead = {0};
+    size_t read = fread( &ehead, sizeof ehead, 1, fp );
+    if ( 1 != read )
+        usage( "elf image file is invalid" );
+
+    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+        usage( "elf image file's magic header is invalid" );
+
+#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+    if ( 1 == ehead.bit_width )
+        return load_image32( fp, pimage, app_args );
+    else
+        usage( "elf image isn't 32-bit" );
+#endif
+
+#if defined( RVOS ) || defined( ARMOS ) || defined( X64OS )
+    bool big_endian = ( 2 == ehead.endianness );
+    tracer.Trace( "image is %s endian\n", big_endian ? "big" : "little" );
+
+    ehead.swap_endianness();
+
+    if ( 2 != ehead.type )
+    {
+        printf( "e_type is %d == %s\n", ehead.type, image_type( ehead.type ) );
+        usage( "elf image isn't an executable file (2)" );
+    }
+
+    if ( ELF_MACHINE_ISA != ehead.machine )
+    {
+        printf( "machine found: %#x\n", ehead.machine );
+        usage( "elf image machine ISA doesn't match this emulator" );
+    }
+
+    if ( 0 == ehead.entry_point )
+        usage( "elf entry point is 0, which is invalid" );
+
+    tracer.Trace( "header fields:\n" );
+    tracer.Trace( "  entry address: %llx\n", ehead.entry_point );
+    tracer.Trace( "  program entries: %u\n", ehead.program_header_table_entries );
+    tracer.Trace( "  program header entry size: %u\n", ehead.program_header_table_size );
+    tracer.Trace( "  program offset: %llu == %llx\n", ehead.program_header_table, ehead.program_header_table );
+    tracer.Trace( "  section entries: %u\n", ehead.section_header_table_entries );
+    tracer.Trace( "  section header entry size: %u\n", ehead.section_header_table_size );
+    tracer.Trace( "  section offset: %llu == %llx\n", ehead.section_header_table, ehead.section_header_table );
+    tracer.Trace( "  section with section names: %u == %x\n", ehead.section_with_section_names, ehead.section_with_section_names );
+    tracer.Trace( "  flags: %x\n", ehead.flags );
+    g_execution_address = (REG_TYPE) ehead.entry_point;
+    g_compressed_rvc = 0 != ( ehead.flags & 1 ); // 2-byte compressed RVC instructions, not 4-byte default risc-v instructions
+
+    // determine how much RAM to allocate
+
+    REG_TYPE memory_size = 0;
+
+    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+    {
+        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
+        tracer.Trace( "program header %u at offset %u\n", ph, (unsigned) o );
 
-            if ( pepb->vector >= 64 )
-            {
-                tracer.Trace( "ERROR: invalid vector number %u\n", pepb->vector );
-                ACCESS_REG( REG_RESULT ) = 0xff;
-                break;
-            }
+        ElfProgramHeader64 head = {0};
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), 1, fp );
+        if ( 1 != read )
+            usage( "can't read program header" );
 
-            pepb->oldValue = cpu.getui32( pepb->vector * 4 );
-            cpu.setui32( pepb->vector * 4, pepb->newValue );
-            pepb->trace();
-            pepb->swap_endianness();
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 62: // set supervisor state.
-        {
-            cpu.set_supervisor_state();
-            ACCESS_REG( REG_RESULT ) = 0;
-            break;
-        }
-        case 102:
+        head.swap_endianness();
+
+        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
+        tracer.Trace( "  offset in image: %llx\n", head.offset_in_image );
+        tracer.Trace( "  virtual address: %llx\n", head.virtual_address );
+        tracer.Trace( "  physical address: %llx\n", head.physical_address );
+        tracer.Trace( "  file size: %llx\n", head.file_size );
+        tracer.Trace( "  memory size: %llx\n", head.memory_size );
+        tracer.Trace( "  alignment: %llx\n", head.alignment );
+
+        if ( 2 == head.type )
         {
-            // Get file date and time (not in cp/m 2.2)
-            break;
+#ifdef X64OS_LIBRARY
+            usage( "dynamic linking is not supported by this emulator. link your app with -static" );
+#endif
+            printf( "dynamic linking is not supported by this emulator. link your app with -static\n" );
+            exit( 1 );
         }
-        case 105: // get date time. cp/m 3.0 and later. Returns seconds in A as packed bcd
-        case 155: // Get date and time. MP/M, Concurrent CP/M. called by rmcobol v1.5
-        {
-            CPM3DateTime * ptime = (CPM3DateTime *) cpu.getmem( ACCESS_REG( REG_ARG0 ) );
-            system_clock::time_point now = system_clock::now();
-            time_t time_now = system_clock::to_time_t( now );
-            struct tm * plocal = localtime( & time_now );
 
-            ptime->day = 1 + days_since_jan1_1978();
-            ptime->hour = packBCD( (uint8_t) plocal->tm_hour );
-            ptime->minute = packBCD( (uint8_t) plocal->tm_min );
-            ACCESS_REG( REG_RESULT ) = packBCD( (uint8_t) plocal->tm_sec );
+        uint64_t just_past = head.physical_address + head.memory_size;
+        if ( just_past > memory_size )
+            memory_size = just_past;
 
-            if ( 155 == function )
-                ptime->second = (uint8_t) ACCESS_REG( REG_RESULT );
+        if ( ( 0 != head.physical_address ) && ( ( 0 == g_base_address ) || g_base_address > head.physical_address ) )
+            g_base_address = (REG_TYPE) head.physical_address;
+    }
 
-#ifdef TARGET_BIG_ENDIAN
-            ptime->swap_endian();
-#endif
-            break;
-        }
-        case 108: // bdos get put program return code
+    if ( 0 == g_base_address )
+        usage( "base address of elf image is invalid; physical address required" );
+
+    memory_size -= g_base_address;
+    tracer.Trace( "memory_size of content to load from elf file: %llx\n", memory_size );
+
+    // first load the string table
+    vector<char> section_names_string_table;
+
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    {
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        ElfSectionHeader64 head = {0};
+
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
+
+        head.swap_endianness();
+        if ( 3 == head.type )
         {
-            // This is not a CP/M v2.2 function. It is in CP/M v3 and it's so handy that it's here too. called by DR PLI v1.4.
-            // if DE = 0xffff then return current code in HL (mapped to 68k registers)
-            // otherwise, set the current code to the value in DE (mapped to 68k registers)
+            if ( sh == ehead.section_with_section_names )
+            {
+                section_names_string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( section_names_string_table.data(), head.size, 1, fp );
+                if ( 1 != read )
+                    usage( "can't read string table\n" );
 
-            if ( 0xffff == ACCESS_REG( REG_ARG0 ) )
-                ACCESS_REG( REG_RESULT ) = g_exit_code;
+                tracer.Trace( "section names string table:\n" );
+                tracer.TraceBinaryData( (uint8_t *) section_names_string_table.data(), (uint32_t) head.size, 4 );
+            }
             else
             {
-                g_exit_code = ACCESS_REG( REG_ARG0 ) >> 16;
-                tracer.Trace( "  app exit code set to %u\n", g_exit_code );
+                g_string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( g_string_table.data(), head.size, 1, fp );
+                if ( 1 != read )
+                    usage( "can't read string table\n" );
+
+                tracer.Trace( "main string table:\n" );
+                tracer.TraceBinaryData( (uint8_t *) g_string_table.data(), (uint32_t) head.size, 4 );
             }
-            break;
         }
-        default:
+    }
+
+    // load the symbol data into RAM
+
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    {
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        tracer.Trace( "section header %zu at offset %zu == %zx\n", sh, o, o );
+
+        ElfSectionHeader64 head = {0};
+
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
+
+        head.swap_endianness();
+        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
+        tracer.Trace( "  name %s, offset: %x\n", & section_names_string_table[ head.name_offset ], head.name_offset );
+        tracer.Trace( "  flags: %llx / %s\n", head.flags, head.show_flags() );
+        tracer.Trace( "  address: %llx\n", head.address );
+        tracer.Trace( "  offset: %llx\n", head.offset );
+        tracer.Trace( "  size: %llx\n", head.size );
+        tracer.Trace( "  link: %x\n", head.link );
+        tracer.Trace( "  info: %x\n", head.info );
+        tracer.Trace( "  address_alignment: %llx\n", head.address_alignment );
+        tracer.Trace( "  entry_size: %llx\n", head.entry_size );
+
+        if ( !strcmp( ".tbss", & section_names_string_table[ head.name_offset ] ) )
+            tracer.Trace( "tbss: %#llx, size %#llx\n", head.address, head.size );
+
+        g_dwarf.add_section( & section_names_string_table[ head.name_offset ], head.offset, head.size );
+
+        if ( 2 == head.type )
         {
-            printf( "  unhandled cp/m bdos call %u\n", function );
-            tracer.Trace( "  unhandled cp/m bdos call %u\n", function );
-            break;
+            g_symbols.resize( head.size / sizeof( ElfSymbol64 ) );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( g_symbols.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read symbol table" );
         }
     }
-} //emulator_invoke_68k_trap2
 
-#endif // M68
+    // void out the entries that don't have symbol names or have mangled names that start with $
 
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+    for ( size_t se = 0; se < g_symbols.size(); se++ )
+    {
+        g_symbols[se].swap_endianness();
 
-static bool load_image32( FILE * fp, const char * pimage, const char * app_args )
-{
-    ElfHeader32 ehead = {0};
-    fseek( fp, (long) 0, SEEK_SET );
-    size_t read = fread( &ehead, 1, sizeof ehead, fp );
+        if ( ( 0 == g_symbols[se].name ) || ( '$' == g_string_table[ g_symbols[se].name ] ) )
+            g_symbols[se].value = 0;
+    }
 
-    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
-        usage( "elf image file's magic header is invalid" );
+    // use known qsort so traces are consistent across platforms because qsort implementations for ties differ
 
-    bool big_endian = ( 2 == ehead.endianness );
-    tracer.Trace( "image is %s endian\n", big_endian ? "big" : "little" );
-    if ( big_endian == CPU_IS_LITTLE_ENDIAN )
-        usage( "elf image endianness isn't consistent with emulator expectations" );
+    my_qsort( g_symbols.data(), g_symbols.size(), sizeof( ElfSymbol64 ), symbol_compare );
 
-    ehead.swap_endianness();
+    // remove symbols that don't look like they have a valid addresses (rust binaries have tens of thousands of these)
 
-    if ( 2 != ehead.type )
+    size_t to_erase = 0;
+    for ( size_t se = 0; se < g_symbols.size(); se++ )
     {
-        printf( "e_type is %d == %s\n", ehead.type, image_type( ehead.type ) );
-        usage( "elf image isn't an executable file (2 expected)" );
+        if ( g_symbols[ se ].value < g_base_address )
+            to_erase++;
+        else
+            break;
     }
 
-    if ( ELF_MACHINE_ISA != ehead.machine )
+    if ( to_erase > 0 )
+        g_symbols.erase( g_symbols.begin(), g_symbols.begin() + to_erase );
+
+    // set the size of each symbol if it's not already set
+
+    for ( size_t se = 0; se < g_symbols.size(); se++ )
     {
-        printf( "machine found: %#x\n", ehead.machine );
-        usage( "elf image machine ISA doesn't match this emulator" );
+        if ( 0 == g_symbols[se].size )
+        {
+            if ( se < ( g_symbols.size() - 1 ) )
+                g_symbols[se].size = g_symbols[ se + 1 ].value - g_symbols[ se ].value;
+            else
+                g_symbols[se].size = g_base_address + memory_size - g_symbols[ se ].value;
+        }
     }
 
-    if ( 0 == ehead.entry_point )
-        usage( "elf entry point is 0, which is invalid" );
+    tracer.Trace( "elf image has %u usable symbols:\n", (unsigned) g_symbols.size() );
+    tracer.Trace( "             address              size  name\n" );
+
+    for ( size_t se = 0; se < g_symbols.size(); se++ )
+        tracer.Trace( "    %16llx  %16llx  %s\n", g_symbols[ se ].value, g_symbols[ se ].size, & g_string_table[ g_symbols[ se ].name ] );
+
+    // memory map from high to low addresses:
+    //     <end of allocated memory>
+    //     (memory for mmap fulfillment)
+    //     g_mmap_offset
+    //     (wasted space so g_mmap_offset is 4k-aligned)
+    //     Linux start data on the stack (see details below)
+    //     g_top_of_stack
+    //     g_bottom_of_stack
+    //     (unallocated space between brk and the bottom of the stack)
+    //     g_brk_offset with uninitialized RAM (just after arg_data_offset initially)
+    //     g_end_of_data
+    //     arg_data_offset
+    //     uninitalized data bss (size read from the .elf file)
+    //     initialized data (size & data read from the .elf file)
+    //     code (read from the .elf file)
+    //     g_base_address (offset read from the .elf file).
+
+    // stacks by convention on arm64 and risc-v are 16-byte aligned. make sure to start aligned
+
+    if ( memory_size & 0xf )
+    {
+        memory_size += 16;
+        memory_size &= ~0xf;
+    }
+
+    uint64_t arg_data_offset = memory_size;
+    memory_size += arg_data_commit();
+    g_end_of_data = memory_size;
+    g_brk_offset = memory_size;
+    g_highwater_brk = memory_size;
+    memory_size += g_brk_commit;
+
+    g_bottom_of_stack = memory_size;
+    memory_size += g_stack_commit;
+
+    uint64_t top_of_aux = memory_size;
+    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
+    g_mmap_offset = memory_size;
+    memory_size += g_mmap_commit;
+
+    memory.resize( memory_size );
+    memset( memory.data(), 0, memory_size );
 
-    tracer.Trace( "header fields:\n" );
-    tracer.Trace( "  entry address: %x\n", ehead.entry_point );
-    tracer.Trace( "  program entries: %u\n", ehead.program_header_table_entries );
-    tracer.Trace( "  program header entry size: %u\n", ehead.program_header_table_size );
-    tracer.Trace( "  program offset: %u == %x\n", ehead.program_header_table, ehead.program_header_table );
-    tracer.Trace( "  section entries: %u\n", ehead.section_header_table_entries );
-    tracer.Trace( "  section header entry size: %u\n", ehead.section_header_table_size );
-    tracer.Trace( "  section offset: %u == %x\n", ehead.section_header_table, ehead.section_header_table );
-    tracer.Trace( "  section with section names: %u == %x\n", ehead.section_with_section_names, ehead.section_with_section_names );
-    tracer.Trace( "  flags: %x\n", ehead.flags );
-    g_execution_address = ehead.entry_point;
+    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
 
-    // determine how much RAM to allocate
+    // load the program into RAM
 
-    REG_TYPE memory_size = 0;
+    uint64_t first_uninitialized_data = 0;
 
     for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
     {
         size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
-        tracer.Trace( "program header %u at offset %u\n", ph, (unsigned int) o );
-
-        ElfProgramHeader32 head = {0};
+        ElfProgramHeader64 head = {0};
         fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), 1, fp );
-        if ( 1 != read )
-            usage( "can't read program header" );
-
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
         head.swap_endianness();
 
-        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
-        tracer.Trace( "  offset in image: %x\n", head.offset_in_image );
-        tracer.Trace( "  virtual address: %x\n", head.virtual_address );
-        tracer.Trace( "  physical address: %x\n", head.physical_address );
-        tracer.Trace( "  file size: %x\n", head.file_size );
-        tracer.Trace( "  memory size: %x\n", head.memory_size );
-        tracer.Trace( "  alignment: %x\n", head.alignment );
+        // head.type 1 == load. Other entries will overlap and even have physical addresses, but they are redundant
 
-        if ( 2 == head.type )
+        if ( 0 != head.file_size && 0 != head.physical_address && 1 == head.type )
         {
-            printf( "dynamic linking is not supported by this emulator. link your app with -static\n" );
-            exit( 1 );
-        }
-
-        REG_TYPE just_past = head.physical_address + head.memory_size;
-        if ( just_past > memory_size )
-            memory_size = just_past;
+            fseek( fp, (long) head.offset_in_image, SEEK_SET );
+            read = fread( memory.data() + head.physical_address - g_base_address, 1, head.file_size, fp );
+            if ( 0 == read )
+                usage( "can't read image" );
 
-        if ( ( 0 != head.physical_address ) && ( ( 0 == g_base_address ) || g_base_address > head.physical_address ) )
-            g_base_address = head.physical_address;
-    }
+            first_uninitialized_data = get_max( head.physical_address + head.file_size, first_uninitialized_data );
 
-    // if it won't waste much RAM, start the address space at 0 so low addresses can be used for things like trap vectors
+            if ( head.flags & 1 ) // PF_X
+            {
+                if ( ( 0 == g_code_end ) || ( head.physical_address < g_code_start ) )
+                    g_code_start = (REG_TYPE) head.physical_address;
+                g_code_end = get_max( g_code_end, (REG_TYPE) ( head.physical_address + head.file_size ) );
+            }
 
-    REG_TYPE elf_base_address = g_base_address;
+            tracer.Trace( "  read type %s: %llx bytes into physical address %llx - %llx then uninitialized to %llx \n", head.show_type(), head.file_size,
+                          head.physical_address, head.physical_address + head.file_size - 1, head.physical_address + head.memory_size - 1 );
+            tracer.TraceBinaryData( memory.data() + head.physical_address - g_base_address, get_min( (uint32_t) head.file_size, (uint32_t) 128 ), 4 );
+        }
+    }
 
-    if ( g_base_address < 0x20000 ) // sparc v8 binaries load by default at 0x10000 using stock tools
-        g_base_address = 0;
+    // write the command-line arguments into the vm memory in a place where _start can find them.
+    // there's an array of pointers to the args followed by the arg strings at offset arg_data_offset.
 
-    memory_size -= g_base_address;
-    tracer.Trace( "memory_size of content to load from elf file: %x\n", memory_size );
+    const uint32_t max_args = 40;
+    REG_TYPE aargs[ max_args ]; // vm pointers to each arguments
+    char * buffer_args = (char *) ( memory.data() + arg_data_offset );
+    size_t image_len = strlen( pimage );
+    vector<char> full_command( 2 + image_len + strlen( app_args ) );
+    strcpy( full_command.data(), pimage );
+    backslash_to_slash( full_command.data() );
+    full_command[ image_len ] = ' ';
+    strcpy( full_command.data() + image_len + 1, app_args );
 
-    // first load the string table(s)
-    vector<char> section_names_string_table;
+    strcpy( buffer_args, full_command.data() );
+    char * pargs = buffer_args;
+    size_t args_len = strlen( buffer_args );
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    uint64_t app_argc = 0;
+    while ( *pargs && app_argc < max_args )
     {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        ElfSectionHeader32 head = {0};
+        while ( ' ' == *pargs )
+            pargs++;
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+        char * space = strchr( pargs, ' ' );
+        if ( space )
+            *space = 0;
 
-        head.swap_endianness();
-        if ( 3 == head.type )
-        {
-            if ( sh == ehead.section_with_section_names )
-            {
-                section_names_string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( section_names_string_table.data(), head.size, 1, fp );
-                if ( 1 != read )
-                    usage( "can't read string table\n" );
+        uint64_t offset = pargs - buffer_args;
+        aargs[ app_argc ] = offset + g_base_address + arg_data_offset;
+        tracer.Trace( "  argument %llu is '%s', at vm address %llx\n", app_argc, pargs, (uint64_t) offset + g_base_address + arg_data_offset );
 
-                tracer.Trace( "section names string table:\n" );
-                tracer.TraceBinaryData( (uint8_t *) section_names_string_table.data(), (uint32_t) head.size, 4 );
-            }
-            else
-            {
-                g_string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( g_string_table.data(), head.size, 1, fp );
-                if ( 1 != read )
-                    usage( "can't read string table\n" );
+        app_argc++;
+        pargs += strlen( pargs );
 
-                tracer.Trace( "main string table:\n" );
-                tracer.TraceBinaryData( (uint8_t *) g_string_table.data(), (uint32_t) head.size, 4 );
-            }
-        }
+        if ( space )
+            pargs++;
     }
 
-    uint32_t the_EH_FRAME_BEGIN = 0; // for C++ programs, the pointer to the argument for __register_frame() at app startup
+    uint64_t env_offset = args_len + 1;
+    char * penv_data = (char *) ( buffer_args + env_offset );
+    strcpy( penv_data, "OS=" );
+    strcat( penv_data, APP_NAME );
+    uint64_t env_os_address = ( penv_data - (char *) memory.data() ) + g_base_address;
+    uint64_t env_count = 1;
+    uint64_t env_tz_address = 0;
 
-    // load the symbol data into RAM and look for .eh_frame
+     // The local time zone is found by libc on Linux/MacOS, but not on Windows.
+     // Workaround: set the TZ environment variable.
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+#ifdef _WIN32
+    DYNAMIC_TIME_ZONE_INFORMATION tzi = {0};
+    DWORD dw = GetDynamicTimeZoneInformation( &tzi );
+    if ( TIME_ZONE_ID_INVALID != dw )
     {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        tracer.Trace( "section header %u at offset %u == %x\n", sh, o, o );
+        char acName[ 32 ] = {0};
+        if ( TIME_ZONE_ID_STANDARD == dw )
+            wcstombs( acName, tzi.StandardName, sizeof( acName ) );
+        else if ( TIME_ZONE_ID_DAYLIGHT == dw )
+            wcstombs( acName, tzi.DaylightName, sizeof( acName ) );
+        else if ( TIME_ZONE_ID_UNKNOWN == dw )
+            strcpy( acName, "local" );
 
-        ElfSectionHeader32 head = {0};
+        if ( 0 != acName[ 0 ] )
+        {
+            char * ptz_data = penv_data + 1 + strlen( penv_data );
+            env_tz_address = ( ptz_data - (char *) memory.data() ) + g_base_address;
+            strcpy( ptz_data, "TZ=" );
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+            // libc doesn't like spaces in spite of the doc saying it's OK:
+            // https://ftp.gnu.org/old-gnu/Manuals/glibc-2.2.3/html_node/libc_431.html
 
-        head.swap_endianness();
+            remove_spaces( acName );
+            strcat( (char *) ptz_data, acName );
 
-        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
-        tracer.Trace( "  name %s, offset: %x\n", & section_names_string_table[ head.name_offset ], head.name_offset );
-        tracer.Trace( "  flags: %x / %s\n", head.flags, head.show_flags() );
-        tracer.Trace( "  address: %x\n", head.address );
-        tracer.Trace( "  offset: %x\n", head.offset );
-        tracer.Trace( "  size: %x\n", head.size );
-        tracer.Trace( "  link: %x\n", head.link );
-        tracer.Trace( "  info: %x\n", head.info );
-        tracer.Trace( "  address_alignment: %x\n", head.address_alignment );
-        tracer.Trace( "  entry_size: %x\n", head.entry_size );
+            if ( tzi.Bias >= 0 )
+                strcat( (char *) ptz_data, "+" );
+            itoa( tzi.Bias / 60, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
+            int minutes = abs( tzi.Bias % 60 );
+            if ( 0 != minutes )
+            {
+                strcat( ptz_data, ":" );
+                itoa( minutes, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
+            }
+            tracer.Trace( "ptz_data: '%s'\n", ptz_data );
+            env_count++;
+        }
+    }
+#endif
 
-        if ( !strcmp( ".tbss", & section_names_string_table[ head.name_offset ] ) )
-            tracer.Trace( "tbss: %#x, size %#x\n", head.address, head.size );
+    vector<REG_TYPE> env_extra_addresses;
+    copy_environment( penv_data, env_extra_addresses );
+    env_count += (REG_TYPE) env_extra_addresses.size();
 
-        if ( !strcmp( ".eh_frame", & section_names_string_table[ head.name_offset ] ) )
-            the_EH_FRAME_BEGIN = head.address;
+    tracer.Trace( "args_len %d, penv_data %p\n", args_len, penv_data );
+    tracer.TraceBinaryData( (uint8_t *) ( memory.data() + arg_data_offset ), g_arg_data_commit + 0x20, 4 ); // +20 to inspect for bugs
 
-        if ( 2 == head.type )
-        {
-            g_symbols32.resize( head.size / sizeof( ElfSymbol32 ) );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( g_symbols32.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read symbol table" );
-        }
-    }
+    // put the Linux startup info at the top of the stack. this consists of (from high to low):
+    //   two 8-byte random numbers used for stack and pointer guards
+    //   optional filler to make sure alignment of all startup info is 16 bytes
+    //   AT_NULL aux record
+    //   AT_RANDOM aux record -- point to the 2 random 8-byte numbers above
+    //   AT_PAGESZ aux record -- golang runtime fails if it can't find the page size here
+    //   0 environment termination
+    //   0..n environment string pointers
+    //   0 argv termination
+    //   1..n argv string pointers
+    //   argc  <<<==== sp should point here when the entrypoint (likely _start) is invoked
 
-    // void out the entries that don't have symbol names or have mangled names that start with $
+    uint64_t * pstack = (uint64_t *) ( memory.data() + top_of_aux );
 
-    for ( size_t se = 0; se < g_symbols32.size(); se++ )
-    {
-        g_symbols32[se].swap_endianness();
+    pstack--;
+    *pstack = rand64();
+    pstack--;
+    *pstack = rand64();
+    uint64_t prandom = g_base_address + memory_size - 16;
 
-        if ( ( 0 == g_symbols32[se].name ) || ( '$' == g_string_table[ g_symbols32[se].name ] ) )
-            g_symbols32[se].value = 0;
-    }
+    // ensure that after all of this the stack is 16-byte aligned
 
-    // use known my_qsort so traces are consistent across platforms because qsort implementations for duplicate values differ
+    if ( 0 == ( 1 & ( app_argc + env_count ) ) )
+        pstack--;
+
+    pstack -= 2; // the AT_NULL record will be here since memory is initialized to 0
+
+    pstack -= 16; // for 8 aux records
+    AuxProcessStart * paux = (AuxProcessStart *) pstack;
+    paux[0].a_type = 25; // AT_RANDOM
+    paux[0].a_un.a_val = prandom;
+    paux[0].swap_endianness();
+    paux[1].a_type = 6; // AT_PAGESZ
+    paux[1].a_un.a_val = 4096;
+    paux[1].swap_endianness();
+    paux[2].a_type = 16; // AT_HWCAP
+    paux[2].a_un.a_val = 0xa01; // ARM64 bits for fp(0), atomics(8), cpuid(11)
+    paux[2].swap_endianness();
+    paux[3].a_type = 26; // AT_HWCAP2
+    paux[3].a_un.a_val = 0;
+    paux[3].swap_endianness();
+    paux[4].a_type = 11; // AT_UID
+    paux[4].a_un.a_val = 0x595a5449; // "ITZY" they are each my bias.
+    paux[4].swap_endianness();
+    paux[5].a_type = 22; // AT_EUID;
+    paux[5].a_un.a_val = 0x595a5449;
+    paux[5].swap_endianness();
+    paux[6].a_type = 13; // AT_GID
+    paux[6].a_un.a_val = 0x595a5449;
+    paux[6].swap_endianness();
+    paux[7].a_type = 14; // AT_EGID
+    paux[7].a_un.a_val = 0x595a5449;
+    paux[7].swap_endianness();
 
-    tracer.Trace( "sorting symbol entries\n" );
-    my_qsort( g_symbols32.data(), g_symbols32.size(), sizeof( ElfSymbol32 ), symbol_compare32 );
+    pstack--; // end of environment data is 0
+    pstack--; // move to where the first environment variable is
 
-    // remove symbols that don't look like they have a valid addresses (rust binaries have tens of thousands of these)
+    for ( size_t e = env_extra_addresses.size(); e > 0; e-- )
+    {
+        *pstack = swap_endian64( env_extra_addresses[ e - 1 ] );
+        pstack--;
+    }
 
-    size_t to_erase = 0;
-    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+    if ( 0 != env_tz_address )
     {
-        if ( g_symbols32[ se ].value < elf_base_address )
-            to_erase++;
-        else
-            break;
+        *pstack = swap_endian64( env_tz_address );
+        tracer.Trace( "the TZ environment argument is at VM address %llx\n", env_tz_address );
+        pstack--;
     }
 
-    if ( to_erase > 0 )
-        g_symbols32.erase( g_symbols32.begin(), g_symbols32.begin() + to_erase );
+    // point to the OS= environment variable location
+    *pstack = swap_endian64( env_os_address );
+    tracer.Trace( "the OS environment argument is at VM address %llx\n", *pstack );
 
-    // set the size of each symbol if it's not already set
+    pstack--; // the last argv is 0 to indicate the end
 
-    for ( size_t se = 0; se < g_symbols32.size(); se++ )
+    for ( int iarg = (int) app_argc - 1; iarg >= 0; iarg-- )
     {
-        if ( 0 == g_symbols32[se].size )
-        {
-            if ( se < ( g_symbols32.size() - 1 ) )
-                g_symbols32[se].size = g_symbols32[ se + 1 ].value - g_symbols32[ se ].value;
-            else
-                g_symbols32[se].size = g_base_address + memory_size - g_symbols32[ se ].value;
-        }
+        pstack--;
+        *pstack = swap_endian64( aargs[ iarg ] );
     }
 
-    tracer.Trace( "elf image has %u usable symbols:\n", (unsigned) g_symbols32.size() );
-    tracer.Trace( "     address      size  name\n" );
+    pstack--;
+    *pstack = swap_endian64( app_argc );
 
-    for ( size_t se = 0; se < g_symbols32.size(); se++ )
-        tracer.Trace( "    %8x  %8x  %s\n", g_symbols32[ se ].value, g_symbols32[ se ].size, & g_string_table[ g_symbols32[ se ].name ] );
+    g_top_of_stack = (uint64_t) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
+    uint64_t aux_data_size = top_of_aux - (uint64_t) ( (uint8_t *) pstack - memory.data() );
+    tracer.Trace( "stack at start (beginning with argc) -- %llu bytes at address %p:\n", aux_data_size, pstack );
+    tracer.TraceBinaryData( (uint8_t *) pstack, (uint32_t) aux_data_size, 2 );
 
-    // memory map from high to low addresses:
-    //     <end of allocated memory>
-    //     (memory for mmap fulfillment)
-    //     g_mmap_offset
-    //     (wasted space so g_mmap_offset is 4k-aligned)
-    //     arg_data_offset -- actual arg and env, etc. values pointed to by Linux start data
-    //     Linux start data on the stack (see details below)
-    //     g_top_of_stack
-    //     g_bottom_of_stack
-    //     (unallocated space between brk and the bottom of the stack)
-    //     g_brk_offset with uninitialized RAM (just after arg_data_offset initially)
-    //     g_end_of_data
-    //     uninitalized data bss (size read from the .elf file)
-    //     initialized data (size & data read from the .elf file)
-    //     code (read from the .elf file)
-    //     g_base_address (offset read from the .elf file).
+    tracer.Trace( "memory map from highest to lowest addresses:\n" );
+    tracer.Trace( "  first byte beyond allocated memory:                 %llx\n", g_base_address + memory_size );
+    tracer.Trace( "  <mmap arena>                                        (%lld = %llx bytes)\n", g_mmap_commit, g_mmap_commit );
+    tracer.Trace( "  mmap start adddress:                                %llx\n", g_base_address + g_mmap_offset );
+    tracer.Trace( "  <align to 4k-page for mmap allocations>\n" );
+    tracer.Trace( "  start of aux data:                                  %llx\n", g_top_of_stack + aux_data_size );
+    tracer.Trace( "  <random, alignment, aux recs, env, argv>            (%lld == %llx bytes)\n", aux_data_size, aux_data_size );
+    tracer.Trace( "  initial stack pointer g_top_of_stack:               %llx\n", g_top_of_stack );
+    uint64_t stack_bytes = g_stack_commit - aux_data_size;
+    tracer.Trace( "  <stack>                                             (%lld == %llx bytes)\n", stack_bytes, stack_bytes );
+    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %llx\n", g_base_address + g_bottom_of_stack );
+    tracer.Trace( "  <unallocated space between brk and the stack>       (%lld == %llx bytes)\n", g_brk_commit, g_brk_commit );
+    tracer.Trace( "  end_of_data / current brk:                          %llx\n", g_base_address + g_end_of_data );
+    uint64_t argv_bytes = g_end_of_data - arg_data_offset;
+    tracer.Trace( "  <argv data, pointed to by argv array above>         (%lld == %llx bytes)\n", argv_bytes, argv_bytes );
+    tracer.Trace( "  start of argv data:                                 %llx\n", g_base_address + arg_data_offset );
+    uint64_t uninitialized_bytes = g_base_address + arg_data_offset - first_uninitialized_data;
+    tracer.Trace( "  <uninitialized data per the .elf file>              (%lld == %llx bytes)\n", uninitialized_bytes, uninitialized_bytes );
+    tracer.Trace( "  first byte of uninitialized data:                   %llx\n", first_uninitialized_data );
+    tracer.Trace( "  <initialized data from the .elf file>\n" );
+    tracer.Trace( "  <code from the .elf file>\n" );
+    tracer.Trace( "  initial pc execution_addess:                        %llx\n", g_execution_address );
+    tracer.Trace( "  <code per the .elf file>\n" );
+    tracer.Trace( "  start of the address space per the .elf file:       %llx\n", g_base_address );
 
-    if ( memory_size & 0xf )
-    {
-        memory_size += 16;
-        memory_size &= ~0xf;
-    }
+    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
+    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
+    tracer.Trace( "memory_size:                     %#llx == %lld\n", memory_size, memory_size );
+    tracer.Trace( "risc-v compressed instructions:  %s\n", g_compressed_rvc ? "yes" : "no" );
 
-    g_end_of_data = memory_size;
-    g_brk_offset = memory_size;
-    g_highwater_brk = memory_size;
-    memory_size += g_brk_commit;
+#endif //M68
 
-    g_bottom_of_stack = memory_size;
-    memory_size += g_stack_commit;
-    REG_TYPE top_of_aux = memory_size;
+    return true;
+} //load_image
 
-    REG_TYPE arg_data_offset = memory_size;
-    memory_size += g_arg_data_commit;
+static void elf_info32( FILE * fp, bool verbose )
+{
+    ElfHeader32 ehead = {0};
+    fseek( fp, (long) 0, SEEK_SET );
+    size_t read = fread( &ehead, 1, sizeof ehead, fp );
 
-    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
-    g_mmap_offset = memory_size;
-    memory_size += g_mmap_commit;
+    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+    {
+        printf( "image file's magic header is invalid: %x\n", ehead.magic );
+        return;
+    }
 
-    memory.resize( memory_size );
-    memset( memory.data(), 0, memory_size );
+    bool big_endian = ( 2 == ehead.endianness );
+    printf( "image is %s endian\n", big_endian ? "big" : "little" );
 
-    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
+    ehead.swap_endianness();
+    if ( ELF_MACHINE_ISA != ehead.machine )
+        printf( "image machine ISA isn't a match for %s; continuing anyway. machine type is %x\n", APP_NAME, ehead.machine );
 
-    // load the program into RAM
+    printf( "header fields:\n" );
+    printf( "  bit_width: %u\n", ehead.bit_width );
+    printf( "  type: %u\n", ehead.type );
+    printf( "  entry address: %#x\n", ehead.entry_point );
+    printf( "  program entries: %u\n", ehead.program_header_table_entries );
+    printf( "  program header entry size: %u\n", ehead.program_header_table_size );
+    printf( "  program offset: %u == %x\n", ehead.program_header_table, ehead.program_header_table );
+    printf( "  section entries: %u\n", ehead.section_header_table_entries );
+    printf( "  section header entry size: %u\n", ehead.section_header_table_size );
+    printf( "  section offset: %u == %#x\n", ehead.section_header_table, ehead.section_header_table );
+    printf( "  flags: %#x\n", ehead.flags );
 
-    REG_TYPE first_uninitialized_data = 0;
+    g_execution_address = ehead.entry_point;
+    REG_TYPE memory_size = 0;
+
+    printf( "program headers:\n" );
+    printf( "   # Type       Offset   VirtAddr PhysAddr FileSize MemSize  Alignment Flags\n" );
 
     for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
     {
         size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
         ElfProgramHeader32 head = {0};
+
         fseek( fp, (long) o, SEEK_SET );
         read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
-        head.swap_endianness();
+        if ( 0 == read )
+            usage( "can't read program header" );
 
-        // head.type 1 == load. Other entries will overlap and even have physical addresses, but they are redundant
+        head.swap_endianness();
 
-        if ( 0 != head.file_size && 1 == head.type )
-        {
-            fseek( fp, (long) head.offset_in_image, SEEK_SET );
-            read = fread( memory.data() + head.physical_address - g_base_address, 1, head.file_size, fp );
-            if ( 0 == read )
-                usage( "can't read image" );
+        printf( "  %2u", ph );
+        printf( " %-10s", head.show_type() );
+        printf( " %08x", head.offset_in_image );
+        printf( " %08x", head.virtual_address );
+        printf( " %08x", head.physical_address );
+        printf( " %08x", head.file_size );
+        printf( " %08x", head.memory_size );
+        printf( " %08x", head.alignment );
+        printf( "  %s\n", head.show_flags() );
 
-            first_uninitialized_data = get_max( head.physical_address + head.file_size, first_uninitialized_data );
+        REG_TYPE just_past = head.physical_address + head.memory_size;
+        if ( just_past > memory_size )
+            memory_size = just_past;
 
-            tracer.Trace( "  read type %s: %x bytes into physical address %x - %x then uninitialized to %x \n", head.show_type(), head.file_size,
-                          head.physical_address, head.physical_address + head.file_size - 1, head.physical_address + head.memory_size - 1 );
-            tracer.TraceBinaryData( memory.data() + head.physical_address - g_base_address, get_min( (uint32_t) head.file_size, (uint32_t) 128 ), 4 );
+        if ( 0 != head.physical_address )
+        {
+            if ( ( 0 == g_base_address ) || ( g_base_address > head.physical_address ) )
+                g_base_address = head.physical_address;
         }
     }
 
-    // if the base address is 0 we need a supervisor stack configured at address 0.
-
-    if ( 0 == g_base_address )
-        * (uint32_t *) memory.data() = swap_endian32( elf_base_address ); // arbitrary, but probably safe here between the vector table and app
+    memory_size -= g_base_address;
 
-    // write the command-line arguments into the vm memory in a place where _start can find them.
-    // there's an array of pointers to the args followed by the arg strings at offset arg_data_offset.
+    // first load the string tables
 
-    const uint32_t max_args = 40;
-    REG_TYPE aargs[ max_args ]; // vm pointers to each arguments
-    char * buffer_args = (char *) ( memory.data() + arg_data_offset );
-    size_t image_len = strlen( pimage );
-    vector<char> full_command( 2 + image_len + strlen( app_args ) );
-    strcpy( full_command.data(), pimage );
-    backslash_to_slash( full_command.data() );
-    full_command[ image_len ] = ' ';
-    strcpy( full_command.data() + image_len + 1, app_args );
-    strcpy( buffer_args, full_command.data() );
-    char * pargs = buffer_args;
-    REG_TYPE args_len = (REG_TYPE) strlen( buffer_args );
+    vector<char> string_table;
+    vector<char> shstr_table;
 
-    REG_TYPE app_argc = 0;
-    while ( *pargs && app_argc < max_args )
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
     {
-        while ( ' ' == *pargs )
-            pargs++;
-
-        char * space = strchr( pargs, ' ' );
-        if ( space )
-            *space = 0;
-
-        REG_TYPE offset = (REG_TYPE) ( pargs - buffer_args );
-        tracer.Trace( "offset %x\n", offset );
-        aargs[ app_argc ] = swap_endian32( offset + g_base_address + arg_data_offset );
-        tracer.Trace( "  argument %d is '%s', at vm address %llx\n", app_argc, pargs, (uint64_t) offset + g_base_address + arg_data_offset );
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        ElfSectionHeader32 head = {0};
 
-        app_argc++;
-        pargs += strlen( pargs );
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
 
-        if ( space )
-            pargs++;
-    }
+        head.swap_endianness();
 
-    REG_TYPE env_offset = args_len + 1;
-    tracer.Trace( "env_offset: %x\n", env_offset );
-    char * penv_data = (char *) ( buffer_args + env_offset );
-    strcpy( penv_data, "OS=" );
-    strcat( penv_data, APP_NAME );
-    REG_TYPE env_os_address = (REG_TYPE) ( penv_data - (char *) memory.data() ) + g_base_address;
-    tracer.Trace( "env_os_address %x\n", env_os_address );
-    REG_TYPE env_count = 1;
-    REG_TYPE env_tz_address = 0;
+        if ( 3 == head.type )
+        {
+            if ( 0 == string_table.size() )
+            {
+                string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( string_table.data(), 1, head.size, fp );
+                if ( 0 == read )
+                    usage( "can't read string table\n" );
+            }
+            else
+            {
+                shstr_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( shstr_table.data(), 1, head.size, fp );
+                if ( 0 == read )
+                    usage( "can't read shstr table\n" );
+            }
+        }
+    }
 
-    // The local time zone is found by libc on Linux/MacOS, but not on Windows.
-    // Workaround: set the TZ environment variable.
+    printf( "section headers:\n" );
+    printf( "   # Name                 Type                             Address  Offset   Size     Flags\n" );
 
-#ifdef _WIN32
-    DYNAMIC_TIME_ZONE_INFORMATION tzi = {0};
-    DWORD dw = GetDynamicTimeZoneInformation( &tzi );
-    if ( TIME_ZONE_ID_INVALID != dw )
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
     {
-        char acName[ 32 ] = {0};
-        if ( TIME_ZONE_ID_STANDARD == dw )
-            wcstombs( acName, tzi.StandardName, sizeof( acName ) );
-        else if ( TIME_ZONE_ID_DAYLIGHT == dw )
-            wcstombs( acName, tzi.DaylightName, sizeof( acName ) );
-        else if ( TIME_ZONE_ID_UNKNOWN == dw )
-            strcpy( acName, "local" );
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        //printf( "section header %u at offset %u == %x\n", sh, (unsigned) o, (unsigned) o );
 
-        if ( 0 != acName[ 0 ] )
-        {
-            char * ptz_data = penv_data + 1 + strlen( penv_data );
-            env_tz_address = (REG_TYPE) ( ptz_data - (char *) memory.data() ) + g_base_address;
-            tracer.Trace( "env_tz_address %x\n", env_tz_address );
-            strcpy( ptz_data, "TZ=" );
+        ElfSectionHeader32 head = {0};
 
-            // libc doesn't like spaces in spite of the doc saying it's OK:
-            // https://ftp.gnu.org/old-gnu/Manuals/glibc-2.2.3/html_node/libc_431.html
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
 
-            remove_spaces( acName );
-            strcat( (char *) ptz_data, acName );
+        head.swap_endianness();
 
-            if ( tzi.Bias >= 0 )
-                strcat( (char *) ptz_data, "+" );
-            itoa( tzi.Bias / 60, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
-            int minutes = abs( tzi.Bias % 60 );
-            if ( 0 != minutes )
+        printf( "  %2u", sh );
+        printf( " %-20s", & shstr_table[ head.name_offset ] );
+        printf( " %-32s", head.show_type() );
+        printf( " %08x", head.address );
+        printf( " %08x", head.offset );
+        printf( " %08x", head.size );
+        printf( " %#x / %s\n", head.flags, head.show_flags() );
+
+        if ( 2 == head.type ) // symbol table
+        {
+            vector<ElfSymbol32> symbols;
+            symbols.resize( head.size / sizeof( ElfSymbol32 ) );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( symbols.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read symbol table" );
+
+            if ( verbose )
             {
-                strcat( ptz_data, ":" );
-                itoa( minutes, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
+                size_t count = head.size / sizeof( ElfSymbol32 );
+                printf( "  symbols:\n" );
+                for ( size_t sym = 0; sym < symbols.size(); sym++ )
+                {
+                    printf( "    symbol # %zd\n", sym );
+                    ElfSymbol32 & sym_entry = symbols[ sym ];
+                    sym_entry.swap_endianness();
+
+                    printf( "     name:  %x == %s\n",   sym_entry.name, ( 0 == sym_entry.name ) ? "" : & string_table[ sym_entry.name ] );
+                    printf( "     info:  %x == %s\n",   sym_entry.info, sym_entry.show_info() );
+                    printf( "     other: %x == %s\n",   sym_entry.other, sym_entry.show_other() );
+                    printf( "     shndx: %x\n",   sym_entry.shndx );
+                    printf( "     value: %x\n", sym_entry.value );
+                    printf( "     size:  %u\n", sym_entry.size );
+                }
             }
-            tracer.Trace( "ptz_data: '%s'\n", ptz_data );
-            env_count++;
+        }
+        else if ( 7 == head.type && 0 != head.size && verbose ) // notes
+        {
+            vector<uint8_t> notes( head.size );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( notes.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read notes\n" );
+            tracer.PrintBinaryData( notes.data(), (uint32_t) head.size, 4 );
         }
     }
-#endif
-
-    tracer.Trace( "args_len %d, penv_data %p\n", args_len, penv_data );
-    tracer.TraceBinaryData( (uint8_t *) ( memory.data() + arg_data_offset ), g_arg_data_commit + 0x20, 4 ); // +20 to inspect for bugs
-
-    // put the Linux startup info at the top of the stack. this consists of (from high to low):
-    //   two 8-byte random numbers used for stack and pointer guards
-    //   optional filler to make sure alignment of all startup info is 16 bytes
-    //   AT_NULL aux record
-    //   AT_RANDOM aux record -- point to the 2 random 8-byte numbers above
-    //   AT_PAGESZ aux record -- golang runtime fails if it can't find the page size here
-    //   0 environment termination
-    //   0..n environment string pointers
-    //   0 argv termination
-    //   1..n argv string pointers
-    //   argc  <<<==== sp should point here when the entrypoint (likely _start) is invoked
-
-    tracer.Trace( "top of aux: %x\n", top_of_aux );
-    REG_TYPE * pstack = (REG_TYPE *) ( memory.data() + top_of_aux );
 
-    pstack--;
-    *pstack = (REG_TYPE) rand64();
-    pstack--;
-    *pstack = (REG_TYPE) rand64();
-    REG_TYPE prandom = g_base_address + memory_size - ( 2 * sizeof( REG_TYPE ) );
+    printf( "global info\n" );
+    printf( "  flags: %#08x\n", ehead.flags );
 
-    // ensure that after all of this the stack is 16-byte aligned
+    printf( "  vm g_base_address %llx\n", (uint64_t) g_base_address );
+    printf( "  memory_size: %llx\n", (uint64_t) memory_size );
+    printf( "  g_stack_commit: %llx\n", (uint64_t) g_stack_commit );
+    printf( "  g_execution_address %llx\n", (uint64_t) g_execution_address );
+} //elf_info32
 
-    if ( 0 == ( 1 & ( app_argc + env_count ) ) )
-        pstack--;
+static void elf_info( const char * pimage, bool verbose )
+{
+    ElfHeader64 ehead = {0};
 
-    pstack -= ( 10 * sizeof( AuxProcessStart32 ) ); // for 10 aux records
-    REG_TYPE aux_data_offset = (REG_TYPE) ( (uint8_t *) pstack - memory.data() );
-    AuxProcessStart32 * paux = (AuxProcessStart32 *) pstack;
-    paux[0].a_type = 25; // AT_RANDOM
-    paux[0].a_un.a_val = prandom;
-    paux[0].swap_endianness();
-    paux[1].a_type = 6; // AT_PAGESZ
-    paux[1].a_un.a_val = 4096;
-    paux[1].swap_endianness();
-    paux[2].a_type = 16; // AT_HWCAP
-    paux[2].a_un.a_val = 0xa01; // ARM64 bits for fp(0), atomics(8), cpuid(11)
-    paux[2].swap_endianness();
-    paux[3].a_type = 26; // AT_HWCAP2
-    paux[3].a_un.a_val = 0;
-    paux[3].swap_endianness();
-    paux[4].a_type = 11; // AT_UID
-    paux[4].a_un.a_val = 0x595a5449; // "ITZY" they are each my bias.
-    paux[4].swap_endianness();
-    paux[5].a_type = 22; // AT_EUID;
-    paux[5].a_un.a_val = 0x595a5449;
-    paux[5].swap_endianness();
-    paux[6].a_type = 13; // AT_GID
-    paux[6].a_un.a_val = 0x595a5449;
-    paux[6].swap_endianness();
-    paux[7].a_type = 14; // AT_EGID
-    paux[7].a_un.a_val = 0x595a5449;
-    paux[7].swap_endianness();
-#ifdef M68 // only needed for M68 because it uses newlib. In fact, on Sparc the C runtime infinte loops when it sees a value as large as AT_EH_FRAME_BEGIN
-    paux[8].a_type = AT_EH_FRAME_BEGIN;
-    paux[8].a_un.a_val = the_EH_FRAME_BEGIN;
-    paux[8].swap_endianness();
-#endif
-    paux[9].a_type = 0;  // 0 to signify the end of the list of AT aux records
-    paux[9].a_un.a_val = 0;
+    FILE * fp = fopen( pimage, "rb" );
+    if ( !fp )
+        usage( "can't open image file" );
 
-    pstack--; // end of environment data is 0
-    pstack--; // move to where the OS environment variable is set OS=RVOS or OS=ARMOS
+    CFile file( fp );
+    size_t read = fread( &ehead, 1, sizeof ehead, fp );
+    if ( 0 == read )
+    {
+        printf( "image file is invalid; can't read data\n" );
+        return;
+    }
 
-    if ( 0 != env_tz_address )
+    if ( 1 == ehead.bit_width )
     {
-        *pstack = swap_endian32( env_tz_address );
-        tracer.Trace( "the TZ environment argument is at VM address %lx (orig %lx)\n", swap_endian32( *pstack ), env_tz_address );
-        pstack--;
+        elf_info32( fp, verbose );
+        return;
     }
 
-    // point to the OS= environment variable location
-    *pstack = swap_endian32( env_os_address ); // (REG_TYPE) ( env_offset + arg_data_offset + g_base_address + max_args * sizeof( REG_TYPE ) );
-    tracer.Trace( "the OS environment argument is at VM address %lx\n", swap_endian32( *pstack ) );
+#ifndef M68
 
-    pstack--; // the last argv is 0 to indicate the end
+    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+    {
+        printf( "image file's magic header is invalid: %x\n", ehead.magic );
+        return;
+    }
 
-    for ( int iarg = (int) app_argc - 1; iarg >= 0; iarg-- )
+    if ( 1 != ehead.endianness )
     {
-        pstack--;
-        *pstack = aargs[ iarg ];
+        printf( "expected a little-endian image\n" );
+        return;
     }
 
-    REG_TYPE first_argv_at = (REG_TYPE) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
-    tracer.Trace( "first argv value (app name) is at %lx\n", first_argv_at );
-    pstack--;
-    *pstack = swap_endian32( app_argc );
+    ehead.swap_endianness();
 
-    g_top_of_stack = (REG_TYPE) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
-#ifdef SPARCOS
-    // linux on sparc v8 reserves one register frame of space between argc and the actual top of the stack for the trap handler
-    g_top_of_stack -= 64;
-#endif
+    printf( "machine isa: %#x\n", ehead.machine );
 
-    REG_TYPE aux_data_size = top_of_aux - (REG_TYPE) ( (uint8_t *) pstack - memory.data() );
-    tracer.Trace( "stack at start (beginning with argc) -- %u bytes at address %p:\n", aux_data_size, pstack );
-    tracer.TraceBinaryData( (uint8_t *) pstack, (uint32_t) aux_data_size, 2 );
+    if ( ELF_MACHINE_ISA != ehead.machine )
+        printf( "image machine ISA isn't a match for %s; continuing anyway. machine type is %x\n", APP_NAME, ehead.machine );
 
-    tracer.Trace( "memory map from highest to lowest addresses:\n" );
-    tracer.Trace( "  first byte beyond allocated memory:                 %lx\n", g_base_address + memory_size );
-    tracer.Trace( "  <mmap arena>                                        (%ld = %lx bytes)\n", g_mmap_commit, g_mmap_commit );
-    tracer.Trace( "  mmap start adddress:                                %lx\n", g_base_address + g_mmap_offset );
-    tracer.Trace( "  <filler to align to 4k-page for mmap allocations>\n" );
+    printf( "header fields:\n" );
+    printf( "  bit_width: %u\n", ehead.bit_width );
+    printf( "  type: %u\n", ehead.type );
+    printf( "  entry address: %llx\n", ehead.entry_point );
+    printf( "  program entries: %u\n", ehead.program_header_table_entries );
+    printf( "  program header entry size: %u\n", ehead.program_header_table_size );
+    printf( "  program offset: %llu == %llx\n", ehead.program_header_table, ehead.program_header_table );
+    printf( "  section entries: %u\n", ehead.section_header_table_entries );
+    printf( "  section header entry size: %u\n", ehead.section_header_table_size );
+    printf( "  section offset: %llu == %llx\n", ehead.section_header_table, ehead.section_header_table );
+    printf( "  flags: %x\n", ehead.flags );
 
-    tracer.Trace( "  <argv data, pointed to by argv array below>         (%ld == %lx bytes)\n", g_arg_data_commit, g_arg_data_commit );
-    tracer.Trace( "  start of argv data:                                 %lx\n", g_base_address + arg_data_offset );
+    g_execution_address = (REG_TYPE) ehead.entry_point;
+    g_compressed_rvc = 0 != ( ehead.flags & 1 ); // 2-byte compressed RVC instructions, not 4-byte default risc-v instructions
+    REG_TYPE memory_size = 0;
 
-    tracer.Trace( "  start of aux data:                                  %lx\n", g_base_address + aux_data_offset );
-    tracer.Trace( "  <random, alignment, aux recs, env, argv>            (%ld == %lx bytes)\n", aux_data_size, aux_data_size );
-    tracer.Trace( "  initial stack pointer g_top_of_stack:               %lx\n", g_top_of_stack );
-    REG_TYPE stack_bytes = g_stack_commit - aux_data_size;
-    tracer.Trace( "  <stack>                                             (%ld == %lx bytes)\n", stack_bytes, stack_bytes );
-    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %lx\n", g_base_address + g_bottom_of_stack );
-    tracer.Trace( "  <unallocated space between brk and the stack>       (%ld == %lx bytes)\n", g_brk_commit, g_brk_commit );
-    tracer.Trace( "  end_of_data / current brk:                          %lx\n", g_base_address + g_end_of_data );
-    REG_TYPE uninitialized_bytes = g_end_of_data - first_uninitialized_data;
-    tracer.Trace( "  <uninitialized data per the .elf file>              (%ld == %lx bytes)\n", uninitialized_bytes, uninitialized_bytes );
-    tracer.Trace( "  first byte of uninitialized data:                   %lx\n", first_uninitialized_data );
-    tracer.Trace( "  <initialized data from the .elf file>\n" );
-    tracer.Trace( "  <code from the .elf file>\n" );
-    tracer.Trace( "  initial pc execution_addess:                        %lx\n", g_execution_address );
-    tracer.Trace( "  <code per the .elf file>\n" );
-    tracer.Trace( "  start of the address space per the .elf file:       %lx\n", elf_base_address );
-    tracer.Trace( "  start of the address space actual:                  %lx\n", g_base_address );
+    printf( "program headers:\n" );
+    printf( "   # Type       Offset   VirtAddr PhysAddr FileSize MemSize  Alignment Flags\n" );
+
+    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+    {
+        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
+        ElfProgramHeader64 head = {0};
+
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read program header" );
 
-    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
-    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
-    tracer.Trace( "memory_size:                     %lx == %ld\n", memory_size, memory_size );
+        head.swap_endianness();
 
-    return true;
-} //load_image32
+        printf( "  %2u", ph );
+        printf( " %-10s", head.show_type() );
+        printf( " %08llx", head.offset_in_image );
+        printf( " %08llx", head.virtual_address );
+        printf( " %08llx", head.physical_address );
+        printf( " %08llx", head.file_size );
+        printf( " %08llx", head.memory_size );
+        printf( " %08llx", head.alignment );
+        printf( "  %s\n", head.show_flags() );
 
-#ifdef M68
+        uint64_t just_past = head.physical_address + head.memory_size;
+        if ( just_past > memory_size )
+            memory_size = (REG_TYPE) just_past;
 
-static bool load_68000_hex( const char * pimage )
-{
-    assert ( 4 == ELF_MACHINE_ISA );
-    FILE * fp = fopen( pimage, "rb" );
-    if ( !fp )
-    {
-        printf( "can't open 68000 hex image file: %s\n", pimage );
-        usage();
+        if ( 0 != head.physical_address )
+        {
+            if ( ( 0 == g_base_address ) || ( g_base_address > head.physical_address ) )
+                g_base_address = (REG_TYPE) head.physical_address;
+        }
     }
 
-    CFile file( fp );
-    char acLine[ 200 ];
-    char ac[ 5 ];
+    memory_size -= g_base_address;
 
-    do
+    // first load the string tables
+
+    vector<char> string_table;
+    vector<char> shstr_table;
+
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
     {
-        char * buf = fgets( acLine, _countof( acLine ), fp );
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        ElfSectionHeader64 head = {0};
 
-        if ( buf && strlen( buf ) >= 8 )
-        {
-            if ( 'S' != buf[ 0 ] )
-                usage( "motorola hex file lines must start with S" );
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
 
-            if ( '0' == acLine[1] )
-            {
-                // ignore
-            }
-            else if ( '1' == acLine[1] )
+        head.swap_endianness();
+        if ( 3 == head.type )
+        {
+            if ( 0 == string_table.size() )
             {
-                ac[ 0 ] = acLine[ 2 ];
-                ac[ 1 ] = acLine[ 3 ];
-                ac[ 2 ] = 0;
-                uint32_t length = strtoul( ac, 0, 16 );
-                length -= 3; // 2-byte address at start and 1-byte checksum at end
-                ac[ 0 ] = acLine[ 4 ];
-                ac[ 1 ] = acLine[ 5 ];
-                ac[ 2 ] = acLine[ 6 ];
-                ac[ 3 ] = acLine[ 7 ];
-                ac[ 4 ] = 0;
-                uint32_t address = strtoul( ac, 0, 16 );
-                memory.resize( address + length );
-                for ( uint32_t i = 0; i < length; i++ )
-                {
-                    ac[ 0 ] = acLine[ 8 + i * 2 ];
-                    ac[ 1 ] = acLine[ 8 + i * 2 + 1 ];
-                    ac[ 2 ] = 0;
-                    uint8_t v = (uint8_t) strtoul( ac, 0, 16 );
-                    memory[ address + i ] = v;
-                }
+                string_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( string_table.data(), 1, head.size, fp );
+                if ( 0 == read )
+                    usage( "can't read string table\n" );
             }
-            else if ( '9' == acLine[1] )
+            else
             {
-                ac[ 0 ] = acLine[ 4 ];
-                ac[ 1 ] = acLine[ 5 ];
-                ac[ 2 ] = acLine[ 6 ];
-                ac[ 3 ] = acLine[ 7 ];
-                ac[ 4 ] = 0;
-                g_execution_address = strtoul( ac, 0, 16 );
+                shstr_table.resize( head.size );
+                fseek( fp, (long) head.offset, SEEK_SET );
+                read = fread( shstr_table.data(), 1, head.size, fp );
+                if ( 0 == read )
+                    usage( "can't read shstr table\n" );
             }
-            else
-                usage( "motorola hex input file format variation not supported" );
         }
-    } while ( !feof( fp ) );
-
-    REG_TYPE memory_size = (REG_TYPE) memory.size();
-
-    if ( memory_size & 0xf )
-    {
-        memory_size += 16;
-        memory_size &= ~0xf;
     }
 
-    g_end_of_data = memory_size;
-    g_brk_offset = memory_size;
-    g_highwater_brk = memory_size;
-    memory_size += g_brk_commit;
-
-    g_bottom_of_stack = memory_size;
-    memory_size += g_stack_commit;
-
-    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
-    g_mmap_offset = memory_size;
-    memory_size += g_mmap_commit;
-
-    memory.resize( memory_size );
-    memset( memory.data() + g_brk_offset, 0, memory_size - g_brk_offset );
+    printf( "section headers:\n" );
+    printf( "   # Name                 Type                             Address  Offset   Size     Flags\n" );
 
-    g_base_address = 0;
-    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
+    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    {
+        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
+        //printf( "section header %u at offset %zu == %zx\n", sh, o, o );
 
-    g_top_of_stack = (REG_TYPE) memory.size();
+        ElfSectionHeader64 head = {0};
 
-    tracer.Trace( "memory map from highest to lowest addresses:\n" );
-    tracer.Trace( "  first byte beyond allocated memory:                 %x\n", g_base_address + memory_size );
-    tracer.Trace( "  <mmap arena>                                        (%d = %x bytes)\n", g_mmap_commit, g_mmap_commit );
-    tracer.Trace( "  mmap start adddress:                                %x\n", g_base_address + g_mmap_offset );
-    tracer.Trace( "  <align to 4k-page for mmap allocations>\n" );
-    tracer.Trace( "  initial stack pointer g_top_of_stack:               %x\n", g_top_of_stack );
-    REG_TYPE stack_bytes = g_stack_commit;
-    tracer.Trace( "  <stack>                                             (%d == %x bytes)\n", stack_bytes, stack_bytes );
-    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %x\n", g_base_address + g_bottom_of_stack );
-    tracer.Trace( "  <unallocated space between brk and the stack>       (%d == %llx bytes)\n", g_brk_commit, g_brk_commit );
-    tracer.Trace( "  end_of_data / current brk:                          %x\n", g_base_address + g_end_of_data );
-    tracer.Trace( "  <code + data from the .hex file>\n" );
-    tracer.Trace( "  initial pc execution_addess:                        %x\n", g_execution_address );
-    tracer.Trace( "  <code per the .hex file>\n" );
-    tracer.Trace( "  start of the address space:                         %x\n", g_base_address );
+        fseek( fp, (long) o, SEEK_SET );
+        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
+        if ( 0 == read )
+            usage( "can't read section header" );
 
-    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
-    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
-    tracer.Trace( "memory_size:                     %#x == %d\n", memory_size, memory_size );
+        head.swap_endianness();
+        printf( "  %2u", sh );
+        printf( " %-20s", & shstr_table[ head.name_offset ] );
+        printf( " %-32s", head.show_type() );
+        printf( " %08llx", head.address );
+        printf( " %08llx", head.offset );
+        printf( " %08llx", head.size );
+        printf( " %#llx / %s\n", head.flags, head.show_flags() );
 
-    return true;
-} //load_68000_hex
+        if ( 2 == head.type ) // symbol table
+        {
+            vector<ElfSymbol64> symbols;
+            symbols.resize( head.size / sizeof( ElfSymbol64 ) );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( symbols.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read symbol table" );
 
-#endif //M68
+            if ( verbose )
+            {
+                size_t count = head.size / sizeof( ElfSymbol64 );
+                printf( "  symbols:\n" );
+                for ( size_t sym = 0; sym < symbols.size(); sym++ )
+                {
+                    printf( "    symbol # %zd\n", sym );
+                    ElfSymbol64 & sym_entry = symbols[ sym ];
 
-#endif // defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
+                    printf( "     name:  %x == %s\n",   sym_entry.name, ( 0 == sym_entry.name ) ? "" : & string_table[ sym_entry.name ] );
+                    printf( "     info:  %x == %s\n",   sym_entry.info, sym_entry.show_info() );
+                    printf( "     other: %x == %s\n",   sym_entry.other, sym_entry.show_other() );
+                    printf( "     shndx: %x\n",   sym_entry.shndx );
+                    printf( "     value: %llx\n", sym_entry.value );
+                    printf( "     size:  %llu\n", sym_entry.size );
+                }
+            }
+        }
+        else if ( 7 == head.type && 0 != head.size && verbose ) // notes
+        {
+            vector<uint8_t> notes( head.size );
+            fseek( fp, (long) head.offset, SEEK_SET );
+            read = fread( notes.data(), 1, head.size, fp );
+            if ( 0 == read )
+                usage( "can't read notes\n" );
+            tracer.PrintBinaryData( notes.data(), (uint32_t) head.size, 4 );
+        }
+    }
 
-static bool load_image( const char * pimage, const char * app_args )
-{
-    tracer.Trace( "loading image %s\n", pimage );
+    if ( 0 == g_base_address )
+        printf( "base address of elf image is zero; physical address required for the emulator\n" );
 
-#ifdef M68
-    if ( ends_with( pimage, ".hex" ) ) // Motorola 68000 hex file special-case
-        return load_68000_hex( pimage ); // app args are lost with hex files
+    printf( "global info\n" );
+    printf( "  flags: %#08x\n", ehead.flags );
+    printf( "    contains 2-byte compressed RVC instructions: %s\n", g_compressed_rvc ? "yes" : "no" );
+    printf( "    contains 4-byte float instructions: %s\n", ( ehead.flags & 2 ) ? "yes" : "no" );
+    printf( "    contains 8-byte double instructions: %s\n", ( ehead.flags & 4 ) ? "yes" : "no" );
+    printf( "    RV TSO memory consistency: %s\n", ( ehead.flags & 0x10 ) ? "yes" : "no" );
+    printf( "    contains non-standard extensions: %s\n", ( ehead.flags & 0xff000000 ) ? "yes" : "no" );
 
-    if ( ends_with( pimage, ".68k" ) || ends_with( pimage, ".rel" ) ) // Digital Research CP/M 68K executable file
-        return load_cpm68k( pimage, app_args );
+    printf( "  vm g_base_address %llx\n", (uint64_t) g_base_address );
+    printf( "  memory_size: %llx\n", (uint64_t) memory_size );
+    printf( "  g_stack_commit: %llx\n", (uint64_t) g_stack_commit );
+    printf( "  g_execution_address %llx\n", (uint64_t) g_execution_address );
 #endif
+} //elf_info
 
-    FILE * fp = fopen( pimage, "rb" );
-    if ( !fp )
-    {
-        printf( "can't open elf image file: %s\n", pimage );
-        usage();
-    }
-
-    CFile file( fp );
-
-    ElfHeader64 ehead = {0};
-    size_t read = fread( &ehead, sizeof ehead, 1, fp );
-    if ( 1 != read )
-        usage( "elf image file is invalid" );
+#if ( defined( X64OS ) || defined( X32OS ) ) && !defined( X64OS_LIBRARY )
 
-    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
-        usage( "elf image file's magic header is invalid" );
+// the code map (see x64::map_code) records instruction lengths and basic block starts of the app's code as it runs.
+// the code cache (-b) keeps the map across runs of the same app. the interpreter decodes each instruction inline and
+// never reads the map, so it doesn't make emulation faster; it costs a little. the map is analysis: -p reports how
+// much of the executed code was cached, and -j translates the blocks that runs with -b found, like targets of
+// indirect jumps that predecoding each function can't see. file layout:
+//   CodeCacheHeader
+//   code_length bytes of code map entries, one per byte of the app's code
+// the file is only used if its hash of the app's code, that code's address, and the emulator build all match.
+// runs that learn something write a new file and rename it into place, so readers never see a partial file.
 
-#if defined( M68 ) || defined( SPARCOS ) || defined( X32OS )
-    if ( 1 == ehead.bit_width )
-        return load_image32( fp, pimage, app_args );
-    else
-        usage( "elf image isn't 32-bit" );
+static const char codeCacheSignature[ 8 ] = { 'x', '6', '4', 'o', 's', 'c', 'm', 0 };
+static const uint64_t codeCacheMaxBytes = 64 * 1024 * 1024; // apps with more code than this aren't mapped or cached
+#ifdef X32OS
+static const bool codeMapIs32 = true;
+#else
+static const bool codeMapIs32 = false;
 #endif
+static EMULATOR_THREAD_LOCAL char g_acCodeCacheFile[ EMULATOR_MAX_PATH ] = {0}; // -b: the code cache
+static EMULATOR_THREAD_LOCAL vector<uint8_t> g_codeMap;     // the code map when the cache file isn't mapped
+static EMULATOR_THREAD_LOCAL uint8_t * g_codeCacheView = 0; // the mapped cache file, including its header
+static EMULATOR_THREAD_LOCAL bool g_codeCacheWarm = false;  // a valid cache file was found at startup
+static EMULATOR_THREAD_LOCAL uint64_t g_codeCacheLoadUs = 0;
 
-#if defined( RVOS ) || defined( ARMOS ) || defined( X64OS )
-    bool big_endian = ( 2 == ehead.endianness );
-    tracer.Trace( "image is %s endian\n", big_endian ? "big" : "little" );
+struct PredecodeRange
+{
+    uint64_t start;
+    uint64_t length;
+};
 
-    ehead.swap_endianness();
+struct CodeCacheHeader
+{
+    char signature[ 8 ];
+    uint64_t code_hash;               // app code bytes, code_start, code_length, cpu mode, and build_string()
+    uint64_t code_start;
+    uint64_t code_length;
+    uint64_t map_hash;                // the entries that follow; catches truncated and damaged files
+};
 
-    if ( 2 != ehead.type )
+static uint64_t hash_bytes( uint64_t h, const void * p, size_t length ) // fnv-1a, a word at a time where possible for speed
+{
+    const uint8_t * pb = (const uint8_t *) p;
+    size_t i = 0;
+    for ( ; i + sizeof( uint64_t ) <= length; i += sizeof( uint64_t ) )
     {
-        printf( "e_type is %d == %s\n", ehead.type, image_type( ehead.type ) );
-        usage( "elf image isn't an executable file (2)" );
+        uint64_t x;
+        memcpy( &x, pb + i, sizeof( x ) );
+        h = ( h ^ x ) * 0x100000001b3ull;
     }
 
-    if ( ELF_MACHINE_ISA != ehead.machine )
+    for ( ; i < length; i++ )
+        h = ( h ^ pb[ i ] ) * 0x100000001b3ull;
+    return h;
+} //hash_bytes
+
+static void code_cache_header( CodeCacheHeader & h )
+{
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.signature, codeCacheSignature, sizeof( h.signature ) );
+    h.code_start = g_code_start;
+    h.code_length = g_code_end - g_code_start;
+
+    bool mode32 = codeMapIs32;
+    uint64_t hash = hash_bytes( 0xcbf29ce484222325ull, memory.data() + g_code_start - g_base_address, (size_t) h.code_length );
+    hash = hash_bytes( hash, &h.code_start, sizeof( h.code_start ) );
+    hash = hash_bytes( hash, &h.code_length, sizeof( h.code_length ) );
+    hash = hash_bytes( hash, &mode32, sizeof( mode32 ) );
+    h.code_hash = hash_bytes( hash, build_string(), strlen( build_string() ) );
+} //code_cache_header
+
+static uint8_t * map_code_cache( const char * pfile, const CodeCacheHeader & expected )
+{
+    uint64_t file_size = sizeof( expected ) + expected.code_length;
+
+#ifdef _WIN32
+    FILE * fp = fopen( pfile, "rb" );
+    if ( !fp )
+        return 0;
+
+    CFile file( fp );
+    g_codeMap.resize( (size_t) file_size );
+    if ( ( 1 != fread( g_codeMap.data(), g_codeMap.size(), 1, fp ) ) || ( EOF != fgetc( fp ) ) )
+        return 0;
+
+    uint8_t * pbase = g_codeMap.data();
+#else
+    int fd = open( pfile, O_RDONLY );
+    if ( fd < 0 )
+        return 0;
+
+    struct stat st;
+    if ( ( 0 != fstat( fd, &st ) ) || ( (uint64_t) st.st_size != file_size ) )
     {
-        printf( "machine found: %#x\n", ehead.machine );
-        usage( "elf image machine ISA doesn't match this emulator" );
+        close( fd );
+        return 0;
     }
 
-    if ( 0 == ehead.entry_point )
-        usage( "elf entry point is 0, which is invalid" );
+    // a private writable mapping lets the run update entries in place without touching the file
 
-    tracer.Trace( "header fields:\n" );
-    tracer.Trace( "  entry address: %llx\n", ehead.entry_point );
-    tracer.Trace( "  program entries: %u\n", ehead.program_header_table_entries );
-    tracer.Trace( "  program header entry size: %u\n", ehead.program_header_table_size );
-    tracer.Trace( "  program offset: %llu == %llx\n", ehead.program_header_table, ehead.program_header_table );
-    tracer.Trace( "  section entries: %u\n", ehead.section_header_table_entries );
-    tracer.Trace( "  section header entry size: %u\n", ehead.section_header_table_size );
-    tracer.Trace( "  section offset: %llu == %llx\n", ehead.section_header_table, ehead.section_header_table );
-    tracer.Trace( "  section with section names: %u == %x\n", ehead.section_with_section_names, ehead.section_with_section_names );
-    tracer.Trace( "  flags: %x\n", ehead.flags );
-    g_execution_address = (REG_TYPE) ehead.entry_point;
-    g_compressed_rvc = 0 != ( ehead.flags & 1 ); // 2-byte compressed RVC instructions, not 4-byte default risc-v instructions
+    void * pmap = mmap( 0, (size_t) file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( MAP_FAILED == pmap )
+        return 0;
 
-    // determine how much RAM to allocate
+    uint8_t * pbase = (uint8_t *) pmap;
+#endif
 
-    REG_TYPE memory_size = 0;
+    CodeCacheHeader & h = * (CodeCacheHeader *) pbase;
+    if ( ( 0 == memcmp( &h, &expected, offsetof( CodeCacheHeader, map_hash ) ) ) &&
+         ( h.map_hash == hash_bytes( 0xcbf29ce484222325ull, pbase + sizeof( h ), (size_t) h.code_length ) ) )
+        return pbase;
 
-    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
-    {
-        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
-        tracer.Trace( "program header %u at offset %u\n", ph, (unsigned) o );
+    tracer.Trace( "  code cache %s is stale or damaged; ignoring it\n", pfile );
+#ifndef _WIN32
+    munmap( pmap, (size_t) file_size );
+#endif
+    return 0;
+} //map_code_cache
 
-        ElfProgramHeader64 head = {0};
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), 1, fp );
-        if ( 1 != read )
-            usage( "can't read program header" );
+static void app_functions( vector<PredecodeRange> & functions )
+{
+    for ( size_t i = 0; i < g_symbols.size(); i++ )
+        if ( 2 == ( g_symbols[ i ].info & 0xf ) && g_symbols[ i ].value >= g_code_start && g_symbols[ i ].value < g_code_end ) // STT_FUNC
+            functions.push_back( { g_symbols[ i ].value, g_symbols[ i ].size } );
 
-        head.swap_endianness();
+    for ( size_t i = 0; i < g_symbols32.size(); i++ )
+        if ( 2 == ( g_symbols32[ i ].info & 0xf ) && g_symbols32[ i ].value >= g_code_start && g_symbols32[ i ].value < g_code_end )
+            functions.push_back( { g_symbols32[ i ].value, g_symbols32[ i ].size } );
 
-        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
-        tracer.Trace( "  offset in image: %llx\n", head.offset_in_image );
-        tracer.Trace( "  virtual address: %llx\n", head.virtual_address );
-        tracer.Trace( "  physical address: %llx\n", head.physical_address );
-        tracer.Trace( "  file size: %llx\n", head.file_size );
-        tracer.Trace( "  memory size: %llx\n", head.memory_size );
-        tracer.Trace( "  alignment: %llx\n", head.alignment );
+    if ( functions.empty() && g_execution_address >= g_code_start && g_execution_address < g_code_end ) // stripped app
+        functions.push_back( { g_execution_address, (uint64_t) ( g_code_end - g_execution_address ) } );
+} //app_functions
 
-        if ( 2 == head.type )
-        {
-            printf( "dynamic linking is not supported by this emulator. link your app with -static\n" );
-            exit( 1 );
-        }
+static void open_code_map( CPUClass & cpu, const char * pfile ) // pfile is the cache file or 0
+{
+    high_resolution_clock::time_point tStart = high_resolution_clock::now();
+    CodeCacheHeader h;
+    code_cache_header( h );
+    if ( 0 == h.code_length || h.code_length > codeCacheMaxBytes )
+    {
+        tracer.Trace( "  app code size %llu is too large for a code map\n", h.code_length );
+        return;
+    }
 
-        uint64_t just_past = head.physical_address + head.memory_size;
-        if ( just_past > memory_size )
-            memory_size = just_past;
+    uint8_t * pbase = pfile ? map_code_cache( pfile, h ) : 0;
+    g_codeCacheWarm = ( 0 != pbase );
+#ifndef _WIN32
+    g_codeCacheView = pbase;
+#endif
 
-        if ( ( 0 != head.physical_address ) && ( ( 0 == g_base_address ) || g_base_address > head.physical_address ) )
-            g_base_address = (REG_TYPE) head.physical_address;
+    uint8_t * pmap = 0;
+    if ( g_codeCacheWarm )
+        pmap = pbase + sizeof( h );
+    else
+    {
+        g_codeMap.assign( (size_t) ( h.code_length + sizeof( h ) ), 0 );
+        pmap = g_codeMap.data() + sizeof( h );
     }
 
-    if ( 0 == g_base_address )
-        usage( "base address of elf image is invalid; physical address required" );
+    cpu.set_code_map( pmap, g_code_start, h.code_length );
+    g_codeCacheLoadUs = duration_cast<std::chrono::microseconds>( high_resolution_clock::now() - tStart ).count();
+    tracer.Trace( "code map of %llu bytes of code at %llx. cache %s is %s\n", h.code_length, h.code_start, pfile ? pfile : "(none)", g_codeCacheWarm ? "warm" : "cold" );
+} //open_code_map
 
-    memory_size -= g_base_address;
-    tracer.Trace( "memory_size of content to load from elf file: %llx\n", memory_size );
+static void close_code_map( CPUClass & cpu, const char * pfile )
+{
+    uint64_t length = g_code_end - g_code_start;
+    uint8_t * pbase = g_codeCacheView ? g_codeCacheView : g_codeMap.data();
+    if ( 0 == pbase )
+        return;
 
-    // first load the string table
-    vector<char> section_names_string_table;
+    cpu.set_code_map( 0, 0, 0 );
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
-    {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        ElfSectionHeader64 head = {0};
+    // drop what only applies to this run, then write the file only if something was learned
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+    CodeCacheHeader & h = * (CodeCacheHeader *) pbase;
+    if ( pfile )
+    {
+        uint64_t previous_hash = g_codeCacheWarm ? h.map_hash : 0;
+        code_cache_header( h );
+        uint8_t * pmap = pbase + sizeof( h );
+        for ( uint64_t i = 0; i < length; i++ )
+            pmap[ i ] = ( 0 == ( pmap[ i ] & CPUClass::code_map_length ) ) ? 0 : (uint8_t) ( pmap[ i ] & ~CPUClass::code_map_run );
 
-        head.swap_endianness();
-        if ( 3 == head.type )
+        h.map_hash = hash_bytes( 0xcbf29ce484222325ull, pmap, (size_t) length );
+        if ( !g_codeCacheWarm || h.map_hash != previous_hash )
         {
-            if ( sh == ehead.section_with_section_names )
+            char actemp[ EMULATOR_MAX_PATH + 32 ];
+            snprintf( actemp, sizeof( actemp ), "%s.%d.tmp", pfile, (int) getpid() );
+            FILE * fp = fopen( actemp, "wb" );
+            bool ok = ( 0 != fp );
+            if ( ok )
             {
-                section_names_string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( section_names_string_table.data(), head.size, 1, fp );
-                if ( 1 != read )
-                    usage( "can't read string table\n" );
-
-                tracer.Trace( "section names string table:\n" );
-                tracer.TraceBinaryData( (uint8_t *) section_names_string_table.data(), (uint32_t) head.size, 4 );
+                ok = ( 1 == fwrite( pbase, (size_t) ( sizeof( h ) + length ), 1, fp ) );
+                ok = ( 0 == fclose( fp ) ) && ok;
             }
-            else
-            {
-                g_string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( g_string_table.data(), head.size, 1, fp );
-                if ( 1 != read )
-                    usage( "can't read string table\n" );
 
-                tracer.Trace( "main string table:\n" );
-                tracer.TraceBinaryData( (uint8_t *) g_string_table.data(), (uint32_t) head.size, 4 );
+#ifdef _WIN32
+            remove( pfile ); // windows rename() won't replace an existing file
+#endif
+            if ( !ok || ( 0 != rename( actemp, pfile ) ) )
+            {
+                tracer.Trace( "  unable to write code cache %s, errno %d\n", pfile, errno );
+                remove( actemp );
             }
         }
     }
 
-    // load the symbol data into RAM
+#ifndef _WIN32
+    if ( g_codeCacheView )
+        munmap( g_codeCacheView, (size_t) ( sizeof( h ) + length ) );
+    g_codeCacheView = 0;
+#endif
+    vector<uint8_t>().swap( g_codeMap );
+} //close_code_map
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
-    {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        tracer.Trace( "section header %zu at offset %zu == %zx\n", sh, o, o );
+#ifdef X64OS
 
-        ElfSectionHeader64 head = {0};
+// -j writes the app's basic blocks as C++ (see x64::translate). mtran.sh compiles that file into an x64os built with
+// X64OS_TRANSLATED, which runs the translated blocks in place of interpreting them. the file only applies to the exact
+// app it came from, so it includes a hash of the app's code that's checked before the blocks are used.
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+static EMULATOR_THREAD_LOCAL char g_acTranslationFile[ EMULATOR_MAX_PATH ] = {0}; // -j: the file to write
 
-        head.swap_endianness();
-        tracer.Trace( "  type: %x / %s\n", head.type, head.show_type() );
-        tracer.Trace( "  name %s, offset: %x\n", & section_names_string_table[ head.name_offset ], head.name_offset );
-        tracer.Trace( "  flags: %llx / %s\n", head.flags, head.show_flags() );
-        tracer.Trace( "  address: %llx\n", head.address );
-        tracer.Trace( "  offset: %llx\n", head.offset );
-        tracer.Trace( "  size: %llx\n", head.size );
-        tracer.Trace( "  link: %x\n", head.link );
-        tracer.Trace( "  info: %x\n", head.info );
-        tracer.Trace( "  address_alignment: %llx\n", head.address_alignment );
-        tracer.Trace( "  entry_size: %llx\n", head.entry_size );
+static uint64_t translation_hash()
+{
+    uint64_t start = g_code_start;
+    uint64_t length = g_code_end - g_code_start;
+    uint64_t hash = hash_bytes( 0xcbf29ce484222325ull, memory.data() + g_code_start - g_base_address, (size_t) length );
+    hash = hash_bytes( hash, &start, sizeof( start ) );
+    return hash_bytes( hash, &length, sizeof( length ) );
+} //translation_hash
+
+static bool translate_app( CPUClass & cpu, const char * pfile, const char * papp )
+{
+    uint64_t length = g_code_end - g_code_start;
+    if ( 0 == length || length > codeCacheMaxBytes )
+    {
+        printf( "app code size %llu is too large to translate\n", (unsigned long long) length );
+        return false;
+    }
 
-        if ( !strcmp( ".tbss", & section_names_string_table[ head.name_offset ] ) )
-            tracer.Trace( "tbss: %#llx, size %#llx\n", head.address, head.size );
+    // predecode every function to find the blocks, then translate each block and each point where a block resumes
 
-        if ( 2 == head.type )
+    vector<uint8_t> map( (size_t) length, 0 );
+    const uint8_t * pcode = memory.data() + g_code_start - g_base_address;
+    vector<PredecodeRange> functions;
+    app_functions( functions );
+    for ( size_t i = 0; i < functions.size(); i++ )
+        CPUClass::predecode( map.data(), pcode, g_code_start, length, functions[ i ].start, functions[ i ].length, codeMapIs32 );
+
+    // add what earlier runs with -b found, like the targets of indirect jumps and calls
+
+    if ( 0 != g_acCodeCacheFile[ 0 ] )
+    {
+        CodeCacheHeader h;
+        code_cache_header( h );
+        uint8_t * pbase = map_code_cache( g_acCodeCacheFile, h );
+        if ( pbase )
         {
-            g_symbols.resize( head.size / sizeof( ElfSymbol64 ) );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( g_symbols.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read symbol table" );
+            uint64_t added = 0;
+            const uint8_t * pcached = pbase + sizeof( h );
+            for ( uint64_t o = 0; o < length; o++ )
+            {
+                if ( ( pcached[ o ] & CPUClass::code_map_block ) && !( map[ o ] & CPUClass::code_map_block ) )
+                    added++;
+                if ( pcached[ o ] & CPUClass::code_map_length )
+                    map[ o ] |= pcached[ o ];
+            }
+#ifndef _WIN32
+            munmap( pbase, (size_t) ( sizeof( h ) + length ) );
+#endif
+            printf( "the code cache %s added %llu block starts\n", g_acCodeCacheFile, (unsigned long long) added );
         }
+        else
+            printf( "the code cache %s is missing or doesn't match the app; translating without it\n", g_acCodeCacheFile );
     }
 
-    // void out the entries that don't have symbol names or have mangled names that start with $
+    cpu.set_code_map( map.data(), g_code_start, length );
 
-    for ( size_t se = 0; se < g_symbols.size(); se++ )
+    vector<uint64_t> work;
+    vector<bool> queued( (size_t) length, false );
+    for ( uint64_t o = 0; o < length; o++ )
     {
-        g_symbols[se].swap_endianness();
-
-        if ( ( 0 == g_symbols[se].name ) || ( '$' == g_string_table[ g_symbols[se].name ] ) )
-            g_symbols[se].value = 0;
+        if ( ( map[ o ] & CPUClass::code_map_block ) && ( map[ o ] & CPUClass::code_map_length ) )
+        {
+            work.push_back( g_code_start + o );
+            queued[ o ] = true;
+        }
     }
 
-    // use known qsort so traces are consistent across platforms because qsort implementations for ties differ
-
-    my_qsort( g_symbols.data(), g_symbols.size(), sizeof( ElfSymbol64 ), symbol_compare );
-
-    // remove symbols that don't look like they have a valid addresses (rust binaries have tens of thousands of these)
-
-    size_t to_erase = 0;
-    for ( size_t se = 0; se < g_symbols.size(); se++ )
+    FILE * fp = fopen( pfile, "w" );
+    if ( !fp )
     {
-        if ( g_symbols[ se ].value < g_base_address )
-            to_erase++;
-        else
-            break;
+        cpu.set_code_map( 0, 0, 0 );
+        printf( "can't create translation file %s, errno %d\n", pfile, errno );
+        return false;
     }
 
-    if ( to_erase > 0 )
-        g_symbols.erase( g_symbols.begin(), g_symbols.begin() + to_erase );
-
-    // set the size of each symbol if it's not already set
+    fprintf( fp, "// %s translated by x64os -j. build it into x64os with mtran.sh\n\n", papp );
+    fprintf( fp, "#include <stdint.h>\n#include <stdio.h>\n#include <stdlib.h>\n#include <memory.h>\n#include <assert.h>\n" );
+    fprintf( fp, "#include <math.h>\n#include <limits>\n#include <type_traits>\n\n" );
+    fprintf( fp, "#include <djl_128.hxx>\n#include <djltrace.hxx>\n#include \"x64.hxx\"\n\n" );
+    fprintf( fp, "struct x64_translated\n{\n" );
 
-    for ( size_t se = 0; se < g_symbols.size(); se++ )
+    vector<uint64_t> blocks;
+    uint64_t instructions = 0;
+    string code;
+    for ( size_t w = 0; w < work.size(); w++ )
     {
-        if ( 0 == g_symbols[se].size )
+        uint64_t resume = 0;
+        uint64_t count = cpu.translate( code, work[ w ], resume );
+        if ( 0 != resume && !queued[ resume - g_code_start ] )
         {
-            if ( se < ( g_symbols.size() - 1 ) )
-                g_symbols[se].size = g_symbols[ se + 1 ].value - g_symbols[ se ].value;
-            else
-                g_symbols[se].size = g_base_address + memory_size - g_symbols[ se ].value;
+            work.push_back( resume );
+            queued[ resume - g_code_start ] = true;
         }
-    }
 
-    tracer.Trace( "elf image has %u usable symbols:\n", (unsigned) g_symbols.size() );
-    tracer.Trace( "             address              size  name\n" );
+        if ( code.empty() )
+            continue;
 
-    for ( size_t se = 0; se < g_symbols.size(); se++ )
-        tracer.Trace( "    %16llx  %16llx  %s\n", g_symbols[ se ].value, g_symbols[ se ].size, & g_string_table[ g_symbols[ se ].name ] );
+        fprintf( fp, "    static uint64_t t_%llx( x64 & cpu )\n    {\n%s    }\n\n", (unsigned long long) work[ w ], code.c_str() );
+        blocks.push_back( work[ w ] );
+        instructions += count;
+    }
 
-    // memory map from high to low addresses:
-    //     <end of allocated memory>
-    //     (memory for mmap fulfillment)
-    //     g_mmap_offset
-    //     (wasted space so g_mmap_offset is 4k-aligned)
-    //     Linux start data on the stack (see details below)
-    //     g_top_of_stack
-    //     g_bottom_of_stack
-    //     (unallocated space between brk and the bottom of the stack)
-    //     g_brk_offset with uninitialized RAM (just after arg_data_offset initially)
-    //     g_end_of_data
-    //     arg_data_offset
-    //     uninitalized data bss (size read from the .elf file)
-    //     initialized data (size & data read from the .elf file)
-    //     code (read from the .elf file)
-    //     g_base_address (offset read from the .elf file).
+    fprintf( fp, "};\n\n" );
+    cpu.set_code_map( 0, 0, 0 );
 
-    // stacks by convention on arm64 and risc-v are 16-byte aligned. make sure to start aligned
+    // an open-addressed table at most half full, probed the same way as x64::find_translation
 
-    if ( memory_size & 0xf )
+    uint64_t size = 2;
+    while ( size < 2 * blocks.size() )
+        size *= 2;
+    vector<uint64_t> table( (size_t) size, 0 );
+    for ( size_t b = 0; b < blocks.size(); b++ )
     {
-        memory_size += 16;
-        memory_size &= ~0xf;
+        uint64_t i = CPUClass::translation_slot( blocks[ b ] ) & ( size - 1 );
+        while ( 0 != table[ i ] )
+            i = ( i + 1 ) & ( size - 1 );
+        table[ i ] = blocks[ b ];
     }
 
-    uint64_t arg_data_offset = memory_size;
-    memory_size += g_arg_data_commit;
-    g_end_of_data = memory_size;
-    g_brk_offset = memory_size;
-    g_highwater_brk = memory_size;
-    memory_size += g_brk_commit;
+    fprintf( fp, "extern const x64::translation x64_translations[] =\n{\n" );
+    for ( size_t i = 0; i < table.size(); i++ )
+    {
+        if ( 0 == table[ i ] )
+            fprintf( fp, "    { 0, 0 },\n" );
+        else
+            fprintf( fp, "    { 0x%llx, x64_translated::t_%llx },\n", (unsigned long long) table[ i ], (unsigned long long) table[ i ] );
+    }
+    fprintf( fp, "};\n\n" );
+    fprintf( fp, "extern const uint64_t x64_translation_mask = 0x%llx;\n", (unsigned long long) ( size - 1 ) );
+    fprintf( fp, "extern const uint64_t x64_translation_hash = 0x%llx;\n", (unsigned long long) translation_hash() );
 
-    g_bottom_of_stack = memory_size;
-    memory_size += g_stack_commit;
+    bool ok = ( 0 == ferror( fp ) );
+    ok = ( 0 == fclose( fp ) ) && ok;
+    if ( !ok )
+        printf( "unable to write translation file %s, errno %d\n", pfile, errno );
+    else
+        printf( "translated %zu blocks with %llu instructions to %s\n", blocks.size(), (unsigned long long) instructions, pfile );
+    return ok;
+} //translate_app
 
-    uint64_t top_of_aux = memory_size;
-    memory_size = round_up( memory_size, (REG_TYPE) 4096 ); // mmap should hand out 4k-aligned pages
-    g_mmap_offset = memory_size;
-    memory_size += g_mmap_commit;
+#ifdef X64OS_TRANSLATED
 
-    memory.resize( memory_size );
-    memset( memory.data(), 0, memory_size );
+extern const x64::translation x64_translations[];
+extern const uint64_t x64_translation_mask;
+extern const uint64_t x64_translation_hash;
 
-    g_mmap.initialize( g_base_address + g_mmap_offset, g_mmap_commit, memory.data() - g_base_address );
+static void use_translations( CPUClass & cpu )
+{
+    if ( x64_translation_hash == translation_hash() )
+        cpu.set_translations( x64_translations, x64_translation_mask );
+    else
+        tracer.Trace( "  the translated code is for a different app; interpreting instead\n" );
+} //use_translations
 
-    // load the program into RAM
+#endif //X64OS_TRANSLATED
 
-    uint64_t first_uninitialized_data = 0;
+#endif //X64OS
 
-    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
-    {
-        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
-        ElfProgramHeader64 head = {0};
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
-        head.swap_endianness();
+// -u profiles the app's heap without changing it. call hooks (see x64::set_call_hooks) on malloc, calloc, realloc,
+// free, posix_memalign, aligned_alloc, memalign, and operator new and delete note each call's arguments and, through
+// a return hook, its result. only the outermost hooked call counts, so new calling malloc or realloc calling malloc
+// is one allocation. each allocation is charged to a call site: the caller, then up to heapFrames - 1 more callers
+// found by scanning the stack for return addresses that follow a call into the prior frame's function. apps rarely
+// keep frame pointers, so frames past the first are a best guess: stale return addresses can linger on the stack.
+// the report at exit has peak live bytes by call site, the allocation rate over time, what was still allocated,
+// and the brk and mmap highwater marks for sizing -h and -m.
+
+enum HeapKind { heapMalloc, heapCalloc, heapRealloc, heapFree, heapMemalign, heapPosixMemalign };
+
+struct HeapFunction
+{
+    const char * name;
+    HeapKind kind;
+};
 
-        // head.type 1 == load. Other entries will overlap and even have physical addresses, but they are redundant
+static const HeapFunction heapFunctions[] =
+{
+    { "malloc", heapMalloc }, { "calloc", heapCalloc }, { "realloc", heapRealloc }, { "free", heapFree },
+    { "posix_memalign", heapPosixMemalign }, { "aligned_alloc", heapMemalign }, { "memalign", heapMemalign },
+
+    // operator new and delete. size_t is m for 64-bit apps and j for 32-bit apps. new's size and delete's pointer are the first argument
+
+    { "_Znwm", heapMalloc }, { "_Znam", heapMalloc }, { "_ZnwmRKSt9nothrow_t", heapMalloc }, { "_ZnamRKSt9nothrow_t", heapMalloc },
+    { "_ZnwmSt11align_val_t", heapMalloc }, { "_ZnamSt11align_val_t", heapMalloc },
+    { "_Znwj", heapMalloc }, { "_Znaj", heapMalloc }, { "_ZnwjRKSt9nothrow_t", heapMalloc }, { "_ZnajRKSt9nothrow_t", heapMalloc },
+    { "_ZnwjSt11align_val_t", heapMalloc }, { "_ZnajSt11align_val_t", heapMalloc },
+    { "_ZdlPv", heapFree }, { "_ZdaPv", heapFree }, { "_ZdlPvm", heapFree }, { "_ZdaPvm", heapFree }, { "_ZdlPvj", heapFree }, { "_ZdaPvj", heapFree },
+    { "_ZdlPvSt11align_val_t", heapFree }, { "_ZdaPvSt11align_val_t", heapFree },
+    { "_ZdlPvmSt11align_val_t", heapFree }, { "_ZdaPvmSt11align_val_t", heapFree }, { "_ZdlPvjSt11align_val_t", heapFree }, { "_ZdaPvjSt11align_val_t", heapFree },
+};
 
-        if ( 0 != head.file_size && 0 != head.physical_address && 1 == head.type )
-        {
-            fseek( fp, (long) head.offset_in_image, SEEK_SET );
-            read = fread( memory.data() + head.physical_address - g_base_address, 1, head.file_size, fp );
-            if ( 0 == read )
-                usage( "can't read image" );
+const size_t heapFrames = 4;          // call site depth
+const size_t heapScanWords = 256;     // how far up the stack to look for callers
+const size_t heapIntervals = 32;      // the allocation rate table has at most this many rows
 
-            first_uninitialized_data = get_max( head.physical_address + head.file_size, first_uninitialized_data );
+struct HeapSite
+{
+    uint64_t frames[ heapFrames ];    // return addresses, the caller first. 0 past the last one found
+    uint64_t allocations;
+    uint64_t bytes;                   // allocated in total
+    uint64_t live;                    // bytes allocated and not yet freed
+    uint64_t live_blocks;
+    uint64_t peak_live;
+};
 
-            tracer.Trace( "  read type %s: %llx bytes into physical address %llx - %llx then uninitialized to %llx \n", head.show_type(), head.file_size,
-                          head.physical_address, head.physical_address + head.file_size - 1, head.physical_address + head.memory_size - 1 );
-            tracer.TraceBinaryData( memory.data() + head.physical_address - g_base_address, get_min( (uint32_t) head.file_size, (uint32_t) 128 ), 4 );
-        }
-    }
+struct HeapBlock
+{
+    uint64_t size;
+    size_t site;
+};
 
-    // write the command-line arguments into the vm memory in a place where _start can find them.
-    // there's an array of pointers to the args followed by the arg strings at offset arg_data_offset.
+struct HeapCall                       // a hooked call that hasn't returned yet
+{
+    bool active;
+    HeapKind kind;
+    uint64_t sp;                      // the stack pointer at entry, which points at the return address
+    uint64_t args[ 3 ];
+    size_t site;
+};
 
-    const uint32_t max_args = 40;
-    REG_TYPE aargs[ max_args ]; // vm pointers to each arguments
-    char * buffer_args = (char *) ( memory.data() + arg_data_offset );
-    size_t image_len = strlen( pimage );
-    vector<char> full_command( 2 + image_len + strlen( app_args ) );
-    strcpy( full_command.data(), pimage );
-    backslash_to_slash( full_command.data() );
-    full_command[ image_len ] = ' ';
-    strcpy( full_command.data() + image_len + 1, app_args );
+struct HeapInterval
+{
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t frees;
+    uint64_t live;                    // live bytes at the end of the interval
+};
 
-    strcpy( buffer_args, full_command.data() );
-    char * pargs = buffer_args;
-    size_t args_len = strlen( buffer_args );
+static EMULATOR_THREAD_LOCAL bool g_heapProfile = false;               // -u
+static EMULATOR_THREAD_LOCAL vector<uint64_t> g_heapHookAddresses;      // sorted, for the cpu
+static EMULATOR_THREAD_LOCAL vector<HeapKind> g_heapHookKinds;          // parallel to g_heapHookAddresses
+static EMULATOR_THREAD_LOCAL vector<HeapSite> g_heapSites;
+static EMULATOR_THREAD_LOCAL map<vector<uint64_t>, size_t> g_heapSiteIndex;
+static EMULATOR_THREAD_LOCAL map<uint64_t, HeapBlock> g_heapBlocks;     // live blocks by address
+static EMULATOR_THREAD_LOCAL HeapCall g_heapCall;
+static EMULATOR_THREAD_LOCAL vector<HeapInterval> g_heapIntervals;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapIntervalMs = 1;             // doubles when the table fills
+static EMULATOR_THREAD_LOCAL high_resolution_clock::time_point g_heapStart;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapAllocations = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapBytes = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapFrees = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapFailed = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapUnknownFrees = 0;           // pointers the profiler never saw allocated
+static EMULATOR_THREAD_LOCAL uint64_t g_heapLive = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapPeakLive = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapPeakBlocks = 0;
+static EMULATOR_THREAD_LOCAL uint64_t g_heapPeakMs = 0;
+
+static bool heap_address_valid( uint64_t address, uint64_t length )
+{
+    return ( address >= g_base_address ) && ( address + length <= g_base_address + memory.size() ) && ( address + length > address );
+} //heap_address_valid
 
-    uint64_t app_argc = 0;
-    while ( *pargs && app_argc < max_args )
-    {
-        while ( ' ' == *pargs )
-            pargs++;
+static uint64_t heap_read_pointer( CPUClass & cpu, uint64_t address )
+{
+    if ( !heap_address_valid( address, sizeof( REG_TYPE ) ) )
+        return 0;
+#ifdef X32OS
+    return cpu.getui32( address );
+#else
+    return cpu.getui64( address );
+#endif
+} //heap_read_pointer
 
-        char * space = strchr( pargs, ' ' );
-        if ( space )
-            *space = 0;
+static uint64_t heap_arg( CPUClass & cpu, size_t i )
+{
+#ifdef X32OS
+    return heap_read_pointer( cpu, ACCESS_REG( x64::rsp ) + 4 + 4 * i ); // cdecl: after the return address
+#else
+    static const size_t regs[] = { x64::rdi, x64::rsi, x64::rdx };
+    return ACCESS_REG( regs[ i ] );
+#endif
+} //heap_arg
 
-        uint64_t offset = pargs - buffer_args;
-        aargs[ app_argc ] = offset + g_base_address + arg_data_offset;
-        tracer.Trace( "  argument %llu is '%s', at vm address %llx\n", app_argc, pargs, (uint64_t) offset + g_base_address + arg_data_offset );
+static bool heap_called_from( CPUClass & cpu, uint64_t address, uint64_t callee )
+{
+    // could the instruction before return address address have called the function holding callee? a direct call
+    // (e8 rel32) must target that function's start. an indirect one (ff /2, with a rex prefix, sib, or displacement)
+    // can't be checked, so it's trusted. this skips most stale return addresses left on the stack by earlier calls
 
-        app_argc++;
-        pargs += strlen( pargs );
+    if ( address < g_code_start + 7 || address > g_code_end )
+        return false;
 
-        if ( space )
-            pargs++;
+    uint8_t * p = cpu.getmem( address );
+    if ( 0xe8 == p[ -5 ] )
+    {
+        uint64_t offset = 0;
+        const char * psymbol = emulator_symbol_lookup( callee, offset );
+        uint64_t target = (uint64_t) ( address + (int32_t) ( p[ -4 ] | ( p[ -3 ] << 8 ) | ( p[ -2 ] << 16 ) | ( (uint32_t) p[ -1 ] << 24 ) ) );
+#ifdef X32OS
+        target &= 0xffffffff;
+#endif
+        if ( 0 == psymbol[ 0 ] || target == callee - offset )
+            return true;
     }
 
-    uint64_t env_offset = args_len + 1;
-    char * penv_data = (char *) ( buffer_args + env_offset );
-    strcpy( penv_data, "OS=" );
-    strcat( penv_data, APP_NAME );
-    uint64_t env_os_address = ( penv_data - (char *) memory.data() ) + g_base_address;
-    uint64_t env_count = 1;
-    uint64_t env_tz_address = 0;
+    static const size_t back[] = { 2, 3, 4, 6, 7 };
+    for ( size_t i = 0; i < _countof( back ); i++ )
+        if ( 0xff == p[ - (ptrdiff_t) back[ i ] ] && 2 == ( ( p[ 1 - (ptrdiff_t) back[ i ] ] >> 3 ) & 7 ) )
+            return true;
 
-     // The local time zone is found by libc on Linux/MacOS, but not on Windows.
-     // Workaround: set the TZ environment variable.
+    return false;
+} //heap_called_from
 
-#ifdef _WIN32
-    DYNAMIC_TIME_ZONE_INFORMATION tzi = {0};
-    DWORD dw = GetDynamicTimeZoneInformation( &tzi );
-    if ( TIME_ZONE_ID_INVALID != dw )
+static size_t heap_site( CPUClass & cpu, uint64_t sp )
+{
+    static EMULATOR_THREAD_LOCAL vector<uint64_t> frames( heapFrames );
+    frames.assign( heapFrames, 0 );
+    frames[ 0 ] = heap_read_pointer( cpu, sp );
+
+    size_t found = 1;
+    for ( size_t w = 1; w <= heapScanWords && found < heapFrames; w++ )
     {
-        char acName[ 32 ] = {0};
-        if ( TIME_ZONE_ID_STANDARD == dw )
-            wcstombs( acName, tzi.StandardName, sizeof( acName ) );
-        else if ( TIME_ZONE_ID_DAYLIGHT == dw )
-            wcstombs( acName, tzi.DaylightName, sizeof( acName ) );
-        else if ( TIME_ZONE_ID_UNKNOWN == dw )
-            strcpy( acName, "local" );
+        uint64_t slot = sp + w * sizeof( REG_TYPE );
+        if ( slot >= g_top_of_stack || !heap_address_valid( slot, sizeof( REG_TYPE ) ) )
+            break;
 
-        if ( 0 != acName[ 0 ] )
-        {
-            char * ptz_data = penv_data + 1 + strlen( penv_data );
-            env_tz_address = ( ptz_data - (char *) memory.data() ) + g_base_address;
-            strcpy( ptz_data, "TZ=" );
+        uint64_t value = heap_read_pointer( cpu, slot );
+        if ( heap_called_from( cpu, value, frames[ found - 1 ] ) )
+            frames[ found++ ] = value;
+    }
 
-            // libc doesn't like spaces in spite of the doc saying it's OK:
-            // https://ftp.gnu.org/old-gnu/Manuals/glibc-2.2.3/html_node/libc_431.html
+    map<vector<uint64_t>, size_t>::iterator it = g_heapSiteIndex.find( frames );
+    if ( it != g_heapSiteIndex.end() )
+        return it->second;
 
-            remove_spaces( acName );
-            strcat( (char *) ptz_data, acName );
+    HeapSite site = {};
+    memcpy( site.frames, frames.data(), sizeof( site.frames ) );
+    g_heapSites.push_back( site );
+    g_heapSiteIndex[ frames ] = g_heapSites.size() - 1;
+    return g_heapSites.size() - 1;
+} //heap_site
 
-            if ( tzi.Bias >= 0 )
-                strcat( (char *) ptz_data, "+" );
-            itoa( tzi.Bias / 60, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
-            int minutes = abs( tzi.Bias % 60 );
-            if ( 0 != minutes )
+static HeapInterval & heap_interval()
+{
+    uint64_t ms = duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - g_heapStart ).count();
+    while ( ms / g_heapIntervalMs >= heapIntervals ) // merge pairs and double the width
+    {
+        for ( size_t i = 0; i < g_heapIntervals.size(); i += 2 )
+        {
+            HeapInterval & merged = g_heapIntervals[ i / 2 ];
+            merged = g_heapIntervals[ i ];
+            if ( i + 1 < g_heapIntervals.size() )
             {
-                strcat( ptz_data, ":" );
-                itoa( minutes, (char *) ( ptz_data + strlen( ptz_data ) ), 10 );
+                merged.allocations += g_heapIntervals[ i + 1 ].allocations;
+                merged.bytes += g_heapIntervals[ i + 1 ].bytes;
+                merged.frees += g_heapIntervals[ i + 1 ].frees;
+                merged.live = g_heapIntervals[ i + 1 ].live;
             }
-            tracer.Trace( "ptz_data: '%s'\n", ptz_data );
-            env_count++;
         }
+        g_heapIntervals.resize( ( g_heapIntervals.size() + 1 ) / 2 );
+        g_heapIntervalMs *= 2;
     }
-#endif
 
-    tracer.Trace( "args_len %d, penv_data %p\n", args_len, penv_data );
-    tracer.TraceBinaryData( (uint8_t *) ( memory.data() + arg_data_offset ), g_arg_data_commit + 0x20, 4 ); // +20 to inspect for bugs
+    size_t i = (size_t) ( ms / g_heapIntervalMs );
+    while ( g_heapIntervals.size() <= i )
+    {
+        HeapInterval interval = {};
+        interval.live = g_heapLive;
+        g_heapIntervals.push_back( interval );
+    }
+    return g_heapIntervals[ i ];
+} //heap_interval
 
-    // put the Linux startup info at the top of the stack. this consists of (from high to low):
-    //   two 8-byte random numbers used for stack and pointer guards
-    //   optional filler to make sure alignment of all startup info is 16 bytes
-    //   AT_NULL aux record
-    //   AT_RANDOM aux record -- point to the 2 random 8-byte numbers above
-    //   AT_PAGESZ aux record -- golang runtime fails if it can't find the page size here
-    //   0 environment termination
-    //   0..n environment string pointers
-    //   0 argv termination
-    //   1..n argv string pointers
-    //   argc  <<<==== sp should point here when the entrypoint (likely _start) is invoked
+static void heap_remove( uint64_t address )
+{
+    if ( 0 == address )
+        return;
 
-    uint64_t * pstack = (uint64_t *) ( memory.data() + top_of_aux );
+    map<uint64_t, HeapBlock>::iterator it = g_heapBlocks.find( address );
+    if ( it == g_heapBlocks.end() ) // a double free, or memory from before a checkpoint
+    {
+        g_heapUnknownFrees++;
+        return;
+    }
 
-    pstack--;
-    *pstack = rand64();
-    pstack--;
-    *pstack = rand64();
-    uint64_t prandom = g_base_address + memory_size - 16;
+    HeapSite & site = g_heapSites[ it->second.site ];
+    site.live -= it->second.size;
+    site.live_blocks--;
+    g_heapLive -= it->second.size;
+    g_heapFrees++;
+    g_heapBlocks.erase( it );
 
-    // ensure that after all of this the stack is 16-byte aligned
+    HeapInterval & interval = heap_interval();
+    interval.frees++;
+    interval.live = g_heapLive;
+} //heap_remove
 
-    if ( 0 == ( 1 & ( app_argc + env_count ) ) )
-        pstack--;
+static void heap_add( uint64_t address, uint64_t size, size_t site_index )
+{
+    if ( g_heapBlocks.count( address ) ) // the profiler missed its free
+        heap_remove( address );
 
-    pstack -= 2; // the AT_NULL record will be here since memory is initialized to 0
+    HeapBlock block = { size, site_index };
+    g_heapBlocks[ address ] = block;
 
-    pstack -= 16; // for 8 aux records
-    AuxProcessStart * paux = (AuxProcessStart *) pstack;
-    paux[0].a_type = 25; // AT_RANDOM
-    paux[0].a_un.a_val = prandom;
-    paux[0].swap_endianness();
-    paux[1].a_type = 6; // AT_PAGESZ
-    paux[1].a_un.a_val = 4096;
-    paux[1].swap_endianness();
-    paux[2].a_type = 16; // AT_HWCAP
-    paux[2].a_un.a_val = 0xa01; // ARM64 bits for fp(0), atomics(8), cpuid(11)
-    paux[2].swap_endianness();
-    paux[3].a_type = 26; // AT_HWCAP2
-    paux[3].a_un.a_val = 0;
-    paux[3].swap_endianness();
-    paux[4].a_type = 11; // AT_UID
-    paux[4].a_un.a_val = 0x595a5449; // "ITZY" they are each my bias.
-    paux[4].swap_endianness();
-    paux[5].a_type = 22; // AT_EUID;
-    paux[5].a_un.a_val = 0x595a5449;
-    paux[5].swap_endianness();
-    paux[6].a_type = 13; // AT_GID
-    paux[6].a_un.a_val = 0x595a5449;
-    paux[6].swap_endianness();
-    paux[7].a_type = 14; // AT_EGID
-    paux[7].a_un.a_val = 0x595a5449;
-    paux[7].swap_endianness();
+    HeapSite & site = g_heapSites[ site_index ];
+    site.allocations++;
+    site.bytes += size;
+    site.live += size;
+    site.live_blocks++;
+    if ( site.live > site.peak_live )
+        site.peak_live = site.live;
 
-    pstack--; // end of environment data is 0
-    pstack--; // move to where the first environment variable is
+    g_heapAllocations++;
+    g_heapBytes += size;
+    g_heapLive += size;
 
-    if ( 0 != env_tz_address )
+    HeapInterval & interval = heap_interval();
+    interval.allocations++;
+    interval.bytes += size;
+    interval.live = g_heapLive;
+
+    if ( g_heapLive > g_heapPeakLive )
     {
-        *pstack = swap_endian64( env_tz_address );
-        tracer.Trace( "the TZ environment argument is at VM address %llx\n", env_tz_address );
-        pstack--;
+        g_heapPeakLive = g_heapLive;
+        g_heapPeakBlocks = g_heapBlocks.size();
+        g_heapPeakMs = duration_cast<std::chrono::milliseconds>( high_resolution_clock::now() - g_heapStart ).count();
     }
+} //heap_add
 
-    // point to the OS= environment variable location
-    *pstack = swap_endian64( env_os_address );
-    tracer.Trace( "the OS environment argument is at VM address %llx\n", *pstack );
-
-    pstack--; // the last argv is 0 to indicate the end
-
-    for ( int iarg = (int) app_argc - 1; iarg >= 0; iarg-- )
+static void heap_return( CPUClass & cpu )
+{
+    uint64_t sp = ACCESS_REG( x64::rsp );
+    if ( sp != g_heapCall.sp + sizeof( REG_TYPE ) ) // a jump to the return address from somewhere else. wait for the real return
     {
-        pstack--;
-        *pstack = swap_endian64( aargs[ iarg ] );
+        cpu.set_return_hook( cpu.rip.q );
+        return;
     }
 
-    pstack--;
-    *pstack = swap_endian64( app_argc );
-
-    g_top_of_stack = (uint64_t) ( ( (uint8_t *) pstack - memory.data() ) + g_base_address );
-    uint64_t aux_data_size = top_of_aux - (uint64_t) ( (uint8_t *) pstack - memory.data() );
-    tracer.Trace( "stack at start (beginning with argc) -- %llu bytes at address %p:\n", aux_data_size, pstack );
-    tracer.TraceBinaryData( (uint8_t *) pstack, (uint32_t) aux_data_size, 2 );
-
-    tracer.Trace( "memory map from highest to lowest addresses:\n" );
-    tracer.Trace( "  first byte beyond allocated memory:                 %llx\n", g_base_address + memory_size );
-    tracer.Trace( "  <mmap arena>                                        (%lld = %llx bytes)\n", g_mmap_commit, g_mmap_commit );
-    tracer.Trace( "  mmap start adddress:                                %llx\n", g_base_address + g_mmap_offset );
-    tracer.Trace( "  <align to 4k-page for mmap allocations>\n" );
-    tracer.Trace( "  start of aux data:                                  %llx\n", g_top_of_stack + aux_data_size );
-    tracer.Trace( "  <random, alignment, aux recs, env, argv>            (%lld == %llx bytes)\n", aux_data_size, aux_data_size );
-    tracer.Trace( "  initial stack pointer g_top_of_stack:               %llx\n", g_top_of_stack );
-    uint64_t stack_bytes = g_stack_commit - aux_data_size;
-    tracer.Trace( "  <stack>                                             (%lld == %llx bytes)\n", stack_bytes, stack_bytes );
-    tracer.Trace( "  last byte stack can use (g_bottom_of_stack):        %llx\n", g_base_address + g_bottom_of_stack );
-    tracer.Trace( "  <unallocated space between brk and the stack>       (%lld == %llx bytes)\n", g_brk_commit, g_brk_commit );
-    tracer.Trace( "  end_of_data / current brk:                          %llx\n", g_base_address + g_end_of_data );
-    uint64_t argv_bytes = g_end_of_data - arg_data_offset;
-    tracer.Trace( "  <argv data, pointed to by argv array above>         (%lld == %llx bytes)\n", argv_bytes, argv_bytes );
-    tracer.Trace( "  start of argv data:                                 %llx\n", g_base_address + arg_data_offset );
-    uint64_t uninitialized_bytes = g_base_address + arg_data_offset - first_uninitialized_data;
-    tracer.Trace( "  <uninitialized data per the .elf file>              (%lld == %llx bytes)\n", uninitialized_bytes, uninitialized_bytes );
-    tracer.Trace( "  first byte of uninitialized data:                   %llx\n", first_uninitialized_data );
-    tracer.Trace( "  <initialized data from the .elf file>\n" );
-    tracer.Trace( "  <code from the .elf file>\n" );
-    tracer.Trace( "  initial pc execution_addess:                        %llx\n", g_execution_address );
-    tracer.Trace( "  <code per the .elf file>\n" );
-    tracer.Trace( "  start of the address space per the .elf file:       %llx\n", g_base_address );
+    g_heapCall.active = false;
+    uint64_t result = ACCESS_REG( x64::rax );
+    uint64_t * args = g_heapCall.args;
 
-    tracer.Trace( "vm memory first byte beyond:     %p\n", memory.data() + memory_size );
-    tracer.Trace( "vm memory start:                 %p\n", memory.data() );
-    tracer.Trace( "memory_size:                     %#llx == %lld\n", memory_size, memory_size );
-    tracer.Trace( "risc-v compressed instructions:  %s\n", g_compressed_rvc ? "yes" : "no" );
-
-#endif //M68
-
-    return true;
-} //load_image
+    switch ( g_heapCall.kind )
+    {
+        case heapMalloc:
+        case heapCalloc:
+        case heapMemalign:
+        {
+            uint64_t size = args[ 0 ];
+            if ( heapCalloc == g_heapCall.kind )
+                size = args[ 0 ] * args[ 1 ];
+            else if ( heapMemalign == g_heapCall.kind )
+                size = args[ 1 ];
 
-static void elf_info32( FILE * fp, bool verbose )
-{
-    ElfHeader32 ehead = {0};
-    fseek( fp, (long) 0, SEEK_SET );
-    size_t read = fread( &ehead, 1, sizeof ehead, fp );
+            if ( 0 != result )
+                heap_add( result, size, g_heapCall.site );
+            else
+                g_heapFailed++;
+            break;
+        }
+        case heapRealloc:
+        {
+            if ( 0 != result )
+            {
+                heap_remove( args[ 0 ] );
+                heap_add( result, args[ 1 ], g_heapCall.site );
+            }
+            else if ( 0 == args[ 1 ] ) // realloc( p, 0 ) frees p
+                heap_remove( args[ 0 ] );
+            else
+                g_heapFailed++;
+            break;
+        }
+        case heapPosixMemalign:
+        {
+            if ( 0 == (uint32_t) result )
+                heap_add( heap_read_pointer( cpu, args[ 0 ] ), args[ 2 ], g_heapCall.site );
+            else
+                g_heapFailed++;
+            break;
+        }
+        default:
+            break;
+    }
+} //heap_return
 
-    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+void emulator_call_hook( CPUClass & cpu, uint64_t address, bool returned )
+{
+    if ( returned )
     {
-        printf( "image file's magic header is invalid: %x\n", ehead.magic );
+        heap_return( cpu );
         return;
     }
 
-    bool big_endian = ( 2 == ehead.endianness );
-    printf( "image is %s endian\n", big_endian ? "big" : "little" );
+    uint64_t sp = ACCESS_REG( x64::rsp );
+    if ( g_heapCall.active )
+    {
+        if ( sp < g_heapCall.sp ) // called by the allocator itself
+            return;
 
-    ehead.swap_endianness();
-    if ( ELF_MACHINE_ISA != ehead.machine )
-        printf( "image machine ISA isn't a match for %s; continuing anyway. machine type is %x\n", APP_NAME, ehead.machine );
+        g_heapCall.active = false; // longjmp or an exception left the pending call without returning
+        cpu.set_return_hook( 0 );
+    }
 
-    printf( "header fields:\n" );
-    printf( "  bit_width: %u\n", ehead.bit_width );
-    printf( "  type: %u\n", ehead.type );
-    printf( "  entry address: %#x\n", ehead.entry_point );
-    printf( "  program entries: %u\n", ehead.program_header_table_entries );
-    printf( "  program header entry size: %u\n", ehead.program_header_table_size );
-    printf( "  program offset: %u == %x\n", ehead.program_header_table, ehead.program_header_table );
-    printf( "  section entries: %u\n", ehead.section_header_table_entries );
-    printf( "  section header entry size: %u\n", ehead.section_header_table_size );
-    printf( "  section offset: %u == %#x\n", ehead.section_header_table, ehead.section_header_table );
-    printf( "  flags: %#x\n", ehead.flags );
+    size_t i = lower_bound( g_heapHookAddresses.begin(), g_heapHookAddresses.end(), address ) - g_heapHookAddresses.begin();
+    HeapKind kind = g_heapHookKinds[ i ];
+    if ( heapFree == kind ) // frees are noted now; the return is hooked so delete's call to free is ignored
+        heap_remove( heap_arg( cpu, 0 ) );
 
-    g_execution_address = ehead.entry_point;
-    REG_TYPE memory_size = 0;
+    g_heapCall.active = true;
+    g_heapCall.kind = kind;
+    g_heapCall.sp = sp;
+    for ( size_t a = 0; a < _countof( g_heapCall.args ); a++ )
+        g_heapCall.args[ a ] = heap_arg( cpu, a );
+    g_heapCall.site = ( heapFree == kind ) ? 0 : heap_site( cpu, sp );
+    cpu.set_return_hook( heap_read_pointer( cpu, sp ) );
+} //emulator_call_hook
 
-    printf( "program headers:\n" );
-    printf( "   # Type       Offset   VirtAddr PhysAddr FileSize MemSize  Alignment Flags\n" );
+static void start_heap_profile( CPUClass & cpu )
+{
+    vector<pair<uint64_t, HeapKind>> hooks;
 
-    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+#ifdef X32OS
+    for ( size_t s = 0; s < g_symbols32.size(); s++ )
     {
-        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
-        ElfProgramHeader32 head = {0};
+        uint64_t address = g_symbols32[ s ].value;
+        const char * pname = & g_string_table[ g_symbols32[ s ].name ];
+#else
+    for ( size_t s = 0; s < g_symbols.size(); s++ )
+    {
+        uint64_t address = g_symbols[ s ].value;
+        const char * pname = & g_string_table[ g_symbols[ s ].name ];
+#endif
+        if ( 0 == address )
+            continue;
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read program header" );
+        for ( size_t f = 0; f < _countof( heapFunctions ); f++ )
+        {
+            if ( !strcmp( pname, heapFunctions[ f ].name ) )
+            {
+                hooks.push_back( pair<uint64_t, HeapKind>( address, heapFunctions[ f ].kind ) );
+                tracer.Trace( "  heap profile hooks %s at %llx\n", pname, address );
+                break;
+            }
+        }
+    }
 
-        head.swap_endianness();
+    sort( hooks.begin(), hooks.end() );
+    for ( size_t h = 0; h < hooks.size(); h++ )
+    {
+        if ( 0 != h && hooks[ h ].first == hooks[ h - 1 ].first ) // aliases like free and cfree
+            continue;
+        g_heapHookAddresses.push_back( hooks[ h ].first );
+        g_heapHookKinds.push_back( hooks[ h ].second );
+    }
 
-        printf( "  %2u", ph );
-        printf( " %-10s", head.show_type() );
-        printf( " %08x", head.offset_in_image );
-        printf( " %08x", head.virtual_address );
-        printf( " %08x", head.physical_address );
-        printf( " %08x", head.file_size );
-        printf( " %08x", head.memory_size );
-        printf( " %08x", head.alignment );
-        printf( "  %s\n", head.show_flags() );
+    if ( 0 == g_heapHookAddresses.size() )
+        printf( "heap profile: the app has no malloc or free symbols. is it stripped?\n" );
 
-        REG_TYPE just_past = head.physical_address + head.memory_size;
-        if ( just_past > memory_size )
-            memory_size = just_past;
+    g_heapStart = high_resolution_clock::now();
+    cpu.set_call_hooks( g_heapHookAddresses.data(), g_heapHookAddresses.size() );
+} //start_heap_profile
 
-        if ( 0 != head.physical_address )
-        {
-            if ( ( 0 == g_base_address ) || ( g_base_address > head.physical_address ) )
-                g_base_address = head.physical_address;
-        }
-    }
+static void show_heap_frame( const char * prefix, uint64_t address )
+{
+    uint64_t offset = 0;
+    const char * psymbol = emulator_symbol_lookup( address, offset );
+    printf( "%s%llx %s + %llx %s\n", prefix, address, psymbol, offset, emulator_line_lookup( address ) );
+} //show_heap_frame
 
-    memory_size -= g_base_address;
+static void show_heap_site( const HeapSite & site )
+{
+    show_heap_frame( "", site.frames[ 0 ] );
+    for ( size_t f = 1; f < heapFrames && 0 != site.frames[ f ]; f++ )
+        show_heap_frame( "          from ", site.frames[ f ] );
+} //show_heap_site
 
-    // first load the string tables
+static bool heap_peak_greater( const HeapSite * a, const HeapSite * b ) { return a->peak_live > b->peak_live; }
+static bool heap_live_greater( const HeapSite * a, const HeapSite * b ) { return a->live > b->live; }
 
-    vector<char> string_table;
-    vector<char> shstr_table;
+static void show_heap_profile()
+{
+    const size_t maxSites = 20;
+    const uint64_t meg = 1024 * 1024;
+    char ac[ 100 ], ac2[ 100 ], ac3[ 100 ], ac4[ 100 ];
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
-    {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        ElfSectionHeader32 head = {0};
+    printf( "heap profile:\n" );
+    printf( "  allocations:         %15s\n", CDJLTrace::RenderNumberWithCommas( g_heapAllocations, ac ) );
+    printf( "  bytes allocated:     %15s\n", CDJLTrace::RenderNumberWithCommas( g_heapBytes, ac ) );
+    printf( "  frees:               %15s\n", CDJLTrace::RenderNumberWithCommas( g_heapFrees, ac ) );
+    printf( "  failed allocations:  %15s\n", CDJLTrace::RenderNumberWithCommas( g_heapFailed, ac ) );
+    printf( "  peak live bytes:     %15s in %s blocks at %s ms\n", CDJLTrace::RenderNumberWithCommas( g_heapPeakLive, ac ),
+            CDJLTrace::RenderNumberWithCommas( g_heapPeakBlocks, ac2 ), CDJLTrace::RenderNumberWithCommas( g_heapPeakMs, ac3 ) );
+    printf( "  leaked at exit:      %15s in %s blocks\n", CDJLTrace::RenderNumberWithCommas( g_heapLive, ac ),
+            CDJLTrace::RenderNumberWithCommas( g_heapBlocks.size(), ac2 ) );
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+    // the allocator's own overhead and fragmentation are in the highwater marks, so size -h and -m from them
 
-        head.swap_endianness();
+    uint64_t brk = g_highwater_brk - g_end_of_data;
+    uint64_t mmap = g_mmap.peak_usage();
+    printf( "  brk highwater:       %15s bytes. -h:%llu is enough\n", CDJLTrace::RenderNumberWithCommas( brk, ac ), ( brk + meg - 1 ) / meg );
+    printf( "  mmap highwater:      %15s bytes. -m:%llu is enough\n", CDJLTrace::RenderNumberWithCommas( mmap, ac ), ( mmap + meg - 1 ) / meg );
 
-        if ( 3 == head.type )
-        {
-            if ( 0 == string_table.size() )
-            {
-                string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( string_table.data(), 1, head.size, fp );
-                if ( 0 == read )
-                    usage( "can't read string table\n" );
-            }
-            else
-            {
-                shstr_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( shstr_table.data(), 1, head.size, fp );
-                if ( 0 == read )
-                    usage( "can't read shstr table\n" );
-            }
-        }
+    vector<const HeapSite *> sites;
+    for ( size_t s = 0; s < g_heapSites.size(); s++ )
+        if ( 0 != g_heapSites[ s ].allocations )
+            sites.push_back( & g_heapSites[ s ] );
+
+    sort( sites.begin(), sites.end(), heap_peak_greater );
+    printf( "call sites by peak live bytes. callers past the first are found on the stack and may be stale:\n" );
+    printf( "       peak live     allocations     bytes allocated  call site\n" );
+    for ( size_t s = 0; s < sites.size() && s < maxSites; s++ )
+    {
+        printf( "  %14s  %14s  %18s  ", CDJLTrace::RenderNumberWithCommas( sites[ s ]->peak_live, ac ),
+                CDJLTrace::RenderNumberWithCommas( sites[ s ]->allocations, ac2 ), CDJLTrace::RenderNumberWithCommas( sites[ s ]->bytes, ac3 ) );
+        show_heap_site( *sites[ s ] );
     }
 
-    printf( "section headers:\n" );
-    printf( "   # Name                 Type                             Address  Offset   Size     Flags\n" );
+    printf( "allocation rate by elapsed milliseconds:\n" );
+    printf( "              ms     allocations     bytes allocated           frees   live bytes at end\n" );
+    for ( size_t i = 0; i < g_heapIntervals.size(); i++ )
+    {
+        HeapInterval & interval = g_heapIntervals[ i ];
+        printf( "  %14llu  %14s  %18s  %14s  %18s\n", i * g_heapIntervalMs, CDJLTrace::RenderNumberWithCommas( interval.allocations, ac ),
+                CDJLTrace::RenderNumberWithCommas( interval.bytes, ac2 ), CDJLTrace::RenderNumberWithCommas( interval.frees, ac3 ),
+                CDJLTrace::RenderNumberWithCommas( interval.live, ac4 ) );
+    }
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
+    sort( sites.begin(), sites.end(), heap_live_greater );
+    printf( "leaked blocks at exit by call site:\n" );
+    printf( "    leaked bytes          blocks  call site\n" );
+    for ( size_t s = 0; s < sites.size() && s < maxSites && 0 != sites[ s ]->live; s++ )
     {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        //printf( "section header %u at offset %u == %x\n", sh, (unsigned) o, (unsigned) o );
+        printf( "  %14s  %14s  ", CDJLTrace::RenderNumberWithCommas( sites[ s ]->live, ac ), CDJLTrace::RenderNumberWithCommas( sites[ s ]->live_blocks, ac2 ) );
+        show_heap_site( *sites[ s ] );
+    }
 
-        ElfSectionHeader32 head = {0};
+    if ( 0 != g_heapUnknownFrees )
+        printf( "  %llu frees of memory the profiler didn't see allocated\n", g_heapUnknownFrees );
+} //show_heap_profile
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+#endif // ( X64OS || X32OS ) && !X64OS_LIBRARY
 
-        head.swap_endianness();
+#ifdef X64OS_LIBRARY
 
-        printf( "  %2u", sh );
-        printf( " %-20s", & shstr_table[ head.name_offset ] );
-        printf( " %-32s", head.show_type() );
-        printf( " %08x", head.address );
-        printf( " %08x", head.offset );
-        printf( " %08x", head.size );
-        printf( " %#x / %s\n", head.flags, head.show_flags() );
+// the emulator's state lives in EMULATOR_THREAD_LOCAL globals, so an X64OSVM owns its thread's globals while it exists
 
-        if ( 2 == head.type ) // symbol table
-        {
-            vector<ElfSymbol32> symbols;
-            symbols.resize( head.size / sizeof( ElfSymbol32 ) );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( symbols.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read symbol table" );
+struct X64OSVMState
+{
+    unique_ptr<CPUClass> cpu;
+    char acAppArgs[ 1024 ];
+    char acError[ 256 ];
+    uint64_t instructions;
+    bool failed;
+};
 
-            if ( verbose )
-            {
-                size_t count = head.size / sizeof( ElfSymbol32 );
-                printf( "  symbols:\n" );
-                for ( size_t sym = 0; sym < symbols.size(); sym++ )
-                {
-                    printf( "    symbol # %zd\n", sym );
-                    ElfSymbol32 & sym_entry = symbols[ sym ];
-                    sym_entry.swap_endianness();
+static EMULATOR_THREAD_LOCAL X64OSVM * g_threadVM = 0;
 
-                    printf( "     name:  %x == %s\n",   sym_entry.name, ( 0 == sym_entry.name ) ? "" : & string_table[ sym_entry.name ] );
-                    printf( "     info:  %x == %s\n",   sym_entry.info, sym_entry.show_info() );
-                    printf( "     other: %x == %s\n",   sym_entry.other, sym_entry.show_other() );
-                    printf( "     shndx: %x\n",   sym_entry.shndx );
-                    printf( "     value: %x\n", sym_entry.value );
-                    printf( "     size:  %u\n", sym_entry.size );
-                }
-            }
-        }
-        else if ( 7 == head.type && 0 != head.size && verbose ) // notes
-        {
-            vector<uint8_t> notes( head.size );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( notes.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read notes\n" );
-            tracer.PrintBinaryData( notes.data(), (uint32_t) head.size, 4 );
-        }
+void emulator_call_hook( CPUClass & cpu, uint64_t address, bool returned ) {} // the library doesn't set call hooks
+
+static void reset_emulator_state()
+{
+#if !defined( _WIN32 ) && !defined( OLDGCC )
+    while ( g_dirStreams.size() )
+        close_dir_stream( g_dirStreams[ 0 ].descriptor );
+#endif
+
+    vfs_reset();
+
+    for ( size_t i = 0; i < g_openFiles.size(); i++ )
+        close( g_openFiles[ i ].descriptor );
+
+    g_openFiles.clear();
+    g_environment.clear();
+    g_stack_commit = 128 * 1024;
+    g_brk_commit = 40 * 1024 * 1024;
+    g_mmap_commit = 40 * 1024 * 1024;
+    g_terminate = false;
+    g_exit_code = 0;
+    vector<uint8_t>().swap( memory );
+    g_base_address = 0;
+    g_execution_address = 0;
+    g_brk_offset = 0;
+    g_mmap_offset = 0;
+    g_highwater_brk = 0;
+    g_end_of_data = 0;
+    g_code_start = 0;
+    g_code_end = 0;
+    g_bottom_of_stack = 0;
+    g_top_of_stack = 0;
+    g_mmap = CMMap();
+    g_string_table.clear();
+    g_symbols.clear();
+    g_symbols32.clear();
+    memset( &g_user_desc, 0, sizeof( g_user_desc ) );
+    g_acCheckpointFile[ 0 ] = 0;
+    g_syscallOverride = 0;
+    g_syscallOverrideContext = 0;
+    g_outputSink = 0;
+    g_outputSinkContext = 0;
+} //reset_emulator_state
+
+X64OSVM::X64OSVM()
+{
+    if ( 0 != g_threadVM )
+        throw runtime_error( "only one X64OSVM can exist at a time on a given thread" );
+
+    g_threadVM = this;
+    reset_emulator_state();
+    state = new X64OSVMState();
+    state->acAppArgs[ 0 ] = 0;
+    state->acError[ 0 ] = 0;
+    state->instructions = 0;
+    state->failed = false;
+} //X64OSVM
+
+X64OSVM::~X64OSVM()
+{
+    if ( state->cpu )
+    {
+        state->cpu->set_instruction_limit( 0 );
+        state->cpu->trace_instructions( false );
     }
 
-    printf( "global info\n" );
-    printf( "  flags: %#08x\n", ehead.flags );
+    delete state;
+    reset_emulator_state();
+    g_threadVM = 0;
+} //~X64OSVM
 
-    printf( "  vm g_base_address %llx\n", (uint64_t) g_base_address );
-    printf( "  memory_size: %llx\n", (uint64_t) memory_size );
-    printf( "  g_stack_commit: %llx\n", (uint64_t) g_stack_commit );
-    printf( "  g_execution_address %llx\n", (uint64_t) g_execution_address );
-} //elf_info32
+bool X64OSVM::set_args( const char * app_args )
+{
+    if ( strlen( app_args ) >= ( g_arg_data_commit / 2 ) ) // leave room for argv[0], OS=, and TZ=
+        return false;
 
-static void elf_info( const char * pimage, bool verbose )
+    strcpy( state->acAppArgs, app_args );
+    return true;
+} //set_args
+
+bool X64OSVM::add_environment( const char * name_equals_value )
 {
-    ElfHeader64 ehead = {0};
+    if ( 0 == strchr( name_equals_value, '=' ) )
+        return false;
 
-    FILE * fp = fopen( pimage, "rb" );
-    if ( !fp )
-        usage( "can't open image file" );
+    g_environment.insert( g_environment.end(), name_equals_value, name_equals_value + strlen( name_equals_value ) + 1 );
+    return true;
+} //add_environment
 
-    CFile file( fp );
-    size_t read = fread( &ehead, 1, sizeof ehead, fp );
-    if ( 0 == read )
+void X64OSVM::set_memory( uint64_t heap_meg, uint64_t mmap_meg, uint64_t stack_kb )
+{
+    g_brk_commit = (REG_TYPE) ( get_min( heap_meg, (uint64_t) 1024 ) * 1024 * 1024 );
+    g_mmap_commit = (REG_TYPE) ( get_min( mmap_meg, (uint64_t) 1024 ) * 1024 * 1024 );
+    g_stack_commit = (REG_TYPE) ( get_max( (uint64_t) 1, get_min( stack_kb, (uint64_t) 1024 ) ) * 1024 );
+} //set_memory
+
+void X64OSVM::set_syscall_override( X64OSSyscallOverride fn, void * context )
+{
+    g_syscallOverride = fn;
+    g_syscallOverrideContext = context;
+} //set_syscall_override
+
+void X64OSVM::set_output_sink( X64OSOutputSink fn, void * context )
+{
+    g_outputSink = fn;
+    g_outputSinkContext = context;
+} //set_output_sink
+
+bool X64OSVM::add_mount( const char * app_path, const char * preload )
+{
+    string spec( app_path );
+    if ( preload )
+        spec += string( "=" ) + preload;
+
+    return vfs_mount( spec.c_str() );
+} //add_mount
+
+static bool load_vm( X64OSVMState * state, const char * pimage, FILE * fp )
+{
+    if ( state->cpu )
     {
-        printf( "image file is invalid; can't read data\n" );
-        return;
+        if ( fp )
+            fclose( fp );
+        strcpy( state->acError, "an app is already loaded" );
+        return false;
     }
 
-    if ( 1 == ehead.bit_width )
+    if ( strlen( pimage ) >= ( g_arg_data_commit / 4 ) )
     {
-        elf_info32( fp, verbose );
-        return;
+        if ( fp )
+            fclose( fp );
+        strcpy( state->acError, "app name is too long" );
+        return false;
     }
 
-#ifndef M68
-
-    if ( 0x464c457f != ehead.magic && 0x7f454c46 != ehead.magic )
+    try
     {
-        printf( "image file's magic header is invalid: %x\n", ehead.magic );
-        return;
-    }
+        if ( !load_image( pimage, state->acAppArgs, fp ) )
+        {
+            strcpy( state->acError, "unable to load the app" );
+            return false;
+        }
 
-    if ( 1 != ehead.endianness )
+        state->cpu.reset( new CPUClass( memory, g_base_address, g_execution_address, g_stack_commit, g_top_of_stack ) );
+#if defined( X32OS )
+        state->cpu->Mode32( true );
+#endif
+    }
+    catch ( exception & e )
     {
-        printf( "expected a little-endian image\n" );
-        return;
+        snprintf( state->acError, sizeof( state->acError ), "%s", e.what() );
+        return false;
     }
 
-    ehead.swap_endianness();
-
-    printf( "machine isa: %#x\n", ehead.machine );
+    return true;
+} //load_vm
 
-    if ( ELF_MACHINE_ISA != ehead.machine )
-        printf( "image machine ISA isn't a match for %s; continuing anyway. machine type is %x\n", APP_NAME, ehead.machine );
+bool X64OSVM::load( const char * path )
+{
+    return load_vm( state, path, 0 );
+} //load
 
-    printf( "header fields:\n" );
-    printf( "  bit_width: %u\n", ehead.bit_width );
-    printf( "  type: %u\n", ehead.type );
-    printf( "  entry address: %llx\n", ehead.entry_point );
-    printf( "  program entries: %u\n", ehead.program_header_table_entries );
-    printf( "  program header entry size: %u\n", ehead.program_header_table_size );
-    printf( "  program offset: %llu == %llx\n", ehead.program_header_table, ehead.program_header_table );
-    printf( "  section entries: %u\n", ehead.section_header_table_entries );
-    printf( "  section header entry size: %u\n", ehead.section_header_table_size );
-    printf( "  section offset: %llu == %llx\n", ehead.section_header_table, ehead.section_header_table );
-    printf( "  flags: %x\n", ehead.flags );
+bool X64OSVM::load( const void * image, size_t length, const char * name )
+{
+#ifdef _WIN32
+    strcpy( state->acError, "loading from a buffer isn't supported on Windows" );
+    return false;
+#else
+    FILE * fp = fmemopen( (void *) image, length, "rb" );
+    if ( !fp )
+    {
+        strcpy( state->acError, "unable to open the image buffer" );
+        return false;
+    }
 
-    g_execution_address = (REG_TYPE) ehead.entry_point;
-    g_compressed_rvc = 0 != ( ehead.flags & 1 ); // 2-byte compressed RVC instructions, not 4-byte default risc-v instructions
-    REG_TYPE memory_size = 0;
+    return load_vm( state, name, fp );
+#endif
+} //load
 
-    printf( "program headers:\n" );
-    printf( "   # Type       Offset   VirtAddr PhysAddr FileSize MemSize  Alignment Flags\n" );
+X64OSRunResult X64OSVM::run( uint64_t instruction_budget )
+{
+    if ( state->failed )
+        return x64osError;
 
-    for ( uint16_t ph = 0; ph < ehead.program_header_table_entries; ph++ )
+    if ( !state->cpu )
     {
-        size_t o = ehead.program_header_table + ( ph * ehead.program_header_table_size );
-        ElfProgramHeader64 head = {0};
+        strcpy( state->acError, "no app is loaded" );
+        return x64osError;
+    }
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.program_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read program header" );
+    if ( g_terminate )
+        return x64osExited;
 
-        head.swap_endianness();
+    try
+    {
+        state->cpu->set_instruction_limit( instruction_budget );
+        uint64_t executed = state->cpu->run();
+        state->instructions += executed;
 
-        printf( "  %2u", ph );
-        printf( " %-10s", head.show_type() );
-        printf( " %08llx", head.offset_in_image );
-        printf( " %08llx", head.virtual_address );
-        printf( " %08llx", head.physical_address );
-        printf( " %08llx", head.file_size );
-        printf( " %08llx", head.memory_size );
-        printf( " %08llx", head.alignment );
-        printf( "  %s\n", head.show_flags() );
+        if ( g_terminate )
+            return x64osExited;
 
-        uint64_t just_past = head.physical_address + head.memory_size;
-        if ( just_past > memory_size )
-            memory_size = (REG_TYPE) just_past;
+        if ( ( 0 != instruction_budget ) && ( executed == instruction_budget ) )
+            return x64osBudgetExhausted;
 
-        if ( 0 != head.physical_address )
-        {
-            if ( ( 0 == g_base_address ) || ( g_base_address > head.physical_address ) )
-                g_base_address = (REG_TYPE) head.physical_address;
-        }
+        return x64osHalted;
+    }
+    catch ( exception & e )
+    {
+        snprintf( state->acError, sizeof( state->acError ), "%s", e.what() );
     }
 
-    memory_size -= g_base_address;
-
-    // first load the string tables
-
-    vector<char> string_table;
-    vector<char> shstr_table;
+    state->failed = true; // the app's state is unknown after an exception
+    return x64osError;
+} //run
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
-    {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        ElfSectionHeader64 head = {0};
+int X64OSVM::exit_code() { return g_exit_code; }
+uint64_t X64OSVM::instructions() { return state->instructions; }
+const char * X64OSVM::error() { return state->acError; }
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+#else // X64OS_LIBRARY
 
-        head.swap_endianness();
-        if ( 3 == head.type )
-        {
-            if ( 0 == string_table.size() )
-            {
-                string_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( string_table.data(), 1, head.size, fp );
-                if ( 0 == read )
-                    usage( "can't read string table\n" );
-            }
-            else
-            {
-                shstr_table.resize( head.size );
-                fseek( fp, (long) head.offset, SEEK_SET );
-                read = fread( shstr_table.data(), 1, head.size, fp );
-                if ( 0 == read )
-                    usage( "can't read shstr table\n" );
-            }
-        }
-    }
+#ifdef HOST_PERF_COUNTERS
 
-    printf( "section headers:\n" );
-    printf( "   # Name                 Type                             Address  Offset   Size     Flags\n" );
+// -p:h counts host hardware events on the emulator's thread while the cpu runs, normalized per guest instruction,
+// to show where emulation time goes without running the whole process under perf stat. counters are opened one by
+// one so those the host lacks, as in many VMs, don't hide the others.
 
-    for ( uint16_t sh = 0; sh < ehead.section_header_table_entries; sh++ )
-    {
-        size_t o = ehead.section_header_table + ( sh * ehead.section_header_table_size );
-        //printf( "section header %u at offset %zu == %zx\n", sh, o, o );
+struct HostCounter
+{
+    const char * name;
+    uint32_t type;
+    uint64_t config;
+    bool per_block;                   // normalized per guest basic block entry rather than per guest instruction
+    int descriptor;
+};
 
-        ElfSectionHeader64 head = {0};
+static HostCounter g_hostCounters[] =
+{
+    { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false, -1 },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false, -1 },
+    { "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, true, -1 },
+    { "L1D misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ), false, -1 },
+    { "LLC misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ), false, -1 },
+    { "iTLB misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_ITLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ), false, -1 },
+};
 
-        fseek( fp, (long) o, SEEK_SET );
-        read = fread( &head, 1, get_min( sizeof( head ), (size_t) ehead.section_header_table_size ), fp );
-        if ( 0 == read )
-            usage( "can't read section header" );
+static int g_hostCountersErrno = 0;   // from the first counter that couldn't be opened
 
-        head.swap_endianness();
-        printf( "  %2u", sh );
-        printf( " %-20s", & shstr_table[ head.name_offset ] );
-        printf( " %-32s", head.show_type() );
-        printf( " %08llx", head.address );
-        printf( " %08llx", head.offset );
-        printf( " %08llx", head.size );
-        printf( " %#llx / %s\n", head.flags, head.show_flags() );
+static void open_host_counters()
+{
+    for ( size_t i = 0; i < _countof( g_hostCounters ); i++ )
+    {
+        HostCounter & c = g_hostCounters[ i ];
+        struct perf_event_attr attr;
+        memset( &attr, 0, sizeof( attr ) );
+        attr.size = sizeof( attr );
+        attr.type = c.type;
+        attr.config = c.config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;      // allowed at the default perf_event_paranoid level, and syscall time isn't the emulator's
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        c.descriptor = (int) syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 );
+        if ( c.descriptor < 0 && 0 == g_hostCountersErrno )
+            g_hostCountersErrno = errno;
+        tracer.Trace( "host counter %s: descriptor %d\n", c.name, c.descriptor );
+    }
+} //open_host_counters
+
+static void enable_host_counters( bool enable )
+{
+    for ( size_t i = 0; i < _countof( g_hostCounters ); i++ )
+        if ( g_hostCounters[ i ].descriptor >= 0 )
+            ioctl( g_hostCounters[ i ].descriptor, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, 0 );
+} //enable_host_counters
 
-        if ( 2 == head.type ) // symbol table
-        {
-            vector<ElfSymbol64> symbols;
-            symbols.resize( head.size / sizeof( ElfSymbol64 ) );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( symbols.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read symbol table" );
+static void show_host_counters( uint64_t instructions, uint64_t blocks )
+{
+    // blocks are the guest's basic block entries from the flight recorder: one after each control transfer instruction,
+    // taken or not. counts are scaled up when the kernel multiplexed a counter with others
 
-            if ( verbose )
-            {
-                size_t count = head.size / sizeof( ElfSymbol64 );
-                printf( "  symbols:\n" );
-                for ( size_t sym = 0; sym < symbols.size(); sym++ )
-                {
-                    printf( "    symbol # %zd\n", sym );
-                    ElfSymbol64 & sym_entry = symbols[ sym ];
+    char ac[ 100 ];
+    bool any = false;
+    for ( size_t i = 0; i < _countof( g_hostCounters ); i++ )
+    {
+        HostCounter & c = g_hostCounters[ i ];
+        if ( c.descriptor < 0 )
+            continue;
 
-                    printf( "     name:  %x == %s\n",   sym_entry.name, ( 0 == sym_entry.name ) ? "" : & string_table[ sym_entry.name ] );
-                    printf( "     info:  %x == %s\n",   sym_entry.info, sym_entry.show_info() );
-                    printf( "     other: %x == %s\n",   sym_entry.other, sym_entry.show_other() );
-                    printf( "     shndx: %x\n",   sym_entry.shndx );
-                    printf( "     value: %llx\n", sym_entry.value );
-                    printf( "     size:  %llu\n", sym_entry.size );
-                }
-            }
-        }
-        else if ( 7 == head.type && 0 != head.size && verbose ) // notes
+        uint64_t values[ 3 ] = { 0 }; // value, time enabled, time running
+        if ( sizeof( values ) == read( c.descriptor, values, sizeof( values ) ) && 0 != values[ 2 ] )
         {
-            vector<uint8_t> notes( head.size );
-            fseek( fp, (long) head.offset, SEEK_SET );
-            read = fread( notes.data(), 1, head.size, fp );
-            if ( 0 == read )
-                usage( "can't read notes\n" );
-            tracer.PrintBinaryData( notes.data(), (uint32_t) head.size, 4 );
+            any = true;
+            uint64_t count = (uint64_t) ( (double) values[ 0 ] * (double) values[ 1 ] / (double) values[ 2 ] );
+            uint64_t per = c.per_block ? blocks : instructions;
+            char label[ 40 ];
+            snprintf( label, sizeof( label ), "host %s:", c.name );
+            printf( "%-22s %15s (%.3lf per guest %s)\n", label, CDJLTrace::RenderNumberWithCommas( count, ac ),
+                    ( 0 == per ) ? 0.0 : (double) count / (double) per, c.per_block ? "block entry" : "instruction" );
         }
-    }
 
-    if ( 0 == g_base_address )
-        printf( "base address of elf image is zero; physical address required for the emulator\n" );
+        close( c.descriptor );
+        c.descriptor = -1;
+    }
 
-    printf( "global info\n" );
-    printf( "  flags: %#08x\n", ehead.flags );
-    printf( "    contains 2-byte compressed RVC instructions: %s\n", g_compressed_rvc ? "yes" : "no" );
-    printf( "    contains 4-byte float instructions: %s\n", ( ehead.flags & 2 ) ? "yes" : "no" );
-    printf( "    contains 8-byte double instructions: %s\n", ( ehead.flags & 4 ) ? "yes" : "no" );
-    printf( "    RV TSO memory consistency: %s\n", ( ehead.flags & 0x10 ) ? "yes" : "no" );
-    printf( "    contains non-standard extensions: %s\n", ( ehead.flags & 0xff000000 ) ? "yes" : "no" );
+    if ( !any )
+        printf( "host counters:         unavailable: %s\n", ( 0 != g_hostCountersErrno ) ? strerror( g_hostCountersErrno ) : "nothing was counted" );
+} //show_host_counters
 
-    printf( "  vm g_base_address %llx\n", (uint64_t) g_base_address );
-    printf( "  memory_size: %llx\n", (uint64_t) memory_size );
-    printf( "  g_stack_commit: %llx\n", (uint64_t) g_stack_commit );
-    printf( "  g_execution_address %llx\n", (uint64_t) g_execution_address );
-#endif
-} //elf_info
+#endif //HOST_PERF_COUNTERS
 
 int main( int argc, char * argv[] )
 {
@@ -9033,10 +14145,15 @@ int main( int argc, char * argv[] )
         bool trace = false;
         char * pcApp = 0;
         bool showPerformance = false;
+        bool hostCounters = false;
         bool traceInstructions = false;
         bool elfInfo = false;
         bool verboseElfInfo = false;
         bool generateRVCTable = false;
+        uint64_t pauseInstructions = 0;
+        const char * pcRestoreFile = 0;
+        const char * pcRecordFile = 0;
+        const char * pcReplayFile = 0;
         static char acAppArgs[1024] = {0};
         static char acApp[1024] = {0};
 
@@ -9090,10 +14207,111 @@ int main( int argc, char * argv[] )
 
                     g_mmap_commit = mmap_space * 1024 * 1024;
                 }
+#if defined( X64OS ) || defined( X32OS )
+                else if ( 'b' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -b argument requires a filename" );
+
+                    if ( strlen( parg + 3 ) >= _countof( g_acCodeCacheFile ) )
+                        usage( "code cache filename is too long" );
+
+                    strcpy( g_acCodeCacheFile, parg + 3 );
+                }
+#ifdef X64OS
+                else if ( 'j' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -j argument requires a filename" );
+
+                    if ( strlen( parg + 3 ) >= _countof( g_acTranslationFile ) )
+                        usage( "translation filename is too long" );
+
+                    strcpy( g_acTranslationFile, parg + 3 );
+                }
+#endif
+                else if ( 'c' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -c argument requires a filename" );
+
+                    if ( strlen( parg + 3 ) >= _countof( g_acCheckpointFile ) )
+                        usage( "checkpoint filename is too long" );
+
+                    strcpy( g_acCheckpointFile, parg + 3 );
+                }
+#ifndef _WIN32
+                else if ( 'f' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -f argument requires a filename or afl" );
+
+                    if ( strlen( parg + 3 ) >= _countof( g_acForkServerInputs ) )
+                        usage( "fork server filename is too long" );
+
+                    strcpy( g_acForkServerInputs, parg + 3 );
+                }
+#endif
+                else if ( 'k' == ca )
+                {
+                    g_virtualClockMHz = 1000;
+                    if ( ':' == parg[2] )
+                        g_virtualClockMHz = strtoull( parg + 3, 0, 10 );
+
+                    if ( 0 == g_virtualClockMHz || g_virtualClockMHz > 1000000 )
+                        usage( "invalid virtual clock rate specified" );
+                }
+                else if ( 'n' == ca )
+                {
+                    if ( ':' != parg[2] )
+                        usage( "the -n argument requires a value" );
+
+                    pauseInstructions = strtoull( parg + 3, 0, 10 );
+                }
+                else if ( 'r' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -r argument requires a filename" );
+
+                    pcRestoreFile = parg + 3;
+                }
+                else if ( 'w' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -w argument requires a filename" );
+
+                    pcRecordFile = parg + 3;
+                }
+                else if ( 'x' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -x argument requires a filename" );
+
+                    pcReplayFile = parg + 3;
+                }
+#endif
+                else if ( 'd' == ca )
+                    g_vfsDiscardWrites = true;
                 else if ( 'e' == ca )
                     elfInfo = true;
+                else if ( 'o' == ca )
+                {
+                    if ( ':' != parg[2] || 0 == parg[3] )
+                        usage( "the -o argument requires an app path" );
+
+                    if ( !vfs_mount( parg + 3 ) )
+                        usage( "invalid -o mount path, or the directory or tar file to preload can't be read" );
+                }
                 else if ( 'p' == ca )
+                {
                     showPerformance = true;
+                    if ( ':' == parg[2] )
+                    {
+                        if ( 'h' != tolower( parg[3] ) )
+                            usage( "the only -p option is -p:h" );
+                        hostCounters = true;
+                    }
+                }
                 else if ( 's' == ca )
                 {
                     if ( ':' != parg[2] )
@@ -9105,6 +14323,10 @@ int main( int argc, char * argv[] )
 
                     g_stack_commit = stack_space * 1024;
                 }
+#if defined( X64OS ) || defined( X32OS )
+                else if ( 'u' == ca )
+                    g_heapProfile = true;
+#endif
                 else if ( 'v' == ca )
                     verboseElfInfo = true;
                 else
@@ -9193,9 +14415,39 @@ int main( int argc, char * argv[] )
             return 0;
         }
 
+#if defined( X64OS ) || defined( X32OS )
+        bool forkServer = false;
+#ifndef _WIN32
+        forkServer = ( 0 != g_acForkServerInputs[ 0 ] );
+#endif
+        if ( ( 0 != pauseInstructions ) && ( 0 == g_acCheckpointFile[ 0 ] ) && !forkServer )
+            usage( "-n requires -c or -f" );
+
+        if ( pcRecordFile && ( pcReplayFile || forkServer ) )
+            usage( "-w can't be used with -x or -f" );
+
+        CheckpointHeader checkpointHeader = {0};
+        if ( pcRestoreFile )
+        {
+            // the memory layout must match the checkpoint, so use its sizes instead of -h, -m, and -s
+
+            if ( !read_checkpoint_header( pcRestoreFile, checkpointHeader ) )
+                usage( "checkpoint file can't be read or was created by a different build" );
+
+            g_stack_commit = checkpointHeader.stack_commit;
+            g_brk_commit = checkpointHeader.brk_commit;
+            g_mmap_commit = checkpointHeader.mmap_commit;
+        }
+#endif
+
         bool ok = load_image( acApp, acAppArgs );
         if ( ok )
         {
+#if defined( X64OS ) || defined( X32OS )
+            if ( pcRestoreFile )
+                g_top_of_stack = checkpointHeader.top_of_stack;
+#endif
+
             unique_ptr<CPUClass> cpu( new CPUClass( memory, g_base_address, g_execution_address, g_stack_commit, g_top_of_stack ) );
 
 #if defined( SPARCOS )
@@ -9204,7 +14456,54 @@ int main( int argc, char * argv[] )
             cpu->Mode32( true ); // flip the cpu into 32-bit mode from 64-bit mode
 #endif
 
+#ifdef X64OS
+            if ( 0 != g_acTranslationFile[ 0 ] )
+            {
+                bool translated = translate_app( *cpu, g_acTranslationFile, acApp );
+                g_consoleConfig.RestoreConsole( false );
+                return translated ? 0 : 1;
+            }
+#endif
+
+#if defined( X64OS ) || defined( X32OS )
+            if ( 0 != g_virtualClockMHz )
+                g_virtualEpochNs = duration_cast<nanoseconds>( system_clock::now().time_since_epoch() ).count();
+
+            if ( pcRestoreFile && !restore_checkpoint( *cpu, pcRestoreFile ) )
+                usage( "checkpoint file doesn't match the executable or is corrupt" );
+
+            cpu->set_instruction_limit( pauseInstructions );
+
+            if ( pcRecordFile && !start_syscall_record( pcRecordFile ) )
+                usage( "can't create the syscall record file" );
+
+            if ( pcReplayFile && !start_syscall_replay( pcReplayFile ) )
+                usage( "can't read the syscall replay file" );
+
+            const char * pcCodeCache = ( 0 != g_acCodeCacheFile[ 0 ] ) ? g_acCodeCacheFile : 0;
+            if ( pcCodeCache )
+                open_code_map( *cpu, pcCodeCache );
+
+            start_flight_recorder( *cpu );
+
+            if ( g_heapProfile )
+                start_heap_profile( *cpu );
+#endif
+#ifdef X64OS_TRANSLATED
+            if ( !g_heapProfile ) // translated blocks don't check call hooks
+                use_translations( *cpu );
+#endif
+
             cpu->trace_instructions( traceInstructions );
+
+#ifdef HOST_PERF_COUNTERS
+            if ( hostCounters )
+            {
+                open_host_counters();
+                enable_host_counters( true );
+            }
+#endif
+
             high_resolution_clock::time_point tStart = high_resolution_clock::now();
 
             #ifdef _WIN32
@@ -9213,6 +14512,34 @@ int main( int argc, char * argv[] )
 
             uint64_t instructions = cpu->run();
 
+#if defined( X64OS ) || defined( X32OS )
+            if ( ( 0 != pauseInstructions ) && ( instructions == pauseInstructions ) && !g_terminate )
+            {
+                if ( ( 0 != g_acCheckpointFile[ 0 ] ) && !save_checkpoint( *cpu, g_acCheckpointFile ) )
+                    printf( "unable to write checkpoint file %s\n", g_acCheckpointFile );
+#ifndef _WIN32
+                if ( forkServer )
+                    start_fork_server( *cpu );
+#endif
+                instructions += cpu->run();
+            }
+#endif
+
+#ifdef HOST_PERF_COUNTERS
+            if ( hostCounters )
+                enable_host_counters( false );
+#endif
+
+#if defined( X64OS ) || defined( X32OS )
+#ifndef _WIN32
+            if ( forkServer && !g_forkServerStarted )
+                printf( "the fork server never started; the app didn't call emulator_sys_fork_server\n" );
+#endif
+            end_syscall_record_replay();
+
+            close_code_map( *cpu, pcCodeCache );
+#endif
+
             char ac[ 100 ];
             if ( showPerformance )
             {
@@ -9223,9 +14550,38 @@ int main( int argc, char * argv[] )
                 printf( "instructions:          %15s\n", CDJLTrace::RenderNumberWithCommas( instructions, ac ) );
                 if ( 0 != totalTime )
                     printf( "effective clock rate:  %15s\n", CDJLTrace::RenderNumberWithCommas( instructions / totalTime, ac ) );
+#ifdef HOST_PERF_COUNTERS
+                if ( hostCounters )
+                    show_host_counters( instructions, cpu->flight_entries() );
+#else
+                if ( hostCounters )
+                    printf( "host counters:         unavailable on this platform\n" );
+#endif
                 printf( "app exit code:         %15d\n", g_exit_code );
+#if defined( X64OS ) || defined( X32OS )
+                if ( pcCodeCache )
+                {
+                    printf( "code cache:            %15s\n", g_codeCacheWarm ? "warm" : "cold" );
+                    printf( "cache load microsecs:  %15s\n", CDJLTrace::RenderNumberWithCommas( g_codeCacheLoadUs, ac ) );
+                    printf( "cached instructions:   %15s\n", CDJLTrace::RenderNumberWithCommas( cpu->code_map_count( CPUClass::code_map_from_cache ), ac ) );
+                    printf( "decoded instructions:  %15s\n", CDJLTrace::RenderNumberWithCommas( cpu->code_map_count( CPUClass::code_map_from_run ), ac ) );
+                }
+
+                // each block entry is one store to a ring the size of a few cache lines, so this is the recorder's cost
+                printf( "flight recorded:       %15s block entries (%.1lf per 1,000 instructions)\n", CDJLTrace::RenderNumberWithCommas( cpu->flight_entries(), ac ),
+                        ( 0 == instructions ) ? 0.0 : 1000.0 * (double) cpu->flight_entries() / (double) instructions );
+#endif
+#ifdef X64OS_TRANSLATED
+                printf( "translated instrs:     %15s (%.1lf%% of instructions)\n", CDJLTrace::RenderNumberWithCommas( cpu->translated_instructions(), ac ),
+                        ( 0 == instructions ) ? 0.0 : 100.0 * (double) cpu->translated_instructions() / (double) instructions );
+#endif
             }
 
+#if defined( X64OS ) || defined( X32OS )
+            if ( g_heapProfile )
+                show_heap_profile();
+#endif
+
             tracer.Trace( "highwater brk heap:  %15s\n", CDJLTrace::RenderNumberWithCommas( g_highwater_brk - g_end_of_data, ac ) );
             g_mmap.trace_allocations();
             tracer.Trace( "highwater mmap heap: %15s\n", CDJLTrace::RenderNumberWithCommas( g_mmap.peak_usage(), ac ) );
@@ -9249,3 +14605,5 @@ int main( int argc, char * argv[] )
     tracer.Shutdown();
     return g_exit_code;
 } //main
+
+#endif // X64OS_LIBRARY